@@ -19,6 +19,8 @@ Copyright Glare Technologies Limited 2024 -
 #include <utils/RuntimeCheck.h>
 #include <resonance_audio/api/resonance_audio_api.h>
 #include <tracy/Tracy.hpp>
+#include <algorithm>
+#include <cmath>
 
 #define USE_MINIAUDIO 1
 
@@ -61,7 +63,8 @@ namespace glare
 
 AudioSource::AudioSource()
 :	resonance_handle(0), cur_read_i(0), type(SourceType_Looping), spatial_type(SourceSpatialType_Spatial), remove_on_finish(true), volume(1.f), mute_volume_factor(1.f), mute_change_start_time(-2), mute_change_end_time(-1), mute_vol_fac_start(1.f),
-	mute_vol_fac_end(1.f), pos(0,0,0,1), num_occlusions(0), userdata_1(0), doppler_factor(1), smoothed_cur_level(0), sampling_rate(44100)
+	mute_vol_fac_end(1.f), pos(0,0,0,1), num_occlusions(0), userdata_1(0), doppler_factor(1), smoothed_cur_level(0), sampling_rate(44100),
+	mixer_volume(1.f), mixer_pos(0,0,0,1), mixer_num_occlusions(0)
 {}
 
 
@@ -121,6 +124,15 @@ void AudioSource::setMuteVolumeFactorImmediately(float factor)
 }
 
 
+void AudioSource::updateMixerParams()
+{
+	Lock lock(source_mutex);
+	mixer_volume = volume * mute_volume_factor;
+	mixer_pos = pos;
+	mixer_num_occlusions = num_occlusions;
+}
+
+
 void AudioSource::updateDopplerEffectFactor(const Vec4f& source_linear_vel, const Vec4f& listener_linear_vel, const Vec4f& listener_pos)
 {
 	const Vec4f source_to_listener = listener_pos - pos;
@@ -160,7 +172,12 @@ float SoundFile::minVal() const
 AudioEngine::AudioEngine()
 :	audio(NULL),
 	resonance(NULL),
-	initialised(false)
+	initialised(false),
+	max_num_spatial_voices(DEFAULT_MAX_NUM_SPATIAL_VOICES),
+	listener_pos(0, 0, 0),
+	sound_file_cache_size_B(0),
+	sound_file_cache_max_size_B(DEFAULT_SOUND_FILE_CACHE_MAX_SIZE_B),
+	sound_file_use_counter(0)
 {
 
 }
@@ -318,12 +335,232 @@ static void zeroBuffer(js::Vector<float, 16>& v)
 }
 
 
+// How a source is mixed for the current buffer.
+enum VoiceMode
+{
+	VoiceMode_Mix,		// Passed to Resonance: spatialised for spatial sources.
+	VoiceMode_Virtual,	// Spatial source that didn't make the spatial voice cap: mixed without spatialisation into the overflow source.
+	VoiceMode_Culled	// Inaudible: samples are skipped, not read.
+};
+
+
+struct VoiceInfo
+{
+	AudioSource* source;
+	float audibility;
+	VoiceMode mode;
+};
+
+
+struct VoiceAudibilityGreaterThan
+{
+	bool operator() (const VoiceInfo* a, const VoiceInfo* b) const { return a->audibility > b->audibility; }
+};
+
+
+// Sources with an estimated audibility below this are culled.
+// This is the audibility of a source with volume 1 at AudioEngine::maxAudibleDistForVolume(1), so sources are culled beyond the same distance
+// that GUIClient uses for deciding when to stop playing them.
+static const float MIN_AUDIBILITY = 1.f / AudioEngine::maxAudibleDistForVolume(1.f);
+
+
+// Sets the mode for each voice.
+// Sources with audibility below MIN_AUDIBILITY are culled.  Of the remaining spatial sources, the max_num_spatial_voices loudest are spatialised, 
+// the rest are made virtual.  Non-spatial sources are cheap to mix, so are not limited.
+// spatial_candidates is just a temporary buffer.
+static void selectVoices(js::Vector<VoiceInfo, 16>& voices, int max_num_spatial_voices, std::vector<VoiceInfo*>& spatial_candidates)
+{
+	spatial_candidates.resize(0);
+	for(size_t i=0; i<voices.size(); ++i)
+	{
+		VoiceInfo& voice = voices[i];
+		if(voice.audibility < MIN_AUDIBILITY)
+			voice.mode = VoiceMode_Culled;
+		else
+		{
+			voice.mode = VoiceMode_Mix;
+			if(voice.source->spatial_type == AudioSource::SourceSpatialType_Spatial)
+				spatial_candidates.push_back(&voice);
+		}
+	}
+
+	const size_t max_num = (size_t)myMax(0, max_num_spatial_voices);
+	if(spatial_candidates.size() > max_num)
+	{
+		// Partition so that the loudest max_num candidates come first.
+		std::nth_element(spatial_candidates.begin(), spatial_candidates.begin() + max_num, spatial_candidates.end(), VoiceAudibilityGreaterThan());
+
+		for(size_t i=max_num; i<spatial_candidates.size(); ++i)
+			spatial_candidates[i]->mode = VoiceMode_Virtual;
+	}
+}
+
+
 // Gets buffered audio data from audio sources, copies it to resonance buffers.
 // Then gets mixed data from resonance, puts on queue to rtAudioCallback.
+//
+// To keep the cost of mixing many sources down, the audibility of each source is estimated each buffer.
+// Inaudible sources are culled, and only the loudest AudioEngine::max_num_spatial_voices spatial sources are spatialised by Resonance, 
+// which is the expensive part.  The remaining spatial sources are mixed together without spatialisation into a single stereo overflow source.
+//
+// engine->mutex is only held while taking a snapshot of the audio sources, each source's data is read while holding its source_mutex.
 class ResonanceThread : public MessageableThread
 {
 public:
-	ResonanceThread() : buffers_processed(0) {}
+	ResonanceThread() : buffers_processed(0), overflow_source_handle(-1) {}
+
+	// Reads src_samples_needed samples from the source, advancing the read position.
+	// Returns a pointer to the samples, which will either point into the source's shared buffer, or at the start of temp_buf.
+	const float* readSourceSamples(AudioSource* source, size_t src_samples_needed, bool& remove_source_out)
+	{
+		temp_buf.resizeNoCopy(src_samples_needed);
+
+		const float* contiguous_data_ptr = temp_buf.data(); // Pointer to a buffer of contiguous source samples.
+		// Will either point into an existing shared buffer, or at the start of temp_buf if we need to use it.
+
+		if(source->type == AudioSource::SourceType_Looping)
+		{
+			if(source->shared_buffer.nonNull()) // If we are reading from shared_buffer:
+			{
+				if(source->cur_read_i + src_samples_needed <= source->shared_buffer->buffer.size()) // If we can just copy the current buffer range directly from source->buffer:
+				{
+					contiguous_data_ptr = &source->shared_buffer->buffer[source->cur_read_i];
+
+					source->cur_read_i += src_samples_needed;
+					if(source->cur_read_i == source->shared_buffer->buffer.size()) // If reached end of buf:
+						source->cur_read_i = 0; // wrap
+				}
+				else
+				{
+					// The data range we want to read from the shared buffer wraps.  So copy data to a temporary contiguous buffer first.
+					size_t cur_i = source->cur_read_i;
+
+					for(size_t i=0; i<src_samples_needed; ++i)
+					{
+						temp_buf[i] = source->shared_buffer->buffer[cur_i++];
+						if(cur_i == source->shared_buffer->buffer.size()) // If reach end of buf:
+							cur_i = 0; // wrap.  TODO: optimise: do simple copy in 2 sections.
+					}
+
+					source->cur_read_i = cur_i;
+				}
+			}
+			else // Else if we are reading from a circular buffer:
+			{
+				assert(0); // SourceType_Looping sources should only read from shared buffers.
+				zeroBuffer(temp_buf); // Just pass zeroes to resonance so as to not blow up the listener's ears.
+			}
+		}
+		else if(source->type == AudioSource::SourceType_OneShot)
+		{
+			if(source->shared_buffer.nonNull()) // If we are reading from shared_buffer:
+			{
+				if(source->cur_read_i + src_samples_needed <= source->shared_buffer->buffer.size()) // If we can just copy the current buffer range directly from source->buffer:
+				{
+					contiguous_data_ptr = &source->shared_buffer->buffer[source->cur_read_i];
+					
+					source->cur_read_i += src_samples_needed;
+				}
+				else
+				{
+					// The data range we want to read from the shared buffer exceeds the shared buffer length.  Just read as much data as we can and then pad with zeroes.
+					// Copy data to a temporary contiguous buffer
+					size_t cur_i = source->cur_read_i;
+
+					for(size_t i=0; i<src_samples_needed; ++i)
+					{
+						if(cur_i < source->shared_buffer->buffer.size())
+							temp_buf[i] = source->shared_buffer->buffer[cur_i++];
+						else
+							temp_buf[i] = 0;
+					}
+					source->cur_read_i = cur_i;
+					remove_source_out = source->remove_on_finish && (cur_i >= source->shared_buffer->buffer.size()); // Remove the source if we reached the end of the buffer.
+				}
+			}
+			else // Else if we are reading from a circular buffer:
+			{
+				assert(0); // SourceType_OneShot sources should only read from shared buffers.
+				zeroBuffer(temp_buf); // Just pass zeroes to resonance so as to not blow up the listener's ears.
+			}
+		}
+		else if(source->type == AudioSource::SourceType_Streaming)
+		{
+			if(!source->mix_sources.empty())
+			{
+				// Mix together the audio sources, applying pitch shift factor and volume factor.
+				zeroBuffer(temp_buf);
+
+				for(size_t z=0; z<source->mix_sources.size(); ++z)
+				{
+					MixSource& mix_source = source->mix_sources[z];
+					const size_t src_buffer_size  = mix_source.soundfile->buf->buffer.size();
+					const float* const src_buffer = mix_source.soundfile->buf->buffer.data();
+
+					for(size_t i=0; i<src_samples_needed; ++i)
+					{
+						mix_source.sound_file_i += mix_source.source_delta; // Advance floating-point read index (index into source buffer)
+
+						const size_t index   = (size_t)mix_source.sound_file_i % src_buffer_size;
+						const size_t index_1 = (index + 1)                     % src_buffer_size;
+						const float frac = (float)(mix_source.sound_file_i - (size_t)mix_source.sound_file_i);
+
+						const float sample = src_buffer[index] * (1 - frac) + src_buffer[index_1] * frac;
+						temp_buf[i] += sample * mix_source.mix_factor;
+					}
+				}
+			}
+			else
+			{
+				if(source->buffer.size() >= src_samples_needed) // If there is sufficient data in the circular buffer:
+				{
+					// Copy data to temp_buf before we pop it from the source buffer.  NOTE: Could optimise by popping later, after we process the data, to avoid copying to temp_buf.
+					source->buffer.popFrontNItems(/*dest=*/temp_buf.data(), src_samples_needed);
+				}
+				else
+				{
+					//conPrint("Ran out of data for streaming audio src!");
+					const size_t source_buf_size = source->buffer.size();
+					source->buffer.popFrontNItems(/*dest=*/temp_buf.data(), source_buf_size); // Copy the data that there is to temp_buf
+					for(size_t i=source_buf_size; i<src_samples_needed; ++i) // Pad the rest with zeroes.
+						temp_buf[i] = 0.f;
+				}
+			}
+		}
+
+		runtimeCheck(contiguous_data_ptr != NULL);
+		return contiguous_data_ptr;
+	}
+
+
+	// Advances the read position of a culled source by src_samples_needed samples, without reading the samples, so that the source stays in sync with the time it would have been playing.
+	void skipSourceSamples(AudioSource* source, size_t src_samples_needed, bool& remove_source_out)
+	{
+		if(source->type == AudioSource::SourceType_Looping)
+		{
+			if(source->shared_buffer.nonNull() && !source->shared_buffer->buffer.empty())
+				source->cur_read_i = (source->cur_read_i + src_samples_needed) % source->shared_buffer->buffer.size();
+		}
+		else if(source->type == AudioSource::SourceType_OneShot)
+		{
+			if(source->shared_buffer.nonNull())
+			{
+				source->cur_read_i = myMin(source->cur_read_i + src_samples_needed, source->shared_buffer->buffer.size());
+				remove_source_out = source->remove_on_finish && (source->cur_read_i >= source->shared_buffer->buffer.size());
+			}
+		}
+		else if(source->type == AudioSource::SourceType_Streaming)
+		{
+			if(!source->mix_sources.empty())
+			{
+				for(size_t z=0; z<source->mix_sources.size(); ++z)
+					source->mix_sources[z].sound_file_i += source->mix_sources[z].source_delta * src_samples_needed;
+			}
+			else
+				source->buffer.popFrontNItems(myMin(src_samples_needed, source->buffer.size())); // Discard samples so the buffer doesn't fill up.
+		}
+	}
+
 
 	virtual void doRun() override
 	{
@@ -345,146 +582,64 @@ public:
 				// For N = 4 this gives 0.0213 s = 21.3 ms of latency.
 				while(num_samples_buffered < 512 * 4)
 				{
-					bool filled_valid_buffer = false;
+					// Take a snapshot of the current set of audio sources, so we don't need to hold engine->mutex while mixing.
 					{
 						Lock lock(engine->mutex);
+						sources.resize(0);
+						for(auto it = engine->audio_sources.begin(); it != engine->audio_sources.end(); ++it)
+							sources.push_back(*it);
+					}
 
-						// Set resonance audio buffers for all audio sources
-						for(auto it = engine->audio_sources.begin(); it != engine->audio_sources.end(); )
-						{
-							AudioSource* source = it->ptr();
-							bool remove_source = false;
+					// Estimate the audibility of each source, and decide how to mix it.
+					const Vec4f listener_pos = engine->getListenerPos();
+					voices.resizeNoCopy(sources.size());
+					for(size_t i=0; i<sources.size(); ++i)
+					{
+						Lock source_lock(sources[i]->source_mutex);
+						voices[i].source = sources[i].ptr();
+						voices[i].audibility = AudioEngine::estimateAudibility(*sources[i], listener_pos);
+					}
+					selectVoices(voices, engine->getMaxNumSpatialVoices(), spatial_candidates);
 
-							const int source_sampling_rate = source->sampling_rate;
-							const int resonance_sampling_rate = engine->getSampleRate();
+					const int resonance_sampling_rate = engine->getSampleRate();
+					bool overflow_buf_used = false;
+					int num_mixed = 0, num_virtual = 0, num_culled = 0;
+					sources_to_remove.resize(0);
 
-							size_t src_samples_needed;
-							if(source_sampling_rate == resonance_sampling_rate)
-								src_samples_needed = frames_per_buffer;
-							else
-								src_samples_needed = (int)source->resampler.numSrcSamplesNeeded(frames_per_buffer);
+					// Set resonance audio buffers for all audio sources
+					for(size_t v=0; v<voices.size(); ++v)
+					{
+						const VoiceInfo& voice = voices[v];
+						AudioSource* source = voice.source;
+						bool remove_source = false;
 
-							temp_buf.resizeNoCopy(src_samples_needed);
+						Lock source_lock(source->source_mutex);
 
-							const float* contiguous_data_ptr = temp_buf.data(); // Pointer to a buffer of contiguous source samples.
-							// Will either point into an existing shared buffer, or at the start of temp_buf if we need to use it.
+						const int source_sampling_rate = source->sampling_rate;
 
-							if(source->type == AudioSource::SourceType_Looping)
-							{
-								if(source->shared_buffer.nonNull()) // If we are reading from shared_buffer:
-								{
-									if(source->cur_read_i + src_samples_needed <= source->shared_buffer->buffer.size()) // If we can just copy the current buffer range directly from source->buffer:
-									{
-										contiguous_data_ptr = &source->shared_buffer->buffer[source->cur_read_i];
-
-										source->cur_read_i += src_samples_needed;
-										if(source->cur_read_i == source->shared_buffer->buffer.size()) // If reached end of buf:
-											source->cur_read_i = 0; // wrap
-									}
-									else
-									{
-										// The data range we want to read from the shared buffer wraps.  So copy data to a temporary contiguous buffer first.
-										size_t cur_i = source->cur_read_i;
-
-										for(size_t i=0; i<src_samples_needed; ++i)
-										{
-											temp_buf[i] = source->shared_buffer->buffer[cur_i++];
-											if(cur_i == source->shared_buffer->buffer.size()) // If reach end of buf:
-												cur_i = 0; // wrap.  TODO: optimise: do simple copy in 2 sections.
-										}
-
-										source->cur_read_i = cur_i;
-									}
-								}
-								else // Else if we are reading from a circular buffer:
-								{
-									assert(0); // SourceType_Looping sources should only read from shared buffers.
-									zeroBuffer(temp_buf); // Just pass zeroes to resonance so as to not blow up the listener's ears.
-								}
-							}
-							else if(source->type == AudioSource::SourceType_OneShot)
-							{
-								if(source->shared_buffer.nonNull()) // If we are reading from shared_buffer:
-								{
-									if(source->cur_read_i + src_samples_needed <= source->shared_buffer->buffer.size()) // If we can just copy the current buffer range directly from source->buffer:
-									{
-										contiguous_data_ptr = &source->shared_buffer->buffer[source->cur_read_i];
-										
-										source->cur_read_i += src_samples_needed;
-									}
-									else
-									{
-										// The data range we want to read from the shared buffer exceeds the shared buffer length.  Just read as much data as we can and then pad with zeroes.
-										// Copy data to a temporary contiguous buffer
-										size_t cur_i = source->cur_read_i;
-
-										for(size_t i=0; i<src_samples_needed; ++i)
-										{
-											if(cur_i < source->shared_buffer->buffer.size())
-												temp_buf[i] = source->shared_buffer->buffer[cur_i++];
-											else
-												temp_buf[i] = 0;
-										}
-										source->cur_read_i = cur_i;
-										remove_source = source->remove_on_finish && (cur_i >= source->shared_buffer->buffer.size()); // Remove the source if we reached the end of the buffer.
-									}
-								}
-								else // Else if we are reading from a circular buffer:
-								{
-									assert(0); // SourceType_OneShot sources should only read from shared buffers.
-									zeroBuffer(temp_buf); // Just pass zeroes to resonance so as to not blow up the listener's ears.
-								}
-							}
-							else if(source->type == AudioSource::SourceType_Streaming)
-							{
-								if(!source->mix_sources.empty())
-								{
-									// Mix together the audio sources, applying pitch shift factor and volume factor.
-									zeroBuffer(temp_buf);
-
-									for(size_t z=0; z<source->mix_sources.size(); ++z)
-									{
-										MixSource& mix_source = source->mix_sources[z];
-										const size_t src_buffer_size  = mix_source.soundfile->buf->buffer.size();
-										const float* const src_buffer = mix_source.soundfile->buf->buffer.data();
-
-										for(size_t i=0; i<src_samples_needed; ++i)
-										{
-											mix_source.sound_file_i += mix_source.source_delta; // Advance floating-point read index (index into source buffer)
-
-											const size_t index   = (size_t)mix_source.sound_file_i % src_buffer_size;
-											const size_t index_1 = (index + 1)                     % src_buffer_size;
-											const float frac = (float)(mix_source.sound_file_i - (size_t)mix_source.sound_file_i);
-
-											const float sample = src_buffer[index] * (1 - frac) + src_buffer[index_1] * frac;
-											temp_buf[i] += sample * mix_source.mix_factor;
-										}
-									}
-								}
-								else
-								{
-									if(source->buffer.size() >= src_samples_needed) // If there is sufficient data in the circular buffer:
-									{
-										// Copy data to temp_buf before we pop it from the source buffer.  NOTE: Could optimise by popping later, after we process the data, to avoid copying to temp_buf.
-										source->buffer.popFrontNItems(/*dest=*/temp_buf.data(), src_samples_needed);
-									}
-									else
-									{
-										//conPrint("Ran out of data for streaming audio src!");
-										const size_t source_buf_size = source->buffer.size();
-										source->buffer.popFrontNItems(/*dest=*/temp_buf.data(), source_buf_size); // Copy the data that there is to temp_buf
-										for(size_t i=source_buf_size; i<src_samples_needed; ++i) // Pad the rest with zeroes.
-											temp_buf[i] = 0.f;
-									}
-								}
-							}
+						size_t src_samples_needed;
+						if(source_sampling_rate == resonance_sampling_rate)
+							src_samples_needed = frames_per_buffer;
+						else
+							src_samples_needed = (int)source->resampler.numSrcSamplesNeeded(frames_per_buffer);
 
-							runtimeCheck(contiguous_data_ptr != NULL);
+						if(voice.mode == VoiceMode_Culled)
+						{
+							// Don't pass a buffer to Resonance, so Resonance doesn't process this source for this buffer.
+							skipSourceSamples(source, src_samples_needed, remove_source);
+
+							// Advance the resampler as well, so that numSrcSamplesNeeded() stays in step with the source read position when the source is heard again.
+							if(source_sampling_rate != resonance_sampling_rate)
+								source->resampler.skip(frames_per_buffer, src_samples_needed);
+							num_culled++;
+						}
+						else
+						{
+							const float* contiguous_data_ptr = readSourceSamples(source, src_samples_needed, remove_source);
+
+							const float* mono_samples; // frames_per_buffer samples at the Resonance sampling rate.
 							if(source_sampling_rate == resonance_sampling_rate)
-							{
-								const float* bufptr = contiguous_data_ptr;
-								resonance->SetPlanarBuffer(source->resonance_handle, &bufptr, /*num channels=*/1, frames_per_buffer);
-							}
+								mono_samples = contiguous_data_ptr;
 							else
 							{
 								// Resample audio to the audio engine and Resonance sampling rate.
@@ -492,41 +647,76 @@ public:
 								
 								source->resampler.resample(resampled_buf.data(), frames_per_buffer, contiguous_data_ptr, src_samples_needed, temp_resampling_buf);
 
-								const float* bufptr = resampled_buf.data();
-								resonance->SetPlanarBuffer(source->resonance_handle, &bufptr, /*num channels=*/1, frames_per_buffer);
+								mono_samples = resampled_buf.data();
 							}
 
-
-							if(remove_source)
+							if(voice.mode == VoiceMode_Mix)
 							{
-								resonance->DestroySource(source->resonance_handle);
-								it = engine->audio_sources.erase(it); // Remove currently iterated to source, advance iterator.
+								resonance->SetPlanarBuffer(source->resonance_handle, &mono_samples, /*num channels=*/1, frames_per_buffer);
+								num_mixed++;
 							}
 							else
-								++it;
-						} // End for each audio source
+							{
+								assert(voice.mode == VoiceMode_Virtual);
+
+								// Mix into the overflow buffer, applying our estimate of the volume Resonance would have applied.  Use an equal-power centre pan.
+								if(!overflow_buf_used)
+								{
+									overflow_buf.resizeNoCopy(frames_per_buffer);
+									zeroBuffer(overflow_buf);
+									overflow_buf_used = true;
+								}
+								const float gain = voice.audibility * 0.7071f;
+								for(size_t i=0; i<frames_per_buffer; ++i)
+									overflow_buf[i] += mono_samples[i] * gain;
+								num_virtual++;
+							}
+						}
 
-						// Get mixed/filtered data from Resonance.
-						temp_buf.resizeNoCopy(frames_per_buffer * 2); // We will receive stereo data
-						filled_valid_buffer = resonance->FillInterleavedOutputBuffer(
-							2, // num channels
-							frames_per_buffer, // num frames
-							temp_buf.data()
-						);
+						if(remove_source)
+							sources_to_remove.push_back(source);
+					} // End for each audio source
 
-						buffers_processed++;
+					if(overflow_buf_used)
+					{
+						const float* channel_ptrs[2] = { overflow_buf.data(), overflow_buf.data() };
+						resonance->SetPlanarBuffer(overflow_source_handle, channel_ptrs, /*num channels=*/2, frames_per_buffer);
+					}
 
-						//for(size_t i=0; i<10; ++i)
-						//	conPrint("buf[" + toString(i) + "]: " + toString(buf[i]));
-						if(buffers_processed * frames_per_buffer < 48000) // Ignore first second or so of sound because resonance seems to fill it with garbage.
-							filled_valid_buffer = false;
+					// Remove finished one-shot sources.
+					if(!sources_to_remove.empty())
+					{
+						Lock lock(engine->mutex);
+						for(size_t i=0; i<sources_to_remove.size(); ++i)
+						{
+							resonance->DestroySource(sources_to_remove[i]->resonance_handle);
+							engine->audio_sources.erase(AudioSourceRef(sources_to_remove[i]));
+						}
+					}
 
-						if(!filled_valid_buffer)
-							break; // break while loop
-					} // End engine->mutex scope
+					sources.resize(0); // Drop references to sources, so that removed sources can be destroyed.
+
+					engine->last_num_mixed_voices = num_mixed;
+					engine->last_num_virtual_voices = num_virtual;
+					engine->last_num_culled_voices = num_culled;
+
+					// Get mixed/filtered data from Resonance.
+					temp_buf.resizeNoCopy(frames_per_buffer * 2); // We will receive stereo data
+					bool filled_valid_buffer = resonance->FillInterleavedOutputBuffer(
+						2, // num channels
+						frames_per_buffer, // num frames
+						temp_buf.data()
+					);
+
+					buffers_processed++;
+
+					if(buffers_processed * frames_per_buffer < 48000) // Ignore first second or so of sound because resonance seems to fill it with garbage.
+						filled_valid_buffer = false;
+
+					if(!filled_valid_buffer)
+						break; // break while loop
 
 					// Push mixed/filtered data onto back of buffer that feeds to rtAudioCallback / miniaudioCallBack.
-					if(filled_valid_buffer)
 					{
 						Lock lock(callback_data->buffer_mutex);
 						callback_data->buffer.pushBackNItems(temp_buf.data(), frames_per_buffer * 2);
@@ -556,9 +746,17 @@ public:
 	uint64 frames_per_buffer; // e.g. 256, with 2 samples per frame = 512 samples.
 	uint64 buffers_processed;
 
+	int overflow_source_handle; // Resonance stereo source that virtual voices are mixed into.
+
 	js::Vector<float, 16> temp_buf;
 	js::Vector<float, 16> temp_resampling_buf;
 	js::Vector<float, 16> resampled_buf;
+	js::Vector<float, 16> overflow_buf;
+
+	std::vector<AudioSourceRef> sources; // Snapshot of engine->audio_sources
+	js::Vector<VoiceInfo, 16> voices;
+	std::vector<VoiceInfo*> spatial_candidates;
+	std::vector<AudioSource*> sources_to_remove;
 };
 
 
@@ -698,6 +896,7 @@ void AudioEngine::init()
 		t->callback_data = &this->callback_data;
 		t->frames_per_buffer = buffer_frames;
 		t->temp_buf.resize(buffer_frames * 2);
+		t->overflow_source_handle = resonance->CreateStereoSource(/*num channels=*/2);
 		thread_manager.addThread(t);
 	}
 
@@ -760,6 +959,49 @@ void AudioEngine::setMasterVolume(float volume)
 }
 
 
+void AudioEngine::setMaxNumSpatialVoices(int max_num)
+{
+	max_num_spatial_voices = myMax(0, max_num);
+}
+
+
+float AudioEngine::estimateAudibility(const AudioSource& source, const Vec4f& listener_pos)
+{
+	const float volume = source.mixer_volume;
+
+	if(source.spatial_type == AudioSource::SourceSpatialType_NonSpatial)
+		return volume;
+
+	if(!source.mixer_pos.isFinite())
+		return 0;
+
+	// Use inverse distance attenuation, the same model as maxAudibleDistForVolume(), so that volume * dist_attenuation >= MIN_AUDIBILITY iff dist <= maxAudibleDistForVolume(volume).
+	// Clamp the distance to avoid huge values very close to the source.
+	const float dist = source.mixer_pos.getDist(listener_pos);
+	const float dist_attenuation = 1.f / myMax(0.1f, dist);
+
+	// Each occlusion is applied as a low-pass filter by Resonance, count each one as roughly halving the volume.
+	const float occlusion_factor = std::exp2(-myMax(0.f, source.mixer_num_occlusions));
+
+	return volume * dist_attenuation * occlusion_factor;
+}
+
+
+Vec4f AudioEngine::getListenerPos() const
+{
+	Lock lock(listener_mutex);
+	return Vec4f(listener_pos.x, listener_pos.y, listener_pos.z, 1);
+}
+
+
+std::string AudioEngine::getDiagnostics() const
+{
+	return "Spatialised/mixed voices: " + toString(last_num_mixed_voices) + ", virtual voices: " + toString(last_num_virtual_voices) + ", culled voices: " + toString(last_num_culled_voices) + 
+		" (max spatial voices: " + toString(max_num_spatial_voices) + ")\n" + 
+		"Sound file cache: " + toString(sound_files.size()) + " files, " + toString(sound_file_cache_size_B / 1024) + " KB\n";
+}
+
+
 void AudioEngine::shutdown()
 {
 	thread_manager.killThreadsBlocking();
@@ -820,6 +1062,8 @@ void AudioEngine::addSource(AudioSourceRef source)
 
 	source->resampler.init(/*src rate=*/source->sampling_rate, this->sample_rate);
 
+	source->updateMixerParams();
+
 	Lock lock(mutex);
 	audio_sources.insert(source);
 }
@@ -834,32 +1078,24 @@ void AudioEngine::removeSource(AudioSourceRef source)
 		Lock lock(mutex);
 		audio_sources.erase(source);
 
-		// Remove audio source from sources_playing_streams (MP3AudioStreamer -> set<AudioSourceRef>) map.
-		Reference<MP3AudioStreamer> streamer_to_remove;
-
-		for(auto it = sources_playing_streams.begin(); it != sources_playing_streams.end(); ++it)
+		// Remove audio source from the stream it is playing, if any.
+		for(auto it = streams.begin(); it != streams.end(); ++it)
 		{
-			std::set<AudioSourceRef>& source_set = it->second;
-
-			source_set.erase(source); // Remove from set if present in set.
-
-			if(source_set.empty())
-				streamer_to_remove = it->first; // No audio source is playing this stream now, so we can free the streamer.
-		}
-
-		// We removed the last audio source playing a stream, so remove the streamer.
-		if(streamer_to_remove.nonNull())
-		{
-			// Remove from streams map
-			for(auto it = streams.begin(); it != streams.end(); ++it)
-				if(it->second == streamer_to_remove)
-				{
-					streams.erase(it);
-					break;
-				}
+			AudioStream* stream = it->second.ptr();
+			bool stream_unused;
+			{
+				Lock stream_lock(stream->mutex);
+				auto res = std::find(stream->sources.begin(), stream->sources.end(), source);
+				if(res == stream->sources.end())
+					continue;
+				stream->sources.erase(res);
+				stream_unused = stream->sources.empty();
+			}
 
-			// Remove from sources_playing_streams map
-			sources_playing_streams.erase(streamer_to_remove);
+			// We removed the last audio source playing the stream, so remove the stream.  This frees the decoder (once the StreamerThread is done with it).
+			if(stream_unused)
+				streams.erase(it);
+			break;
 		}
 	} // End lock scope
 }
@@ -867,6 +1103,8 @@ void AudioEngine::removeSource(AudioSourceRef source)
 
 void AudioEngine::sourcePositionUpdated(AudioSource& source)
 {
+	source.updateMixerParams();
+
 	if(!initialised)
 		return;
 
@@ -878,6 +1116,8 @@ void AudioEngine::sourcePositionUpdated(AudioSource& source)
 
 void AudioEngine::sourceVolumeUpdated(AudioSource& source)
 {
+	source.updateMixerParams();
+
 	if(!initialised)
 		return;
 	// conPrint("Setting volume to " + doubleToStringNSigFigs(source.volume, 4));
@@ -887,6 +1127,8 @@ void AudioEngine::sourceVolumeUpdated(AudioSource& source)
 
 void AudioEngine::sourceNumOcclusionsUpdated(AudioSource& source)
 {
+	source.updateMixerParams();
+
 	if(!initialised)
 		return;
 	resonance->SetSoundObjectOcclusionIntensity(source.resonance_handle, source.num_occlusions);
@@ -904,6 +1146,9 @@ void AudioEngine::setHeadTransform(const Vec4f& head_pos, const Quatf& head_rot)
 	{
 		resonance->SetHeadPosition(head_pos[0], head_pos[1], head_pos[2]);
 		resonance->SetHeadRotation(head_rot.v[0], head_rot.v[1], head_rot.v[2], head_rot.v[3]);
+
+		Lock lock(listener_mutex);
+		listener_pos = Vec3f(head_pos[0], head_pos[1], head_pos[2]);
 	}
 }
 
@@ -914,19 +1159,68 @@ SoundFileRef AudioEngine::loadSoundFile(const std::string& sound_file_path)
 }
 
 
+static size_t soundFileSizeB(const SoundFile& sound)
+{
+	return sound.buf->buffer.size() * sizeof(float);
+}
+
+
 SoundFileRef AudioEngine::getOrLoadSoundFile(const std::string& sound_file_path)
 {
+	sound_file_use_counter++;
+
 	auto res = sound_files.find(sound_file_path);
 	if(res == sound_files.end())
 	{
 		// Load the sound
 		SoundFileRef sound = loadSoundFile(sound_file_path);
-		sound_files.insert(std::make_pair(sound_file_path, sound));
+
+		CachedSoundFile cached;
+		cached.sound = sound;
+		cached.last_used = sound_file_use_counter;
+		sound_files.insert(std::make_pair(sound_file_path, cached));
+		sound_file_cache_size_B += soundFileSizeB(*sound);
+
+		trimSoundFileCache();
 		return sound;
 	}
 	else
 	{
-		return res->second;
+		res->second.last_used = sound_file_use_counter;
+		return res->second.sound;
+	}
+}
+
+
+void AudioEngine::setSoundFileCacheMaxSize(size_t max_size_B)
+{
+	sound_file_cache_max_size_B = max_size_B;
+	trimSoundFileCache();
+}
+
+
+// Removes least recently used sound files from the cache until the cache size is <= the budget.
+// Sound files still referenced elsewhere (by an audio source, or by a caller holding a reference) are not removed, as removing them wouldn't free any memory.
+void AudioEngine::trimSoundFileCache()
+{
+	while(sound_file_cache_size_B > sound_file_cache_max_size_B)
+	{
+		auto lru_it = sound_files.end();
+		for(auto it = sound_files.begin(); it != sound_files.end(); ++it)
+		{
+			const SoundFile* sound = it->second.sound.ptr();
+			const bool in_use = (sound->getRefCount() > 1) || (sound->buf->getRefCount() > 1);
+			if(!in_use && (lru_it == sound_files.end() || it->second.last_used < lru_it->second.last_used))
+				lru_it = it;
+		}
+
+		if(lru_it == sound_files.end()) // If all sound files are in use:
+			break;
+
+		const size_t size_B = soundFileSizeB(*lru_it->second.sound);
+		assert(sound_file_cache_size_B >= size_B);
+		sound_file_cache_size_B -= size_B;
+		sound_files.erase(lru_it);
 	}
 }
 
@@ -989,6 +1283,19 @@ void AudioEngine::playOneShotSound(const std::string& sound_file_path, const Vec
 
 
 AudioSourceRef AudioEngine::addSourceFromStreamingSoundFile(const std::string& sound_file_path, const Vec4f& pos, float source_volume, double global_time)
+{
+	return addStreamingSource(sound_file_path, /*data=*/NULL, /*data_owner=*/Reference<ThreadSafeRefCounted>(), pos, source_volume, global_time);
+}
+
+
+AudioSourceRef AudioEngine::addSourceFromStreamingSoundData(const std::string& sound_file_path, ArrayRef<uint8> data, const Reference<ThreadSafeRefCounted>& data_owner, const Vec4f& pos, float source_volume, double global_time)
+{
+	return addStreamingSource(sound_file_path, &data, data_owner, pos, source_volume, global_time);
+}
+
+
+// If data is NULL, the stream decodes the file at sound_file_path.
+AudioSourceRef AudioEngine::addStreamingSource(const std::string& sound_file_path, const ArrayRef<uint8>* data, const Reference<ThreadSafeRefCounted>& data_owner, const Vec4f& pos, float source_volume, double global_time)
 {
 	Lock lock(mutex);
 
@@ -1002,30 +1309,33 @@ AudioSourceRef AudioEngine::addSourceFromStreamingSoundFile(const std::string& s
 	auto res = streams.find(sound_file_path);
 	if(res == streams.end())
 	{
-		// Load the sound
-		Reference<MP3AudioStreamer> streamer = new MP3AudioStreamer(sound_file_path);
-
-		streamer->seekToApproxTimeWrapped(global_time);
-
-		streams.insert(std::make_pair(sound_file_path, streamer));
-
-		sources_playing_streams[streamer].insert(source); // Add this audio source as a user of this stream.
+		// Open the sound file for streaming
+		AudioStreamRef stream = new AudioStream();
+		stream->decoder = data ? AudioStreamDecoder::createDecoderForBuffer(sound_file_path, *data) : AudioStreamDecoder::createDecoderForFile(sound_file_path);
+		stream->data_owner = data_owner;
+		stream->decoder->seekToApproxTimeWrapped(global_time);
+		stream->sources.push_back(source); // Add this audio source as a user of this stream.
+
+		streams.insert(std::make_pair(sound_file_path, stream));
 	}
 	else
 	{
-		// Streamer for this mp3 file already exists.
-		Reference<MP3AudioStreamer> streamer = res->second;
+		// Stream for this file already exists.
+		AudioStream* stream = res->second.ptr();
+
+		Lock stream_lock(stream->mutex); // Hold the stream lock so the StreamerThread doesn't append a block to the other sources but not this one.
 
 		// If there is another source playing this stream, copy the other source's buffer in order to synchronise the audio sources in the audio stream.
-		auto first_source_it = sources_playing_streams[streamer].begin();
-		if(first_source_it != sources_playing_streams[streamer].end())
+		if(!stream->sources.empty())
 		{
-			AudioSourceRef first_source = *first_source_it;
+			AudioSource* first_source = stream->sources[0].ptr();
 
+			Lock source_lock(first_source->source_mutex);
 			source->buffer = first_source->buffer;
+			source->sampling_rate = first_source->sampling_rate;
 		}
 
-		sources_playing_streams[streamer].insert(source); // Add this audio source as a user of this stream.
+		stream->sources.push_back(source); // Add this audio source as a user of this stream.
 	}
 
 	addSource(source);
@@ -1047,6 +1357,128 @@ AudioSourceRef AudioEngine::addSourceFromStreamingSoundFile(const std::string& s
 #include "../utils/TestUtils.h"
 
 
+void glare::AudioEngine::testWithoutDevice()
+{
+	// Test audibility estimation and voice selection
+	{
+		const Vec4f listener_pos(0, 0, 0, 1);
+
+		AudioSourceRef near_source = new AudioSource();
+		near_source->pos = Vec4f(2, 0, 0, 1);
+
+		AudioSourceRef far_source = new AudioSource();
+		far_source->pos = Vec4f(40, 0, 0, 1);
+
+		AudioSourceRef occluded_source = new AudioSource();
+		occluded_source->pos = Vec4f(2, 0, 0, 1);
+		occluded_source->num_occlusions = 2;
+
+		AudioSourceRef silent_source = new AudioSource();
+		silent_source->pos = Vec4f(1, 0, 0, 1);
+		silent_source->volume = 0;
+
+		AudioSourceRef non_spatial_source = new AudioSource();
+		non_spatial_source->spatial_type = AudioSource::SourceSpatialType_NonSpatial;
+		non_spatial_source->pos = Vec4f(1000, 0, 0, 1);
+		non_spatial_source->volume = 0.5f;
+
+		// Sources beyond maxAudibleDistForVolume(volume) should be culled.
+		AudioSourceRef out_of_range_source = new AudioSource();
+		out_of_range_source->pos = Vec4f(maxAudibleDistForVolume(1.f) * 1.1f, 0, 0, 1);
+
+		AudioSourceRef loud_far_source = new AudioSource();
+		loud_far_source->pos = Vec4f(maxAudibleDistForVolume(1.f) * 1.1f, 0, 0, 1);
+		loud_far_source->volume = 2.f;
+
+		AudioSource* sources[] = { near_source.ptr(), far_source.ptr(), occluded_source.ptr(), silent_source.ptr(), non_spatial_source.ptr(), out_of_range_source.ptr(), loud_far_source.ptr() };
+		const size_t num_sources = sizeof(sources) / sizeof(sources[0]);
+		for(size_t i=0; i<num_sources; ++i)
+			sources[i]->updateMixerParams();
+
+		testAssert(epsEqual(estimateAudibility(*near_source, listener_pos), 0.5f));
+		testAssert(epsEqual(estimateAudibility(*far_source, listener_pos), 0.025f));
+		testAssert(epsEqual(estimateAudibility(*occluded_source, listener_pos), 0.125f));
+		testAssert(estimateAudibility(*silent_source, listener_pos) == 0);
+		testAssert(epsEqual(estimateAudibility(*non_spatial_source, listener_pos), 0.5f)); // Distance should be ignored for non-spatial sources.
+
+		near_source->setMuteVolumeFactorImmediately(0.5f);
+		testAssert(epsEqual(estimateAudibility(*near_source, listener_pos), 0.5f)); // Mixer params shouldn't change until updateMixerParams() is called.
+		near_source->updateMixerParams();
+		testAssert(epsEqual(estimateAudibility(*near_source, listener_pos), 0.25f));
+		near_source->setMuteVolumeFactorImmediately(1.f);
+		near_source->updateMixerParams();
+
+		testAssert(estimateAudibility(*out_of_range_source, listener_pos) < MIN_AUDIBILITY);
+		testAssert(estimateAudibility(*loud_far_source, listener_pos) >= MIN_AUDIBILITY);
+
+		js::Vector<VoiceInfo, 16> voices;
+		voices.resize(num_sources);
+		for(size_t i=0; i<num_sources; ++i)
+		{
+			voices[i].source = sources[i];
+			voices[i].audibility = estimateAudibility(*sources[i], listener_pos);
+		}
+		std::vector<VoiceInfo*> temp;
+
+		// With a large enough cap, all audible sources should be mixed.
+		selectVoices(voices, /*max_num_spatial_voices=*/10, temp);
+		testAssert(voices[0].mode == VoiceMode_Mix);
+		testAssert(voices[1].mode == VoiceMode_Mix);
+		testAssert(voices[2].mode == VoiceMode_Mix);
+		testAssert(voices[3].mode == VoiceMode_Culled);
+		testAssert(voices[4].mode == VoiceMode_Mix);
+		testAssert(voices[5].mode == VoiceMode_Culled);
+		testAssert(voices[6].mode == VoiceMode_Mix);
+
+		// With a cap of 2, the quietest audible spatial sources (far_source and loud_far_source) should be virtual.  The non-spatial source is not limited.
+		selectVoices(voices, /*max_num_spatial_voices=*/2, temp);
+		testAssert(voices[0].mode == VoiceMode_Mix);
+		testAssert(voices[1].mode == VoiceMode_Virtual);
+		testAssert(voices[6].mode == VoiceMode_Virtual);
+		testAssert(voices[2].mode == VoiceMode_Mix);
+		testAssert(voices[3].mode == VoiceMode_Culled);
+		testAssert(voices[4].mode == VoiceMode_Mix);
+
+		selectVoices(voices, /*max_num_spatial_voices=*/0, temp);
+		testAssert(voices[0].mode == VoiceMode_Virtual);
+		testAssert(voices[1].mode == VoiceMode_Virtual);
+		testAssert(voices[2].mode == VoiceMode_Virtual);
+		testAssert(voices[4].mode == VoiceMode_Mix);
+	}
+
+	// Test sound file cache eviction
+	try
+	{
+		AudioEngine engine;
+		const std::string path_a = TestUtils::getTestReposDir() + "/testfiles/WAVs/mono.wav";
+		const std::string path_b = TestUtils::getTestReposDir() + "/testfiles/WAVs/stereo.wav";
+
+		SoundFileRef sound_a = engine.getOrLoadSoundFile(path_a);
+		testAssert(engine.getOrLoadSoundFile(path_a) == sound_a); // Should be cached
+		const size_t size_a = engine.getSoundFileCacheSize();
+		testAssert(size_a > 0);
+
+		engine.setSoundFileCacheMaxSize(0);
+		testAssert(engine.getSoundFileCacheSize() == size_a); // sound_a is still referenced so shouldn't be removed.
+
+		SoundFileRef sound_b = engine.getOrLoadSoundFile(path_b);
+		const size_t size_b = engine.getSoundFileCacheSize() - size_a;
+		sound_a = NULL;
+		engine.setSoundFileCacheMaxSize(size_a + size_b - 1); // Need to remove one sound file.  a is unreferenced, so should be removed.
+		testAssert(engine.getSoundFileCacheSize() == size_b);
+		testAssert(engine.getOrLoadSoundFile(path_b) == sound_b); // b should still be cached.
+
+		sound_b = NULL;
+		engine.setSoundFileCacheMaxSize(0);
+		testAssert(engine.getSoundFileCacheSize() == 0);
+	}
+	catch(glare::Exception& e)
+	{
+		failTest(e.what());
+	}
+}
+
+
 void glare::AudioEngine::test()
 {
 	try
@@ -1068,10 +1500,15 @@ void glare::AudioEngine::test()
 		PlatformUtils::Sleep(1);
 		AudioSourceRef source2 = engine.addSourceFromStreamingSoundFile(TestUtils::getTestReposDir() + "/testfiles/mp3s/sample-3s.mp3", Vec4f(1, 1, 0, 1), /*source_volume=*/1.f, /*global time=*/0.0);
 
-		testAssert(engine.streams.size() == 1);
-		testAssert(engine.sources_playing_streams.size() == 1);
-		testAssert(engine.sources_playing_streams.begin()->second.count(source1) == 1);
-		testAssert(engine.sources_playing_streams.begin()->second.count(source2) == 1);
+		{
+			Lock lock(engine.mutex);
+			testAssert(engine.streams.size() == 1);
+			AudioStream* stream = engine.streams.begin()->second.ptr();
+			Lock stream_lock(stream->mutex);
+			testAssert(stream->sources.size() == 2);
+			testAssert(stream->sources[0] == source1);
+			testAssert(stream->sources[1] == source2);
+		}
 
 		for(int i=0; i<3000; ++i)
 		{
@@ -1081,8 +1518,8 @@ void glare::AudioEngine::test()
 		engine.removeSource(source1);
 		engine.removeSource(source2);
 
+		Lock lock(engine.mutex);
 		testAssert(engine.streams.empty());
-		testAssert(engine.sources_playing_streams.empty());
 	}
 	catch(glare::Exception& e)
 	{
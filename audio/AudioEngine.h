@@ -7,6 +7,7 @@ Copyright Glare Technologies Limited 2021 -
 
 
 #include "AudioResampler.h"
+#include "AudioStreamDecoder.h"
 #include "../maths/vec3.h"
 #include "../maths/vec2.h"
 #include "../maths/matrix3.h"
@@ -17,6 +18,7 @@ Copyright Glare Technologies Limited 2021 -
 #include <utils/ThreadManager.h>
 #include <utils/Vector.h>
 #include <utils/VRef.h>
+#include <utils/AtomicInt.h>
 #include <vector>
 #include <set>
 #include <map>
@@ -32,7 +34,6 @@ namespace glare
 
 
 class AudioEngine;
-class MP3AudioStreamer;
 struct SoundFile;
 
 struct AudioBuffer : public ThreadSafeRefCounted
@@ -100,6 +101,10 @@ public:
 
 	int resonance_handle; // Set in AudioEngine::addSource().
 
+	// Protects buffer, cur_read_i, mix_sources, sampling_rate and resampler once the source has been added to the engine, as they are read by the mixer thread.
+	// The mixer does not hold AudioEngine::mutex while reading source data.
+	Mutex source_mutex;
+
 	int sampling_rate;
 	
 	// Audio data can either be in buffer or shared_buffer.
@@ -136,10 +141,34 @@ public:
 	float smoothed_cur_level;
 
 	AudioResampler resampler;
+
+	// Copies volume * mute volume factor, pos and num_occlusions to the mixer_ fields below, while holding source_mutex.
+	// Called by AudioEngine::addSource() and the AudioEngine::source*Updated() methods.
+	void updateMixerParams();
+
+	// Snapshot of the parameters used by the mixer thread to estimate audibility.  Protected by source_mutex.
+	// The fields above are written by the main thread without locking, so the mixer thread shouldn't read them directly.
+	float mixer_volume;
+	Vec4f mixer_pos;
+	float mixer_num_occlusions;
 };
 typedef Reference<AudioSource> AudioSourceRef;
 
 
+// A decoder for a streamed sound file, and the audio sources playing it.
+// Each block is decoded once, by the StreamerThread, and appended to the buffers of all sources playing the stream, so the sources stay in sync.
+struct AudioStream : public ThreadSafeRefCounted
+{
+	Reference<ThreadSafeRefCounted> data_owner; // Keeps the data read by decoder alive, if decoding from memory.  Declared before decoder so it is destroyed after it.
+	AudioStreamDecoderRef decoder;
+
+	// Protects decoder and sources.  Lock order is AudioEngine::mutex, then AudioStream::mutex, then AudioSource::source_mutex.
+	Mutex mutex;
+	std::vector<AudioSourceRef> sources		GUARDED_BY(mutex);
+};
+typedef Reference<AudioStream> AudioStreamRef;
+
+
 struct AudioCallbackData
 {
 	Mutex buffer_mutex; // protects buffer
@@ -176,6 +205,10 @@ public:
 
 	AudioSourceRef addSourceFromStreamingSoundFile(const std::string& sound_file_path, const Vec4f& pos, float source_volume, double global_time);
 
+	// Like addSourceFromStreamingSoundFile(), but decodes the sound file from data in memory.  data_owner is kept by the stream to keep data alive.
+	// sound_file_path identifies the stream, and its extension determines the format.
+	AudioSourceRef addSourceFromStreamingSoundData(const std::string& sound_file_path, ArrayRef<uint8> data, const Reference<ThreadSafeRefCounted>& data_owner, const Vec4f& pos, float source_volume, double global_time);
+
 	void sourcePositionUpdated(AudioSource& source);
 
 	void sourceVolumeUpdated(AudioSource& source);
@@ -193,11 +226,42 @@ public:
 	
 	void setMasterVolume(float volume);
 
+	static const int DEFAULT_MAX_NUM_SPATIAL_VOICES = 32;
+
+	// Sets the maximum number of spatial sources that are spatialised by Resonance each buffer.
+	// The loudest sources are spatialised, the rest are mixed without spatialisation.
+	void setMaxNumSpatialVoices(int max_num);
+	int getMaxNumSpatialVoices() const { return (int)max_num_spatial_voices; }
+
+	// Estimates the volume of the source at the listener, taking into account the source volume, mute factor, distance attenuation and occlusions.
+	// Used for culling inaudible sources and choosing which sources to spatialise.
+	// Reads the source mixer_ parameters, so source.source_mutex should be held.
+	static float estimateAudibility(const AudioSource& source, const Vec4f& listener_pos);
+
+	// Returns the distance beyond which a source with the given volume factor is considered inaudible.
+	// Assumes amplitude falls off inversely with distance, and that a source with volume 1 is inaudible beyond 60 m.
+	static float maxAudibleDistForVolume(float volume) { return 60.f * volume; }
+
+	Vec4f getListenerPos() const;
+
+	static const size_t DEFAULT_SOUND_FILE_CACHE_MAX_SIZE_B = 64 * 1024 * 1024;
+
+	// Returns the fully decoded sound file, loading it if it is not in the sound file cache.
+	// If the total size of cached sound files is over the budget, least recently used sound files not used by any source are removed from the cache.
+	// Not threadsafe, should be called from the main thread only.
 	SoundFileRef getOrLoadSoundFile(const std::string& sound_file_path);
 
+	void setSoundFileCacheMaxSize(size_t max_size_B);
+	size_t getSoundFileCacheSize() const { return sound_file_cache_size_B; }
+
+	std::string getDiagnostics() const;
+
+	static void testWithoutDevice(); // Tests that don't need an audio device.
 	static void test();
 private:
 	SoundFileRef loadSoundFile(const std::string& sound_file_path);
+	AudioSourceRef addStreamingSource(const std::string& sound_file_path, const ArrayRef<uint8>* data, const Reference<ThreadSafeRefCounted>& data_owner, const Vec4f& pos, float source_volume, double global_time);
+	void trimSoundFileCache();
 
 	RtAudio* audio;
 	ma_device* device; // Miniaudio device
@@ -213,14 +277,30 @@ public:
 
 	ThreadManager thread_manager; // Manages: ResonanceThread, StreamerThread
 
-	std::map<std::string, SoundFileRef> sound_files;
-
-	std::map<std::string, Reference<MP3AudioStreamer>> streams; // Map from mp3 file path to MP3AudioStreamer for that mp3.
+	std::map<std::string, AudioStreamRef> streams		GUARDED_BY(mutex); // Map from sound file path to stream for that file.
 
-	std::map<Reference<MP3AudioStreamer>, std::set<AudioSourceRef>> sources_playing_streams; // Map from MP3AudioStreamer to audio sources playing that stream.
+	// Number of sources spatialised, mixed as virtual voices, and culled, for the last buffer mixed.  For diagnostics.
+	glare::AtomicInt last_num_mixed_voices;
+	glare::AtomicInt last_num_virtual_voices;
+	glare::AtomicInt last_num_culled_voices;
 
 private:
+	struct CachedSoundFile
+	{
+		SoundFileRef sound;
+		uint64 last_used; // Value of sound_file_use_counter when last returned from getOrLoadSoundFile().
+	};
+	std::map<std::string, CachedSoundFile> sound_files;
+	size_t sound_file_cache_size_B; // Total size of decoded samples in sound_files.
+	size_t sound_file_cache_max_size_B;
+	uint64 sound_file_use_counter;
+
 	uint32 sample_rate;
+
+	glare::AtomicInt max_num_spatial_voices;
+
+	mutable Mutex listener_mutex;
+	Vec3f listener_pos		GUARDED_BY(listener_mutex);
 };
 
 
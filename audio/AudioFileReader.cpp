@@ -37,6 +37,45 @@ SoundFileRef AudioFileReader::readAudioFile(const std::string& path)
 }
 
 
+SoundFileRef AudioFileReader::readAudioFileFromBuffer(const std::string& path, const uint8* data, size_t len)
+{
+	if(::hasExtension(path, "mp3"))
+	{
+		return MP3AudioFileReader::readAudioFileFromBuffer(data, len);
+	}
+	else if(::hasExtension(path, "wav"))
+	{
+		return WavAudioFileReader::readAudioFileFromBuffer(data, len);
+	}
+	else
+		throw glare::Exception("Unhandled audio format: " + ::getExtension(path));
+}
+
+
+AudioStreamDecoderRef AudioStreamDecoder::createDecoderForFile(const std::string& path)
+{
+	if(::hasExtension(path, "mp3"))
+	{
+		return new MP3AudioStreamer(path);
+	}
+	else if(::hasExtension(path, "wav"))
+	{
+		return new WavAudioStreamer(path);
+	}
+	else
+		throw glare::Exception("Unhandled audio format: " + ::getExtension(path));
+}
+
+
+AudioStreamDecoderRef AudioStreamDecoder::createDecoderForBuffer(const std::string& path, ArrayRef<uint8> data)
+{
+	if(::hasExtension(path, "mp3"))
+		return new MP3AudioStreamer(data);
+	else
+		throw glare::Exception("Unhandled audio format for streaming from memory: " + ::getExtension(path));
+}
+
+
 } // end namespace glare
 
 
@@ -53,12 +92,76 @@ SoundFileRef AudioFileReader::readAudioFile(const std::string& path)
 #include "../utils/FileUtils.h"
 
 
+// Check that streaming a file gives the same samples as reading the whole file.
+static void testStreamingMatchesReadingWholeFile(const std::string& path)
+{
+	glare::SoundFileRef sound_file = glare::AudioFileReader::readAudioFile(path);
+	testAssert(sound_file->num_channels == 1);
+
+	glare::AudioStreamDecoderRef decoder = glare::AudioStreamDecoder::createDecoderForFile(path);
+
+	for(int iter=0; iter<2; ++iter) // Check seeking to the beginning works as well
+	{
+		js::Vector<float, 16> block;
+		size_t num_samples_read = 0;
+		while(1)
+		{
+			int sample_freq_hz;
+			const bool is_EOF = decoder->decodeMonoBlock(block, sample_freq_hz);
+			testAssert(block.empty() || sample_freq_hz == (int)sound_file->sample_rate);
+
+			testAssert(num_samples_read + block.size() <= sound_file->buf->buffer.size());
+			for(size_t i=0; i<block.size(); ++i)
+				testAssert(block[i] == sound_file->buf->buffer[num_samples_read + i]);
+			num_samples_read += block.size();
+
+			if(is_EOF)
+				break;
+		}
+		testAssert(num_samples_read == sound_file->buf->buffer.size());
+
+		decoder->seekToBeginningOfFile();
+	}
+}
+
+
 void glare::AudioFileReader::test()
 {
 	conPrint("AudioFileReader::test()");
 
 	try
 	{
+		testStreamingMatchesReadingWholeFile(TestUtils::getTestReposDir() + "/testfiles/WAVs/mono.wav");
+		testStreamingMatchesReadingWholeFile(TestUtils::getTestReposDir() + "/testfiles/WAVs/stereo.wav");
+		testStreamingMatchesReadingWholeFile(TestUtils::getTestReposDir() + "/testfiles/WAVs/mono_24bit.wav");
+		testStreamingMatchesReadingWholeFile(TestUtils::getTestReposDir() + "/testfiles/WAVs/stereo_24bit.wav");
+		testStreamingMatchesReadingWholeFile(TestUtils::getTestReposDir() + "/testfiles/WAVs/stereo_32bit.wav");
+
+		// Test an mp3 file streams without errors.
+		{
+			AudioStreamDecoderRef decoder = AudioStreamDecoder::createDecoderForFile(TestUtils::getTestReposDir() + "/testfiles/mp3s/sample-3s.mp3");
+			js::Vector<float, 16> block;
+			size_t num_samples_read = 0;
+			while(1)
+			{
+				int sample_freq_hz;
+				const bool is_EOF = decoder->decodeMonoBlock(block, sample_freq_hz);
+				num_samples_read += block.size();
+				if(is_EOF)
+					break;
+			}
+			testAssert(num_samples_read > 0);
+		}
+
+		// Test unhandled format
+		try
+		{
+			AudioStreamDecoder::createDecoderForFile("a.aac");
+			failTest("Expected exception");
+		}
+		catch(glare::Exception&)
+		{}
+
 		/*{
 			const std::vector<std::string> paths = FileUtils::getFilesInDirWithExtensionFullPaths("D:\\audio\\substrata_mp3s", "mp3");
 			for(size_t i = 0; i<paths.size(); ++i)
@@ -25,6 +25,9 @@ class AudioFileReader
 public:
 	static SoundFileRef readAudioFile(const std::string& path);
 
+	// Reads the file contents from memory.  The format is determined from the extension of path.
+	static SoundFileRef readAudioFileFromBuffer(const std::string& path, const uint8* data, size_t len);
+
 	static void test();
 };
 
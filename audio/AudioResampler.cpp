@@ -9,11 +9,120 @@ Copyright Glare Technologies Limited 2023 -
 #include <utils/ConPrint.h>
 #include <utils/StringUtils.h>
 #include <utils/PlatformUtils.h>
+#include <utils/Mutex.h>
+#include <utils/Lock.h>
+#include <maths/SSE.h>
+#include <cmath>
+#include <map>
 
 
 namespace glare
 {
-	
+
+
+static const int MAX_NUM_PHASES = 1024; // For rate pairs with large up factors (e.g. 11025 -> 48000), fractional offsets are quantised to this many phases.
+static const int BASE_NUM_TAPS = 24; // Number of taps for upsampling.  Downsampling uses proportionally more.
+static const int MAX_NUM_TAPS = 128;
+static const double CUTOFF_FRACTION = 0.9; // Filter cutoff as a fraction of the Nyquist frequency of the lower of the two rates.  The remainder is the transition band.
+static const double KAISER_BETA = 8.0; // Gives a stopband attenuation of roughly 80 dB.
+
+
+static int gcd(int a, int b)
+{
+	while(b != 0)
+	{
+		const int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window.
+static double besselI0(double x)
+{
+	double sum = 1;
+	double term = 1;
+	for(int k=1; k<50; ++k)
+	{
+		const double a = x / (2 * k);
+		term *= a * a;
+		sum += term;
+		if(term < sum * 1.0e-12)
+			break;
+	}
+	return sum;
+}
+
+
+static Mutex filter_banks_mutex;
+static std::map<std::pair<int, int>, Reference<AudioResamplerFilterBank> > filter_banks; // Map from (src rate, dest rate) to filter bank.  Guarded by filter_banks_mutex.
+
+
+Reference<AudioResamplerFilterBank> AudioResamplerFilterBank::getFilterBank(int src_rate, int dest_rate)
+{
+	Lock lock(filter_banks_mutex);
+
+	const std::pair<int, int> key(src_rate, dest_rate);
+	auto res = filter_banks.find(key);
+	if(res != filter_banks.end())
+		return res->second;
+
+	Reference<AudioResamplerFilterBank> bank = new AudioResamplerFilterBank();
+	bank->build(src_rate, dest_rate);
+	filter_banks[key] = bank;
+	return bank;
+}
+
+
+// Builds Kaiser-windowed sinc filters for each phase (fractional offset of the destination sample time from a source sample).
+// The tap k filter coefficient for phase p, with fractional offset f = p / num_phases, is for the source sample at offset (k - num_taps/2 + 1) from
+// the source sample at or before the destination sample time.
+void AudioResamplerFilterBank::build(int src_rate, int dest_rate)
+{
+	const int g = gcd(src_rate, dest_rate);
+	up_factor = dest_rate / g;
+	down_factor = src_rate / g;
+	num_phases = myMin(up_factor, MAX_NUM_PHASES);
+
+	// When downsampling, the cutoff frequency is lower (relative to the source rate), so the filter needs to be wider.
+	const double rate_ratio = myMin(1.0, (double)dest_rate / (double)src_rate);
+	num_taps = myMin(MAX_NUM_TAPS, ((int)std::ceil(BASE_NUM_TAPS / rate_ratio) + 3) & ~3); // Round up to multiple of 4 for SIMD.
+	const int half_num_taps = num_taps / 2;
+
+	const double cutoff = 0.5 * rate_ratio * CUTOFF_FRACTION; // In cycles per source sample.
+	const double recip_I0_beta = 1.0 / besselI0(KAISER_BETA);
+	const double pi = 3.14159265358979323846;
+
+	coeffs.resizeNoCopy(num_phases * num_taps);
+	for(int p=0; p<num_phases; ++p)
+	{
+		const double frac = (double)p / num_phases;
+		float* const phase_coeffs = &coeffs[p * num_taps];
+
+		double sum = 0;
+		for(int k=0; k<num_taps; ++k)
+		{
+			const double t = (k - half_num_taps + 1) - frac; // Offset of source sample from destination sample time, in source samples.  In [-half_num_taps, half_num_taps].
+
+			const double x = t / half_num_taps;
+			const double window = (std::fabs(x) < 1) ? besselI0(KAISER_BETA * std::sqrt(1 - x*x)) * recip_I0_beta : 0.0;
+
+			const double u = 2 * cutoff * t;
+			const double sinc = (u == 0) ? 1.0 : (std::sin(pi * u) / (pi * u));
+
+			const double h = 2 * cutoff * sinc * window;
+			phase_coeffs[k] = (float)h;
+			sum += h;
+		}
+
+		// Normalise so each phase filter has unit DC gain, to avoid a ripple at the up_factor rate.
+		for(int k=0; k<num_taps; ++k)
+			phase_coeffs[k] = (float)(phase_coeffs[k] / sum);
+	}
+}
+
 
 AudioResampler::AudioResampler()
 {
@@ -25,179 +134,165 @@ void AudioResampler::init(int src_rate_, int dest_rate_)
 {
 	src_rate = src_rate_;
 	dest_rate = dest_rate_;
-	prev_dest_dst_coords = -1;
 
-	prev_samples_0_src_coords = -2;
-	prev_samples[0] = 0;
-	prev_samples[1] = 0;
+	next_dest_i = 0;
+	src_base_i = 0;
+	src_phase_num = 0;
+	num_src_consumed = 0;
+
+	if(src_rate == dest_rate)
+	{
+		filter_bank = NULL;
+		history.clear();
+	}
+	else
+	{
+		filter_bank = AudioResamplerFilterBank::getFilterBank(src_rate, dest_rate);
+
+		// Source samples before the first sample passed in are treated as zero.
+		history.resizeNoCopy(filter_bank->num_taps);
+		for(size_t i=0; i<history.size(); ++i)
+			history[i] = 0;
+	}
+}
+
+
+// Requires num_taps to be a multiple of 4, and coeffs to be 16-byte aligned.
+static inline float dotProduct(const float* samples, const float* coeffs, int num_taps)
+{
+	__m128 sum = _mm_setzero_ps();
+	for(int i=0; i<num_taps; i += 4)
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(samples + i), _mm_load_ps(coeffs + i)));
+
+	// Horizontal sum
+	__m128 shuf = _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(2, 3, 0, 1));
+	__m128 sums = _mm_add_ps(sum, shuf);
+	shuf = _mm_movehl_ps(shuf, sums);
+	sums = _mm_add_ss(sums, shuf);
+	return _mm_cvtss_f32(sums);
 }
 
 
-// Use coordinates x such that:
-// Src samples are spaced uniformly at x=0, x=1, x=2 etc.
-// Dest samples are at x=dest_0_x, dest_0_x+dest_w, dest_0_x+2*dest_w  etc.
-//
-// Currently just doing linear interpolation between source samples (e.g. tent filter).
-//
-// In the example below, evaluating the signal at dest index 0, we interpolate between the value
-// at src sample at x=1 and the src sample at x=2.
-// If num_dest = 4, then we are evaluating up to dest_3, so should have src samples at x=0 to x=4. (e.g. num_src should be >= 5)
-//
-//                     dest index=0       1       2       3       4       5       6
-//                                |-------|-------|-------|-------|-------|-------|-------|-> dest coords
-//                    
-//                             
-//   |-----------------|----------|----|--|-----------|---|-----------|-------------|----->   src coords
-//  x=0               x=1         |   x=2 |           x=3 |           x=4           x=5
-//                     |          |       |               |
-//                     d_i    dext_0_x   dest_1_x       dest_3_x
-//                                |       |
-//                                |<----->|
-//                                 dest_w
-static void resampleFromContiguousBuffer(float* dest_samples, size_t num_dest, const float* src_samples, size_t num_src, double dest_x_0, double dest_w)
+// Computes num_dest destination samples from a contiguous buffer of source samples, with polyphase filtering.
+// src_samples[0] has source index src_samples_0_i.
+// Destination sample i is at source time base + phase_num / up_factor, where base and phase_num start at base_in_out and phase_num_in_out, 
+// and advance by down_factor / up_factor each destination sample.
+static void resampleFromContiguousBuffer(const AudioResamplerFilterBank& bank, float* dest_samples, size_t num_dest, const float* src_samples, size_t num_src, int64 src_samples_0_i, 
+	int64& base_in_out, int64& phase_num_in_out)
 {
-	assert(dest_x_0 >= 0);
-	assert((size_t)std::ceil(dest_x_0 + (num_dest - 1) * dest_w) <= num_src);
-	double dest_i_x = dest_x_0; // x coordinate (source coordinate relative to source sample 0) of destination sample i.
-	const int max_src_i = (int)num_src - 1;
+	const int num_taps = bank.num_taps;
+	const int half_num_taps = num_taps / 2;
+	const int64 up_factor = bank.up_factor;
+	const int64 base_step = bank.down_factor / bank.up_factor;
+	const int64 phase_step = bank.down_factor % bank.up_factor;
+	const bool phases_quantised = bank.num_phases != bank.up_factor;
+	const float* const coeffs = bank.coeffs.data();
+
+	int64 base = base_in_out;
+	int64 phase_num = phase_num_in_out;
 	for(size_t i=0; i<num_dest; ++i)
 	{
-		const int d_i = (int)dest_i_x;
-		const float frac = (float)(dest_i_x - d_i);
-
-		const int d_i_plus_1 = d_i + 1;
-
-		dest_i_x += dest_w;
-		const float val = src_samples[myClamp(d_i, 0, max_src_i)] * (1 - frac) + src_samples[myClamp(d_i_plus_1, 0, max_src_i)] * frac;
-		dest_samples[i] = val;
+		const int64 phase = phases_quantised ? ((phase_num * bank.num_phases) / up_factor) : phase_num;
+		const float* const phase_coeffs = coeffs + phase * num_taps;
+
+		const int64 first = base - half_num_taps + 1 - src_samples_0_i; // Index in src_samples of the source sample for tap 0.
+		if(first >= 0 && first + num_taps <= (int64)num_src)
+			dest_samples[i] = dotProduct(src_samples + first, phase_coeffs, num_taps);
+		else
+		{
+			// Not all source samples needed are present (caller passed fewer samples than numSrcSamplesNeeded() returned).  Treat the missing samples as zero.
+			float sum = 0;
+			for(int k=0; k<num_taps; ++k)
+			{
+				const int64 src_i = first + k;
+				if(src_i >= 0 && src_i < (int64)num_src)
+					sum += src_samples[src_i] * phase_coeffs[k];
+			}
+			dest_samples[i] = sum;
+		}
+
+		// Advance to next destination sample time.
+		base += base_step;
+		phase_num += phase_step;
+		if(phase_num >= up_factor)
+		{
+			phase_num -= up_factor;
+			base++;
+		}
 	}
+
+	base_in_out = base;
+	phase_num_in_out = phase_num;
 }
 
 
 size_t AudioResampler::numSrcSamplesNeeded(size_t dest_num_samples)
 {
-	const int64 max_dest_dst_coords = prev_dest_dst_coords + dest_num_samples; // Get destination coordinate for largest destination sample to be computed
-	const double max_dest_x_src_coords  = max_dest_dst_coords * (double)src_rate / (double)dest_rate; // Source coordinates for the new rightmost destination sample.
+	if(filter_bank.isNull())
+		return dest_num_samples;
+
+	if(dest_num_samples == 0)
+		return 0;
 
-	const int64 prev_samples_1_src_coords = this->prev_samples_0_src_coords + 1; // Source coordinates for prev_samples[1]
+	// Work out the source sample at or before the time of the last destination sample to be computed.  We need source samples up to half_num_taps after it.
+	const int64 last_dest_i = next_dest_i + (int64)dest_num_samples - 1;
+	const int64 last_base = (last_dest_i * filter_bank->down_factor) / filter_bank->up_factor;
+	const int64 src_end = last_base + filter_bank->num_taps / 2 + 1;
 
-	const size_t num_needed = (size_t)std::ceil(max_dest_x_src_coords) - prev_samples_1_src_coords;
-	return num_needed;
+	return (size_t)myMax<int64>(0, src_end - num_src_consumed);
 }
 
 
 void AudioResampler::resample(float* dest_samples, size_t dest_samples_size, const float* src_samples, size_t src_samples_size, js::Vector<float, 16>& temp_buf)
 {
-#if 1
-	// Simpler code that just forms a temporary buffer of source samples.  Less efficient due to copying of samples to the temp buffer.
-	
-	// Form a contiguous buffer of source samples
-	temp_buf.resizeNoCopy(src_samples_size + 2);
-	temp_buf[0] = prev_samples[0];
-	temp_buf[1] = prev_samples[1];
+	if(filter_bank.isNull()) // If src_rate == dest_rate, just copy.
+	{
+		const size_t num_to_copy = myMin(dest_samples_size, src_samples_size);
+		for(size_t i=0; i<num_to_copy; ++i)
+			dest_samples[i] = src_samples[i];
+		for(size_t i=num_to_copy; i<dest_samples_size; ++i)
+			dest_samples[i] = 0;
+		next_dest_i += dest_samples_size;
+		num_src_consumed += src_samples_size;
+		return;
+	}
+
+	// Form a contiguous buffer of source samples: the history samples followed by the new source samples.
+	const size_t history_size = history.size();
+	temp_buf.resizeNoCopy(history_size + src_samples_size);
+	for(size_t i=0; i<history_size; ++i)
+		temp_buf[i] = history[i];
 	for(size_t i=0; i<src_samples_size; ++i)
-		temp_buf[2 + i] = src_samples[i];
-
-	const int64 dest_0_dest_coords = prev_dest_dst_coords + 1;
-	const double dest_0_src_coords = dest_0_dest_coords * (double)src_rate / (double)dest_rate;
-	const double dest_0_x = dest_0_src_coords - prev_samples_0_src_coords;
-	resampleFromContiguousBuffer(dest_samples, dest_samples_size, temp_buf.data(), temp_buf.size(), 
-		dest_0_x, // dest_0 x coord (in source coords where source sample 0 has x = 0)
-		(double)src_rate / (double)dest_rate // dest_w (in source coords where source coord 0 has x = 0)
-	);
-
-	prev_dest_dst_coords += dest_samples_size;
-	prev_samples_0_src_coords += src_samples_size;
-
-	prev_samples[0] = temp_buf[temp_buf.size() - 2];
-	prev_samples[1] = temp_buf[temp_buf.size() - 1];
-#else
-	// More effcient (in theory) but more complicated code.  Not sure worth the complexity.
-
-// 
-//  Suppose 200 was the last dest coord evaluated.
-//  To evaluate it we need source sample at coord 100 and 101.  So we need to keep those around to evaluate dest coord 201 in the next call of resample.
-// 
-// --------prefix-------------------->|<---------------suffix-----------------------
-//         200      201     202     203    204     205     206
-//       ----|-------|-------|-------|-------|-------|-------|-------|-> dest coords
-//                    
-//                             
-//   |-------|---------|--------------|-------------|--------------|-------------|----->   src coords
-//  100      |        101            102            103            104           105
-// prev_samples_0    prev_samples_1
-//  x=0      |        x=1            x=2           x=3            x=4            x=5
-//         dest_0_x
-//          
-// Lets say we have 2 prev_samples at src coords 100 and 101.  For destination samples to be a function of them, they must have src_coords <= 102, e.g src_coords <= prev_samples_0_src_coords + 2
-// The largest dest sample meeting this requirement is 203.
-// So if 200 was the last dest coord evaluated, we need to use a prefix of 3 samples (201, 202, 203) to evaluate all samples which are a function of src samples 100 and 101.
-	
-	const size_t prefix_num_src = (src_samples_size == 0) ? 2 : 3;
+		temp_buf[history_size + i] = src_samples[i];
 
-	temp_buf.resizeNoCopy(prefix_num_src);
-	temp_buf[0] = prev_samples[0];
-	temp_buf[1] = prev_samples[1];
-	for(size_t i=0; i<prefix_num_src - 2; ++i)
-		temp_buf[2 + i] = src_samples[i];
+	resampleFromContiguousBuffer(*filter_bank, dest_samples, dest_samples_size, temp_buf.data(), temp_buf.size(), /*src_samples_0_i=*/num_src_consumed - (int64)history_size,
+		/*base_in_out=*/src_base_i, /*phase_num_in_out=*/src_phase_num);
 
+	next_dest_i += dest_samples_size;
+	num_src_consumed += src_samples_size;
 
-	const size_t prefix_max_src = prev_samples_0_src_coords + 2;
-	const double prefix_max_dest = prefix_max_src * (double)dest_rate / (double)src_rate;
-	const int64 prefix_max_dest_int = (int64)prefix_max_dest;
-	
-	const size_t prefix_num_dest = myMin<size_t>(prefix_max_dest_int - prev_dest_dst_coords, dest_samples_size);
+	// Save the last history_size source samples
+	for(size_t i=0; i<history_size; ++i)
+		history[i] = temp_buf[temp_buf.size() - history_size + i];
+}
 
-	const double dest_w_src_coords = (double)src_rate / (double)dest_rate;
 
-	if(prefix_num_dest > 0) // If prefix has non-zero length:
-	{
-		const int64 dest_0_dest_coords = prev_dest_dst_coords + 1;
-		const double dest_0_src_coords = dest_0_dest_coords * dest_w_src_coords;
-		const double dest_0_x = dest_0_src_coords - prev_samples_0_src_coords;
-		resampleFromContiguousBuffer(dest_samples, prefix_num_dest, temp_buf.data(), temp_buf.size(), 
-			dest_0_x, // dest_0 x coord (in source coords where source sample 0 has x = 0)
-			dest_w_src_coords // dest_w (in source coords where source coord 0 has x = 0)
-		);
-	}
-	
-	if(dest_samples_size > prefix_num_dest) // If suffix has non-zero length:
-	{
-		// Do the suffix destination samples, that don't depend on prev_samples.
-		// 
-		//   ------prefix-------------------->|<---------------suffix-----------------------
-		//         200      201     202     203    204     205     206
-		//       ----|-------|-------|-------|-------|-------|-------|-------|-> dest coords
-		//                    
-		//                             
-		//   |-----------------|--------------|-------------|--------------|-------------|----->   src coords
-		//  100               101            102            103            104           105
-		// prev_samples_0    prev_samples_1  x=0            x=1            x=2           x=3
-		//                                           |
-		//                                         dest_0_x
-		const int64 suffix_dest_0_dst_coords = prefix_max_dest_int + 1;
-		const double suffix_dest_0_src_coords = suffix_dest_0_dst_coords * dest_w_src_coords;
-		const double suffix_dest_0_x = suffix_dest_0_src_coords - (prev_samples_0_src_coords + 2);
-		resampleFromContiguousBuffer(dest_samples + prefix_num_dest, dest_samples_size - prefix_num_dest, src_samples, src_samples_size, 
-			suffix_dest_0_x, // dest_0 x coord (in source coords where source sample 0 has x = 0)
-			dest_w_src_coords
-		);
-	}
+void AudioResampler::skip(size_t dest_samples_size, size_t src_samples_size)
+{
+	next_dest_i += dest_samples_size;
+	num_src_consumed += src_samples_size;
 
-	prev_dest_dst_coords += dest_samples_size;
-	prev_samples_0_src_coords += src_samples_size;
+	if(filter_bank.isNull())
+		return;
 
-	if(src_samples_size >= 2)
-	{
-		prev_samples[0] = src_samples[src_samples_size - 2];
-		prev_samples[1] = src_samples[src_samples_size - 1];
-	}
-	else if(src_samples_size >= 1)
-	{
-		prev_samples[0] = prev_samples[1];
-		prev_samples[1] = src_samples[src_samples_size - 1];
-	}
-#endif
+	// Advance the source time by dest_samples_size * down_factor / up_factor, as resampleFromContiguousBuffer() would.
+	const int64 up_factor = filter_bank->up_factor;
+	const int64 phase_num = src_phase_num + (int64)dest_samples_size * filter_bank->down_factor;
+	src_base_i += phase_num / up_factor;
+	src_phase_num = phase_num % up_factor;
+
+	for(size_t i=0; i<history.size(); ++i)
+		history[i] = 0;
 }
 
 
@@ -208,6 +303,32 @@ void AudioResampler::resample(float* dest_samples, size_t dest_samples_size, con
 
 
 #include <utils/TestUtils.h>
+#include <utils/Timer.h>
+#include <vector>
+
+
+// Resamples src_data in chunks of dest_chunk_size destination samples, until we run out of source data.
+static void resampleInChunks(int src_sample_rate, int dest_sample_rate, const std::vector<float>& src_data, size_t dest_chunk_size, std::vector<float>& resampled_out)
+{
+	glare::AudioResampler resampler;
+	resampler.init(src_sample_rate, dest_sample_rate);
+
+	js::Vector<float, 16> temp_buf;
+
+	resampled_out.resize(0);
+	size_t src_i = 0;
+	while(1)
+	{
+		const size_t num_src_needed = resampler.numSrcSamplesNeeded(dest_chunk_size);
+		if(src_i + num_src_needed > src_data.size())
+			break;
+
+		resampled_out.resize(resampled_out.size() + dest_chunk_size);
+		resampler.resample(&resampled_out[resampled_out.size() - dest_chunk_size], dest_chunk_size, src_data.data() + src_i, num_src_needed, temp_buf);
+
+		src_i += num_src_needed;
+	}
+}
 
 
 static void testResamplingLinearRamp(int src_sample_rate, int dest_sample_rate)
@@ -215,42 +336,125 @@ static void testResamplingLinearRamp(int src_sample_rate, int dest_sample_rate)
 	const int N = 10000;
 	std::vector<float> src_data(N);
 
-
 	// Test with linear ramp
 	for(int i=0; i<N; ++i)
-		src_data[i] = (float)i;
+		src_data[i] = (float)i * 0.01f;
 
-	glare::AudioResampler resampler;
-	resampler.init(src_sample_rate, dest_sample_rate);
+	std::vector<float> resampled;
+	resampleInChunks(src_sample_rate, dest_sample_rate, src_data, /*dest chunk size=*/37, resampled);
+	testAssert(resampled.size() > 100);
 
-	const int dest_chunk_size = 4;
-	const int dest_N = dest_chunk_size * 10;
+	// Check resampled samples.  Skip the start, where the filter support includes source samples before the first sample (which are treated as zero).
+	for(size_t i=0; i<resampled.size(); ++i)
+	{
+		const double src_time = (double)i * (double)src_sample_rate / (double)dest_sample_rate;
+		if(src_time >= 64)
+		{
+			const double expected = src_time * 0.01;
+			testAssert(std::fabs(resampled[i] - expected) < 1.0e-3);
+		}
+	}
+}
 
-	js::Vector<float, 16> temp_buf;
 
-	std::vector<float> resampled(dest_N);
+// Resamples a sine wave, and returns the signal-to-noise ratio in dB of the resampled signal compared to the exact sine wave.
+static double computeResamplingSNR(int src_sample_rate, int dest_sample_rate, double freq)
+{
+	const int N = src_sample_rate / 2;
+	const double two_pi = 6.283185307179586;
+	std::vector<float> src_data(N);
+	for(int i=0; i<N; ++i)
+		src_data[i] = (float)std::sin(two_pi * freq * i / src_sample_rate);
+
+	std::vector<float> resampled;
+	resampleInChunks(src_sample_rate, dest_sample_rate, src_data, /*dest chunk size=*/256, resampled);
+	testAssert(resampled.size() > 1000);
+
+	double signal_sum = 0, noise_sum = 0;
+	for(size_t i=0; i<resampled.size(); ++i)
+	{
+		const double src_time = (double)i * (double)src_sample_rate / (double)dest_sample_rate;
+		if(src_time >= 64) // Skip start
+		{
+			const double expected = std::sin(two_pi * freq * i / dest_sample_rate);
+			signal_sum += expected * expected;
+			noise_sum += (resampled[i] - expected) * (resampled[i] - expected);
+		}
+	}
+
+	return 10 * std::log10(signal_sum / myMax(noise_sum, 1.0e-30));
+}
+
+
+static void testResamplingQuality(int src_sample_rate, int dest_sample_rate, double freq)
+{
+	const double snr = computeResamplingSNR(src_sample_rate, dest_sample_rate, freq);
+	conPrint(toString(src_sample_rate) + " hz -> " + toString(dest_sample_rate) + " hz, " + doubleToStringNSigFigs(freq, 4) + " hz tone: SNR: " + doubleToStringNSigFigs(snr, 4) + " dB");
+	testAssert(snr > 60);
+}
+
+
+// Check that a resampler that skips a chunk with skip() ends up in the same state as one that resampled it.
+static void testSkip(int src_sample_rate, int dest_sample_rate)
+{
+	const size_t dest_chunk_size = 480;
+	const int N = 20000;
+	std::vector<float> src_data(N);
+	for(int i=0; i<N; ++i)
+		src_data[i] = (float)std::sin(6.283185307179586 * 440.0 * i / src_sample_rate);
+
+	glare::AudioResampler a, b;
+	a.init(src_sample_rate, dest_sample_rate);
+	b.init(src_sample_rate, dest_sample_rate);
+
+	js::Vector<float, 16> temp_buf;
+	std::vector<float> a_out(dest_chunk_size), b_out(dest_chunk_size);
 	size_t src_i = 0;
-	for(int i=0; i<dest_N; i += dest_chunk_size)
+	for(int chunk=0; chunk<5; ++chunk)
 	{
-		const size_t num_src_needed = resampler.numSrcSamplesNeeded(dest_chunk_size);
+		const size_t num_src_needed = a.numSrcSamplesNeeded(dest_chunk_size);
+		testAssert(b.numSrcSamplesNeeded(dest_chunk_size) == num_src_needed);
 		testAssert(src_i + num_src_needed <= src_data.size());
-		resampler.resample(&resampled[i], dest_chunk_size, &src_data[src_i], num_src_needed, temp_buf);
+
+		a.resample(a_out.data(), dest_chunk_size, src_data.data() + src_i, num_src_needed, temp_buf);
+		if(chunk == 1)
+			b.skip(dest_chunk_size, num_src_needed);
+		else
+		{
+			b.resample(b_out.data(), dest_chunk_size, src_data.data() + src_i, num_src_needed, temp_buf);
+
+			// Just after the skip, the filter support includes skipped source samples (treated as zero), so outputs will differ.  After that they should match.
+			const size_t begin = (chunk == 2) ? 200 : 0;
+			for(size_t i=begin; i<dest_chunk_size; ++i)
+				testAssert(std::fabs(a_out[i] - b_out[i]) < 1.0e-6f);
+		}
 
 		src_i += num_src_needed;
 	}
+}
 
-	// Check resampled samples
-	for(int i=0; i<dest_N; ++i)
-	{
-		const double expected = (double)i * (double)src_sample_rate / (double)dest_sample_rate;
-		testMathsApproxEq((double)resampled[i], expected);
-	}
 
+static void testResamplingPerf(int src_sample_rate, int dest_sample_rate)
+{
+	const int N = src_sample_rate * 10; // 10 seconds of audio
+	std::vector<float> src_data(N);
+	for(int i=0; i<N; ++i)
+		src_data[i] = (float)std::sin(i * 0.05);
+
+	Timer timer;
+	std::vector<float> resampled;
+	resampleInChunks(src_sample_rate, dest_sample_rate, src_data, /*dest chunk size=*/256, resampled);
+	const double elapsed = timer.elapsed();
+
+	conPrint(toString(src_sample_rate) + " hz -> " + toString(dest_sample_rate) + " hz: " + doubleToStringNSigFigs(resampled.size() / elapsed * 1.0e-6, 4) + " M samples/s (" + 
+		doubleToStringNSigFigs(resampled.size() / (double)dest_sample_rate / elapsed, 4) + "x realtime)");
 }
 
 
 void glare::AudioResampler::test()
 {
+	conPrint("AudioResampler::test()");
+
 	testResamplingLinearRamp(/*src rate=*/8000, /*dest rate=*/48000);
 	testResamplingLinearRamp(/*src rate=*/12000, /*dest rate=*/48000);
 	testResamplingLinearRamp(/*src rate=*/16000, /*dest rate=*/48000);
@@ -271,20 +475,54 @@ void glare::AudioResampler::test()
 	
 	testResamplingLinearRamp(/*src rate=*/44100, /*dest rate=*/44100);
 
+	// Test a rate pair with quantised phases (up factor = 640)
+	testResamplingLinearRamp(/*src rate=*/11025, /*dest rate=*/48000);
+
+	// Test with a source rate much higher than the dest rate.
+	testResamplingLinearRamp(/*src rate=*/48000, /*dest rate=*/8000);
+
+	// Test filter banks are shared
+	testAssert(AudioResamplerFilterBank::getFilterBank(44100, 48000).ptr() == AudioResamplerFilterBank::getFilterBank(44100, 48000).ptr());
+
+	//------------------------ Test skip() ------------------------
+	testSkip(/*src rate=*/44100, /*dest rate=*/48000);
+	testSkip(/*src rate=*/16000, /*dest rate=*/48000);
+	testSkip(/*src rate=*/48000, /*dest rate=*/16000);
+	testSkip(/*src rate=*/48000, /*dest rate=*/48000);
 
+	//------------------------ Quality tests ------------------------
+	testResamplingQuality(/*src rate=*/44100, /*dest rate=*/48000, /*freq=*/1000);
+	testResamplingQuality(/*src rate=*/44100, /*dest rate=*/48000, /*freq=*/10000);
+	testResamplingQuality(/*src rate=*/16000, /*dest rate=*/48000, /*freq=*/1000);
+	testResamplingQuality(/*src rate=*/16000, /*dest rate=*/48000, /*freq=*/5000);
+	testResamplingQuality(/*src rate=*/48000, /*dest rate=*/44100, /*freq=*/1000);
+	testResamplingQuality(/*src rate=*/48000, /*dest rate=*/16000, /*freq=*/1000);
+	testResamplingQuality(/*src rate=*/11025, /*dest rate=*/48000, /*freq=*/1000);
+
+	// A tone above the Nyquist frequency of the destination rate should be filtered out when downsampling, instead of being aliased.
 	{
-		
-		//// Test with 1 hz sine tone
-		//for(int i=0; i<N; ++i)
-		//{
-		//	const double x = i / 44100.0;
-		//	const double val = std::sin(1.0 * Maths::get2Pi<double>() * x);
-		//	src_data[i] = val;
-		//}
+		const int N = 24000;
+		std::vector<float> src_data(N);
+		for(int i=0; i<N; ++i)
+			src_data[i] = (float)std::sin(6.283185307179586 * 12000.0 * i / 48000);
 
+		std::vector<float> resampled;
+		resampleInChunks(/*src rate=*/48000, /*dest rate=*/16000, src_data, /*dest chunk size=*/160, resampled);
+		
+		double sum = 0;
+		for(size_t i=100; i<resampled.size(); ++i)
+			sum += resampled[i] * resampled[i];
+		const double rms = std::sqrt(sum / (resampled.size() - 100));
+		testAssert(rms < 1.0e-3);
 	}
 
+	//------------------------ Perf tests ------------------------
+	testResamplingPerf(/*src rate=*/44100, /*dest rate=*/48000);
+	testResamplingPerf(/*src rate=*/16000, /*dest rate=*/48000);
+	testResamplingPerf(/*src rate=*/48000, /*dest rate=*/16000);
+
+	conPrint("AudioResampler::test() done.");
 }
 
 
-#endif // BUILD_TESTS
\ No newline at end of file
+#endif // BUILD_TESTS
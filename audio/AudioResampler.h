@@ -8,6 +8,8 @@ Copyright Glare Technologies Limited 2023 -
 
 #include <utils/MessageableThread.h>
 #include <utils/AtomicInt.h>
+#include <utils/ThreadSafeRefCounted.h>
+#include <utils/Reference.h>
 #include <utils/Vector.h>
 
 
@@ -15,10 +17,38 @@ namespace glare
 {
 
 
+/*=====================================================================
+AudioResamplerFilterBank
+------------------------
+Windowed-sinc polyphase filter bank for a pair of sampling rates.
+Built once per rate pair and shared by all resamplers using that pair.
+=====================================================================*/
+class AudioResamplerFilterBank : public ThreadSafeRefCounted
+{
+public:
+	// Returns the filter bank for the given rate pair, building it if it has not been built yet.  Threadsafe.
+	static Reference<AudioResamplerFilterBank> getFilterBank(int src_rate, int dest_rate);
+
+	int up_factor;   // L: dest_rate / gcd(src_rate, dest_rate)
+	int down_factor; // M: src_rate / gcd(src_rate, dest_rate)
+	int num_phases;  // Number of fractional offsets filters are stored for.  Equal to up_factor, unless up_factor is very large.
+	int num_taps;    // Number of taps per phase filter, a multiple of 4.
+
+	js::Vector<float, 16> coeffs; // num_phases * num_taps filter coefficients, phase filters stored contiguously.
+
+private:
+	void build(int src_rate, int dest_rate);
+};
+
+
 /*=====================================================================
 AudioResampler
 --------------
+Streaming sample rate converter, using a windowed-sinc polyphase filter.
 
+Destination sample n is at source time n * src_rate / dest_rate.
+Evaluating it needs source samples up to num_taps/2 samples after that time,
+so numSrcSamplesNeeded() will ask for that many more samples for the first call.
 =====================================================================*/
 class AudioResampler
 {
@@ -27,18 +57,28 @@ public:
 
 	void init(int src_rate, int dest_rate);
 
+	// Returns the number of source samples that need to be passed to resample() to compute the next dest_num_samples destination samples.
 	size_t numSrcSamplesNeeded(size_t dest_num_samples);
 
 	void resample(float* dest_samples, size_t dest_samples_size, const float* src_samples, size_t src_samples_size, js::Vector<float, 16>& temp_buf);
 
+	// Advances the resampler state as if resample() had been called with the given numbers of destination and source samples, without computing any samples.
+	// Used when a source is culled and its samples are skipped.  The skipped source samples are treated as zero in the filter history.
+	void skip(size_t dest_samples_size, size_t src_samples_size);
+
 	static void test();
 
 private:
 	int src_rate, dest_rate;
-	int64 prev_dest_dst_coords; // Destination coord of largest dest sample we have returned.
-	
-	int64 prev_samples_0_src_coords; // Source coordinates for prev_samples[0]
-	float prev_samples[2];
+
+	Reference<AudioResamplerFilterBank> filter_bank; // NULL if src_rate == dest_rate.
+
+	int64 next_dest_i; // Index of next destination sample to be computed.
+	int64 src_base_i; // Index of the source sample at or before the source time of destination sample next_dest_i.
+	int64 src_phase_num; // Fractional part of the source time of destination sample next_dest_i, is src_phase_num / up_factor.
+	int64 num_src_consumed; // Total number of source samples passed to resample().
+
+	js::Vector<float, 16> history; // The last num_taps source samples passed to resample() (zeroes initially).
 };
 
 
@@ -0,0 +1,57 @@
+/*=====================================================================
+AudioStreamDecoder.h
+--------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#pragma once
+
+
+#include <utils/ThreadSafeRefCounted.h>
+#include <utils/Reference.h>
+#include <utils/Vector.h>
+#include <utils/ArrayRef.h>
+#include <string>
+
+
+namespace glare
+{
+
+
+/*=====================================================================
+AudioStreamDecoder
+------------------
+Interface for decoding an audio file a block at a time, to mono float samples.
+Implemented by MP3AudioStreamer and WavAudioStreamer.
+
+Files are memory-mapped (or read from a buffer already in memory), so only the encoded
+file data and the current decoded block are in memory, instead of the whole decoded file.
+=====================================================================*/
+class AudioStreamDecoder : public ThreadSafeRefCounted
+{
+public:
+	virtual ~AudioStreamDecoder() {}
+
+	// Decodes the next block of samples, mixed down to mono.  mono_samples_out may be empty, for example if the decoder skipped some non-audio data.
+	// sample_freq_hz_out is set to 0 if no samples were decoded.
+	// Returns true if reached EOF.
+	virtual bool decodeMonoBlock(js::Vector<float, 16>& mono_samples_out, int& sample_freq_hz_out) = 0;
+
+	virtual void seekToBeginningOfFile() = 0;
+
+	virtual void seekToApproxTimeWrapped(double time) = 0;
+
+	// Makes a decoder for the file, based on the file extension.  Throws glare::Exception on failure.
+	// Defined in AudioFileReader.cpp.
+	static Reference<AudioStreamDecoder> createDecoderForFile(const std::string& path);
+
+	// Makes a decoder reading the file data from memory, based on the extension of path.  Only mp3 files are supported.
+	// data must stay valid while the decoder is in use.  Throws glare::Exception on failure.
+	// Defined in AudioFileReader.cpp.
+	static Reference<AudioStreamDecoder> createDecoderForBuffer(const std::string& path, ArrayRef<uint8> data);
+};
+
+
+typedef Reference<AudioStreamDecoder> AudioStreamDecoderRef;
+
+
+} // end namespace glare
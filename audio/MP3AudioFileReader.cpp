@@ -53,7 +53,7 @@ bool glare::MP3AudioStreamer::decodeFrame(js::Vector<float, 16>& samples_out, in
 	mp3dec_frame_info_t frame_info;
 	const int num_samples_decoded = mp3dec_decode_frame(&decoder, /*input buf=*/(const uint8*)in_stream.currentReadPtr(), /*input buf size=*/(int)input_bytes_avail, /*pcm data out=*/samples_out.data(), &frame_info);
 
-	samples_out.resize(num_samples_decoded * 2);
+	samples_out.resize(num_samples_decoded * frame_info.channels); // num_samples_decoded is the number of samples per channel.
 
 	in_stream.advanceReadIndex(frame_info.frame_bytes);
 
@@ -81,6 +81,29 @@ bool glare::MP3AudioStreamer::decodeFrame(js::Vector<float, 16>& samples_out, in
 }
 
 
+bool glare::MP3AudioStreamer::decodeMonoBlock(js::Vector<float, 16>& mono_samples_out, int& sample_freq_hz_out)
+{
+	int num_channels;
+	const bool is_EOF = decodeFrame(interleaved_samples, num_channels, sample_freq_hz_out);
+
+	if(num_channels == 1)
+	{
+		mono_samples_out = interleaved_samples;
+	}
+	else if(num_channels == 2)
+	{
+		const size_t num_frames = interleaved_samples.size() / 2;
+		mono_samples_out.resizeNoCopy(num_frames);
+		for(size_t i=0; i<num_frames; ++i)
+			mono_samples_out[i] = (interleaved_samples[i*2 + 0] + interleaved_samples[i*2 + 1]) * 0.5f;
+	}
+	else
+		mono_samples_out.resize(0);
+
+	return is_EOF;
+}
+
+
 void glare::MP3AudioStreamer::seekToBeginningOfFile()
 {
 	in_stream.setReadIndex(0);
@@ -7,6 +7,7 @@ Copyright Glare Technologies Limited 2022 -
 
 
 #include "AudioFileReader.h"
+#include "AudioStreamDecoder.h"
 #include <utils/ThreadSafeRefCounted.h>
 #include <utils/BufferViewInStream.h>
 #include <utils/ArrayRef.h>
@@ -34,22 +35,28 @@ MP3AudioStreamer
 ----------------
 Streams an mp3 file - allows reading one mp3 frame at a time
 =====================================================================*/
-class MP3AudioStreamer : public ThreadSafeRefCounted
+class MP3AudioStreamer : public AudioStreamDecoder
 {
 public:
 	MP3AudioStreamer(const std::string& path);
 	MP3AudioStreamer(const ArrayRef<uint8> data);
 	~MP3AudioStreamer();
 
+	// Decodes one mp3 frame to interleaved samples.
 	// Returns true if reached EOF
 	bool decodeFrame(js::Vector<float, 16>& samples_out, int& num_channels_out, int& sample_freq_hz_out);
 
-	void seekToBeginningOfFile();
+	// Decodes one mp3 frame, mixed down to mono.
+	virtual bool decodeMonoBlock(js::Vector<float, 16>& mono_samples_out, int& sample_freq_hz_out) override;
 
-	void seekToApproxTimeWrapped(double time);
+	virtual void seekToBeginningOfFile() override;
+
+	virtual void seekToApproxTimeWrapped(double time) override;
 
 	mp3dec_t decoder;
 
+	js::Vector<float, 16> interleaved_samples; // Temp buffer for decodeMonoBlock()
+
 	MemMappedFile* mem_mapped_file;
 	BufferViewInStream in_stream;
 };
@@ -51,10 +51,19 @@ namespace glare
 
 
 MicReadThread::MicReadThread(ThreadSafeQueue<Reference<ThreadMessage> >* out_msg_queue_, Reference<UDPSocket> udp_socket_, UID client_avatar_uid_, const std::string& server_hostname_, int server_port_, 
-	const std::string& input_device_name_, float input_vol_scale_factor_, MicReadStatus* mic_read_status_)
+	const std::string& input_device_name_, float input_vol_scale_factor_, MicReadStatus* mic_read_status_, int preferred_frame_duration_ms_, bool long_frames_allowed_)
 :	out_msg_queue(out_msg_queue_), udp_socket(udp_socket_), client_avatar_uid(client_avatar_uid_), server_hostname(server_hostname_), server_port(server_port_), 
-	input_device_name(input_device_name_), input_vol_scale_factor(input_vol_scale_factor_), mic_read_status(mic_read_status_)
+	input_device_name(input_device_name_), input_vol_scale_factor(input_vol_scale_factor_), long_frames_allowed(long_frames_allowed_), mic_read_status(mic_read_status_)
 {
+	// Use the closest frame duration supported by Opus.
+	if(preferred_frame_duration_ms_ <= 15)
+		preferred_frame_duration_ms = 10;
+	else if(preferred_frame_duration_ms_ <= 30)
+		preferred_frame_duration_ms = 20;
+	else if(preferred_frame_duration_ms_ <= 50)
+		preferred_frame_duration_ms = 40;
+	else
+		preferred_frame_duration_ms = 60;
 }
 
 
@@ -320,6 +329,20 @@ void MicReadThread::doRun()
 		//const int ret = opus_encoder_ctl(opus_encoder, OPUS_SET_BITRATE(512000));
 		//if(ret != OPUS_OK)
 		//	throw glare::Exception("opus_encoder_ctl failed.");
+
+		// Enable discontinuous transmission: during silence the encoder produces tiny packets, which we don't send.
+		if(opus_encoder_ctl(opus_encoder, OPUS_SET_DTX(1)) != OPUS_OK)
+			throw glare::Exception("opus_encoder_ctl OPUS_SET_DTX failed.");
+
+		// Enable in-band forward error correction, so receivers can reconstruct a lost packet from the following packet.
+		// The encoder only adds FEC data if the expected packet loss percentage is > 0.
+		if(opus_encoder_ctl(opus_encoder, OPUS_SET_INBAND_FEC(1)) != OPUS_OK)
+			throw glare::Exception("opus_encoder_ctl OPUS_SET_INBAND_FEC failed.");
+		if(opus_encoder_ctl(opus_encoder, OPUS_SET_PACKET_LOSS_PERC(10)) != OPUS_OK)
+			throw glare::Exception("opus_encoder_ctl OPUS_SET_PACKET_LOSS_PERC failed.");
+
+		if(opus_encoder_ctl(opus_encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE)) != OPUS_OK)
+			throw glare::Exception("opus_encoder_ctl OPUS_SET_SIGNAL failed.");
 		//-------------------------------------- End Opus init --------------------------------------------------
 
 		uint32 stream_id;
@@ -344,6 +367,7 @@ void MicReadThread::doRun()
 
 		js::Vector<float, 16> resampled_pcm_buffer;
 		glare::AudioResampler resampler;
+		resampler.init(/*src rate=*/(int)capture_sampling_rate, /*dest rate=*/(int)opus_sampling_rate);
 		js::Vector<float, 16> temp_resampling_buf;
 
 		std::vector<uint8> packet;
@@ -368,6 +392,11 @@ void MicReadThread::doRun()
 						InputVolumeScaleChangedMessage* vol_msg = msg.downcastToPtr<InputVolumeScaleChangedMessage>();
 						this->input_vol_scale_factor = vol_msg->input_vol_scale_factor;
 					}
+					else if(msg.isType<LongVoiceFramesAllowedChangedMessage>())
+					{
+						// Receivers get the frame size from each packet, so the frame duration can change mid-stream.
+						this->long_frames_allowed = msg.downcastToPtr<LongVoiceFramesAllowedChangedMessage>()->long_frames_allowed;
+					}
 				}
 			}
 
@@ -486,8 +515,7 @@ void MicReadThread::doRun()
 				}
 
 				// "To encode a frame, opus_encode() or opus_encode_float() must be called with exactly one frame (2.5, 5, 10, 20, 40 or 60 ms) of audio data:"
-				// We will use 10ms frames.
-				const size_t opus_samples_per_frame = opus_sampling_rate / 100;
+				const size_t opus_samples_per_frame = opus_sampling_rate * getFrameDurationMS() / 1000;
 				
 				// While there is enough data in pcm_buffer, keep looping doing the following:
 				// Resample to Opus sample rate if needed, feed frame to Opus to encode, then send UDP packet with encoded data to server.
@@ -527,6 +555,14 @@ void MicReadThread::doRun()
 
 					cur_i += capture_samples_for_frame;
 
+					// "If the return value is 2 bytes or less, then the packet does not need to be transmitted (DTX)."  (https://opus-codec.org/docs/opus_api-1.3.1/group__opus__encoder.html)
+					// Still increment the sequence number, so receivers know how much time has passed.
+					if(encoded_B <= 2)
+					{
+						seq_num++;
+						continue;
+					}
+
 					// Form packet
 					const size_t header_size_B = sizeof(uint32) * 3;
 					packet.resize(header_size_B + encoded_B);
@@ -38,6 +38,14 @@ public:
 };
 
 
+class LongVoiceFramesAllowedChangedMessage : public ThreadMessage
+{
+public:
+	LongVoiceFramesAllowedChangedMessage(bool long_frames_allowed_) : long_frames_allowed(long_frames_allowed_) {}
+	bool long_frames_allowed;
+};
+
+
 struct MicReadStatus
 {
 	MicReadStatus() : cur_level(0) {}
@@ -55,14 +63,27 @@ namespace glare
 MicReadThread
 -------------
 Reads audio from microphone, encodes with Opus, streams to server over UDP connection.
+
+Each UDP packet contains one Opus frame.  The encoder uses DTX, so packets are mostly
+not sent during silence, and in-band FEC, so receivers can recover single lost packets.
+The sequence number is incremented for every frame, including those not sent.
+
+Clients with protocol version < 41 can only decode 10 ms frames, so longer frames
+(preferred_frame_duration_ms) are only used while long_frames_allowed is true, which should only
+be the case when the server reports that all connected clients support them.
 =====================================================================*/
 class MicReadThread : public MessageableThread
 {
 public:
 	MicReadThread(ThreadSafeQueue<Reference<ThreadMessage> >* out_msg_queue, Reference<UDPSocket> udp_socket, UID client_avatar_uid, const std::string& server_hostname, int server_port,
-		const std::string& input_device_name, float input_vol_scale_factor, MicReadStatus* mic_read_status);
+		const std::string& input_device_name, float input_vol_scale_factor, MicReadStatus* mic_read_status, int preferred_frame_duration_ms = DEFAULT_FRAME_DURATION_MS, bool long_frames_allowed = false);
 	~MicReadThread();
 
+	static const int COMPATIBLE_FRAME_DURATION_MS = 10; // Frame duration that all clients can decode.
+	static const int DEFAULT_FRAME_DURATION_MS = 20; // Default preferred frame duration, used if long_frames_allowed is true.
+
+	int getFrameDurationMS() const { return long_frames_allowed ? preferred_frame_duration_ms : COMPATIBLE_FRAME_DURATION_MS; }
+
 	virtual void doRun() override;
 
 	virtual void kill() override { die = 1; }
@@ -78,6 +99,9 @@ public:
 
 	float input_vol_scale_factor;
 
+	int preferred_frame_duration_ms; // Duration of each encoded Opus frame, if long_frames_allowed is true.  One of 10, 20, 40 or 60.
+	bool long_frames_allowed; // If false, COMPATIBLE_FRAME_DURATION_MS is used.
+
 	Mutex buffer_mutex;
 	std::vector<float> callback_buffer;
 
@@ -7,13 +7,13 @@ Copyright Glare Technologies Limited 2022 -
 
 
 #include "AudioEngine.h"
-#include "MP3AudioFileReader.h"
 #include <utils/CircularBuffer.h>
 #include <utils/ConPrint.h>
 #include <utils/StringUtils.h>
 #include <utils/PlatformUtils.h>
 #include <utils/MemMappedFile.h>
 #include <utils/FileInStream.h>
+#include <limits>
 
 
 namespace glare
@@ -28,83 +28,72 @@ void StreamerThread::doRun()
 {
 	PlatformUtils::setCurrentThreadNameIfTestsEnabled("Audio StreamerThread");
 
+	std::vector<AudioStreamRef> streams;
+
 	while(die == 0)
 	{
+		// Take a copy of the list of streams, so we don't hold AudioEngine::mutex while decoding.
 		{
 			Lock lock(audio_engine->mutex);
 
-			for(auto it = audio_engine->sources_playing_streams.begin(); it != audio_engine->sources_playing_streams.end(); ++it)
-			{
-				MP3AudioStreamer* streamer = it->first.ptr();
+			streams.clear();
+			for(auto it = audio_engine->streams.begin(); it != audio_engine->streams.end(); ++it)
+				streams.push_back(it->second);
+		} // End lock scope
 
-				const std::set<AudioSourceRef>& sources_playing_stream = it->second;
+		for(size_t z=0; z<streams.size(); ++z)
+		{
+			AudioStream* stream = streams[z].ptr();
 
-				if(!sources_playing_stream.empty())
-				{
-					// Get the smallest buffer size over all sources playing this stream.
-					size_t min_src_buffer_size = std::numeric_limits<size_t>::max();
-					for(auto src_it = sources_playing_stream.begin(); src_it != sources_playing_stream.end(); ++src_it)
-						min_src_buffer_size = myMin(min_src_buffer_size, (*src_it)->buffer.size());
-
-
-					/*
-					Each mp3 frame should supply us with 1152 sample-frames.
-					If we read up to 4 frames at a time, then that should be sufficient to fill up the 4096 sized buffer.
-					*/
-					const int max_num_iters = 4;
-					int iter = 0;
-					while(min_src_buffer_size < 4096) // 4096 samples / 44100 samples/s  = 0.092 s = 92 ms of audio, which should be sufficient to avoid stuttering due to buffer underflows.
-					{
-						int num_channels, sample_freq_hz;
-						const bool is_EOF = streamer->decodeFrame(/*samples out=*/samples, num_channels, sample_freq_hz);
+			Lock stream_lock(stream->mutex);
 
-						// Convert samples to mono_samples.
-						if(num_channels == 1)
-						{
-							mono_samples = samples;
-						}
-						else if(num_channels == 2)
-						{
-							const size_t num_frames = samples.size() / 2;
-							if(samples.size() == num_frames * 2)
-							{
-								mono_samples.resizeNoCopy(num_frames);
-								for(size_t i=0; i<num_frames; ++i)
-									mono_samples[i] = (samples[i*2 + 0] + samples[i*2 + 1]) * 0.5f;
-							}
-						}
-						else
-							mono_samples.resize(0);
+			const std::vector<AudioSourceRef>& sources_playing_stream = stream->sources;
+			if(sources_playing_stream.empty())
+				continue;
 
-						if(is_EOF)
-							streamer->seekToBeginningOfFile();
+			// Get the smallest buffer size over all sources playing this stream.
+			size_t min_src_buffer_size = std::numeric_limits<size_t>::max();
+			for(size_t i=0; i<sources_playing_stream.size(); ++i)
+			{
+				Lock source_lock(sources_playing_stream[i]->source_mutex);
+				min_src_buffer_size = myMin(min_src_buffer_size, sources_playing_stream[i]->buffer.size());
+			}
 
-						// If the source file is not a valid mp3 file, then we won't get samples from it.  Avoid looping forever in that case.
-						iter++;
-						if(iter > max_num_iters)
-							break;
+			/*
+			Each mp3 frame should supply us with 1152 sample-frames.
+			If we read up to 4 blocks at a time, then that should be sufficient to fill up the 4096 sized buffer.
+			If the source file is not a valid audio file, then we won't get samples from it.  Limiting the number of blocks read avoids looping forever in that case.
+			*/
+			const int max_num_iters = 4;
+			for(int iter=0; (iter < max_num_iters) && (min_src_buffer_size < 4096); ++iter) // 4096 samples / 44100 samples/s  = 0.092 s = 92 ms of audio, which should be sufficient to avoid stuttering due to buffer underflows.
+			{
+				int sample_freq_hz;
+				const bool is_EOF = stream->decoder->decodeMonoBlock(/*mono samples out=*/mono_samples, sample_freq_hz);
+				if(is_EOF)
+					stream->decoder->seekToBeginningOfFile();
 
-						// Pass the mono_samples onto the audio sources playing this stream.
-						for(auto src_it = sources_playing_stream.begin(); src_it != sources_playing_stream.end(); ++src_it)
+				// Pass the decoded block onto all the audio sources playing this stream.
+				for(size_t i=0; i<sources_playing_stream.size(); ++i)
+				{
+					AudioSource* source = sources_playing_stream[i].ptr();
+					Lock source_lock(source->source_mutex);
+					source->buffer.pushBackNItems(mono_samples.data(), mono_samples.size());
+					if(sample_freq_hz != 0)
+					{
+						// If we have read a sample rate from the file and it differs from the default, re-init the resampler.
+						if(source->sampling_rate != sample_freq_hz)
 						{
-							AudioSource* source = src_it->ptr();
-							source->buffer.pushBackNItems(mono_samples.data(), mono_samples.size());
-							if(sample_freq_hz != 0)
-							{
-								// If we have read a sample rate from the mp3 file and it differs from the default, re-init the resampler.
-								if(source->sampling_rate != sample_freq_hz)
-								{
-									source->sampling_rate = sample_freq_hz;
-									source->resampler.init(/*src rate=*/sample_freq_hz, /*dest rate*/audio_engine->getSampleRate());
-								}
-							}
+							source->sampling_rate = sample_freq_hz;
+							source->resampler.init(/*src rate=*/sample_freq_hz, /*dest rate*/audio_engine->getSampleRate());
 						}
-
-						min_src_buffer_size += mono_samples.size();
 					}
 				}
+
+				min_src_buffer_size += mono_samples.size();
 			}
-		} // End lock scope
+		}
+
+		streams.clear(); // Release references to streams, so removed streams can be freed.
 		
 		PlatformUtils::Sleep(2);
 	}
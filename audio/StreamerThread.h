@@ -21,7 +21,7 @@ class AudioEngine;
 /*=====================================================================
 StreamerThread
 --------------
-Streams data from mp3 decoders to AudioSource buffers.
+Decodes blocks from AudioEngine streams into the buffers of the AudioSources playing them.
 =====================================================================*/
 class StreamerThread : public MessageableThread
 {
@@ -37,7 +37,6 @@ public:
 	glare::AtomicInt die;
 
 	// Temp buffers
-	js::Vector<float, 16> samples;
 	js::Vector<float, 16> mono_samples;
 };
 
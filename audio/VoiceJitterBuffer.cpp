@@ -0,0 +1,421 @@
+/*=====================================================================
+VoiceJitterBuffer.cpp
+---------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#include "VoiceJitterBuffer.h"
+
+
+#include <maths/mathstypes.h>
+#include <cmath>
+
+
+namespace glare
+{
+
+
+static const double MIN_TARGET_DELAY = 0.02; // seconds
+static const double MAX_TARGET_DELAY = 0.2; // seconds
+
+
+const double VoiceJitterBuffer::MAX_PACKET_AGE = 0.5; // seconds.  Should be comfortably larger than MAX_TARGET_DELAY.
+
+
+VoiceJitterBuffer::VoiceJitterBuffer()
+{
+	reset();
+}
+
+
+void VoiceJitterBuffer::reset()
+{
+	for(int i=0; i<NUM_SLOTS; ++i)
+		slots[i].valid = false;
+
+	started = false;
+	next_seq_num = 0;
+	newest_seq_num = 0;
+	lost_end_seq_num = 0;
+	had_prev_packet = false;
+	prev_transit = 0;
+	jitter = 0;
+	frame_duration = 0.01;
+	target_delay = MIN_TARGET_DELAY;
+	next_is_discontinuity = true;
+
+	num_packets_received = 0;
+	num_late_packets = 0;
+	num_reordered_packets = 0;
+	num_fec_frames = 0;
+	num_concealed_frames = 0;
+	num_old_packets_dropped = 0;
+}
+
+
+void VoiceJitterBuffer::insertPacket(uint32 seq_num, const uint8* data, size_t data_size, double frame_duration_, double arrival_time)
+{
+	num_packets_received++;
+	frame_duration = frame_duration_;
+
+	// Update jitter estimate, see RFC 3550 section 6.4.1.  The send time of the packet is seq_num * frame_duration, as sequence numbers are incremented for every frame, even if not sent.
+	const double transit = arrival_time - (double)seq_num * frame_duration;
+	if(had_prev_packet)
+		jitter += (std::fabs(transit - prev_transit) - jitter) * (1.0 / 16);
+	prev_transit = transit;
+	had_prev_packet = true;
+
+	target_delay = myClamp(frame_duration + 3 * jitter, MIN_TARGET_DELAY, MAX_TARGET_DELAY);
+
+	if(!started)
+	{
+		started = true;
+		next_seq_num = seq_num;
+		newest_seq_num = seq_num;
+		lost_end_seq_num = seq_num;
+		next_is_discontinuity = true;
+	}
+	else
+	{
+		const int32 offset = (int32)(seq_num - next_seq_num); // Handle sequence number wraparound.
+		if(offset <= -NUM_SLOTS || offset >= NUM_SLOTS) // If sequence number is way out of the window, the sender has probably restarted, so resync.
+		{
+			for(int i=0; i<NUM_SLOTS; ++i)
+				slots[i].valid = false;
+			next_seq_num = seq_num;
+			newest_seq_num = seq_num;
+			lost_end_seq_num = seq_num;
+			next_is_discontinuity = true;
+		}
+		else if(offset < 0) // If we have already played out or concealed this frame:
+		{
+			num_late_packets++;
+			return;
+		}
+
+		if((int32)(seq_num - newest_seq_num) < 0)
+			num_reordered_packets++;
+		else
+			newest_seq_num = seq_num;
+	}
+
+	Slot& slot = slots[seq_num % NUM_SLOTS];
+	if(slot.valid && slot.seq_num == seq_num) // Ignore duplicate packets
+		return;
+
+	slot.valid = true;
+	slot.seq_num = seq_num;
+	slot.arrival_time = arrival_time;
+	slot.data.assign(data, data + data_size);
+}
+
+
+bool VoiceJitterBuffer::getEarliestBufferedPacketAfterNext(uint32& earliest_seq_num_out) const
+{
+	const int32 newest_offset = (int32)(newest_seq_num - next_seq_num);
+	for(int32 i=1; i<=myMin(newest_offset, NUM_SLOTS - 1); ++i)
+	{
+		const uint32 seq_num = next_seq_num + (uint32)i;
+		const Slot& slot = slots[seq_num % NUM_SLOTS];
+		if(slot.valid && slot.seq_num == seq_num)
+		{
+			earliest_seq_num_out = seq_num;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+bool VoiceJitterBuffer::hasBufferedPackets() const
+{
+	if(!started)
+		return false;
+
+	const int32 newest_offset = (int32)(newest_seq_num - next_seq_num);
+	for(int32 i=0; i<=myMin(newest_offset, NUM_SLOTS - 1); ++i)
+	{
+		const uint32 seq_num = next_seq_num + (uint32)i;
+		const Slot& slot = slots[seq_num % NUM_SLOTS];
+		if(slot.valid && slot.seq_num == seq_num)
+			return true;
+	}
+	return false;
+}
+
+
+bool VoiceJitterBuffer::popFrame(double cur_time, Frame& frame_out)
+{
+	if(!started)
+		return false;
+
+	while(1)
+	{
+		Slot& slot = slots[next_seq_num % NUM_SLOTS];
+		if(slot.valid && slot.seq_num == next_seq_num) // If we have the packet for the next frame:
+		{
+			if(cur_time - slot.arrival_time > MAX_PACKET_AGE) // If the packet has been buffered for too long (e.g. popFrame() wasn't called for a while), drop it instead of playing it out late.
+			{
+				slot.valid = false;
+				num_old_packets_dropped++;
+				next_is_discontinuity = true;
+				next_seq_num++;
+				continue;
+			}
+
+			popped_data.swap(slot.data); // Swap instead of copy, so buffers get reused.
+			slot.valid = false;
+
+			frame_out.type = FrameType_Packet;
+			frame_out.seq_num = next_seq_num;
+			frame_out.data = popped_data.data();
+			frame_out.data_size = popped_data.size();
+			frame_out.discontinuity = next_is_discontinuity;
+			next_is_discontinuity = false;
+			next_seq_num++;
+			return true;
+		}
+
+		uint32 earliest_seq_num;
+		if(!getEarliestBufferedPacketAfterNext(earliest_seq_num)) // If nothing later is buffered, we are either waiting for the next packet, or in silence.
+			return false;
+
+		const uint32 gap = earliest_seq_num - next_seq_num;
+		if(gap > (uint32)MAX_CONCEAL_FRAMES)
+		{
+			// Long gap: assume the sender was in DTX silence, and skip to the next packet.
+			next_seq_num = earliest_seq_num;
+			next_is_discontinuity = true;
+			continue;
+		}
+
+		// Short gap: the packet for the next frame may just be late.  Wait until enough later audio has been received, or the earliest later packet has been waiting long enough.
+		const double buffered_duration = (double)(int32)(newest_seq_num - next_seq_num) * frame_duration;
+		const Slot& earliest_slot = slots[earliest_seq_num % NUM_SLOTS];
+		const bool gap_declared_lost = (int32)(lost_end_seq_num - next_seq_num) > 0; // Once we have started concealing a gap, conceal the rest of it without waiting.
+		if(!gap_declared_lost && buffered_duration <= target_delay && (cur_time - earliest_slot.arrival_time) < target_delay)
+			return false;
+
+		// Treat the packet as lost.
+		lost_end_seq_num = earliest_seq_num;
+		frame_out.seq_num = next_seq_num;
+		frame_out.discontinuity = false;
+		if(gap == 1) // If the next packet received is the one right after the lost packet, it may contain FEC data for the lost packet.
+		{
+			frame_out.type = FrameType_FEC;
+			frame_out.data = earliest_slot.data.data();
+			frame_out.data_size = earliest_slot.data.size();
+			num_fec_frames++;
+		}
+		else
+		{
+			frame_out.type = FrameType_Conceal;
+			frame_out.data = NULL;
+			frame_out.data_size = 0;
+			num_concealed_frames++;
+		}
+		next_seq_num++;
+		return true;
+	}
+}
+
+
+} // end namespace glare
+
+
+#if BUILD_TESTS
+
+
+#include <utils/TestUtils.h>
+#include <utils/ConPrint.h>
+
+
+static void insertTestPacket(glare::VoiceJitterBuffer& buffer, uint32 seq_num, double arrival_time)
+{
+	const uint8 data[2] = { (uint8)seq_num, 123 };
+	buffer.insertPacket(seq_num, data, sizeof(data), /*frame duration=*/0.02, arrival_time);
+}
+
+
+static void testPopFrame(glare::VoiceJitterBuffer& buffer, double cur_time, glare::VoiceJitterBuffer::FrameType expected_type, uint32 expected_seq_num, bool expected_discontinuity = false)
+{
+	glare::VoiceJitterBuffer::Frame frame;
+	testAssert(buffer.popFrame(cur_time, frame));
+	testAssert(frame.type == expected_type);
+	testAssert(frame.seq_num == expected_seq_num);
+	testAssert(frame.discontinuity == expected_discontinuity);
+	if(expected_type == glare::VoiceJitterBuffer::FrameType_Packet)
+	{
+		testAssert(frame.data_size == 2 && frame.data[0] == (uint8)expected_seq_num);
+	}
+	else if(expected_type == glare::VoiceJitterBuffer::FrameType_FEC)
+	{
+		testAssert(frame.data_size == 2 && frame.data[0] != (uint8)expected_seq_num);
+	}
+	else
+	{
+		testAssert(frame.data == NULL);
+	}
+}
+
+
+static bool canPopFrame(glare::VoiceJitterBuffer& buffer, double cur_time)
+{
+	glare::VoiceJitterBuffer::Frame frame;
+	return buffer.popFrame(cur_time, frame);
+}
+
+
+void glare::VoiceJitterBuffer::test()
+{
+	conPrint("VoiceJitterBuffer::test()");
+
+	// Test in-order packets
+	{
+		VoiceJitterBuffer buffer;
+		testAssert(!canPopFrame(buffer, 0.0));
+		for(uint32 i=0; i<10; ++i)
+		{
+			insertTestPacket(buffer, i, i * 0.02);
+			testPopFrame(buffer, i * 0.02, FrameType_Packet, i, /*expected_discontinuity=*/i == 0);
+			testAssert(!canPopFrame(buffer, i * 0.02));
+		}
+		testAssert(buffer.num_late_packets == 0 && buffer.num_reordered_packets == 0);
+		testAssert(buffer.getJitter() < 1.0e-9);
+	}
+
+	// Test sequence number wraparound
+	{
+		VoiceJitterBuffer buffer;
+		const uint32 start = 0xFFFFFFFEu;
+		for(uint32 i=0; i<4; ++i)
+		{
+			insertTestPacket(buffer, start + i, i * 0.02);
+			testPopFrame(buffer, i * 0.02, FrameType_Packet, start + i, /*expected_discontinuity=*/i == 0);
+		}
+	}
+
+	// Test reordered packets are played out in order
+	{
+		VoiceJitterBuffer buffer;
+		insertTestPacket(buffer, 0, 0.0);
+		testPopFrame(buffer, 0.0, FrameType_Packet, 0, /*expected_discontinuity=*/true);
+		insertTestPacket(buffer, 2, 0.04);
+		testAssert(!canPopFrame(buffer, 0.04)); // Should wait for packet 1
+		insertTestPacket(buffer, 1, 0.045);
+		testPopFrame(buffer, 0.045, FrameType_Packet, 1);
+		testPopFrame(buffer, 0.045, FrameType_Packet, 2);
+		testAssert(!canPopFrame(buffer, 0.045));
+		testAssert(buffer.num_reordered_packets == 1);
+		testAssert(buffer.num_late_packets == 0);
+	}
+
+	// Test a lost packet is recovered with FEC from the next packet, once enough later packets have arrived, and that the lost packet is dropped if it turns up later.
+	{
+		VoiceJitterBuffer buffer;
+		insertTestPacket(buffer, 0, 0.0);
+		testPopFrame(buffer, 0.0, FrameType_Packet, 0, /*expected_discontinuity=*/true);
+		insertTestPacket(buffer, 2, 0.04);
+		insertTestPacket(buffer, 3, 0.06);
+		insertTestPacket(buffer, 4, 0.08);
+		testPopFrame(buffer, 0.08, FrameType_FEC, 1);
+		testPopFrame(buffer, 0.08, FrameType_Packet, 2);
+		testPopFrame(buffer, 0.08, FrameType_Packet, 3);
+		testPopFrame(buffer, 0.08, FrameType_Packet, 4);
+
+		insertTestPacket(buffer, 1, 0.1);
+		testAssert(buffer.num_late_packets == 1);
+		testAssert(!canPopFrame(buffer, 0.1));
+		testAssert(buffer.num_fec_frames == 1);
+	}
+
+	// Test a lost packet is treated as lost once the later packet has been waiting for the target delay, and that multiple lost packets are concealed.
+	{
+		VoiceJitterBuffer buffer;
+		insertTestPacket(buffer, 0, 0.0);
+		testPopFrame(buffer, 0.0, FrameType_Packet, 0, /*expected_discontinuity=*/true);
+		insertTestPacket(buffer, 2, 0.04);
+		testAssert(!canPopFrame(buffer, 0.04));
+		testPopFrame(buffer, 0.041 + buffer.getTargetDelay(), FrameType_FEC, 1);
+		testPopFrame(buffer, 0.041 + buffer.getTargetDelay(), FrameType_Packet, 2);
+
+		insertTestPacket(buffer, 5, 0.1);
+		testPopFrame(buffer, 0.1, FrameType_Conceal, 3);
+		testPopFrame(buffer, 0.1, FrameType_FEC, 4);
+		testPopFrame(buffer, 0.1, FrameType_Packet, 5);
+		testAssert(buffer.num_concealed_frames == 1 && buffer.num_fec_frames == 2);
+	}
+
+
+	// Test a talkspurt that ends just after a lost packet: no more packets arrive, so the lost packet must be recovered based on time alone, and the last packet played out.
+	{
+		VoiceJitterBuffer buffer;
+		insertTestPacket(buffer, 0, 0.0);
+		insertTestPacket(buffer, 1, 0.02);
+		testPopFrame(buffer, 0.02, FrameType_Packet, 0, /*expected_discontinuity=*/true);
+		testPopFrame(buffer, 0.02, FrameType_Packet, 1);
+		testAssert(!buffer.hasBufferedPackets());
+
+		insertTestPacket(buffer, 3, 0.06); // Packet 2 is lost, packet 3 is the last packet of the talkspurt.
+		testAssert(!canPopFrame(buffer, 0.06));
+		testAssert(buffer.hasBufferedPackets()); // Caller should keep calling popFrame().
+
+		const double later_time = 0.061 + buffer.getTargetDelay();
+		testPopFrame(buffer, later_time, FrameType_FEC, 2);
+		testPopFrame(buffer, later_time, FrameType_Packet, 3);
+		testAssert(!canPopFrame(buffer, later_time));
+		testAssert(!buffer.hasBufferedPackets());
+	}
+
+	// Test packets buffered for longer than MAX_PACKET_AGE are dropped
+	{
+		VoiceJitterBuffer buffer;
+		for(uint32 i=0; i<5; ++i)
+			insertTestPacket(buffer, i, i * 0.02);
+		testAssert(!canPopFrame(buffer, 0.1 + MAX_PACKET_AGE));
+		testAssert(buffer.num_old_packets_dropped == 5);
+		testAssert(!buffer.hasBufferedPackets());
+
+		insertTestPacket(buffer, 5, 0.1 + MAX_PACKET_AGE);
+		testPopFrame(buffer, 0.1 + MAX_PACKET_AGE, FrameType_Packet, 5, /*expected_discontinuity=*/true);
+	}
+
+
+	// Test a long gap (DTX silence) is skipped over without concealment
+	{
+		VoiceJitterBuffer buffer;
+		insertTestPacket(buffer, 0, 0.0);
+		testPopFrame(buffer, 0.0, FrameType_Packet, 0, /*expected_discontinuity=*/true);
+		insertTestPacket(buffer, 20, 0.4);
+		testPopFrame(buffer, 0.4, FrameType_Packet, 20, /*expected_discontinuity=*/true);
+		testAssert(buffer.num_concealed_frames == 0 && buffer.num_fec_frames == 0);
+	}
+
+	// Test resync when the sequence number jumps a long way
+	{
+		VoiceJitterBuffer buffer;
+		insertTestPacket(buffer, 1000, 0.0);
+		testPopFrame(buffer, 0.0, FrameType_Packet, 1000, /*expected_discontinuity=*/true);
+		insertTestPacket(buffer, 5, 0.02);
+		testPopFrame(buffer, 0.02, FrameType_Packet, 5, /*expected_discontinuity=*/true);
+	}
+
+	// Test target delay adapts to jitter
+	{
+		VoiceJitterBuffer buffer;
+		for(uint32 i=0; i<100; ++i)
+			insertTestPacket(buffer, i, i * 0.02);
+		const double steady_target_delay = buffer.getTargetDelay();
+		testAssert(steady_target_delay < 0.021);
+
+		for(uint32 i=100; i<200; ++i)
+			insertTestPacket(buffer, i, i * 0.02 + ((i % 2 == 0) ? 0.03 : 0.0));
+		testAssert(buffer.getJitter() > 0.01);
+		testAssert(buffer.getTargetDelay() > steady_target_delay + 0.03);
+		testAssert(buffer.getTargetDelay() <= 0.2);
+	}
+
+	conPrint("VoiceJitterBuffer::test() done.");
+}
+
+
+#endif // BUILD_TESTS
@@ -0,0 +1,124 @@
+/*=====================================================================
+VoiceJitterBuffer.h
+-------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#pragma once
+
+
+#include <utils/Platform.h>
+#include <vector>
+
+
+namespace glare
+{
+
+
+/*=====================================================================
+VoiceJitterBuffer
+-----------------
+Reorders received voice packets for a single stream, and decides when
+missing packets should be concealed.
+
+Packets are identified by sequence number, one per encoded frame.
+The sender doesn't send packets for silent frames (Opus DTX), but still
+increments the sequence number, so a gap may be either lost packets or silence.
+Short gaps (<= MAX_CONCEAL_FRAMES) are treated as loss, and are concealed
+(with FEC data from the following packet if available, or with PLC), but only once
+enough later packets have arrived that the missing packet is unlikely to be just late.
+Longer gaps are treated as silence, and playout skips to the next received packet.
+
+The target delay adapts to the measured packet arrival jitter (as in RFC 3550),
+and is used by the caller to size the playout buffer.
+
+Decisions to conceal depend on the current time, not just on packet arrivals, so while
+hasBufferedPackets() returns true the caller should keep calling popFrame() periodically,
+even if no more packets arrive (e.g. when a talkspurt ends just after a lost packet).
+Packets that have been buffered for longer than MAX_PACKET_AGE are dropped instead of
+being played out late.
+
+Doesn't depend on the codec: popFrame() returns what the caller should decode.
+Not threadsafe.
+=====================================================================*/
+class VoiceJitterBuffer
+{
+public:
+	VoiceJitterBuffer();
+
+	static const int NUM_SLOTS = 64; // Max number of packets buffered.  Must be a power of 2.
+	static const int MAX_CONCEAL_FRAMES = 3; // Gaps longer than this are assumed to be DTX silence instead of loss.
+	static const double MAX_PACKET_AGE; // Buffered packets older than this (in seconds) are dropped in popFrame().
+
+	void reset();
+
+	// frame_duration is the duration of the packet's frame in seconds.  arrival_time is in seconds, from any fixed origin.
+	void insertPacket(uint32 seq_num, const uint8* data, size_t data_size, double frame_duration, double arrival_time);
+
+	enum FrameType
+	{
+		FrameType_Packet, // Decode the packet data.
+		FrameType_FEC, // The packet for this frame was lost: decode the FEC data in the packet data (which is the packet for the next frame).
+		FrameType_Conceal // The packet for this frame was lost, and there is no FEC data for it: do packet loss concealment.
+	};
+
+	struct Frame
+	{
+		FrameType type;
+		uint32 seq_num;
+		const uint8* data; // Valid until the next call to insertPacket() or popFrame().  NULL for FrameType_Conceal.
+		size_t data_size;
+		bool discontinuity; // True if this is the first frame after a gap treated as silence.
+	};
+
+	// Returns true if there is a frame ready to be played out, in which case frame_out is set.
+	// Call repeatedly until it returns false.
+	bool popFrame(double cur_time, Frame& frame_out);
+
+	// Returns true if there are buffered packets that have not been played out yet.
+	// If so, popFrame() may return frames later, even if no more packets are inserted.
+	bool hasBufferedPackets() const;
+
+	double getTargetDelay() const { return target_delay; } // In seconds
+	double getJitter() const { return jitter; } // In seconds
+
+	static void test();
+
+	uint64 num_packets_received;
+	uint64 num_late_packets; // Number of packets dropped as they arrived after their frame was played out or concealed.
+	uint64 num_reordered_packets;
+	uint64 num_fec_frames;
+	uint64 num_concealed_frames;
+	uint64 num_old_packets_dropped; // Number of packets dropped as they were buffered for longer than MAX_PACKET_AGE.
+
+private:
+	struct Slot
+	{
+		Slot() : valid(false) {}
+
+		bool valid;
+		uint32 seq_num;
+		double arrival_time;
+		std::vector<uint8> data;
+	};
+
+	// Returns true if a packet with sequence number > next_seq_num is buffered, and sets earliest_seq_num_out to the earliest such packet.
+	bool getEarliestBufferedPacketAfterNext(uint32& earliest_seq_num_out) const;
+
+	Slot slots[NUM_SLOTS];
+	std::vector<uint8> popped_data; // Data for the last popped frame.
+
+	bool started;
+	uint32 next_seq_num; // Sequence number of the next frame to be played out.
+	uint32 newest_seq_num; // Highest sequence number received.
+	uint32 lost_end_seq_num; // Frames before this sequence number, in the gap currently being concealed, have been declared lost.
+
+	bool had_prev_packet;
+	double prev_transit;
+	double jitter; // Smoothed mean deviation of packet transit time.
+	double frame_duration;
+	double target_delay;
+	bool next_is_discontinuity;
+};
+
+
+} // end namespace glare
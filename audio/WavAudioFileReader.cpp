@@ -26,6 +26,161 @@ static inline int32 signExtend24BitValue(int32 x)
 }
 
 
+// Parses the RIFF header and format chunk, and finds the data chunk.  Leaves the read index of file at the start of the sample data.
+static void parseWavHeader(BufferViewInStream& file, glare::WavFormat& format_out)
+{
+	const uint32 riff_chunk_id = file.readUInt32();
+	if(riff_chunk_id != 0x46464952) // big endian: 0x52494646
+		throw glare::Exception("invalid header, expected RIFF");
+
+	/*const uint32 riff_chunk_size =*/ file.readUInt32();
+	/*const uint32 riff_chunk_format =*/ file.readUInt32();
+
+	const uint32 fmt_chunk_id = file.readUInt32();
+	if(fmt_chunk_id != 0x20746d66) // big endian: 0x666d7420
+		throw glare::Exception("invalid fmt chunk id, expected fmt");
+	/*const uint32 fmt_chunk_size =*/ file.readUInt32();
+	const uint16 audio_format = file.readUInt16();
+	if(audio_format != 1)
+		throw glare::Exception("Unhandled audio format, only 1 (PCM) handled.");
+	const uint16 wav_num_channels = file.readUInt16();
+	const uint32 sample_rate = file.readUInt32();
+	/*const uint32 byte_rate =*/ file.readUInt32();
+	/*const uint16 block_align =*/ file.readUInt16(); // TODO: handle this?
+	const uint16 bits_per_sample = file.readUInt16();
+
+	const uint32 bytes_per_sample = bits_per_sample / 8;
+
+	// Avoid divide by zeroes
+	if(wav_num_channels == 0)
+		throw glare::Exception("Invalid num channels");
+	if(bytes_per_sample == 0)
+		throw glare::Exception("Invalid bytes per sample");
+
+	if(wav_num_channels > 2)
+		throw glare::Exception("Unsupported num channels: " + toString(wav_num_channels));
+	if(bytes_per_sample < 2 || bytes_per_sample > 4)
+		throw glare::Exception("Unhandled bytes_per_sample: " + toString(bytes_per_sample));
+
+	format_out.num_channels = wav_num_channels;
+	format_out.bytes_per_sample = bytes_per_sample;
+	format_out.sample_rate = sample_rate;
+
+	while(!file.endOfStream())
+	{
+		// Read chunk
+		const uint32 chunk_id = file.readUInt32();
+		const uint32 chunk_size = file.readUInt32();
+
+		if(chunk_id == 0x61746164) // "data", big endian: 0x64617461 
+		{
+			const uint32 num_samples = chunk_size / bytes_per_sample;
+
+			const uint32 MAX_NUM_SAMPLES = 1 << 27; // ~536 MB
+			if(num_samples > MAX_NUM_SAMPLES)
+				throw glare::Exception("too many samples: " + toString(num_samples));
+
+			const size_t expected_remaining = bytes_per_sample * num_samples;
+			if(!file.canReadNBytes(expected_remaining))
+				throw glare::Exception("not enough data in file.");
+
+			format_out.data_offset = file.getReadIndex();
+			format_out.num_frames = num_samples / wav_num_channels;
+			return;
+		}
+		else
+		{
+			// Unknown chunk, skip it
+			file.advanceReadIndex(chunk_size);
+		}
+	}
+
+	throw glare::Exception("Didn't find data chunk");
+}
+
+
+// Converts num_frames frames of sample data, starting at src, to mono float samples.
+static void convertWavSamplesToMono(const glare::WavFormat& format, const uint8* src, size_t num_frames, float* dest)
+{
+	if(format.bytes_per_sample == 2)
+	{
+		if(format.num_channels == 1)
+		{
+			for(size_t i=0; i<num_frames; ++i)
+			{
+				int16 val;
+				std::memcpy(&val, &src[i * 2], 2);
+				dest[i] = val * (1.f / 32768);
+			}
+		}
+		else
+		{
+			// Mix down to mono
+			for(size_t i=0; i<num_frames; ++i)
+			{
+				int16 left, right;
+				std::memcpy(&left,  &src[i * 4 + 0], 2);
+				std::memcpy(&right, &src[i * 4 + 2], 2);
+				// val = (left/32768.f + right/32768)*0.5 = ((left + right)/32768)*0.5 = left + right)/65536
+				dest[i] = ((int32)left + (int32)right) * (1.f / 65536);
+			}
+		}
+	}
+	else if(format.bytes_per_sample == 3)
+	{
+		if(format.num_channels == 1)
+		{
+			for(size_t i=0; i<num_frames; ++i)
+			{
+				int32 val = 0;
+				std::memcpy(&val, &src[i * 3], 3);
+				val = signExtend24BitValue(val);
+				assert(val >= -8388608 && val < 8388608);
+				dest[i] = val * (1.f / 8388608);
+			}
+		}
+		else
+		{
+			// Mix down to mono
+			for(size_t i=0; i<num_frames; ++i)
+			{
+				// NOTE: a much faster way to do this would be to handle blocks of 4 3-byte values, and use bitwise ops on them.
+				int32 left = 0;
+				int32 right = 0;
+				std::memcpy(&left, &src[i * 3 * 2 + 0], 3);
+				std::memcpy(&right, &src[i * 3 * 2 + 3], 3);
+				dest[i] = (signExtend24BitValue(left) + signExtend24BitValue(right)) * (1.f / 16777216); // values seem to be in [0, 16777216), so map to [-8388608, 8388607)
+			}
+		}
+	}
+	else
+	{
+		assert(format.bytes_per_sample == 4);
+		if(format.num_channels == 1)
+		{
+			for(size_t i=0; i<num_frames; ++i)
+			{
+				int32 val;
+				std::memcpy(&val, &src[i * 4], 4);
+				dest[i] = val * (1.f / 2147483648.f);
+			}
+		}
+		else
+		{
+			// Mix down to mono
+			for(size_t i=0; i<num_frames; ++i)
+			{
+				int32 left, right;
+				std::memcpy(&left,  &src[i * 8 + 0], 4);
+				std::memcpy(&right, &src[i * 8 + 4], 4);
+				// val = (left/2147483648.f + right/2147483648)*0.5 = ((left + right)/2147483648)*0.5 = left + right)/4294967296
+				dest[i] = ((float)left + (float)right) * (1.f / 4294967296.f);
+			}
+		}
+	}
+}
+
+
 glare::SoundFileRef glare::WavAudioFileReader::readAudioFile(const std::string& sound_file_path)
 {
 	FileInStream file(sound_file_path);
@@ -40,157 +195,18 @@ glare::SoundFileRef glare::WavAudioFileReader::readAudioFileFromBuffer(const uin
 	{
 		BufferViewInStream file(ArrayRef<uint8>(data, len));
 
-		SoundFileRef sound = new SoundFile();
+		WavFormat format;
+		parseWavHeader(file, format);
 
-		const uint32 riff_chunk_id = file.readUInt32();
-		if(riff_chunk_id != 0x46464952) // big endian: 0x52494646
-			throw glare::Exception("invalid header, expected RIFF");
-
-		/*const uint32 riff_chunk_size =*/ file.readUInt32();
-		/*const uint32 riff_chunk_format =*/ file.readUInt32();
-
-		const uint32 fmt_chunk_id = file.readUInt32();
-		if(fmt_chunk_id != 0x20746d66) // big endian: 0x666d7420
-			throw glare::Exception("invalid fmt chunk id, expected fmt");
-		/*const uint32 fmt_chunk_size =*/ file.readUInt32();
-		const uint16 audio_format = file.readUInt16();
-		if(audio_format != 1)
-			throw glare::Exception("Unhandled audio format, only 1 (PCM) handled.");
-		const uint16 wav_num_channels = file.readUInt16();
-		const uint32 sample_rate = file.readUInt32(); // TODO: handle this by resampling to target rate.
-		/*const uint32 byte_rate =*/ file.readUInt32();
-		/*const uint16 block_align =*/ file.readUInt16(); // TODO: handle this?
-		const uint16 bits_per_sample = file.readUInt16();
+		if(format.num_frames == 0)
+			throw glare::Exception("Didn't find data chunk");
 
+		SoundFileRef sound = new SoundFile();
 		sound->num_channels = 1; // mix down to mono
-		sound->sample_rate = sample_rate;
-		sound->buf = new AudioBuffer();
-
-		while(!file.endOfStream())
-		{
-			// Read chunk
-			const uint32 chunk_id = file.readUInt32();
-			const uint32 chunk_size = file.readUInt32();
-
-			if(chunk_id == 0x61746164) // "data", big endian: 0x64617461 
-			{
-				const uint32 bytes_per_sample = bits_per_sample / 8;
-
-				// Avoid divide by zeroes
-				if(wav_num_channels == 0)
-					throw glare::Exception("Invalid num channels");
-				if(bytes_per_sample == 0)
-					throw glare::Exception("Invalid bytes per sample");
-
-				if(wav_num_channels > 2)
-					throw glare::Exception("Unsupported num channels: " + toString(wav_num_channels));
-
-				// Read actual data, convert to mono float.
-				const uint32 num_samples = chunk_size / bytes_per_sample;
-
-				const uint32 MAX_NUM_SAMPLES = 1 << 27; // ~536 MB
-				if(num_samples > MAX_NUM_SAMPLES)
-					throw glare::Exception("too many samples: " + toString(num_samples));
-
-				//const uint32 num_samples = num_samples / wav_num_channels;
-				sound->buf->buffer.resize(num_samples / wav_num_channels); // TEMP: mix down to mono
-
-				const size_t expected_remaining = bytes_per_sample * num_samples;
-				if(!file.canReadNBytes(expected_remaining))
-					throw glare::Exception("not enough data in file.");
-
-				if(bytes_per_sample == 2)
-				{
-					if(wav_num_channels == 1)
-					{
-						std::vector<int16> temp(num_samples);
-						file.readData(temp.data(), num_samples * bytes_per_sample);
-
-						for(uint32 i=0; i<num_samples / wav_num_channels; ++i)
-							sound->buf->buffer[i] = temp[i] * (1.f / 32768);
-					}
-					else if(wav_num_channels == 2)
-					{
-						// Mix down to mono
-						std::vector<int16> temp(num_samples);
-						file.readData(temp.data(), num_samples * bytes_per_sample);
-
-						for(uint32 i=0; i<num_samples / wav_num_channels; ++i)
-						{
-							// val = (left/32768.f + right/32768)*0.5 = ((left + right)/32768)*0.5 = left + right)/65536
-							sound->buf->buffer[i] = ((int32)temp[i * 2 + 0] + (int32)temp[i * 2 + 1])  * (1.f / 65536);
-						}
-					}
-				}
-				else if(bytes_per_sample == 3)
-				{
-					if(wav_num_channels == 1)
-					{
-						runtimeCheck(file.canReadNBytes(num_samples * 3));
-						const uint8* src = (const uint8*)file.currentReadPtr();
-						for(uint32 i=0; i<num_samples; ++i)
-						{
-							int32 val = 0;
-							std::memcpy(&val, &src[i * 3], 3);
-							val = signExtend24BitValue(val);
-							assert(val >= -8388608 && val < 8388608);
-							sound->buf->buffer[i] = val * (1.f / 8388608);
-						}
-						file.advanceReadIndex(expected_remaining);
-					}
-					else if(wav_num_channels == 2)
-					{
-						// Mix down to mono
-						runtimeCheck(file.canReadNBytes(num_samples * 3));
-						const uint8* src = (const uint8*)file.currentReadPtr();
-						for(uint32 i=0; i<num_samples / wav_num_channels; ++i)
-						{
-							// NOTE: a much faster way to do this would be to handle blocks of 4 3-byte values, and use bitwise ops on them.
-							int32 left = 0;
-							int32 right = 0;
-							std::memcpy(&left, &src[i * 3 * 2 + 0], 3);
-							std::memcpy(&right, &src[i * 3 * 2 + 3], 3);
-							//sound->buf[i] = ((left + right) - 16777216) * (1.f / 16777216); // values seem to be in [0, 16777216), so map to [-8388608, 8388607)
-							sound->buf->buffer[i] = (signExtend24BitValue(left) + signExtend24BitValue(right)) * (1.f / 16777216); // values seem to be in [0, 16777216), so map to [-8388608, 8388607)
-						}
-						file.advanceReadIndex(expected_remaining);
-					}
-				}
-				else if(bytes_per_sample == 4)
-				{
-					if(wav_num_channels == 1)
-					{
-						std::vector<int32> temp(num_samples);
-						file.readData(temp.data(), num_samples * bytes_per_sample);
-
-						for(uint32 i=0; i<num_samples; ++i)
-							sound->buf->buffer[i] = temp[i] * (1.f / 2147483648.f);
-					}
-					else if(wav_num_channels == 2)
-					{
-						// Mix down to mono
-						std::vector<int32> temp(num_samples);
-						file.readData(temp.data(), num_samples * bytes_per_sample);
-
-						for(uint32 i=0; i<num_samples / wav_num_channels; ++i)
-						{
-							// val = (left/2147483648.f + right/2147483648)*0.5 = ((left + right)/2147483648)*0.5 = left + right)/4294967296
-							sound->buf->buffer[i] = ((int32)temp[i * 2 + 0] + (int32)temp[i * 2 + 1])  * (1.f / 4294967296.f);
-						}
-					}
-				}
-				else
-					throw glare::Exception("Unhandled bytes_per_sample: " + toString(bytes_per_sample));
-			}
-			else
-			{
-				// Unknown chunk, skip it
-				file.advanceReadIndex(chunk_size);
-			}
-		}
+		sound->sample_rate = format.sample_rate;
+		sound->buf->buffer.resize(format.num_frames);
 
-		if(sound->buf->buffer.empty())
-			throw glare::Exception("Didn't find data chunk");
+		convertWavSamplesToMono(format, data + format.data_offset, format.num_frames, sound->buf->buffer.data());
 
 		return sound;
 	}
@@ -201,6 +217,46 @@ glare::SoundFileRef glare::WavAudioFileReader::readAudioFileFromBuffer(const uin
 }
 
 
+glare::WavAudioStreamer::WavAudioStreamer(const std::string& path)
+:	mem_mapped_file(path),
+	next_frame_i(0)
+{
+	BufferViewInStream file(ArrayRef<uint8>((const uint8*)mem_mapped_file.fileData(), mem_mapped_file.fileSize()));
+	parseWavHeader(file, format);
+}
+
+
+glare::WavAudioStreamer::~WavAudioStreamer()
+{}
+
+
+bool glare::WavAudioStreamer::decodeMonoBlock(js::Vector<float, 16>& mono_samples_out, int& sample_freq_hz_out)
+{
+	const size_t num_frames = myMin(format.num_frames - next_frame_i, (size_t)BLOCK_NUM_FRAMES);
+
+	const uint8* src = (const uint8*)mem_mapped_file.fileData() + format.data_offset + next_frame_i * format.num_channels * format.bytes_per_sample;
+	mono_samples_out.resizeNoCopy(num_frames);
+	convertWavSamplesToMono(format, src, num_frames, mono_samples_out.data());
+
+	next_frame_i += num_frames;
+	sample_freq_hz_out = (num_frames > 0) ? (int)format.sample_rate : 0;
+	return next_frame_i >= format.num_frames;
+}
+
+
+void glare::WavAudioStreamer::seekToBeginningOfFile()
+{
+	next_frame_i = 0;
+}
+
+
+void glare::WavAudioStreamer::seekToApproxTimeWrapped(double time)
+{
+	if(format.num_frames > 0)
+		next_frame_i = (size_t)(myMax(0.0, time) * format.sample_rate) % format.num_frames;
+}
+
+
 #if BUILD_TESTS
 
 
@@ -7,6 +7,8 @@ Copyright Glare Technologies Limited 2022 -
 
 
 #include "AudioFileReader.h"
+#include "AudioStreamDecoder.h"
+#include <utils/MemMappedFile.h>
 
 
 namespace glare
@@ -29,4 +31,44 @@ public:
 };
 
 
+struct WavFormat
+{
+	uint32 num_channels; // 1 or 2
+	uint32 bytes_per_sample; // 2, 3 or 4
+	uint32 sample_rate;
+	size_t data_offset; // Offset of sample data in file.
+	size_t num_frames; // Number of samples per channel.
+};
+
+
+/*=====================================================================
+WavAudioStreamer
+----------------
+Streams a wav file from a memory-mapped file, converting blocks of
+samples to mono float samples.
+=====================================================================*/
+class WavAudioStreamer : public AudioStreamDecoder
+{
+public:
+	// Throws glare::Exception on failure.
+	WavAudioStreamer(const std::string& path);
+	~WavAudioStreamer();
+
+	static const size_t BLOCK_NUM_FRAMES = 2048;
+
+	virtual bool decodeMonoBlock(js::Vector<float, 16>& mono_samples_out, int& sample_freq_hz_out) override;
+
+	virtual void seekToBeginningOfFile() override;
+
+	virtual void seekToApproxTimeWrapped(double time) override;
+
+	const WavFormat& getFormat() const { return format; }
+
+private:
+	MemMappedFile mem_mapped_file;
+	WavFormat format;
+	size_t next_frame_i;
+};
+
+
 } // end namespace glare
@@ -353,7 +353,8 @@ void AddObjectDialog::urlChanged(const QString& filename)
 		{
 			try
 			{
-				loadModelIntoPreview(resource_manager->pathForURL(url));
+				PackedResourceCache::PinRef extracted_file_pin; // Stops the extracted file from being deleted while we are reading it.
+				loadModelIntoPreview(resource_manager->extractedPathForURL(url, extracted_file_pin));
 			}
 			catch(glare::Exception& e)
 			{
@@ -412,9 +413,9 @@ void AddObjectDialog::timerEvent(QTimerEvent* event)
 			try
 			{
 				// Now that the model is downloaded, set the result to be the local path where it was downloaded to.
-				this->result_path = resource_manager->pathForURL(m->URL); // TODO: catch
+				this->result_path = resource_manager->extractedPathForURL(m->URL, this->result_path_pin); // TODO: catch
 
-				loadModelIntoPreview(resource_manager->pathForURL(m->URL));
+				loadModelIntoPreview(this->result_path);
 			}
 			catch(glare::Exception& e)
 			{
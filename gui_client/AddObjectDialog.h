@@ -10,6 +10,7 @@ Copyright Glare Technologies Limited 2022 -
 #include "../dll/include/IndigoMesh.h"
 #include "../shared/WorldMaterial.h"
 #include "../shared/WorldObject.h"
+#include "../shared/PackedResourceCache.h"
 #include <utils/ThreadManager.h>
 #include <graphics/BatchedMesh.h>
 #include <QtCore/QString>
@@ -61,6 +62,7 @@ private:
 
 public:
 	std::string result_path;
+	PackedResourceCache::PinRef result_path_pin; // Stops the file at result_path from being deleted, if it was extracted from the packed cache.
 	BatchedMeshRef loaded_mesh;
 
 	glare::AllocatorVector<Voxel, 16> loaded_voxels;
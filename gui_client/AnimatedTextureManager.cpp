@@ -7,6 +7,7 @@ Copyright Glare Technologies Limited 2023 -
 
 
 #include "GUIClient.h"
+#include "StreamingGIFTexture.h"
 #include "EmbeddedBrowser.h"
 #include "CEF.h"
 #include "../shared/ResourceManager.h"
@@ -42,92 +43,125 @@ AnimatedTexData::~AnimatedTexData()
 }
 
 
-void AnimatedTexObData::processGIFAnimatedTex(GUIClient* gui_client, OpenGLEngine* opengl_engine, WorldObject* ob, double anim_time, double dt,
-	OpenGLMaterial& mat, Reference<OpenGLTexture>& texture, AnimatedTexData& animtexdata, const std::string& tex_path, bool is_refl_tex)
+// Returns the index of the frame to display at time in_anim_time, where in_anim_time is in [0, total anim time).
+// cur_frame_i is the index of the frame currently displayed, used to speed up the search.
+template <class FrameEndTimesVec>
+static int findCurrentFrame(double in_anim_time, int cur_frame_i, int num_frames, bool frame_durations_equal, double recip_frame_duration, const FrameEndTimesVec& frame_end_times)
 {
-	TextureData* texdata = texture->texture_data.ptr();
-	if(texdata)
+	if(cur_frame_i < 0 || cur_frame_i >= num_frames) // Make sure cur_frame_i is in bounds.
+		cur_frame_i = 0;
+
+	// If frame durations are equal, we can skip the frame search stuff, and just compute the frame index directly.
+	if(frame_durations_equal)
 	{
-		const int num_frames = (int)texdata->num_frames;
-		const double total_anim_time = texdata->last_frame_end_time;
-		if((num_frames > 0) && (total_anim_time > 0)) // Check !frames.empty() for back() calls below.
-		{
-			const double in_anim_time = Maths::doubleMod(anim_time, total_anim_time);
-			assert(in_anim_time >= 0);
+		int index = (int)(in_anim_time * recip_frame_duration);
+		assert(index >= 0);
 
-			// Search for the current frame, setting animtexdata.cur_frame_i, for in_anim_time.
-			// Note that in_anim_time may have increased just a little bit since last time process() was called, or it may have jumped a lot if object left and re-entered the camera view.
+		if(index >= num_frames)
+			index = 0;
 
-			if(animtexdata.cur_frame_i < 0 && animtexdata.cur_frame_i >= num_frames) // Make sure cur_frame_i is in bounds.
+		return index;
+	}
+	else
+	{
+		// Else frame end times are irregularly spaced.  
+		// Start with a special case search, where we assume in_anim_time just increased a little bit, so that we are still on the same frame, or maybe the next frame.
+		// If that doesn't find the correct frame, then fall back to a binary search over all frames to find the correct frame.
+
+		// Is in_anim_time still in the time range of the current frame?  Note that we need to check both frame start and end times as in_anim_time may have decreased.
+		// cur frame start time = prev frame end time, but be careful about wraparound.
+		const double cur_frame_start_time = (cur_frame_i == 0) ? 0.0 : frame_end_times[cur_frame_i - 1];
+		if(in_anim_time >= cur_frame_start_time && in_anim_time <= frame_end_times[cur_frame_i])
+		{
+			return cur_frame_i; // Current frame is unchanged.
+		}
+		else
+		{
+			// See if in_anim_time is in the time range of the next frame
+			double next_frame_start_time, next_frame_end_time;
+			int next_frame_index;
+			if(cur_frame_i == num_frames - 1)
 			{
-				assert(false);
-				animtexdata.cur_frame_i = 0;
+				next_frame_start_time = 0.0;
+				next_frame_end_time = frame_end_times[0];
+				next_frame_index = 0;
+			}
+			else
+			{
+				next_frame_start_time = frame_end_times[cur_frame_i];
+				next_frame_end_time   = frame_end_times[cur_frame_i + 1];
+				next_frame_index = cur_frame_i + 1;
 			}
 
-			// If frame durations are equal, we can skip the frame search stuff, and just compute the frame index directly.
-			if(texdata->frame_durations_equal)
+			if(in_anim_time >= next_frame_start_time && in_anim_time <= next_frame_end_time) // if in_anim_time is in the time range of the next frame:
 			{
-				int index = (int)(in_anim_time * texdata->recip_frame_duration);
+				return next_frame_index;
+			}
+			else
+			{
+				// Else in_anim_time was not in current frame or next frame periods.
+				// Do binary search for current frame.
+				const auto res = std::lower_bound(frame_end_times.begin(), frame_end_times.end(), in_anim_time); // Get the position of the first frame_end_time >= in_anim_time.
+				int index = (int)(res - frame_end_times.begin());
 				assert(index >= 0);
-
 				if(index >= num_frames)
 					index = 0;
 
-				animtexdata.cur_frame_i = index;
+				return index;
 			}
-			else
+		}
+	}
+}
+
+
+void AnimatedTexObData::processGIFAnimatedTex(GUIClient* gui_client, OpenGLEngine* opengl_engine, WorldObject* ob, double anim_time, double dt,
+	OpenGLMaterial& mat, Reference<OpenGLTexture>& texture, AnimatedTexData& animtexdata, const std::string& tex_path, bool is_refl_tex)
+{
+	// If this is a streaming GIF, frames are decoded on demand by the StreamingGIFTexture.
+	auto streaming_res = gui_client->streaming_gif_textures.find(tex_path);
+	if(streaming_res != gui_client->streaming_gif_textures.end())
+	{
+		StreamingGIFTexture* streaming_gif = streaming_res->second.ptr();
+		const int num_frames = streaming_gif->getNumFrames();
+		const double total_anim_time = streaming_gif->last_frame_end_time;
+		if((num_frames > 0) && (total_anim_time > 0))
+		{
+			const double in_anim_time = Maths::doubleMod(anim_time, total_anim_time);
+			assert(in_anim_time >= 0);
+
+			animtexdata.cur_frame_i = findCurrentFrame(in_anim_time, animtexdata.cur_frame_i, num_frames, streaming_gif->frame_durations_equal, streaming_gif->recip_frame_duration, streaming_gif->frame_end_times);
+
+			if(animtexdata.cur_frame_i != animtexdata.last_loaded_frame_i) // If cur frame changed: (Avoid uploading the same frame multiple times in a row)
 			{
-				// Else frame end times are irregularly spaced.  
-				// Start with a special case search, where we assume in_anim_time just increased a little bit, so that we are still on the same frame, or maybe the next frame.
-				// If that doesn't find the correct frame, then fall back to a binary search over all frames to find the correct frame.
-
-				// Is in_anim_time still in the time range of the current frame?  Note that we need to check both frame start and end times as in_anim_time may have decreased.
-				// cur frame start time = prev frame end time, but be careful about wraparound.
-				const double cur_frame_start_time = (animtexdata.cur_frame_i == 0) ? 0.0 : texdata->frame_end_times[animtexdata.cur_frame_i - 1];
-				if(in_anim_time >= cur_frame_start_time && in_anim_time <= texdata->frame_end_times[animtexdata.cur_frame_i])
+				// Note that the frame may not have been decoded yet, in which case we keep displaying the last loaded frame, and try again next time.
+				Reference<TextureData> frame_texdata = streaming_gif->getFrame(animtexdata.cur_frame_i, anim_time, gui_client->model_and_texture_loader_task_manager);
+				if(frame_texdata.nonNull())
 				{
-					// animtexdata.cur_frame_i is unchanged.
-					//conPrint("current frame is unchanged");
-				}
-				else
-				{
-					// See if in_anim_time is in the time range of the next frame
-					double next_frame_start_time, next_frame_end_time;
-					int next_frame_index;
-					if(animtexdata.cur_frame_i == num_frames - 1)
-					{
-						next_frame_start_time = 0.0;
-						next_frame_end_time = texdata->frame_end_times[0];
-						next_frame_index = 0;
-					}
-					else
-					{
-						next_frame_start_time = texdata->frame_end_times[animtexdata.cur_frame_i];
-						next_frame_end_time   = texdata->frame_end_times[animtexdata.cur_frame_i + 1];
-						next_frame_index = animtexdata.cur_frame_i + 1;
-					}
-
-					if(in_anim_time >= next_frame_start_time && in_anim_time <= next_frame_end_time) // if in_anim_time is in the time range of the next frame:
-					{
-						animtexdata.cur_frame_i = next_frame_index;
-						//conPrint("advancing to next frame");
-					}
-					else
-					{
-						//conPrint("Finding frame with binary search");
+					OpenGLTextureRef tex = is_refl_tex ? mat.albedo_texture : mat.emission_texture;
 
-						// Else in_anim_time was not in current frame or next frame periods.
-						// Do binary search for current frame.
-						const auto res = std::lower_bound(texdata->frame_end_times.begin(), texdata->frame_end_times.end(), in_anim_time); // Get the position of the first frame_end_time >= in_anim_time.
-						int index = (int)(res - texdata->frame_end_times.begin());
-						assert(index >= 0);
-						if(index >= num_frames)
-							index = 0;
+					if(tex.nonNull() && tex->xRes() == frame_texdata->W && tex->yRes() == frame_texdata->H)
+						TextureLoading::loadIntoExistingOpenGLTexture(tex, *frame_texdata, /*frame_i=*/0);
 
-						animtexdata.cur_frame_i = index;
-					}
+					animtexdata.last_loaded_frame_i = animtexdata.cur_frame_i;
 				}
 			}
+		}
+		return;
+	}
+
+	TextureData* texdata = texture->texture_data.ptr();
+	if(texdata)
+	{
+		const int num_frames = (int)texdata->num_frames;
+		const double total_anim_time = texdata->last_frame_end_time;
+		if((num_frames > 0) && (total_anim_time > 0)) // Check !frames.empty() for back() calls below.
+		{
+			const double in_anim_time = Maths::doubleMod(anim_time, total_anim_time);
+			assert(in_anim_time >= 0);
+
+			// Search for the current frame, setting animtexdata.cur_frame_i, for in_anim_time.
+			// Note that in_anim_time may have increased just a little bit since last time process() was called, or it may have jumped a lot if object left and re-entered the camera view.
+			animtexdata.cur_frame_i = findCurrentFrame(in_anim_time, animtexdata.cur_frame_i, num_frames, texdata->frame_durations_equal, texdata->recip_frame_duration, texdata->frame_end_times);
 
 			assert(animtexdata.cur_frame_i >= 0 && animtexdata.cur_frame_i < num_frames); // Should be in bounds
 
@@ -701,7 +701,7 @@ VehiclePhysicsUpdateEvents BikePhysics::update(PhysicsWorld& physics_world, cons
 	{
 		// Set mix parameters for the engine sound.  Actual mixing will get done in the ResonanceThread.
 		{
-			Lock lock(m_audio_engine->mutex);
+			Lock lock(engine_audio_source->source_mutex);
 
 			const float current_RPM = controller->GetEngine().GetCurrentRPM();
 			const float cur_engine_freq = current_RPM / 60.f;
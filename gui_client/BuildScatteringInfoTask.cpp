@@ -71,7 +71,8 @@ void BuildScatteringInfoTask::run(size_t thread_index)
 
 			// We want to load and build the mesh at lod_model_url.
 			// conPrint("LoadModelTask: loading mesh with URL '" + lod_model_url + "'.");.
-			const std::string model_path = resource_manager->pathForURL(lod_model_url);
+			PackedResourceCache::PinRef extracted_file_pin; // Stops the extracted file from being deleted while we are reading it.
+			const std::string model_path = resource_manager->extractedPathForURL(lod_model_url, extracted_file_pin);
 
 			gl_meshdata = ModelLoading::makeGLMeshDataAndBatchedMeshForModelPath(model_path,
 				/*vert_buf_allocator=*/NULL, 
@@ -0,0 +1,456 @@
+/*=====================================================================
+ClientBenchmark.cpp
+-------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#include "ClientBenchmark.h"
+
+
+#include "GUIClient.h"
+#include "ClientThread.h"
+#include <opengl/OpenGLEngine.h>
+#include <maths/mathstypes.h>
+#include <utils/Parser.h>
+#include <utils/FileUtils.h>
+#include <utils/StringUtils.h>
+#include <utils/Exception.h>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+#if defined(_WIN32)
+#include <utils/IncludeWindows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+
+static const int MEM_SAMPLING_PERIOD_FRAMES = 30; // Getting OpenGL mem usage iterates over textures, so don't do it every frame.
+
+
+ClientBenchmark::ClientBenchmark()
+:	max_time(600.0),
+	frame_index(0),
+	done(false),
+	timed_out(false),
+	time_to_first_frame(-1),
+	time_to_fully_loaded(-1),
+	idle_start_time(0),
+	num_idle_frames(0),
+	peak_process_mem_B(0),
+	peak_gl_CPU_mem_B(0),
+	peak_gl_GPU_mem_B(0),
+	download_bytes(0),
+	resources_downloaded(0),
+	peak_load_item_queue_size(0),
+	peak_download_queue_size(0),
+	peak_loader_tasks(0),
+	peak_loaded_msgs_to_process(0),
+	peak_frame_scheduler_backlog(0),
+	num_frames_with_deferred_work(0)
+{}
+
+
+ClientBenchmark::~ClientBenchmark()
+{}
+
+
+void ClientBenchmark::loadCameraPath(const std::string& path)
+{
+	try
+	{
+		parseCameraPath(FileUtils::readEntireFileTextMode(path), keyframes);
+	}
+	catch(glare::Exception& e)
+	{
+		throw glare::Exception("Error loading camera path '" + path + "': " + e.what());
+	}
+}
+
+
+static void parseDoubleWithLeadingWS(Parser& parser, double& x_out)
+{
+	while(parser.notEOF() && (parser.currentIsChar(' ') || parser.currentIsChar('\t')))
+		parser.advance();
+	if(!parser.parseDouble(x_out))
+		throw glare::Exception("Failed to parse number at position " + toString(parser.currentPos()));
+}
+
+
+void ClientBenchmark::parseCameraPath(const std::string& contents, std::vector<CameraKeyframe>& keyframes_out)
+{
+	keyframes_out.clear();
+
+	Parser parser(contents.data(), contents.size());
+	while(1)
+	{
+		parser.parseWhiteSpace();
+		if(parser.eof())
+			break;
+
+		if(parser.currentIsChar('#'))
+		{
+			string_view line;
+			parser.parseLine(line);
+			continue;
+		}
+
+		CameraKeyframe keyframe;
+		parseDoubleWithLeadingWS(parser, keyframe.time);
+		parseDoubleWithLeadingWS(parser, keyframe.pos.x);
+		parseDoubleWithLeadingWS(parser, keyframe.pos.y);
+		parseDoubleWithLeadingWS(parser, keyframe.pos.z);
+		parseDoubleWithLeadingWS(parser, keyframe.angles.x);
+		parseDoubleWithLeadingWS(parser, keyframe.angles.y);
+		keyframe.angles.z = 0;
+
+		if(!keyframes_out.empty() && keyframe.time < keyframes_out.back().time)
+			throw glare::Exception("Keyframe times must be increasing.");
+
+		keyframes_out.push_back(keyframe);
+	}
+
+	if(keyframes_out.empty())
+		throw glare::Exception("Camera path has no keyframes.");
+}
+
+
+std::string ClientBenchmark::cameraKeyframeToString(const CameraKeyframe& keyframe)
+{
+	return doubleToStringNDecimalPlaces(keyframe.time, 3) + " " +
+		doubleToStringNDecimalPlaces(keyframe.pos.x, 3) + " " + doubleToStringNDecimalPlaces(keyframe.pos.y, 3) + " " + doubleToStringNDecimalPlaces(keyframe.pos.z, 3) + " " +
+		doubleToStringNDecimalPlaces(keyframe.angles.x, 5) + " " + doubleToStringNDecimalPlaces(keyframe.angles.y, 5);
+}
+
+
+void ClientBenchmark::getCameraPose(const std::vector<CameraKeyframe>& keyframes, double t, Vec3d& pos_out, Vec3d& angles_out)
+{
+	assert(!keyframes.empty());
+
+	if(t <= keyframes.front().time)
+	{
+		pos_out = keyframes.front().pos;
+		angles_out = keyframes.front().angles;
+		return;
+	}
+	if(t >= keyframes.back().time)
+	{
+		pos_out = keyframes.back().pos;
+		angles_out = keyframes.back().angles;
+		return;
+	}
+
+	// Find first keyframe with time > t.  There must be one, and it can't be the first keyframe, from the checks above.
+	size_t i = 1;
+	while(keyframes[i].time <= t)
+		i++;
+
+	const CameraKeyframe& a = keyframes[i - 1];
+	const CameraKeyframe& b = keyframes[i];
+	const double frac = (t - a.time) / (b.time - a.time);
+
+	pos_out = a.pos + (b.pos - a.pos) * frac;
+
+	// Interpolate heading the short way around the circle.
+	double heading_delta = b.angles.x - a.angles.x;
+	heading_delta -= Maths::get2Pi<double>() * std::floor((heading_delta + Maths::pi<double>()) / Maths::get2Pi<double>());
+
+	angles_out = Vec3d(a.angles.x + heading_delta * frac, a.angles.y + (b.angles.y - a.angles.y) * frac, 0);
+}
+
+
+// Returns the peak resident memory usage of the process, or 0 if not available.
+static uint64 getPeakProcessMemUsage()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize;
+	return 0;
+#elif defined(__APPLE__)
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) == 0)
+		return (uint64)usage.ru_maxrss; // In bytes on Mac.
+	return 0;
+#elif defined(EMSCRIPTEN)
+	return 0;
+#else
+	// Read VmHWM (peak resident set size) from /proc/self/status
+	try
+	{
+		const std::string status = FileUtils::readEntireFileTextMode("/proc/self/status");
+		const size_t pos = status.find("VmHWM:");
+		if(pos != std::string::npos)
+		{
+			Parser parser(status.data() + pos + 6, status.size() - (pos + 6));
+			parser.parseWhiteSpace();
+			uint32 size_kB;
+			if(parser.parseUnsignedInt(size_kB))
+				return (uint64)size_kB * 1024;
+		}
+	}
+	catch(glare::Exception&)
+	{}
+	return 0;
+#endif
+}
+
+
+bool ClientBenchmark::isLoadingIdle(GUIClient& gui_client)
+{
+	return
+		(gui_client.connection_state == GUIClient::ServerConnectionState_Connected) &&
+		gui_client.client_thread.nonNull() && gui_client.client_thread->all_objects_received &&
+		gui_client.load_item_queue.empty() &&
+		(gui_client.model_and_texture_loader_task_manager.getNumUnfinishedTasks() == 0) &&
+		gui_client.model_loaded_messages_to_process.empty() &&
+		gui_client.texture_loaded_messages_to_process.empty() &&
+		gui_client.cur_loading_mesh_data.isNull() &&
+		!gui_client.tex_loading_progress.loadingInProgress() &&
+		(gui_client.download_queue.size() == 0) &&
+		(gui_client.num_non_net_resources_downloading == 0) &&
+		(gui_client.num_net_resources_downloading == 0) &&
+		(gui_client.msg_queue.size() == 0) &&
+		(gui_client.frame_scheduler.getTotalBacklog() == 0);
+}
+
+
+void ClientBenchmark::beginFrame(GUIClient& gui_client)
+{
+	if(frame_index == 0)
+		gui_client.player_physics.setFlyModeEnabled(true); // Don't let gravity move the camera off the path.
+
+	const double path_time = (double)frame_index / PATH_FRAME_RATE;
+
+	Vec3d pos, angles;
+	getCameraPose(keyframes, path_time, pos, angles);
+
+	gui_client.cam_controller.setAngles(angles);
+	gui_client.cam_controller.setFirstAndThirdPersonPositions(pos);
+	gui_client.player_physics.setEyePosition(pos);
+}
+
+
+void ClientBenchmark::endFrame(GUIClient& gui_client, double frame_time)
+{
+	const double cur_time = timer.elapsed();
+
+	if(time_to_first_frame < 0)
+		time_to_first_frame = cur_time;
+	else
+		frame_times.push_back(frame_time); // Don't include the first frame, which includes startup work.
+
+	peak_load_item_queue_size    = myMax<size_t>(peak_load_item_queue_size, gui_client.load_item_queue.size());
+	peak_download_queue_size     = myMax<size_t>(peak_download_queue_size, gui_client.download_queue.size());
+	peak_loader_tasks            = myMax<size_t>(peak_loader_tasks, gui_client.model_and_texture_loader_task_manager.getNumUnfinishedTasks());
+	peak_loaded_msgs_to_process  = myMax<size_t>(peak_loaded_msgs_to_process, gui_client.model_loaded_messages_to_process.size() + gui_client.texture_loaded_messages_to_process.size());
+	peak_frame_scheduler_backlog = myMax<size_t>(peak_frame_scheduler_backlog, gui_client.frame_scheduler.getTotalBacklog());
+	if(gui_client.frame_scheduler.getTotalBacklog() > 0)
+		num_frames_with_deferred_work++;
+
+	const bool path_done = ((double)frame_index / PATH_FRAME_RATE) >= keyframes.back().time;
+
+	if((frame_index % MEM_SAMPLING_PERIOD_FRAMES == 0) || path_done)
+	{
+		peak_process_mem_B = myMax(peak_process_mem_B, getPeakProcessMemUsage());
+		if(gui_client.opengl_engine.nonNull())
+		{
+			const GLMemUsage mem_usage = gui_client.opengl_engine->getTotalMemUsage();
+			peak_gl_CPU_mem_B = myMax<uint64>(peak_gl_CPU_mem_B, mem_usage.totalCPUUsage());
+			peak_gl_GPU_mem_B = myMax<uint64>(peak_gl_GPU_mem_B, mem_usage.totalGPUUsage());
+		}
+	}
+
+	// Work out if loading has finished.  Require loading to be idle for a number of frames, since e.g. a download finishing can start a load task.
+	if(isLoadingIdle(gui_client))
+	{
+		if(num_idle_frames == 0)
+			idle_start_time = cur_time;
+		num_idle_frames++;
+	}
+	else
+		num_idle_frames = 0;
+
+	if(path_done && (num_idle_frames >= IDLE_FRAMES_FOR_LOADED))
+	{
+		time_to_fully_loaded = idle_start_time;
+		done = true;
+	}
+	else if(cur_time > max_time)
+	{
+		timed_out = true;
+		done = true;
+	}
+
+	if(done)
+	{
+		download_bytes = gui_client.resource_download_stats.getTotalBytesReceived();
+		resources_downloaded = gui_client.resource_download_stats.getTotalResourcesDownloaded();
+	}
+
+	frame_index++;
+}
+
+
+double ClientBenchmark::percentile(const std::vector<double>& sorted_values, double p)
+{
+	if(sorted_values.empty())
+		return 0;
+
+	const size_t rank = (size_t)std::ceil(p / 100.0 * (double)sorted_values.size());
+	return sorted_values[myClamp<size_t>(rank, 1, sorted_values.size()) - 1];
+}
+
+
+// Formats a time in seconds as milliseconds.
+static std::string msString(double t)
+{
+	return doubleToStringNDecimalPlaces(t * 1.0e3, 3);
+}
+
+
+std::string ClientBenchmark::getResultsJSON() const
+{
+	std::vector<double> sorted_frame_times = frame_times;
+	std::sort(sorted_frame_times.begin(), sorted_frame_times.end());
+
+	double sum = 0;
+	for(size_t i=0; i<frame_times.size(); ++i)
+		sum += frame_times[i];
+	const double mean = frame_times.empty() ? 0.0 : (sum / frame_times.size());
+
+	std::string s;
+	s += "{\n";
+	s += "\t\"time_to_first_frame_s\": " + doubleToStringNDecimalPlaces(time_to_first_frame, 4) + ",\n";
+	s += "\t\"time_to_fully_loaded_s\": " + doubleToStringNDecimalPlaces(time_to_fully_loaded, 4) + ",\n";
+	s += "\t\"total_time_s\": " + doubleToStringNDecimalPlaces(timer.elapsed(), 4) + ",\n";
+	s += "\t\"timed_out\": " + boolToString(timed_out) + ",\n";
+	s += "\t\"num_frames\": " + toString(frame_index) + ",\n";
+	s += "\t\"frame_time_ms\": {\n";
+	s += "\t\t\"mean\": " + msString(mean) + ",\n";
+	s += "\t\t\"p50\": " + msString(percentile(sorted_frame_times, 50)) + ",\n";
+	s += "\t\t\"p90\": " + msString(percentile(sorted_frame_times, 90)) + ",\n";
+	s += "\t\t\"p99\": " + msString(percentile(sorted_frame_times, 99)) + ",\n";
+	s += "\t\t\"max\": " + msString(sorted_frame_times.empty() ? 0.0 : sorted_frame_times.back()) + "\n";
+	s += "\t},\n";
+	s += "\t\"peak_process_mem_B\": " + toString(peak_process_mem_B) + ",\n";
+	s += "\t\"peak_gl_CPU_mem_B\": " + toString(peak_gl_CPU_mem_B) + ",\n";
+	s += "\t\"peak_gl_GPU_mem_B\": " + toString(peak_gl_GPU_mem_B) + ",\n";
+	s += "\t\"download_bytes\": " + toString(download_bytes) + ",\n";
+	s += "\t\"resources_downloaded\": " + toString(resources_downloaded) + ",\n";
+	s += "\t\"loading\": {\n";
+	s += "\t\t\"peak_load_item_queue_size\": " + toString(peak_load_item_queue_size) + ",\n";
+	s += "\t\t\"peak_download_queue_size\": " + toString(peak_download_queue_size) + ",\n";
+	s += "\t\t\"peak_loader_tasks\": " + toString(peak_loader_tasks) + ",\n";
+	s += "\t\t\"peak_loaded_msgs_to_process\": " + toString(peak_loaded_msgs_to_process) + ",\n";
+	s += "\t\t\"peak_frame_scheduler_backlog\": " + toString(peak_frame_scheduler_backlog) + ",\n";
+	s += "\t\t\"num_frames_with_deferred_work\": " + toString(num_frames_with_deferred_work) + "\n";
+	s += "\t}\n";
+	s += "}\n";
+	return s;
+}
+
+
+#if BUILD_TESTS
+
+
+#include <utils/TestUtils.h>
+#include <utils/ConPrint.h>
+
+
+void ClientBenchmark::test()
+{
+	conPrint("ClientBenchmark::test()");
+
+	//---------------------- Test camera path parsing ----------------------
+	try
+	{
+		std::vector<CameraKeyframe> keyframes;
+		parseCameraPath("# time x y z heading pitch\n0 1 2 3 0.5 1.5\n\n  2.0\t10 20 30 1.0 1.0\n", keyframes);
+		testAssert(keyframes.size() == 2);
+		testAssert(keyframes[0].time == 0 && keyframes[0].pos == Vec3d(1, 2, 3) && keyframes[0].angles == Vec3d(0.5, 1.5, 0));
+		testAssert(keyframes[1].time == 2 && keyframes[1].pos == Vec3d(10, 20, 30) && keyframes[1].angles == Vec3d(1.0, 1.0, 0));
+
+		// Test round trip through cameraKeyframeToString()
+		std::vector<CameraKeyframe> keyframes2;
+		parseCameraPath(cameraKeyframeToString(keyframes[0]) + "\n" + cameraKeyframeToString(keyframes[1]) + "\n", keyframes2);
+		testAssert(keyframes2.size() == 2);
+		testAssert(keyframes2[1].pos == keyframes[1].pos && keyframes2[1].angles == keyframes[1].angles);
+
+		// Test interpolation
+		Vec3d pos, angles;
+		getCameraPose(keyframes, -1.0, pos, angles);
+		testAssert(pos == Vec3d(1, 2, 3));
+		getCameraPose(keyframes, 1.0, pos, angles);
+		testAssert(epsEqual(pos, Vec3d(5.5, 11, 16.5)));
+		testAssert(epsEqual(angles.x, 0.75) && epsEqual(angles.y, 1.25));
+		getCameraPose(keyframes, 100.0, pos, angles);
+		testAssert(pos == Vec3d(10, 20, 30));
+
+		// Heading should be interpolated the short way around.
+		parseCameraPath("0 0 0 0 6.0 1.5\n1 0 0 0 0.2 1.5\n", keyframes);
+		getCameraPose(keyframes, 0.5, pos, angles);
+		const double expected_heading = 6.0 + (0.2 + Maths::get2Pi<double>() - 6.0) * 0.5;
+		testAssert(epsEqual(angles.x, expected_heading));
+	}
+	catch(glare::Exception& e)
+	{
+		failTest(e.what());
+	}
+
+	// Test invalid paths
+	try
+	{
+		std::vector<CameraKeyframe> keyframes;
+		parseCameraPath("0 1 2 3 0.5\n", keyframes);
+		failTest("Expected exception");
+	}
+	catch(glare::Exception&)
+	{}
+	try
+	{
+		std::vector<CameraKeyframe> keyframes;
+		parseCameraPath("1 1 2 3 0.5 1\n0 1 2 3 0.5 1\n", keyframes);
+		failTest("Expected exception");
+	}
+	catch(glare::Exception&)
+	{}
+	try
+	{
+		std::vector<CameraKeyframe> keyframes;
+		parseCameraPath("# just a comment\n", keyframes);
+		failTest("Expected exception");
+	}
+	catch(glare::Exception&)
+	{}
+
+	//---------------------- Test percentile ----------------------
+	{
+		std::vector<double> values;
+		testAssert(percentile(values, 50) == 0);
+		for(int i=1; i<=100; ++i)
+			values.push_back(i);
+		testAssert(percentile(values, 50) == 50);
+		testAssert(percentile(values, 90) == 90);
+		testAssert(percentile(values, 99) == 99);
+		testAssert(percentile(values, 100) == 100);
+		testAssert(percentile(values, 0) == 1);
+
+		values.resize(1);
+		testAssert(percentile(values, 99) == 1);
+	}
+
+	//---------------------- Test results JSON ----------------------
+	{
+		ClientBenchmark benchmark;
+		const std::string json = benchmark.getResultsJSON();
+		testAssert(StringUtils::containsString(json, "\"time_to_fully_loaded_s\": -1.0000"));
+		testAssert(StringUtils::containsString(json, "\"p99\": 0.000"));
+		testAssert(StringUtils::containsString(json, "\"timed_out\": false"));
+	}
+
+	conPrint("ClientBenchmark::test() done.");
+}
+
+
+#endif // BUILD_TESTS
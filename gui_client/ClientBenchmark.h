@@ -0,0 +1,111 @@
+/*=====================================================================
+ClientBenchmark.h
+-----------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#pragma once
+
+
+#include <maths/vec3.h>
+#include <utils/Timer.h>
+#include <utils/Platform.h>
+#include <string>
+#include <vector>
+class GUIClient;
+
+
+/*=====================================================================
+ClientBenchmark
+---------------
+Benchmark mode for the SDL client (run with --benchmark camera_path_file).
+
+Flies the camera along a recorded camera path.  The path is sampled at a fixed
+time step per frame (1 / PATH_FRAME_RATE), so the same sequence of camera positions
+is rendered on each run, regardless of how fast the machine is.
+
+Once the end of the path is reached, waits until loading has finished
+(all objects received, and the load, download and task queues are empty for IDLE_FRAMES_FOR_LOADED frames),
+or until max_time has elapsed.
+
+Records time to first frame, time to fully loaded, frame time percentiles,
+peak process and OpenGL memory usage, downloaded bytes and loading queue sizes,
+which are written as JSON by getResultsJSON().
+
+Camera path files are text files with one keyframe per line:
+time x y z heading pitch
+with time in seconds, and angles in radians, as returned by CameraController::getAngles().
+Lines starting with '#' are ignored.  Paths can be recorded with the SDL client --record_camera_path option.
+
+Can be combined with --replay_capture (see NetCapture.h) to benchmark without a server.
+=====================================================================*/
+class ClientBenchmark
+{
+public:
+	ClientBenchmark();
+	~ClientBenchmark();
+
+	static const int PATH_FRAME_RATE = 60;
+	static const int IDLE_FRAMES_FOR_LOADED = 30;
+
+	struct CameraKeyframe
+	{
+		double time;
+		Vec3d pos;
+		Vec3d angles; // (heading, pitch, roll)
+	};
+
+	// Throws glare::Exception on failure.
+	void loadCameraPath(const std::string& path);
+	static void parseCameraPath(const std::string& contents, std::vector<CameraKeyframe>& keyframes_out);
+	static std::string cameraKeyframeToString(const CameraKeyframe& keyframe);
+
+	// Interpolates the camera path at time t.  Clamps to the first and last keyframes.
+	static void getCameraPose(const std::vector<CameraKeyframe>& keyframes, double t, Vec3d& pos_out, Vec3d& angles_out);
+
+	// Sets the camera position for this frame.  Call before GUIClient::timerEvent().
+	void beginFrame(GUIClient& gui_client);
+
+	// Records stats for the frame.  frame_time is the total time for the frame, including drawing.
+	void endFrame(GUIClient& gui_client, double frame_time);
+
+	bool isDone() const { return done; }
+
+	std::string getResultsJSON() const;
+
+	// Returns the value at percentile p (in [0, 100]) of sorted_values, using the nearest-rank method.
+	static double percentile(const std::vector<double>& sorted_values, double p);
+
+	static void test();
+
+	double max_time; // Benchmark is stopped after this amount of time, even if loading has not finished.
+
+private:
+	static bool isLoadingIdle(GUIClient& gui_client);
+
+	std::vector<CameraKeyframe> keyframes;
+
+	Timer timer; // Started when the benchmark is created, at client startup.
+	int64 frame_index;
+	bool done;
+	bool timed_out;
+
+	double time_to_first_frame;
+	double time_to_fully_loaded; // -1 if not fully loaded.
+	double idle_start_time;
+	int num_idle_frames;
+
+	std::vector<double> frame_times;
+
+	uint64 peak_process_mem_B;
+	uint64 peak_gl_CPU_mem_B;
+	uint64 peak_gl_GPU_mem_B;
+	uint64 download_bytes;
+	uint64 resources_downloaded;
+
+	size_t peak_load_item_queue_size;
+	size_t peak_download_queue_size;
+	size_t peak_loader_tasks;
+	size_t peak_loaded_msgs_to_process;
+	size_t peak_frame_scheduler_backlog;
+	int64 num_frames_with_deferred_work;
+};
@@ -8,6 +8,7 @@ Copyright Glare Technologies Limited 2024 -
 
 #include "ClientSenderThread.h"
 #include "WorldState.h"
+#include "NetCapture.h"
 #include "../shared/Protocol.h"
 #include "../shared/ProtocolStructs.h"
 #include "../shared/Parcel.h"
@@ -29,6 +30,8 @@ Copyright Glare Technologies Limited 2024 -
 
 
 static const size_t MAX_STRING_LEN = 10000;
+static const size_t MAX_PENDING_OBJECTS = 512; // Max number of received objects to buffer before inserting them into the world state.
+static const int MAX_MSG_BATCH_SIZE = 1024; // Max number of messages to handle in a batch, before going back to check should_die.
 
 
 ClientThread::ClientThread(ThreadSafeQueue<Reference<ThreadMessage> >* out_msg_queue_, const std::string& hostname_, int port_,
@@ -40,8 +43,11 @@ ClientThread::ClientThread(ThreadSafeQueue<Reference<ThreadMessage> >* out_msg_q
 	all_objects_received(false),
 	config(config_),
 	world_ob_pool_allocator(world_ob_pool_allocator_),
-	send_data_to_socket(false)
+	send_data_to_socket(false),
+	replay_speed(1.0)
 {
+	pending_objects.reserve(MAX_PENDING_OBJECTS);
+
 #if !defined(EMSCRIPTEN)
 	MySocketRef mysocket = new MySocket();
 	mysocket->setUseNetworkByteOrder(false);
@@ -95,6 +101,19 @@ void ClientThread::killConnection()
 }
 
 
+void ClientThread::setCaptureWriter(const Reference<NetCaptureWriter>& capture_writer_)
+{
+	capture_writer = capture_writer_;
+}
+
+
+void ClientThread::setReplayCapture(const std::string& capture_path, double replay_speed_)
+{
+	replay_capture_path = capture_path;
+	replay_speed = replay_speed_;
+}
+
+
 WorldObjectRef ClientThread::allocWorldObject()
 {
 	glare::PoolAllocator::AllocResult alloc_res = this->world_ob_pool_allocator->alloc();
@@ -107,6 +126,51 @@ WorldObjectRef ClientThread::allocWorldObject()
 }
 
 
+// Inserts all pending objects into the world state, taking the world state lock once for the whole batch.
+void ClientThread::flushPendingObjects()
+{
+	if(pending_objects.empty())
+		return;
+
+	{
+		::Lock lock(world_state->mutex);
+
+		world_state->dirty_from_remote_objects.reserve(world_state->dirty_from_remote_objects.size() + pending_objects.size());
+
+		for(size_t i=0; i<pending_objects.size(); ++i)
+		{
+			WorldObject* ob = pending_objects[i].ptr();
+
+			// When a client moves and a new cell comes into proximity, a QueryObjects message is sent to the server.
+			// The server replies with ObjectInitialSend messages.
+			// This means that the client may already have the object inserted, when moving back into a cell previously in proximity.
+			// We want to make sure not to add the object twice or load it into the graphics engine twice.
+			// NOTE: will not replace existing object with that UID if it exists in the map.
+			const bool added = world_state->objects.insert(ob->uid, pending_objects[i]);
+			if(added)
+				world_state->dirty_from_remote_objects.insert(pending_objects[i]);
+		}
+	}
+
+	pending_objects.clear(); // Objects that were not added are freed here, back to the pool allocator.  Keeps vector capacity.
+}
+
+
+// Reads and handles messages until there is no more data immediately available on the socket, or the batch size limit is reached.
+// Any objects received are inserted into the world state at the end of the batch.
+void ClientThread::readAndHandleMessageBatch(const uint32 peer_protocol_version)
+{
+	readAndHandleMessage(peer_protocol_version);
+
+#if !defined(EMSCRIPTEN)
+	for(int i=1; (i < MAX_MSG_BATCH_SIZE) && !should_die && socket->readable(/*timeout (s)=*/0.0); ++i)
+		readAndHandleMessage(peer_protocol_version);
+#endif
+
+	flushPendingObjects();
+}
+
+
 void ClientThread::readAndHandleMessage(const uint32 peer_protocol_version)
 {
 	// Read msg type and length
@@ -126,6 +190,21 @@ void ClientThread::readAndHandleMessage(const uint32 peer_protocol_version)
 
 	socket->readData(msg_buffer.buf.data() + sizeof(uint32) * 2, msg_len - sizeof(uint32) * 2); // Read rest of message, store in msg_buffer.
 
+	if(capture_writer.nonNull())
+		capture_writer->writeMessage(msg_type, msg_buffer.buf.data() + sizeof(uint32) * 2, msg_len - sizeof(uint32) * 2);
+
+	handleMessage(msg_type, peer_protocol_version);
+}
+
+
+// Handles a message with type msg_type, whose body has been read into msg_buffer.
+void ClientThread::handleMessage(const uint32 msg_type, const uint32 peer_protocol_version)
+{
+	// Objects received in ObjectCreated and ObjectInitialSend messages are buffered in pending_objects.
+	// Insert them before handling any other message, so that later messages (e.g. ObjectDestroyed, AllObjectsSent) see them.
+	if(msg_type != Protocol::ObjectCreated && msg_type != Protocol::ObjectInitialSend)
+		flushPendingObjects();
+
 	switch(msg_type)
 	{
 	case Protocol::AllObjectsSent:
@@ -146,6 +225,13 @@ void ClientThread::readAndHandleMessage(const uint32 peer_protocol_version)
 
 			out_msg_queue->enqueue(new RemoteClientAudioStreamToServerStarted(avatar_uid, sampling_rate, flags, stream_id)); // Inform MainWindow
 
+			break;
+		}
+	case Protocol::MinClientProtocolVersion:
+		{
+			const uint32 min_client_protocol_version = msg_buffer.readUInt32();
+
+			out_msg_queue->enqueue(new MinClientProtocolVersionMessage(min_client_protocol_version));
 			break;
 		}
 	case Protocol::AudioStreamToServerEnded:
@@ -610,6 +696,7 @@ void ClientThread::readAndHandleMessage(const uint32 peer_protocol_version)
 					WorldObject* ob = res.getValue().ptr();
 
 					ob->model_url = new_model_url;
+					BitUtils::zeroBit(ob->flags, WorldObject::GPU_MESH_PRESENT_FLAG); // GPU meshes are for the old model.
 
 					ob->from_remote_model_url_dirty = true;
 					world_state->dirty_from_remote_objects.insert(ob);
@@ -722,15 +809,10 @@ void ClientThread::readAndHandleMessage(const uint32 peer_protocol_version)
 			ob->from_remote_other_dirty = true;
 			ob->setTransformAndHistory(ob->pos, ob->axis, ob->angle);
 
-			// Insert into world state.
-			{
-				::Lock lock(world_state->mutex);
-
-				// NOTE: will not replace existing object with that UID if it exists in the map.
-				const bool added = world_state->objects.insert(object_uid, ob);
-				if(added)
-					world_state->dirty_from_remote_objects.insert(ob);
-			}
+			// Insert into world state in flushPendingObjects().
+			pending_objects.push_back(ob);
+			if(pending_objects.size() >= MAX_PENDING_OBJECTS)
+				flushPendingObjects();
 			break;
 		}
 	case Protocol::ObjectInitialSend:
@@ -758,18 +840,10 @@ void ClientThread::readAndHandleMessage(const uint32 peer_protocol_version)
 			if(hasPrefix(ob->content, feature_prefix))
 				ob->max_load_dist2 = Maths::square(100.f);
 
-			// Insert into world state.
-			{
-				::Lock lock(world_state->mutex);
-
-				// When a client moves and a new cell comes into proximity, a QueryObjects message is sent to the server.
-				// The server replies with ObjectInitialSend messages.
-				// This means that the client may already have the object inserted, when moving back into a cell previously in proximity.
-				// We want to make sure not to add the object twice or load it into the graphics engine twice.
-				const bool added = world_state->objects.insert(object_uid, ob);
-				if(added)
-					world_state->dirty_from_remote_objects.insert(ob);
-			}
+			// Insert into world state in flushPendingObjects().
+			pending_objects.push_back(ob);
+			if(pending_objects.size() >= MAX_PENDING_OBJECTS)
+				flushPendingObjects();
 			break;
 		}
 	case Protocol::ObjectDestroyed:
@@ -1025,6 +1099,13 @@ void ClientThread::doRun()
 
 	try
 	{
+		if(!replay_capture_path.empty())
+		{
+			doReplay();
+			out_msg_queue->enqueue(new ClientDisconnectedFromServerMessage());
+			return;
+		}
+
 		// Do DNS resolution of server hostname
 		//Timer timer;
 #if EMSCRIPTEN
@@ -1093,6 +1174,9 @@ void ClientThread::doRun()
 		// Read assigned client avatar UID
 		this->client_avatar_uid = readUIDFromStream(*socket);
 
+		if(capture_writer.nonNull())
+			capture_writer->writeHeader(peer_protocol_version, this->client_avatar_uid, world_name);
+
 		out_msg_queue->enqueue(new ClientConnectedToServerMessage(this->client_avatar_uid, peer_protocol_version));
 
 #if defined(EMSCRIPTEN)
@@ -1144,19 +1228,19 @@ void ClientThread::doRun()
 
 			if(socket->readable(/*timeout (s)=*/0.1)) // If socket has some data to read from it:  (Use a timeout so we can check should_die occasionally)
 			{
-				readAndHandleMessage(peer_protocol_version);
+				readAndHandleMessageBatch(peer_protocol_version);
 			}
 
 #elif defined(EMSCRIPTEN)
 			
-			readAndHandleMessage(peer_protocol_version);
+			readAndHandleMessageBatch(peer_protocol_version);
 
 #else // Else Linux:
 
 			// Block until either the socket is readable or the event fd is signalled, which means should_die has been set.
 			if(socket->readable(event_fd)) // If there is some data to read:
 			{
-				readAndHandleMessage(peer_protocol_version);
+				readAndHandleMessageBatch(peer_protocol_version);
 			}
 #endif
 		}
@@ -1172,12 +1256,73 @@ void ClientThread::doRun()
 		out_msg_queue->enqueue(new ClientDisconnectedFromServerMessage(e.what(), /*closed_gracefully=*/false));
 	}
 
+	pending_objects.clear(); // Drop any objects from a partially handled batch.
+
 	out_msg_queue->enqueue(new ClientDisconnectedFromServerMessage());
 }
 
 
+// Reads messages from the replay capture and handles them, waiting until the recorded time of each message (scaled by replay_speed) before handling it.
+// After the end of the capture is reached, waits until the thread is killed, as if still connected to the server.
+void ClientThread::doReplay()
+{
+	conPrint("ClientThread: Replaying capture '" + replay_capture_path + "'...");
+
+	NetCaptureReader reader(replay_capture_path);
+
+	this->client_avatar_uid = reader.client_avatar_uid;
+	out_msg_queue->enqueue(new ClientConnectedToServerMessage(this->client_avatar_uid, reader.peer_protocol_version));
+
+	Timer replay_timer;
+	size_t num_msgs_replayed = 0;
+	try
+	{
+		NetCaptureReader::Record record;
+		while(!should_die && reader.readRecord(record))
+		{
+			if(record.type != NetCaptureReader::RecordType_Message)
+				continue; // Resources are added to the resource manager before the replay starts, see NetCaptureReader::installResources().
+
+			if(replay_speed > 0)
+			{
+				while(!should_die && (replay_timer.elapsed() * replay_speed < record.time))
+				{
+					flushPendingObjects(); // Insert any objects from the current batch before waiting.
+					PlatformUtils::Sleep(1);
+				}
+			}
+
+			msg_buffer.buf.resizeNoCopy(sizeof(uint32) * 2 + record.data.size());
+			if(!record.data.empty())
+				std::memcpy(msg_buffer.buf.data() + sizeof(uint32) * 2, record.data.data(), record.data.size());
+			msg_buffer.read_index = sizeof(uint32) * 2;
+
+			handleMessage(record.msg_type, reader.peer_protocol_version);
+
+			num_msgs_replayed++;
+			if(num_msgs_replayed % MAX_MSG_BATCH_SIZE == 0)
+				flushPendingObjects();
+		}
+	}
+	catch(glare::Exception& e)
+	{
+		conPrint("ClientThread: Error while replaying capture: " + e.what());
+	}
+
+	flushPendingObjects();
+
+	conPrint("ClientThread: Replayed " + toString(num_msgs_replayed) + " messages in " + replay_timer.elapsedString());
+
+	while(!should_die)
+		PlatformUtils::Sleep(10);
+}
+
+
 void ClientThread::enqueueDataToSend(const ArrayRef<uint8> data)
 {
+	if(!replay_capture_path.empty())
+		return; // There is no server to send to when replaying a capture.
+
 #if defined(EMSCRIPTEN)
 	Lock lock(data_to_send_mutex);
 
@@ -21,6 +21,7 @@ Copyright Glare Technologies Limited 2024 -
 #include <utils/ArrayRef.h>
 #include <string>
 class ClientSenderThread;
+class NetCaptureWriter;
 class WorldState;
 class WorldObject;
 class SocketInterface;
@@ -106,6 +107,14 @@ public:
 };
 
 
+class MinClientProtocolVersionMessage : public ThreadMessage
+{
+public:
+	MinClientProtocolVersionMessage(uint32 min_client_protocol_version_) : min_client_protocol_version(min_client_protocol_version_) {}
+	uint32 min_client_protocol_version;
+};
+
+
 class UserSelectedObjectMessage : public ThreadMessage
 {
 public:
@@ -229,6 +238,15 @@ public:
 ClientThread
 ------------
 Maintains network connection to server.
+
+Messages are read and handled in batches, while data is immediately available on the socket.
+Objects received in a batch are inserted into world_state with a single lock acquisition.
+WorldObjects are allocated from world_ob_pool_allocator, which is owned by the caller, so
+can be reused across disconnects and reconnects.
+
+Received messages can be recorded to a capture file with setCaptureWriter().
+With setReplayCapture(), messages are read from a capture file instead of from the server,
+which allows profiling the client without a server.
 =====================================================================*/
 class ClientThread : public MessageableThread
 {
@@ -245,10 +263,22 @@ public:
 
 	void killConnection();
 
+	// Records received messages with capture_writer.  Should be called before the thread is launched.
+	void setCaptureWriter(const Reference<NetCaptureWriter>& capture_writer);
+
+	// Replays the messages in the capture file instead of connecting to the server.  Messages sent to the server are discarded.
+	// replay_speed is the playback speed relative to the recorded message timings, or 0 to replay as fast as possible.
+	// Should be called before the thread is launched.
+	void setReplayCapture(const std::string& capture_path, double replay_speed);
+
 	bool all_objects_received;
 	Reference<WorldState> world_state;
 private:
+	void readAndHandleMessageBatch(uint32 peer_protocol_version);
 	void readAndHandleMessage(uint32 peer_protocol_version);
+	void handleMessage(uint32 msg_type, uint32 peer_protocol_version);
+	void flushPendingObjects();
+	void doReplay();
 
 	UID client_avatar_uid;
 
@@ -271,8 +301,14 @@ private:
 
 	BufferInStream msg_buffer;
 
+	std::vector<Reference<WorldObject> > pending_objects; // Objects received from the server that have not been inserted into world_state yet.
+
 	Reference<glare::PoolAllocator> world_ob_pool_allocator;
 
+	Reference<NetCaptureWriter> capture_writer;
+	std::string replay_capture_path; // Non-empty if replaying a capture.
+	double replay_speed;
+
 	ThreadManager client_sender_thread_manager;
 	Reference<ClientSenderThread> client_sender_thread		GUARDED_BY(data_to_send_mutex);
 };
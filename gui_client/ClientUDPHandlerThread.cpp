@@ -14,12 +14,16 @@ Copyright Glare Technologies Limited 2023 -
 #include "../shared/WorldObject.h"
 #include "../shared/MessageUtils.h"
 #include "../shared/FileTypes.h"
+#include "../audio/VoiceJitterBuffer.h"
 #include <vec3.h>
 #include <ConPrint.h>
 #include <Exception.h>
 #include <MySocket.h>
 #include <PlatformUtils.h>
 #include <Networking.h>
+#include <Clock.h>
+#include <ThreadManager.h>
+#include <KillThreadMessage.h>
 #include <opus.h>
 
 
@@ -44,112 +48,300 @@ struct AvatarVoiceStreamInfo
 	OpusDecoder* opus_decoder;
 	uint32 sampling_rate;
 	uint32 stream_id;
-	uint32 next_seq_num_expected;
+	glare::VoiceJitterBuffer jitter_buffer;
+	int last_frame_num_samples; // Number of samples in the last packet received, used as the frame size for concealment.
 };
 
 
-void ClientUDPHandlerThread::doRun()
+// A voice packet received by the ClientUDPHandlerThread, passed to the VoicePlayoutThread.
+class VoicePacketReceivedMessage : public ThreadMessage
 {
-	PlatformUtils::setCurrentThreadNameIfTestsEnabled("ClientUDPHandlerThread");
+public:
+	uint32 avatar_id;
+	uint32 seq_num;
+	std::vector<uint8> opus_packet;
+	double arrival_time; // From Clock::getTimeSinceInit()
+};
 
-	std::unordered_map<uint32, AvatarVoiceStreamInfo> avatar_stream_info; // Map from avatar UID to AvatarVoiceStreamInfo for that avatar.
 
-	try
+static const double PLAYOUT_PERIOD = 0.005; // Play out (or conceal) frames at least this often while jitter buffers have packets pending.
+static const double IDLE_WAIT_PERIOD = 0.1; // Check for avatar audio source changes at least this often while no packets are pending.
+
+
+// Decode frames that are ready to be played out from the jitter buffer, and append the decoded audio to the avatar audio source buffer.
+static void playOutVoiceFrames(AvatarVoiceStreamInfo& stream_info, double cur_time, std::vector<float>& pcm_buffer, const std::vector<float>& silence_buffer)
+{
+	glare::VoiceJitterBuffer::Frame frame;
+	while(stream_info.jitter_buffer.popFrame(cur_time, frame))
 	{
-		// This DNS lookup has already been done in ClientThread, but it should be cached, so we can efficiently do it again here.
-		const std::vector<IPAddress> server_ips = Networking::doDNSLookup(server_hostname);
-		const IPAddress server_ip_addr = server_ips[0];
+		// "For the PLC and FEC cases, frame_size must be a multiple of 2.5 ms." (https://opus-codec.org/docs/opus_api-1.3.1/group__opus__decoder.html)
+		// We use the frame size of the last packet received as our best guess for the lost frame size.
+		int num_samples_decoded;
+		if(frame.type == glare::VoiceJitterBuffer::FrameType_Packet)
+			num_samples_decoded = opus_decode_float(stream_info.opus_decoder, frame.data, (int32)frame.data_size, pcm_buffer.data(), (int)pcm_buffer.size(), /*decode_fec=*/0);
+		else if(frame.type == glare::VoiceJitterBuffer::FrameType_FEC) // Recover lost frame from FEC data in the following packet.  If the packet doesn't have FEC data, Opus does loss concealment.
+			num_samples_decoded = opus_decode_float(stream_info.opus_decoder, frame.data, (int32)frame.data_size, pcm_buffer.data(), stream_info.last_frame_num_samples, /*decode_fec=*/1);
+		else // "Lost packets can be replaced with loss concealment by calling the decoder with a null pointer and zero length for the missing packet."
+			num_samples_decoded = opus_decode_float(stream_info.opus_decoder, NULL, 0, pcm_buffer.data(), stream_info.last_frame_num_samples, /*decode_fec=*/0);
+
+		if(num_samples_decoded < 0)
+		{
+			conPrint("Opus decoding failed: " + toString(num_samples_decoded));
+			continue;
+		}
 
-		std::vector<uint8> packet_buf(4096);
-		std::vector<float> pcm_buffer(480);
+		// Get max abs value in decoded buffer
+		float max_val = 0;
+		for(int i=0; i<num_samples_decoded; ++i)
+			max_val = myMax(max_val, std::fabs(pcm_buffer[i]));
 
-		while(die == 0)
+		// Append to audio source buffer
+		glare::AudioSource* source = stream_info.avatar_audio_source.ptr();
+		Lock lock(source->source_mutex);
+
+		// The audio source buffer is the playout buffer.  Try and keep target_delay worth of audio queued in it, so that jitter in packet arrival times doesn't cause underruns.
+		const size_t target_num_buffered = (size_t)(stream_info.jitter_buffer.getTargetDelay() * stream_info.sampling_rate);
+
+		// At the start of a talkspurt, if the buffer has run dry, queue up some silence first.
+		if(frame.discontinuity && source->buffer.size() < target_num_buffered)
+			source->buffer.pushBackNItems(silence_buffer.data(), myMin(target_num_buffered - source->buffer.size(), silence_buffer.size()));
+
+		// If too much data is queued up for this audio source (e.g. after a burst of delayed packets arrived), drop audio to get back to the target delay.
+		const size_t max_num_buffered = target_num_buffered + stream_info.sampling_rate / 10; // Allow 100 ms over the target delay.
+		if(source->buffer.size() > max_num_buffered)
 		{
-			IPAddress sender_ip_addr;
-			int sender_port;
-			const size_t packet_len = udp_socket->readPacket(packet_buf.data(), packet_buf.size(), sender_ip_addr, sender_port);
+			const size_t num_samples_to_remove = source->buffer.size() - target_num_buffered;
+			conPrint("Audio source buffer too full, removing " + toString(num_samples_to_remove) + " samples");
 
-			// conPrint("ClientUDPHandlerThread: Received packet of length " + toString(packet_len) + " from " + sender_ip_addr.toString() + ", port " + toString(sender_port));
+			source->buffer.popFrontNItems(num_samples_to_remove);
+		}
 
-			// See if the local avatar list has changed.
-			if(world_state->avatars_changed)
-			{
-				Lock lock(world_state->mutex);
+		source->buffer.pushBackNItems(pcm_buffer.data(), num_samples_decoded);
 
-				for(auto it = world_state->avatars.begin(); it != world_state->avatars.end(); ++it)
-				{
-					Avatar* av = it->second.ptr();
+		source->smoothed_cur_level = myMax(source->smoothed_cur_level * 0.95f, max_val);
+	}
+}
 
-					// If there is an avatar not in our avatar_stream_info map, that has an audio source, add it to our map.
-					// If we are already have stream info, but stream IDs differ: this indicates a new stream has been created.  We need to reset the expected next sequence number.  We will also recreate the Opus decoder in this case.
-					bool create_stream_info = false; // Should we (re)create stream info for this avatar?
-					if(av->audio_source.nonNull())
-					{
-						auto info_res = avatar_stream_info.find((uint32)av->uid.value());
-						if(info_res == avatar_stream_info.end())
-							create_stream_info = true;
-						else // Else if we already have stream info for this avatar:
-						{
-							AvatarVoiceStreamInfo& stream_info = info_res->second;
-							if(stream_info.stream_id != av->audio_stream_id) // But the stream ID is different:
-							{
-								if(stream_info.opus_decoder)
-								{
-									conPrint("Stream ID changed, destroying existing Opus decoder.");
-									opus_decoder_destroy(stream_info.opus_decoder);
-								}
-								create_stream_info = true;
-							}
-						}
-					}
 
-					if(create_stream_info)
-					{
-						const uint32 sampling_rate = av->audio_stream_sampling_rate;
+/*=====================================================================
+VoicePlayoutThread
+------------------
+Owns the per-avatar Opus decoders and jitter buffers.
+Voice packets are passed to this thread from the ClientUDPHandlerThread as VoicePacketReceivedMessages.
+Waits on the message queue with a timeout, so that while jitter buffers have packets pending, frames
+are played out or concealed on time, even if no more packets arrive.
+=====================================================================*/
+class VoicePlayoutThread : public MessageableThread
+{
+public:
+	VoicePlayoutThread(WorldState* world_state_) : world_state(world_state_) {}
 
-						conPrint("Creating Opus decoder for avatar, sampling_rate: " + toString(sampling_rate));
+	virtual void doRun() override;
 
-						int opus_error = 0;
-						OpusDecoder* opus_decoder = opus_decoder_create(
-							sampling_rate, // sampling rate
-							1, // channels
-							&opus_error
-						);
-						if(opus_error != OPUS_OK)
-							throw glare::Exception("opus_decoder_create failed.");
+private:
+	void updateStreamInfoForAvatars();
+	void insertPacket(const VoicePacketReceivedMessage& msg);
 
-						avatar_stream_info[(uint32)av->uid.value()] = AvatarVoiceStreamInfo({av->audio_source, opus_decoder, sampling_rate, /*stream_id=*/av->audio_stream_id, /*next_seq_num_expected=*/0});
-					}
-				}
+	WorldState* world_state;
+	std::unordered_map<uint32, AvatarVoiceStreamInfo> avatar_stream_info; // Map from avatar UID to AvatarVoiceStreamInfo for that avatar.
+	std::vector<float> pcm_buffer;
+};
 
-				for(auto it = avatar_stream_info.begin(); it != avatar_stream_info.end();)
-				{
-					const UID avatar_uid(it->first);
 
-					bool remove = false;
-					auto res = world_state->avatars.find(avatar_uid);
-					if(res == world_state->avatars.end()) // If the avatar no longer exists:
-						remove = true;
-					else
-					{
-						Avatar* avatar = res->second.ptr();
-						if(avatar->audio_source.isNull()) // If the avatar audio source has been removed:
-							remove = true;
-					}
+// Create or destroy stream info (and Opus decoders) for avatars whose audio sources have been added or removed.
+void VoicePlayoutThread::updateStreamInfoForAvatars()
+{
+	Lock lock(world_state->mutex);
+
+	for(auto it = world_state->avatars.begin(); it != world_state->avatars.end(); ++it)
+	{
+		Avatar* av = it->second.ptr();
 
-					if(remove)
+		// If there is an avatar not in our avatar_stream_info map, that has an audio source, add it to our map.
+		// If we are already have stream info, but stream IDs differ: this indicates a new stream has been created.  We need to reset the jitter buffer.  We will also recreate the Opus decoder in this case.
+		bool create_stream_info = false; // Should we (re)create stream info for this avatar?
+		if(av->audio_source.nonNull())
+		{
+			auto info_res = avatar_stream_info.find((uint32)av->uid.value());
+			if(info_res == avatar_stream_info.end())
+				create_stream_info = true;
+			else // Else if we already have stream info for this avatar:
+			{
+				AvatarVoiceStreamInfo& stream_info = info_res->second;
+				if(stream_info.stream_id != av->audio_stream_id) // But the stream ID is different:
+				{
+					if(stream_info.opus_decoder)
 					{
-						conPrint("Destroying Opus decoder for avatar");
-						opus_decoder_destroy(it->second.opus_decoder);
-						it = avatar_stream_info.erase(it); // Remove from our stream info map
+						conPrint("Stream ID changed, destroying existing Opus decoder.");
+						opus_decoder_destroy(stream_info.opus_decoder);
+						stream_info.opus_decoder = NULL;
 					}
-					else
-						++it;
+					create_stream_info = true;
 				}
+			}
+		}
+
+		if(create_stream_info)
+		{
+			const uint32 sampling_rate = av->audio_stream_sampling_rate;
+
+			conPrint("Creating Opus decoder for avatar, sampling_rate: " + toString(sampling_rate));
+
+			int opus_error = 0;
+			OpusDecoder* opus_decoder = opus_decoder_create(
+				sampling_rate, // sampling rate
+				1, // channels
+				&opus_error
+			);
+			if(opus_error != OPUS_OK)
+				throw glare::Exception("opus_decoder_create failed.");
+
+			AvatarVoiceStreamInfo& stream_info = avatar_stream_info[(uint32)av->uid.value()];
+			stream_info.avatar_audio_source = av->audio_source;
+			stream_info.opus_decoder = opus_decoder;
+			stream_info.sampling_rate = sampling_rate;
+			stream_info.stream_id = av->audio_stream_id;
+			stream_info.jitter_buffer.reset();
+			stream_info.last_frame_num_samples = (int)sampling_rate / 100; // Default to 10 ms
+		}
+	}
+
+	for(auto it = avatar_stream_info.begin(); it != avatar_stream_info.end();)
+	{
+		const UID avatar_uid(it->first);
+
+		bool remove = false;
+		auto res = world_state->avatars.find(avatar_uid);
+		if(res == world_state->avatars.end()) // If the avatar no longer exists:
+			remove = true;
+		else
+		{
+			Avatar* avatar = res->second.ptr();
+			if(avatar->audio_source.isNull()) // If the avatar audio source has been removed:
+				remove = true;
+		}
+
+		if(remove)
+		{
+			conPrint("Destroying Opus decoder for avatar");
+			opus_decoder_destroy(it->second.opus_decoder);
+			it = avatar_stream_info.erase(it); // Remove from our stream info map
+		}
+		else
+			++it;
+	}
 
-				world_state->avatars_changed = 0;
+	world_state->avatars_changed = 0;
+}
+
+
+void VoicePlayoutThread::insertPacket(const VoicePacketReceivedMessage& msg)
+{
+	// Lookup VoiceChatStreamInfo from avatar_id
+	auto res = avatar_stream_info.find(msg.avatar_id);
+	if(res == avatar_stream_info.end())
+	{
+		// conPrint("Received voice packet for avatar without streaming context. UID: " + toString(msg.avatar_id));
+		return;
+	}
+
+	AvatarVoiceStreamInfo& stream_info = res->second;
+
+	//conPrint("Received voice packet for avatar (UID: " + toString(msg.avatar_id) + ", seq num: " + toString(msg.seq_num) + ")");
+
+	// Senders may use different frame durations (10 - 60 ms), so get the frame size from the packet.
+	const int frame_num_samples = opus_packet_get_nb_samples(msg.opus_packet.data(), (opus_int32)msg.opus_packet.size(), (opus_int32)stream_info.sampling_rate);
+	if(frame_num_samples <= 0 || frame_num_samples > (int)pcm_buffer.size())
+		conPrint("Invalid Opus packet: " + toString(frame_num_samples));
+	else
+	{
+		stream_info.jitter_buffer.insertPacket(msg.seq_num, msg.opus_packet.data(), msg.opus_packet.size(), /*frame duration=*/(double)frame_num_samples / stream_info.sampling_rate, /*arrival time=*/msg.arrival_time);
+		stream_info.last_frame_num_samples = frame_num_samples;
+	}
+}
+
+
+void VoicePlayoutThread::doRun()
+{
+	PlatformUtils::setCurrentThreadNameIfTestsEnabled("VoicePlayoutThread");
+
+	try
+	{
+		pcm_buffer.resize(5760); // Max Opus frame size is 120 ms, = 5760 samples at 48 khz.
+		const std::vector<float> silence_buffer(9600, 0.f); // 200 ms at 48 khz
+
+		bool frames_pending = false;
+		while(1)
+		{
+			// Block until we get a message, or until it's time to play out pending frames.
+			ThreadMessageRef msg;
+			const bool got_msg = getMessageQueue().dequeueWithTimeout(/*wait_time_seconds=*/frames_pending ? PLAYOUT_PERIOD : IDLE_WAIT_PERIOD, msg);
+
+			// See if the local avatar list has changed.
+			if(world_state->avatars_changed)
+				updateStreamInfoForAvatars();
+
+			if(got_msg)
+			{
+				if(msg.isType<KillThreadMessage>())
+					break;
+				else if(msg.isType<VoicePacketReceivedMessage>())
+					insertPacket(*msg.downcastToPtr<VoicePacketReceivedMessage>());
 			}
 
+			// Play out any frames that are ready.  This is done after every message, and periodically while frames are pending,
+			// so that lost frames are concealed and buffered frames are played out even if no more voice packets arrive.
+			const double cur_time = Clock::getTimeSinceInit();
+			frames_pending = false;
+			for(auto it = avatar_stream_info.begin(); it != avatar_stream_info.end(); ++it)
+			{
+				if(it->second.jitter_buffer.hasBufferedPackets())
+				{
+					playOutVoiceFrames(it->second, cur_time, pcm_buffer, silence_buffer);
+					frames_pending = frames_pending || it->second.jitter_buffer.hasBufferedPackets();
+				}
+			}
+		}
+	}
+	catch(glare::Exception& e)
+	{
+		conPrint("VoicePlayoutThread: glare::Exception: " + e.what());
+	}
+	catch(std::bad_alloc&)
+	{
+		conPrint("VoicePlayoutThread: Caught std::bad_alloc.");
+	}
+
+	// Destroy Opus decoders
+	for(auto it = avatar_stream_info.begin(); it != avatar_stream_info.end(); ++it)
+		opus_decoder_destroy(it->second.opus_decoder);
+	avatar_stream_info.clear();
+}
+
+
+void ClientUDPHandlerThread::doRun()
+{
+	PlatformUtils::setCurrentThreadNameIfTestsEnabled("ClientUDPHandlerThread");
+
+	ThreadManager playout_thread_manager;
+	Reference<VoicePlayoutThread> playout_thread = new VoicePlayoutThread(world_state);
+	playout_thread_manager.addThread(playout_thread);
+
+	try
+	{
+		// This DNS lookup has already been done in ClientThread, but it should be cached, so we can efficiently do it again here.
+		const std::vector<IPAddress> server_ips = Networking::doDNSLookup(server_hostname);
+		const IPAddress server_ip_addr = server_ips[0];
+
+		std::vector<uint8> packet_buf(4096);
+
+		while(die == 0)
+		{
+			IPAddress sender_ip_addr;
+			int sender_port;
+			const size_t packet_len = udp_socket->readPacket(packet_buf.data(), packet_buf.size(), sender_ip_addr, sender_port);
+
+			// conPrint("ClientUDPHandlerThread: Received packet of length " + toString(packet_len) + " from " + sender_ip_addr.toString() + ", port " + toString(sender_port));
 
 			if(sender_ip_addr == server_ip_addr)
 			{
@@ -159,101 +351,17 @@ void ClientUDPHandlerThread::doRun()
 					std::memcpy(&type, packet_buf.data(), 4);
 					if(type == 1) // If packet has voice type:
 					{
-						if(packet_len >= 12)
+						const size_t packet_header_size_B = 12;
+						if(packet_len >= packet_header_size_B)
 						{
-							uint32 avatar_id;
-							std::memcpy(&avatar_id, packet_buf.data() + 4, 4);
-
-							// Lookup VoiceChatStreamInfo from avatar_id
-							auto res = avatar_stream_info.find(avatar_id);
-							if(res != avatar_stream_info.end())
-							{
-								AvatarVoiceStreamInfo* stream_info = &res->second;
-
-								uint32 rcvd_seq_num;
-								std::memcpy(&rcvd_seq_num, packet_buf.data() + 8, 4);
-
-								//conPrint("Received voice packet for avatar (UID: " + toString(avatar_id) + ", seq num: " + toString(rcvd_seq_num) + ")");
-
-								if(rcvd_seq_num < stream_info->next_seq_num_expected)
-								{
-									// Discard packet
-									conPrint("Discarding packet.");
-								}
-								else // else seq_num >= next_seq_num_expected
-								{
-									/*
-									while(next_seq_num_expected < rcvd_seq_num)
-									{
-										conPrint("Packet was missed, doing loss concealment...");
-										// We received a packet with a sequence number (rcvd_seq_num) greater than the one we were expecting (next_seq_num_expected).  Treat the packets with sequence number < rcvd_seq_num as lost.
-										// Tell Opus we had a missing packet.
-										// "Lost packets can be replaced with loss concealment by calling the decoder with a null pointer and zero length for the missing packet."  https://opus-codec.org/docs/opus_api-1.3.1/group__opus__decoder.html
-
-										// "For the PLC and FEC cases, frame_size must be a multiple of 2.5 ms."
-										// at 48000 hz, 1 sample = 1 / 48000 s^-1 = 2.08333 e-5 s
-										// samples per 2.5 ms = 0.0025 s / 2.08333 e-5 s = 120
-										const int num_samples_decoded = opus_decode_float(stream_info->opus_decoder, NULL, 0, pcm_buffer.data(), 480,//(int)pcm_buffer.size(), 
-											0 // decode_fec
-										);
-										if(num_samples_decoded < 0)
-										{
-											conPrint("Opus decoding failed: " + toString(num_samples_decoded));
-										}
-										next_seq_num_expected++;
-									}
-									assert(rcvd_seq_num == next_seq_num_expected);
-									*/
-
-									// Decode opus packet into pcm_buffer
-									const size_t packet_header_size_B = 12;
-									const size_t opus_packet_len = packet_len - packet_header_size_B;
-									const int num_samples_decoded = opus_decode_float(stream_info->opus_decoder, packet_buf.data() + packet_header_size_B, (int32)opus_packet_len, pcm_buffer.data(), (int)pcm_buffer.size(), 
-										0 // decode_fec
-									);
-									if(num_samples_decoded < 0)
-										conPrint("Opus decoding failed: " + toString(num_samples_decoded));
-									else
-									{
-										// We are using 10ms frames, so expect sampling_rate * 0.01 samples.
-										if(num_samples_decoded != (int)stream_info->sampling_rate / 100)
-											conPrint("Unexpected number of samples");
-										else
-										{
-											// Get max abs value in decoded buffer
-											float max_val = 0;
-											for(int i=0; i<num_samples_decoded; ++i)
-												max_val = myMax(max_val, std::fabs(pcm_buffer[i]));
-											//printVar(max_val);
-
-											// Append to audio source buffer
-											Lock lock(audio_engine->mutex);
-
-											// If too much data is queued up for this audio source:
-											if(stream_info->avatar_audio_source->buffer.size() > 4096) // 4096 samples ~= 85 ms at 48 khz
-											{
-												// Pop all but 2048 items from the buffer.
-												const size_t num_samples_to_remove = stream_info->avatar_audio_source->buffer.size() - 2048;
-												conPrint("Audio source buffer too full, removing " + toString(num_samples_to_remove) + " samples");
-
-												stream_info->avatar_audio_source->buffer.popFrontNItems(num_samples_to_remove);
-											}
-
-											stream_info->avatar_audio_source->buffer.pushBackNItems(pcm_buffer.data(), num_samples_decoded);
-
-											stream_info->avatar_audio_source->smoothed_cur_level = myMax(stream_info->avatar_audio_source->smoothed_cur_level * 0.95f, max_val);
-										}
-
-										// conPrint("ClientUDPHandlerThread: decoded " + toString(num_samples_decoded) + " samples.");
-
-										stream_info->next_seq_num_expected++;
-									}
-								}
-							}
-							else
-							{
-								// conPrint("Received voice packet for avatar without streaming context. UID: " + toString(avatar_id));
-							}
+							// Pass the packet to the playout thread.
+							Reference<VoicePacketReceivedMessage> msg = new VoicePacketReceivedMessage();
+							std::memcpy(&msg->avatar_id, packet_buf.data() + 4, 4);
+							std::memcpy(&msg->seq_num,   packet_buf.data() + 8, 4);
+							msg->opus_packet.assign(packet_buf.data() + packet_header_size_B, packet_buf.data() + packet_len);
+							msg->arrival_time = Clock::getTimeSinceInit();
+
+							playout_thread->getMessageQueue().enqueue(msg);
 						}
 					}
 				}
@@ -279,9 +387,7 @@ void ClientUDPHandlerThread::doRun()
 		conPrint("ClientUDPHandlerThread: Caught std::bad_alloc.");
 	}
 
-	// Destroy Opus decoders
-	for(auto it = avatar_stream_info.begin(); it != avatar_stream_info.end(); ++it)
-		opus_decoder_destroy(it->second.opus_decoder);
+	playout_thread_manager.killThreadsBlocking();
 
 	udp_socket = NULL;
 }
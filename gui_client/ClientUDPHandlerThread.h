@@ -23,6 +23,12 @@ class WorldState;
 /*=====================================================================
 ClientUDPHandlerThread
 ----------------------
+Receives voice packets from the server, and passes them to a VoicePlayoutThread,
+which plays them out through the per-avatar jitter buffers.
+
+The playout thread is separate so that it can wait on its message queue with a timeout,
+and so play out or conceal frames on time even if no more packets arrive,
+while this thread blocks in readPacket().
 =====================================================================*/
 class ClientUDPHandlerThread : public MessageableThread
 {
@@ -0,0 +1,229 @@
+/*=====================================================================
+DistanceBandQueue.cpp
+---------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#include "DistanceBandQueue.h"
+
+
+#if BUILD_TESTS
+
+
+#include <utils/TestUtils.h>
+#include <utils/ConPrint.h>
+#include <utils/Timer.h>
+#include <utils/StringUtils.h>
+#include <utils/SmallVector.h>
+#include <maths/PCG32.h>
+#include <maths/vec3.h>
+
+
+struct DistanceBandQueueTestPosInfo
+{
+	Vec3f pos;
+	float size_factor;
+};
+
+struct DistanceBandQueueTestItem
+{
+	GLARE_ALIGNED_16_NEW_DELETE
+
+	SmallVector<DistanceBandQueueTestPosInfo, 4> pos_info;
+	int id;
+	float priority;
+	DistanceBandQueueItemInfo band_queue_info;
+};
+
+typedef DistanceBandQueue<DistanceBandQueueTestItem> TestQueue;
+
+
+static DistanceBandQueueTestItem* makeTestItem(int id, const Vec3f& pos, float size_factor)
+{
+	DistanceBandQueueTestItem* item = new DistanceBandQueueTestItem();
+	item->pos_info.resize(1);
+	item->pos_info[0].pos = pos;
+	item->pos_info[0].size_factor = size_factor;
+	item->id = id;
+	return item;
+}
+
+
+// Check that every item dequeued is in the same band or a lower band than all items left in the queue, when priorities are computed exactly for the current camera position.
+static void checkDequeueOrder(TestQueue& queue, const Vec4f& campos)
+{
+	int last_band = 0;
+	while(!queue.empty())
+	{
+		DistanceBandQueueTestItem item;
+		queue.dequeueFront(item);
+		const int band = TestQueue::bandForPriority(TestQueue::computePriority(item, campos));
+		testAssert(band >= last_band);
+		last_band = band;
+	}
+}
+
+
+void testDistanceBandQueue()
+{
+	conPrint("testDistanceBandQueue()");
+
+	//-------------------- Test band computation --------------------
+	{
+		testAssert(TestQueue::bandForPriority(0.f) == 0);
+		testAssert(TestQueue::bandForPriority(0.99f) == 0);
+		testAssert(TestQueue::bandForPriority(1.f) == 1);
+		testAssert(TestQueue::bandForPriority(std::numeric_limits<float>::quiet_NaN()) == 0);
+		testAssert(TestQueue::bandForPriority(std::numeric_limits<float>::infinity()) == TestQueue::NUM_BANDS - 1);
+		testAssert(TestQueue::bandForPriority(1.0e30f) == TestQueue::NUM_BANDS - 1);
+
+		for(int b=1; b<TestQueue::NUM_BANDS - 1; ++b)
+		{
+			const float lower = TestQueue::bandLowerBound(b);
+			const float upper = TestQueue::bandUpperBound(b);
+			testAssert(TestQueue::bandForPriority(lower * 1.0001f) == b);
+			testAssert(TestQueue::bandForPriority(upper * 0.9999f) == b);
+		}
+	}
+
+	//-------------------- Test basic ordering --------------------
+	{
+		TestQueue queue;
+		queue.insert(makeTestItem(0, Vec3f(100, 0, 0), 1.f));
+		queue.insert(makeTestItem(1, Vec3f(10, 0, 0), 1.f));
+		queue.insert(makeTestItem(2, Vec3f(1000, 0, 0), 1.f));
+		testAssert(queue.size() == 3);
+
+		DistanceBandQueueTestItem item;
+		queue.dequeueFront(item);
+		testAssert(item.id == 1);
+		queue.dequeueFront(item);
+		testAssert(item.id == 0);
+		queue.dequeueFront(item);
+		testAssert(item.id == 2);
+		testAssert(queue.empty());
+	}
+
+	//-------------------- Test that camera movement changes ordering --------------------
+	{
+		TestQueue queue;
+		queue.insert(makeTestItem(0, Vec3f(0, 0, 0), 1.f));
+		queue.insert(makeTestItem(1, Vec3f(1000, 0, 0), 1.f));
+
+		queue.updatePriorities(Vec4f(1000, 10, 0, 1));
+
+		DistanceBandQueueTestItem item;
+		queue.dequeueFront(item);
+		testAssert(item.id == 1);
+	}
+
+	//-------------------- Test itemPosInfoChanged --------------------
+	{
+		TestQueue queue;
+		DistanceBandQueueTestItem* item_0 = makeTestItem(0, Vec3f(1000, 0, 0), 1.f);
+		queue.insert(item_0);
+		queue.insert(makeTestItem(1, Vec3f(100, 0, 0), 1.f));
+
+		// Add a closer position for item 0
+		DistanceBandQueueTestPosInfo new_pos_info;
+		new_pos_info.pos = Vec3f(5, 0, 0);
+		new_pos_info.size_factor = 1.f;
+		item_0->pos_info.push_back(new_pos_info);
+		queue.itemPosInfoChanged(item_0);
+
+		DistanceBandQueueTestItem item;
+		queue.dequeueFront(item);
+		testAssert(item.id == 0);
+	}
+
+	//-------------------- Test random insertions and camera movement against exact priorities --------------------
+	{
+		PCG32 rng(1);
+		TestQueue queue;
+		Vec4f campos(0, 0, 0, 1);
+		for(int i=0; i<10000; ++i)
+		{
+			const Vec3f pos((rng.unitRandom() - 0.5f) * 2000.f, (rng.unitRandom() - 0.5f) * 2000.f, rng.unitRandom() * 100.f);
+			queue.insert(makeTestItem(i, pos, 1.f / (1.f + rng.unitRandom() * 10.f)));
+
+			if(i % 100 == 0)
+			{
+				campos += Vec4f(rng.unitRandom() * 20.f, rng.unitRandom() * 20.f, 0, 0); // Move camera
+				queue.updatePriorities(campos);
+			}
+
+			if(i % 10 == 0) // Dequeue some items, to test deletion of items that still have recheck entries.
+			{
+				DistanceBandQueueTestItem item;
+				queue.dequeueFront(item);
+			}
+		}
+
+		// Items with priorities near band boundaries may be up to DISTANCE_BAND_QUEUE_MIN_RECHECK_DIST of camera travel out of date,
+		// so just do one final large move, that will exceed the min recheck distance.
+		campos += Vec4f(300, 0, 0, 0);
+		queue.updatePriorities(campos);
+		checkDequeueOrder(queue, campos);
+	}
+
+	//-------------------- Test clear with dequeued items that still have recheck entries --------------------
+	{
+		TestQueue queue;
+		for(int i=0; i<100; ++i)
+			queue.insert(makeTestItem(i, Vec3f((float)i * 10, 0, 0), 1.f));
+		for(int i=0; i<50; ++i)
+		{
+			DistanceBandQueueTestItem item;
+			queue.dequeueFront(item);
+		}
+		testAssert(queue.size() == 50);
+		testAssert(queue.numRecheckEntries() >= 50);
+		queue.clear();
+		testAssert(queue.empty() && queue.numRecheckEntries() == 0);
+	}
+
+	//-------------------- Test heap compaction with stationary camera --------------------
+	{
+		TestQueue queue;
+		for(int i=0; i<10000; ++i)
+		{
+			queue.insert(makeTestItem(i, Vec3f((float)i, 0, 0), 1.f));
+			DistanceBandQueueTestItem item;
+			queue.dequeueFront(item);
+			queue.updatePriorities(Vec4f(0, 0, 0, 1));
+		}
+		testAssert(queue.numRecheckEntries() <= 1024 + 1);
+	}
+
+	// Performance test
+	if(false)
+	{
+		PCG32 rng(1);
+		const int N = 50000;
+		TestQueue queue;
+		for(int i=0; i<N; ++i)
+			queue.insert(makeTestItem(i, Vec3f((rng.unitRandom() - 0.5f) * 4000.f, (rng.unitRandom() - 0.5f) * 4000.f, rng.unitRandom() * 100.f), 1.f));
+
+		Timer timer;
+		Vec4f campos(0, 0, 0, 1);
+		const int num_frames = 1000;
+		for(int f=0; f<num_frames; ++f)
+		{
+			campos += Vec4f(1.f, 0.5f, 0, 0); // About 1 m per frame
+			queue.updatePriorities(campos);
+		}
+		conPrint("updatePriorities: " + doubleToStringNSigFigs(timer.elapsed() / num_frames * 1.0e6, 4) + " us per frame for " + toString(N) + " items");
+
+		timer.reset();
+		while(!queue.empty())
+		{
+			DistanceBandQueueTestItem item;
+			queue.dequeueFront(item);
+		}
+		conPrint("dequeueFront: " + doubleToStringNSigFigs(timer.elapsed() / N * 1.0e9, 4) + " ns per item");
+	}
+
+	conPrint("testDistanceBandQueue() done.");
+}
+
+
+#endif // BUILD_TESTS
@@ -0,0 +1,375 @@
+/*=====================================================================
+DistanceBandQueue.h
+-------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#pragma once
+
+
+#include <maths/Vec4f.h>
+#include <maths/mathstypes.h>
+#include <utils/Platform.h>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cassert>
+
+
+// Bookkeeping data stored in each item of a DistanceBandQueue.
+struct DistanceBandQueueItemInfo
+{
+	DistanceBandQueueItemInfo() : band(-1), index_in_band(0), recheck_version(0), num_recheck_entries(0), in_queue(false) {}
+
+	int band;
+	uint32 index_in_band;
+	uint32 recheck_version;
+	uint32 num_recheck_entries; // Number of entries in the recheck heap that refer to this item.
+	bool in_queue;
+};
+
+
+/*=====================================================================
+DistanceBandQueue
+-----------------
+Approximate priority queue for items with positions, where the priority of an item is
+    min over item positions i of (distance from camera to position i) * size_factor_i
+Lower priority values are dequeued first.
+
+Items are stored in bands of priority, with BANDS_PER_OCTAVE bands per doubling of priority.
+Dequeueing takes the last item from the lowest non-empty band, so is O(1).
+Items within a band are not ordered.
+
+When the camera moves by distance d, the priority of an item can change by at most d * (max size factor of item).
+So when an item is evaluated, we compute how far the camera can travel before the item could move out of its band,
+and schedule a recheck of the item after the camera has travelled that far (using a min-heap keyed by camera travel distance).
+This means that updatePriorities() only re-evaluates the items that may have changed band, instead of all items.
+
+ItemType must have members
+    pos_info            (array of elements with Vec3f pos and float size_factor)
+    float priority
+    DistanceBandQueueItemInfo band_queue_info
+
+The queue owns inserted items, and deletes them when they are dequeued or the queue is cleared.
+Not thread-safe.
+=====================================================================*/
+template <class ItemType>
+class DistanceBandQueue
+{
+public:
+	static const int NUM_BANDS = 64;
+	static const int BANDS_PER_OCTAVE = 4;
+
+	DistanceBandQueue();
+	~DistanceBandQueue();
+
+	// Computes priority of item at the last camera position, and adds it to the queue.  Takes ownership of item.
+	void insert(ItemType* item);
+
+	// Should be called after the pos_info of an item in the queue has changed.
+	void itemPosInfoChanged(ItemType* item);
+
+	// Copies the item with (approximately) the lowest priority value to item_out and removes it from the queue.  Queue must not be empty.
+	void dequeueFront(ItemType& item_out);
+
+	// Re-evaluates priorities of items that may have changed band due to camera movement.
+	void updatePriorities(const Vec4f& campos);
+
+	void clear();
+
+	size_t size() const { return num_items; }
+	bool empty() const { return num_items == 0; }
+
+	size_t numRecheckEntries() const { return recheck_heap.size(); } // For testing
+
+	static float computePriority(const ItemType& item, const Vec4f& campos);
+	static int bandForPriority(float priority);
+	static float bandLowerBound(int band);
+	static float bandUpperBound(int band);
+
+private:
+	GLARE_DISABLE_COPY(DistanceBandQueue);
+
+	struct RecheckEntry
+	{
+		double due_travel; // Recheck item when total_travel >= due_travel.
+		ItemType* item;
+		uint32 recheck_version;
+	};
+	struct RecheckEntryComparator
+	{
+		bool operator() (const RecheckEntry& a, const RecheckEntry& b) const { return a.due_travel > b.due_travel; } // Makes a min-heap on due_travel.
+	};
+
+	void evaluateItem(ItemType* item);
+	void addToBand(ItemType* item, int band);
+	void removeFromBand(ItemType* item);
+	void scheduleRecheck(ItemType* item);
+	void releaseRecheckEntry(ItemType* item);
+	void compactRecheckHeap();
+
+	std::vector<ItemType*> bands[NUM_BANDS];
+	int lowest_nonempty_band; // All bands with index < lowest_nonempty_band are empty.
+	size_t num_items;
+
+	std::vector<RecheckEntry> recheck_heap;
+	double total_travel; // Total distance camera has moved, as passed to updatePriorities().
+	Vec4f last_campos;
+};
+
+
+// Don't recheck items more often than this (in metres of camera travel), to avoid rechecking items right at band boundaries on every update.
+static const float DISTANCE_BAND_QUEUE_MIN_RECHECK_DIST = 1.0f;
+
+
+void testDistanceBandQueue();
+
+
+template <class ItemType>
+DistanceBandQueue<ItemType>::DistanceBandQueue()
+:	lowest_nonempty_band(NUM_BANDS),
+	num_items(0),
+	total_travel(0),
+	last_campos(0, 0, 0, 1)
+{}
+
+
+template <class ItemType>
+DistanceBandQueue<ItemType>::~DistanceBandQueue()
+{
+	clear();
+}
+
+
+template <class ItemType>
+float DistanceBandQueue<ItemType>::computePriority(const ItemType& item, const Vec4f& campos)
+{
+	const Vec4f campos_zero_w = maskWToZero(campos);
+
+	assert(item.pos_info.size() >= 1);
+	float smallest_priority = std::numeric_limits<float>::infinity();
+	for(size_t z=0; z<item.pos_info.size(); ++z)
+	{
+		const float pos_info_z_priority = campos_zero_w.getDist(maskWToZero(loadUnalignedVec4f(&item.pos_info[z].pos.x))) * item.pos_info[z].size_factor;
+		smallest_priority = myMin(smallest_priority, pos_info_z_priority);
+	}
+	return smallest_priority;
+}
+
+
+// Band 0 holds priorities < 1.  Band b > 0 holds priorities in [2^((b-1)/BANDS_PER_OCTAVE), 2^(b/BANDS_PER_OCTAVE)), the last band also holds all larger priorities.
+template <class ItemType>
+int DistanceBandQueue<ItemType>::bandForPriority(float priority)
+{
+	if(!(priority >= 1.f)) // Also handles NaN
+		return 0;
+	if(priority == std::numeric_limits<float>::infinity())
+		return NUM_BANDS - 1;
+	const int band = 1 + (int)std::floor(std::log2(priority) * BANDS_PER_OCTAVE);
+	return myClamp(band, 1, NUM_BANDS - 1);
+}
+
+
+template <class ItemType>
+float DistanceBandQueue<ItemType>::bandLowerBound(int band)
+{
+	return (band == 0) ? 0.f : std::exp2((float)(band - 1) / BANDS_PER_OCTAVE);
+}
+
+
+template <class ItemType>
+float DistanceBandQueue<ItemType>::bandUpperBound(int band)
+{
+	return (band == NUM_BANDS - 1) ? std::numeric_limits<float>::infinity() : std::exp2((float)band / BANDS_PER_OCTAVE);
+}
+
+
+template <class ItemType>
+void DistanceBandQueue<ItemType>::addToBand(ItemType* item, int band)
+{
+	item->band_queue_info.band = band;
+	item->band_queue_info.index_in_band = (uint32)bands[band].size();
+	bands[band].push_back(item);
+	lowest_nonempty_band = myMin(lowest_nonempty_band, band);
+}
+
+
+template <class ItemType>
+void DistanceBandQueue<ItemType>::removeFromBand(ItemType* item)
+{
+	std::vector<ItemType*>& band = bands[item->band_queue_info.band];
+	const uint32 index = item->band_queue_info.index_in_band;
+	assert(index < band.size() && band[index] == item);
+
+	// Swap with last item in band and pop back
+	band[index] = band.back();
+	band[index]->band_queue_info.index_in_band = index;
+	band.pop_back();
+
+	item->band_queue_info.band = -1;
+}
+
+
+template <class ItemType>
+void DistanceBandQueue<ItemType>::scheduleRecheck(ItemType* item)
+{
+	float max_size_factor = 0;
+	for(size_t z=0; z<item->pos_info.size(); ++z)
+		max_size_factor = myMax(max_size_factor, item->pos_info[z].size_factor);
+
+	// Compute distance the camera can move before the item priority could leave the current band.
+	const int band = item->band_queue_info.band;
+	const float priority_slack = myMin(item->priority - bandLowerBound(band), bandUpperBound(band) - item->priority);
+	const float travel_slack = (max_size_factor > 0) ? (priority_slack / max_size_factor) : std::numeric_limits<float>::infinity();
+	if(travel_slack == std::numeric_limits<float>::infinity())
+		return; // Item can never change band, so don't need to recheck.
+
+	RecheckEntry entry;
+	entry.due_travel = total_travel + myMax(DISTANCE_BAND_QUEUE_MIN_RECHECK_DIST, travel_slack);
+	entry.item = item;
+	entry.recheck_version = item->band_queue_info.recheck_version;
+	recheck_heap.push_back(entry);
+	std::push_heap(recheck_heap.begin(), recheck_heap.end(), RecheckEntryComparator());
+
+	item->band_queue_info.num_recheck_entries++;
+}
+
+
+// Called when a recheck entry referring to the item is removed from the heap.  Deletes the item if it has been dequeued and there are no other entries referring to it.
+template <class ItemType>
+void DistanceBandQueue<ItemType>::releaseRecheckEntry(ItemType* item)
+{
+	assert(item->band_queue_info.num_recheck_entries > 0);
+	item->band_queue_info.num_recheck_entries--;
+	if(!item->band_queue_info.in_queue && (item->band_queue_info.num_recheck_entries == 0))
+		delete item;
+}
+
+
+template <class ItemType>
+void DistanceBandQueue<ItemType>::evaluateItem(ItemType* item)
+{
+	item->priority = computePriority(*item, last_campos);
+
+	const int new_band = bandForPriority(item->priority);
+	if(new_band != item->band_queue_info.band)
+	{
+		removeFromBand(item);
+		addToBand(item, new_band);
+	}
+
+	scheduleRecheck(item);
+}
+
+
+template <class ItemType>
+void DistanceBandQueue<ItemType>::insert(ItemType* item)
+{
+	item->band_queue_info = DistanceBandQueueItemInfo();
+	item->band_queue_info.in_queue = true;
+	item->priority = computePriority(*item, last_campos);
+	addToBand(item, bandForPriority(item->priority));
+	num_items++;
+
+	scheduleRecheck(item);
+}
+
+
+template <class ItemType>
+void DistanceBandQueue<ItemType>::itemPosInfoChanged(ItemType* item)
+{
+	assert(item->band_queue_info.in_queue);
+
+	item->band_queue_info.recheck_version++; // Invalidate any existing recheck entries for the item.
+	evaluateItem(item);
+}
+
+
+template <class ItemType>
+void DistanceBandQueue<ItemType>::dequeueFront(ItemType& item_out)
+{
+	assert(num_items > 0);
+
+	while(bands[lowest_nonempty_band].empty())
+		lowest_nonempty_band++;
+	assert(lowest_nonempty_band < NUM_BANDS);
+
+	ItemType* item = bands[lowest_nonempty_band].back();
+	removeFromBand(item);
+	num_items--;
+
+	item_out = *item; // Copy to item_out
+
+	item->band_queue_info.in_queue = false;
+	if(item->band_queue_info.num_recheck_entries == 0)
+		delete item;
+	// else item will be deleted when the last recheck entry referring to it is removed from the heap.
+}
+
+
+template <class ItemType>
+void DistanceBandQueue<ItemType>::updatePriorities(const Vec4f& campos)
+{
+	total_travel += maskWToZero(campos).getDist(maskWToZero(last_campos));
+	last_campos = campos;
+
+	while(!recheck_heap.empty() && (recheck_heap.front().due_travel <= total_travel))
+	{
+		std::pop_heap(recheck_heap.begin(), recheck_heap.end(), RecheckEntryComparator());
+		const RecheckEntry entry = recheck_heap.back();
+		recheck_heap.pop_back();
+
+		ItemType* item = entry.item;
+		const bool valid = item->band_queue_info.in_queue && (entry.recheck_version == item->band_queue_info.recheck_version);
+		releaseRecheckEntry(item); // NOTE: may delete item if not in queue
+		if(valid)
+			evaluateItem(item);
+	}
+
+	// Dequeued items with pending recheck entries are kept alive until the entries are removed.  If the camera is not moving much, this may take a long time,
+	// so remove such entries if they make up a large fraction of the heap.
+	if(recheck_heap.size() > 2 * num_items + 1024)
+		compactRecheckHeap();
+}
+
+
+template <class ItemType>
+void DistanceBandQueue<ItemType>::compactRecheckHeap()
+{
+	size_t write_i = 0;
+	for(size_t i=0; i<recheck_heap.size(); ++i)
+	{
+		const RecheckEntry entry = recheck_heap[i];
+		ItemType* item = entry.item;
+		if(item->band_queue_info.in_queue && (entry.recheck_version == item->band_queue_info.recheck_version))
+			recheck_heap[write_i++] = entry;
+		else
+			releaseRecheckEntry(item);
+	}
+	recheck_heap.resize(write_i);
+	std::make_heap(recheck_heap.begin(), recheck_heap.end(), RecheckEntryComparator());
+}
+
+
+template <class ItemType>
+void DistanceBandQueue<ItemType>::clear()
+{
+	// Delete dequeued items that are still referred to by recheck entries.
+	for(size_t i=0; i<recheck_heap.size(); ++i)
+	{
+		ItemType* item = recheck_heap[i].item;
+		if(!item->band_queue_info.in_queue)
+			releaseRecheckEntry(item);
+	}
+	recheck_heap.clear();
+
+	for(int b=0; b<NUM_BANDS; ++b)
+	{
+		for(size_t i=0; i<bands[b].size(); ++i)
+			delete bands[b][i];
+		bands[b].clear();
+	}
+
+	lowest_nonempty_band = NUM_BANDS;
+	num_items = 0;
+}
@@ -7,6 +7,7 @@ Copyright Glare Technologies Limited 2021 -
 
 
 #include "DownloadingResourceQueue.h"
+#include "ResourceDownloadStats.h"
 #include "ThreadMessages.h"
 #include "../shared/Protocol.h"
 #include <MySocket.h>
@@ -20,17 +21,34 @@ Copyright Glare Technologies Limited 2021 -
 #include <KillThreadMessage.h>
 #include <PlatformUtils.h>
 #include <FileOutStream.h>
+#include <cmath>
+#include <limits>
+
+
+static const size_t MIN_BATCH_SIZE = 1;
+static const size_t MAX_BATCH_SIZE = 64;
+static const size_t INITIAL_BATCH_SIZE = 4;
+static const size_t MAX_BATCHES_IN_FLIGHT = 2; // The batch whose responses are being read, plus one more queued at the server.
+static const size_t READ_CHUNK_SIZE = 1 << 16;
+static const uint64 MIN_BANDWIDTH_SAMPLE_BYTES = 1 << 16; // Batches smaller than this are too small to give a useful bandwidth measurement.
+static const double ESTIMATE_SMOOTHING = 0.2; // Weight of new samples in the exponentially weighted moving averages.
 
 
 DownloadResourcesThread::DownloadResourcesThread(ThreadSafeQueue<Reference<ThreadMessage> >* out_msg_queue_, Reference<ResourceManager> resource_manager_, const std::string& hostname_, int port_, 
-	glare::AtomicInt* num_resources_downloading_, struct tls_config* config_, DownloadingResourceQueue* download_queue_)
+	glare::AtomicInt* num_resources_downloading_, struct tls_config* config_, DownloadingResourceQueue* download_queue_, ResourceDownloadStats* stats_, int connection_index_)
 :	out_msg_queue(out_msg_queue_),
 	hostname(hostname_),
 	resource_manager(resource_manager_),
 	port(port_),
 	num_resources_downloading(num_resources_downloading_),
 	config(config_),
-	download_queue(download_queue_)
+	download_queue(download_queue_),
+	stats(stats_),
+	connection_index(connection_index_),
+	bandwidth_estimate(-1),
+	rtt_estimate(-1),
+	mean_file_size_estimate(-1),
+	batch_size(INITIAL_BATCH_SIZE)
 {
 	MySocketRef mysocket = new MySocket();
 	mysocket->setUseNetworkByteOrder(false);
@@ -59,20 +77,6 @@ static bool checkMessageQueue(ThreadSafeQueue<Reference<ThreadMessage> >& queue)
 }
 
 
-// Make sure num_resources_downloading gets decremented even in the presence of exceptions.
-struct NumNonNetResourcesDownloadingDecrementor
-{
-	NumNonNetResourcesDownloadingDecrementor() : num_decrements(0) {}
-	~NumNonNetResourcesDownloadingDecrementor()
-	{
-		// Do any remaining decrements
-		(*num_resources_downloading) -= (max_decrements - num_decrements);
-	}
-	glare::AtomicInt* num_resources_downloading;
-	int max_decrements;
-	int num_decrements;
-};
-
 // Some resources, such as MP4 videos, shouldn't be downloaded fully before displaying, but instead can be streamed and displayed when only part of the stream is downloaded.
 //static bool shouldStreamResource(const std::string& url)
 //{
@@ -154,7 +158,7 @@ void DownloadResourcesThread::doRun()
 		// Read server protocol version
 		/*const uint32 server_protocol_version =*/ socket->readUInt32();
 
-		std::set<std::string> URLs_to_get; // Set of URLs that this thread will get from the server.
+		std::vector<std::string> URLs_to_get; // URLs for the next batch.
 
 		while(1)
 		{
@@ -162,155 +166,290 @@ void DownloadResourcesThread::doRun()
 			{
 				socket->writeInt32(Protocol::CyberspaceGoodbye);
 				socket->startGracefulShutdown(); // Tell sockets lib to send a FIN packet to the server.
+				abortBatchesInFlight();
 				return;
 			}
 
-			if(URLs_to_get.empty())
+			if(batches_in_flight.size() < MAX_BATCHES_IN_FLIGHT)
 			{
-				// Wait until we have something to download, or we get a kill-thread message.
+				// If there are no batches in flight, wait until we have something to download, or we get a kill-thread message.
+				// Otherwise just get any items that are in the queue, without waiting, so we can get back to reading the batch in flight.
+				const double wait_time_s = batches_in_flight.empty() ? 0.1 : 0.0;
+				download_queue->dequeueItemsWithTimeOut(wait_time_s, /*max_num_items=*/batch_size, queue_items);
 
-				download_queue->dequeueItemsWithTimeOut(/*wait_time_s=*/0.1, /*max_num_items=*/4, queue_items);
+				URLs_to_get.clear();
 				for(size_t i=0; i<queue_items.size(); ++i)
 				{
-					if(!resource_manager->isInDownloadFailedURLs(queue_items[i].URL)) // Don't try to re-download if we already failed to download this session.
-						URLs_to_get.insert(queue_items[i].URL);
+					if(resource_manager->isInDownloadFailedURLs(queue_items[i].URL)) // Don't try to re-download if we already failed to download this session.
+						continue;
+
+					ResourceRef resource = resource_manager->getOrCreateResourceForURL(queue_items[i].URL);
+					if(resource->getState() == Resource::State_NotPresent) // If we don't already have the file, and it's not being downloaded by another connection:
+					{
+						resource->setState(Resource::State_Transferring);
+						URLs_to_get.push_back(queue_items[i].URL);
+					}
 				}
 
+				if(!URLs_to_get.empty())
+					sendBatch(URLs_to_get, /*no_batches_in_flight=*/batches_in_flight.empty());
 
 				// Get any more messages from the queue while we're woken up.
 				if(checkMessageQueue(getMessageQueue()))
 				{
 					socket->writeInt32(Protocol::CyberspaceGoodbye);
 					socket->startGracefulShutdown(); // Tell sockets lib to send a FIN packet to the server.
+					abortBatchesInFlight();
 					return; // if got kill message, return.
 				}
 			}
-			else
+
+			if(!batches_in_flight.empty())
 			{
-				for(auto it = URLs_to_get.begin(); it != URLs_to_get.end(); )
+				readBatchResponses(batches_in_flight.front());
+				batches_in_flight.pop_front();
+			}
+		}
+	}
+	catch(MySocketExcep& e)
+	{
+		conPrint("DownloadResourcesThread Socket error: " + e.what());
+	}
+	catch(glare::Exception& e)
+	{
+		conPrint("DownloadResourcesThread glare::Exception: " + e.what());
+	}
+
+	abortBatchesInFlight();
+#endif
+}
+
+
+void DownloadResourcesThread::sendBatch(std::vector<std::string>& URLs, bool no_batches_in_flight)
+{
+	(*this->num_resources_downloading) += URLs.size();
+
+	// Add to batches_in_flight before writing, so that abortBatchesInFlight() handles the URLs if writing fails.
+	batches_in_flight.push_back(DownloadBatch());
+	DownloadBatch& batch = batches_in_flight.back();
+	batch.URLs.swap(URLs);
+	batch.num_URLs_done = 0;
+	batch.sent_with_no_batches_in_flight = no_batches_in_flight;
+
+	socket->writeUInt32(Protocol::GetFiles);
+	socket->writeUInt64(batch.URLs.size()); // Write number of files to get
+
+	for(size_t i=0; i<batch.URLs.size(); ++i)
+	{
+		// conPrint("DownloadResourcesThread: Querying server for file '" + batch.URLs[i] + "'...");
+		socket->writeStringLengthFirst(batch.URLs[i]);
+	}
+
+	batch.time_since_sent.reset();
+}
+
+
+// Read reply, which has an error code for each resource download, followed by the file data if OK.
+// File data is written to disk in chunks as it is received.
+void DownloadResourcesThread::readBatchResponses(DownloadBatch& batch)
+{
+	double rtt_sample = -1;
+	Timer read_timer;
+	uint64 batch_bytes = 0;
+	uint64 batch_num_files = 0;
+
+	for(; batch.num_URLs_done < batch.URLs.size(); )
+	{
+		const std::string& URL = batch.URLs[batch.num_URLs_done];
+		ResourceRef resource = resource_manager->getOrCreateResourceForURL(URL);
+
+		const uint32 result = socket->readUInt32();
+
+		if(batch.num_URLs_done == 0)
+		{
+			if(batch.sent_with_no_batches_in_flight)
+				rtt_sample = batch.time_since_sent.elapsed();
+			read_timer.reset(); // Measure bandwidth from when the first response arrives.
+		}
+
+		if(result == 0) // If OK:
+		{
+			// Download resource
+			const uint64 file_len = socket->readUInt64();
+			if(file_len > 0)
+			{
+				if(file_len > 1000000000)
+					throw glare::Exception("downloaded file too large (len=" + toString(file_len) + ").");
+
+				resource->setState(Resource::State_Transferring);
+
+				if(temp_buf.size() < READ_CHUNK_SIZE)
+					temp_buf.resize(READ_CHUNK_SIZE);
+
+				uint64 offset = 0; // Number of bytes of the resource data read from the socket so far.
+				try
 				{
-					ResourceRef resource = resource_manager->getOrCreateResourceForURL(*it);
-					if(resource->getState() != Resource::State_NotPresent)
+					// Reads the resource data from the socket in chunks, passing each chunk to write_chunk.
+					auto readResourceData = [&](auto write_chunk)
 					{
-						//conPrint("Already have file or downloading file '" + *it + "', not downloading.");
-						auto to_remove = it++;
-						URLs_to_get.erase(to_remove);
+						while(offset < file_len)
+						{
+							const uint64 chunk_size = myMin<uint64>(file_len - offset, READ_CHUNK_SIZE);
+							assert(offset + chunk_size <= file_len);
+							socket->readData(temp_buf.data(), chunk_size);
+							offset += chunk_size;
+							write_chunk(temp_buf.data(), chunk_size);
+
+							if(stats)
+								stats->bytesReceived(chunk_size);
+
+							if(should_die)
+								throw glare::Exception("Interrupted");
+						}
+					};
+
+					const Reference<PackedResourceCache>& packed_cache = resource_manager->getPackedCache();
+					if(packed_cache.nonNull())
+					{
+						// Write directly into the packed cache.
+						PackedResourceCache::Writer writer(*packed_cache, URL, file_len);
+						readResourceData([&](const uint8* data, size_t size) { writer.writeData(data, size); });
+						writer.commit();
 					}
 					else
 					{
-						resource->setState(Resource::State_Transferring);
-						++it;
+						FileOutStream file(resource_manager->getLocalAbsPathForResource(*resource), std::ios::binary | std::ios::trunc); // Remove any existing data in the file
+						readResourceData([&](const uint8* data, size_t size) { file.writeData(data, size); });
+						file.close(); // Manually call close, to check for any errors via failbit.
 					}
-				}
 
-				(*this->num_resources_downloading) += URLs_to_get.size();
-				NumNonNetResourcesDownloadingDecrementor decrementor;
-				decrementor.num_resources_downloading = this->num_resources_downloading;
-				decrementor.max_decrements = (int)URLs_to_get.size();
+					resource->setState(Resource::State_Present);
+					resource_manager->markAsChanged();
 
-				if(!URLs_to_get.empty())
+					out_msg_queue->enqueue(new ResourceDownloadedMessage(URL));
+
+					if(stats)
+						stats->resourceDownloaded(URL, file_len, batch.time_since_sent.elapsed());
+				}
+				catch(glare::Exception& e)
 				{
-					socket->writeUInt32(Protocol::GetFiles);
-					socket->writeUInt64(URLs_to_get.size()); // Write number of files to get
+					resource->setState(Resource::State_NotPresent);
+					resource_manager->markAsChanged();
 
-					for(auto it = URLs_to_get.begin(); it != URLs_to_get.end(); ++it)
-					{
-						const std::string URL = *it;
+					//conPrint("DownloadResourcesThread: Error while writing file to disk: " + e.what());
+					out_msg_queue->enqueue(new LogMessage("DownloadResourcesThread: Error while writing file to disk: " + e.what()));
 
-						// conPrint("DownloadResourcesThread: Querying server for file '" + URL + "'...");
-						socket->writeStringLengthFirst(URL);
-					}
+					// If we didn't read all the resource data, the rest of it is still in the socket stream, so we can't read the next response.
+					// Rethrow to close the connection.  abortBatchesInFlight() will then mark this and the remaining resources in the batches as not present.
+					if(offset < file_len)
+						throw;
+				}
 
-					// Read reply, which has an error code for each resource download.
-					for(auto it = URLs_to_get.begin(); it != URLs_to_get.end(); ++it)
-					{
-						const std::string URL = *it;
-						ResourceRef resource = resource_manager->getOrCreateResourceForURL(URL);
+				batch_bytes += file_len;
+				batch_num_files++;
+			}
 
-						
-						const uint32 result = socket->readUInt32();
-						if(result == 0) // If OK:
-						{
-							// Download resource
-							const uint64 file_len = socket->readUInt64();
-							if(file_len > 0)
-							{
-								if(file_len > 1000000000)
-									throw glare::Exception("downloaded file too large (len=" + toString(file_len) + ").");
-
-								resource->setState(Resource::State_Transferring);
-
-								try
-								{
-									const std::string path = resource_manager->getLocalAbsPathForResource(*resource);
-									{
-										FileOutStream file(path, std::ios::binary | std::ios::trunc); // Remove any existing data in the file
-
-										uint64 offset = 0;
-										const uint64 MAX_CHUNK_SIZE = 1ull << 14;
-										js::Vector<uint8, 16> temp_buf(MAX_CHUNK_SIZE);
-										while(offset < file_len)
-										{
-											const uint64 chunk_size = myMin(file_len - offset, MAX_CHUNK_SIZE);
-											assert(offset + chunk_size <= file_len);
-											socket->readData(temp_buf.data(), chunk_size);
-											file.writeData(temp_buf.data(), chunk_size);
-											offset += chunk_size;
-
-											if(should_die)
-												throw glare::Exception("Interrupted");
-										}
-
-										file.close(); // Manually call close, to check for any errors via failbit.
-									} // End scope for FileOutStream
-
-									resource->setState(Resource::State_Present);
-									resource_manager->markAsChanged();
-
-									out_msg_queue->enqueue(new ResourceDownloadedMessage(URL));
-								}
-								catch(glare::Exception& e)
-								{
-									resource->setState(Resource::State_NotPresent);
-									resource_manager->markAsChanged();
-
-									//conPrint("DownloadResourcesThread: Error while writing file to disk: " + e.what());
-									out_msg_queue->enqueue(new LogMessage("DownloadResourcesThread: Error while writing file to disk: " + e.what()));
-								}
-							}
-
-							//conPrint("DownloadResourcesThread: Got file '" + URL + "'.");
-						}
-						else
-						{
-							resource_manager->addToDownloadFailedURLs(URL);
+			//conPrint("DownloadResourcesThread: Got file '" + URL + "'.");
+		}
+		else
+		{
+			resource_manager->addToDownloadFailedURLs(URL);
 
-							resource->setState(Resource::State_NotPresent);
-							//conPrint("DownloadResourcesThread: Server couldn't send file '" + URL + "' (Result=" + toString(result) + ")");
-							out_msg_queue->enqueue(new LogMessage("Server couldn't send resource '" + URL + "' (resource not found)"));
-						}
+			resource->setState(Resource::State_NotPresent);
+			//conPrint("DownloadResourcesThread: Server couldn't send file '" + URL + "' (Result=" + toString(result) + ")");
+			out_msg_queue->enqueue(new LogMessage("Server couldn't send resource '" + URL + "' (resource not found)"));
+		}
 
-						(*this->num_resources_downloading)--;
-						decrementor.num_decrements++;
-					} // End for each URL
-				}
+		(*this->num_resources_downloading)--;
+		batch.num_URLs_done++;
+	} // End for each URL
 
-				URLs_to_get.clear();
-			}
-		}
-	}
-	catch(MySocketExcep& e)
-	{
-		conPrint("DownloadResourcesThread Socket error: " + e.what());
-	}
-	catch(glare::Exception& e)
+	const double read_time = read_timer.elapsed();
+	const double bandwidth_sample = (batch_bytes >= MIN_BANDWIDTH_SAMPLE_BYTES && read_time > 0) ? (double)batch_bytes / read_time : -1;
+	const double mean_file_size_sample = (batch_num_files > 0) ? (double)batch_bytes / (double)batch_num_files : -1;
+	updateEstimates(bandwidth_sample, rtt_sample, mean_file_size_sample);
+}
+
+
+// Samples are negative if not available.
+void DownloadResourcesThread::updateEstimates(double bandwidth_sample, double rtt_sample, double mean_file_size_sample)
+{
+	if(bandwidth_sample > 0)
+		bandwidth_estimate = (bandwidth_estimate < 0) ? bandwidth_sample : (ESTIMATE_SMOOTHING * bandwidth_sample + (1 - ESTIMATE_SMOOTHING) * bandwidth_estimate);
+	if(rtt_sample > 0)
+		rtt_estimate = (rtt_estimate < 0) ? rtt_sample : (ESTIMATE_SMOOTHING * rtt_sample + (1 - ESTIMATE_SMOOTHING) * rtt_estimate);
+	if(mean_file_size_sample > 0)
+		mean_file_size_estimate = (mean_file_size_estimate < 0) ? mean_file_size_sample : (ESTIMATE_SMOOTHING * mean_file_size_sample + (1 - ESTIMATE_SMOOTHING) * mean_file_size_estimate);
+
+	if(bandwidth_estimate > 0 && rtt_estimate > 0 && mean_file_size_estimate > 0)
+		batch_size = computeBatchSize(bandwidth_estimate, rtt_estimate, mean_file_size_estimate);
+
+	if(stats)
+		stats->connectionStatsUpdated(connection_index, myMax(0.0, bandwidth_estimate), myMax(0.0, rtt_estimate), batch_size);
+}
+
+
+size_t DownloadResourcesThread::computeBatchSize(double bandwidth_B_per_s, double rtt_s, double mean_file_size_B)
+{
+	assert(mean_file_size_B > 0);
+	const double bandwidth_delay_product = bandwidth_B_per_s * rtt_s;
+	const double num_files = std::ceil(bandwidth_delay_product / mean_file_size_B);
+	if(!(num_files >= (double)MIN_BATCH_SIZE)) // Handle NaN also
+		return MIN_BATCH_SIZE;
+	return (size_t)myMin(num_files, (double)MAX_BATCH_SIZE);
+}
+
+
+// Called when the connection is closed or fails.  Marks resources in batches we didn't finish reading as not present, so they can be downloaded again.
+void DownloadResourcesThread::abortBatchesInFlight()
+{
+	for(auto it = batches_in_flight.begin(); it != batches_in_flight.end(); ++it)
 	{
-		conPrint("DownloadResourcesThread glare::Exception: " + e.what());
+		DownloadBatch& batch = *it;
+		for(size_t i=batch.num_URLs_done; i<batch.URLs.size(); ++i)
+		{
+			ResourceRef resource = resource_manager->getOrCreateResourceForURL(batch.URLs[i]);
+			if(resource->getState() == Resource::State_Transferring)
+				resource->setState(Resource::State_NotPresent);
+		}
+
+		(*this->num_resources_downloading) -= (batch.URLs.size() - batch.num_URLs_done);
 	}
-#endif
+	batches_in_flight.clear();
 }
 
 
+#if BUILD_TESTS
+
+
+#include <utils/TestUtils.h>
+
+
+void DownloadResourcesThread::test()
+{
+	conPrint("DownloadResourcesThread::test()");
+
+	// 1 Gb/s link with 100 ms RTT, 100 KB files: BDP is 12.5 MB, so want 125 files per batch, clamped to MAX_BATCH_SIZE.
+	testAssert(computeBatchSize(1.25e8, 0.1, 1.0e5) == MAX_BATCH_SIZE);
+
+	// 10 Mb/s link with 50 ms RTT, 25 KB files: BDP is 62.5 KB, so want 3 files per batch.
+	testAssert(computeBatchSize(1.25e6, 0.05, 2.5e4) == 3);
+
+	// Low latency link: BDP is less than one file.
+	testAssert(computeBatchSize(1.25e6, 0.001, 1.0e5) == MIN_BATCH_SIZE);
+
+	// Degenerate values
+	testAssert(computeBatchSize(0, 0.1, 1.0e5) == MIN_BATCH_SIZE);
+	testAssert(computeBatchSize(std::numeric_limits<double>::quiet_NaN(), 0.1, 1.0e5) == MIN_BATCH_SIZE);
+	testAssert(computeBatchSize(std::numeric_limits<double>::infinity(), 0.1, 1.0e5) == MAX_BATCH_SIZE);
+
+	conPrint("DownloadResourcesThread::test() done.");
+}
+
+
+#endif // BUILD_TESTS
+
+
 
 
 
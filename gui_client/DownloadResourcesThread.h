@@ -16,7 +16,9 @@ Copyright Glare Technologies Limited 2021 -
 #include <utils/EventFD.h>
 #include <utils/ThreadManager.h>
 #include <utils/ThreadSafeQueue.h>
-#include <set>
+#include <utils/Timer.h>
+#include <utils/Vector.h>
+#include <deque>
 #include <string>
 class WorkUnit;
 class PrintOutput;
@@ -25,6 +27,7 @@ class Server;
 namespace glare { class AtomicInt; }
 struct tls_config;
 class DownloadingResourceQueue;
+class ResourceDownloadStats;
 
 
 class ResourceDownloadedMessage : public ThreadMessage
@@ -41,12 +44,19 @@ DownloadResourcesThread
 Downloads any resources from the server as needed.
 This thread gets sent DownloadResourceMessage from MainWindow, when a new file is needed to be downloaded.
 It sends ResourceDownloadedMessages back to MainWindow via the out_msg_queue when files are downloaded.
+
+Several of these threads are run, each with its own connection to the server.
+
+Requests are pipelined: the next GetFiles request is sent before the responses to the
+current request have been read, so the server always has a request to work on.
+For the connection not to go idle, each batch needs to take at least one round-trip time to transfer,
+so the batch size is set from the measured bandwidth-delay product of the connection, divided by the mean file size.
 =====================================================================*/
 class DownloadResourcesThread : public MessageableThread
 {
 public:
 	DownloadResourcesThread(ThreadSafeQueue<Reference<ThreadMessage> >* out_msg_queue, Reference<ResourceManager> resource_manager, const std::string& hostname, int port,
-		glare::AtomicInt* num_resources_downloading_, struct tls_config* config, DownloadingResourceQueue* download_queue_);
+		glare::AtomicInt* num_resources_downloading_, struct tls_config* config, DownloadingResourceQueue* download_queue_, ResourceDownloadStats* stats_, int connection_index_);
 	virtual ~DownloadResourcesThread();
 
 	virtual void doRun();
@@ -55,7 +65,25 @@ public:
 
 	void killConnection();
 
+	// Number of files to request in a batch, so that a batch takes about one round trip time to transfer.
+	static size_t computeBatchSize(double bandwidth_B_per_s, double rtt_s, double mean_file_size_B);
+
+	static void test();
+
 private:
+	struct DownloadBatch
+	{
+		std::vector<std::string> URLs;
+		size_t num_URLs_done; // Number of URLs at the front of URLs for which responses have been read.
+		Timer time_since_sent;
+		bool sent_with_no_batches_in_flight; // If true, the time until the first response is received is approximately the round trip time.
+	};
+
+	void sendBatch(std::vector<std::string>& URLs, bool no_batches_in_flight);
+	void readBatchResponses(DownloadBatch& batch);
+	void updateEstimates(double bandwidth_sample, double rtt_sample, double mean_file_size_sample);
+	void abortBatchesInFlight();
+
 	ThreadSafeQueue<Reference<ThreadMessage> >* out_msg_queue;
 	Reference<ResourceManager> resource_manager;
 	std::string hostname;
@@ -66,6 +94,18 @@ private:
 	DownloadingResourceQueue* download_queue;
 
 	std::vector<DownloadQueueItem> queue_items; // scratch buffer
+	js::Vector<uint8, 16> temp_buf; // scratch buffer for reading file data
+
+	std::deque<DownloadBatch> batches_in_flight;
+
+	ResourceDownloadStats* stats; // May be NULL
+	int connection_index;
+
+	// Estimates for this connection, used for computing batch size.  Negative if no samples yet.
+	double bandwidth_estimate; // bytes / s
+	double rtt_estimate; // s
+	double mean_file_size_estimate; // bytes
+	size_t batch_size;
 
 	glare::AtomicInt should_die;
 public:
@@ -14,15 +14,11 @@ Copyright Glare Technologies Limited 2024 -
 
 
 DownloadingResourceQueue::DownloadingResourceQueue()
-:	begin_i(0)
 {}
 
 
 DownloadingResourceQueue::~DownloadingResourceQueue()
-{
-	for(size_t i = begin_i; i < items.size(); ++i)
-		delete items[i];
-}
+{}
 
 
 void DownloadingResourceQueue::enqueueOrUpdateItem(/*const DownloadQueueItem& item*/const std::string& URL, const Vec4f& pos, float size_factor)
@@ -43,7 +39,7 @@ void DownloadingResourceQueue::enqueueOrUpdateItem(/*const DownloadQueueItem& it
 			new_item->pos_info[0].size_factor = size_factor;
 			
 			item_URL_map[URL] = new_item;
-			items.push_back(new_item);
+			queue.insert(new_item);
 
 			already_inserted = false;
 		}
@@ -55,6 +51,7 @@ void DownloadingResourceQueue::enqueueOrUpdateItem(/*const DownloadQueueItem& it
 			new_pos_info.pos = Vec3f(pos);
 			new_pos_info.size_factor = size_factor;
 			existing_item->pos_info.push_back(new_pos_info);
+			queue.itemPosInfoChanged(existing_item);
 			
 			already_inserted = true;
 		}
@@ -68,57 +65,15 @@ void DownloadingResourceQueue::enqueueOrUpdateItem(/*const DownloadQueueItem& it
 size_t DownloadingResourceQueue::size() const
 {
 	Lock lock(mutex);
-	return items.size() - begin_i;
+	return queue.size();
 }
 
 
-struct QueueItemDistComparator
+void DownloadingResourceQueue::updateItemPriorities(const Vec3d& campos)
 {
-	bool operator () (const DownloadQueueItem* a, const DownloadQueueItem* b)
-	{
-		return a->priority < b->priority;
-	}
-};
-
-
-void DownloadingResourceQueue::sortQueue(const Vec3d& campos_) // Sort queue
-{
-	// Sort download list by distance from camera
-	const Vec4f campos_zero_w((float)campos_.x, (float)campos_.y, (float)campos_.z, 0.f);
-
-	{
-		Lock lock(mutex);
-
-		Timer timer;
-
-		QueueItemDistComparator comparator;
-
-		// Do pass over queue items to compute priority, store and use that for sorting.
-		const size_t items_size = items.size();
-		for(size_t i = begin_i; i < items_size; ++i)
-		{
-			const SmallVector<DownloadQueuePosInfo, 4>& pos_info = items[i]->pos_info;
-			assert(pos_info.size() >= 1);
-			float smallest_priority = campos_zero_w.getDist(maskWToZero(loadUnalignedVec4f(&pos_info[0].pos.x))) * pos_info[0].size_factor;
-			for(size_t z=1; z<pos_info.size(); ++z)
-			{
-				const float pos_info_z_priority = campos_zero_w.getDist(maskWToZero(loadUnalignedVec4f(&pos_info[z].pos.x))) * pos_info[z].size_factor;
-				smallest_priority = myMin(smallest_priority, pos_info_z_priority);
-			}
-
-			items[i]->priority = smallest_priority;
-		}
-
-		std::sort(items.begin() + begin_i, items.end(), comparator);
-
-		/*conPrint("Download queue: ");
-		for(int i=(int)begin_i; i<(int)items.size(); ++i)
-		{
-			conPrint("item " + toString(i) + ": " + items[i].URL + ", (" + doubleToStringNSigFigs(items[i].pos.getDist(campos), 3) + " m away)");
-		}*/
+	Lock lock(mutex);
 
-		// conPrint("!!!!Sorting download queue (" + toString(items.size() - begin_i) + " items) took " + timer.elapsedStringNSigFigs(4) + " (begin_i: " + toString(begin_i) + ")");
-	}
+	queue.updatePriorities(Vec4f((float)campos.x, (float)campos.y, (float)campos.z, 1.f));
 }
 
 
@@ -128,28 +83,14 @@ void DownloadingResourceQueue::dequeueItemsWithTimeOut(double wait_time_seconds,
 
 	Lock lock(mutex);
 
-	if(begin_i < items.size()) // If there are any items in the queue:
-	{
-		for(size_t i=0; (i<max_num_items) && (begin_i < items.size()); ++i) // while we have removed <= max_num_items and there are still items in the queue:
-		{
-			items_out.push_back(*items[begin_i]);
-			item_URL_map.erase(items[begin_i]->URL);
-			delete items[begin_i];
-			items[begin_i] = NULL;
-			begin_i++;
-		}
-		return;
-	}
-
-	nonempty.waitWithTimeout(mutex, wait_time_seconds); // Suspend thread until there are (maybe) items in the queue
+	if(queue.empty())
+		nonempty.waitWithTimeout(mutex, wait_time_seconds); // Suspend thread until there are (maybe) items in the queue
 
-	for(size_t i=0; (i<max_num_items) && (begin_i < items.size()); ++i) // while we have removed <= max_num_items and there are still items in the queue:
+	for(size_t i=0; (i<max_num_items) && !queue.empty(); ++i) // while we have removed <= max_num_items and there are still items in the queue:
 	{
-		items_out.push_back(*items[begin_i]);
-		item_URL_map.erase(items[begin_i]->URL);
-		delete items[begin_i];
-		items[begin_i] = NULL;
-		begin_i++;
+		items_out.resize(items_out.size() + 1);
+		queue.dequeueFront(items_out.back());
+		item_URL_map.erase(items_out.back().URL);
 	}
 }
 
@@ -158,13 +99,10 @@ bool DownloadingResourceQueue::tryDequeueItem(DownloadQueueItem& item_out)
 {
 	Lock lock(mutex);
 
-	if(begin_i < items.size()) // If there are any items in the queue:
+	if(!queue.empty()) // If there are any items in the queue:
 	{
-		item_out = *items[begin_i];
-		item_URL_map.erase(items[begin_i]->URL);
-		delete items[begin_i];
-		items[begin_i] = NULL;
-		begin_i++;
+		queue.dequeueFront(item_out);
+		item_URL_map.erase(item_out.URL);
 		return true;
 	}
 	else
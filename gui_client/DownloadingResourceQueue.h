@@ -6,6 +6,7 @@ Copyright Glare Technologies Limited 2024 -
 #pragma once
 
 
+#include "DistanceBandQueue.h"
 #include <physics/jscol_aabbox.h>
 #include <utils/Platform.h>
 #include <utils/Mutex.h>
@@ -45,6 +46,7 @@ struct DownloadQueueItem
 	std::string URL;
 
 	float priority;
+	DistanceBandQueueItemInfo band_queue_info;
 };
 
 
@@ -52,7 +54,9 @@ struct DownloadQueueItem
 DownloadingResourceQueue
 ------------------------
 Queue of resource URLs to download, together with the position of the object using the resource,
-which is used for sorting the items based on distance from the camera.
+which is used for prioritising the items based on distance from the camera.
+Items are kept in a DistanceBandQueue, so updating priorities when the camera moves only re-evaluates
+items whose priority band may have changed, and holds the mutex for a short time.
 
 DownloadResourcesThreads will dequeue items from this queue.
 =====================================================================*/
@@ -66,7 +70,7 @@ public:
 
 	size_t size() const;
 
-	void sortQueue(const Vec3d& campos); // Sort queue (approximately by item distance to camera)
+	void updateItemPriorities(const Vec3d& campos); // Update priorities of items (approximately by item distance to camera) after the camera has moved.
 
 	void dequeueItemsWithTimeOut(double wait_time_s, size_t max_num_items, std::vector<DownloadQueueItem>& items_out); // Blocks for up to wait_time_s
 
@@ -75,7 +79,6 @@ private:
 
 	mutable Mutex mutex;
 	Condition nonempty;
-	size_t begin_i										GUARDED_BY(mutex);
-	js::Vector<DownloadQueueItem*, 16> items			GUARDED_BY(mutex);
+	DistanceBandQueue<DownloadQueueItem> queue			GUARDED_BY(mutex);
 	std::unordered_map<std::string, DownloadQueueItem*> item_URL_map	GUARDED_BY(mutex); // Map from item URL to pointer to DownloadQueueItem in items.
 };
@@ -22,6 +22,7 @@ Copyright Glare Technologies Limited 2023 -
 #include <utils/FileInStream.h>
 #include <utils/PlatformUtils.h>
 #include <utils/BufferInStream.h>
+#include <utils/BufferViewInStream.h>
 #include <utils/Base64.h>
 #include "superluminal/PerformanceAPI.h"
 
@@ -278,7 +279,12 @@ public:
 				//conPrint("path: " + path);
 				try
 				{
-					in_stream = new FileInStream(path);
+					// Read directly from the packed cache if the resource is in it, otherwise from the resource file.
+					const Reference<PackedResourceCache>& packed_cache = resource_manager->getPackedCache();
+					if(packed_cache.nonNull() && packed_cache->getData(resource_URL, packed_data))
+						in_stream = new BufferViewInStream(packed_data.data);
+					else
+						in_stream = new FileInStream(path);
 
 					response_mime_type = web::ResponseUtils::getContentTypeForPath(resource_URL);
 
@@ -419,6 +425,7 @@ public:
 	std::string root_page;
 	std::string response_mime_type;
 	RandomAccessInStream* in_stream;
+	PackedResourceCache::ReadRef packed_data; // Keeps the data read by in_stream alive, if reading from the packed cache.
 	Reference<ResourceManager> resource_manager;
 
 	IMPLEMENT_REFCOUNTING(EmbeddedBrowserResourceHandler);
@@ -773,7 +780,7 @@ public:
 				Lock lock(mutex);
 				if(m_gui_client)
 				{
-					Lock audio_engine_lock(m_gui_client->audio_engine.mutex);
+					Lock source_lock(this->audio_source->source_mutex);
 					this->audio_source->buffer.pushBackNItems(temp_buf.data(), num_samples);
 				}
 			}
@@ -0,0 +1,377 @@
+/*=====================================================================
+FrameWorkScheduler.cpp
+----------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#include "FrameWorkScheduler.h"
+
+
+#include "../maths/mathstypes.h"
+#include "../utils/Timer.h"
+#include "../utils/StringUtils.h"
+#include <algorithm>
+#include <cassert>
+
+
+static const double MIN_BUDGET = 0.001; // 1 ms
+static const double MAX_BUDGET_FRACTION = 0.5; // Max fraction of the target frame period to use for deferrable work.
+static const double MAX_CPU_FRACTION = 0.7; // Target fraction of the target frame period for total main-thread CPU work, leaving the rest for render submission etc.
+static const double BUDGET_GROWTH_FRACTION = 0.02; // Fraction of the target frame period to increase the budget by each frame, when there is spare CPU time.
+static const double MAX_FRAME_TIME = 1.0; // Ignore frame CPU times longer than this (e.g. from the app being paused in a debugger).
+static const double TIME_SMOOTHING = 0.1;
+
+
+FrameWorkScheduler::FrameWorkScheduler()
+:	target_frame_period(1.0 / DEFAULT_TARGET_FRAME_RATE),
+	last_frame_start_time(-1),
+	last_frame_time(0),
+	last_frame_cpu_time(-1),
+	last_frame_reported_cpu_time(0)
+{
+	budget = target_frame_period * MAX_BUDGET_FRACTION;
+}
+
+
+FrameWorkScheduler::~FrameWorkScheduler()
+{}
+
+
+int FrameWorkScheduler::addWorkUnit(const std::string& name, FrameWorkUnit* unit, int priority, double min_time_per_frame)
+{
+	assert(unit);
+
+	Subsystem subsystem;
+	subsystem.name = name;
+	subsystem.unit = unit;
+	subsystem.priority = priority;
+	subsystem.min_time_per_frame = min_time_per_frame;
+	subsystem.cur_frame_time = 0;
+	subsystem.last_time = 0;
+	subsystem.smoothed_time = 0;
+	subsystem.backlog = 0;
+	subsystem.num_frames_deferred = 0;
+
+	const int index = (int)subsystems.size();
+	subsystems.push_back(subsystem);
+
+	// Insert into run_order after any units with the same or higher priority, so units with equal priority are run in registration order.
+	size_t insert_pos = 0;
+	while(insert_pos < run_order.size() && subsystems[run_order[insert_pos]].priority >= priority)
+		insert_pos++;
+	run_order.insert(run_order.begin() + insert_pos, index);
+
+	return index;
+}
+
+
+int FrameWorkScheduler::addMeasuredSubsystem(const std::string& name)
+{
+	Subsystem subsystem;
+	subsystem.name = name;
+	subsystem.unit = NULL;
+	subsystem.priority = 0;
+	subsystem.min_time_per_frame = 0;
+	subsystem.cur_frame_time = 0;
+	subsystem.last_time = 0;
+	subsystem.smoothed_time = 0;
+	subsystem.backlog = 0;
+	subsystem.num_frames_deferred = 0;
+
+	subsystems.push_back(subsystem);
+	return (int)subsystems.size() - 1;
+}
+
+
+void FrameWorkScheduler::addMeasuredTime(int subsystem_index, double elapsed)
+{
+	assert(subsystem_index >= 0 && subsystem_index < (int)subsystems.size() && !subsystems[subsystem_index].unit);
+	subsystems[subsystem_index].cur_frame_time += elapsed;
+}
+
+
+void FrameWorkScheduler::setTargetFrameRate(double frame_rate)
+{
+	if(frame_rate > 0)
+	{
+		target_frame_period = 1.0 / frame_rate;
+		budget = myClamp(budget, MIN_BUDGET, myMax(MIN_BUDGET, target_frame_period * MAX_BUDGET_FRACTION));
+	}
+}
+
+
+void FrameWorkScheduler::setFrameCPUTime(double cpu_time)
+{
+	last_frame_cpu_time = cpu_time;
+	last_frame_reported_cpu_time = cpu_time;
+}
+
+
+void FrameWorkScheduler::updateBudget(double cur_time)
+{
+	if(last_frame_start_time >= 0)
+		last_frame_time = cur_time - last_frame_start_time;
+	last_frame_start_time = cur_time;
+
+	if(last_frame_cpu_time >= 0 && last_frame_cpu_time <= MAX_FRAME_TIME)
+	{
+		// Work out the CPU time used in the last frame by work other than the work units.  The work unit times are still those from the last frame at this point.
+		double work_units_time = 0;
+		for(size_t i=0; i<run_order.size(); ++i)
+			work_units_time += subsystems[run_order[i]].last_time;
+		const double other_cpu_time = myMax(0.0, last_frame_cpu_time - work_units_time);
+
+		const double target_budget = target_frame_period * MAX_CPU_FRACTION - other_cpu_time;
+		if(target_budget < budget)
+			budget = target_budget; // Reduce immediately, so we would have just hit the target CPU time.
+		else
+			budget = myMin(target_budget, budget + target_frame_period * BUDGET_GROWTH_FRACTION);
+
+		budget = myClamp(budget, MIN_BUDGET, myMax(MIN_BUDGET, target_frame_period * MAX_BUDGET_FRACTION));
+	}
+	last_frame_cpu_time = -1;
+}
+
+
+void FrameWorkScheduler::runFrame(double cur_time)
+{
+	updateBudget(cur_time);
+
+	// Roll over times for measured subsystems
+	for(size_t i=0; i<subsystems.size(); ++i)
+	{
+		Subsystem& subsystem = subsystems[i];
+		if(!subsystem.unit)
+		{
+			subsystem.last_time = subsystem.cur_frame_time;
+			subsystem.smoothed_time = subsystem.smoothed_time * (1 - TIME_SMOOTHING) + subsystem.cur_frame_time * TIME_SMOOTHING;
+			subsystem.cur_frame_time = 0;
+		}
+	}
+
+	Timer frame_timer;
+	for(size_t i=0; i<run_order.size(); ++i)
+	{
+		Subsystem& subsystem = subsystems[run_order[i]];
+
+		const double remaining = budget - frame_timer.elapsed();
+		const double unit_budget = myMax(remaining, subsystem.min_time_per_frame);
+
+		Timer unit_timer;
+		subsystem.backlog = subsystem.unit->doWork(unit_budget);
+		const double elapsed = unit_timer.elapsed();
+
+		subsystem.last_time = elapsed;
+		subsystem.smoothed_time = subsystem.smoothed_time * (1 - TIME_SMOOTHING) + elapsed * TIME_SMOOTHING;
+		if(subsystem.backlog > 0)
+			subsystem.num_frames_deferred++;
+	}
+}
+
+
+size_t FrameWorkScheduler::getTotalBacklog() const
+{
+	size_t sum = 0;
+	for(size_t i=0; i<subsystems.size(); ++i)
+		sum += subsystems[i].backlog;
+	return sum;
+}
+
+
+std::string FrameWorkScheduler::getDiagnostics() const
+{
+	std::string s;
+	s += "Frame scheduler: budget: " + doubleToStringNSigFigs(budget * 1000, 3) + " ms, last frame: " + doubleToStringNSigFigs(last_frame_time * 1000, 3) + " ms (CPU: " +
+		doubleToStringNSigFigs(last_frame_reported_cpu_time * 1000, 3) + " ms), target: " +
+		doubleToStringNSigFigs(target_frame_period * 1000, 3) + " ms\n";
+	for(size_t i=0; i<subsystems.size(); ++i)
+	{
+		const Subsystem& subsystem = subsystems[i];
+		s += "    " + subsystem.name + ": " + doubleToStringNSigFigs(subsystem.smoothed_time * 1000, 3) + " ms";
+		if(subsystem.unit)
+			s += ", backlog: " + toString(subsystem.backlog) + ", frames deferred: " + toString(subsystem.num_frames_deferred);
+		s += "\n";
+	}
+	return s;
+}
+
+
+#if BUILD_TESTS
+
+
+#include "../utils/TestUtils.h"
+#include "../utils/ConPrint.h"
+
+
+namespace
+{
+
+// Does one work item per call to doWork(), records the budget it was given.
+class TestWorkUnit : public FrameWorkUnit
+{
+public:
+	TestWorkUnit(int id_, std::vector<int>* call_order_, size_t num_items_) : id(id_), call_order(call_order_), num_items(num_items_), last_budget(0) {}
+
+	virtual size_t doWork(double time_budget)
+	{
+		call_order->push_back(id);
+		last_budget = time_budget;
+		if(num_items > 0)
+			num_items--;
+		return num_items;
+	}
+
+	int id;
+	std::vector<int>* call_order;
+	size_t num_items;
+	double last_budget;
+};
+
+
+// Does work items taking item_time each, until the budget is used.
+class TimedTestWorkUnit : public FrameWorkUnit
+{
+public:
+	TimedTestWorkUnit(size_t num_items_, double item_time_) : num_items(num_items_), item_time(item_time_) {}
+
+	virtual size_t doWork(double time_budget)
+	{
+		Timer timer;
+		while(num_items > 0 && timer.elapsed() < time_budget)
+		{
+			Timer item_timer;
+			while(item_timer.elapsed() < item_time)
+			{}
+			num_items--;
+		}
+		return num_items;
+	}
+
+	size_t num_items;
+	double item_time;
+};
+
+}
+
+
+void FrameWorkScheduler::test()
+{
+	conPrint("FrameWorkScheduler::test()");
+
+	const double target_period = 1.0 / DEFAULT_TARGET_FRAME_RATE;
+	const double max_budget = target_period * MAX_BUDGET_FRACTION;
+
+	//---------------------- Test budget adaption ----------------------
+	{
+		FrameWorkScheduler scheduler;
+		testAssert(epsEqual(scheduler.getBudget(), max_budget));
+
+		// Frames with CPU time much longer than the target period should reduce the budget to the minimum.
+		double t = 0;
+		for(int i=0; i<10; ++i)
+		{
+			scheduler.runFrame(t);
+			scheduler.setFrameCPUTime(0.05);
+			t += 0.05;
+		}
+		scheduler.runFrame(t);
+		testAssert(epsEqual(scheduler.getBudget(), MIN_BUDGET));
+
+		// Long frames with little CPU time (e.g. GPU-bound frames) should increase the budget back to the maximum.
+		for(int i=0; i<1000; ++i)
+		{
+			scheduler.setFrameCPUTime(0.002);
+			t += 0.05;
+			scheduler.runFrame(t);
+		}
+		testAssert(epsEqual(scheduler.getBudget(), max_budget));
+
+		// If the non-deferrable CPU work leaves less than the max budget, the budget should be reduced to what is left.
+		const double other_cpu_time = target_period * MAX_CPU_FRACTION - max_budget + 0.002;
+		scheduler.setFrameCPUTime(other_cpu_time);
+		t += target_period;
+		scheduler.runFrame(t);
+		testAssert(epsEqual(scheduler.getBudget(), max_budget - 0.002));
+
+		// Frames without a CPU time set, and long pauses, should be ignored.
+		t += target_period;
+		scheduler.runFrame(t);
+		testAssert(epsEqual(scheduler.getBudget(), max_budget - 0.002));
+		scheduler.setFrameCPUTime(100.0);
+		scheduler.runFrame(t + 100.0);
+		testAssert(epsEqual(scheduler.getBudget(), max_budget - 0.002));
+
+		// Changing the target frame rate should clamp the budget.
+		scheduler.setTargetFrameRate(1000.0);
+		testAssert(epsEqual(scheduler.getBudget(), MIN_BUDGET));
+	}
+
+	//---------------------- Test that time used by work units is not counted as non-deferrable CPU time ----------------------
+	{
+		std::vector<int> call_order;
+		TestWorkUnit unit(0, &call_order, 0);
+
+		FrameWorkScheduler scheduler;
+		scheduler.addWorkUnit("unit", &unit, /*priority=*/0, /*min time=*/0.0);
+		scheduler.runFrame(0.0);
+		scheduler.subsystems[0].last_time = max_budget; // Pretend the unit used the whole budget.
+		scheduler.setFrameCPUTime(max_budget + 0.001);
+		scheduler.runFrame(target_period);
+		testAssert(epsEqual(scheduler.getBudget(), max_budget));
+	}
+
+	//---------------------- Test priority order and min time ----------------------
+	{
+		std::vector<int> call_order;
+		TestWorkUnit low(0, &call_order, 3);
+		TestWorkUnit high(1, &call_order, 1);
+		TestWorkUnit mid_a(2, &call_order, 0);
+		TestWorkUnit mid_b(3, &call_order, 0);
+
+		FrameWorkScheduler scheduler;
+		scheduler.addWorkUnit("low", &low, /*priority=*/0, /*min time=*/0.002);
+		scheduler.addWorkUnit("high", &high, /*priority=*/10, /*min time=*/0.0);
+		scheduler.addWorkUnit("mid a", &mid_a, /*priority=*/5, /*min time=*/0.0);
+		scheduler.addWorkUnit("mid b", &mid_b, /*priority=*/5, /*min time=*/0.0);
+		const int measured = scheduler.addMeasuredSubsystem("measured");
+
+		scheduler.runFrame(0.0);
+		testAssert(call_order.size() == 4);
+		testAssert(call_order[0] == 1 && call_order[1] == 2 && call_order[2] == 3 && call_order[3] == 0);
+		testAssert(low.last_budget >= 0.002);
+		testAssert(scheduler.getTotalBacklog() == 2);
+
+		scheduler.addMeasuredTime(measured, 0.003);
+		scheduler.runFrame(1.0);
+		testAssert(scheduler.subsystems[measured].last_time == 0.003);
+		testAssert(scheduler.getTotalBacklog() == 1);
+		testAssert(scheduler.subsystems[0].num_frames_deferred == 2);
+		testAssert(scheduler.subsystems[1].num_frames_deferred == 0);
+
+		conPrint(scheduler.getDiagnostics());
+	}
+
+	//---------------------- Test that low priority units still make progress when the budget is used up ----------------------
+	{
+		TimedTestWorkUnit high(1000000, 0.0001);
+		TimedTestWorkUnit low(1000000, 0.0001);
+
+		FrameWorkScheduler scheduler;
+		scheduler.addWorkUnit("high", &high, /*priority=*/1, /*min time=*/0.0);
+		scheduler.addWorkUnit("low", &low, /*priority=*/0, /*min time=*/0.0005);
+
+		double t = 0;
+		for(int i=0; i<10; ++i)
+		{
+			scheduler.runFrame(t);
+			t += target_period;
+		}
+		testAssert(high.num_items < 1000000);
+		testAssert(low.num_items < 1000000);
+		testAssert(high.num_items < low.num_items);
+	}
+
+	conPrint("FrameWorkScheduler::test() done.");
+}
+
+
+#endif // BUILD_TESTS
@@ -0,0 +1,112 @@
+/*=====================================================================
+FrameWorkScheduler.h
+--------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#pragma once
+
+
+#include <string>
+#include <vector>
+
+
+/*=====================================================================
+FrameWorkUnit
+-------------
+Resumable per-frame work for a subsystem, run by FrameWorkScheduler.
+=====================================================================*/
+class FrameWorkUnit
+{
+public:
+	virtual ~FrameWorkUnit() {}
+
+	// Does work until time_budget (in seconds) has been used, or there is no more work to do.
+	// Work that was not done should be resumed on the next call.
+	// Returns the number of work items still to be done (the deferred backlog), or 0 if all work was done.
+	virtual size_t doWork(double time_budget) = 0;
+};
+
+
+/*=====================================================================
+FrameWorkScheduler
+------------------
+Cooperative scheduler for deferrable per-frame work on the main thread.
+
+Subsystems register FrameWorkUnits with a priority.  Each frame, runFrame() computes
+a time budget for deferrable work, and runs the units in order of decreasing priority,
+giving each unit the remaining budget.  Each unit is always given at least its
+min_time_per_frame, so that low priority units still make progress when the frame is busy.
+
+The budget is adapted from the measured main-thread CPU time of the last frame, set with setFrameCPUTime(),
+not from the wall-clock frame time, since on GPU-bound machines or with vsync most of the frame time can be spent
+waiting for the GPU, and shrinking the budget then wouldn't make frames any faster.
+The budget is set so that the CPU time of the non-deferrable work in the last frame plus the budget is MAX_CPU_FRACTION
+of the target frame period.  It is reduced immediately if needed, and otherwise increased slowly, up to MAX_BUDGET_FRACTION of the target frame period.
+
+Subsystems whose work can't be deferred (e.g. animated textures, which have to be updated every frame)
+can be registered with addMeasuredSubsystem() so that their time is reported in the diagnostics.
+
+Not threadsafe, should just be used from the main thread.
+=====================================================================*/
+class FrameWorkScheduler
+{
+public:
+	FrameWorkScheduler();
+	~FrameWorkScheduler();
+
+	static const int DEFAULT_TARGET_FRAME_RATE = 60;
+
+	// Registers a work unit.  Returns the subsystem index.  unit is not owned by the scheduler, and must outlive it.
+	int addWorkUnit(const std::string& name, FrameWorkUnit* unit, int priority, double min_time_per_frame);
+
+	// Registers a subsystem that does non-deferrable work, which is just timed for diagnostics.  Returns the subsystem index.
+	int addMeasuredSubsystem(const std::string& name);
+
+	// Records time taken by a measured subsystem this frame.
+	void addMeasuredTime(int subsystem_index, double elapsed);
+
+	void setTargetFrameRate(double frame_rate);
+
+	// Records the main-thread CPU time of the current frame, including time spent in runFrame().  Should be called at the end of each frame.
+	void setFrameCPUTime(double cpu_time);
+
+	// Updates the time budget from the measured frame time, then runs the work units.  cur_time is in seconds.
+	void runFrame(double cur_time);
+
+	// Time budget for deferrable work in the current frame, in seconds.
+	double getBudget() const { return budget; }
+
+	// Total backlog of all work units after the last runFrame() call.
+	size_t getTotalBacklog() const;
+
+	std::string getDiagnostics() const;
+
+	static void test();
+
+private:
+	void updateBudget(double cur_time);
+
+	struct Subsystem
+	{
+		std::string name;
+		FrameWorkUnit* unit; // NULL for measured subsystems.
+		int priority;
+		double min_time_per_frame;
+
+		double cur_frame_time; // Time accumulated by addMeasuredTime() since the last runFrame() call.
+		double last_time; // Time used in the last frame.
+		double smoothed_time; // Exponential moving average of time used per frame.
+		size_t backlog; // Work items remaining after last frame.
+		size_t num_frames_deferred; // Number of frames where the unit had work remaining at the end of the frame.
+	};
+
+	std::vector<Subsystem> subsystems;
+	std::vector<int> run_order; // Indices of work units, in order of decreasing priority.
+
+	double target_frame_period;
+	double budget;
+	double last_frame_start_time; // -1 if runFrame() has not been called yet.
+	double last_frame_time;
+	double last_frame_cpu_time; // -1 if not set for the last frame.
+	double last_frame_reported_cpu_time; // For diagnostics.
+};
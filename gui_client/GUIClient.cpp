@@ -75,6 +75,7 @@ Copyright Glare Technologies Limited 2024 -
 #include "../utils/RuntimeCheck.h"
 #include "../utils/MemAlloc.h"
 #include "../utils/UTF8Utils.h"
+#include "../utils/MemMappedFile.h"
 #include "../networking/Networking.h"
 #include "../networking/URL.h"
 #include "../graphics/ImageMap.h"
@@ -166,10 +167,12 @@ GUIClient::GUIClient(const std::string& base_dir_path_, const std::string& appda
 	last_vehicle_renewal_msg_time(-1),
 	stack_allocator(/*size (B)=*/4 * 1024 * 1024),
 	server_protocol_version(0),
+	min_client_protocol_version(0),
 	settings(NULL),
 	ui_interface(NULL),
 	extracted_anim_data_loaded(false),
 	server_using_lod_chunks(false),
+	replay_speed(1.0),
 	last_cursor_movement_was_from_mouse(true)
 {
 	resources_dir_path = base_dir_path + "/data/resources";
@@ -200,6 +203,17 @@ GUIClient::GUIClient(const std::string& base_dir_path_, const std::string& appda
 	
 	this->world_ob_pool_allocator = new glare::PoolAllocator(sizeof(WorldObject), 64);
 
+	// Register per-frame work with the frame scheduler.  LOD changes are handled before loading, since they just queue up load tasks.
+	loading_work_unit.gui_client = this;
+	lod_changes_work_unit.gui_client = this;
+	frame_scheduler.addWorkUnit("LOD changes", &lod_changes_work_unit, /*priority=*/10, /*min time per frame=*/0.001);
+	frame_scheduler.addWorkUnit("model and texture loading", &loading_work_unit, /*priority=*/5, /*min time per frame=*/0.005); // Always give loading at least 5 ms, so it still makes reasonable progress when the budget is small.
+	proximity_checker_subsystem = frame_scheduler.addMeasuredSubsystem("scripted ob proximity checks");
+	animated_tex_subsystem      = frame_scheduler.addMeasuredSubsystem("animated textures");
+	avatar_graphics_subsystem   = frame_scheduler.addMeasuredSubsystem("avatar graphics");
+	audio_range_subsystem       = frame_scheduler.addMeasuredSubsystem("audio range checks");
+	terrain_subsystem           = frame_scheduler.addMeasuredSubsystem("terrain update");
+
 	proximity_loader.callbacks = this;
 
 	cam_controller.setMouseSensitivity(-1.0);
@@ -303,11 +317,56 @@ void GUIClient::initialise(const std::string& cache_dir, SettingsStore* settings
 	if(resources_dir_changed)
 		settings->setStringValue("last_resources_dir", resources_dir);
 
+	// Open the packed resource cache, if enabled.
+	// If it is not enabled, but was used previously, remove it.  Resources that were only in the packed cache are then no longer present, so check which resources are actually on disk.
+	bool packed_cache_removed = false;
+#if !defined(EMSCRIPTEN)
+	const std::string packed_cache_dir = cache_dir + "/packed_resources";
+	if(settings->getBoolValue("setting/use_packed_resource_cache", /*default val=*/false))
+	{
+		try
+		{
+			const uint64 budget_B = (uint64)myMax(64, settings->getIntValue("setting/packed_resource_cache_budget_MB", /*default val=*/8192)) * 1024 * 1024;
+			resource_manager->setPackedCache(new PackedResourceCache(packed_cache_dir), budget_B);
+		}
+		catch(glare::Exception& e)
+		{
+			conPrint("WARNING: failed to open packed resource cache in '" + packed_cache_dir + "': " + e.what());
+		}
+	}
+	else if(FileUtils::fileExists(packed_cache_dir))
+	{
+		try
+		{
+			const std::vector<std::string> filenames = FileUtils::getFilesInDir(packed_cache_dir);
+			for(size_t i=0; i<filenames.size(); ++i)
+			{
+				FileUtils::deleteFile(packed_cache_dir + "/" + filenames[i]);
+				packed_cache_removed = true;
+			}
+		}
+		catch(glare::Exception& e)
+		{
+			conPrint("WARNING: failed to remove packed resource cache in '" + packed_cache_dir + "': " + e.what());
+		}
+	}
+
+	try
+	{
+		const uint64 physics_shape_cache_budget_B = (uint64)myMax(64, settings->getIntValue("setting/physics_shape_cache_budget_MB", /*default val=*/(int)(PhysicsShapeCache::DEFAULT_MAX_SIZE_B / (1024 * 1024)))) * 1024 * 1024;
+		physics_shape_cache = new PhysicsShapeCache(cache_dir + "/physics_shapes", physics_shape_cache_budget_B);
+	}
+	catch(glare::Exception& e)
+	{
+		conPrint("WARNING: failed to create physics shape cache: " + e.what());
+	}
+#endif
+
 	const std::string resources_db_path = appdata_path + "/resources_db";
 	try
 	{
 		if(FileUtils::fileExists(resources_db_path))
-			resource_manager->loadFromDisk(resources_db_path, /*check_if_resources_exist_on_disk=*/resources_dir_changed);
+			resource_manager->loadFromDisk(resources_db_path, /*check_if_resources_exist_on_disk=*/resources_dir_changed || packed_cache_removed);
 	}
 	catch(glare::Exception& e)
 	{
@@ -361,6 +420,7 @@ void GUIClient::initAudioEngine()
 	try
 	{
 		audio_engine.init();
+		audio_engine.setMaxNumSpatialVoices(settings->getIntValue("setting/max_num_spatial_audio_voices", /*default val=*/glare::AudioEngine::DEFAULT_MAX_NUM_SPATIAL_VOICES));
 
 		// Load a wind sound and create a non-spatial audio source, to use for a rushing effect when the player moves fast.
 		// TODO: Load wind noise off main thread. (Take about 11ms to load on my 5950x).
@@ -760,6 +820,8 @@ void GUIClient::shutdown()
 
 	texture_loaded_messages_to_process.clear();
 
+	streaming_gif_textures.clear();
+
 	cur_loading_voxel_ob = NULL;
 
 
@@ -1234,7 +1296,7 @@ r_s / r = s
 */
 static inline float maxAudioDistForSourceVolFactor(float volume_factor)
 {
-	return 60.f * volume_factor;
+	return glare::AudioEngine::maxAudibleDistForVolume(volume_factor); // Use the same model as the audio engine uses for culling.
 }
 
 
@@ -1255,7 +1317,7 @@ void GUIClient::startDownloadingResourcesForObject(WorldObject* ob, int ob_lod_l
 		const bool has_audio_extension = FileTypes::hasAudioFileExtension(url);
 		const bool has_video_extension = FileTypes::hasSupportedVideoFileExtension(url);
 
-		if(has_audio_extension || has_video_extension || ImageDecoding::hasSupportedImageExtension(url) || ModelLoading::hasSupportedModelExtension(url))
+		if(has_audio_extension || has_video_extension || ImageDecoding::hasSupportedImageExtension(url) || ModelLoading::hasSupportedModelExtension(url) || ModelLoading::hasGPUMeshExtension(url))
 		{
 			// Only download mp4s and audio files if the camera is near them in the world.
 			bool in_range = true;
@@ -2092,7 +2154,10 @@ void GUIClient::loadModelForObject(WorldObject* ob, WorldStateLock& world_state_
 				ob->loading_or_loaded_model_lod_level = ob_model_lod_level;
 
 				bool added_opengl_ob = false;
-				const std::string lod_model_url = WorldObject::getLODModelURLForLevel(ob->model_url, ob_model_lod_level);
+				// Use the GPU mesh variant if the server has generated it, since it can be loaded with less processing.
+				const std::string lod_model_url = BitUtils::isBitSet(ob->flags, WorldObject::GPU_MESH_PRESENT_FLAG) ? 
+					WorldObject::getGPUMeshURLForLevel(ob->model_url, ob_model_lod_level) : 
+					WorldObject::getLODModelURLForLevel(ob->model_url, ob_model_lod_level);
 
 				// print("Loading model for ob: UID: " + ob->uid.toString() + ", type: " + WorldObject::objectTypeString((WorldObject::ObjectType)ob->object_type) + ", lod_model_url: " + lod_model_url);
 
@@ -2124,6 +2189,7 @@ void GUIClient::loadModelForObject(WorldObject* ob, WorldStateLock& world_state_
 							load_model_task->unit_cube_shape = this->unit_cube_shape;
 							load_model_task->result_msg_queue = &this->msg_queue;
 							load_model_task->resource_manager = resource_manager;
+							load_model_task->physics_shape_cache = physics_shape_cache;
 							load_model_task->build_dynamic_physics_ob = ob->isDynamic();
 
 							load_item_queue.enqueueItem(/*key=*/lod_model_url, *ob, load_model_task, max_dist_for_ob_model_lod_level);
@@ -2835,8 +2901,14 @@ void GUIClient::loadAudioForObject(WorldObject* ob)
 
 					if(hasExtensionStringView(ob->audio_source_url, "mp3"))
 					{
-						// Make a new audio source
-						glare::AudioSourceRef source = audio_engine.addSourceFromStreamingSoundFile(resource_manager->pathForURL(ob->audio_source_url), ob->pos.toVec4fPoint(), ob->audio_volume, this->world_state->getCurrentGlobalTime());
+						// Make a new audio source.  Stream directly from the packed cache if the resource is in it, otherwise from the resource file.
+						const std::string audio_path = resource_manager->pathForURL(ob->audio_source_url);
+						PackedResourceCache::ReadRef packed_data;
+						glare::AudioSourceRef source;
+						if(resource_manager->getPackedCache().nonNull() && resource_manager->getPackedCache()->getData(ob->audio_source_url, packed_data))
+							source = audio_engine.addSourceFromStreamingSoundData(audio_path, packed_data.data, packed_data.mapping.ptr(), ob->pos.toVec4fPoint(), ob->audio_volume, this->world_state->getCurrentGlobalTime());
+						else
+							source = audio_engine.addSourceFromStreamingSoundFile(audio_path, ob->pos.toVec4fPoint(), ob->audio_volume, this->world_state->getCurrentGlobalTime());
 
 						Lock lock(world_state->mutex);
 						const Parcel* parcel = world_state->getParcelPointIsIn(ob->pos);
@@ -3324,6 +3396,8 @@ void GUIClient::doMoveAndRotateObject(WorldObjectRef ob, const Vec3d& new_ob_pos
 
 	ob->transformChanged();
 
+	scripted_ob_proximity_checker.objectTransformChanged(ob.ptr());
+
 	ob->last_modified_time = TimeStamp::currentTime(); // Gets set on server as well, this is just for updating the local display.
 
 	// Set graphics object pos and update in opengl engine.
@@ -3406,6 +3480,9 @@ float proj_len_viewable_threshold = 0.02f;
 
 
 
+static const float LOD_CHUNK_DIST_THRESHOLD = 150.f; // LOD chunks are displayed when the camera is further than this from the chunk centre.
+
+
 static inline float xyDist2(const Vec4f& a, const Vec4f& b)
 {
 	Vec4f a_to_b = b - a;
@@ -3416,24 +3493,21 @@ static inline bool shouldDisplayLODChunk(const Vec3i& chunk_coords, const Vec4f&
 {
 	const Vec4f chunk_centre = Vec4f((chunk_coords.x + 0.5f) * chunk_w, (chunk_coords.y + 0.5f) * chunk_w, 0, 1);
 	
-	const float CHUNK_DIST_THRESHOLD = 150.f;
-	
 	const float dist_to_chunk2 = xyDist2(campos, chunk_centre);
 
-	return dist_to_chunk2 > Maths::square(CHUNK_DIST_THRESHOLD);
+	return dist_to_chunk2 > Maths::square(LOD_CHUNK_DIST_THRESHOLD);
 }
 
 
-void GUIClient::checkForLODChanges()
+size_t GUIClient::checkForLODChanges(double time_budget)
 {
 	ZoneScoped; // Tracy profiler
 
 	if(world_state.isNull())
-		return;
+		return 0;
 		
-	
-
-	//Timer timer;
+	Timer timer;
+	size_t num_remaining = 0;
 	{
 		WorldStateLock lock(this->world_state->mutex);
 
@@ -3443,52 +3517,39 @@ void GUIClient::checkForLODChanges()
 		const bool use_server_using_lod_chunks = this->server_using_lod_chunks;
 
 
-		const Vec4f cam_pos = cam_controller.getPosition().toVec4fPoint();
+		ObjectLODTable::ComputeParams params;
+		params.campos = cam_controller.getPosition().toVec4fPoint();
+		params.load_distance2 = this->load_distance2;
 #if EMSCRIPTEN
-		const float proj_len_viewable_threshold_ = proj_len_viewable_threshold;
+		params.use_proj_len_viewable_threshold = true;
+#else
+		params.use_proj_len_viewable_threshold = false;
 #endif
-		const float load_distance2_ = this->load_distance2;
+		params.proj_len_viewable_threshold = proj_len_viewable_threshold;
+		params.use_lod_chunks = use_server_using_lod_chunks;
+		params.chunk_w = chunk_w;
+		params.chunk_dist_threshold = LOD_CHUNK_DIST_THRESHOLD;
 
-		glare::FastIterMapValueInfo<UID, WorldObjectRef>* const objects_data = this->world_state->objects.vector.data();
-		const size_t objects_size                                            = this->world_state->objects.vector.size();
+		// Compute LOD state for all objects in a vectorised loop over the LOD table, which just returns the objects whose LOD state has changed.
+		temp_lod_changes.clear();
+		this->world_state->lod_table.computeChangedObjects(params, temp_lod_changes);
 
-		// Process just some of the objects each frame, to reduce CPU time and ease pressure on the cache.
-		const size_t num_slices = 4;
-		const size_t slice = frame_num % num_slices;
-		const size_t begin_i = myMin(objects_size, Maths::roundedUpDivide(objects_size, num_slices) * slice      );
-		const size_t end_i   = myMin(objects_size, Maths::roundedUpDivide(objects_size, num_slices) * (slice + 1));
-
-		//conPrint("checking slice from " + toString(begin_i) + " to " + toString(end_i));
-		for(size_t i=begin_i; i<end_i; ++i)
+		for(size_t i=0; i<temp_lod_changes.size(); ++i)
 		{
-			if(i + 16 < end_i)
-				_mm_prefetch((const char*)(&objects_data[i + 16].value->centroid_ws), _MM_HINT_T0);
-
-			WorldObject* const ob = objects_data[i].value.ptr();
-
-			const Vec4f centroid = ob->getCentroidWS();
-
-			const float cam_to_ob_d2 = ob->getCentroidWS().getDist2(cam_pos);
-			//const float cam_to_ob_d2 = ob->getAABBWS().getClosestPointInAABB(cam_pos).getDist2(cam_pos);
-#if EMSCRIPTEN
-			const float recip_dist = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(cam_to_ob_d2)));
-			//assert(epsEqual(recip_dist, 1 / sqrt(cam_to_ob_d2)));
-
-			const float proj_len = ob->getBiasedAABBLength() * recip_dist;
-
-			bool in_proximity = (proj_len > proj_len_viewable_threshold_) && (cam_to_ob_d2 < load_distance2_);
-#else
-			bool in_proximity = cam_to_ob_d2 < load_distance2_;
-#endif
+			// If we have used up our time budget, stop.  Changes not handled will be returned by computeChangedObjects() again next time,
+			// since objectLODStateChanged() has not been called for them.
+			if((i > 0) && (timer.elapsed() > time_budget))
+			{
+				num_remaining = temp_lod_changes.size() - i;
+				break;
+			}
 
-			// If this object is in a chunk region, and we are displaying the chunk, then don't show the object.
-			const Vec3i chunk_coords(Maths::floorToInt(centroid[0] / chunk_w), Maths::floorToInt(centroid[1] / chunk_w), 0);
-			if(use_server_using_lod_chunks && shouldDisplayLODChunk(chunk_coords, cam_pos) && !ob->exclude_from_lod_chunk_mesh)
-				in_proximity = false;
+			WorldObject* const ob = temp_lod_changes[i].ob;
+			const int new_lod_state = temp_lod_changes[i].new_lod_state;
 
 			assert(ob->exclude_from_lod_chunk_mesh == BitUtils::isBitSet(ob->flags, WorldObject::EXCLUDE_FROM_LOD_CHUNK_MESH));
 
-			if(!in_proximity) // If object is out of load distance:
+			if(new_lod_state == ObjectLODTable::LOD_STATE_NOT_IN_PROXIMITY) // If object is out of load distance:
 			{
 				if(ob->in_proximity) // If an object was in proximity to the camera, and moved out of load distance:
 				{
@@ -3498,7 +3559,7 @@ void GUIClient::checkForLODChanges()
 			}
 			else // Else if object is within load distance:
 			{
-				const int lod_level = ob->getLODLevel(cam_to_ob_d2);
+				const int lod_level = new_lod_state;
 
 				if((lod_level != ob->current_lod_level)/* || ob->opengl_engine_ob.isNull()*/)
 				{
@@ -3514,9 +3575,12 @@ void GUIClient::checkForLODChanges()
 					ob->current_lod_level = lod_level;
 				}
 			}
+
+			this->world_state->lod_table.objectLODStateChanged(ob);
 		}
 	} // End lock scope
 	//conPrint("checkForLODChanges took " + timer.elapsedStringMSWIthNSigFigs(4) + " (" + toString(world_state->objects.size()) + " obs)");
+	return num_remaining;
 }
 
 
@@ -3593,7 +3657,7 @@ struct CloserToCamComparator
 };
 
 
-void GUIClient::processLoading()
+size_t GUIClient::processLoading(double time_budget)
 {
 	//double frame_loading_time = 0;
 	//std::vector<std::string> loading_times; // TEMP just for profiling/debugging
@@ -3601,11 +3665,10 @@ void GUIClient::processLoading()
 	{
 		PERFORMANCEAPI_INSTRUMENT("process loading msgs");
 
-		// Process ModelLoadedThreadMessages and TextureLoadedThreadMessages until we have consumed a certain amount of time.
+		// Process ModelLoadedThreadMessages and TextureLoadedThreadMessages until we have consumed the time budget given by frame_scheduler.
 		// We don't want to do too much at one time or it will cause hitches.
 		// We'll alternate between processing model loaded and texture loaded messages, using process_model_loaded_next.
 		// We alternate for fairness.
-		const double MAX_LOADING_TIME = 0.005;// 5 ms
 		Timer loading_timer;
 		//int max_items_to_process = 10;
 		//int num_items_processed = 0;
@@ -3619,7 +3682,7 @@ void GUIClient::processLoading()
 		//while((cur_loading_mesh_data.nonNull() || !model_loaded_messages_to_process.empty() || !texture_loaded_messages_to_process.empty()) && (loading_timer.elapsed() < MAX_LOADING_TIME))
 		while((tex_loading_progress.loadingInProgress() || cur_loading_mesh_data.nonNull() || !model_loaded_messages_to_process.empty() || !texture_loaded_messages_to_process.empty()) && 
 			(total_bytes_uploaded < max_total_upload_bytes) && 
-			(loading_timer.elapsed() < MAX_LOADING_TIME) //&&
+			(loading_timer.elapsed() < time_budget) //&&
 			/*(num_items_processed < max_items_to_process)*/)
 		{
 			//num_items_processed++;
@@ -4014,6 +4077,9 @@ void GUIClient::processLoading()
 
 					this->cur_loading_terrain_map = message->terrain_map;
 
+					if(message->streaming_gif.nonNull())
+						streaming_gif_textures[message->tex_key] = message->streaming_gif;
+
 					try
 					{
 						TextureLoading::initialiseTextureLoadingProgress(message->tex_path, opengl_engine, OpenGLTextureKey(message->tex_key), message->tex_params,
@@ -4045,6 +4111,21 @@ void GUIClient::processLoading()
 
 		this->last_model_and_tex_loading_time = loading_timer.elapsed();
 	}
+
+	return model_loaded_messages_to_process.size() + texture_loaded_messages_to_process.size() + 
+		((cur_loading_mesh_data.nonNull() || tex_loading_progress.loadingInProgress()) ? 1 : 0);
+}
+
+
+size_t LoadingFrameWorkUnit::doWork(double time_budget)
+{
+	return gui_client->processLoading(time_budget);
+}
+
+
+size_t LODChangesFrameWorkUnit::doWork(double time_budget)
+{
+	return gui_client->checkForLODChanges(time_budget);
 }
 
 
@@ -4321,10 +4402,16 @@ void GUIClient::processPlayerPhysicsInput(float dt, bool world_render_has_keyboa
 
 void GUIClient::timerEvent(const MouseCursorState& mouse_cursor_state)
 {
+	Timer timerEvent_timer; // Measures CPU time for this frame, for the frame scheduler budget.
+
 	if(world_state)
 	{
-		WorldStateLock lock(this->world_state->mutex);
-		scripted_ob_proximity_checker.think(cam_controller.getPosition().toVec4fPoint(), lock);
+		Timer timer;
+		{
+			WorldStateLock lock(this->world_state->mutex);
+			scripted_ob_proximity_checker.think(cam_controller.getPosition().toVec4fPoint(), lock);
+		}
+		frame_scheduler.addMeasuredTime(proximity_checker_subsystem, timer.elapsed());
 	}
 
 	// Do Lua timer callbacks
@@ -4414,7 +4501,8 @@ void GUIClient::timerEvent(const MouseCursorState& mouse_cursor_state)
 
 
 
-	processLoading();
+	// Handle LOD changes and process loaded models and textures, within this frame's time budget.
+	frame_scheduler.runFrame(total_timer.elapsed());
 
 	
 	
@@ -4520,25 +4608,21 @@ void GUIClient::timerEvent(const MouseCursorState& mouse_cursor_state)
 	}
 
 
-	// Sort load_item_queue every now and then
+	// Update load_item_queue priorities every now and then
 	if(load_item_queue_sort_timer.elapsed() > 0.1)
 	{
-		this->load_item_queue.sortQueue(cam_controller.getPosition());
+		this->load_item_queue.updateItemPriorities(cam_controller.getPosition());
 		load_item_queue_sort_timer.reset();
 	}
 
 
-	// Sort download queue every now and then
-	if(download_queue_sort_timer.elapsed() > 2.0)
+	// Update download queue priorities every now and then.  Only items that may have changed priority band are re-evaluated, so this is cheap.
+	if(download_queue_sort_timer.elapsed() > 0.25)
 	{
-		this->download_queue.sortQueue(cam_controller.getPosition());
+		this->download_queue.updateItemPriorities(cam_controller.getPosition());
 		download_queue_sort_timer.reset();
 	}
 
-	checkForLODChanges();
-
-
-	
 	gesture_ui.think();
 	hud_ui.think();
 	minimap.think();
@@ -4626,6 +4710,21 @@ void GUIClient::timerEvent(const MouseCursorState& mouse_cursor_state)
 		this->last_num_gif_textures_processed = num_gif_textures_processed;
 		this->last_num_mp4_textures_processed = num_mp4_textures_processed;
 
+		// Periodically free decoded frames of streaming GIFs that haven't been displayed for a while, and remove entries for textures that have been unloaded.
+		if(streaming_gif_release_timer.elapsed() > 1.0)
+		{
+			for(auto it = streaming_gif_textures.begin(); it != streaming_gif_textures.end(); )
+			{
+				it->second->releaseFramesIfUnused(anim_time, /*max idle time=*/5.0);
+
+				if(it->second->isUnusedFor(anim_time, /*period=*/60.0) && opengl_engine->getTextureIfLoaded(OpenGLTextureKey(it->first)).isNull())
+					it = streaming_gif_textures.erase(it);
+				else
+					++it;
+			}
+			streaming_gif_release_timer.reset();
+		}
+
 		// Process web-view objects
 		for(auto it = web_view_obs.begin(); it != web_view_obs.end(); ++it)
 		{
@@ -4657,6 +4756,7 @@ void GUIClient::timerEvent(const MouseCursorState& mouse_cursor_state)
 		}
 
 		this->last_animated_tex_time = timer.elapsed();
+		frame_scheduler.addMeasuredTime(animated_tex_subsystem, this->last_animated_tex_time);
 	}
 
 	// NOTE: goes after sceeenshot code, which might update campos.
@@ -5428,7 +5528,11 @@ void GUIClient::timerEvent(const MouseCursorState& mouse_cursor_state)
 	}
 
 
-	updateAvatarGraphics(cur_time, dt, cam_angles, our_move_impulse_zero);
+	{
+		Timer timer;
+		updateAvatarGraphics(cur_time, dt, cam_angles, our_move_impulse_zero);
+		frame_scheduler.addMeasuredTime(avatar_graphics_subsystem, timer.elapsed());
+	}
 
 	// Set third-person camera position.  NOTE: this goes after updateAvatarGraphics since it depends on where the player's avatar is,
 	// which can depend on interpolated vehicle physics etc.
@@ -5557,6 +5661,7 @@ void GUIClient::timerEvent(const MouseCursorState& mouse_cursor_state)
 						removeInstancesOfObject(ob);
 						//removeObScriptingInfo(ob);
 
+						this->world_state->lod_table.removeObject(ob);
 						this->world_state->objects.erase(ob->uid);
 
 						active_objects.erase(ob);
@@ -5590,6 +5695,9 @@ void GUIClient::timerEvent(const MouseCursorState& mouse_cursor_state)
 							ob->in_proximity = false;
 						assert(ob->exclude_from_lod_chunk_mesh == BitUtils::isBitSet(ob->flags, WorldObject::EXCLUDE_FROM_LOD_CHUNK_MESH));
 
+						// Add to LOD table, or re-read flags etc. if already present.  The LOD level will be checked in the next checkForLODChanges() call.
+						this->world_state->lod_table.insertOrUpdateObject(ob);
+
 						if(ob->in_proximity)
 						{
 							loadModelForObject(ob, lock);
@@ -5740,6 +5848,8 @@ void GUIClient::timerEvent(const MouseCursorState& mouse_cursor_state)
 				{
 					active_objects.insert(ob); // Add to active_objects: objects that have moved recently and so need interpolation done on them.
 
+					scripted_ob_proximity_checker.objectTransformChanged(ob);
+
 					ob->from_remote_transform_dirty = false;
 				}
 
@@ -5771,6 +5881,8 @@ void GUIClient::timerEvent(const MouseCursorState& mouse_cursor_state)
 						opengl_engine->updateObjectTransformData(*ob->opengl_engine_ob);
 					}
 
+					scripted_ob_proximity_checker.objectTransformChanged(ob);
+
 					ob->from_remote_summoned_dirty = false;
 				}
 			}
@@ -6038,15 +6150,23 @@ void GUIClient::timerEvent(const MouseCursorState& mouse_cursor_state)
 
 	
 	if(frame_num % 8 == 0)
+	{
+		Timer timer;
 		checkForAudioRangeChanges();
+		frame_scheduler.addMeasuredTime(audio_range_subsystem, timer.elapsed());
+	}
 
 	if(terrain_system.nonNull())
+	{
+		Timer timer;
 		terrain_system->updateCampos(this->cam_controller.getPosition(), stack_allocator);
+		frame_scheduler.addMeasuredTime(terrain_subsystem, timer.elapsed());
+	}
 
 	if(terrain_decal_manager.nonNull())
 		terrain_decal_manager->think((float)dt);
 	if(particle_manager.nonNull())
-		particle_manager->think((float)dt);
+		particle_manager->think((float)dt, this->cam_controller.getPosition().toVec4fPoint());
 
 	if(opengl_engine.nonNull())
 	{
@@ -6055,6 +6175,8 @@ void GUIClient::timerEvent(const MouseCursorState& mouse_cursor_state)
 
 
 	frame_num++;
+
+	frame_scheduler.setFrameCPUTime(timerEvent_timer.elapsed());
 }
 
 
@@ -7325,6 +7447,16 @@ void GUIClient::handleMessages(double global_time, double cur_time)
 			else
 				conPrint("Invalid sampling rate, ignoring RemoteClientAudioStreamToServerStarted message");
 		}
+		else if(dynamic_cast<const MinClientProtocolVersionMessage*>(msg))
+		{
+			// Sent by ClientThread after receiving MinClientProtocolVersion message from server.
+			const bool prev_long_voice_frames_allowed = longVoiceFramesAllowed();
+
+			this->min_client_protocol_version = static_cast<const MinClientProtocolVersionMessage*>(msg)->min_client_protocol_version;
+
+			if(longVoiceFramesAllowed() != prev_long_voice_frames_allowed)
+				mic_read_thread_manager.enqueueMessage(new LongVoiceFramesAllowedChangedMessage(longVoiceFramesAllowed()));
+		}
 		else if(dynamic_cast<const RemoteClientAudioStreamToServerEnded*>(msg))
 		{
 			// Sent by ClientThread to this GUIClient after receiving AudioStreamToServerEnded message from server.
@@ -7655,14 +7787,17 @@ void GUIClient::handleMessages(double global_time, double cur_time)
 			{
 				if(resource_manager->isFileForURLPresent(m->URL))
 				{
-					const std::string path = resource_manager->pathForURL(m->URL);
+					PackedResourceCache::PinRef extracted_file_pin;
+					const std::string path = resource_manager->extractedPathForURL(m->URL, extracted_file_pin);
 
 					const std::string username = ui_interface->getUsernameForDomain(server_hostname);
 					const std::string password = ui_interface->getDecryptedPasswordForDomain(server_hostname);
 
 					this->num_resources_uploading++;
-					resource_upload_thread_manager.addThread(new UploadResourceThread(&this->msg_queue, path, m->URL, server_hostname, server_port, username, password, this->client_tls_config, 
-						&this->num_resources_uploading));
+					UploadResourceThread* upload_thread = new UploadResourceThread(&this->msg_queue, path, m->URL, server_hostname, server_port, username, password, this->client_tls_config, 
+						&this->num_resources_uploading);
+					upload_thread->local_file_pin = extracted_file_pin;
+					resource_upload_thread_manager.addThread(upload_thread);
 					print("Received GetFileMessage, Uploading resource with URL '" + m->URL + "' to server.");
 				}
 				else
@@ -7717,7 +7852,7 @@ void GUIClient::handleMessages(double global_time, double cur_time)
 							}
 						}
 
-						const bool valid_extension = FileTypes::hasSupportedExtension(m->URL);
+						const bool valid_extension = FileTypes::hasSupportedExtension(m->URL) || ModelLoading::hasGPUMeshExtension(m->URL);
 						conPrint("need_resource: " + boolToString(need_resource) + " valid_extension: " + boolToString(valid_extension));
 
 						if(need_resource && valid_extension)// && !shouldStreamResourceViaHTTP(m->URL))
@@ -7810,7 +7945,7 @@ void GUIClient::handleMessages(double global_time, double cur_time)
 							}
 						}
 					}
-					else if(ModelLoading::hasSupportedModelExtension(local_path)) // Else we didn't download a texture, but maybe a model:
+					else if(ModelLoading::hasSupportedModelExtension(local_path) || ModelLoading::hasGPUMeshExtension(local_path)) // Else we didn't download a texture, but maybe a model:
 					{
 						try
 						{
@@ -7823,6 +7958,7 @@ void GUIClient::handleMessages(double global_time, double cur_time)
 							load_model_task->unit_cube_shape = this->unit_cube_shape;
 							load_model_task->result_msg_queue = &this->msg_queue;
 							load_model_task->resource_manager = resource_manager;
+							load_model_task->physics_shape_cache = physics_shape_cache;
 							load_model_task->build_physics_ob = build_physics_ob;
 							load_model_task->build_dynamic_physics_ob = build_dynamic_physics_ob;
 
@@ -7935,9 +8071,18 @@ std::string GUIClient::getDiagnosticsString(bool do_graphics_diagnostics, bool d
 	msg += "FPS: " + doubleToStringNDecimalPlaces(this->last_fps, 1) + "\n";
 	msg += "main loop CPU time: " + doubleToStringNSigFigs(last_timerEvent_CPU_work_elapsed * 1000, 3) + " ms\n";
 	msg += "main loop updateGL time: " + doubleToStringNSigFigs(last_updateGL_time * 1000, 3) + " ms\n";
+	msg += frame_scheduler.getDiagnostics();
+	if(capture_writer.nonNull())
+		msg += capture_writer->getDiagnostics();
 	msg += "last_animated_tex_time: " + doubleToStringNSigFigs(this->last_animated_tex_time * 1000, 3) + " ms\n";
 	msg += "last_num_gif_textures_processed: " + toString(last_num_gif_textures_processed) + "\n";
 	msg += "last_num_mp4_textures_processed: " + toString(last_num_mp4_textures_processed) + "\n";
+	{
+		size_t streaming_gif_mem = 0;
+		for(auto it = streaming_gif_textures.begin(); it != streaming_gif_textures.end(); ++it)
+			streaming_gif_mem += it->second->getTotalCPUMemUsage();
+		msg += "streaming GIFs: " + toString(streaming_gif_textures.size()) + " (decoded frames: " + getNiceByteSize(streaming_gif_mem) + ")\n";
+	}
 	msg += "last_eval_script_time: " + doubleToStringNSigFigs(last_eval_script_time * 1000, 3) + "ms\n";
 	msg += "num obs with scripts: " + toString(obs_with_scripts.size()) + "\n";
 	msg += "last_num_scripts_processed: " + toString(last_num_scripts_processed) + "\n";
@@ -7976,6 +8121,14 @@ std::string GUIClient::getDiagnosticsString(bool do_graphics_diagnostics, bool d
 	msg += resource_manager->getDiagnostics();
 	msg += "----------------------------------------\n";
 
+	if(physics_shape_cache.nonNull())
+		msg += physics_shape_cache->getDiagnostics();
+
+	msg += "------------Resource Downloads------------\n";
+	msg += "download_queue: " + toString(download_queue.size()) + "\n";
+	msg += resource_download_stats.getDiagnostics();
+	msg += "------------------------------------------\n";
+
 	{
 		msg += "\nAudio engine:\n";
 		{
@@ -7983,6 +8136,7 @@ std::string GUIClient::getDiagnosticsString(bool do_graphics_diagnostics, bool d
 			msg += "Num audio obs: " + toString(audio_obs.size()) + "\n";
 			msg += "Num active audio sources: " + toString(audio_engine.audio_sources.size()) + "\n";
 		}
+		msg += audio_engine.getDiagnostics();
 		/*msg += "Audio sources\n";
 		Lock lock(audio_engine.mutex);
 		for(auto it = audio_engine.audio_sources.begin(); it != audio_engine.audio_sources.end(); ++it)
@@ -8857,7 +9011,8 @@ void GUIClient::createObjectLoadedFromXML(WorldObjectRef new_world_object, Print
 
 			// Resource is present locally.
 			// Load mesh from disk.  TODO: cache loaded meshes for this method
-			batched_mesh = BatchedMesh::readFromFile(resource_manager->pathForURL(new_world_object->model_url), /*mem allocator=*/NULL); // NOTE: assuming URLs are bmeshes.
+			PackedResourceCache::PinRef extracted_file_pin; // Stops the extracted file from being deleted while we are reading it.
+			batched_mesh = BatchedMesh::readFromFile(resource_manager->extractedPathForURL(new_world_object->model_url, extracted_file_pin), /*mem allocator=*/NULL); // NOTE: assuming URLs are bmeshes.
 		}
 
 		new_world_object->setAABBOS(batched_mesh->aabb_os);
@@ -9950,7 +10105,8 @@ void GUIClient::objectEdited()
 			{
 				removeAndDeleteGLAndPhysicsObjectsForOb(*this->selected_ob); // Remove old opengl and physics objects
 
-				const std::string mesh_path = FileUtils::fileExists(this->selected_ob->model_url) ? this->selected_ob->model_url : resource_manager->pathForURL(this->selected_ob->model_url);
+				PackedResourceCache::PinRef extracted_file_pin; // Stops the extracted file from being deleted while we are reading it.
+				const std::string mesh_path = FileUtils::fileExists(this->selected_ob->model_url) ? this->selected_ob->model_url : resource_manager->extractedPathForURL(this->selected_ob->model_url, extracted_file_pin);
 
 				ModelLoading::MakeGLObjectResults results;
 				ModelLoading::makeGLObjectForModelFile(*opengl_engine, *opengl_engine->vert_buf_allocator, mesh_path,
@@ -9993,6 +10149,7 @@ void GUIClient::objectEdited()
 						this->resource_manager->copyLocalFileToResourceDir(bmesh_disk_path, mesh_URL);
 
 					this->selected_ob->model_url = mesh_URL;
+					BitUtils::zeroBit(this->selected_ob->flags, WorldObject::GPU_MESH_PRESENT_FLAG); // Server will set this again once it has generated GPU meshes for the new model.
 					this->selected_ob->max_model_lod_level = (results.batched_mesh->numVerts() <= 4 * 6) ? 0 : 2; // If this is a very small model (e.g. a cuboid), don't generate LOD versions of it.
 					this->selected_ob->setAABBOS(results.batched_mesh->aabb_os);
 				}
@@ -10511,6 +10668,8 @@ void GUIClient::visitSubURL(const std::string& URL) // Visit a substrata 'sub://
 
 void GUIClient::disconnectFromServerAndClearAllObjects() // Remove any WorldObjectRefs held by GUIClient.
 {
+	finishCapture();
+
 	udp_socket = NULL;
 
 	load_item_queue.clear();
@@ -10572,6 +10731,7 @@ void GUIClient::disconnectFromServerAndClearAllObjects() // Remove any WorldObje
 
 	this->client_avatar_uid = UID::invalidUID();
 	this->server_protocol_version = 0;
+	this->min_client_protocol_version = 0;
 
 
 	this->logged_in_user_id = UserID::invalidUserID();
@@ -10804,6 +10964,39 @@ void GUIClient::connectToServer(const URLParseResults& parse_res)
 
 	client_thread = new ClientThread(&msg_queue, server_hostname, server_port, server_worldname, this->client_tls_config, this->world_ob_pool_allocator);
 	client_thread->world_state = world_state;
+
+#if !defined(EMSCRIPTEN)
+	if(!replay_capture_path.empty())
+	{
+		// Add the resources from the capture to the resource manager first, so they don't need to be downloaded.
+		// Any resources not in the capture will be downloaded from the server as usual, if it is reachable.
+		try
+		{
+			Timer timer;
+			const size_t num_added = NetCaptureReader::installResources(replay_capture_path, *resource_manager);
+			logAndConPrintMessage("Added " + toString(num_added) + " resources from capture '" + replay_capture_path + "' in " + timer.elapsedString());
+		}
+		catch(glare::Exception& e)
+		{
+			logAndConPrintMessage("Error adding resources from capture: " + e.what());
+		}
+
+		client_thread->setReplayCapture(replay_capture_path, replay_speed);
+	}
+	else if(!record_capture_path.empty())
+	{
+		try
+		{
+			capture_writer = new NetCaptureWriter(record_capture_path);
+			client_thread->setCaptureWriter(capture_writer);
+		}
+		catch(glare::Exception& e)
+		{
+			logAndConPrintMessage("Error creating capture file: " + e.what());
+		}
+	}
+#endif
+
 	client_thread_manager.addThread(client_thread);
 
 #if defined(EMSCRIPTEN)
@@ -10811,7 +11004,7 @@ void GUIClient::connectToServer(const URLParseResults& parse_res)
 #else
 	for(int z=0; z<4; ++z)
 		resource_download_thread_manager.addThread(new DownloadResourcesThread(&msg_queue, resource_manager, server_hostname, server_port, &this->num_non_net_resources_downloading, this->client_tls_config,
-			&this->download_queue));
+			&this->download_queue, &this->resource_download_stats, /*connection_index=*/z));
 
 	for(int i=0; i<4; ++i)
 		net_resource_download_thread_manager.addThread(new NetDownloadResourcesThread(&msg_queue, resource_manager, &num_net_resources_downloading));
@@ -10876,6 +11069,59 @@ void GUIClient::connectToServer(const URLParseResults& parse_res)
 }
 
 
+void GUIClient::finishCapture()
+{
+	if(capture_writer.isNull())
+		return;
+
+	// Resources that were already in the cache when recording were not downloaded, so write all resources used by the world,
+	// so the capture can be replayed on a machine with an empty cache.
+	std::set<DependencyURL> URLs;
+	if(world_state.nonNull())
+	{
+		Lock lock(this->world_state->mutex);
+
+		for(auto it = this->world_state->objects.valuesBegin(); it != this->world_state->objects.valuesEnd(); ++it)
+			it.getValue()->getDependencyURLSetForAllLODLevels(URLs);
+
+		for(auto it = this->world_state->avatars.begin(); it != this->world_state->avatars.end(); ++it)
+			it->second->getDependencyURLSetForAllLODLevels(URLs);
+	}
+
+	size_t num_written = 0;
+	for(auto it = URLs.begin(); it != URLs.end(); ++it)
+	{
+		const std::string& URL = it->URL;
+		try
+		{
+			ResourceRef resource = resource_manager->getExistingResourceForURL(URL);
+			if(resource.isNull() || !resource->isPresent())
+				continue;
+
+			PackedResourceCache::ReadRef packed_data;
+			if(resource_manager->getPackedCache().nonNull() && resource_manager->getPackedCache()->getData(URL, packed_data))
+			{
+				capture_writer->writeResource(URL, packed_data.data.data(), packed_data.data.size());
+			}
+			else
+			{
+				MemMappedFile file(resource_manager->getLocalAbsPathForResource(*resource));
+				capture_writer->writeResource(URL, (const uint8*)file.fileData(), file.fileSize());
+			}
+			num_written++;
+		}
+		catch(glare::Exception& e)
+		{
+			logAndConPrintMessage("Error writing resource '" + URL + "' to capture: " + e.what());
+		}
+	}
+
+	logAndConPrintMessage("Wrote " + toString(num_written) + " resources to capture '" + record_capture_path + "'.");
+
+	capture_writer = NULL; // Closes the file.
+}
+
+
 static float sensorWidth() { return 0.035f; }
 static float lensSensorDist() { return 0.025f; }
 
@@ -12603,7 +12849,7 @@ void GUIClient::updateGroundPlane()
 		}
 
 
-		// Convert URL-based terrain spec to path-based spec
+		// Convert URL-based terrain spec to path-based spec.  The paths are used as texture keys, the maps are extracted from the packed cache by the LoadTextureTasks that load them.
 		const TerrainSpec& spec = this->connected_world_settings.terrain_spec;
 		TerrainPathSpec path_spec;
 		path_spec.section_specs.resize(spec.section_specs.size());
@@ -12863,7 +13109,9 @@ void GUIClient::setMicForVoiceChatEnabled(bool enabled)
 				Reference<glare::MicReadThread> mic_read_thread = new glare::MicReadThread(&this->msg_queue, this->udp_socket, this->client_avatar_uid, server_hostname, server_UDP_port,
 					settings->getStringValue("setting/input_device_name", "Default"), //MainOptionsDialog::getInputDeviceName(settings),
 					settings->getIntValue("setting/input_scale_factor_name", /*default val=*/100) * 0.01f, // NOTE: stored in percent in settings //MainOptionsDialog::getInputScaleFactor(settings), // input_vol_scale_factor
-					&mic_read_status
+					&mic_read_status,
+					settings->getIntValue("setting/voice_frame_duration_ms", glare::MicReadThread::DEFAULT_FRAME_DURATION_MS),
+					longVoiceFramesAllowed()
 				);
 				mic_read_thread_manager.addThread(mic_read_thread);
 			}
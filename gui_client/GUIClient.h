@@ -19,12 +19,17 @@ Copyright Glare Technologies Limited 2024 -
 #include "ChatUI.h"
 #include "MiniMap.h"
 #include "DownloadingResourceQueue.h"
+#include "ResourceDownloadStats.h"
 #include "LoadItemQueue.h"
 #include "MeshManager.h"
 #include "URLParser.h"
 #include "WorldState.h"
 #include "EmscriptenResourceDownloader.h"
 #include "ScriptedObjectProximityChecker.h"
+#include "StreamingGIFTexture.h"
+#include "PhysicsShapeCache.h"
+#include "FrameWorkScheduler.h"
+#include "NetCapture.h"
 #include "../shared/WorldSettings.h"
 #include "../audio/AudioEngine.h"
 #include "../audio/MicReadThread.h" // For MicReadStatus
@@ -46,6 +51,7 @@ Copyright Glare Technologies Limited 2024 -
 #include <networking/IPAddress.h>
 #include <string>
 #include <unordered_set>
+#include <unordered_map>
 #include <deque>
 class UDPSocket;
 namespace Ui { class MainWindow; }
@@ -96,6 +102,27 @@ struct DownloadingResourceInfo
 extern float proj_len_viewable_threshold; // TEMP for tweaking with ImGui.
 
 
+class GUIClient;
+
+
+// Runs GUIClient::processLoading() as a FrameWorkScheduler work unit.
+class LoadingFrameWorkUnit : public FrameWorkUnit
+{
+public:
+	virtual size_t doWork(double time_budget) override;
+	GUIClient* gui_client;
+};
+
+
+// Runs GUIClient::checkForLODChanges() as a FrameWorkScheduler work unit.
+class LODChangesFrameWorkUnit : public FrameWorkUnit
+{
+public:
+	virtual size_t doWork(double time_budget) override;
+	GUIClient* gui_client;
+};
+
+
 /*=====================================================================
 GUIClient
 ---------------
@@ -245,7 +272,7 @@ public:
 	void pickUpSelectedObject();
 	void dropSelectedObject();
 
-	void checkForLODChanges();
+	size_t checkForLODChanges(double time_budget); // Returns number of LOD changes not handled yet.
 	void checkForAudioRangeChanges();
 
 	int mouseOverAxisArrowOrRotArc(const Vec2f& pixel_coords, Vec4f& closest_seg_point_ws_out); // Returns closest axis arrow or -1 if no close.
@@ -300,9 +327,12 @@ public:
 
 	void disconnectFromServerAndClearAllObjects(); // Remove any WorldObjectRefs held by MainWindow.
 
+	// Writes the resources used by objects and avatars in the world to the capture file, then closes it.
+	void finishCapture();
+
 	void connectToServer(const URLParseResults& url_results);
 
-	void processLoading();
+	size_t processLoading(double time_budget); // Returns number of loaded models and textures not yet processed.
 	ObjectPathController* getPathControllerForOb(const WorldObject& ob);
 	void createPathControlledPathVisObjects(const WorldObject& ob);
 	Reference<VehiclePhysics> createVehicleControllerForScript(WorldObject* ob);
@@ -386,6 +416,7 @@ public:
 	ThreadManager save_resources_db_thread_manager;
 
 	glare::AtomicInt num_non_net_resources_downloading;
+	ResourceDownloadStats resource_download_stats;
 	glare::AtomicInt num_net_resources_downloading;
 	glare::AtomicInt num_resources_uploading;
 
@@ -406,6 +437,8 @@ public:
 
 	Reference<ResourceManager> resource_manager;
 
+	PhysicsShapeCacheRef physics_shape_cache; // May be null.
+
 
 	// NOTE: these object sets need to be cleared in connectToServer(), also when removing a dead object in ob->state == WorldObject::State_Dead case in timerEvent, the object needs to be removed
 	// from any of these sets it is in.
@@ -492,6 +525,9 @@ public:
 	std::deque<Reference<ModelLoadedThreadMessage> > model_loaded_messages_to_process;
 	
 	std::deque<Reference<TextureLoadedThreadMessage> > texture_loaded_messages_to_process;
+
+	std::unordered_map<std::string, StreamingGIFTextureRef> streaming_gif_textures; // Map from texture key to streaming GIF data, for animated GIFs with frames decoded on demand.
+	Timer streaming_gif_release_timer;
 	
 	bool process_model_loaded_next;
 
@@ -621,6 +657,9 @@ public:
 
 	UID client_avatar_uid; // When we connect to a server, the server assigns a UID to the client/avatar.
 	uint32 server_protocol_version;
+	uint32 min_client_protocol_version; // Minimum protocol version of all clients connected to the server, as reported by the server.  0 if not known.
+
+	bool longVoiceFramesAllowed() const { return min_client_protocol_version >= 41; } // Clients with protocol version < 41 can only decode 10 ms voice frames.
 
 	uint64 frame_num;
 
@@ -679,6 +718,8 @@ public:
 
 	std::vector<Reference<ThreadMessage> > temp_msgs;
 
+	std::vector<ObjectLODTable::ObjectLODChange> temp_lod_changes;
+
 	bool extracted_anim_data_loaded;
 
 	URLParseResults last_url_parse_results;
@@ -706,5 +747,20 @@ public:
 
 	ParcelID cur_in_parcel_id;
 
+	FrameWorkScheduler frame_scheduler;
+	LoadingFrameWorkUnit loading_work_unit;
+	LODChangesFrameWorkUnit lod_changes_work_unit;
+	int proximity_checker_subsystem;
+	int animated_tex_subsystem;
+	int avatar_graphics_subsystem;
+	int audio_range_subsystem;
+	int terrain_subsystem;
+
+	// Network message capture and replay, see NetCapture.h.  Should be set before connectToServer() is called.
+	std::string record_capture_path; // If non-empty, messages received from the server are recorded to this path.
+	std::string replay_capture_path; // If non-empty, messages are replayed from this capture instead of connecting to the server.
+	double replay_speed; // Replay speed relative to the recorded message timings.  0 to replay as fast as possible.
+	Reference<NetCaptureWriter> capture_writer;
+
 	bool last_cursor_movement_was_from_mouse; // as opposed to from gamepad moving crosshair.
 };
@@ -0,0 +1,95 @@
+/*=====================================================================
+HashedObGrid.cpp
+----------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#include "HashedObGrid.h"
+
+
+#if BUILD_TESTS
+
+
+#include "../utils/TestUtils.h"
+#include "../utils/ConPrint.h"
+#include "../maths/PCG32.h"
+#include <set>
+
+
+static Vec4f randomPos(PCG32& rng, float extent)
+{
+	return Vec4f((rng.unitRandom() - 0.5f) * extent, (rng.unitRandom() - 0.5f) * extent, rng.unitRandom() * 50.f, 1.f);
+}
+
+
+void HashedObGrid::test()
+{
+	conPrint("HashedObGrid::test()");
+
+	//-------------------- Test insert, remove, update and queries against brute force --------------------
+	{
+		PCG32 rng(1);
+		const int N = 1000;
+		std::vector<WorldObjectRef> obs(N);
+		std::vector<Vec4f> centroids(N);
+		std::vector<float> radii(N);
+
+		HashedObGrid grid(/*cell_w=*/10.f, /*expected_num_items=*/N);
+		for(int i=0; i<N; ++i)
+		{
+			obs[i] = new WorldObject();
+			centroids[i] = randomPos(rng, 200.f);
+			radii[i] = (i % 50 == 0) ? (rng.unitRandom() * 100.f) : (rng.unitRandom() * 5.f); // Include some large objects, that are bigger than a cell.
+			grid.insert(obs[i].ptr(), centroids[i], radii[i]);
+		}
+		testAssert(grid.numObjects() == N);
+		testAssert(grid.numLargeObjects() > 0 && grid.numLargeObjects() <= N / 50);
+
+		// Move some objects, remove some others.
+		std::vector<bool> in_grid(N, true);
+		for(int i=0; i<N; i += 3)
+		{
+			const Vec4f new_centroid = (i % 2 == 0) ? (centroids[i] + Vec4f(0.1f, 0, 0, 0)) : randomPos(rng, 200.f); // Mix of same-cell and different-cell moves.
+			if(i % 5 == 0)
+				radii[i] = (radii[i] > grid.large_ob_radius) ? 1.f : 50.f; // Change some objects between small and large.
+			grid.update(obs[i].ptr(), centroids[i], new_centroid, radii[i]);
+			centroids[i] = new_centroid;
+		}
+		for(int i=1; i<N; i += 7)
+		{
+			testAssert(grid.remove(obs[i].ptr(), centroids[i]));
+			in_grid[i] = false;
+		}
+		testAssert(!grid.remove(obs[1].ptr(), centroids[1])); // Already removed
+
+		size_t num_in_grid = 0;
+		for(int i=0; i<N; ++i)
+			if(in_grid[i])
+				num_in_grid++;
+		testAssert(grid.numObjects() == num_in_grid);
+
+		for(int q=0; q<100; ++q)
+		{
+			const Vec4f query_pos = randomPos(rng, 200.f);
+			const float query_r = rng.unitRandom() * 30.f;
+
+			std::set<WorldObject*> grid_results;
+			grid.forEachObInSphere(query_pos, query_r, [&](WorldObject* ob, const Vec4f& /*centroid_and_radius*/) { testAssert(grid_results.insert(ob).second); });
+
+			std::set<WorldObject*> ref_results;
+			for(int i=0; i<N; ++i)
+				if(in_grid[i] && (query_pos.getDist(centroids[i]) <= query_r + radii[i]))
+					ref_results.insert(obs[i].ptr());
+
+			testAssert(grid_results == ref_results);
+		}
+
+		grid.clear();
+		testAssert(grid.numObjects() == 0);
+		testAssert(grid.getCellForIndices(0, 0, 0) == NULL);
+	}
+
+	conPrint("HashedObGrid::test() done.");
+}
+
+
+#endif // BUILD_TESTS
@@ -7,42 +7,75 @@ Copyright Glare Technologies Limited 2021 -
 
 
 #include "../shared/WorldObject.h"
-#include <unordered_set>
+#include "../utils/HashMapInsertOnly2.h"
+#include "../utils/Vector.h"
+#include "../maths/vec3.h"
+#include <vector>
+#include <limits>
 
 
+/*=====================================================================
+HashedObGridCell
+----------------
+Objects whose centroid lies in a single grid cell.
+Stored in structure-of-arrays form, so that range and proximity queries
+are a linear scan over centroid_and_radius, without touching the objects themselves.
+=====================================================================*/
+class HashedObGridCell
+{
+public:
+	inline size_t size() const { return objects.size(); }
+	inline bool empty() const { return objects.empty(); }
+
+	js::Vector<Vec4f, 16> centroid_and_radius; // (x, y, z) = world space centroid of object, w = bounding radius of object.
+	std::vector<WorldObject*> objects;
+};
+
 
-class HashedObGridBucket
+class HashedObGridCellHash
 {
 public:
-	//SmallVector<WorldObjectRef, 2> objects;
-	std::unordered_set<WorldObjectRef, WorldObjectRefHash> objects;
+	inline size_t operator() (const Vec3<int>& v) const
+	{
+		// NOTE: technically possible undefined behaviour here (signed overflow)
+		return (size_t)(uint32)((v.x * 73856093) ^ (v.y * 19349663) ^ (v.z * 83492791));
+	}
 };
 
 
 /*=====================================================================
 HashedObGrid
 ------------
-TODO: Try using open addressing (don't use a vector in buckets, spill into adjacent buckets)
+Uniform grid over all of space, with cells stored in a flat array.
+Cell coordinates are mapped to indices into the cell array with an open-addressed hash map.
+Cells are not removed from the hash map when they become empty, they are just reused if objects move back into them.
+
+Objects are inserted into the cell containing their centroid.  Queries are expanded
+by large_ob_radius (half the cell width), so objects overlapping a query region are not missed.
+Objects with a bounding radius larger than large_ob_radius are instead kept in a separate list
+which is checked by every query, so a few very large objects don't make every query scan more cells.
+
+Objects are not reference-counted by the grid, so must be removed before they are destroyed.
 =====================================================================*/
 class HashedObGrid
 {
 public:
 	HashedObGrid(float cell_w_, int expected_num_items)
 	:	cell_w(cell_w_),
-		recip_cell_w(1 / cell_w_)
+		recip_cell_w(1 / cell_w_),
+		large_ob_radius(cell_w_ * 0.5f),
+		cell_indices(/*empty key=*/Vec3<int>(std::numeric_limits<int>::min()), /*expected num items=*/myMax(8, expected_num_items)),
+		num_objects(0)
 	{
 		assert(expected_num_items > 0);
-
-		const unsigned int num_buckets = myMax<unsigned int>(8, (unsigned int)Maths::roundToNextHighestPowerOf2((unsigned int)expected_num_items/* * 2*/));
-		buckets.resize(num_buckets);
-
-		hash_mask = num_buckets - 1;
 	}
 
 	inline void clear()
 	{
-		for(size_t i = 0; i < buckets.size(); ++i)
-			buckets[i].objects.clear();
+		cell_indices.clear();
+		cells.clear();
+		large_objects = HashedObGridCell();
+		num_objects = 0;
 	}
 
 	inline Vec4i bucketIndicesForPoint(const Vec4f& p) const
@@ -50,75 +83,142 @@ public:
 		return floorToVec4i(p * recip_cell_w);
 	}
 
-	inline void insert(const WorldObjectRef& ob)
+	inline void insert(WorldObject* ob, const Vec4f& centroid, float radius)
 	{
-		unsigned int bucket_i = getBucketIndexForPoint(ob->pos.toVec4fPoint());
-		//buckets[bucket_i].objects.push_back(ob);
-		buckets[bucket_i].objects.insert(ob);
+		HashedObGridCell& cell = (radius > large_ob_radius) ? large_objects : getOrCreateCellForPoint(centroid);
+		cell.centroid_and_radius.push_back(Vec4f(centroid[0], centroid[1], centroid[2], radius));
+		cell.objects.push_back(ob);
+
+		num_objects++;
 	}
 
-	inline void remove(const WorldObjectRef& ob)
+	// centroid should be the centroid the object was inserted (or last updated) with.
+	// Returns true if the object was found and removed.
+	inline bool remove(WorldObject* ob, const Vec4f& centroid)
 	{
-		unsigned int bucket_i = getBucketIndexForPoint(ob->pos.toVec4fPoint());
-		// Find item
-		/*for(size_t i=0; i<buckets[bucket_i].objects.size(); ++i)
+		HashedObGridCell* cell = getCellForPoint(centroid);
+		if((cell && removeFromCell(*cell, ob)) || removeFromCell(large_objects, ob))
 		{
-			if(buckets[bucket_i].objects[i] == ob)
-			{
-				buckets[bucket_i].objects.erase(buckets[bucket_i].objects.begin() + i);
-				return;
-			}
-		}*/
-		buckets[bucket_i].objects.erase(ob);
+			num_objects--;
+			return true;
+		}
+		return false;
 	}
 
-#if GUI_CLIENT
-	inline void removeAtLastPos(const WorldObjectRef& ob)
+	// Update the bounds of an object that is already in the grid.  old_centroid should be the centroid the object was inserted (or last updated) with.
+	inline void update(WorldObject* ob, const Vec4f& old_centroid, const Vec4f& new_centroid, float new_radius)
 	{
-		//unsigned int bucket_i = getBucketIndexForPoint(ob->last_pos.toVec4fPoint());
-		//buckets[bucket_i].objects.erase(ob);
+		const Vec4i old_indices = bucketIndicesForPoint(old_centroid);
+		const Vec4i new_indices = bucketIndicesForPoint(new_centroid);
+		if((new_radius <= large_ob_radius) && old_indices[0] == new_indices[0] && old_indices[1] == new_indices[1] && old_indices[2] == new_indices[2])
+		{
+			// Object is still in the same cell, just update bounds in place.
+			HashedObGridCell* cell = getCellForPoint(old_centroid);
+			if(cell)
+				for(size_t i=0; i<cell->objects.size(); ++i)
+					if(cell->objects[i] == ob)
+					{
+						cell->centroid_and_radius[i] = Vec4f(new_centroid[0], new_centroid[1], new_centroid[2], new_radius);
+						return;
+					}
+		}
+
+		// Object has changed cell, or is (or was) a large object.
+		remove(ob, old_centroid);
+		insert(ob, new_centroid, new_radius);
 	}
-#endif
 
-
-	inline const HashedObGridBucket& getBucketForIndices(const Vec4i& p) const
+	// Returns NULL if there is no cell with the given indices.
+	inline const HashedObGridCell* getCellForIndices(int x, int y, int z) const
 	{
-		return buckets[computeHash(p)];
+		auto res = cell_indices.find(Vec3<int>(x, y, z));
+		return (res == cell_indices.end()) ? NULL : &cells[res->second];
 	}
 
-	inline const HashedObGridBucket& getBucketForIndices(const int x, const int y, const int z) const
-	{
-		return buckets[computeHash(x, y, z)];
-	}
+	inline const HashedObGridCell* getCellForIndices(const Vec4i& p) const { return getCellForIndices(p[0], p[1], p[2]); }
 
-	inline unsigned int getBucketIndexForPoint(const Vec4f& p) const
+	// Calls f(WorldObject* ob, const Vec4f& centroid_and_radius) for each object whose bounding sphere intersects the query sphere.
+	template <class Func>
+	inline void forEachObInSphere(const Vec4f& query_centre, float query_radius, Func f) const
 	{
-		const Vec4i p_i = floorToVec4i(p * recip_cell_w); //truncateToVec4i((p - grid_aabb.min_) * recip_cell_w);
+		const float expanded_r = query_radius + large_ob_radius; // Objects in cells have radius <= large_ob_radius.
+		const Vec4i begin = bucketIndicesForPoint(query_centre - Vec4f(expanded_r, expanded_r, expanded_r, 0));
+		const Vec4i end   = bucketIndicesForPoint(query_centre + Vec4f(expanded_r, expanded_r, expanded_r, 0)); // inclusive
 
-		return computeHash(p_i);
-	}
+		const Vec4f query_centre_xyz = maskWToZero(query_centre);
 
+		for(int z = begin[2]; z <= end[2]; ++z)
+		for(int y = begin[1]; y <= end[1]; ++y)
+		for(int x = begin[0]; x <= end[0]; ++x)
+		{
+			const HashedObGridCell* cell = getCellForIndices(x, y, z);
+			if(cell)
+				forEachObInCellInSphere(*cell, query_centre_xyz, query_radius, f);
+		}
 
-	inline unsigned int computeHash(const Vec4i& p_i) const
-	{
-		// NOTE: technically possible undefined behaviour here (signed overflow)
+		forEachObInCellInSphere(large_objects, query_centre_xyz, query_radius, f);
+	}
+
+	inline size_t numObjects() const { return num_objects; }
+	inline size_t numCells() const { return cells.size(); }
+	inline size_t numLargeObjects() const { return large_objects.size(); }
 
-		//unsigned int u[4];
-		//storeVec4i(p_i, u);
+	static void test();
 
-		return ((p_i[0] * 73856093) ^ (p_i[1] * 19349663) ^ (p_i[2] * 83492791)) & hash_mask;
+private:
+	template <class Func>
+	static inline void forEachObInCellInSphere(const HashedObGridCell& cell, const Vec4f& query_centre_xyz, float query_radius, Func& f)
+	{
+		const Vec4f* const bounds = cell.centroid_and_radius.data();
+		const size_t num = cell.centroid_and_radius.size();
+		for(size_t i=0; i<num; ++i)
+		{
+			const Vec4f b = bounds[i];
+			const float r = b[3] + query_radius;
+			if(query_centre_xyz.getDist2(maskWToZero(b)) <= r * r)
+				f(cell.objects[i], b);
+		}
 	}
 
-	inline unsigned int computeHash(int x, int y, int z) const
+	// Returns true if the object was found and removed.
+	static inline bool removeFromCell(HashedObGridCell& cell, WorldObject* ob)
 	{
-		// NOTE: technically possible undefined behaviour here (signed overflow)
+		for(size_t i=0; i<cell.objects.size(); ++i)
+			if(cell.objects[i] == ob)
+			{
+				// Swap with last item and pop back
+				cell.objects[i] = cell.objects.back();
+				cell.objects.pop_back();
+				cell.centroid_and_radius[i] = cell.centroid_and_radius.back();
+				cell.centroid_and_radius.pop_back();
+				return true;
+			}
+		return false;
+	}
 
-		return ((x * 73856093) ^ (y * 19349663) ^ (z * 83492791)) & hash_mask;
+	inline HashedObGridCell* getCellForPoint(const Vec4f& p)
+	{
+		const Vec4i p_i = bucketIndicesForPoint(p);
+		auto res = cell_indices.find(Vec3<int>(p_i[0], p_i[1], p_i[2]));
+		return (res == cell_indices.end()) ? NULL : &cells[res->second];
 	}
 
+	inline HashedObGridCell& getOrCreateCellForPoint(const Vec4f& p)
+	{
+		const Vec4i p_i = bucketIndicesForPoint(p);
+		const auto insert_res = cell_indices.insert(std::make_pair(Vec3<int>(p_i[0], p_i[1], p_i[2]), (uint32)cells.size()));
+		if(insert_res.second) // If cell was newly inserted:
+			cells.push_back(HashedObGridCell());
+		return cells[insert_res.first->second];
+	}
 
-	float recip_cell_w;
+public:
 	float cell_w;
-	std::vector<HashedObGridBucket> buckets;
-	uint32 hash_mask; // hash_mask = buckets_size - 1;
+	float recip_cell_w;
+	float large_ob_radius; // Objects with a bounding radius larger than this are stored in large_objects instead of in a cell.
+private:
+	HashMapInsertOnly2<Vec3<int>, uint32, HashedObGridCellHash> cell_indices; // Map from cell coordinates to index into cells.
+	std::vector<HashedObGridCell> cells;
+	HashedObGridCell large_objects; // Objects with radius > large_ob_radius.  Checked by every query.
+	size_t num_objects;
 };
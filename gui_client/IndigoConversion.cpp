@@ -56,7 +56,7 @@ inline static const Indigo::String toIndigoString(const std::string& s)
 //}
 
 
-static Indigo::WavelengthDependentParamRef getAlbedoParam(const WorldMaterial& mat, ResourceManager& resource_manager)
+static Indigo::WavelengthDependentParamRef getAlbedoParam(const WorldMaterial& mat, ResourceManager& resource_manager, std::vector<PackedResourceCache::PinRef>& extracted_file_pins)
 {
 	Indigo::RGBSpectrumRef rgb_spect = new Indigo::RGBSpectrum(toIndigoVec3d(mat.colour_rgb), 2.2);
 
@@ -66,7 +66,10 @@ static Indigo::WavelengthDependentParamRef getAlbedoParam(const WorldMaterial& m
 	}
 	else
 	{
-		const std::string path = resource_manager.pathForURL(mat.colour_texture_url);
+		PackedResourceCache::PinRef extracted_file_pin;
+		const std::string path = resource_manager.extractedPathForURL(mat.colour_texture_url, extracted_file_pin);
+		if(extracted_file_pin.nonNull())
+			extracted_file_pins.push_back(extracted_file_pin); // The texture is read when the scene is rendered, so keep the extracted file until then.
 
 		// Image formats that are supported by Indigo.  NOTE: no ktx!
 		const bool is_allowed_file_type =
@@ -93,7 +96,7 @@ static Indigo::WavelengthDependentParamRef getAlbedoParam(const WorldMaterial& m
 }
 
 
-static Indigo::WavelengthDependentParamRef getEmissionParam(const WorldMaterial& mat, ResourceManager& resource_manager)
+static Indigo::WavelengthDependentParamRef getEmissionParam(const WorldMaterial& mat, ResourceManager& resource_manager, std::vector<PackedResourceCache::PinRef>& extracted_file_pins)
 {
 	if(mat.emission_texture_url.empty())
 	{
@@ -101,7 +104,10 @@ static Indigo::WavelengthDependentParamRef getEmissionParam(const WorldMaterial&
 	}
 	else
 	{
-		const std::string path = resource_manager.pathForURL(mat.emission_texture_url);
+		PackedResourceCache::PinRef extracted_file_pin;
+		const std::string path = resource_manager.extractedPathForURL(mat.emission_texture_url, extracted_file_pin);
+		if(extracted_file_pin.nonNull())
+			extracted_file_pins.push_back(extracted_file_pin); // The texture is read when the scene is rendered, so keep the extracted file until then.
 
 		// Image formats that are supported by Indigo.  NOTE: no ktx!
 		const bool is_allowed_file_type =
@@ -128,25 +134,25 @@ static Indigo::WavelengthDependentParamRef getEmissionParam(const WorldMaterial&
 }
 
 
-static void setEmissionParams(const WorldMaterial& mat, const Indigo::SceneNodeMaterialRef mat_node, ResourceManager& resource_manager)
+static void setEmissionParams(const WorldMaterial& mat, const Indigo::SceneNodeMaterialRef mat_node, ResourceManager& resource_manager, std::vector<PackedResourceCache::PinRef>& extracted_file_pins)
 {
 	if(mat.emission_lum_flux_or_lum > 0)
 	{
 		mat_node->material->base_emission = new Indigo::ConstantWavelengthDependentParam(new Indigo::RGBSpectrum(toIndigoVec3d(mat.emission_rgb), 2.2));
 
-		mat_node->material->emission = getEmissionParam(mat, resource_manager);
+		mat_node->material->emission = getEmissionParam(mat, resource_manager, extracted_file_pins);
 	}
 }
 
 
-Indigo::SceneNodeMaterialRef IndigoConversion::convertMaterialToIndigoMat(const WorldMaterial& mat, ResourceManager& resource_manager)
+Indigo::SceneNodeMaterialRef IndigoConversion::convertMaterialToIndigoMat(const WorldMaterial& mat, ResourceManager& resource_manager, std::vector<PackedResourceCache::PinRef>& extracted_file_pins)
 {
 	// Handle hologram materials as null materials with emission.  We don't want them to be specular materials.
 	if((mat.flags & mat.HOLOGRAM_FLAG) != 0)
 	{
 		Indigo::SceneNodeMaterialRef mat_node = new Indigo::SceneNodeMaterial("hologram mat", new Indigo::NullMaterial());
 		mat_node->material->backface_emit = true;
-		setEmissionParams(mat, mat_node, resource_manager);
+		setEmissionParams(mat, mat_node, resource_manager, extracted_file_pins);
 		return mat_node;
 	}
 
@@ -157,7 +163,7 @@ Indigo::SceneNodeMaterialRef IndigoConversion::convertMaterialToIndigoMat(const
 		{
 			// Export as diffuse
 			mat_node = new Indigo::SceneNodeMaterial("diffuse mat", new Indigo::DiffuseMaterial(
-				getAlbedoParam(mat, resource_manager)
+				getAlbedoParam(mat, resource_manager, extracted_file_pins)
 			));
 		}
 		else
@@ -166,7 +172,7 @@ Indigo::SceneNodeMaterialRef IndigoConversion::convertMaterialToIndigoMat(const
 			if(mat.metallic_fraction.val == 0.0)
 			{
 				mat_node = new Indigo::SceneNodeMaterial("phong mat", new Indigo::PhongMaterial(
-					getAlbedoParam(mat, resource_manager), // albedo
+					getAlbedoParam(mat, resource_manager, extracted_file_pins), // albedo
 					NULL, // spec refl
 					new Indigo::ConstantWavelengthIndependentParam(mat.roughness.val), // roughness
 					new Indigo::ConstantWavelengthIndependentParam(0.5), // fresnel scale
@@ -178,7 +184,7 @@ Indigo::SceneNodeMaterialRef IndigoConversion::convertMaterialToIndigoMat(const
 			{
 				mat_node = new Indigo::SceneNodeMaterial("metallic mat", new Indigo::PhongMaterial(
 					NULL, // albedo
-					getAlbedoParam(mat, resource_manager), // spec refl
+					getAlbedoParam(mat, resource_manager, extracted_file_pins), // spec refl
 					new Indigo::ConstantWavelengthIndependentParam(mat.roughness.val), // roughness
 					new Indigo::ConstantWavelengthIndependentParam(1.0), // fresnel scale
 					1.5, // IOR
@@ -189,7 +195,7 @@ Indigo::SceneNodeMaterialRef IndigoConversion::convertMaterialToIndigoMat(const
 			{
 				// Export as a blend between metallic phong and non-metallic phong.
 				Indigo::SceneNodeMaterialRef non_metallic = new Indigo::SceneNodeMaterial(new Indigo::PhongMaterial(
-					getAlbedoParam(mat, resource_manager), // albedo
+					getAlbedoParam(mat, resource_manager, extracted_file_pins), // albedo
 					NULL, // spec refl
 					new Indigo::ConstantWavelengthIndependentParam(mat.roughness.val), // roughness
 					new Indigo::ConstantWavelengthIndependentParam(0.5), // fresnel scale
@@ -199,7 +205,7 @@ Indigo::SceneNodeMaterialRef IndigoConversion::convertMaterialToIndigoMat(const
 
 				Indigo::SceneNodeMaterialRef metallic = new Indigo::SceneNodeMaterial(new Indigo::PhongMaterial(
 					NULL, // albedo
-					getAlbedoParam(mat, resource_manager), // spec refl
+					getAlbedoParam(mat, resource_manager, extracted_file_pins), // spec refl
 					new Indigo::ConstantWavelengthIndependentParam(mat.roughness.val), // roughness
 					new Indigo::ConstantWavelengthIndependentParam(1.0), // fresnel scale
 					1.5, // IOR
@@ -215,7 +221,7 @@ Indigo::SceneNodeMaterialRef IndigoConversion::convertMaterialToIndigoMat(const
 			}
 		}
 
-		setEmissionParams(mat, mat_node, resource_manager);
+		setEmissionParams(mat, mat_node, resource_manager, extracted_file_pins);
 
 		return mat_node;
 	}
@@ -280,7 +286,8 @@ Indigo::SceneNodeMeshRef IndigoConversion::convertMesh(const WorldObject& object
 	// TEMP HACK:
 	if(!object.model_url.empty())
 	{
-		const std::string local_path = resource_manager.getLocalAbsPathForResource(*resource_manager.getExistingResourceForURL(object.model_url));
+		PackedResourceCache::PinRef extracted_file_pin; // Stops the extracted file from being deleted while we are reading it.
+		const std::string local_path = resource_manager.extractedPathForURL(object.model_url, extracted_file_pin);
 
 		BatchedMeshRef bmesh = BatchedMesh::readFromFile(local_path, NULL);
 
@@ -303,7 +310,7 @@ static const Matrix4f obToWorldMatrix(const WorldObject* ob)
 }
 
 
-Indigo::SceneNodeModelRef IndigoConversion::convertObject(const WorldObject& object, ResourceManager& resource_manager)
+Indigo::SceneNodeModelRef IndigoConversion::convertObject(const WorldObject& object, ResourceManager& resource_manager, std::vector<PackedResourceCache::PinRef>& extracted_file_pins)
 {
 	Indigo::SceneNodeModelRef model = new Indigo::SceneNodeModel();
 	model->setName(toIndigoString("Object with UID " + object.uid.toString()));
@@ -340,7 +347,7 @@ Indigo::SceneNodeModelRef IndigoConversion::convertObject(const WorldObject& obj
 	{
 		Indigo::Vector<Indigo::SceneNodeMaterialRef> indigo_mats(object.materials.size());
 		for(size_t i=0; i<object.materials.size(); ++i)
-			indigo_mats[i] = convertMaterialToIndigoMat(*object.materials[i], resource_manager);
+			indigo_mats[i] = convertMaterialToIndigoMat(*object.materials[i], resource_manager, extracted_file_pins);
 
 		model->setMaterials(indigo_mats);
 	}
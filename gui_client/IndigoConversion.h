@@ -6,7 +6,9 @@ Copyright Glare Technologies Limited 2022 -
 #pragma once
 
 
+#include "../shared/PackedResourceCache.h"
 #include <Reference.h>
+#include <vector>
 class WorldMaterial;
 class WorldObject;
 class ResourceManager;
@@ -24,12 +26,14 @@ class IndigoConversion
 {
 public:
 #if INDIGO_SUPPORT
-	static Reference<Indigo::SceneNodeMaterial> convertMaterialToIndigoMat(const WorldMaterial& mat, ResourceManager& resource_manager);
+	// Texture files used by the material are read by Indigo when the scene is rendered, so pins for any files extracted from the packed cache
+	// are appended to extracted_file_pins.  The caller should keep them while the scene is in use.
+	static Reference<Indigo::SceneNodeMaterial> convertMaterialToIndigoMat(const WorldMaterial& mat, ResourceManager& resource_manager, std::vector<PackedResourceCache::PinRef>& extracted_file_pins);
 
 #if GUI_CLIENT
 	static Reference<Indigo::SceneNodeMesh> convertMesh(const WorldObject& object, ResourceManager& resource_manager);
 
-	static Reference<Indigo::SceneNodeModel> convertObject(const WorldObject& object, ResourceManager& resource_manager);
+	static Reference<Indigo::SceneNodeModel> convertObject(const WorldObject& object, ResourceManager& resource_manager, std::vector<PackedResourceCache::PinRef>& extracted_file_pins);
 #endif
 
 #endif // INDIGO_SUPPORT
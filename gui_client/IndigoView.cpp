@@ -299,6 +299,7 @@ void IndigoView::shutdown()
 		this->settings_node = NULL;
 		this->camera_node = NULL;
 		this->context = NULL;
+		this->extracted_file_pins.clear();
 	}
 	catch(Indigo::IndigoException& e)
 	{
@@ -320,7 +321,7 @@ void IndigoView::addExistingObjects(const WorldState& world_state, ResourceManag
 
 		if(ob->physics_object.nonNull())
 		{
-			Indigo::SceneNodeModelRef model_node = IndigoConversion::convertObject(*ob, resource_manager);
+			Indigo::SceneNodeModelRef model_node = IndigoConversion::convertObject(*ob, resource_manager, extracted_file_pins);
 
 			{
 				Indigo::Lock lock(this->root_node->getMutex());
@@ -343,7 +344,7 @@ void IndigoView::objectAdded(WorldObject& object, ResourceManager& resource_mana
 	if(this->renderer.isNull())
 		return;
 
-	Indigo::SceneNodeModelRef model_node = IndigoConversion::convertObject(object, resource_manager);
+	Indigo::SceneNodeModelRef model_node = IndigoConversion::convertObject(object, resource_manager, extracted_file_pins);
 
 	{
 		Indigo::Lock lock(this->root_node->getMutex());
@@ -6,6 +6,7 @@ Copyright Glare Technologies Limited 2024 -
 #pragma once
 
 
+#include "../shared/PackedResourceCache.h"
 #include "utils/Timer.h"
 #include "utils/Reference.h"
 #include "utils/RefCounted.h"
@@ -71,6 +72,8 @@ private:
 	Reference<Indigo::UInt8Buffer> uint8_buffer;
 	Reference<Indigo::ToneMapper> tone_mapper;
 	Reference<Indigo::DataManager> data_manager;
+
+	std::vector<PackedResourceCache::PinRef> extracted_file_pins; // Pins for texture files extracted from the packed cache, which Indigo reads when rendering.
 #endif
 	QLabel* label;
 	QTimer* resize_timer;
@@ -32,7 +32,13 @@ void LoadAudioTask::run(size_t thread_index)
 
 	try
 	{
-		glare::SoundFileRef sound_file = glare::AudioFileReader::readAudioFile(audio_source_path);
+		// Read directly from the packed cache if the resource is in it, otherwise from the resource file.
+		glare::SoundFileRef sound_file;
+		PackedResourceCache::ReadRef packed_data;
+		if(resource.nonNull() && resource_manager->getPackedCache().nonNull() && resource_manager->getPackedCache()->getData(resource->URL, packed_data))
+			sound_file = glare::AudioFileReader::readAudioFileFromBuffer(audio_source_path, packed_data.data.data(), packed_data.data.size());
+		else
+			sound_file = glare::AudioFileReader::readAudioFile(audio_source_path);
 
 		Reference<AudioLoadedThreadMessage> msg = new AudioLoadedThreadMessage();
 		msg->audio_source_url = audio_source_url;
@@ -18,7 +18,6 @@ Copyright Glare Technologies Limited 2024 -
 
 
 LoadItemQueue::LoadItemQueue()
-:	begin_i(0)
 {}
 
 
@@ -59,9 +58,9 @@ void LoadItemQueue::enqueueItem(const std::string& key, const Vec4f& pos, float
 	item->task = task;
 	item->task_max_dist = task_max_dist;
 
-	items.push_back(item);
-
 	item_map.insert(std::make_pair(key, item));
+
+	queue.insert(item);
 }
 
 
@@ -97,103 +96,36 @@ void LoadItemQueue::checkUpdateItemPosition(const std::string& key, const Vec4f&
 		new_pos_info.pos = Vec3f(pos);
 		new_pos_info.size_factor = size_factor;
 		existing_item->pos_info.push_back(new_pos_info);
+
+		queue.itemPosInfoChanged(existing_item);
 	}
 }
 
 
 size_t LoadItemQueue::size() const
 {
-	return items.size() - begin_i;
+	return queue.size();
 }
 
 
 void LoadItemQueue::clear()
 {
-	for(size_t i = begin_i; i < items.size(); ++i)
-		delete items[i];
-
-	begin_i = 0;
-	items.clear();
+	queue.clear();
 	item_map.clear();
 }
 
 
-struct QueueItemDistComparator
-{
-	bool operator () (const LoadItemQueueItem* a, const LoadItemQueueItem* b)
-	{
-		return a->priority < b->priority;
-	}
-};
-
-
-void LoadItemQueue::sortQueue(const Vec3d& campos_) // Sort queue
+void LoadItemQueue::updateItemPriorities(const Vec3d& campos)
 {
-	// Sort items into ascending order of priority: roughly distance from camera
-	
-	const Vec4f campos_zero_w((float)campos_.x, (float)campos_.y, (float)campos_.z, 0.f);
-
-	Timer timer;
-
-	// Do pass over queue items to compute priority, store and use that for sorting.
-	const size_t items_size = items.size();
-	for(size_t i = begin_i; i < items_size; ++i)
-	{
-		SmallVector<LoadItemQueuePosInfo, 4>& pos_info = items[i]->pos_info;
-		assert(pos_info.size() >= 1);
-		float smallest_priority = campos_zero_w.getDist(maskWToZero(loadUnalignedVec4f(&pos_info[0].pos.x))) * pos_info[0].size_factor;
-		for(size_t z=1; z<pos_info.size(); ++z)
-		{
-			const float pos_info_z_priority = campos_zero_w.getDist(maskWToZero(loadUnalignedVec4f(&pos_info[z].pos.x))) * pos_info[z].size_factor;
-			smallest_priority = myMin(smallest_priority, pos_info_z_priority);
-		}
-
-		items[i]->priority = smallest_priority;
-	}
-
-	QueueItemDistComparator comparator;
-	std::sort(items.begin() + begin_i, items.end(), comparator);
-
-	//conPrint("\n!!!!Sorting load item queue (" + toString(items.size() - begin_i) + " items) took " + timer.elapsedStringNSigFigs(4));
-
-	/*
-	If the unused space at the start of the array gets too large, copy items back to the start of the array, and trim off the end.
-	                 begin_i                    end
-	---------------------------------------------
-	   unused          |         data           |
-	---------------------------------------------
-	
-	|
-	v
-
-	begin_i                  end
-	--------------------------
-	|         data           |
-	--------------------------
-	
-	*/
-	if(begin_i > 1000)
-	{
-		//conPrint("LoadItemQueue::sortQueue(): copying backwards (begin_i: " + toString(begin_i) + ")");
-		for(size_t i = begin_i; i < items_size; ++i)
-			items[i - begin_i] = items[i];
-		items.resize(items.size() - begin_i);
-		begin_i = 0;
-	}
+	queue.updatePriorities(Vec4f((float)campos.x, (float)campos.y, (float)campos.z, 1.f));
 }
 
 
 void LoadItemQueue::dequeueFront(LoadItemQueueItem& item_out)
 {
-	assert(begin_i < items.size());
-
-	item_map.erase(items[begin_i]->key);
-
-	item_out = *items[begin_i]; // Copy to item_out
+	queue.dequeueFront(item_out);
 
-	delete items[begin_i];
-	items[begin_i] = NULL;
-	begin_i++;
+	item_map.erase(item_out.key);
 }
 
 
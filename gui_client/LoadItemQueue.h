@@ -6,6 +6,7 @@ Copyright Glare Technologies Limited 2024 -
 #pragma once
 
 
+#include "DistanceBandQueue.h"
 #include <physics/jscol_aabbox.h>
 #include <maths/Vec4.h>
 #include <maths/vec3.h>
@@ -51,6 +52,7 @@ struct LoadItemQueueItem
 	glare::TaskRef task;
 	
 	float priority;
+	DistanceBandQueueItemInfo band_queue_info;
 };
 
 
@@ -58,7 +60,9 @@ struct LoadItemQueueItem
 LoadItemQueue
 -------------
 Queue of load model tasks, load texture tasks etc, together with the position of the item,
-which is used for sorting the tasks based on distance from the camera.
+which is used for prioritising the tasks based on distance from the camera.
+Items are kept in a DistanceBandQueue, so only items whose priority band may have changed
+are re-evaluated when the camera moves.
 =====================================================================*/
 class LoadItemQueue
 {
@@ -82,13 +86,11 @@ public:
 
 	size_t size() const;
 
-	void sortQueue(const Vec3d& campos); // Sort queue (approximately by item distance to camera)
+	void updateItemPriorities(const Vec3d& campos); // Update priorities of items (approximately by item distance to camera) after the camera has moved.
 
 	void dequeueFront(LoadItemQueueItem& item_out);
 private:
-	// Valid items are at indices [begin_i, items.size())
-	size_t begin_i;
-	js::Vector<LoadItemQueueItem*, 16> items;
+	DistanceBandQueue<LoadItemQueueItem> queue;
 
 	std::unordered_map<std::string, LoadItemQueueItem*> item_map; // Map from key to pointer to LoadItemQueueItem.
 };
@@ -96,14 +96,23 @@ void LoadModelTask::run(size_t thread_index)
 			// We want to load and build the mesh at lod_model_url.
 			// conPrint("LoadModelTask: loading mesh with URL '" + lod_model_url + "'.");
 			const std::string lod_model_path = resource_manager->pathForURL(lod_model_url);
+			PackedResourceCache::PinRef extracted_file_pin; // Stops the extracted file from being deleted while we are reading it.
+			if(resource.nonNull())
+				extracted_file_pin = resource_manager->ensureResourceFileExtracted(resource); // Extract from packed cache if needed.
+
+			// Try and load the physics shape from the cache, so we can skip building it.
+			const bool got_cached_physics_shape = build_physics_ob && physics_shape_cache.nonNull() && physics_shape_cache->tryLoadShape(lod_model_url, build_dynamic_physics_ob, physics_shape);
 
 			gl_meshdata = ModelLoading::makeGLMeshDataAndBatchedMeshForModelPath(lod_model_path,
 				/*vert_buf_allocator=*/NULL, 
 				true, // skip_opengl_calls - we need to do these on the main thread.
-				build_physics_ob,
+				build_physics_ob && !got_cached_physics_shape,
 				build_dynamic_physics_ob,
 				opengl_engine->mem_allocator.ptr(),
 				/*physics shape out=*/physics_shape);
+
+			if(build_physics_ob && !got_cached_physics_shape && physics_shape_cache.nonNull())
+				physics_shape_cache->saveShape(lod_model_url, build_dynamic_physics_ob, physics_shape);
 		}
 
 		// Send a ModelLoadedThreadMessage back to main window.
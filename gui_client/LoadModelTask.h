@@ -9,6 +9,7 @@ Copyright Glare Technologies Limited 2021 -
 #include "../shared/WorldObject.h"
 #include "../shared/Resource.h"
 #include "PhysicsObject.h"
+#include "PhysicsShapeCache.h"
 #include <opengl/OpenGLEngine.h>
 #include <Task.h>
 #include <ThreadMessage.h>
@@ -69,5 +70,6 @@ public:
 	PhysicsShape unit_cube_shape;
 	Reference<OpenGLEngine> opengl_engine;
 	Reference<ResourceManager> resource_manager;
+	PhysicsShapeCacheRef physics_shape_cache; // May be null.  If non-null, physics shapes for models are loaded from and saved to this cache.
 	ThreadSafeQueue<Reference<ThreadMessage> >* result_msg_queue;
 };
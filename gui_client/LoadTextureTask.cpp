@@ -40,6 +40,36 @@ void LoadTextureTask::run(size_t thread_index)
 
 		const std::string& key = this->path;
 
+		PackedResourceCache::PinRef extracted_file_pin; // Stops the extracted file from being deleted while we are reading it.
+		if(resource.nonNull())
+			extracted_file_pin = resource_manager->ensureResourceFileExtracted(resource); // Extract from packed cache if needed.
+
+		// Animated GIFs are streamed: just decode the first frame now, the rest are decoded on demand by StreamingGIFTexture.
+		if(hasExtension(key, "gif") && !is_terrain_map)
+		{
+			StreamingGIFTextureRef streaming_gif;
+			try
+			{
+				streaming_gif = new StreamingGIFTexture(key, resource_manager, resource, opengl_engine, tex_params);
+			}
+			catch(glare::Exception& e)
+			{
+				conPrint("Failed to open GIF for streaming, falling back to full decode: " + e.what());
+			}
+
+			if(streaming_gif.nonNull() && streaming_gif->getNumFrames() > 1)
+			{
+				Reference<TextureLoadedThreadMessage> msg = new TextureLoadedThreadMessage();
+				msg->tex_path = path;
+				msg->tex_key = key;
+				msg->tex_params = tex_params;
+				msg->texture_data = streaming_gif->decodeFirstFrame();
+				msg->streaming_gif = streaming_gif;
+				result_msg_queue->enqueue(msg);
+				return;
+			}
+		}
+
 		// Load texture from disk and decode it.
 		Reference<Map2D> map;
 		if(hasExtension(key, "gif"))
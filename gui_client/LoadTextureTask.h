@@ -6,6 +6,7 @@ Copyright Glare Technologies Limited 2019 -
 #pragma once
 
 
+#include "StreamingGIFTexture.h"
 #include "../shared/Resource.h"
 #include <opengl/OpenGLTexture.h>
 #include <Task.h>
@@ -28,6 +29,8 @@ public:
 	Reference<TextureData> texture_data;
 	
 	Reference<Map2D> terrain_map; // Non-null iff we are loading a terrain map (e.g. is_terrain_map is true)
+
+	StreamingGIFTextureRef streaming_gif; // Non-null if this is an animated GIF with frames decoded on demand.  texture_data is the first frame.
 };
 
 
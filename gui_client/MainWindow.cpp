@@ -47,6 +47,8 @@ Copyright Glare Technologies Limited 2024 -
 #include <QtGui/QMouseEvent>
 #include <QtGui/QClipboard>
 #include <QtGui/QDesktopServices>
+#include <QtGui/QScreen>
+#include <QtGui/QGuiApplication>
 #include <QtWidgets/QFileDialog>
 #include <QtWidgets/QMessageBox>
 #include <QtWidgets/QErrorMessage>
@@ -513,6 +515,10 @@ void MainWindow::afterGLInitInitialise()
 
 	gui_client.afterGLInitInitialise((double)device_pixel_ratio, ui->glWidget->opengl_engine, fonts, emoji_fonts);
 
+	// Budget per-frame work for the screen refresh rate.
+	if(QGuiApplication::primaryScreen())
+		gui_client.frame_scheduler.setTargetFrameRate(QGuiApplication::primaryScreen()->refreshRate());
+
 	MainWindowGLUICallbacks* glui_callbacks = new MainWindowGLUICallbacks();
 	glui_callbacks->main_window = this;
 	gui_client.gl_ui->callbacks = glui_callbacks;
@@ -2934,7 +2940,9 @@ void MainWindow::on_actionOptions_triggered()
 		Reference<glare::MicReadThread> mic_read_thread = new glare::MicReadThread(&gui_client.msg_queue, gui_client.udp_socket, gui_client.client_avatar_uid, gui_client.server_hostname, gui_client.server_UDP_port,
 			MainOptionsDialog::getInputDeviceName(settings),
 			MainOptionsDialog::getInputScaleFactor(settings), // input_vol_scale_factor
-			&gui_client.mic_read_status
+			&gui_client.mic_read_status,
+			settings->value("setting/voice_frame_duration_ms", glare::MicReadThread::DEFAULT_FRAME_DURATION_MS).toInt(),
+			gui_client.longVoiceFramesAllowed()
 		);
 		gui_client.mic_read_thread_manager.addThread(mic_read_thread);
 	}
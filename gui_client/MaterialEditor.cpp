@@ -139,6 +139,8 @@ static void checkStringSize(std::string& s, size_t max_size)
 
 void MaterialEditor::toMaterial(WorldMaterial& mat_out)
 {
+	const Reference<WorldMaterial> old_mat = mat_out.clone();
+
 	mat_out.colour_rgb = col;
 	mat_out.colour_texture_url = QtUtils::toIndString(this->textureFileSelectWidget->filename());
 	checkStringSize(mat_out.colour_texture_url, WorldObject::MAX_URL_SIZE);
@@ -170,6 +172,8 @@ void MaterialEditor::toMaterial(WorldMaterial& mat_out)
 	BitUtils::setOrZeroBit(mat_out.flags, WorldMaterial::USE_VERT_COLOURS_FOR_WIND, this->windCheckBox->isChecked());
 	BitUtils::setOrZeroBit(mat_out.flags, WorldMaterial::DOUBLE_SIDED_FLAG, this->doubleSidedCheckBox->isChecked());
 	BitUtils::setOrZeroBit(mat_out.flags, WorldMaterial::DECAL_FLAG, this->decalCheckBox->isChecked());
+
+	mat_out.updateBasisTexturesPresentFlag(old_mat.ptr());
 }
 
 
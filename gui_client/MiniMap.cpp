@@ -455,6 +455,7 @@ void MiniMap::checkUpdateTilesForCurCamPosition()
 								tile.ob->material.tex_matrix = Matrix2f(scale, 0, 0, -scale);  // See diagrams below for explanation
 								tile.ob->material.tex_translation = Vec2f(lower_left_coords.x, 1 - lower_left_coords.y);
 
+								// The texture is loaded by a LoadTextureTask for the resource, which extracts the file from the packed cache if needed.
 								const std::string local_path = gui_client->resource_manager->getLocalAbsPathForResource(*resource);
 
 								OpenGLTextureRef tile_tex = opengl_engine->getTextureIfLoaded(OpenGLTextureKey(local_path));
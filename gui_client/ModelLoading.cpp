@@ -12,6 +12,7 @@ Code By Nicholas Chapman.
 #include "../shared/WorldObject.h"
 #include "../shared/ResourceManager.h"
 #include "../shared/VoxelMeshBuilding.h"
+#include "../shared/GPUMesh.h"
 #include "../dll/include/IndigoMesh.h"
 #include "../dll/include/IndigoException.h"
 #include "../graphics/formatdecoderobj.h"
@@ -32,6 +33,7 @@ Code By Nicholas Chapman.
 #include "../utils/Sort.h"
 #include "../utils/IncludeHalf.h"
 #include "../utils/BitUtils.h"
+#include "../utils/MemMappedFile.h"
 #include "../opengl/GLMeshBuilding.h"
 #include "../opengl/IncludeOpenGL.h"
 #include "../indigo/UVUnwrapper.h"
@@ -998,10 +1000,163 @@ void ModelLoading::setMaterialTexPathsForLODLevel(GLObject& gl_ob, int ob_lod_le
 }
 
 
+// Load a GPU mesh file (see GPUMesh.h).  The vertex and index data is already in the OpenGL engine layout, so is just copied.
+static Reference<OpenGLMeshRenderData> makeGLMeshDataForGPUMeshFile(const std::string& model_path, VertexBufferAllocator* vert_buf_allocator, 
+	bool skip_opengl_calls, bool build_physics_ob, bool build_dynamic_physics_ob, 
+	glare::Allocator* mem_allocator, PhysicsShape& physics_shape_out)
+{
+	MemMappedFile file(model_path);
+
+	GPUMesh::ParsedGPUMesh gpu_mesh;
+	GPUMesh::parse((const uint8*)file.fileData(), file.fileSize(), gpu_mesh); // Throws glare::Exception on invalid data.
+
+	Reference<OpenGLMeshRenderData> mesh_data = new OpenGLMeshRenderData();
+	mesh_data->vert_data.setAllocator(mem_allocator);
+	mesh_data->vert_index_buffer.setAllocator(mem_allocator);
+	mesh_data->vert_index_buffer_uint16.setAllocator(mem_allocator);
+	mesh_data->vert_index_buffer_uint8.setAllocator(mem_allocator);
+
+	const GPUMesh::VertLayout& layout = gpu_mesh.layout;
+	const bool has_normals	= (gpu_mesh.flags & GPUMesh::HAS_NORMALS_FLAG) != 0;
+	const bool has_uv0		= (gpu_mesh.flags & GPUMesh::HAS_UV0_FLAG) != 0;
+	const bool has_uv1		= (gpu_mesh.flags & GPUMesh::HAS_UV1_FLAG) != 0;
+	const GLenum uv_gl_type = (gpu_mesh.flags & GPUMesh::FLOAT_UVS_FLAG) ? GL_FLOAT : GL_HALF_FLOAT;
+
+	mesh_data->has_shading_normals = has_normals;
+	mesh_data->has_uvs = has_uv0;
+	mesh_data->has_vert_colours = false;
+
+	// Copy vertex data
+	const size_t vert_data_size = (size_t)gpu_mesh.num_verts * layout.vert_stride_B;
+	mesh_data->vert_data.resizeNoCopy(vert_data_size);
+	if(vert_data_size > 0)
+		std::memcpy(mesh_data->vert_data.data(), gpu_mesh.vert_data, vert_data_size);
+
+	// Copy index data
+	const size_t index_data_size = (size_t)gpu_mesh.num_indices * gpu_mesh.index_size_B;
+	void* dest_indices;
+	if(gpu_mesh.index_size_B == 1)
+	{
+		mesh_data->setIndexType(GL_UNSIGNED_BYTE);
+		mesh_data->vert_index_buffer_uint8.resizeNoCopy(gpu_mesh.num_indices);
+		dest_indices = mesh_data->vert_index_buffer_uint8.data();
+	}
+	else if(gpu_mesh.index_size_B == 2)
+	{
+		mesh_data->setIndexType(GL_UNSIGNED_SHORT);
+		mesh_data->vert_index_buffer_uint16.resizeNoCopy(gpu_mesh.num_indices);
+		dest_indices = mesh_data->vert_index_buffer_uint16.data();
+	}
+	else
+	{
+		mesh_data->setIndexType(GL_UNSIGNED_INT);
+		mesh_data->vert_index_buffer.resizeNoCopy(gpu_mesh.num_indices);
+		dest_indices = mesh_data->vert_index_buffer.data();
+	}
+	if(index_data_size > 0)
+		std::memcpy(dest_indices, gpu_mesh.index_data, index_data_size);
+
+	for(size_t i=0; i<gpu_mesh.batches.size(); ++i)
+	{
+		OpenGLBatch batch;
+		batch.material_index = gpu_mesh.batches[i].material_index;
+		batch.prim_start_offset_B = gpu_mesh.batches[i].indices_start * gpu_mesh.index_size_B;
+		batch.num_indices = gpu_mesh.batches[i].num_indices;
+		mesh_data->batches.push_back(batch);
+	}
+
+	// Set vertex spec.  Attributes are in the order position, normal, uv0, colour, lightmap uv (uv1).
+	// Disabled attributes are added where needed to maintain the attribute order.
+	VertexAttrib pos_attrib;
+	pos_attrib.enabled = true;
+	pos_attrib.num_comps = 3;
+	pos_attrib.type = (gpu_mesh.flags & GPUMesh::FLOAT_POSITIONS_FLAG) ? GL_FLOAT : GL_HALF_FLOAT;
+	pos_attrib.normalised = false;
+	pos_attrib.stride = layout.vert_stride_B;
+	pos_attrib.offset = (uint32)layout.pos_offset_B;
+	mesh_data->vertex_spec.attributes.push_back(pos_attrib);
+
+	VertexAttrib normal_attrib;
+	normal_attrib.enabled = has_normals;
+	normal_attrib.num_comps = 4;
+	normal_attrib.type = GL_INT_2_10_10_10_REV;
+	normal_attrib.normalised = true;
+	normal_attrib.stride = has_normals ? layout.vert_stride_B : 4; // Stride needs to be a multiple of 4 for WebGL.
+	normal_attrib.offset = has_normals ? (uint32)layout.normal_offset_B : 0;
+	mesh_data->vertex_spec.attributes.push_back(normal_attrib);
+
+	VertexAttrib uv_attrib;
+	uv_attrib.enabled = has_uv0;
+	uv_attrib.num_comps = 2;
+	uv_attrib.type = uv_gl_type;
+	uv_attrib.normalised = false;
+	uv_attrib.stride = has_uv0 ? layout.vert_stride_B : 4;
+	uv_attrib.offset = has_uv0 ? (uint32)layout.uv0_offset_B : 0;
+	mesh_data->vertex_spec.attributes.push_back(uv_attrib);
+
+	if(has_uv1)
+	{
+		VertexAttrib colour_attrib;
+		colour_attrib.enabled = false;
+		colour_attrib.num_comps = 3;
+		colour_attrib.type = GL_FLOAT;
+		colour_attrib.normalised = false;
+		colour_attrib.stride = 4;
+		colour_attrib.offset = 0;
+		mesh_data->vertex_spec.attributes.push_back(colour_attrib);
+
+		VertexAttrib lightmap_uv_attrib;
+		lightmap_uv_attrib.enabled = true;
+		lightmap_uv_attrib.num_comps = 2;
+		lightmap_uv_attrib.type = uv_gl_type;
+		lightmap_uv_attrib.normalised = false;
+		lightmap_uv_attrib.stride = layout.vert_stride_B;
+		lightmap_uv_attrib.offset = (uint32)layout.uv1_offset_B;
+		mesh_data->vertex_spec.attributes.push_back(lightmap_uv_attrib);
+	}
+
+	mesh_data->vertex_spec.checkValid();
+
+	mesh_data->aabb_os = gpu_mesh.aabb_os;
+	mesh_data->num_materials_referenced = gpu_mesh.num_materials_referenced;
+
+	if(build_physics_ob)
+	{
+		BatchedMeshRef physics_mesh = GPUMesh::makeBatchedMeshWithPositions(gpu_mesh);
+		physics_shape_out = PhysicsWorld::createJoltShapeForBatchedMesh(*physics_mesh, /*is dynamic=*/build_dynamic_physics_ob);
+	}
+
+	// Load rendering data into GPU mem if requested.
+	if(!skip_opengl_calls)
+	{
+		mesh_data->vbo_handle = vert_buf_allocator->allocateVertexDataSpace(mesh_data->vertex_spec.vertStride(), mesh_data->vert_data.data(), mesh_data->vert_data.dataSizeBytes());
+
+		if(gpu_mesh.index_size_B == 1)
+			mesh_data->indices_vbo_handle = vert_buf_allocator->allocateIndexDataSpace(mesh_data->vert_index_buffer_uint8.data(), mesh_data->vert_index_buffer_uint8.dataSizeBytes());
+		else if(gpu_mesh.index_size_B == 2)
+			mesh_data->indices_vbo_handle = vert_buf_allocator->allocateIndexDataSpace(mesh_data->vert_index_buffer_uint16.data(), mesh_data->vert_index_buffer_uint16.dataSizeBytes());
+		else
+			mesh_data->indices_vbo_handle = vert_buf_allocator->allocateIndexDataSpace(mesh_data->vert_index_buffer.data(), mesh_data->vert_index_buffer.dataSizeBytes());
+
+		vert_buf_allocator->getOrCreateAndAssignVAOForMesh(*mesh_data, mesh_data->vertex_spec);
+
+		mesh_data->vert_data.clearAndFreeMem();
+		mesh_data->vert_index_buffer.clearAndFreeMem();
+		mesh_data->vert_index_buffer_uint16.clearAndFreeMem();
+		mesh_data->vert_index_buffer_uint8.clearAndFreeMem();
+	}
+
+	return mesh_data;
+}
+
+
 Reference<OpenGLMeshRenderData> ModelLoading::makeGLMeshDataAndBatchedMeshForModelPath(const std::string& model_path, VertexBufferAllocator* vert_buf_allocator, 
 	bool skip_opengl_calls, bool build_physics_ob, bool build_dynamic_physics_ob, 
 	glare::Allocator* mem_allocator, PhysicsShape& physics_shape_out)
 {
+	if(hasExtension(model_path, "gpumesh"))
+		return makeGLMeshDataForGPUMeshFile(model_path, vert_buf_allocator, skip_opengl_calls, build_physics_ob, build_dynamic_physics_ob, mem_allocator, physics_shape_out);
+
 	// Load mesh from disk:
 	BatchedMeshRef batched_mesh;
 
@@ -42,6 +42,9 @@ public:
 
 	inline static bool hasSupportedModelExtension(const std::string& path);
 
+	// GPU mesh files (see GPUMesh.h) are generated by the server, and can't be uploaded by users, so are not included in hasSupportedModelExtension().
+	inline static bool hasGPUMeshExtension(const std::string& path);
+
 	// Load a model file from disk.
 	// Also load associated material information from the model file.
 	// Make an OpenGL object from it, suitable for previewing, so situated at the origin. 
@@ -114,3 +117,9 @@ bool ModelLoading::hasSupportedModelExtension(const std::string& path)
 		StringUtils::equalCaseInsensitive(extension, "vrm") ||
 		StringUtils::equalCaseInsensitive(extension, "igmesh");
 }
+
+
+bool ModelLoading::hasGPUMeshExtension(const std::string& path)
+{
+	return StringUtils::equalCaseInsensitive(getExtensionStringView(path), "gpumesh");
+}
@@ -0,0 +1,291 @@
+/*=====================================================================
+NetCapture.cpp
+--------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#include "NetCapture.h"
+
+
+#include "../shared/ResourceManager.h"
+#include "../shared/PackedResourceCache.h"
+#include <utils/FileUtils.h>
+#include <utils/StringUtils.h>
+#include <utils/ConPrint.h>
+#include <utils/Exception.h>
+#include <utils/Lock.h>
+
+
+static const size_t MAX_URL_LEN = 10000;
+static const size_t MAX_WORLD_NAME_LEN = 10000;
+static const uint32 MAX_MSG_BODY_LEN = 1000000; // Same limit as ClientThread uses for received messages.
+static const uint64 MAX_RESOURCE_LEN = 1000000000; // Same limit as DownloadResourcesThread uses.
+
+
+NetCaptureWriter::NetCaptureWriter(const std::string& path_)
+:	path(path_),
+	file(path_, std::ios::binary | std::ios::trunc),
+	header_written(false),
+	failed(false),
+	num_messages_written(0),
+	num_resources_written(0)
+{}
+
+
+NetCaptureWriter::~NetCaptureWriter()
+{}
+
+
+void NetCaptureWriter::writeFailed(const std::string& error_msg)
+{
+	conPrint("NetCaptureWriter: error writing to '" + path + "': " + error_msg + ", stopping recording.");
+	failed = true;
+}
+
+
+void NetCaptureWriter::writeHeader(uint32 peer_protocol_version, const UID& client_avatar_uid, const std::string& world_name)
+{
+	Lock lock(mutex);
+
+	if(failed || header_written)
+		return;
+
+	try
+	{
+		file.writeUInt32(NetCaptureReader::MAGIC_NUMBER);
+		file.writeUInt32(NetCaptureReader::FORMAT_VERSION);
+		file.writeUInt32(peer_protocol_version);
+		writeToStream(client_avatar_uid, file);
+		file.writeStringLengthFirst(world_name);
+
+		header_written = true;
+		timer.reset();
+	}
+	catch(glare::Exception& e)
+	{
+		writeFailed(e.what());
+	}
+}
+
+
+void NetCaptureWriter::writeMessage(uint32 msg_type, const uint8* body, size_t body_len)
+{
+	Lock lock(mutex);
+
+	if(failed || !header_written)
+		return;
+
+	try
+	{
+		file.writeUInt32(NetCaptureReader::RecordType_Message);
+		file.writeDouble(timer.elapsed());
+		file.writeUInt32(msg_type);
+		file.writeUInt32((uint32)body_len);
+		file.writeData(body, body_len);
+
+		num_messages_written++;
+	}
+	catch(glare::Exception& e)
+	{
+		writeFailed(e.what());
+	}
+}
+
+
+void NetCaptureWriter::writeResource(const std::string& URL, const uint8* data, size_t data_len)
+{
+	Lock lock(mutex);
+
+	if(failed || !header_written)
+		return;
+
+	try
+	{
+		file.writeUInt32(NetCaptureReader::RecordType_Resource);
+		file.writeDouble(timer.elapsed());
+		file.writeStringLengthFirst(URL);
+		file.writeUInt64(data_len);
+		file.writeData(data, data_len);
+
+		num_resources_written++;
+	}
+	catch(glare::Exception& e)
+	{
+		writeFailed(e.what());
+	}
+}
+
+
+std::string NetCaptureWriter::getDiagnostics() const
+{
+	Lock lock(mutex);
+
+	return "Recording capture to '" + path + "': " + toString(num_messages_written) + " messages, " + toString(num_resources_written) + " resources" + (failed ? " (failed)" : "") + "\n";
+}
+
+
+NetCaptureReader::NetCaptureReader(const std::string& path)
+:	file(path)
+{
+	const uint32 magic = file.readUInt32();
+	if(magic != MAGIC_NUMBER)
+		throw glare::Exception("Invalid magic number in capture file '" + path + "'.");
+
+	const uint32 version = file.readUInt32();
+	if(version > FORMAT_VERSION)
+		throw glare::Exception("Unsupported capture file version " + toString(version) + ", expected " + toString(FORMAT_VERSION) + ".");
+
+	peer_protocol_version = file.readUInt32();
+	client_avatar_uid = readUIDFromStream(file);
+	world_name = file.readStringLengthFirst(MAX_WORLD_NAME_LEN);
+}
+
+
+NetCaptureReader::~NetCaptureReader()
+{}
+
+
+bool NetCaptureReader::readRecord(Record& record_out)
+{
+	if(file.endOfStream())
+		return false;
+
+	record_out.type = file.readUInt32();
+	record_out.time = file.readDouble();
+
+	if(record_out.type == RecordType_Message)
+	{
+		record_out.msg_type = file.readUInt32();
+		const uint32 body_len = file.readUInt32();
+		if(body_len > MAX_MSG_BODY_LEN)
+			throw glare::Exception("Invalid message length in capture: " + toString(body_len));
+
+		record_out.URL.clear();
+		record_out.data.resizeNoCopy(body_len);
+		file.readData(record_out.data.data(), body_len);
+	}
+	else if(record_out.type == RecordType_Resource)
+	{
+		record_out.msg_type = 0;
+		record_out.URL = file.readStringLengthFirst(MAX_URL_LEN);
+		const uint64 data_len = file.readUInt64();
+		if(data_len > MAX_RESOURCE_LEN)
+			throw glare::Exception("Invalid resource length in capture: " + toString(data_len));
+
+		record_out.data.resizeNoCopy(data_len);
+		file.readData(record_out.data.data(), data_len);
+	}
+	else
+		throw glare::Exception("Invalid record type in capture: " + toString(record_out.type));
+
+	return true;
+}
+
+
+size_t NetCaptureReader::installResources(const std::string& path, ResourceManager& resource_manager)
+{
+	NetCaptureReader reader(path);
+
+	size_t num_installed = 0;
+	Record record;
+	while(reader.readRecord(record))
+	{
+		if(record.type != RecordType_Resource)
+			continue;
+
+		if(!ResourceManager::isValidURL(record.URL))
+			throw glare::Exception("Invalid resource URL in capture: '" + record.URL + "'");
+
+		ResourceRef resource = resource_manager.getOrCreateResourceForURL(record.URL);
+		if(resource->isPresent())
+			continue;
+
+		const Reference<PackedResourceCache>& packed_cache = resource_manager.getPackedCache();
+		if(packed_cache.nonNull())
+			packed_cache->insert(record.URL, ArrayRef<uint8>(record.data.data(), record.data.size()));
+		else
+			FileUtils::writeEntireFile(resource_manager.getLocalAbsPathForResource(*resource), (const char*)record.data.data(), record.data.size());
+
+		resource->setState(Resource::State_Present);
+		num_installed++;
+	}
+
+	if(num_installed > 0)
+		resource_manager.markAsChanged();
+
+	return num_installed;
+}
+
+
+#if BUILD_TESTS
+
+
+#include <utils/TestUtils.h>
+#include <utils/PlatformUtils.h>
+
+
+void NetCaptureReader::test()
+{
+	conPrint("NetCaptureReader::test()");
+
+	try
+	{
+		const std::string path = PlatformUtils::getTempDirPath() + "/net_capture_test.capture";
+
+		const uint8 msg_body[] = { 1, 2, 3, 4, 5 };
+		const uint8 resource_data[] = { 10, 20, 30 };
+
+		{
+			Reference<NetCaptureWriter> writer = new NetCaptureWriter(path);
+
+			// Messages written before the header should be ignored.
+			writer->writeMessage(/*msg_type=*/7, msg_body, sizeof(msg_body));
+
+			writer->writeHeader(/*peer_protocol_version=*/42, UID(123), "some world");
+			writer->writeMessage(/*msg_type=*/7, msg_body, sizeof(msg_body));
+			writer->writeResource("test_resource_abc.bin", resource_data, sizeof(resource_data));
+			writer->writeMessage(/*msg_type=*/8, NULL, 0);
+		}
+
+		NetCaptureReader reader(path);
+		testAssert(reader.peer_protocol_version == 42);
+		testAssert(reader.client_avatar_uid == UID(123));
+		testAssert(reader.world_name == "some world");
+
+		Record record;
+		testAssert(reader.readRecord(record));
+		testAssert(record.type == RecordType_Message && record.msg_type == 7);
+		testAssert(record.data.size() == sizeof(msg_body) && record.data[4] == 5);
+		const double first_time = record.time;
+		testAssert(first_time >= 0);
+
+		testAssert(reader.readRecord(record));
+		testAssert(record.type == RecordType_Resource && record.URL == "test_resource_abc.bin");
+		testAssert(record.data.size() == sizeof(resource_data) && record.data[2] == 30);
+		testAssert(record.time >= first_time);
+
+		testAssert(reader.readRecord(record));
+		testAssert(record.type == RecordType_Message && record.msg_type == 8 && record.data.size() == 0);
+
+		testAssert(!reader.readRecord(record));
+	}
+	catch(glare::Exception& e)
+	{
+		failTest(e.what());
+	}
+
+	// Test that an invalid file is rejected.
+	try
+	{
+		const std::string path = PlatformUtils::getTempDirPath() + "/net_capture_test_invalid.capture";
+		FileUtils::writeEntireFile(path, std::string("not a capture file"));
+		NetCaptureReader reader(path);
+		failTest("Expected exception");
+	}
+	catch(glare::Exception&)
+	{}
+
+	conPrint("NetCaptureReader::test() done.");
+}
+
+
+#endif // BUILD_TESTS
@@ -0,0 +1,120 @@
+/*=====================================================================
+NetCapture.h
+------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#pragma once
+
+
+#include "../shared/UID.h"
+#include <utils/ThreadSafeRefCounted.h>
+#include <utils/Reference.h>
+#include <utils/Mutex.h>
+#include <utils/Timer.h>
+#include <utils/Vector.h>
+#include <utils/FileOutStream.h>
+#include <utils/FileInStream.h>
+#include <utils/Platform.h>
+#include <string>
+class ResourceManager;
+
+
+/*=====================================================================
+NetCaptureWriter
+----------------
+Records the message stream received from the server by ClientThread,
+and resources downloaded by the client, to a capture file.
+The capture can be replayed by ClientThread without a server, see ClientThread::setReplayCapture().
+
+File format:
+Header:
+	magic number (uint32), format version (uint32),
+	peer protocol version (uint32), client avatar UID (uint64), world name (string, length first)
+Followed by records:
+	record type (uint32), time in seconds since the header was written (double), then
+	for RecordType_Message:  message type (uint32), body length (uint32), body (the message without the type and length header)
+	for RecordType_Resource: URL (string, length first), data length (uint64), data
+
+Write errors are logged, and stop the recording.
+
+Threadsafe.
+=====================================================================*/
+class NetCaptureWriter : public ThreadSafeRefCounted
+{
+public:
+	// Throws glare::Exception if the file could not be created.
+	NetCaptureWriter(const std::string& path);
+	~NetCaptureWriter();
+
+	// Should be called once, after the initial handshake with the server, before any messages are written.
+	void writeHeader(uint32 peer_protocol_version, const UID& client_avatar_uid, const std::string& world_name);
+
+	void writeMessage(uint32 msg_type, const uint8* body, size_t body_len);
+
+	void writeResource(const std::string& URL, const uint8* data, size_t data_len);
+
+	std::string getDiagnostics() const;
+
+private:
+	void writeFailed(const std::string& error_msg) REQUIRES(mutex);
+
+	std::string path;
+	mutable Mutex mutex;
+	FileOutStream file				GUARDED_BY(mutex);
+	bool header_written				GUARDED_BY(mutex);
+	bool failed						GUARDED_BY(mutex);
+	Timer timer						GUARDED_BY(mutex); // Reset when the header is written.
+	uint64 num_messages_written		GUARDED_BY(mutex);
+	uint64 num_resources_written	GUARDED_BY(mutex);
+};
+
+
+/*=====================================================================
+NetCaptureReader
+----------------
+Reads a capture file written by NetCaptureWriter.
+Records are read one at a time, so the whole capture doesn't need to be held in memory.
+=====================================================================*/
+class NetCaptureReader
+{
+public:
+	// Opens the file and reads the header.  Throws glare::Exception on failure.
+	NetCaptureReader(const std::string& path);
+	~NetCaptureReader();
+
+	static const uint32 MAGIC_NUMBER = 0x50414353; // "SCAP"
+	static const uint32 FORMAT_VERSION = 1;
+
+	enum RecordType
+	{
+		RecordType_Message = 1,
+		RecordType_Resource = 2
+	};
+
+	struct Record
+	{
+		uint32 type; // RecordType
+		double time;
+		uint32 msg_type; // For RecordType_Message
+		std::string URL; // For RecordType_Resource
+		js::Vector<uint8, 16> data; // Message body or resource data.
+	};
+
+	// Reads the next record.  Returns false if the end of the file has been reached.
+	// Throws glare::Exception if the record is invalid.
+	bool readRecord(Record& record_out);
+
+	// Adds all resources in the capture file to the resource manager, marking them as present, so they don't need to be downloaded during replay.
+	// Resources already present are skipped.  Returns the number of resources added.
+	// Throws glare::Exception on failure.
+	static size_t installResources(const std::string& path, ResourceManager& resource_manager);
+
+	static void test();
+
+	uint32 peer_protocol_version;
+	UID client_avatar_uid;
+	std::string world_name;
+
+private:
+	FileInStream file;
+};
@@ -0,0 +1,477 @@
+/*=====================================================================
+ObjectLODTable.cpp
+------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#include "ObjectLODTable.h"
+
+
+#include "../shared/WorldObject.h"
+#include "../maths/mathstypes.h"
+#include "../maths/SSE.h"
+
+
+static inline int LODStateForObject(const WorldObject* ob)
+{
+	return ob->in_proximity ? ob->current_lod_level : ObjectLODTable::LOD_STATE_NOT_IN_PROXIMITY;
+}
+
+
+ObjectLODTable::ObjectLODTable()
+{}
+
+
+ObjectLODTable::~ObjectLODTable()
+{
+	// Don't touch objects in obs here, they may have been destroyed already.  Owner should call clear() while objects are still alive.
+}
+
+
+void ObjectLODTable::setEntry(size_t i, const WorldObject* ob)
+{
+	const Vec4f centroid = ob->getCentroidWS();
+	centroid_x[i] = centroid[0];
+	centroid_y[i] = centroid[1];
+	centroid_z[i] = centroid[2];
+	biased_aabb_len[i] = ob->getBiasedAABBLength();
+	exclude_from_lod_chunk_mesh[i] = ob->exclude_from_lod_chunk_mesh ? -1 : 0;
+}
+
+
+static inline size_t paddedSize(size_t n)
+{
+	return (n + 3) & ~(size_t)3;
+}
+
+
+void ObjectLODTable::insertOrUpdateObject(WorldObject* ob)
+{
+	if(ob->lod_table_index < 0)
+	{
+		assert(ob->lod_table == NULL);
+
+		const size_t i = obs.size();
+		obs.push_back(ob);
+
+		const size_t old_size = centroid_x.size();
+		const size_t padded_size = paddedSize(obs.size());
+		if(padded_size > old_size)
+		{
+			centroid_x.resize(padded_size);
+			centroid_y.resize(padded_size);
+			centroid_z.resize(padded_size);
+			biased_aabb_len.resize(padded_size);
+			exclude_from_lod_chunk_mesh.resize(padded_size);
+			lod_state.resize(padded_size);
+
+			// Initialise padding entries, although the results for them are ignored.
+			for(size_t z=old_size; z<padded_size; ++z)
+			{
+				centroid_x[z] = centroid_y[z] = centroid_z[z] = 0.f;
+				biased_aabb_len[z] = 0.f;
+				exclude_from_lod_chunk_mesh[z] = 0;
+				lod_state[z] = LOD_STATE_NOT_IN_PROXIMITY;
+			}
+		}
+
+		ob->lod_table = this;
+		ob->lod_table_index = (int)i;
+	}
+	else
+	{
+		assert(ob->lod_table == this);
+		assert(obs[ob->lod_table_index] == ob);
+	}
+
+	setEntry(ob->lod_table_index, ob);
+	lod_state[ob->lod_table_index] = LOD_STATE_UNKNOWN;
+}
+
+
+void ObjectLODTable::removeObject(WorldObject* ob)
+{
+	if(ob->lod_table_index < 0)
+		return;
+
+	assert(ob->lod_table == this);
+	const size_t i = ob->lod_table_index;
+	assert(obs[i] == ob);
+
+	// Swap with last item and pop back
+	const size_t last = obs.size() - 1;
+	if(i != last)
+	{
+		obs[i] = obs[last];
+		centroid_x[i] = centroid_x[last];
+		centroid_y[i] = centroid_y[last];
+		centroid_z[i] = centroid_z[last];
+		biased_aabb_len[i] = biased_aabb_len[last];
+		exclude_from_lod_chunk_mesh[i] = exclude_from_lod_chunk_mesh[last];
+		lod_state[i] = lod_state[last];
+		obs[i]->lod_table_index = (int)i;
+	}
+	obs.pop_back();
+
+	const size_t padded_size = paddedSize(obs.size());
+	centroid_x.resize(padded_size);
+	centroid_y.resize(padded_size);
+	centroid_z.resize(padded_size);
+	biased_aabb_len.resize(padded_size);
+	exclude_from_lod_chunk_mesh.resize(padded_size);
+	lod_state.resize(padded_size);
+
+	ob->lod_table = NULL;
+	ob->lod_table_index = -1;
+}
+
+
+void ObjectLODTable::clear()
+{
+	for(size_t i=0; i<obs.size(); ++i)
+	{
+		obs[i]->lod_table = NULL;
+		obs[i]->lod_table_index = -1;
+	}
+
+	obs.clear();
+	centroid_x.clear();
+	centroid_y.clear();
+	centroid_z.clear();
+	biased_aabb_len.clear();
+	exclude_from_lod_chunk_mesh.clear();
+	lod_state.clear();
+}
+
+
+void ObjectLODTable::objectTransformChanged(const WorldObject* ob)
+{
+	assert(ob->lod_table == this && ob->lod_table_index >= 0 && obs[ob->lod_table_index] == ob);
+
+	setEntry(ob->lod_table_index, ob);
+}
+
+
+void ObjectLODTable::objectLODStateChanged(const WorldObject* ob)
+{
+	if(ob->lod_table_index >= 0)
+	{
+		assert(ob->lod_table == this && obs[ob->lod_table_index] == ob);
+		lod_state[ob->lod_table_index] = LODStateForObject(ob);
+	}
+}
+
+
+/*
+Vectorised version of the computation in computeLODState() below.
+The LOD level is computed as in WorldObject::getLODLevel(float cam_to_ob_d2), using the same rsqrt approximation.
+Comparisons are written so that NaN projected lengths give the same results as the scalar code.
+*/
+uint32 ObjectLODTable::computeChangedMask(const ComputeParams& params, size_t begin, int32* new_states_out) const
+{
+	const __m128 x = _mm_load_ps(centroid_x.data() + begin);
+	const __m128 y = _mm_load_ps(centroid_y.data() + begin);
+	const __m128 z = _mm_load_ps(centroid_z.data() + begin);
+
+	const __m128 cam_x = _mm_set1_ps(params.campos[0]);
+	const __m128 cam_y = _mm_set1_ps(params.campos[1]);
+	const __m128 cam_z = _mm_set1_ps(params.campos[2]);
+
+	const __m128 dx = _mm_sub_ps(x, cam_x);
+	const __m128 dy = _mm_sub_ps(y, cam_y);
+	const __m128 dz = _mm_sub_ps(z, cam_z);
+	const __m128 cam_to_ob_d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+	const __m128 proj_len = _mm_mul_ps(_mm_load_ps(biased_aabb_len.data() + begin), _mm_rsqrt_ps(cam_to_ob_d2));
+
+	// lod_level = -1 + (number of thresholds that proj_len is not greater than).  Each comparison mask is -1 where true, so subtract it.
+	__m128i lod_level = _mm_set1_epi32(-1);
+	lod_level = _mm_sub_epi32(lod_level, _mm_castps_si128(_mm_cmpngt_ps(proj_len, _mm_set1_ps(0.6f))));
+	lod_level = _mm_sub_epi32(lod_level, _mm_castps_si128(_mm_cmpngt_ps(proj_len, _mm_set1_ps(0.16f))));
+	lod_level = _mm_sub_epi32(lod_level, _mm_castps_si128(_mm_cmpngt_ps(proj_len, _mm_set1_ps(0.03f))));
+
+	__m128 in_proximity = _mm_cmplt_ps(cam_to_ob_d2, _mm_set1_ps(params.load_distance2));
+	if(params.use_proj_len_viewable_threshold)
+		in_proximity = _mm_and_ps(in_proximity, _mm_cmpgt_ps(proj_len, _mm_set1_ps(params.proj_len_viewable_threshold)));
+
+	if(params.use_lod_chunks)
+	{
+		// If this object is in a chunk region, and we are displaying the chunk, then don't show the object.
+		const __m128 chunk_w = _mm_set1_ps(params.chunk_w);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 chunk_centre_x = _mm_mul_ps(_mm_add_ps(_mm_floor_ps(_mm_div_ps(x, chunk_w)), half), chunk_w);
+		const __m128 chunk_centre_y = _mm_mul_ps(_mm_add_ps(_mm_floor_ps(_mm_div_ps(y, chunk_w)), half), chunk_w);
+		const __m128 chunk_dx = _mm_sub_ps(chunk_centre_x, cam_x);
+		const __m128 chunk_dy = _mm_sub_ps(chunk_centre_y, cam_y);
+		const __m128 dist_to_chunk2 = _mm_add_ps(_mm_mul_ps(chunk_dx, chunk_dx), _mm_mul_ps(chunk_dy, chunk_dy));
+
+		const __m128 display_chunk = _mm_cmpgt_ps(dist_to_chunk2, _mm_set1_ps(Maths::square(params.chunk_dist_threshold)));
+		const __m128 hidden_by_chunk = _mm_andnot_ps(_mm_castsi128_ps(_mm_load_si128((const __m128i*)(exclude_from_lod_chunk_mesh.data() + begin))), display_chunk);
+		in_proximity = _mm_andnot_ps(hidden_by_chunk, in_proximity);
+	}
+
+	const __m128i new_state = _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(_mm_set1_epi32(LOD_STATE_NOT_IN_PROXIMITY)), _mm_castsi128_ps(lod_level), in_proximity));
+	_mm_storeu_si128((__m128i*)new_states_out, new_state);
+
+	const __m128i unchanged = _mm_cmpeq_epi32(new_state, _mm_load_si128((const __m128i*)(lod_state.data() + begin)));
+	return (uint32)_mm_movemask_ps(_mm_castsi128_ps(unchanged)) ^ 0xF;
+}
+
+
+int ObjectLODTable::computeLODState(const ComputeParams& params, size_t i) const
+{
+	const float dx = centroid_x[i] - params.campos[0];
+	const float dy = centroid_y[i] - params.campos[1];
+	const float dz = centroid_z[i] - params.campos[2];
+	const float cam_to_ob_d2 = (dx*dx + dy*dy) + dz*dz;
+
+	const float recip_dist = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(cam_to_ob_d2)));
+	const float proj_len = biased_aabb_len[i] * recip_dist;
+
+	bool in_proximity = cam_to_ob_d2 < params.load_distance2;
+	if(params.use_proj_len_viewable_threshold)
+		in_proximity = in_proximity && (proj_len > params.proj_len_viewable_threshold);
+
+	if(params.use_lod_chunks)
+	{
+		const float chunk_centre_x = (Maths::floorToInt(centroid_x[i] / params.chunk_w) + 0.5f) * params.chunk_w;
+		const float chunk_centre_y = (Maths::floorToInt(centroid_y[i] / params.chunk_w) + 0.5f) * params.chunk_w;
+		const float dist_to_chunk2 = Maths::square(chunk_centre_x - params.campos[0]) + Maths::square(chunk_centre_y - params.campos[1]);
+		if((dist_to_chunk2 > Maths::square(params.chunk_dist_threshold)) && (exclude_from_lod_chunk_mesh[i] == 0))
+			in_proximity = false;
+	}
+
+	if(!in_proximity)
+		return LOD_STATE_NOT_IN_PROXIMITY;
+
+	if(proj_len > 0.6f)
+		return -1;
+	else if(proj_len > 0.16f)
+		return 0;
+	else if(proj_len > 0.03f)
+		return 1;
+	else
+		return 2;
+}
+
+
+void ObjectLODTable::computeChangedObjects(const ComputeParams& params, std::vector<ObjectLODChange>& changes_out) const
+{
+	const size_t num_obs = obs.size();
+	for(size_t begin=0; begin<num_obs; begin += 4)
+	{
+		int32 new_states[4];
+		uint32 mask = computeChangedMask(params, begin, new_states);
+
+		// Ignore padding entries in the last group.
+		if(begin + 4 > num_obs)
+			mask &= (1u << (num_obs - begin)) - 1;
+
+		if(mask != 0)
+			for(int z=0; z<4; ++z)
+				if(mask & (1u << z))
+				{
+					ObjectLODChange change;
+					change.ob = obs[begin + z];
+					change.new_lod_state = new_states[z];
+					changes_out.push_back(change);
+				}
+	}
+}
+
+
+#if BUILD_TESTS
+
+
+#include "../utils/TestUtils.h"
+#include "../utils/ConPrint.h"
+#include "../utils/Timer.h"
+#include "../utils/StringUtils.h"
+#include "../maths/PCG32.h"
+#include <cmath>
+#include <cstdlib>
+
+
+static void applyChanges(ObjectLODTable& table, const std::vector<ObjectLODTable::ObjectLODChange>& changes)
+{
+	for(size_t i=0; i<changes.size(); ++i)
+	{
+		WorldObject* ob = changes[i].ob;
+		ob->in_proximity = changes[i].new_lod_state != ObjectLODTable::LOD_STATE_NOT_IN_PROXIMITY;
+		if(ob->in_proximity)
+			ob->current_lod_level = changes[i].new_lod_state;
+		table.objectLODStateChanged(ob);
+	}
+}
+
+
+static WorldObjectRef makeTestOb(const Vec3d& pos, float size)
+{
+	WorldObjectRef ob = new WorldObject();
+	ob->pos = pos;
+	ob->axis = Vec3f(0, 0, 1);
+	ob->angle = 0;
+	ob->scale = Vec3f(1.f);
+	ob->setAABBOS(js::AABBox(Vec4f(0, 0, 0, 1), Vec4f(size, size, size, 1)));
+	return ob;
+}
+
+
+void ObjectLODTable::test()
+{
+	conPrint("ObjectLODTable::test()");
+
+	ComputeParams params;
+	params.campos = Vec4f(0, 0, 0, 1);
+	params.load_distance2 = Maths::square(500.f);
+	params.use_proj_len_viewable_threshold = false;
+	params.proj_len_viewable_threshold = 0.02f;
+	params.use_lod_chunks = false;
+	params.chunk_w = 128.f;
+	params.chunk_dist_threshold = 150.f;
+
+	//-------------------- Test computeChangedMask against scalar computeLODState, for random objects and camera positions --------------------
+	{
+		PCG32 rng(1);
+		ObjectLODTable table;
+		std::vector<WorldObjectRef> obs;
+		for(int i=0; i<1001; ++i)
+		{
+			WorldObjectRef ob = makeTestOb(Vec3d((rng.unitRandom() - 0.5f) * 2000, (rng.unitRandom() - 0.5f) * 2000, rng.unitRandom() * 50), rng.unitRandom() * 20);
+			if(rng.unitRandom() < 0.2f)
+			{
+				ob->flags |= WorldObject::EXCLUDE_FROM_LOD_CHUNK_MESH;
+				ob->exclude_from_lod_chunk_mesh = true;
+			}
+			obs.push_back(ob);
+			table.insertOrUpdateObject(ob.ptr());
+		}
+		testAssert(table.size() == obs.size());
+
+		for(int iter=0; iter<100; ++iter)
+		{
+			params.campos = Vec4f((rng.unitRandom() - 0.5f) * 2000, (rng.unitRandom() - 0.5f) * 2000, rng.unitRandom() * 50, 1);
+			params.use_proj_len_viewable_threshold = (iter % 2) == 0;
+			params.use_lod_chunks = (iter % 3) == 0;
+
+			for(size_t begin=0; begin<obs.size(); begin += 4)
+			{
+				int32 new_states[4];
+				const uint32 mask = table.computeChangedMask(params, begin, new_states);
+				for(size_t z=0; z<4 && begin + z < obs.size(); ++z)
+				{
+					const int ref_state = table.computeLODState(params, begin + z);
+					testAssert(new_states[z] == ref_state);
+					testAssert((((mask >> z) & 1) != 0) == (ref_state != table.lod_state[begin + z]));
+				}
+			}
+
+			// Check scalar computation matches WorldObject::getLODLevel() for objects in proximity.
+			if(!params.use_proj_len_viewable_threshold && !params.use_lod_chunks)
+				for(size_t i=0; i<obs.size(); ++i)
+				{
+					const float d2 = obs[i]->getCentroidWS().getDist2(params.campos);
+					const int state = table.computeLODState(params, i);
+					if(std::fabs(d2 - params.load_distance2) > 1.f)
+						testAssert((state != LOD_STATE_NOT_IN_PROXIMITY) == (d2 < params.load_distance2));
+					if(state != LOD_STATE_NOT_IN_PROXIMITY)
+					{
+						const int ob_lod_level = obs[i]->getLODLevel(d2);
+						testAssert(std::abs(ob_lod_level - state) <= 1); // Allow for rounding differences at LOD boundaries.
+					}
+				}
+		}
+
+		table.clear();
+		for(size_t i=0; i<obs.size(); ++i)
+			testAssert(obs[i]->lod_table == NULL && obs[i]->lod_table_index == -1);
+	}
+
+	//-------------------- Test that changes are only returned until they are applied, and that transform changes are picked up --------------------
+	{
+		params.campos = Vec4f(0, 0, 0, 1);
+		params.use_proj_len_viewable_threshold = false;
+		params.use_lod_chunks = false;
+
+		ObjectLODTable table;
+		WorldObjectRef near_ob = makeTestOb(Vec3d(10, 0, 0), 1.f);
+		WorldObjectRef far_ob = makeTestOb(Vec3d(1000, 0, 0), 1.f);
+		table.insertOrUpdateObject(near_ob.ptr());
+		table.insertOrUpdateObject(far_ob.ptr());
+
+		std::vector<ObjectLODChange> changes;
+		table.computeChangedObjects(params, changes);
+		testAssert(changes.size() == 2); // Newly inserted objects should always be returned.
+		applyChanges(table, changes);
+		testAssert(near_ob->in_proximity && !far_ob->in_proximity);
+
+		changes.clear();
+		table.computeChangedObjects(params, changes);
+		testAssert(changes.empty());
+
+		// Move far object near to the camera.
+		far_ob->pos = Vec3d(5, 0, 0);
+		far_ob->transformChanged();
+
+		changes.clear();
+		table.computeChangedObjects(params, changes);
+		testAssert(changes.size() == 1 && changes[0].ob == far_ob.ptr() && changes[0].new_lod_state != LOD_STATE_NOT_IN_PROXIMITY);
+		applyChanges(table, changes);
+
+		// Remove the first object, check the moved object still has a correct index.
+		table.removeObject(near_ob.ptr());
+		testAssert(near_ob->lod_table_index == -1 && far_ob->lod_table_index == 0);
+		testAssert(table.size() == 1);
+
+		far_ob->pos = Vec3d(2000, 0, 0);
+		far_ob->transformChanged();
+		changes.clear();
+		table.computeChangedObjects(params, changes);
+		testAssert(changes.size() == 1 && changes[0].ob == far_ob.ptr() && changes[0].new_lod_state == LOD_STATE_NOT_IN_PROXIMITY);
+
+		// Removing an object not in the table should do nothing.
+		table.removeObject(near_ob.ptr());
+		testAssert(table.size() == 1);
+
+		table.clear();
+	}
+
+	// Performance test
+	if(false)
+	{
+		PCG32 rng(1);
+		ObjectLODTable table;
+		std::vector<WorldObjectRef> obs;
+		const int N = 100000;
+		for(int i=0; i<N; ++i)
+		{
+			WorldObjectRef ob = makeTestOb(Vec3d((rng.unitRandom() - 0.5f) * 4000, (rng.unitRandom() - 0.5f) * 4000, rng.unitRandom() * 50), rng.unitRandom() * 20);
+			obs.push_back(ob);
+			table.insertOrUpdateObject(ob.ptr());
+		}
+
+		params.use_lod_chunks = true;
+		std::vector<ObjectLODChange> changes;
+		table.computeChangedObjects(params, changes);
+		applyChanges(table, changes);
+
+		const int num_iters = 1000;
+		Timer timer;
+		size_t num_changes = 0;
+		for(int i=0; i<num_iters; ++i)
+		{
+			params.campos += Vec4f(0.1f, 0, 0, 0);
+			changes.clear();
+			table.computeChangedObjects(params, changes);
+			applyChanges(table, changes);
+			num_changes += changes.size();
+		}
+		conPrint("computeChangedObjects: " + doubleToStringNSigFigs(timer.elapsed() / num_iters * 1.0e6, 4) + " us for " + toString(N) + " obs (" + toString(num_changes) + " changes total)");
+
+		table.clear();
+	}
+
+	conPrint("ObjectLODTable::test() done.");
+}
+
+
+#endif // BUILD_TESTS
@@ -0,0 +1,95 @@
+/*=====================================================================
+ObjectLODTable.h
+----------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#pragma once
+
+
+#include "../utils/Vector.h"
+#include "../maths/Vec4f.h"
+#include <vector>
+class WorldObject;
+
+
+/*=====================================================================
+ObjectLODTable
+--------------
+Compact structure-of-arrays copy of the fields of each world object that are
+needed to compute its LOD level and whether it is within load distance.
+
+Used by GUIClient::checkForLODChanges(), so that it can check all objects each frame
+with a vectorised loop, without touching the (large) WorldObjects themselves.
+
+Objects store their index in the table (WorldObject::lod_table_index), and
+WorldObject::doTransformChanged() etc. update the table entry for the object, so the
+table stays in sync with object transforms.
+
+The table also stores the 'LOD state' of each object: current_lod_level if the object is in proximity,
+or LOD_STATE_NOT_IN_PROXIMITY otherwise.  computeChangedObjects() returns the objects whose computed LOD state
+differs from the stored state.
+Should be accessed with the world state mutex held.
+=====================================================================*/
+class ObjectLODTable
+{
+public:
+	ObjectLODTable();
+	~ObjectLODTable();
+
+	static const int LOD_STATE_NOT_IN_PROXIMITY = 100;
+	static const int LOD_STATE_UNKNOWN = 101; // Used for newly inserted objects, so they will be returned by computeChangedObjects().
+
+	// Inserts the object if it is not already in the table, otherwise re-reads all fields from the object.
+	// In both cases the stored LOD state is set to LOD_STATE_UNKNOWN, so the object will be returned by the next computeChangedObjects() call.
+	void insertOrUpdateObject(WorldObject* ob);
+	void removeObject(WorldObject* ob);
+	void clear();
+
+	// Re-read centroid and biased AABB length from object.  Called from WorldObject::doTransformChanged() etc.
+	void objectTransformChanged(const WorldObject* ob);
+
+	// Re-read ob->in_proximity and ob->current_lod_level.
+	void objectLODStateChanged(const WorldObject* ob);
+
+	struct ComputeParams
+	{
+		Vec4f campos;
+		float load_distance2;
+		bool use_proj_len_viewable_threshold;
+		float proj_len_viewable_threshold;
+		bool use_lod_chunks; // If true, objects in a LOD chunk that is displayed are not in proximity, unless exclude_from_lod_chunk_mesh is set.
+		float chunk_w;
+		float chunk_dist_threshold; // LOD chunks are displayed if the camera is further than this from the chunk centre (in the xy plane).
+	};
+
+	struct ObjectLODChange
+	{
+		WorldObject* ob;
+		int new_lod_state;
+	};
+
+	// Computes the LOD state of all objects, appends objects whose LOD state differs from the stored state to changes_out.
+	// Doesn't update the stored LOD state, objectLODStateChanged() should be called once the change has been handled.
+	void computeChangedObjects(const ComputeParams& params, std::vector<ObjectLODChange>& changes_out) const;
+
+	// Computes LOD state for the 4 objects in [begin, begin + 4), writing to new_states_out.
+	// Returns bitmask with bit i set if LOD state of object begin + i differs from stored state.
+	uint32 computeChangedMask(const ComputeParams& params, size_t begin, int32* new_states_out) const;
+
+	// Computed LOD state for a single object, scalar version.  Used for testing.
+	int computeLODState(const ComputeParams& params, size_t i) const;
+
+	inline size_t size() const { return obs.size(); }
+
+	static void test();
+
+private:
+	void setEntry(size_t i, const WorldObject* ob);
+
+	// Arrays are padded to a multiple of 4 elements.
+	js::Vector<float, 16> centroid_x, centroid_y, centroid_z;
+	js::Vector<float, 16> biased_aabb_len;
+	js::Vector<int32, 16> exclude_from_lod_chunk_mesh; // 0 or -1 (all bits set)
+	js::Vector<int32, 16> lod_state; // Stored LOD state
+	std::vector<WorldObject*> obs; // Not padded.
+};
@@ -12,6 +12,8 @@ Copyright Glare Technologies Limited 2023 -
 
 ParticleManager::ParticleManager(const std::string& base_dir_path_, AsyncTextureLoader* async_tex_loader_, OpenGLEngine* opengl_engine_, PhysicsWorld* physics_world_, TerrainDecalManager* terrain_decal_manager_)
 :	base_dir_path(base_dir_path_), opengl_engine(opengl_engine_), physics_world(physics_world_), terrain_decal_manager(terrain_decal_manager_),
+	max_num_particles(2048),
+	last_campos(0, 0, 0, 1),
 	async_tex_loader(async_tex_loader_)
 {
 	TextureParams params;
@@ -70,33 +72,100 @@ void ParticleManager::clear()
 		async_tex_loader->cancelLoadingTexture(loading_handles[i]);
 	loading_handles.clear();
 
-	for(size_t i=0; i<particles.size(); ++i)
+	for(size_t i=0; i<particle_gl_ob.size(); ++i)
 	{
-		if(particles[i].gl_ob.nonNull())
-			opengl_engine->removeObject(particles[i].gl_ob);
+		if(particle_gl_ob[i].nonNull())
+			opengl_engine->removeObject(particle_gl_ob[i]);
 	}
-	particles.clear();
+	resizeParticleArrays(0);
 }
 
 
+void ParticleManager::resizeParticleArrays(size_t new_size)
+{
+	particle_pos.resize(new_size);
+	particle_vel.resize(new_size);
+	particle_drag_factor.resize(new_size);
+	particle_restitution.resize(new_size);
+	particle_width.resize(new_size);
+	particle_dwidth_dt.resize(new_size);
+	particle_opacity.resize(new_size);
+	particle_dopacity_dt.resize(new_size);
+	particle_theta.resize(new_size);
+	particle_collision_free_time.resize(new_size);
+	particle_die_when_hit_surface.resize(new_size);
+	particle_gl_ob.resize(new_size);
+}
+
+
+// Remove particle i: swap with last particle in arrays, then remove last array element.
+void ParticleManager::removeParticle(size_t i)
+{
+	const size_t last = particle_pos.size() - 1;
+	mySwap(particle_pos[i],							particle_pos[last]);
+	mySwap(particle_vel[i],							particle_vel[last]);
+	mySwap(particle_drag_factor[i],					particle_drag_factor[last]);
+	mySwap(particle_restitution[i],					particle_restitution[last]);
+	mySwap(particle_width[i],						particle_width[last]);
+	mySwap(particle_dwidth_dt[i],					particle_dwidth_dt[last]);
+	mySwap(particle_opacity[i],						particle_opacity[last]);
+	mySwap(particle_dopacity_dt[i],					particle_dopacity_dt[last]);
+	mySwap(particle_theta[i],						particle_theta[last]);
+	mySwap(particle_collision_free_time[i],			particle_collision_free_time[last]);
+	mySwap(particle_die_when_hit_surface[i],		particle_die_when_hit_surface[last]);
+	mySwap(particle_gl_ob[i],						particle_gl_ob[last]);
+	resizeParticleArrays(last);
+}
+
+
+static const float MAX_PARTICLE_DIST = 300.f; // New particles further than this from the camera are not added.
+static const float FAR_PARTICLE_DIST = 50.f; // Particles further than this from the camera use the longer collision lookahead.
+static const float SLOW_PARTICLE_SPEED = 2.f; // Particles with speed less than this use the longer collision lookahead.
+static const float LOOKAHEAD_NUM_FRAMES = 4.f; // Longer collision lookahead period, in frames.
+static const float GRAVITY_ACCEL = 9.81f;
+static const float MAX_DRAG_ACCEL = 10.f; // Drag acceleration magnitude is clamped to this.
+static const size_t COLLISION_BATCH_SIZE = 64;
+
+
 void ParticleManager::addParticle(const Particle& particle_)
 {
-	// conPrint("addParticle, particles.size(): " + toString(particles.size()));
+	// conPrint("addParticle, particles.size(): " + toString(particle_pos.size()));
 
-	const size_t MAX_NUM_PARTICLES = 2048;
+	const float new_dist2 = (particle_.pos - last_campos).length2();
+	if(new_dist2 > Maths::square(MAX_PARTICLE_DIST))
+		return;
 
 	size_t use_index;
-	if(particles.size() >= MAX_NUM_PARTICLES) // If we have enough particles already:
+	if(particle_pos.size() >= max_num_particles) // If we have enough particles already:
 	{
-		use_index = rng.nextUInt((uint32)particles.size()); // Pick a random existing particle to replace
+		if(particle_pos.empty())
+			return;
+
+		// Pick an existing particle to replace: the furthest from the camera out of a few randomly chosen particles.
+		use_index = rng.nextUInt((uint32)particle_pos.size());
+		float use_dist2 = (particle_pos[use_index] - last_campos).length2();
+		for(int z=0; z<3; ++z)
+		{
+			const size_t index = rng.nextUInt((uint32)particle_pos.size());
+			const float dist2 = (particle_pos[index] - last_campos).length2();
+			if(dist2 > use_dist2)
+			{
+				use_index = index;
+				use_dist2 = dist2;
+			}
+		}
+
+		// If the new particle is much further away from the camera than the particle it would replace, don't add it.
+		if(new_dist2 > 4 * use_dist2)
+			return;
 
 		// Remove existing particle at this index
-		opengl_engine->removeObject(particles[use_index].gl_ob);
+		opengl_engine->removeObject(particle_gl_ob[use_index]);
 	}
 	else
 	{
-		use_index = particles.size();
-		particles.resize(use_index + 1);
+		use_index = particle_pos.size();
+		resizeParticleArrays(use_index + 1);
 	}
 
 
@@ -133,141 +202,200 @@ void ParticleManager::addParticle(const Particle& particle_)
 	ob->ob_to_world_matrix.e[1] = particle_.theta; // Since object-space vert positions are just (0,0,0) for particle geometry, we can store info in the model matrix.
 	opengl_engine->addObject(ob);
 
-	Particle particle = particle_;
-	particle.gl_ob = ob;
-
-	particles[use_index] = particle;
+	const float rho = 1.293f; // air density, kg m^-3
+	const float C_d = 0.5f; // drag coefficient
+
+	particle_pos[use_index]						= particle_.pos;
+	particle_vel[use_index]						= particle_.vel;
+	particle_drag_factor[use_index]				= 0.5f * rho * C_d * particle_.area / particle_.mass;
+	particle_restitution[use_index]				= particle_.restitution;
+	particle_width[use_index]					= particle_.width;
+	particle_dwidth_dt[use_index]				= particle_.dwidth_dt;
+	particle_opacity[use_index]					= particle_.cur_opacity;
+	particle_dopacity_dt[use_index]				= particle_.dopacity_dt;
+	particle_theta[use_index]					= particle_.theta;
+	particle_collision_free_time[use_index]		= 0; // Do a collision check on the first think() call.
+	particle_die_when_hit_surface[use_index]	= particle_.die_when_hit_surface ? 1 : 0;
+	particle_gl_ob[use_index]					= ob;
 }
 
 
-void ParticleManager::think(const float dt)
+void ParticleManager::think(const float dt, const Vec4f& campos)
 {
 	//Timer timer;
 
+	this->last_campos = campos;
+
 	const bool water_buoyancy_enabled = physics_world->getWaterBuoyancyEnabled();
 	const float water_z = physics_world->getWaterZ();
 
-	for(size_t i=0; i<particles.size();)
+	const size_t num_particles = particle_pos.size();
+
+	Vec4f* const pos					= particle_pos.data();
+	Vec4f* const vel					= particle_vel.data();
+	float* const drag_factor			= particle_drag_factor.data();
+	float* const restitution			= particle_restitution.data();
+	float* const width					= particle_width.data();
+	float* const dwidth_dt				= particle_dwidth_dt.data();
+	float* const opacity				= particle_opacity.data();
+	float* const dopacity_dt			= particle_dopacity_dt.data();
+	float* const collision_free_time	= particle_collision_free_time.data();
+	const uint8* const die_when_hit_surface = particle_die_when_hit_surface.data();
+
+	//---------------------- Collision detection and integration of position and velocity ----------------------
+	for(size_t batch_begin=0; batch_begin<num_particles; batch_begin += COLLISION_BATCH_SIZE)
 	{
-		Particle& particle = particles[i];
+		const size_t batch_end = myMin(num_particles, batch_begin + COLLISION_BATCH_SIZE);
 
-		assert(particle.pos.isFinite());
+		// Work out which particles in the batch need a collision ray cast this frame, and the AABB of the ray segments.
+		float lookahead[COLLISION_BATCH_SIZE]; // Lookahead period if the particle needs a ray cast, or 0 if it doesn't.
+		js::AABBox batch_aabb = js::AABBox::emptyAABBox();
+		bool any_need_check = false;
+		for(size_t i=batch_begin; i<batch_end; ++i)
+		{
+			lookahead[i - batch_begin] = 0;
+			if(collision_free_time[i] < dt)
+			{
+				const float v_mag2 = vel[i].length2();
+				const bool is_slow = v_mag2 < Maths::square(SLOW_PARTICLE_SPEED);
+				const bool is_far = (pos[i] - campos).length2() > Maths::square(FAR_PARTICLE_DIST);
+				float particle_lookahead = dt;
+				if(is_slow || is_far)
+				{
+					// The ray is cast along the current velocity, but over several frames the path curves due to gravity and drag.
+					// The path deviates from the ray by at most 0.5 * max_accel * t^2, so limit the lookahead so the deviation is at most the particle radius (0.5 * width):
+					// 0.5 * max_accel * t^2 <= 0.5 * width  =>  t <= sqrt(width / max_accel).
+					// Over a single frame the particle moves exactly along the ray, so always look ahead at least dt.
+					const float max_accel = GRAVITY_ACCEL + myMin(MAX_DRAG_ACCEL, drag_factor[i] * v_mag2);
+					const float max_curved_lookahead = std::sqrt(myMax(0.f, width[i]) / max_accel);
+					particle_lookahead = myMax(dt, myMin(dt * LOOKAHEAD_NUM_FRAMES, max_curved_lookahead));
+				}
 
-		const Vec4f pos_delta = particle.vel * dt;
+				lookahead[i - batch_begin] = particle_lookahead;
+				batch_aabb.enlargeToHoldPoint(pos[i]);
+				batch_aabb.enlargeToHoldPoint(pos[i] + vel[i] * particle_lookahead);
+				any_need_check = true;
+			}
+		}
 
-		
-		RayTraceResult results;
-		results.hit_object = NULL;
-		//if(pos_delta.length2() > Maths::square(1.0e-3f))
-			physics_world->traceRay(particle.pos, particle.vel, dt, /*ignore body id=*/JPH::BodyID(), results);
+		// Test the batch AABB against the broadphase.  If it doesn't overlap any bodies, none of the rays can hit anything.
+		const bool batch_may_hit = any_need_check && physics_world->doesAABBOverlapAnyBody(batch_aabb);
 
-		float remaining_dt = dt;
-		if(results.hit_object)
+		for(size_t i=batch_begin; i<batch_end; ++i)
 		{
-			const float to_hit_dt = results.hit_t;
-			assert(to_hit_dt <= dt);
-			remaining_dt -= to_hit_dt;
+			assert(pos[i].isFinite());
 
-			const Vec4f hitpos = particle.pos + particle.vel * to_hit_dt;
+			RayTraceResult results;
+			results.hit_object = NULL;
+			const float particle_lookahead = lookahead[i - batch_begin];
+			if(particle_lookahead > 0)
+			{
+				if(batch_may_hit)
+					physics_world->traceRay(pos[i], vel[i], particle_lookahead, /*ignore body id=*/JPH::BodyID(), results);
 
-			// Reflect velocity vector in hit normal
-			particle.vel -= results.hit_normal_ws * (2 * dot(results.hit_normal_ws, particle.vel));
-			particle.vel *= particle.restitution; // Apply restitution factor for inelastic collisions.
+				collision_free_time[i] = results.hit_object ? results.hit_t : particle_lookahead;
+			}
 
-			assert(particle.pos.isFinite());
-			assert(particle.vel.isFinite());
+			if(results.hit_object && (results.hit_t <= dt))
+			{
+				const float to_hit_dt = results.hit_t;
+				const float remaining_dt = dt - to_hit_dt;
 
-			particle.pos = hitpos + 
-				results.hit_normal_ws * 1.0e-3f + // nudge off surface
-				particle.vel * remaining_dt;
+				const Vec4f hitpos = pos[i] + vel[i] * to_hit_dt;
 
-			assert(particle.pos.isFinite());
-			assert(particle.vel.isFinite());
+				// Reflect velocity vector in hit normal
+				vel[i] -= results.hit_normal_ws * (2 * dot(results.hit_normal_ws, vel[i]));
+				vel[i] *= restitution[i]; // Apply restitution factor for inelastic collisions.
 
-			if(particle.die_when_hit_surface)
-				particle.cur_opacity = -1;
-		}
-		else
-		{
-			particle.pos += pos_delta;
+				assert(vel[i].isFinite());
 
-			if(water_buoyancy_enabled && (particle.pos[2] < water_z))
-			{
-				if(particle.die_when_hit_surface && (particle.vel[2] < 0)) // If should die when hit surface, and are moving downwards:
-				{
-					particle.cur_opacity = -1;
+				pos[i] = hitpos + 
+					results.hit_normal_ws * 1.0e-3f + // nudge off surface
+					vel[i] * remaining_dt;
 
-					// Create foam decal at hit position
-					Vec4f foam_pos = particle.pos;
-					foam_pos[2] = water_z;
-					terrain_decal_manager->addFoamDecal(foam_pos, /*width=*/particle.width, /*opacity=*/1.f, TerrainDecalManager::DecalType_SparseFoam);
-				}
+				assert(pos[i].isFinite());
+
+				collision_free_time[i] = 0; // Velocity changed, so do another collision check next frame.
 
-				// underwater
-				particle.vel[2] = myMax(particle.vel[2], 0.5f); // apply buoyancy in a hacky way while not limiting positive z velocity (e.g. for water spray shooting out of water)
+				if(die_when_hit_surface[i])
+					opacity[i] = -1;
 			}
 			else
-				particle.vel[2] -= 9.81f * dt; // Apply gravity
-		}
+			{
+				pos[i] += vel[i] * dt;
 
-		assert(particle.vel.isFinite());
+				if(water_buoyancy_enabled && (pos[i][2] < water_z))
+				{
+					if(die_when_hit_surface[i] && (vel[i][2] < 0)) // If should die when hit surface, and are moving downwards:
+					{
+						opacity[i] = -1;
+
+						// Create foam decal at hit position
+						Vec4f foam_pos = pos[i];
+						foam_pos[2] = water_z;
+						terrain_decal_manager->addFoamDecal(foam_pos, /*width=*/width[i], /*opacity=*/1.f, TerrainDecalManager::DecalType_SparseFoam);
+					}
+
+					// underwater
+					vel[i][2] = myMax(vel[i][2], 0.5f); // apply buoyancy in a hacky way while not limiting positive z velocity (e.g. for water spray shooting out of water)
+					collision_free_time[i] = 0;
+				}
+				else
+					vel[i][2] -= GRAVITY_ACCEL * dt; // Apply gravity
+			}
 
-		// Apply wind-resistance drag force
-		const float v_mag2 = particle.vel.length2();
-		if(v_mag2 > Maths::square(1.0e-3f))
-		{
-			// ||a|| = F_d rho * ||v||^2 C_d A / m
-
-			// dvel = -vel/||vel|| * ||a|| * dt    = vel * (||a|| * dt / ||v||)
-			// vel' = vel + devl = vel - vel * (||a|| * dt / ||v||)
-			// vel' = vel - vel * (F_d rho * ||v||^2 C_d A * dt / (m * ||v||))
-			// vel' = vel - vel * (F_d rho * ||v|| C_d A * dt / m)
-			// vel' = vel * (1 - F_d rho * ||v|| C_d A * dt / m)
-
-			const float rho = 1.293f; // air density, kg m^-3
-			const float projected_forwards_area = particle.area;
-			const float forwards_C_d = 0.5f; // drag coefficient
-			const float forwards_F_d = 0.5f * rho * v_mag2 * forwards_C_d * projected_forwards_area;
-			const float mass = particle.mass;
-			const float accel_mag = myMin(10.f, forwards_F_d / mass);
-
-			// dvel = -vel/||vel|| * ||a|| * dt    = vel * (||a|| * dt / ||vel||)
-			// vel' = vel + dvel = vel - vel * (||a|| * dt / ||vel||)
-			// vel' = vel * (1 - (||a|| * dt / ||vel||))
-			particle.vel *= myMax(0.f, 1.f - accel_mag * dt / std::sqrt(v_mag2));
-
-			assert(particle.vel.isFinite());
-		}
+			collision_free_time[i] -= dt;
 
-		assert(particle.pos.isFinite());
-		assert(particle.vel.isFinite());
-		
-		particle.cur_opacity += particle.dopacity_dt * dt;
-		particle.width       += particle.dwidth_dt   * dt;
+			assert(vel[i].isFinite());
+		}
+	}
 
-		particle.gl_ob->ob_to_world_matrix = translationMulUniformScaleMatrix(/*translation=*/particle.pos, /*scale=*/particle.width);
-		particle.gl_ob->ob_to_world_matrix.e[1] = particle.theta; // Since object-space vert positions are just (0,0,0) for particle geometry, we can store info in the model matrix.
+	//---------------------- Apply wind-resistance drag force ----------------------
+	for(size_t i=0; i<num_particles; ++i)
+	{
+		// ||a|| = F_d / m = 0.5 rho ||v||^2 C_d A / m = drag_factor * ||v||^2
+		// dvel = -vel/||vel|| * ||a|| * dt
+		// vel' = vel + dvel = vel * (1 - (||a|| * dt / ||vel||))
+		const float v_mag2 = vel[i].length2();
+		if(v_mag2 > Maths::square(1.0e-3f))
+		{
+			const float accel_mag = myMin(MAX_DRAG_ACCEL, drag_factor[i] * v_mag2);
+			vel[i] *= myMax(0.f, 1.f - accel_mag * dt / std::sqrt(v_mag2));
 
-		opengl_engine->updateObjectTransformData(*particle.gl_ob);
+			assert(vel[i].isFinite());
+		}
+	}
 
-		// NOTE: changing alpha directly in shader based on particle lifetime now.
-		//particle.gl_ob->materials[0].alpha = particle.cur_opacity;
-		//opengl_engine->updateAllMaterialDataOnGPU(*particle.gl_ob); // Since opacity changed.
+	//---------------------- Update opacity and width ----------------------
+	for(size_t i=0; i<num_particles; ++i)
+	{
+		opacity[i] += dopacity_dt[i] * dt;
+		width[i]   += dwidth_dt[i]   * dt;
+	}
 
-		if(particle.cur_opacity <= 0)
+	//---------------------- Update OpenGL objects, remove dead particles ----------------------
+	// Iterate backwards, so that when we swap a particle from the back into position i, it has already been processed.
+	// Index the arrays directly, as removeParticle() resizes them.
+	for(size_t i=num_particles; i-- > 0; )
+	{
+		GLObject* gl_ob = particle_gl_ob[i].ptr();
+		if(particle_opacity[i] <= 0)
 		{
 			//conPrint("removed particle");
-			opengl_engine->removeObject(particle.gl_ob);
+			opengl_engine->removeObject(particle_gl_ob[i]);
 
-			// Remove particle: swap with last particle in array
-			mySwap(particle, particles.back());
-			particles.pop_back(); // Now remove last array element.
-			
-			// Don't increment i as we there is a new particle in position i that we want to process.
+			removeParticle(i);
 		}
 		else
-			++i;
+		{
+			gl_ob->ob_to_world_matrix = translationMulUniformScaleMatrix(/*translation=*/particle_pos[i], /*scale=*/particle_width[i]);
+			gl_ob->ob_to_world_matrix.e[1] = particle_theta[i]; // Since object-space vert positions are just (0,0,0) for particle geometry, we can store info in the model matrix.
+
+			opengl_engine->updateObjectTransformData(*gl_ob);
+
+			// NOTE: changing alpha directly in shader based on particle lifetime now.
+		}
 	}
 
-	//conPrint("ParticleManager::think() took " + timer.elapsedStringMSWIthNSigFigs(4) + " for " + toString(particles.size()) + " particles.");
+	//conPrint("ParticleManager::think() took " + timer.elapsedStringMSWIthNSigFigs(4) + " for " + toString(particle_pos.size()) + " particles.");
 }
@@ -14,6 +14,7 @@ Copyright Glare Technologies Limited 2023 -
 #include <maths/PCG32.h>
 #include <utils/RefCounted.h>
 #include <utils/Reference.h>
+#include <utils/Vector.h>
 class OpenGLShader;
 class OpenGLMeshRenderData;
 class VertexBufferAllocator;
@@ -38,8 +39,6 @@ struct Particle
 	Vec4f pos;
 	Vec4f vel;
 
-	GLObjectRef gl_ob;
-
 	Colour3f colour;
 
 	float area; // particle cross-sectional area (m^2).  Larger area = more wind drag.  TODO: just store ratio of area to mass?
@@ -66,6 +65,20 @@ ParticleManager
 The basic idea is to simulate point particles with ray-traced collisions, and a simple physics model with 
 bouncing off surfaces and with wind resistance.
 See https://github.com/jrouwe/JoltPhysics/discussions/756 for a discussion of the approach.
+
+Particle state is stored in structure-of-arrays layout, and think() does the
+integration in separate passes over the arrays, so the passes are simple loops
+the compiler can vectorise.
+
+Collision rays are cast for a particle along its velocity over a lookahead period.
+If nothing is hit, the particle doesn't need another ray cast until the lookahead period has elapsed.
+Slow particles and particles far from the camera use a longer lookahead period (several frames), limited so that
+the deviation of the particle path from the ray due to gravity and drag is at most the particle radius.
+Before casting rays, particles are grouped into batches of consecutive particles, and the swept AABB of each
+batch is tested against the broadphase.  If it overlaps no bodies, no rays need to be cast for the batch.
+
+The number of particles is limited to max_num_particles.  When the limit is reached, new particles replace
+particles far from the camera, and new particles far from the camera are not added.
 =====================================================================*/
 class ParticleManager final : public RefCounted, public AsyncTextureLoadedHandler
 {
@@ -81,15 +94,36 @@ public:
 
 	void addParticle(const Particle& particle);
 
-	void think(float dt);
+	void think(float dt, const Vec4f& campos);
+
+	size_t getNumParticles() const { return particle_pos.size(); }
 
 private:
+	void resizeParticleArrays(size_t new_size);
+	void removeParticle(size_t i);
+
 	std::string base_dir_path;
 	OpenGLEngine* opengl_engine;
 	PhysicsWorld* physics_world;
 	TerrainDecalManager* terrain_decal_manager;
 	PCG32 rng;
-	std::vector<Particle> particles;
+
+	size_t max_num_particles;
+	Vec4f last_campos;
+
+	// Particle state, in structure-of-arrays layout.  All arrays have the same size.
+	js::Vector<Vec4f, 16> particle_pos;
+	js::Vector<Vec4f, 16> particle_vel;
+	js::Vector<float, 16> particle_drag_factor; // 0.5 * rho * C_d * area / mass.  Drag acceleration magnitude = drag_factor * ||v||^2.
+	js::Vector<float, 16> particle_restitution;
+	js::Vector<float, 16> particle_width;
+	js::Vector<float, 16> particle_dwidth_dt;
+	js::Vector<float, 16> particle_opacity;
+	js::Vector<float, 16> particle_dopacity_dt;
+	js::Vector<float, 16> particle_theta;
+	js::Vector<float, 16> particle_collision_free_time; // Time for which the particle's path is known to not hit anything.  A ray is cast when this runs out.
+	js::Vector<uint8, 16> particle_die_when_hit_surface;
+	std::vector<GLObjectRef> particle_gl_ob;
 
 	Reference<OpenGLTexture> smoke_sprite_top;
 	Reference<OpenGLTexture> smoke_sprite_bottom;
@@ -0,0 +1,432 @@
+/*=====================================================================
+PhysicsShapeCache.cpp
+---------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#include "PhysicsShapeCache.h"
+
+
+#include "PhysicsWorld.h"
+#include <FileUtils.h>
+#include <MemMappedFile.h>
+#include <BufferOutStream.h>
+#include <StringUtils.h>
+#include <ConPrint.h>
+#include <Exception.h>
+#include <Lock.h>
+#include <tracy/Tracy.hpp>
+#include <xxhash.h>
+#include <Jolt/Jolt.h>
+#include <cstring>
+
+
+static const uint32 SHAPE_FILE_MAGIC_NUMBER = 0x4850534A; // "JSPH"
+static const uint32 SHAPE_FILE_FORMAT_VERSION = 1;
+static const size_t SHAPE_FILE_HEADER_SIZE = 4 + 4 + 4 + 8 + 8;
+
+
+// Jolt binary state is only valid for the Jolt version that wrote it, so include the Jolt version in the file header.
+static uint32 joltVersion()
+{
+#ifdef JPH_VERSION_MAJOR
+	return (uint32)(JPH_VERSION_MAJOR * 10000 + JPH_VERSION_MINOR * 100 + JPH_VERSION_PATCH);
+#else
+	return 0;
+#endif
+}
+
+
+PhysicsShapeCache::PhysicsShapeCache(const std::string& cache_dir_, uint64 max_size_B_)
+:	cache_dir(cache_dir_),
+	max_size_B(max_size_B_),
+	total_size_B(0),
+	use_counter(0)
+{
+	FileUtils::createDirIfDoesNotExist(cache_dir);
+
+	Lock lock(mutex);
+
+	// Build the index of existing shape files.  Remove any temp files left over from an interrupted save.
+	const std::vector<std::string> filenames = FileUtils::getFilesInDir(cache_dir);
+	for(size_t i=0; i<filenames.size(); ++i)
+	{
+		const std::string& filename = filenames[i];
+		try
+		{
+			if(hasExtension(filename, "joltshape"))
+			{
+				CacheFileInfo info;
+				info.size_B = FileUtils::getFileSize(cache_dir + "/" + filename);
+				info.last_used = 0;
+				files[filename] = info;
+				total_size_B += info.size_B;
+			}
+			else if(hasExtension(filename, "tmp"))
+				FileUtils::deleteFile(cache_dir + "/" + filename);
+		}
+		catch(glare::Exception& e)
+		{
+			conPrint("PhysicsShapeCache: Error while scanning '" + filename + "': " + e.what());
+		}
+	}
+
+	evictToBudget(/*filename_to_keep=*/std::string());
+}
+
+
+PhysicsShapeCache::~PhysicsShapeCache()
+{}
+
+
+std::string PhysicsShapeCache::filenameForKey(const std::string& model_URL, bool dynamic) const
+{
+	const std::string key = model_URL + (dynamic ? "_dynamic" : "_static");
+	const uint64 hash = XXH64(key.data(), key.size(), /*seed=*/1);
+	return toHexString(hash) + ".joltshape";
+}
+
+
+std::string PhysicsShapeCache::pathForKey(const std::string& model_URL, bool dynamic) const
+{
+	return cache_dir + "/" + filenameForKey(model_URL, dynamic);
+}
+
+
+// Deletes the file and removes it from the index.  The file is removed from the index even if deleting it fails (e.g. if it is open in another thread on Windows),
+// in which case it will be re-added to the index next time the cache is constructed.
+void PhysicsShapeCache::removeFile(const std::string& filename)
+{
+	auto res = files.find(filename);
+	if(res != files.end())
+	{
+		assert(total_size_B >= res->second.size_B);
+		total_size_B -= res->second.size_B;
+		files.erase(res);
+	}
+
+	try
+	{
+		if(FileUtils::fileExists(cache_dir + "/" + filename))
+			FileUtils::deleteFile(cache_dir + "/" + filename);
+	}
+	catch(glare::Exception& e)
+	{
+		conPrint("PhysicsShapeCache: Failed to delete '" + filename + "': " + e.what());
+	}
+}
+
+
+// Removes least recently used files until the total size is <= max_size_B.  Doesn't remove filename_to_keep.
+void PhysicsShapeCache::evictToBudget(const std::string& filename_to_keep)
+{
+	while(total_size_B > max_size_B)
+	{
+		auto lru_it = files.end();
+		for(auto it = files.begin(); it != files.end(); ++it)
+			if(it->first != filename_to_keep && (lru_it == files.end() || it->second.last_used < lru_it->second.last_used))
+				lru_it = it;
+
+		if(lru_it == files.end()) // If only filename_to_keep is left:
+			break;
+
+		const std::string filename = lru_it->first; // Copy, as removeFile erases the entry.
+		removeFile(filename);
+		num_evicted.increment();
+	}
+}
+
+
+bool PhysicsShapeCache::tryLoadShape(const std::string& model_URL, bool dynamic, PhysicsShape& shape_out)
+{
+	ZoneScoped; // Tracy profiler
+
+	const std::string filename = filenameForKey(model_URL, dynamic);
+	const std::string path = cache_dir + "/" + filename;
+	if(!FileUtils::fileExists(path))
+	{
+		num_misses.increment();
+		return false;
+	}
+
+	try
+	{
+		MemMappedFile file(path);
+		const uint8* data = (const uint8*)file.fileData();
+		if(file.fileSize() < SHAPE_FILE_HEADER_SIZE)
+			throw glare::Exception("file too small");
+
+		uint32 magic, version, jolt_version;
+		uint64 shape_data_size, shape_data_hash;
+		std::memcpy(&magic,				data + 0,  4);
+		std::memcpy(&version,			data + 4,  4);
+		std::memcpy(&jolt_version,		data + 8,  4);
+		std::memcpy(&shape_data_size,	data + 12, 8);
+		std::memcpy(&shape_data_hash,	data + 20, 8);
+
+		if(magic != SHAPE_FILE_MAGIC_NUMBER || version != SHAPE_FILE_FORMAT_VERSION || jolt_version != joltVersion())
+			throw glare::Exception("invalid header or version");
+		if(shape_data_size != file.fileSize() - SHAPE_FILE_HEADER_SIZE)
+			throw glare::Exception("invalid shape data size");
+		if(XXH64(data + SHAPE_FILE_HEADER_SIZE, shape_data_size, /*seed=*/1) != shape_data_hash)
+			throw glare::Exception("shape data hash mismatch");
+
+		const std::string shape_data((const char*)data + SHAPE_FILE_HEADER_SIZE, shape_data_size);
+		shape_out = PhysicsWorld::deserialiseShape(shape_data);
+	}
+	catch(glare::Exception& e)
+	{
+		conPrint("PhysicsShapeCache: Failed to load '" + path + "': " + e.what() + ", removing.");
+		{
+			Lock lock(mutex);
+			removeFile(filename);
+		}
+		num_misses.increment();
+		return false;
+	}
+
+	{
+		Lock lock(mutex);
+		auto res = files.find(filename);
+		if(res != files.end())
+			res->second.last_used = ++use_counter;
+	}
+
+	num_hits.increment();
+	return true;
+}
+
+
+void PhysicsShapeCache::saveShape(const std::string& model_URL, bool dynamic, const PhysicsShape& shape)
+{
+	ZoneScoped; // Tracy profiler
+
+	if(shape.size_B < MIN_SHAPE_SIZE_B)
+		return;
+
+	const std::string filename = filenameForKey(model_URL, dynamic);
+	const std::string path = cache_dir + "/" + filename;
+	try
+	{
+		std::string shape_data;
+		PhysicsWorld::serialiseShape(shape, shape_data);
+
+		BufferOutStream out;
+		out.writeUInt32(SHAPE_FILE_MAGIC_NUMBER);
+		out.writeUInt32(SHAPE_FILE_FORMAT_VERSION);
+		out.writeUInt32(joltVersion());
+		out.writeUInt64(shape_data.size());
+		out.writeUInt64(XXH64(shape_data.data(), shape_data.size(), /*seed=*/1));
+		out.writeData(shape_data.data(), shape_data.size());
+
+		// Write to a temp file then move, so other threads never see a partially written file.
+		const std::string temp_path = path + "_" + toString(next_temp_file_id.increment()) + ".tmp";
+		FileUtils::writeEntireFile(temp_path, (const char*)out.buf.data(), out.buf.size());
+		FileUtils::moveFile(temp_path, path);
+
+		num_saved.increment();
+
+		Lock lock(mutex);
+		CacheFileInfo& info = files[filename]; // May replace an existing file for the same key.
+		total_size_B -= info.size_B;
+		info.size_B = out.buf.size();
+		info.last_used = ++use_counter;
+		total_size_B += info.size_B;
+
+		evictToBudget(/*filename_to_keep=*/filename);
+	}
+	catch(glare::Exception& e)
+	{
+		conPrint("PhysicsShapeCache: Failed to save '" + path + "': " + e.what());
+	}
+}
+
+
+uint64 PhysicsShapeCache::getTotalSizeB() const
+{
+	Lock lock(mutex);
+	return total_size_B;
+}
+
+
+std::string PhysicsShapeCache::getDiagnostics() const
+{
+	return "Physics shape cache: hits: " + toString(num_hits) + ", misses: " + toString(num_misses) + ", saved: " + toString(num_saved) + ", evicted: " + toString(num_evicted) +
+		", size: " + getMBSizeString(getTotalSizeB()) + " / " + getMBSizeString(max_size_B) + "\n";
+}
+
+
+#if BUILD_TESTS
+
+
+#include <dll/include/IndigoMesh.h>
+#include <utils/TestUtils.h>
+#include <utils/PlatformUtils.h>
+
+
+// Makes a flat grid mesh in the z=0 plane, from (0,0) to (res, res), with the triangle material index set to the cell index.
+static Indigo::MeshRef makeTestGridMesh(int res)
+{
+	Indigo::MeshRef mesh = new Indigo::Mesh();
+	for(int y=0; y<=res; ++y)
+	for(int x=0; x<=res; ++x)
+		mesh->vert_positions.push_back(Indigo::Vec3f((float)x, (float)y, 0.f));
+
+	for(int y=0; y<res; ++y)
+	for(int x=0; x<res; ++x)
+	{
+		const uint32 v0 = y * (res + 1) + x;
+		const uint32 v1 = v0 + 1;
+		const uint32 v2 = v0 + res + 1;
+		const uint32 v3 = v2 + 1;
+
+		Indigo::Triangle tri;
+		tri.uv_indices[0] = tri.uv_indices[1] = tri.uv_indices[2] = 0;
+		tri.tri_mat_index = y * res + x;
+
+		tri.vertex_indices[0] = v0; tri.vertex_indices[1] = v1; tri.vertex_indices[2] = v3;
+		mesh->triangles.push_back(tri);
+		tri.vertex_indices[0] = v0; tri.vertex_indices[1] = v3; tri.vertex_indices[2] = v2;
+		mesh->triangles.push_back(tri);
+	}
+	return mesh;
+}
+
+
+static bool AABBsEqual(const js::AABBox& a, const js::AABBox& b)
+{
+	for(int i=0; i<3; ++i)
+		if(a.min_[i] != b.min_[i] || a.max_[i] != b.max_[i])
+			return false;
+	return true;
+}
+
+
+void PhysicsShapeCache::test()
+{
+	conPrint("PhysicsShapeCache::test()");
+
+	// PhysicsWorld::init() needs to have been called already.
+
+	try
+	{
+		const std::string dir = PlatformUtils::getTempDirPath() + "/physics_shape_cache_test";
+		FileUtils::createDirIfDoesNotExist(dir);
+		{
+			const std::vector<std::string> filenames = FileUtils::getFilesInDir(dir);
+			for(size_t i=0; i<filenames.size(); ++i)
+				FileUtils::deleteFile(dir + "/" + filenames[i]);
+		}
+
+		Indigo::MeshRef mesh = makeTestGridMesh(/*res=*/100);
+
+		const PhysicsShape static_shape  = PhysicsWorld::createJoltShapeForIndigoMesh(*mesh, /*build_dynamic_physics_ob=*/false);
+		const PhysicsShape box_shape = PhysicsWorld::createGroundQuadShape(/*ground_quad_w=*/10.f);
+		testAssert(static_shape.size_B >= MIN_SHAPE_SIZE_B);
+
+		// Test serialisation round trip
+		{
+			std::string data;
+			PhysicsWorld::serialiseShape(static_shape, data);
+			const PhysicsShape restored = PhysicsWorld::deserialiseShape(data);
+			testAssert(AABBsEqual(restored.getAABBOS(), static_shape.getAABBOS()));
+			testAssert(restored.size_B == static_shape.size_B);
+		}
+
+		{
+			PhysicsShapeCache cache(dir, DEFAULT_MAX_SIZE_B);
+
+			PhysicsShape shape;
+			testAssert(!cache.tryLoadShape("grid.bmesh", /*dynamic=*/false, shape));
+
+			cache.saveShape("grid.bmesh", /*dynamic=*/false, static_shape);
+			cache.saveShape("box.bmesh", /*dynamic=*/false, box_shape); // Box shape is small, so shouldn't be saved.
+			testAssert(cache.num_saved == 1);
+
+			testAssert(cache.tryLoadShape("grid.bmesh", /*dynamic=*/false, shape));
+			testAssert(AABBsEqual(shape.getAABBOS(), static_shape.getAABBOS()));
+			testAssert(shape.jolt_shape->GetSubType() == static_shape.jolt_shape->GetSubType());
+
+			testAssert(!cache.tryLoadShape("grid.bmesh", /*dynamic=*/true, shape)); // Dynamic flag is part of the key.
+			testAssert(!cache.tryLoadShape("box.bmesh", /*dynamic=*/false, shape));
+		}
+
+		// Test that a cached shape is found by a new cache object, and that a corrupted file is detected and removed.
+		{
+			PhysicsShapeCache cache(dir, DEFAULT_MAX_SIZE_B);
+
+			PhysicsShape shape;
+			testAssert(cache.tryLoadShape("grid.bmesh", /*dynamic=*/false, shape));
+
+			const std::string path = cache.pathForKey("grid.bmesh", /*dynamic=*/false);
+			const uint64 file_size = FileUtils::getFileSize(path);
+			std::string contents(file_size, '\0');
+			{
+				MemMappedFile file(path);
+				std::memcpy(&contents[0], file.fileData(), file_size);
+			}
+			contents[file_size / 2] ^= 0xFF;
+			FileUtils::writeEntireFile(path, contents);
+
+			testAssert(!cache.tryLoadShape("grid.bmesh", /*dynamic=*/false, shape));
+			testAssert(!FileUtils::fileExists(path));
+			testAssert(cache.getTotalSizeB() == 0);
+		}
+
+		// Test eviction of least recently used files when over budget
+		{
+			uint64 file_size;
+			{
+				PhysicsShapeCache cache(dir, DEFAULT_MAX_SIZE_B);
+				cache.saveShape("a.bmesh", /*dynamic=*/false, static_shape);
+				file_size = cache.getTotalSizeB();
+				testAssert(file_size > 0);
+				testAssert(FileUtils::getFileSize(cache.pathForKey("a.bmesh", /*dynamic=*/false)) == file_size);
+			}
+
+			// Existing files should be added to the index on construction.
+			PhysicsShapeCache cache(dir, /*max size=*/file_size * 5 / 2);
+			testAssert(cache.getTotalSizeB() == file_size);
+
+			PhysicsShape shape;
+			cache.saveShape("b.bmesh", /*dynamic=*/false, static_shape);
+			testAssert(cache.getTotalSizeB() == file_size * 2);
+			testAssert(cache.tryLoadShape("a.bmesh", /*dynamic=*/false, shape)); // Use a, so b is least recently used.
+
+			cache.saveShape("c.bmesh", /*dynamic=*/false, static_shape);
+			testAssert(cache.getTotalSizeB() == file_size * 2);
+			testAssert(cache.num_evicted == 1);
+			testAssert(!FileUtils::fileExists(cache.pathForKey("b.bmesh", /*dynamic=*/false)));
+			testAssert(cache.tryLoadShape("a.bmesh", /*dynamic=*/false, shape));
+			testAssert(cache.tryLoadShape("c.bmesh", /*dynamic=*/false, shape));
+
+			// Saving the same key again should replace the file, not add to the total size.
+			cache.saveShape("c.bmesh", /*dynamic=*/false, static_shape);
+			testAssert(cache.getTotalSizeB() == file_size * 2);
+
+			// A new cache with a smaller budget should evict files on construction.
+			{
+				PhysicsShapeCache small_cache(dir, /*max size=*/file_size * 3 / 2);
+				testAssert(small_cache.getTotalSizeB() == file_size);
+				testAssert(FileUtils::getFilesInDir(dir).size() == 1);
+			}
+
+			// A file larger than the budget should still be kept after saving it.
+			{
+				PhysicsShapeCache tiny_cache(dir, /*max size=*/1);
+				testAssert(tiny_cache.getTotalSizeB() == 0);
+				tiny_cache.saveShape("d.bmesh", /*dynamic=*/false, static_shape);
+				testAssert(tiny_cache.getTotalSizeB() == file_size);
+				testAssert(tiny_cache.tryLoadShape("d.bmesh", /*dynamic=*/false, shape));
+			}
+		}
+	}
+	catch(glare::Exception& e)
+	{
+		failTest(e.what());
+	}
+
+	conPrint("PhysicsShapeCache::test() done.");
+}
+
+
+#endif // BUILD_TESTS
@@ -0,0 +1,92 @@
+/*=====================================================================
+PhysicsShapeCache.h
+-------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#pragma once
+
+
+#include "PhysicsObject.h"
+#include <ThreadSafeRefCounted.h>
+#include <Reference.h>
+#include <AtomicInt.h>
+#include <Mutex.h>
+#include <string>
+#include <unordered_map>
+
+
+/*=====================================================================
+PhysicsShapeCache
+-----------------
+On-disk cache of built Jolt shapes, keyed by model URL and whether the
+shape was built for a dynamic object (convex hull) or static object (mesh shape).
+
+Building a mesh shape requires building a BVH over the triangles, which is a large
+part of the cost of loading a model.  Restoring the shape from the serialised
+binary state skips this.
+
+Each shape is stored in its own file, named by a hash of the key.
+Files contain a header with a format version (which includes the Jolt version, since the
+binary state format is Jolt-version specific), and a hash of the shape data, so stale or
+corrupted files are detected and ignored.
+
+Only shapes with size >= MIN_SHAPE_SIZE_B are cached, for small shapes building is fast enough.
+
+The total size of the cache files is kept <= max_size_B, by removing least recently used files when a shape is saved.
+Recency is only tracked in memory, files already in the cache dir when the cache is constructed are treated as
+less recently used than any file used since.
+
+Threadsafe.
+=====================================================================*/
+class PhysicsShapeCache : public ThreadSafeRefCounted
+{
+public:
+	// Throws glare::Exception if the cache dir could not be created.
+	// If the files already in the cache dir total more than max_size_B, least recently used files are removed.
+	PhysicsShapeCache(const std::string& cache_dir, uint64 max_size_B);
+	~PhysicsShapeCache();
+
+	static const size_t MIN_SHAPE_SIZE_B = 64 * 1024;
+	static const uint64 DEFAULT_MAX_SIZE_B = 1024 * 1024 * 1024;
+
+	// Returns true if a valid cached shape was found, in which case shape_out is set.
+	bool tryLoadShape(const std::string& model_URL, bool dynamic, PhysicsShape& shape_out);
+
+	// Saves the shape to the cache, if it is large enough to be worth caching.  Errors are logged, not thrown.
+	void saveShape(const std::string& model_URL, bool dynamic, const PhysicsShape& shape);
+
+	std::string getDiagnostics() const;
+
+	static void test();
+
+	uint64 getTotalSizeB() const;
+
+private:
+	std::string filenameForKey(const std::string& model_URL, bool dynamic) const;
+	std::string pathForKey(const std::string& model_URL, bool dynamic) const;
+	void removeFile(const std::string& filename) REQUIRES(mutex);
+	void evictToBudget(const std::string& filename_to_keep) REQUIRES(mutex);
+
+	struct CacheFileInfo
+	{
+		uint64 size_B;
+		uint64 last_used; // Value of use_counter when last loaded or saved.  0 if not used since the cache was constructed.
+	};
+
+	std::string cache_dir;
+	uint64 max_size_B;
+
+	mutable Mutex mutex;
+	std::unordered_map<std::string, CacheFileInfo> files	GUARDED_BY(mutex); // Map from filename to info, for all shape files in the cache dir.
+	uint64 total_size_B										GUARDED_BY(mutex);
+	uint64 use_counter										GUARDED_BY(mutex);
+
+	glare::AtomicInt num_hits;
+	glare::AtomicInt num_misses;
+	glare::AtomicInt num_saved;
+	glare::AtomicInt num_evicted;
+	glare::AtomicInt next_temp_file_id;
+};
+
+
+typedef Reference<PhysicsShapeCache> PhysicsShapeCacheRef;
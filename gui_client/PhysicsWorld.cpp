@@ -52,10 +52,12 @@ Copyright Glare Technologies Limited 2022 -
 #include <Jolt/Physics/Collision/BroadPhase/BroadPhaseQuery.h>
 #include <Jolt/Physics/Collision/RayCast.h>
 #include <Jolt/Physics/Collision/CastResult.h>
+#include <Jolt/Physics/Collision/CollisionCollectorImpl.h>
 #include <Jolt/Physics/Collision/Shape/OffsetCenterOfMassShape.h>
 #endif
 #include <HashSet.h>
 #include <fstream>
+#include <sstream>
 
 
 #if USE_JOLT
@@ -1668,6 +1670,52 @@ bool PhysicsWorld::doesRayHitAnything(const Vec4f& origin, const Vec4f& dir, flo
 }
 
 
+bool PhysicsWorld::doesAABBOverlapAnyBody(const js::AABBox& aabb) const
+{
+	const JPH::AABox box(toJoltVec3(aabb.min_), toJoltVec3(aabb.max_));
+	JPH::AnyHitCollisionCollector<JPH::CollideShapeBodyCollector> collector;
+	this->physics_system->GetBroadPhaseQuery().CollideAABox(box, collector);
+	return collector.HadHit();
+}
+
+
+void PhysicsWorld::serialiseShape(const PhysicsShape& shape, std::string& data_out)
+{
+	ZoneScoped; // Tracy profiler
+
+	std::stringstream stream(std::ios::out | std::ios::binary);
+	JPH::StreamOutWrapper wrapper(stream);
+
+	JPH::Shape::ShapeToIDMap shape_to_id;
+	JPH::Shape::MaterialToIDMap material_to_id;
+	shape.jolt_shape->SaveWithChildren(wrapper, shape_to_id, material_to_id);
+	if(wrapper.IsFailed())
+		throw glare::Exception("Failed to serialise Jolt shape");
+
+	data_out = stream.str();
+}
+
+
+PhysicsShape PhysicsWorld::deserialiseShape(const std::string& data)
+{
+	ZoneScoped; // Tracy profiler
+
+	std::stringstream stream(data, std::ios::in | std::ios::binary);
+	JPH::StreamInWrapper wrapper(stream);
+
+	JPH::Shape::IDToShapeMap id_to_shape;
+	JPH::Shape::IDToMaterialMap id_to_material;
+	JPH::Shape::ShapeResult result = JPH::Shape::sRestoreWithChildren(wrapper, id_to_shape, id_to_material);
+	if(result.HasError())
+		throw glare::Exception(std::string("Failed to restore Jolt shape: ") + result.GetError().c_str());
+
+	PhysicsShape shape;
+	shape.jolt_shape = result.Get();
+	shape.size_B = computeSizeBForShape(shape.jolt_shape);
+	return shape;
+}
+
+
 void PhysicsWorld::writeJoltSnapshotToDisk(const std::string& path)
 {
 	// Convert physics system to scene
@@ -131,6 +131,11 @@ public:
 
 	static PhysicsShape createScaledAndTranslatedShapeForShape(const PhysicsShape& shape, const Vec3f& translation, const Vec3f& scale);
 
+	// Serialises the shape (including any sub-shapes and materials) with Jolt's binary state format.  Throws glare::Exception on failure.
+	static void serialiseShape(const PhysicsShape& shape, std::string& data_out);
+	// Restores a shape serialised with serialiseShape().  Throws glare::Exception on failure.
+	static PhysicsShape deserialiseShape(const std::string& data);
+
 	void think(double dt);
 
 #if USE_JOLT
@@ -174,6 +179,9 @@ public:
 
 	bool doesRayHitAnything(const Vec4f& origin, const Vec4f& dir, float max_t) const;
 
+	// Returns true if the AABB overlaps the bounding box of any body in the broadphase.  Much cheaper than a ray cast, so can be used to skip ray casts.
+	bool doesAABBOverlapAnyBody(const js::AABBox& aabb) const;
+
 	void writeJoltSnapshotToDisk(const std::string& path);
 
 	static void test();
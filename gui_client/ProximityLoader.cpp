@@ -61,37 +61,7 @@ void ProximityLoader::setLoadDistance(float new_load_distance)
 	for(int y = upper_begin[1]; y <= upper_end[1]; ++y)
 	for(int x = upper_begin[0]; x <= upper_end[0]; ++x)
 	{
-		// NOTE: this code was too slow with lots of objects (e.g. CV world) and large view distances (e.g. 2km), so disabled for now.
-
-
-	//	const HashedObGridBucket& bucket = ob_grid.getBucketForIndices(x, y, z);
-	//	for(auto it = bucket.objects.begin(); it != bucket.objects.end(); ++it)
-	//	{
-	//		WorldObject* ob = it->ptr();
-	//		const float dist2 = ob->pos.toVec4fPoint().getDist2(last_cam_pos);
-	//		const float ob_load_dist2 = myMin(ob->max_load_dist2, load_distance2);
-	//
-	//		if(dist2 > ob_load_dist2) // If object is (now) outside of loading distance
-	//		{
-	//			if(ob->in_proximity)
-	//			{
-	//				ob->in_proximity = false;
-	//				//conPrint("setLoadDistance(): Unloading object " + ob->uid.toString());
-	//				callbacks->unloadObject(ob);
-	//			}
-	//		}
-	//		else // If object is (now) inside of loading distance
-	//		{
-	//			if(!ob->in_proximity)
-	//			{
-	//				ob->in_proximity = true;
-	//				//conPrint("setLoadDistance(): Unloading object " + ob->uid.toString());
-	//				callbacks->loadObject(ob);
-	//			}
-	//		}
-	//	}
-
-		//old_cells.insert(Vec3<int>(x, y, z));
+		// NOTE: loading and unloading individual objects here was too slow with lots of objects (e.g. CV world) and large view distances (e.g. 2km), so is disabled for now.
 
 		const Vec3<int> cell_coords(x, y, z);
 		const bool is_in_new_cells =
@@ -115,30 +85,12 @@ void ProximityLoader::setLoadDistance(float new_load_distance)
 void ProximityLoader::checkAddObject(WorldObjectRef ob)
 {
 	if(VERBOSE) conPrint("ProximityLoader:checkAddObject(): Adding ob " + ob->uid.toString() + " at " + ob->pos.toString());
-
-	//ob_grid.insert(ob); // Add to set if not already added.
-	//
-	//const float ob_load_dist2 = myMin(ob->max_load_dist2, load_distance2);
-	//
-	//const float dist2 = ob->pos.toVec4fPoint().getDist2(last_cam_pos);
-	//if(dist2 <= ob_load_dist2) // If object is inside of loading distance:
-	//{
-	//	if(!ob->in_proximity)
-	//	{
-	//		ob->in_proximity = true;
-	//		callbacks->loadObject(ob);
-	//	}
-	//}
 }
 
 
 void ProximityLoader::removeObject(WorldObjectRef ob)
 {
-	//conPrint("ProximityLoader:removeObject(): Removing ob " + ob->uid.toString());
-
-	//callbacks->unloadObject(ob);
-	//
-	//ob_grid.remove(ob);
+	if(VERBOSE) conPrint("ProximityLoader:removeObject(): Removing ob " + ob->uid.toString());
 }
 
 
@@ -148,37 +100,9 @@ void ProximityLoader::clearAllObjects()
 }
 
 
-void ProximityLoader::objectTransformChanged(WorldObject* ob)
+void ProximityLoader::objectTransformChanged(WorldObject* /*ob*/)
 {
-	// See if the object has changed grid cells
-	//const Vec4i old_cell = ob_grid.bucketIndicesForPoint(ob->last_pos.toVec4fPoint());
-	//const Vec4i new_cell = ob_grid.bucketIndicesForPoint(ob->pos.toVec4fPoint());
-	//
-	//if(old_cell != new_cell)
-	//{
-	//	if(VERBOSE) conPrint("Cell changed!");
-	//
-	//	// Remove from old grid cell
-	//	ob_grid.removeAtLastPos(ob);
-	//
-	//	// Add to new grid cell
-	//	ob_grid.insert(ob);
-	//}
-	//
-	//// Check for moving in/out of load distance.
-	//const float ob_load_dist2 = myMin(ob->max_load_dist2, load_distance2);
-	//const bool old_in_load_dist = ob->last_pos.toVec4fPoint().getDist2(last_cam_pos) <= ob_load_dist2;
-	//const bool new_in_load_dist = ob->pos     .toVec4fPoint().getDist2(last_cam_pos) <= ob_load_dist2;
-	//if(old_in_load_dist && !new_in_load_dist) // If object has moved out of load distance:
-	//{
-	//	ob->in_proximity = false;
-	//	callbacks->unloadObject(ob);
-	//}
-	//else if(!old_in_load_dist && new_in_load_dist) // If object has moved into load distance:
-	//{
-	//	ob->in_proximity = true;
-	//	callbacks->loadObject(ob);
-	//}
+	// Per-object loading is disabled, so there is nothing to update.
 }
 
 
@@ -188,45 +112,11 @@ void ProximityLoader::updateCamPos(const Vec4f& new_cam_pos)
 	{
 		//conPrint("ProximityLoader: walking grid cells, new_cam_pos: " + new_cam_pos.toStringNSigFigs(3));
 
-		// Iterate over grid cells around last_cam_pos
-		// Unload any objects outside of load_distance of new_cam_pos
+		// Work out the grid cells around last_cam_pos
 		const Vec4i old_begin = ob_grid.bucketIndicesForPoint(last_cam_pos - Vec4f(load_distance, load_distance, load_distance, 0));
 		const Vec4i old_end   = ob_grid.bucketIndicesForPoint(last_cam_pos + Vec4f(load_distance, load_distance, load_distance, 0));
-		//{
-		//	int num_iters = 0;
-		//	int num_obs_tested = 0;
-		//	for(int z = old_begin[2]; z <= old_end[2]; ++z)
-		//	for(int y = old_begin[1]; y <= old_end[1]; ++y)
-		//	for(int x = old_begin[0]; x <= old_end[0]; ++x)
-		//	{
-		//		const HashedObGridBucket& bucket = ob_grid.getBucketForIndices(x, y, z);
-		//		for(auto it = bucket.objects.begin(); it != bucket.objects.end(); ++it)
-		//		{
-		//			WorldObject* ob = it->ptr();
-		//			const float new_dist2 = ob->pos.toVec4fPoint().getDist2(new_cam_pos);
-		//			const float ob_load_dist2 = myMin(ob->max_load_dist2, load_distance2);
-		//			if(new_dist2 > ob_load_dist2) // If object is now outside of loading distance
-		//			{
-		//				if(ob->in_proximity)
-		//				{
-		//					ob->in_proximity = false;
-		//					if(VERBOSE) conPrint("ProximityLoader: Unloading object " + ob->uid.toString());
-		//					callbacks->unloadObject(ob);
-		//				}
-		//			}
-		//			num_obs_tested++;
-		//		}
-		//
-		//		//old_cells.insert(Vec3<int>(x, y, z));
-		//
-		//		num_iters++;
-		//	}
-		//	printVar(num_iters);
-		//	printVar(num_obs_tested);
-		//}
-
-		// Iterate over grid cells around new_cam_pos
-		// Load any objects inside of load_distance of new_cam_pos
+
+		// Iterate over grid cells around new_cam_pos, calling newCellInProximity() for any cells that were not around last_cam_pos.
 		{
 			const Vec4i begin = ob_grid.bucketIndicesForPoint(new_cam_pos - Vec4f(load_distance, load_distance, load_distance, 0));
 			const Vec4i end   = ob_grid.bucketIndicesForPoint(new_cam_pos + Vec4f(load_distance, load_distance, load_distance, 0));
@@ -235,23 +125,6 @@ void ProximityLoader::updateCamPos(const Vec4f& new_cam_pos)
 			for(int y = begin[1]; y <= end[1]; ++y)
 			for(int x = begin[0]; x <= end[0]; ++x)
 			{
-				//const HashedObGridBucket& bucket = ob_grid.getBucketForIndices(x, y, z);
-				//for(auto it = bucket.objects.begin(); it != bucket.objects.end(); ++it)
-				//{
-				//	WorldObject* ob = it->ptr();
-				//	const float new_dist2 = ob->pos.toVec4fPoint().getDist2(new_cam_pos);
-				//	const float ob_load_dist2 = myMin(ob->max_load_dist2, load_distance2);
-				//	if(new_dist2 <= ob_load_dist2) // If object is now inside of loading distance
-				//	{
-				//		if(!ob->in_proximity)
-				//		{
-				//			if(VERBOSE) conPrint("ProximityLoader: Loading object " + ob->uid.toString());
-				//			ob->in_proximity = true;
-				//			callbacks->loadObject(ob);
-				//		}
-				//	}
-				//}
-
 				const Vec3<int> cell_coords(x, y, z);
 				const bool is_in_old_cells =
 					x >= old_begin[0] && y >= old_begin[1] && z >= old_begin[2] &&
@@ -271,19 +144,8 @@ void ProximityLoader::updateCamPos(const Vec4f& new_cam_pos)
 
 std::string ProximityLoader::getDiagnostics() const
 {
-	size_t num_obs = 0;
+	const size_t num_obs = ob_grid.numObjects();
 	size_t num_in_proximity_obs = 0;
-	for(size_t i=0; i<ob_grid.buckets.size(); ++i)
-	{
-		for(auto it = ob_grid.buckets[i].objects.begin(); it != ob_grid.buckets[i].objects.end(); ++it)
-		{
-			//const WorldObject* ob = it->ptr();
-
-			num_obs++;
-			//if(ob->in_proximity)
-			//	num_in_proximity_obs++;
-		}
-	}
 
 	return "Obs: " + toString(num_obs) + " (in proximity: " + toString(num_in_proximity_obs) + ", out of proximity: " + toString(num_obs - num_in_proximity_obs) + ")";
 }
@@ -0,0 +1,118 @@
+/*=====================================================================
+ResourceDownloadStats.cpp
+-------------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#include "ResourceDownloadStats.h"
+
+
+#include <utils/Lock.h>
+#include <utils/StringUtils.h>
+
+
+ResourceDownloadStats::ResourceDownloadStats()
+:	total_bytes_received(0),
+	total_resources_downloaded(0),
+	total_time_to_complete(0),
+	next_recent_download_i(0),
+	bytes_at_last_diagnostics(0)
+{}
+
+
+ResourceDownloadStats::~ResourceDownloadStats()
+{}
+
+
+void ResourceDownloadStats::bytesReceived(uint64 num_bytes)
+{
+	Lock lock(mutex);
+	if(total_bytes_received == 0)
+		time_since_first_byte.reset();
+	total_bytes_received += num_bytes;
+}
+
+
+void ResourceDownloadStats::resourceDownloaded(const std::string& URL, uint64 size_B, double time_to_complete)
+{
+	Lock lock(mutex);
+
+	total_resources_downloaded++;
+	total_time_to_complete += time_to_complete;
+
+	CompletedDownload download;
+	download.URL = URL;
+	download.size_B = size_B;
+	download.time_to_complete = time_to_complete;
+
+	if(recent_downloads.size() < NUM_RECENT_DOWNLOADS)
+		recent_downloads.push_back(download);
+	else
+		recent_downloads[next_recent_download_i] = download;
+	next_recent_download_i = (next_recent_download_i + 1) % NUM_RECENT_DOWNLOADS;
+}
+
+
+uint64 ResourceDownloadStats::getTotalBytesReceived()
+{
+	Lock lock(mutex);
+	return total_bytes_received;
+}
+
+
+uint64 ResourceDownloadStats::getTotalResourcesDownloaded()
+{
+	Lock lock(mutex);
+	return total_resources_downloaded;
+}
+
+
+void ResourceDownloadStats::connectionStatsUpdated(int connection_index, double bandwidth_B_per_s, double rtt_s, size_t batch_size)
+{
+	Lock lock(mutex);
+
+	if((size_t)connection_index >= connection_stats.size())
+		connection_stats.resize(connection_index + 1, ConnectionStats());
+
+	connection_stats[connection_index].bandwidth_B_per_s = bandwidth_B_per_s;
+	connection_stats[connection_index].rtt_s = rtt_s;
+	connection_stats[connection_index].batch_size = batch_size;
+}
+
+
+std::string ResourceDownloadStats::getDiagnostics()
+{
+	Lock lock(mutex);
+
+	const double elapsed = time_since_last_diagnostics.elapsed();
+	const double recent_throughput = (elapsed > 0) ? (double)(total_bytes_received - bytes_at_last_diagnostics) / elapsed : 0.0;
+	time_since_last_diagnostics.reset();
+	bytes_at_last_diagnostics = total_bytes_received;
+
+	const double total_elapsed = time_since_first_byte.elapsed();
+
+	std::string s;
+	s += "Total downloaded:         " + getNiceByteSize(total_bytes_received) + " (" + toString(total_resources_downloaded) + " resources)\n";
+	s += "Recent throughput:        " + doubleToStringNSigFigs(recent_throughput * 8.0e-6, 3) + " Mb/s\n";
+	if(total_bytes_received > 0 && total_elapsed > 0)
+		s += "Mean throughput:          " + doubleToStringNSigFigs((double)total_bytes_received / total_elapsed * 8.0e-6, 3) + " Mb/s\n";
+	if(total_resources_downloaded > 0)
+		s += "Mean time to complete:    " + doubleToStringNSigFigs(total_time_to_complete / total_resources_downloaded * 1.0e3, 3) + " ms\n";
+
+	for(size_t i=0; i<connection_stats.size(); ++i)
+		s += "Connection " + toString(i) + ": bandwidth: " + doubleToStringNSigFigs(connection_stats[i].bandwidth_B_per_s * 8.0e-6, 3) + " Mb/s, RTT: " + 
+			doubleToStringNSigFigs(connection_stats[i].rtt_s * 1.0e3, 3) + " ms, batch size: " + toString(connection_stats[i].batch_size) + "\n";
+
+	if(!recent_downloads.empty())
+	{
+		s += "Recent downloads:\n";
+		// Iterate from most recent to oldest
+		for(size_t z=0; z<recent_downloads.size(); ++z)
+		{
+			const size_t i = (next_recent_download_i + NUM_RECENT_DOWNLOADS - 1 - z) % NUM_RECENT_DOWNLOADS;
+			if(i < recent_downloads.size())
+				s += "  " + recent_downloads[i].URL + ": " + getNiceByteSize(recent_downloads[i].size_B) + ", " + doubleToStringNSigFigs(recent_downloads[i].time_to_complete * 1.0e3, 3) + " ms\n";
+		}
+	}
+
+	return s;
+}
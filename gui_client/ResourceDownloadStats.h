@@ -0,0 +1,69 @@
+/*=====================================================================
+ResourceDownloadStats.h
+-----------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#pragma once
+
+
+#include <utils/Mutex.h>
+#include <utils/Timer.h>
+#include <string>
+#include <vector>
+
+
+/*=====================================================================
+ResourceDownloadStats
+---------------------
+Download statistics shared between the DownloadResourcesThreads, for display in the diagnostics widget.
+Threadsafe.
+=====================================================================*/
+class ResourceDownloadStats
+{
+public:
+	ResourceDownloadStats();
+	~ResourceDownloadStats();
+
+	void bytesReceived(uint64 num_bytes);
+
+	// time_to_complete is the time from when the request for the resource was sent, to when the resource was completely written to disk.
+	void resourceDownloaded(const std::string& URL, uint64 size_B, double time_to_complete);
+
+	// Called by each connection when it recomputes its batch size.
+	void connectionStatsUpdated(int connection_index, double bandwidth_B_per_s, double rtt_s, size_t batch_size);
+
+	std::string getDiagnostics();
+
+	uint64 getTotalBytesReceived();
+	uint64 getTotalResourcesDownloaded();
+
+private:
+	struct CompletedDownload
+	{
+		std::string URL;
+		uint64 size_B;
+		double time_to_complete;
+	};
+
+	struct ConnectionStats
+	{
+		double bandwidth_B_per_s;
+		double rtt_s;
+		size_t batch_size;
+	};
+
+	static const size_t NUM_RECENT_DOWNLOADS = 8;
+
+	Mutex mutex;
+	uint64 total_bytes_received						GUARDED_BY(mutex);
+	uint64 total_resources_downloaded				GUARDED_BY(mutex);
+	double total_time_to_complete					GUARDED_BY(mutex);
+	std::vector<CompletedDownload> recent_downloads	GUARDED_BY(mutex); // Circular buffer
+	size_t next_recent_download_i					GUARDED_BY(mutex);
+	std::vector<ConnectionStats> connection_stats	GUARDED_BY(mutex);
+
+	// For computing throughput since the last getDiagnostics() call.
+	Timer time_since_last_diagnostics				GUARDED_BY(mutex);
+	uint64 bytes_at_last_diagnostics				GUARDED_BY(mutex);
+	Timer time_since_first_byte						GUARDED_BY(mutex);
+};
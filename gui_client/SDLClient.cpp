@@ -10,6 +10,7 @@ Copyright Glare Technologies Limited 2024 -
 #include "SDLSettingsStore.h"
 #include "TestSuite.h"
 #include "URLParser.h"
+#include "ClientBenchmark.h"
 #include <maths/GeometrySampling.h>
 #include <graphics/FormatDecoderGLTF.h>
 #include <graphics/MeshSimplification.h>
@@ -143,6 +144,13 @@ static std::vector<float> mem_usage_values;
 
 static bool show_imgui_info_window = false;
 
+static ClientBenchmark* benchmark = NULL; // Non-null if running in benchmark mode.
+static std::string benchmark_output_path;
+
+static std::string record_camera_path_path; // Non-empty if recording a camera path for use with --benchmark.
+static std::string recorded_camera_path;
+static double last_camera_keyframe_time = -1;
+
 
 #if EMSCRIPTEN
 
@@ -206,6 +214,13 @@ int main(int argc, char** argv)
 		syntax["--testscreenshot"] = std::vector<ArgumentParser::ArgumentType>(); // Test screenshot taking
 		syntax["--no_MDI"] = std::vector<ArgumentParser::ArgumentType>(); // Disable MDI in graphics engine
 		syntax["--no_bindless"] = std::vector<ArgumentParser::ArgumentType>(); // Disable bindless textures in graphics engine
+		syntax["--benchmark"] = std::vector<ArgumentParser::ArgumentType>(1, ArgumentParser::ArgumentType_string); // Run benchmark, flying along the given camera path file.
+		syntax["--benchmark_output"] = std::vector<ArgumentParser::ArgumentType>(1, ArgumentParser::ArgumentType_string); // Path to write benchmark results JSON to.  Printed to stdout if not given.
+		syntax["--benchmark_max_time"] = std::vector<ArgumentParser::ArgumentType>(1, ArgumentParser::ArgumentType_string); // Max benchmark time in seconds.
+		syntax["--record_camera_path"] = std::vector<ArgumentParser::ArgumentType>(1, ArgumentParser::ArgumentType_string); // Record camera path to the given file, for use with --benchmark.
+		syntax["--record_capture"] = std::vector<ArgumentParser::ArgumentType>(1, ArgumentParser::ArgumentType_string); // Record messages from the server, and used resources, to the given capture file.
+		syntax["--replay_capture"] = std::vector<ArgumentParser::ArgumentType>(1, ArgumentParser::ArgumentType_string); // Replay messages from the given capture file instead of connecting to the server.
+		syntax["--replay_speed"] = std::vector<ArgumentParser::ArgumentType>(1, ArgumentParser::ArgumentType_string); // Replay speed relative to the recorded timings, 0 = as fast as possible.  Default 1.
 
 		std::vector<std::string> args;
 		for(int i=0; i<argc; ++i)
@@ -224,6 +239,18 @@ int main(int argc, char** argv)
 		}
 #endif
 
+		if(parsed_args.isArgPresent("--benchmark"))
+		{
+			benchmark = new ClientBenchmark();
+			benchmark->loadCameraPath(parsed_args.getArgStringValue("--benchmark"));
+			if(parsed_args.isArgPresent("--benchmark_output"))
+				benchmark_output_path = parsed_args.getArgStringValue("--benchmark_output");
+			if(parsed_args.isArgPresent("--benchmark_max_time"))
+				benchmark->max_time = stringToDouble(parsed_args.getArgStringValue("--benchmark_max_time"));
+		}
+		if(parsed_args.isArgPresent("--record_camera_path"))
+			record_camera_path_path = parsed_args.getArgStringValue("--record_camera_path");
+
 
 #if defined(EMSCRIPTEN)
 		const std::string base_dir = "";
@@ -309,7 +336,8 @@ int main(int argc, char** argv)
 #else
 		const char* window_name = "Substrata SDL Client";
 #endif
-		win = SDL_CreateWindow(window_name, 600, 100, primary_W, primary_H, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
+		const uint32 window_visibility_flag = benchmark ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN; // Don't show the window when benchmarking, so it doesn't get user input.
+		win = SDL_CreateWindow(window_name, 600, 100, primary_W, primary_H, SDL_WINDOW_OPENGL | window_visibility_flag | SDL_WINDOW_RESIZABLE);
 		if(win == nullptr)
 			throw glare::Exception("SDL_CreateWindow Error: " + std::string(SDL_GetError()));
 
@@ -320,6 +348,8 @@ int main(int argc, char** argv)
 
 
 		// SDL_GL_SetSwapInterval(0); // Disable Vsync
+		if(benchmark)
+			SDL_GL_SetSwapInterval(0); // Disable Vsync so frame times measure the client's work, not the display refresh rate.
 
 		//SDL_SetHint("SDL_HINT_MOUSE_RELATIVE_WARP_MOTION", "true");
 
@@ -501,6 +531,12 @@ int main(int argc, char** argv)
 			return 1;
 		}
 
+		if(parsed_args.isArgPresent("--record_capture"))
+			gui_client->record_capture_path = parsed_args.getArgStringValue("--record_capture");
+		if(parsed_args.isArgPresent("--replay_capture"))
+			gui_client->replay_capture_path = parsed_args.getArgStringValue("--replay_capture");
+		if(parsed_args.isArgPresent("--replay_speed"))
+			gui_client->replay_speed = stringToDouble(parsed_args.getArgStringValue("--replay_speed"));
 #endif
 
 		gui_client->connectToServer(url_parse_results);
@@ -555,6 +591,15 @@ int main(int argc, char** argv)
 
 		conPrint("main finished...");
 
+		if(!record_camera_path_path.empty())
+		{
+			FileUtils::writeEntireFileTextMode(record_camera_path_path, recorded_camera_path);
+			conPrint("Wrote camera path to '" + record_camera_path_path + "'.");
+		}
+
+		delete benchmark;
+		benchmark = NULL;
+
 		gui_client->shutdown();
 		delete gui_client;
 		gui_client = NULL; 
@@ -973,6 +1018,9 @@ static void doOneMainLoopIter()
 		mouse_cursor_state.alt_key_down  = (mod_state & KMOD_ALT)  != 0;
 	}
 	
+	if(benchmark)
+		benchmark->beginFrame(*gui_client);
+
 	try
 	{
 		gui_client->timerEvent(mouse_cursor_state);
@@ -1089,6 +1137,40 @@ static void doOneMainLoopIter()
 
 	time_since_last_frame->reset();
 
+	if(benchmark)
+	{
+		benchmark->endFrame(*gui_client, loop_iter_timer.elapsed());
+		if(benchmark->isDone())
+		{
+			const std::string results = benchmark->getResultsJSON();
+			if(benchmark_output_path.empty())
+				conPrint(results);
+			else
+			{
+				try
+				{
+					FileUtils::writeEntireFileTextMode(benchmark_output_path, results);
+					conPrint("Wrote benchmark results to '" + benchmark_output_path + "'.");
+				}
+				catch(glare::Exception& e)
+				{
+					conPrint("ERROR: Failed to write benchmark results: " + e.what());
+				}
+			}
+			quit = true;
+		}
+	}
+
+	if(!record_camera_path_path.empty() && (timer->elapsed() - last_camera_keyframe_time >= 0.1))
+	{
+		ClientBenchmark::CameraKeyframe keyframe;
+		keyframe.time = timer->elapsed();
+		keyframe.pos = gui_client->cam_controller.getFirstPersonPosition();
+		keyframe.angles = gui_client->cam_controller.getAngles();
+		recorded_camera_path += ClientBenchmark::cameraKeyframeToString(keyframe) + "\n";
+		last_camera_keyframe_time = keyframe.time;
+	}
+
 	
 
 #if EMSCRIPTEN
@@ -28,6 +28,9 @@ void SaveResourcesDBThread::doRun()
 
 	while(1)
 	{
+		// Evict and compact the packed cache, if in use.  Done before saving, as eviction changes resource states.
+		resource_manager->doPackedCacheMaintenance();
+
 		{
 			Lock lock(resource_manager->getMutex());
 			if(resource_manager->hasChanged())
@@ -17,6 +17,7 @@ SaveResourcesDBThread
 ---------------------
 Saves resources list to resources database on disk, if the resource manager 
 has changed.
+Also does periodic maintenance (eviction and compaction) of the packed resource cache.
 =====================================================================*/
 class SaveResourcesDBThread : public MessageableThread
 {
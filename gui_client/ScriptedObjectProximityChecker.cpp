@@ -11,6 +11,17 @@ Copyright Glare Technologies Limited 2024 -
 #include "../shared/ObjectEventHandlers.h"
 #include "../shared/MessageUtils.h"
 #include "../shared/Protocol.h"
+#include <algorithm>
+
+
+// Objects are inserted into the grid with a radius of (AABB half-diagonal + proximity radius), and objects with radius > GRID_CELL_WIDTH / 2
+// are stored in the grid's large object list, which is scanned by every query.  So the cell width is chosen such that objects with the default
+// proximity radius (20 m) and a half-diagonal of up to 12 m are stored in cells.
+static const float GRID_CELL_WIDTH = 64.f;
+static const float NEAR_MARGIN = 20.f; // Objects whose bounding sphere is within this distance of the camera are in the near set.
+static const double NEAR_SET_RECOMPUTE_PERIOD = 0.5; // Recompute near set (and re-read AABBs of near objects) at least this often, to handle moving objects.
+static const double MOVED_CHECK_PERIOD = 2.0; // Re-read the AABB of every object, and update it in the grid if it has moved, about this often.
+static const float NEVER_IN_PROXIMITY_COORD = 1.0e20f; // Used for padding entries in the near set arrays.
 
 
 static void enqueueMessageToSend(ClientThread& client_thread, SocketBufferOutStream& packet)
@@ -22,7 +33,13 @@ static void enqueueMessageToSend(ClientThread& client_thread, SocketBufferOutStr
 
 
 ScriptedObjectProximityChecker::ScriptedObjectProximityChecker()
-:	objects(/*empty_val=*/WorldObjectRef())
+:	objects(/*empty_val=*/WorldObjectRef()),
+	gui_client(NULL),
+	grid(GRID_CELL_WIDTH, /*expected_num_items=*/1024),
+	next_moved_check_i(0),
+	near_set_dirty(true),
+	near_set_campos(0, 0, 0, 1),
+	last_campos(0, 0, 0, 1)
 {}
 
 
@@ -30,61 +47,553 @@ ScriptedObjectProximityChecker::~ScriptedObjectProximityChecker()
 {}
 
 
+void ScriptedObjectProximityChecker::addObject(WorldObjectRef ob)
+{
+	objects.insert(ob);
+
+	// Event handlers may have been added for an object already in the set, so always update the object in the grid.
+	updateGridForObject(ob.ptr());
+}
+
+
+void ScriptedObjectProximityChecker::removeObject(WorldObjectRef ob)
+{
+	// Remove from near set and grid now, since they don't hold references.
+	removeFromNearSet(ob.ptr());
+	removeFromGrid(ob.ptr());
+
+	objects.erase(ob);
+}
+
+
+void ScriptedObjectProximityChecker::objectProximityRadiusChanged(WorldObject* ob)
+{
+	if(grid_bounds.count(ob) != 0) // Only update objects already in the grid, proximity radius only affects objects with proximity handlers, which are added with addObject().
+		updateGridForObject(ob);
+}
+
+
+void ScriptedObjectProximityChecker::objectTransformChanged(WorldObject* ob)
+{
+	if(grid_bounds.count(ob) != 0)
+		updateGridForObject(ob);
+}
+
+
 void ScriptedObjectProximityChecker::clear()
 {
 	objects.clear();
+	grid.clear();
+	grid_bounds.clear();
+	near_obs.clear();
+	next_moved_check_i = 0;
+	near_set_dirty = true;
 }
 
 
-// Iterate over objects, see if the player has moved near to or away from any objects, and execute the relevant event handlers if so.
-void ScriptedObjectProximityChecker::think(const Vec4f& campos, WorldStateLock& world_state_lock)
+// Inserts, updates or removes the object in the grid, depending on whether it has proximity handlers, and its current AABB and proximity radius.
+void ScriptedObjectProximityChecker::updateGridForObject(WorldObject* ob)
+{
+	bool in_grid = false;
+	Vec4f centroid_and_radius;
+	if(ob->event_handlers && ob->event_handlers->hasProximityHandlers())
+	{
+		const js::AABBox aabb = ob->getAABBWS();
+		const Vec4f centroid = aabb.centroid();
+		const float half_diagonal = (aabb.max_ - aabb.min_).length() * 0.5f;
+		const float radius = half_diagonal + ob->event_handlers->proximity_radius;
+		if(centroid.isFinite() && isFinite(radius)) // Skip objects without a valid AABB yet.
+		{
+			in_grid = true;
+			centroid_and_radius = Vec4f(centroid[0], centroid[1], centroid[2], radius);
+		}
+	}
+
+	auto res = grid_bounds.find(ob);
+	if(!in_grid)
+	{
+		if(res != grid_bounds.end())
+			removeFromGrid(ob);
+	}
+	else if(res == grid_bounds.end())
+	{
+		grid.insert(ob, centroid_and_radius, centroid_and_radius[3]);
+		grid_bounds[ob] = centroid_and_radius;
+		near_set_dirty = true;
+	}
+	else if(res->second != centroid_and_radius) // If bounds have changed:
+	{
+		grid.update(ob, /*old centroid=*/res->second, /*new centroid=*/centroid_and_radius, /*new radius=*/centroid_and_radius[3]);
+		res->second = centroid_and_radius;
+		near_set_dirty = true;
+	}
+}
+
+
+void ScriptedObjectProximityChecker::removeFromGrid(WorldObject* ob)
 {
+	auto res = grid_bounds.find(ob);
+	if(res != grid_bounds.end())
+	{
+		grid.remove(ob, /*centroid=*/res->second);
+		grid_bounds.erase(res);
+		near_set_dirty = true;
+	}
+}
+
+
+// Checks a batch of objects for movement, sized so that all objects are checked about every MOVED_CHECK_PERIOD seconds.
+void ScriptedObjectProximityChecker::checkForMovedObjects()
+{
+	const size_t objects_size = objects.vector.size();
+	if(objects_size == 0)
+		return;
+
+	const double elapsed = time_since_moved_check.elapsed();
+	const size_t num_to_check = myMin(objects_size, (size_t)std::ceil(objects_size * myMin(1.0, elapsed / MOVED_CHECK_PERIOD)));
+	if(num_to_check == 0)
+		return;
+
 	WorldObjectRef* const objects_data = objects.vector.data();
-	const size_t objects_size          = objects.vector.size();
+	for(size_t i=0; i<num_to_check; ++i)
+	{
+		if(next_moved_check_i >= objects_size)
+			next_moved_check_i = 0;
+		updateGridForObject(objects_data[next_moved_check_i].ptr());
+		next_moved_check_i++;
+	}
+
+	time_since_moved_check.reset();
+}
+
+
+void ScriptedObjectProximityChecker::removeFromNearSet(WorldObject* ob)
+{
+	for(size_t i=0; i<near_obs.size(); ++i)
+		if(near_obs[i] == ob)
+		{
+			near_obs.erase(near_obs.begin() + i);
+			near_set_dirty = true; // near_obs no longer matches the SoA arrays, so they need to be recomputed before use.
+			return;
+		}
+}
+
+
+void ScriptedObjectProximityChecker::recomputeNearSet(const Vec4f& campos)
+{
+	checkForMovedObjects();
+
+	temp_obs.clear();
+
+	// Keep objects that are currently in proximity, so that we detect them moving out of proximity.
+	for(size_t i=0; i<near_obs.size(); ++i)
+		if(near_obs[i]->in_script_proximity)
+			temp_obs.push_back(near_obs[i]);
+
+	grid.forEachObInSphere(campos, NEAR_MARGIN, [&](WorldObject* ob, const Vec4f& /*centroid_and_radius*/) { temp_obs.push_back(ob); });
+
+	std::sort(temp_obs.begin(), temp_obs.end());
+	temp_obs.erase(std::unique(temp_obs.begin(), temp_obs.end()), temp_obs.end());
+
+	near_obs = temp_obs;
+
+	const size_t padded_size = (near_obs.size() + 3) & ~(size_t)3; // Round up to multiple of 4
+	near_min_x.resize(padded_size);
+	near_min_y.resize(padded_size);
+	near_min_z.resize(padded_size);
+	near_max_x.resize(padded_size);
+	near_max_y.resize(padded_size);
+	near_max_z.resize(padded_size);
+	near_radius_2.resize(padded_size);
+
+	for(size_t i=0; i<padded_size; ++i)
+	{
+		if(i < near_obs.size())
+		{
+			const WorldObject* ob = near_obs[i];
+			const js::AABBox aabb = ob->getAABBWS();
+			const float radius = ob->event_handlers ? ob->event_handlers->proximity_radius : ObjectEventHandlers::DEFAULT_PROXIMITY_RADIUS;
+			near_min_x[i] = aabb.min_[0];
+			near_min_y[i] = aabb.min_[1];
+			near_min_z[i] = aabb.min_[2];
+			near_max_x[i] = aabb.max_[0];
+			near_max_y[i] = aabb.max_[1];
+			near_max_z[i] = aabb.max_[2];
+			near_radius_2[i] = Maths::square(radius);
+		}
+		else
+		{
+			near_min_x[i] = near_min_y[i] = near_min_z[i] = NEVER_IN_PROXIMITY_COORD;
+			near_max_x[i] = near_max_y[i] = near_max_z[i] = NEVER_IN_PROXIMITY_COORD;
+			near_radius_2[i] = 0;
+		}
+	}
+
+	near_set_dirty = false;
+	near_set_campos = campos;
+	time_since_near_set_recompute.reset();
+}
+
+
+// Re-reads the AABBs of the objects in the near set, so that objects moving into or out of proximity are detected even if the camera is stationary.
+// Returns true if any AABB changed.
+bool ScriptedObjectProximityChecker::refreshNearSetBounds()
+{
+	bool changed = false;
+	for(size_t i=0; i<near_obs.size(); ++i)
+	{
+		const js::AABBox aabb = near_obs[i]->getAABBWS();
+		if(aabb.min_[0] != near_min_x[i] || aabb.min_[1] != near_min_y[i] || aabb.min_[2] != near_min_z[i] ||
+			aabb.max_[0] != near_max_x[i] || aabb.max_[1] != near_max_y[i] || aabb.max_[2] != near_max_z[i])
+		{
+			near_min_x[i] = aabb.min_[0];
+			near_min_y[i] = aabb.min_[1];
+			near_min_z[i] = aabb.min_[2];
+			near_max_x[i] = aabb.max_[0];
+			near_max_y[i] = aabb.max_[1];
+			near_max_z[i] = aabb.max_[2];
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+
+uint32 ScriptedObjectProximityChecker::computeProximityMask(const Vec4f& campos, const float* min_x, const float* min_y, const float* min_z, const float* max_x, const float* max_y, const float* max_z,
+	const float* radius_2, size_t begin)
+{
+	const __m128 cx = _mm_set1_ps(campos[0]);
+	const __m128 cy = _mm_set1_ps(campos[1]);
+	const __m128 cz = _mm_set1_ps(campos[2]);
+	const __m128 zero = _mm_setzero_ps();
+
+	// Distance along each axis from the camera to the closest point in the AABB.
+	const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(min_x + begin), cx), _mm_sub_ps(cx, _mm_load_ps(max_x + begin))), zero);
+	const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(min_y + begin), cy), _mm_sub_ps(cy, _mm_load_ps(max_y + begin))), zero);
+	const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(min_z + begin), cz), _mm_sub_ps(cz, _mm_load_ps(max_z + begin))), zero);
+
+	const __m128 dist2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+	return (uint32)_mm_movemask_ps(_mm_cmplt_ps(dist2, _mm_load_ps(radius_2 + begin)));
+}
 
-	for(size_t i=0; i<objects_size; ++i)
+
+// See if the player has moved near to or away from any objects, and execute the relevant event handlers if so.
+void ScriptedObjectProximityChecker::think(const Vec4f& campos, WorldStateLock& world_state_lock)
+{
+	bool need_check;
+	if(near_set_dirty || (campos.getDist(near_set_campos) > NEAR_MARGIN * 0.5f) || (time_since_near_set_recompute.elapsed() > NEAR_SET_RECOMPUTE_PERIOD))
 	{
-		if(i + 16 < objects_size)
-			_mm_prefetch((const char*)(&objects_data[i + 16]->centroid_ws), _MM_HINT_T0);
+		recomputeNearSet(campos);
+		need_check = true;
+	}
+	else
+	{
+		// Only need to check if the camera or any of the near objects have moved.
+		const bool near_obs_moved = refreshNearSetBounds();
+		need_check = near_obs_moved || (campos.getDist2(last_campos) > 0);
+	}
+
+	last_campos = campos;
+
+	if(!need_check)
+		return;
+
+	// Find objects with changed proximity state
+	std::vector<WorldObjectRef> changed_obs;
+	const size_t num_near = near_obs.size();
+	for(size_t i=0; i<num_near; i += 4)
+	{
+		const uint32 mask = computeProximityMask(campos, near_min_x.data(), near_min_y.data(), near_min_z.data(), near_max_x.data(), near_max_y.data(), near_max_z.data(), near_radius_2.data(), i);
+
+		const size_t num_in_group = myMin<size_t>(4, num_near - i);
+		for(size_t z=0; z<num_in_group; ++z)
+		{
+			const bool new_in_proximity = ((mask >> z) & 1) != 0;
+			if(new_in_proximity != near_obs[i + z]->in_script_proximity)
+				changed_obs.push_back(near_obs[i + z]);
+		}
+	}
 
-		WorldObject* const ob = objects_data[i].ptr();
+	// Execute event handlers.  Do this after the loop above, since event handlers may add or remove objects.
+	for(size_t i=0; i<changed_obs.size(); ++i)
+		proximityChanged(changed_obs[i].ptr(), /*new_in_proximity=*/!changed_obs[i]->in_script_proximity, world_state_lock);
+}
 
-		const bool cur_in_proximity = ob->in_script_proximity;
 
-		const Vec4f closest_point_in_aabb = ob->getAABBWS().getClosestPointInAABB(campos);
-		const float dist2 = campos.getDist2(closest_point_in_aabb);
-		const bool new_in_proximity = dist2 < Maths::square(20.f);
+void ScriptedObjectProximityChecker::proximityChanged(WorldObject* ob, bool new_in_proximity, WorldStateLock& world_state_lock)
+{
+	ob->in_script_proximity = new_in_proximity;
 
-		if(new_in_proximity != cur_in_proximity)
+	if(new_in_proximity)
+	{
+		if(ob->event_handlers && ob->event_handlers->onUserMovedNearToObject_handlers.nonEmpty())
+		{
+			// Execute any event handlers
+			ob->event_handlers->executeOnUserMovedNearToObjectHandlers(/*avatar_uid=*/gui_client->client_avatar_uid, ob->uid, world_state_lock);
+
+			// Send message to server to execute on server as well
+			MessageUtils::initPacket(gui_client->scratch_packet, Protocol::UserMovedNearToObjectMessage);
+			writeToStream(ob->uid, gui_client->scratch_packet);
+			enqueueMessageToSend(*gui_client->client_thread, gui_client->scratch_packet);
+		}
+	}
+	else
+	{
+		if(ob->event_handlers && ob->event_handlers->onUserMovedAwayFromObject_handlers.nonEmpty())
 		{
-			ob->in_script_proximity = new_in_proximity;
+			// Execute any event handlers
+			ob->event_handlers->executeOnUserMovedAwayFromObjectHandlers(/*avatar_uid=*/gui_client->client_avatar_uid, ob->uid, world_state_lock);
+
+			// Send message to server to execute on server as well
+			MessageUtils::initPacket(gui_client->scratch_packet, Protocol::UserMovedAwayFromObjectMessage);
+			writeToStream(ob->uid, gui_client->scratch_packet);
+			enqueueMessageToSend(*gui_client->client_thread, gui_client->scratch_packet);
+		}
+	}
+}
+
+
+#if BUILD_TESTS
+
+
+#include "../utils/TestUtils.h"
+#include "../utils/ConPrint.h"
+#include "../maths/PCG32.h"
+
+
+static WorldObjectRef makeTestObject(const Vec3d& pos, bool add_proximity_handler)
+{
+	WorldObjectRef ob = new WorldObject();
+	ob->pos = pos;
+	ob->axis = Vec3f(0, 0, 1);
+	ob->angle = 0;
+	ob->scale = Vec3f(1.f);
+	ob->setAABBOS(js::AABBox(Vec4f(0, 0, 0, 1), Vec4f(1, 1, 1, 1)));
+
+	if(add_proximity_handler)
+	{
+		HandlerFunc handler;
+		handler.handler_func_ref = 0;
+		handler.function_ptr = ob.ptr();
+		ob->getOrCreateEventHandlers()->onUserMovedNearToObject_handlers.handler_funcs.push_back(handler);
+	}
+	return ob;
+}
+
+
+static bool nearSetContains(const std::vector<WorldObject*>& near_obs, const WorldObject* ob)
+{
+	return std::find(near_obs.begin(), near_obs.end(), ob) != near_obs.end();
+}
+
+
+void ScriptedObjectProximityChecker::test()
+{
+	conPrint("ScriptedObjectProximityChecker::test()");
 
-			if(new_in_proximity)
+	// Test computeProximityMask against scalar closest-point computation
+	{
+		PCG32 rng(1);
+		js::Vector<float, 16> min_x(8), min_y(8), min_z(8), max_x(8), max_y(8), max_z(8), radius_2(8);
+		for(int iter=0; iter<1000; ++iter)
+		{
+			std::vector<js::AABBox> aabbs(8);
+			std::vector<float> radii(8);
+			for(int i=0; i<8; ++i)
 			{
-				if(ob->event_handlers && ob->event_handlers->onUserMovedNearToObject_handlers.nonEmpty())
-				{
-					// Execute any event handlers
-					ob->event_handlers->executeOnUserMovedNearToObjectHandlers(/*avatar_uid=*/gui_client->client_avatar_uid, ob->uid, world_state_lock);
+				const Vec4f p((rng.unitRandom() - 0.5f) * 100, (rng.unitRandom() - 0.5f) * 100, (rng.unitRandom() - 0.5f) * 100, 1);
+				aabbs[i] = js::AABBox(p, p + Vec4f(rng.unitRandom() * 10, rng.unitRandom() * 10, rng.unitRandom() * 10, 0));
+				radii[i] = rng.unitRandom() * 30;
 
-					// Send message to server to execute on server as well
-					MessageUtils::initPacket(gui_client->scratch_packet, Protocol::UserMovedNearToObjectMessage);
-					writeToStream(ob->uid, gui_client->scratch_packet);
-					enqueueMessageToSend(*gui_client->client_thread, gui_client->scratch_packet);
-				}
+				min_x[i] = aabbs[i].min_[0]; min_y[i] = aabbs[i].min_[1]; min_z[i] = aabbs[i].min_[2];
+				max_x[i] = aabbs[i].max_[0]; max_y[i] = aabbs[i].max_[1]; max_z[i] = aabbs[i].max_[2];
+				radius_2[i] = Maths::square(radii[i]);
 			}
-			else
+
+			const Vec4f campos((rng.unitRandom() - 0.5f) * 100, (rng.unitRandom() - 0.5f) * 100, (rng.unitRandom() - 0.5f) * 100, 1);
+
+			for(size_t begin=0; begin<8; begin += 4)
 			{
-				if(ob->event_handlers && ob->event_handlers->onUserMovedAwayFromObject_handlers.nonEmpty())
+				const uint32 mask = computeProximityMask(campos, min_x.data(), min_y.data(), min_z.data(), max_x.data(), max_y.data(), max_z.data(), radius_2.data(), begin);
+				for(size_t z=0; z<4; ++z)
 				{
-					// Execute any event handlers
-					ob->event_handlers->executeOnUserMovedAwayFromObjectHandlers(/*avatar_uid=*/gui_client->client_avatar_uid, ob->uid, world_state_lock);
-
-					// Send message to server to execute on server as well
-					MessageUtils::initPacket(gui_client->scratch_packet, Protocol::UserMovedAwayFromObjectMessage);
-					writeToStream(ob->uid, gui_client->scratch_packet);
-					enqueueMessageToSend(*gui_client->client_thread, gui_client->scratch_packet);
+					const js::AABBox& aabb = aabbs[begin + z];
+					const float dist2 = campos.getDist2(aabb.getClosestPointInAABB(campos));
+					const bool ref_in_proximity = dist2 < Maths::square(radii[begin + z]);
+					const bool in_proximity = ((mask >> z) & 1) != 0;
+					// Allow for differences in rounding very close to the boundary.
+					if(std::fabs(std::sqrt(dist2) - radii[begin + z]) > 1.0e-3f)
+						testAssert(in_proximity == ref_in_proximity);
 				}
 			}
 		}
 	}
+
+	// Test padding entries are never in proximity
+	{
+		js::Vector<float, 16> coords(4), radius_2(4);
+		for(int i=0; i<4; ++i)
+		{
+			coords[i] = NEVER_IN_PROXIMITY_COORD;
+			radius_2[i] = 0;
+		}
+		testAssert(computeProximityMask(Vec4f(0, 0, 0, 1), coords.data(), coords.data(), coords.data(), coords.data(), coords.data(), coords.data(), radius_2.data(), 0) == 0);
+		testAssert(computeProximityMask(Vec4f(1.0e20f, 1.0e20f, 1.0e20f, 1), coords.data(), coords.data(), coords.data(), coords.data(), coords.data(), coords.data(), radius_2.data(), 0) == 0);
+	}
+
+	// Test grid queries and incremental grid updates
+	{
+		ScriptedObjectProximityChecker checker;
+
+		WorldObjectRef ob_a = makeTestObject(Vec3d(0, 0, 0),    /*add_proximity_handler=*/true);
+		WorldObjectRef ob_b = makeTestObject(Vec3d(1000, 0, 0), /*add_proximity_handler=*/true);
+		WorldObjectRef ob_no_handlers = makeTestObject(Vec3d(0, 0, 0), /*add_proximity_handler=*/false);
+		checker.addObject(ob_a);
+		checker.addObject(ob_b);
+		checker.addObject(ob_no_handlers);
+		testAssert(checker.grid_bounds.size() == 2); // Object without proximity handlers should not be in the grid.
+		testAssert(checker.grid.numLargeObjects() == 0); // Typical scripted objects, with the default proximity radius, should be stored in grid cells.
+
+		const Vec4f campos(0, 0, 0, 1);
+		checker.recomputeNearSet(campos);
+		testAssert(checker.near_obs.size() == 1 && nearSetContains(checker.near_obs, ob_a.ptr()));
+
+		// Query near the other object
+		checker.recomputeNearSet(Vec4f(1000, 0, 0, 1));
+		testAssert(checker.near_obs.size() == 1 && nearSetContains(checker.near_obs, ob_b.ptr()));
+
+		// Move ob_b next to the camera, check it is picked up once all objects have been checked for movement.
+		ob_b->pos = Vec3d(2, 0, 0);
+		ob_b->transformChanged();
+		for(size_t i=0; i<checker.objects.vector.size(); ++i)
+			checker.updateGridForObject(checker.objects.vector[i].ptr());
+		testAssert(checker.near_set_dirty);
+		checker.recomputeNearSet(campos);
+		testAssert(checker.near_obs.size() == 2 && nearSetContains(checker.near_obs, ob_a.ptr()) && nearSetContains(checker.near_obs, ob_b.ptr()));
+		checker.recomputeNearSet(Vec4f(1000, 0, 0, 1));
+		testAssert(checker.near_obs.empty());
+
+		// Updating an object that hasn't moved shouldn't dirty the near set.
+		checker.recomputeNearSet(campos);
+		checker.updateGridForObject(ob_a.ptr());
+		testAssert(!checker.near_set_dirty);
+
+		// Test proximity radius change: a large radius should make ob_a near to a camera position well outside the default radius.
+		const Vec4f far_campos(300, 0, 0, 1);
+		checker.recomputeNearSet(far_campos);
+		testAssert(!nearSetContains(checker.near_obs, ob_a.ptr()));
+		ob_a->event_handlers->proximity_radius = 500.f;
+		checker.objectProximityRadiusChanged(ob_a.ptr());
+		testAssert(checker.near_set_dirty);
+		checker.recomputeNearSet(far_campos);
+		testAssert(nearSetContains(checker.near_obs, ob_a.ptr()));
+
+		// Radius change for an object not in the checker should be ignored.
+		WorldObjectRef ob_not_added = makeTestObject(Vec3d(0, 0, 0), /*add_proximity_handler=*/true);
+		checker.objectProximityRadiusChanged(ob_not_added.ptr());
+		testAssert(checker.grid_bounds.size() == 2);
+
+		// Adding handlers to an object already in the checker should insert it into the grid.
+		HandlerFunc handler;
+		handler.handler_func_ref = 0;
+		handler.function_ptr = ob_no_handlers.ptr();
+		ob_no_handlers->getOrCreateEventHandlers()->onUserMovedAwayFromObject_handlers.handler_funcs.push_back(handler);
+		checker.addObject(ob_no_handlers);
+		testAssert(checker.grid_bounds.size() == 3);
+		checker.recomputeNearSet(campos);
+		testAssert(nearSetContains(checker.near_obs, ob_no_handlers.ptr()));
+
+		// Test removal
+		checker.removeObject(ob_a);
+		testAssert(checker.grid_bounds.size() == 2);
+		testAssert(!nearSetContains(checker.near_obs, ob_a.ptr()));
+		checker.recomputeNearSet(far_campos);
+		testAssert(!nearSetContains(checker.near_obs, ob_a.ptr()));
+		checker.recomputeNearSet(campos);
+		testAssert(!nearSetContains(checker.near_obs, ob_a.ptr()) && nearSetContains(checker.near_obs, ob_b.ptr()));
+
+		// Test that objects without a valid AABB yet are not inserted into the grid, and are inserted once they have one.
+		WorldObjectRef ob_no_aabb = new WorldObject();
+		ob_no_aabb->pos = Vec3d(0, 0, 0);
+		ob_no_aabb->axis = Vec3f(0, 0, 1);
+		ob_no_aabb->angle = 0;
+		ob_no_aabb->scale = Vec3f(1.f);
+		ob_no_aabb->getOrCreateEventHandlers()->onUserMovedNearToObject_handlers.handler_funcs.push_back(handler);
+		checker.addObject(ob_no_aabb);
+		testAssert(checker.grid_bounds.size() == 2);
+		ob_no_aabb->setAABBOS(js::AABBox(Vec4f(0, 0, 0, 1), Vec4f(1, 1, 1, 1)));
+		for(size_t i=0; i<checker.objects.vector.size(); ++i)
+			checker.updateGridForObject(checker.objects.vector[i].ptr());
+		testAssert(checker.grid_bounds.size() == 3);
+
+		checker.clear();
+		testAssert(checker.grid_bounds.empty() && checker.near_obs.empty());
+	}
+
+	// Test that typical scripted objects are stored in grid cells, not in the large object list, and that very large objects are.
+	{
+		ScriptedObjectProximityChecker checker;
+		PCG32 rng(1);
+		std::vector<WorldObjectRef> obs;
+		for(int i=0; i<100; ++i)
+		{
+			WorldObjectRef ob = makeTestObject(Vec3d(rng.unitRandom() * 1000, rng.unitRandom() * 1000, rng.unitRandom() * 10), /*add_proximity_handler=*/true);
+			ob->scale = Vec3f(1 + rng.unitRandom() * 9); // Objects up to 10 m wide.
+			ob->transformChanged();
+			checker.addObject(ob);
+			obs.push_back(ob);
+		}
+		testAssert(checker.grid_bounds.size() == 100);
+		testAssert(checker.grid.numLargeObjects() == 0);
+
+		WorldObjectRef huge_ob = makeTestObject(Vec3d(0, 0, 0), /*add_proximity_handler=*/true);
+		huge_ob->scale = Vec3f(100.f);
+		huge_ob->transformChanged();
+		checker.addObject(huge_ob);
+		testAssert(checker.grid.numLargeObjects() == 1);
+
+		checker.clear();
+	}
+
+	// Test that objects moving into proximity of a stationary camera are detected.
+	{
+		ScriptedObjectProximityChecker checker;
+		WorldObjectRef ob = makeTestObject(Vec3d(15, 0, 0), /*add_proximity_handler=*/true);
+		ob->getOrCreateEventHandlers()->proximity_radius = 5.f;
+		checker.addObject(ob);
+
+		const Vec4f campos(0, 0, 0, 1);
+		checker.recomputeNearSet(campos);
+		testAssert(nearSetContains(checker.near_obs, ob.ptr()));
+		testAssert(!checker.refreshNearSetBounds());
+		testAssert((computeProximityMask(campos, checker.near_min_x.data(), checker.near_min_y.data(), checker.near_min_z.data(), checker.near_max_x.data(), checker.near_max_y.data(),
+			checker.near_max_z.data(), checker.near_radius_2.data(), 0) & 1) == 0);
+
+		// Move the object to within its proximity radius of the camera.
+		ob->pos = Vec3d(2, 0, 0);
+		ob->transformChanged();
+		testAssert(checker.refreshNearSetBounds());
+		testAssert((computeProximityMask(campos, checker.near_min_x.data(), checker.near_min_y.data(), checker.near_min_z.data(), checker.near_max_x.data(), checker.near_max_y.data(),
+			checker.near_max_z.data(), checker.near_radius_2.data(), 0) & 1) != 0);
+
+		// Move an object from far away to near the camera, check objectTransformChanged() updates the grid so the next near set recompute picks it up.
+		WorldObjectRef far_ob = makeTestObject(Vec3d(1000, 0, 0), /*add_proximity_handler=*/true);
+		checker.addObject(far_ob);
+		checker.recomputeNearSet(campos);
+		testAssert(!nearSetContains(checker.near_obs, far_ob.ptr()));
+		far_ob->pos = Vec3d(3, 0, 0);
+		far_ob->transformChanged();
+		checker.objectTransformChanged(far_ob.ptr());
+		testAssert(checker.near_set_dirty);
+		checker.recomputeNearSet(campos);
+		testAssert(nearSetContains(checker.near_obs, far_ob.ptr()));
+
+		checker.clear();
+	}
+
+	conPrint("ScriptedObjectProximityChecker::test() done.");
 }
+
+
+#endif // BUILD_TESTS
@@ -6,8 +6,13 @@ Copyright Glare Technologies Limited 2024 -
 #pragma once
 
 
+#include "HashedObGrid.h"
 #include "../utils/LinearIterSet.h"
+#include "../utils/Vector.h"
+#include "../utils/Timer.h"
 #include "../shared/WorldObject.h"
+#include <vector>
+#include <unordered_map>
 class GUIClient;
 class WorldStateLock;
 
@@ -15,11 +20,25 @@ class WorldStateLock;
 /*=====================================================================
 ScriptedObjectProximityChecker
 ------------------------------
-Stores references to all objects that have a script that has one of the 
+Stores references to all objects that have a script that has one of the
 spatial event handlers, for example onUserMovedNearToObject.
 
-Currently just uses linear iteration over such objects but could use some kind of
-spatial acceleration data structure in the future.
+Objects with onUserMovedNearToObject or onUserMovedAwayFromObject handlers are inserted into a HashedObGrid,
+with a bounding sphere that encloses the object AABB expanded by the object proximity radius.
+
+The 'near set' is the set of objects whose bounding sphere is within NEAR_MARGIN of the camera.
+It is recomputed from the grid when the camera has moved more than NEAR_MARGIN / 2 since the last recompute,
+so objects not in the near set can't be in proximity.
+The AABBs and proximity radii of objects in the near set are stored in structure-of-arrays form, so
+the per-frame proximity test is a vectorised loop over only the near set.
+
+The grid is updated incrementally: objects are inserted or removed when they are added or removed,
+or when their event handlers, proximity radius or transform change.  To handle objects moved by other means (e.g. physics),
+object AABBs are also re-read in small batches each time the near set is recomputed, such that every object is checked about
+every MOVED_CHECK_PERIOD seconds, and only objects whose bounds have changed are moved in the grid.
+
+The AABBs of objects in the near set are re-read every frame, so objects moving into or out of proximity
+are detected even when the camera is stationary.
 =====================================================================*/
 class ScriptedObjectProximityChecker
 {
@@ -27,14 +46,48 @@ public:
 	ScriptedObjectProximityChecker();
 	~ScriptedObjectProximityChecker();
 
-	void addObject(WorldObjectRef ob) { objects.insert(ob); }
-	void removeObject(WorldObjectRef ob) { objects.erase(ob); }
+	void addObject(WorldObjectRef ob);
+	void removeObject(WorldObjectRef ob);
+	void objectProximityRadiusChanged(WorldObject* ob);
+	void objectTransformChanged(WorldObject* ob); // Should be called when an object is moved, so it is moved in the grid immediately instead of at the next periodic movement check.
 	void clear();
 
-	// Iterate over objects, see if the player has moved near to or away from any objects, and execute the relevant event handlers if so.
+	// See if the player has moved near to or away from any objects, and execute the relevant event handlers if so.
 	void think(const Vec4f& campos, WorldStateLock& world_state_lock);
 
+	// Returns a bitmask with bit i set if the camera is within radius_2[i] (squared radius) of the AABB (min_x[i], min_y[i], min_z[i]) - (max_x[i], max_y[i], max_z[i]), for i in [begin, begin + 4).
+	static uint32 computeProximityMask(const Vec4f& campos, const float* min_x, const float* min_y, const float* min_z, const float* max_x, const float* max_y, const float* max_z,
+		const float* radius_2, size_t begin);
+
+	static void test();
+
 	glare::LinearIterSet<WorldObjectRef, WorldObjectRefHash> objects;
 
 	GUIClient* gui_client;
+
+private:
+	void updateGridForObject(WorldObject* ob);
+	void removeFromGrid(WorldObject* ob);
+	void checkForMovedObjects();
+	void recomputeNearSet(const Vec4f& campos);
+	bool refreshNearSetBounds();
+	void removeFromNearSet(WorldObject* ob);
+	void proximityChanged(WorldObject* ob, bool new_in_proximity, WorldStateLock& world_state_lock);
+
+	HashedObGrid grid;
+	std::unordered_map<WorldObject*, Vec4f> grid_bounds; // Map from object to the (centroid, radius) it is stored in the grid with.  Objects not in the grid are not in the map.
+	size_t next_moved_check_i; // Index into objects.vector of the next object to check for movement.
+	Timer time_since_moved_check;
+
+	// Near set, in structure-of-arrays form.  Arrays are padded to a multiple of 4 elements with entries that are never in proximity.
+	js::Vector<float, 16> near_min_x, near_min_y, near_min_z;
+	js::Vector<float, 16> near_max_x, near_max_y, near_max_z;
+	js::Vector<float, 16> near_radius_2; // Squared proximity radius.
+	std::vector<WorldObject*> near_obs; // Not padded.
+	bool near_set_dirty;
+	Vec4f near_set_campos; // Camera position when near set was last recomputed.
+	Timer time_since_near_set_recompute;
+
+	Vec4f last_campos;
+	std::vector<WorldObject*> temp_obs;
 };
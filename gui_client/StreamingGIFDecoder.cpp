@@ -0,0 +1,428 @@
+/*=====================================================================
+StreamingGIFDecoder.cpp
+-----------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#include "StreamingGIFDecoder.h"
+
+
+#include <utils/Exception.h>
+#include <utils/StringUtils.h>
+#include <utils/ConPrint.h>
+#include <gif_lib.h>
+#include <cstring>
+#include <cmath>
+
+
+static const std::string errorString(int error_code)
+{
+	const char* s = GifErrorString(error_code);
+	return s ? std::string(s) : ("error code " + toString(error_code));
+}
+
+
+StreamingGIFDecoder::StreamingGIFDecoder(const std::string& path_)
+:	path(path_), gif(NULL), W(0), H(0), next_frame_index(0), last_disposal_mode(DISPOSAL_UNSPECIFIED), last_frame_x(0), last_frame_y(0), last_frame_w(0), last_frame_h(0)
+{
+	open();
+}
+
+
+StreamingGIFDecoder::~StreamingGIFDecoder()
+{
+	close();
+}
+
+
+void StreamingGIFDecoder::open()
+{
+	int error_code = 0;
+	gif = DGifOpenFileName(path.c_str(), &error_code);
+	if(!gif)
+		throw glare::Exception("Failed to open GIF file '" + path + "': " + errorString(error_code));
+
+	if(gif->SWidth <= 0 || gif->SHeight <= 0 || gif->SWidth > 16384 || gif->SHeight > 16384)
+	{
+		close();
+		throw glare::Exception("Invalid GIF dimensions.");
+	}
+
+	W = (size_t)gif->SWidth;
+	H = (size_t)gif->SHeight;
+	next_frame_index = 0;
+	last_disposal_mode = DISPOSAL_UNSPECIFIED;
+
+	canvas.resize(W * H * 4);
+	std::memset(canvas.data(), 0, canvas.size());
+}
+
+
+void StreamingGIFDecoder::close()
+{
+	if(gif)
+	{
+		int error_code = 0;
+		DGifCloseFile(gif, &error_code);
+		gif = NULL;
+	}
+}
+
+
+void StreamingGIFDecoder::rewind()
+{
+	close();
+	open();
+}
+
+
+void StreamingGIFDecoder::readImageDesc(int& frame_x, int& frame_y, int& frame_w, int& frame_h)
+{
+	if(DGifGetImageDesc(gif) == GIF_ERROR)
+		throw glare::Exception("Failed to read GIF image descriptor: " + errorString(gif->Error));
+
+	frame_x = gif->Image.Left;
+	frame_y = gif->Image.Top;
+	frame_w = gif->Image.Width;
+	frame_h = gif->Image.Height;
+	if(frame_w < 0 || frame_h < 0 || frame_w > 16384 || frame_h > 16384)
+		throw glare::Exception("Invalid GIF frame dimensions.");
+}
+
+
+void StreamingGIFDecoder::scanFrames(std::vector<FrameInfo>& frames_out, bool& has_transparency_out)
+{
+	has_transparency_out = false;
+
+	GraphicsControlBlock gcb;
+	gcb.DelayTime = 0;
+	gcb.TransparentColor = NO_TRANSPARENT_COLOR;
+
+	while(1)
+	{
+		GifRecordType record_type;
+		if(DGifGetRecordType(gif, &record_type) == GIF_ERROR)
+			throw glare::Exception("Failed to read GIF record: " + errorString(gif->Error));
+
+		if(record_type == EXTENSION_RECORD_TYPE)
+		{
+			int ext_code;
+			GifByteType* ext;
+			if(DGifGetExtension(gif, &ext_code, &ext) == GIF_ERROR)
+				throw glare::Exception("Failed to read GIF extension: " + errorString(gif->Error));
+			if(ext_code == GRAPHICS_EXT_FUNC_CODE && ext)
+				DGifExtensionToGCB(ext[0], ext + 1, &gcb);
+			while(ext)
+				if(DGifGetExtensionNext(gif, &ext) == GIF_ERROR)
+					throw glare::Exception("Failed to read GIF extension: " + errorString(gif->Error));
+		}
+		else if(record_type == IMAGE_DESC_RECORD_TYPE)
+		{
+			int frame_x, frame_y, frame_w, frame_h;
+			readImageDesc(frame_x, frame_y, frame_w, frame_h);
+
+			// Skip the LZW-compressed image data without decoding it.
+			int code_size;
+			GifByteType* code_block;
+			if(DGifGetCode(gif, &code_size, &code_block) == GIF_ERROR)
+				throw glare::Exception("Failed to read GIF image data: " + errorString(gif->Error));
+			while(code_block)
+				if(DGifGetCodeNext(gif, &code_block) == GIF_ERROR)
+					throw glare::Exception("Failed to read GIF image data: " + errorString(gif->Error));
+
+			FrameInfo info;
+			info.duration = (gcb.DelayTime < 2) ? 0.1 : (gcb.DelayTime * 0.01); // Browsers treat very small delays as 100 ms, so do the same.
+			frames_out.push_back(info);
+
+			// If a frame has a transparent colour, or doesn't cover the whole canvas (so the initially transparent canvas may show through), then the animation may have transparency.
+			if(gcb.TransparentColor != NO_TRANSPARENT_COLOR || frame_x > 0 || frame_y > 0 || (size_t)frame_x + frame_w < W || (size_t)frame_y + frame_h < H)
+				has_transparency_out = true;
+
+			// Graphics control blocks only apply to the next image.
+			gcb.DelayTime = 0;
+			gcb.TransparentColor = NO_TRANSPARENT_COLOR;
+		}
+		else if(record_type == TERMINATE_RECORD_TYPE)
+			break;
+	}
+
+	rewind();
+}
+
+
+bool StreamingGIFDecoder::decodeNextFrame()
+{
+	GraphicsControlBlock gcb;
+	gcb.DisposalMode = DISPOSAL_UNSPECIFIED;
+	gcb.DelayTime = 0;
+	gcb.TransparentColor = NO_TRANSPARENT_COLOR;
+
+	while(1)
+	{
+		GifRecordType record_type;
+		if(DGifGetRecordType(gif, &record_type) == GIF_ERROR)
+			throw glare::Exception("Failed to read GIF record: " + errorString(gif->Error));
+
+		if(record_type == EXTENSION_RECORD_TYPE)
+		{
+			int ext_code;
+			GifByteType* ext;
+			if(DGifGetExtension(gif, &ext_code, &ext) == GIF_ERROR)
+				throw glare::Exception("Failed to read GIF extension: " + errorString(gif->Error));
+			if(ext_code == GRAPHICS_EXT_FUNC_CODE && ext)
+				DGifExtensionToGCB(ext[0], ext + 1, &gcb);
+			while(ext)
+				if(DGifGetExtensionNext(gif, &ext) == GIF_ERROR)
+					throw glare::Exception("Failed to read GIF extension: " + errorString(gif->Error));
+		}
+		else if(record_type == IMAGE_DESC_RECORD_TYPE)
+		{
+			int frame_x, frame_y, frame_w, frame_h;
+			readImageDesc(frame_x, frame_y, frame_w, frame_h);
+
+			const ColorMapObject* colour_map = gif->Image.ColorMap ? gif->Image.ColorMap : gif->SColorMap;
+			if(!colour_map)
+				throw glare::Exception("GIF frame has no colour map.");
+
+			// Read pixel indices for the frame, de-interlacing if needed.
+			indices.resize((size_t)frame_w * (size_t)frame_h);
+			if(gif->Image.Interlace)
+			{
+				const int pass_offsets[4] = { 0, 4, 2, 1 };
+				const int pass_jumps[4]   = { 8, 8, 4, 2 };
+				for(int pass=0; pass<4; ++pass)
+					for(int y=pass_offsets[pass]; y<frame_h; y += pass_jumps[pass])
+						if(DGifGetLine(gif, indices.data() + (size_t)y * frame_w, frame_w) == GIF_ERROR)
+							throw glare::Exception("Failed to read GIF image data: " + errorString(gif->Error));
+			}
+			else
+			{
+				for(int y=0; y<frame_h; ++y)
+					if(DGifGetLine(gif, indices.data() + (size_t)y * frame_w, frame_w) == GIF_ERROR)
+						throw glare::Exception("Failed to read GIF image data: " + errorString(gif->Error));
+			}
+
+			// Apply the disposal method of the previous frame
+			if(last_disposal_mode == DISPOSE_BACKGROUND)
+				clearRect(canvas.data(), W, H, last_frame_x, last_frame_y, last_frame_w, last_frame_h);
+			else if(last_disposal_mode == DISPOSE_PREVIOUS && prev_canvas.size() == canvas.size())
+				canvas = prev_canvas;
+
+			if(gcb.DisposalMode == DISPOSE_PREVIOUS)
+				prev_canvas = canvas;
+
+			// Convert colour map to packed RGB
+			uint8 colours[256 * 3];
+			const int num_colours = myMin(256, colour_map->ColorCount);
+			for(int i=0; i<num_colours; ++i)
+			{
+				colours[i*3 + 0] = colour_map->Colors[i].Red;
+				colours[i*3 + 1] = colour_map->Colors[i].Green;
+				colours[i*3 + 2] = colour_map->Colors[i].Blue;
+			}
+
+			compositeFrame(canvas.data(), W, H, indices.data(), frame_x, frame_y, frame_w, frame_h, colours, num_colours, gcb.TransparentColor);
+
+			last_disposal_mode = gcb.DisposalMode;
+			last_frame_x = frame_x;
+			last_frame_y = frame_y;
+			last_frame_w = frame_w;
+			last_frame_h = frame_h;
+
+			next_frame_index++;
+			return true;
+		}
+		else if(record_type == TERMINATE_RECORD_TYPE)
+			return false;
+	}
+}
+
+
+void StreamingGIFDecoder::compositeFrame(uint8* canvas, size_t canvas_w, size_t canvas_h, const uint8* indices, int frame_x, int frame_y, int frame_w, int frame_h,
+	const uint8* colours, int num_colours, int transparent_index)
+{
+	// Clip frame rect to canvas
+	const int x_begin = myMax(0, frame_x);
+	const int y_begin = myMax(0, frame_y);
+	const int x_end = (int)myMin<int64>((int64)frame_x + frame_w, (int64)canvas_w);
+	const int y_end = (int)myMin<int64>((int64)frame_y + frame_h, (int64)canvas_h);
+
+	for(int y=y_begin; y<y_end; ++y)
+	{
+		const uint8* src = indices + (size_t)(y - frame_y) * frame_w;
+		uint8* dst = canvas + ((size_t)y * canvas_w) * 4;
+		for(int x=x_begin; x<x_end; ++x)
+		{
+			const int index = src[x - frame_x];
+			if(index != transparent_index && index < num_colours)
+			{
+				dst[x*4 + 0] = colours[index*3 + 0];
+				dst[x*4 + 1] = colours[index*3 + 1];
+				dst[x*4 + 2] = colours[index*3 + 2];
+				dst[x*4 + 3] = 255;
+			}
+		}
+	}
+}
+
+
+void StreamingGIFDecoder::clearRect(uint8* canvas, size_t canvas_w, size_t canvas_h, int x, int y, int w, int h)
+{
+	const int x_begin = myMax(0, x);
+	const int y_begin = myMax(0, y);
+	const int x_end = (int)myMin<int64>((int64)x + w, (int64)canvas_w);
+	const int y_end = (int)myMin<int64>((int64)y + h, (int64)canvas_h);
+	if(x_end <= x_begin)
+		return;
+
+	for(int py=y_begin; py<y_end; ++py)
+		std::memset(canvas + ((size_t)py * canvas_w + x_begin) * 4, 0, (size_t)(x_end - x_begin) * 4);
+}
+
+
+#if BUILD_TESTS
+
+
+#include <utils/TestUtils.h>
+#include <utils/PlatformUtils.h>
+#include <utils/FileUtils.h>
+
+
+// Writes a 3-frame 4x4 test GIF using the giflib encoder.
+static void writeTestGIF(const std::string& path, bool interlace)
+{
+	int error_code = 0;
+	GifFileType* gif = EGifOpenFileName(path.c_str(), /*test existence=*/false, &error_code);
+	testAssert(gif != NULL);
+	EGifSetGifVersion(gif, /*gif89=*/true);
+
+	GifColorType colours[4] = { { 0, 0, 0 }, { 255, 0, 0 }, { 0, 255, 0 }, { 0, 0, 255 } };
+	ColorMapObject* colour_map = GifMakeMapObject(4, colours);
+	testAssert(EGifPutScreenDesc(gif, 4, 4, /*colour res=*/8, /*background=*/0, colour_map) == GIF_OK);
+
+	for(int f=0; f<3; ++f)
+	{
+		GraphicsControlBlock gcb;
+		gcb.DisposalMode = (f == 1) ? DISPOSE_BACKGROUND : DISPOSE_DO_NOT;
+		gcb.UserInputFlag = false;
+		gcb.DelayTime = 5 * (f + 1); // 50 ms, 100 ms, 150 ms
+		gcb.TransparentColor = (f == 0) ? NO_TRANSPARENT_COLOR : 0;
+		GifByteType ext[4];
+		const size_t ext_len = EGifGCBToExtension(&gcb, ext);
+		testAssert(EGifPutExtension(gif, GRAPHICS_EXT_FUNC_CODE, (int)ext_len, ext) == GIF_OK);
+
+		// Frame 0: whole canvas red.  Frame 1: 2x2 green square at (1, 1), with a transparent pixel at (2, 2).  Frame 2: blue pixel at (3, 3).
+		if(f == 0)
+		{
+			testAssert(EGifPutImageDesc(gif, 0, 0, 4, 4, interlace, NULL) == GIF_OK);
+			for(int y=0; y<4; ++y)
+			{
+				GifPixelType line[4] = { 1, 1, 1, 1 };
+				testAssert(EGifPutLine(gif, line, 4) == GIF_OK);
+			}
+		}
+		else if(f == 1)
+		{
+			testAssert(EGifPutImageDesc(gif, 1, 1, 2, 2, interlace, NULL) == GIF_OK);
+			GifPixelType line0[2] = { 2, 2 };
+			GifPixelType line1[2] = { 2, 0 };
+			testAssert(EGifPutLine(gif, line0, 2) == GIF_OK);
+			testAssert(EGifPutLine(gif, line1, 2) == GIF_OK);
+		}
+		else
+		{
+			testAssert(EGifPutImageDesc(gif, 3, 3, 1, 1, interlace, NULL) == GIF_OK);
+			GifPixelType line[1] = { 3 };
+			testAssert(EGifPutLine(gif, line, 1) == GIF_OK);
+		}
+	}
+
+	GifFreeMapObject(colour_map);
+	testAssert(EGifCloseFile(gif, &error_code) == GIF_OK);
+}
+
+
+static void checkPixel(const StreamingGIFDecoder& decoder, int x, int y, uint8 r, uint8 g, uint8 b, uint8 a)
+{
+	const uint8* px = &decoder.getCanvas()[(y * decoder.getWidth() + x) * 4];
+	testAssert(px[0] == r && px[1] == g && px[2] == b && px[3] == a);
+}
+
+
+void StreamingGIFDecoder::test()
+{
+	conPrint("StreamingGIFDecoder::test()");
+
+	//-------------------- Test compositeFrame() and clearRect() --------------------
+	{
+		uint8 canvas[4 * 4 * 4];
+		std::memset(canvas, 0, sizeof(canvas));
+
+		const uint8 colours[2 * 3] = { 10, 20, 30,  40, 50, 60 };
+		const uint8 indices[3 * 2] = { 0, 1, 0,  1, 0, 1 };
+
+		// Frame partially off the right and bottom of the canvas, index 0 transparent.
+		compositeFrame(canvas, 4, 4, indices, /*x=*/2, /*y=*/3, /*w=*/3, /*h=*/2, colours, 2, /*transparent index=*/0);
+		testAssert(canvas[(3 * 4 + 2) * 4 + 3] == 0); // (2, 3) is transparent
+		testAssert(canvas[(3 * 4 + 3) * 4 + 0] == 40 && canvas[(3 * 4 + 3) * 4 + 3] == 255); // (3, 3) has colour 1
+		for(int i=0; i<3 * 4 * 4; ++i) // First 3 rows untouched
+			testAssert(canvas[i] == 0);
+
+		// Frame partially off the top-left of the canvas, no transparency.
+		compositeFrame(canvas, 4, 4, indices, /*x=*/-1, /*y=*/-1, /*w=*/3, /*h=*/2, colours, 2, /*transparent index=*/-1);
+		testAssert(canvas[(0 * 4 + 0) * 4 + 0] == 10 && canvas[(0 * 4 + 0) * 4 + 3] == 255); // (0, 0) gets frame pixel (1, 1), which has index 0.
+		testAssert(canvas[(0 * 4 + 1) * 4 + 0] == 40); // (1, 0) gets frame pixel (2, 1), which has index 1.
+		testAssert(canvas[(0 * 4 + 2) * 4 + 3] == 0); // (2, 0) is outside the frame.
+		testAssert(canvas[(1 * 4 + 0) * 4 + 3] == 0); // (0, 1) is outside the frame.
+
+		clearRect(canvas, 4, 4, /*x=*/-2, /*y=*/-2, /*w=*/4, /*h=*/4);
+		testAssert(canvas[(0 * 4 + 1) * 4 + 3] == 0);
+		testAssert(canvas[(3 * 4 + 3) * 4 + 3] == 255); // Outside cleared rect
+	}
+
+	//-------------------- Test decoding a GIF file --------------------
+	for(int interlace=0; interlace<2; ++interlace)
+	{
+		const std::string path = PlatformUtils::getTempDirPath() + "/streaming_gif_decoder_test.gif";
+		writeTestGIF(path, interlace != 0);
+
+		StreamingGIFDecoder decoder(path);
+		testAssert(decoder.getWidth() == 4 && decoder.getHeight() == 4);
+
+		std::vector<FrameInfo> frames;
+		bool has_transparency;
+		decoder.scanFrames(frames, has_transparency);
+		testAssert(frames.size() == 3);
+		testAssert(std::fabs(frames[0].duration - 0.05) < 1.0e-9);
+		testAssert(std::fabs(frames[2].duration - 0.15) < 1.0e-9);
+		testAssert(has_transparency);
+
+		for(int loop=0; loop<2; ++loop) // Decode twice to test rewind()
+		{
+			testAssert(decoder.getNextFrameIndex() == 0);
+
+			testAssert(decoder.decodeNextFrame());
+			checkPixel(decoder, 0, 0, 255, 0, 0, 255);
+			checkPixel(decoder, 3, 3, 255, 0, 0, 255);
+
+			testAssert(decoder.decodeNextFrame());
+			checkPixel(decoder, 0, 0, 255, 0, 0, 255);
+			checkPixel(decoder, 1, 1, 0, 255, 0, 255);
+			checkPixel(decoder, 2, 2, 255, 0, 0, 255); // Transparent pixel in frame 1, so frame 0 shows through.
+
+			// Frame 1 has DISPOSE_BACKGROUND, so its rect is cleared before frame 2 is drawn.
+			testAssert(decoder.decodeNextFrame());
+			checkPixel(decoder, 0, 0, 255, 0, 0, 255);
+			checkPixel(decoder, 1, 1, 0, 0, 0, 0);
+			checkPixel(decoder, 2, 2, 0, 0, 0, 0);
+			checkPixel(decoder, 3, 3, 0, 0, 255, 255);
+
+			testAssert(!decoder.decodeNextFrame());
+			decoder.rewind();
+		}
+	}
+
+	conPrint("StreamingGIFDecoder::test() done.");
+}
+
+
+#endif // BUILD_TESTS
@@ -0,0 +1,88 @@
+/*=====================================================================
+StreamingGIFDecoder.h
+---------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#pragma once
+
+
+#include <utils/Platform.h>
+#include <string>
+#include <vector>
+struct GifFileType;
+
+
+/*=====================================================================
+StreamingGIFDecoder
+-------------------
+Decodes an animated GIF one frame at a time, unlike GIFDecoder::decodeImageSequence(),
+which decodes all frames up-front.
+
+Keeps a single canvas image, onto which each frame is composited (taking into account
+frame disposal modes and transparency), so memory usage doesn't depend on the number of frames.
+
+scanFrames() does a pass over the file without decoding any image data, to get the number of
+frames and frame durations.
+=====================================================================*/
+class StreamingGIFDecoder
+{
+public:
+	// Opens the file.  Throws glare::Exception on failure.
+	StreamingGIFDecoder(const std::string& path);
+	~StreamingGIFDecoder();
+
+	struct FrameInfo
+	{
+		double duration; // in seconds
+	};
+
+	// Reads through the rest of the file, appending info for each frame to frames_out, without decoding image data.
+	// Sets has_transparency_out to true if any frame has a transparent colour.
+	// Rewinds the decoder afterwards.
+	// Throws glare::Exception on failure.
+	void scanFrames(std::vector<FrameInfo>& frames_out, bool& has_transparency_out);
+
+	// Decodes the next frame, compositing it onto the canvas.  Returns false if there are no more frames, in which case rewind() should be called to start again.
+	// Throws glare::Exception on failure.
+	bool decodeNextFrame();
+
+	// Reopens the file and clears the canvas, so the next frame decoded is frame 0.
+	void rewind();
+
+	int getNextFrameIndex() const { return next_frame_index; }
+
+	size_t getWidth() const { return W; }
+	size_t getHeight() const { return H; }
+
+	// RGBA, W * H * 4 bytes.  The result of compositing all decoded frames so far.
+	const std::vector<uint8>& getCanvas() const { return canvas; }
+
+
+	// Composites frame pixel indices (frame_w * frame_h) with top-left corner at (frame_x, frame_y) onto the RGBA canvas.
+	// colours is an array of num_colours RGB triples.  Indices equal to transparent_index (if >= 0) are not written.  Pixels outside the canvas are clipped.
+	static void compositeFrame(uint8* canvas, size_t canvas_w, size_t canvas_h, const uint8* indices, int frame_x, int frame_y, int frame_w, int frame_h,
+		const uint8* colours, int num_colours, int transparent_index);
+
+	// Sets the pixels in the given rectangle of the canvas to transparent black.
+	static void clearRect(uint8* canvas, size_t canvas_w, size_t canvas_h, int x, int y, int w, int h);
+
+	static void test();
+
+private:
+	void open();
+	void close();
+	void readImageDesc(int& frame_x, int& frame_y, int& frame_w, int& frame_h);
+
+	std::string path;
+	GifFileType* gif;
+	size_t W, H;
+	int next_frame_index;
+
+	std::vector<uint8> canvas;
+	std::vector<uint8> prev_canvas; // Copy of canvas before the last frame was drawn, used for DISPOSE_PREVIOUS.
+	std::vector<uint8> indices; // Pixel indices for the current frame.
+
+	// Disposal info for the last decoded frame, applied before the next frame is drawn.
+	int last_disposal_mode;
+	int last_frame_x, last_frame_y, last_frame_w, last_frame_h;
+};
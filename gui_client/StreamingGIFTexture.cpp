@@ -0,0 +1,285 @@
+/*=====================================================================
+StreamingGIFTexture.cpp
+-----------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#include "StreamingGIFTexture.h"
+
+
+#include "StreamingGIFDecoder.h"
+#include "../shared/ResourceManager.h"
+#include <graphics/ImageMap.h>
+#include <graphics/TextureProcessing.h>
+#include <opengl/OpenGLEngine.h>
+#include <TaskManager.h>
+#include <Lock.h>
+#include <Exception.h>
+#include <ConPrint.h>
+#include <StringUtils.h>
+#include <tracy/Tracy.hpp>
+#include <cstring>
+
+
+StreamingGIFTexture::StreamingGIFTexture(const std::string& path_, const Reference<ResourceManager>& resource_manager_, const ResourceRef& resource_, const Reference<OpenGLEngine>& opengl_engine_, const TextureParams& tex_params_)
+:	path(path_),
+	resource_manager(resource_manager_),
+	resource(resource_),
+	opengl_engine(opengl_engine_),
+	tex_params(tex_params_),
+	decoder(NULL),
+	compress_frames(false),
+	num_cached_frames(0),
+	decode_task_in_flight(false),
+	decode_failed(false),
+	last_used_time(-1)
+{
+	openDecoder();
+
+	std::vector<StreamingGIFDecoder::FrameInfo> frame_info;
+	bool has_transparency = false;
+	try
+	{
+		decoder->scanFrames(frame_info, has_transparency);
+	}
+	catch(glare::Exception& e)
+	{
+		delete decoder;
+		throw e;
+	}
+
+	W = decoder->getWidth();
+	H = decoder->getHeight();
+	num_channels = has_transparency ? 4 : 3;
+
+	// DXT compression is only worth doing if all compressed frames can be kept, otherwise frames outside the cached range would be recompressed every time the animation loops.
+	// Estimate the compressed frame size as 4 bits per pixel for DXT1 (RGB) or 8 bits per pixel for DXT5 (RGBA), plus a third for mipmaps.
+	const size_t est_compressed_frame_size_B = W * H * (num_channels == 4 ? 8 : 4) / 8 * 4 / 3;
+	compress_frames = est_compressed_frame_size_B * frame_info.size() <= FRAME_CACHE_MAX_SIZE_B;
+
+	// Compute frame end times
+	frame_end_times.resize(frame_info.size());
+	double t = 0;
+	frame_durations_equal = true;
+	for(size_t i=0; i<frame_info.size(); ++i)
+	{
+		t += frame_info[i].duration;
+		frame_end_times[i] = t;
+		if(frame_info[i].duration != frame_info[0].duration)
+			frame_durations_equal = false;
+	}
+	last_frame_end_time = t;
+	recip_frame_duration = frame_info.empty() ? 1.0 : (1.0 / frame_info[0].duration);
+
+	frames.resize(frame_info.size());
+}
+
+
+StreamingGIFTexture::~StreamingGIFTexture()
+{
+	delete decoder;
+}
+
+
+// Makes sure the GIF file is present, extracting it from the packed cache again if it was deleted since it was last opened, then opens the decoder.
+void StreamingGIFTexture::openDecoder()
+{
+	if(resource.nonNull())
+		extracted_file_pin = resource_manager->ensureResourceFileExtracted(resource);
+
+	decoder = new StreamingGIFDecoder(path);
+}
+
+
+// Makes texture data for the current decoder canvas.
+Reference<TextureData> StreamingGIFTexture::buildFrameTextureData()
+{
+	const std::vector<uint8>& canvas = decoder->getCanvas();
+
+	ImageMapUInt8Ref map = new ImageMapUInt8(W, H, num_channels);
+	uint8* dst = map->getData();
+	if(num_channels == 4)
+		std::memcpy(dst, canvas.data(), W * H * 4);
+	else
+	{
+		for(size_t i=0; i<W * H; ++i)
+		{
+			dst[i*3 + 0] = canvas[i*4 + 0];
+			dst[i*3 + 1] = canvas[i*4 + 1];
+			dst[i*3 + 2] = canvas[i*4 + 2];
+		}
+	}
+
+	const bool do_compression = compress_frames && opengl_engine->DXTTextureCompressionSupportedAndEnabled() && tex_params.allow_compression && OpenGLTexture::areTextureDimensionsValidForCompression(*map);
+
+	return TextureProcessing::buildTextureData(map.ptr(), opengl_engine->mem_allocator.ptr(), opengl_engine->getMainTaskManager(), do_compression, /*build_mipmaps=*/tex_params.use_mipmaps);
+}
+
+
+Reference<TextureData> StreamingGIFTexture::decodeFirstFrame()
+{
+	ZoneScoped; // Tracy profiler
+
+	if(frames.empty())
+		throw glare::Exception("GIF has no frames");
+
+	if(decoder->getNextFrameIndex() != 0)
+		decoder->rewind();
+
+	if(!decoder->decodeNextFrame())
+		throw glare::Exception("Failed to decode first GIF frame");
+
+	Reference<TextureData> texdata = buildFrameTextureData();
+
+	Lock lock(mutex);
+	frames[0] = texdata;
+	num_cached_frames = (int)myMin(frames.size(), FRAME_CACHE_MAX_SIZE_B / myMax<size_t>(1, texdata->totalCPUMemUsage())); // All frames have the same size.
+	return texdata;
+}
+
+
+Reference<TextureData> StreamingGIFTexture::getFrame(int frame_i, double cur_time, glare::TaskManager& task_manager)
+{
+	Lock lock(mutex);
+
+	last_used_time = cur_time;
+
+	if(frame_i < 0 || frame_i >= (int)frames.size())
+		return NULL;
+
+	// Start decoding if this frame, or a frame half a window ahead, is not decoded yet.
+	const int lookahead_frame_i = (frame_i + WINDOW_SIZE / 2) % (int)frames.size();
+	if((frames[frame_i].isNull() || frames[lookahead_frame_i].isNull()) && !decode_task_in_flight && !decode_failed)
+	{
+		decode_task_in_flight = true;
+		task_manager.addTask(new StreamingGIFDecodeTask(this, frame_i));
+	}
+
+	return frames[frame_i];
+}
+
+
+void StreamingGIFTexture::decodeFrames(int frame_i)
+{
+	ZoneScoped; // Tracy profiler
+
+	const int num_frames = (int)frames.size();
+	const int window_size = myMin(WINDOW_SIZE, num_frames);
+	try
+	{
+		if(!decoder)
+			openDecoder();
+
+		for(int z=0; z<window_size; ++z)
+		{
+			const int i = (frame_i + z) % num_frames;
+			{
+				Lock lock(mutex);
+				if(frames[i].nonNull())
+					continue;
+			}
+
+			// GIF frames are composited on top of previous frames, so we have to decode all frames up to frame i.
+			if(decoder->getNextFrameIndex() > i)
+				decoder->rewind();
+			while(decoder->getNextFrameIndex() <= i)
+				if(!decoder->decodeNextFrame())
+					throw glare::Exception("Unexpected end of GIF frames");
+
+			Reference<TextureData> texdata = buildFrameTextureData();
+
+			Lock lock(mutex);
+			frames[i] = texdata;
+		}
+
+		// Free frames outside of the window, apart from the cached frames.
+		Lock lock(mutex);
+		for(int i=num_cached_frames; i<num_frames; ++i)
+		{
+			const int offset = (i - frame_i + num_frames) % num_frames; // Offset of frame i from start of window, taking into account wraparound.
+			if(offset >= window_size)
+				frames[i] = NULL;
+		}
+	}
+	catch(glare::Exception& e)
+	{
+		conPrint("StreamingGIFTexture: Error while decoding '" + path + "': " + e.what());
+		decodeFailed();
+	}
+	catch(std::bad_alloc&)
+	{
+		conPrint("StreamingGIFTexture: Failed to allocate mem while decoding '" + path + "'");
+		decodeFailed();
+	}
+}
+
+
+// Closes the decoder, so it is reopened from the start of the file if decoding is retried.
+void StreamingGIFTexture::decodeFailed()
+{
+	delete decoder;
+	decoder = NULL;
+	extracted_file_pin = NULL;
+
+	Lock lock(mutex);
+	decode_failed = true;
+}
+
+
+void StreamingGIFTexture::decodeTaskFinished()
+{
+	Lock lock(mutex);
+	decode_task_in_flight = false;
+}
+
+
+void StreamingGIFTexture::releaseFramesIfUnused(double cur_time, double max_idle_time)
+{
+	Lock lock(mutex);
+
+	if(last_used_time < 0)
+		last_used_time = cur_time; // Start the idle period from the first time we check.
+
+	if(!decode_task_in_flight && (cur_time - last_used_time > max_idle_time))
+	{
+		for(size_t i=0; i<frames.size(); ++i)
+			frames[i] = NULL;
+
+		delete decoder;
+		decoder = NULL;
+		extracted_file_pin = NULL;
+
+		decode_failed = false; // Retry decoding, if it failed, next time the texture is used.
+	}
+}
+
+
+bool StreamingGIFTexture::isUnusedFor(double cur_time, double period) const
+{
+	Lock lock(mutex);
+	return (last_used_time >= 0) && (cur_time - last_used_time > period);
+}
+
+
+size_t StreamingGIFTexture::getTotalCPUMemUsage() const
+{
+	Lock lock(mutex);
+
+	size_t sum = 0;
+	for(size_t i=0; i<frames.size(); ++i)
+		if(frames[i].nonNull())
+			sum += frames[i]->totalCPUMemUsage();
+	return sum;
+}
+
+
+StreamingGIFDecodeTask::~StreamingGIFDecodeTask()
+{
+	// Clear the in-flight flag in the destructor, so that it is cleared even if the task is removed from the task manager queue without being run.
+	tex->decodeTaskFinished();
+}
+
+
+void StreamingGIFDecodeTask::run(size_t thread_index)
+{
+	tex->decodeFrames(frame_i);
+}
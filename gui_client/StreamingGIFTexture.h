@@ -0,0 +1,126 @@
+/*=====================================================================
+StreamingGIFTexture.h
+---------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#pragma once
+
+
+#include "../shared/PackedResourceCache.h"
+#include "../shared/Resource.h"
+#include <opengl/OpenGLTexture.h>
+#include <ThreadSafeRefCounted.h>
+#include <Reference.h>
+#include <Mutex.h>
+#include <Task.h>
+#include <string>
+#include <vector>
+class StreamingGIFDecoder;
+class ResourceManager;
+class OpenGLEngine;
+class TextureData;
+namespace glare { class TaskManager; }
+
+
+/*=====================================================================
+StreamingGIFTexture
+-------------------
+Texture data for an animated GIF, where frames are decoded on demand
+instead of all being decoded and stored when the texture is loaded.
+
+Frames are decoded by a decode task, a few frames ahead of the currently displayed frame,
+into a small window of frames.
+
+Up to FRAME_CACHE_MAX_SIZE_B of decoded frames are kept once decoded: for short animations
+this is all frames, so each frame is only decoded (and compressed) once.
+For longer animations, the first frames that fit in the budget are kept, and the remaining frames
+are freed when outside the window, so memory usage doesn't depend on the length of the animation.
+Those frames are decoded again each time the animation loops.  DXT compression is only done if
+all compressed frames are expected to fit in the budget, so streamed frames are never recompressed each loop.
+
+When the animation has not been displayed for a while, releaseFramesIfUnused() frees
+all frames and the decoder, and unpins the GIF file, so the resource manager can delete it if it
+was extracted from the packed cache.  The file is extracted again when the decoder is reopened.
+=====================================================================*/
+class StreamingGIFTexture : public ThreadSafeRefCounted
+{
+public:
+	// Opens the GIF and scans it to get the number of frames and frame timings.
+	// If resource is non-null, the GIF file at path is the file for the resource, and is extracted from the packed cache with resource_manager whenever the decoder is opened.
+	// Throws glare::Exception on failure.
+	StreamingGIFTexture(const std::string& path, const Reference<ResourceManager>& resource_manager, const ResourceRef& resource, const Reference<OpenGLEngine>& opengl_engine, const TextureParams& tex_params);
+	~StreamingGIFTexture();
+
+	static const int WINDOW_SIZE = 8; // Number of frames decoded ahead of the current frame.
+	static const size_t FRAME_CACHE_MAX_SIZE_B = 16 * 1024 * 1024; // Max total size of decoded frames kept outside of the window.
+
+	// Decodes and returns the texture data for frame 0.  The OpenGL texture is created from this, so all frames have the same format and size.
+	// Called from a loader thread.
+	// Throws glare::Exception on failure.
+	Reference<TextureData> decodeFirstFrame();
+
+	// Returns the texture data for frame frame_i if it has been decoded, or NULL otherwise.
+	// Starts a decode task on task_manager if frame_i or upcoming frames have not been decoded yet.
+	Reference<TextureData> getFrame(int frame_i, double cur_time, glare::TaskManager& task_manager);
+
+	// Frees all decoded frames and the decoder if getFrame() has not been called for max_idle_time.
+	// Also clears any decode failure, so decoding is retried if the texture is used again.
+	void releaseFramesIfUnused(double cur_time, double max_idle_time);
+
+	// Returns true if getFrame() has not been called for the given period.
+	bool isUnusedFor(double cur_time, double period) const;
+
+	// Decodes the frames in the window starting at frame_i.  Called by the decode task.
+	void decodeFrames(int frame_i);
+	void decodeTaskFinished();
+
+	int getNumFrames() const { return (int)frame_end_times.size(); }
+	size_t getTotalCPUMemUsage() const;
+
+	// Frame timing info, same as in TextureData.
+	std::vector<double> frame_end_times;
+	double last_frame_end_time;
+	bool frame_durations_equal;
+	double recip_frame_duration;
+
+	size_t W, H;
+
+private:
+	void openDecoder();
+	void decodeFailed();
+	Reference<TextureData> buildFrameTextureData();
+
+	std::string path;
+	Reference<ResourceManager> resource_manager;
+	ResourceRef resource;
+	PackedResourceCache::PinRef extracted_file_pin; // Stops the GIF file from being deleted while the decoder is open.  Only used with decoder.
+	Reference<OpenGLEngine> opengl_engine;
+	TextureParams tex_params;
+	size_t num_channels; // 3 if no frame has transparency, 4 otherwise.
+	bool compress_frames; // Should frames be DXT-compressed (if supported)?  Set in constructor.
+
+	StreamingGIFDecoder* decoder; // Only used by the decode task (or decodeFirstFrame()), at most one of which runs at a time.
+
+	mutable Mutex mutex;
+	std::vector<Reference<TextureData> > frames		GUARDED_BY(mutex); // Decoded frames, NULL for frames not currently decoded.
+	int num_cached_frames								GUARDED_BY(mutex); // Frames with index < num_cached_frames are kept once decoded.
+	bool decode_task_in_flight							GUARDED_BY(mutex);
+	bool decode_failed									GUARDED_BY(mutex); // Set if decoding failed.  No more decode tasks are started until it is cleared by releaseFramesIfUnused().
+	double last_used_time								GUARDED_BY(mutex);
+};
+
+
+typedef Reference<StreamingGIFTexture> StreamingGIFTextureRef;
+
+
+class StreamingGIFDecodeTask : public glare::Task
+{
+public:
+	StreamingGIFDecodeTask(const StreamingGIFTextureRef& tex_, int frame_i_) : tex(tex_), frame_i(frame_i_) {}
+	~StreamingGIFDecodeTask();
+
+	virtual void run(size_t thread_index);
+
+	StreamingGIFTextureRef tex;
+	int frame_i;
+};
@@ -1191,15 +1191,13 @@ void TerrainScattering::buildVegLocationInfo(int chunk_x_index, int chunk_y_inde
 			//Vec3f(3.f), // base scale
 			//Vec3f(1.f), // scale variation
 
-			const float terrain_h = terrain_system_->evalTerrainHeight(pos[0], pos[1], /*quad_w=*/1.f);
-			const Vec4f use_pos(pos[0], pos[1], terrain_h/* - 0.1f*/, 1); // NOTE: offsetting down
-
+			// NOTE: z coord is set below, when terrain heights are evaluated in batch.
 			//const float base_scale = 3.f;
 
 			const float scale_factor =  (rng.unitRandom() * rng.unitRandom() * rng.unitRandom());
 			const float scale_variation = base_scale / 3;//1.f;
 			VegetationLocationInfo info;
-			info.pos = use_pos;
+			info.pos = pos;
 			//info.width = 9.f + scale_factor * 2.f;
 			//info.height = base_height + scale_factor * height_variation;
 			info.scale = base_scale + scale_factor * scale_variation;
@@ -1208,6 +1206,24 @@ void TerrainScattering::buildVegLocationInfo(int chunk_x_index, int chunk_y_inde
 
 scatterpos_invalid: ; // Null statement for goto label.
 	}
+
+	// Evaluate terrain heights for the accepted positions in batch.
+	if(!locations_out.empty())
+	{
+		const size_t num_locations = locations_out.size();
+		glare::StackAllocation points_allocation(num_locations * sizeof(Vec2f), /*alignment=*/16, bump_allocator);
+		glare::StackAllocation heights_allocation(num_locations * sizeof(float), /*alignment=*/16, bump_allocator);
+		Vec2f* const points = (Vec2f*)points_allocation.ptr;
+		float* const heights = (float*)heights_allocation.ptr;
+
+		for(size_t i=0; i<num_locations; ++i)
+			points[i] = Vec2f(locations_out[i].pos[0], locations_out[i].pos[1]);
+
+		terrain_system_->evalTerrainHeightsForPoints(points, num_locations, /*quad_w=*/1.f, heights);
+
+		for(size_t i=0; i<num_locations; ++i)
+			locations_out[i].pos = Vec4f(points[i].x, points[i].y, heights[i]/* - 0.1f*/, 1); // NOTE: offsetting down
+	}
 }
 
 
@@ -1809,13 +1825,14 @@ void TerrainScattering::updateGridScatterChunkWithComputeShader(int chunk_x_inde
 		// Update AABB with approximate bounds
 		js::AABBox aabb_ws = js::AABBox::emptyAABBox();
 		const int N = 4;
+		const float sample_spacing = grid_scatter.chunk_width * (1.f / (N - 1));
 		for(int y=0; y<N; ++y)
-		for(int x=0; x<N; ++x)
 		{
-			const float p_x = (chunk_x_index + x * (1.f / (N - 1))) * grid_scatter.chunk_width;
-			const float p_y = (chunk_y_index + y * (1.f / (N - 1))) * grid_scatter.chunk_width;
-			const float p_z = terrain_system->evalTerrainHeight(p_x, p_y, 1.0f);
-			aabb_ws.enlargeToHoldPoint(Vec4f(p_x, p_y, p_z, 1));
+			const float p_y = chunk_y_index * grid_scatter.chunk_width + y * sample_spacing;
+			float row_z[N];
+			terrain_system->evalTerrainHeightsForRow(/*p_x=*/chunk_x_index * grid_scatter.chunk_width, p_y, /*dx=*/sample_spacing, N, /*quad_w=*/1.0f, row_z);
+			for(int x=0; x<N; ++x)
+				aabb_ws.enlargeToHoldPoint(Vec4f(chunk_x_index * grid_scatter.chunk_width + x * sample_spacing, p_y, row_z[x], 1));
 		}
 
 		// Expand AABB a little to handle finite size of imposters, and also terrain bumps/dips between sample positions
@@ -28,6 +28,7 @@ Copyright Glare Technologies Limited 2023 -
 #include "opengl/MeshPrimitiveBuilding.h"
 #include "meshoptimizer/src/meshoptimizer.h"
 #include "../dll/include/IndigoMesh.h"
+#include <limits>
 
 
 TerrainSystem::TerrainSystem()
@@ -762,24 +763,21 @@ float TerrainSystem::evalTreeMask(float p_x, float p_y) const
 }
 
 
-// p_x, p_y are world space coordinates.
-float TerrainSystem::evalTerrainHeight(float p_x, float p_y, float quad_w) const
+// Returns the terrain data section with the given indices, or NULL if the indices are out of bounds or the section has no heightmap.
+inline const TerrainDataSection* TerrainSystem::getSectionWithHeightmap(int section_x, int section_y) const
 {
-#if 1
-	const float MIN_TERRAIN_Z = -50.f; // Have a max under-sea depth.  This allows having a flat sea-floor, which in turn allows a lower-res mesh to be used for seafloor chunks.
-
-	const float nx = p_x * terrain_scale_factor + 0.5f; // Offset by 0.5 so that the central heightmap is centered at (0,0,0).
-	const float ny = p_y * terrain_scale_factor + 0.5f;
-
-	// Work out which source terrain data section we are reading from
-	const int section_x = Maths::floorToInt(nx) + TERRAIN_SECTION_OFFSET;
-	const int section_y = Maths::floorToInt(ny) + TERRAIN_SECTION_OFFSET;
-	if(section_x < 0 || section_x >= 8 || section_y < 0 || section_y >= 8)
-		return spec.default_terrain_z;
+	if(section_x < 0 || section_x >= TERRAIN_DATA_SECTION_RES || section_y < 0 || section_y >= TERRAIN_DATA_SECTION_RES)
+		return NULL;
 	const TerrainDataSection& section = terrain_data_sections[section_x + section_y*TERRAIN_DATA_SECTION_RES]; // terrain_data_sections.elem(section_x, section_y);
-	if(section.heightmap.isNull())
-		return spec.default_terrain_z;
+	return section.heightmap.nonNull() ? &section : NULL;
+}
+
 
+// p_x, p_y are world space coordinates, nx, ny are the corresponding normalised heightmap coordinates.
+// section is the section containing the point, and must have a non-null heightmap.
+inline float TerrainSystem::evalTerrainHeightInSection(const TerrainDataSection& section, float p_x, float p_y, float nx, float ny) const
+{
+	const float MIN_TERRAIN_Z = -50.f; // Have a max under-sea depth.  This allows having a flat sea-floor, which in turn allows a lower-res mesh to be used for seafloor chunks.
 
 	//const float dist_from_origin = Vec2f(p_x, p_y).length();
 	//const float centre_flatten_factor = Maths::smoothStep(700.f, 1000.f, dist_from_origin); // Start the hills only x metres from origin
@@ -848,6 +846,22 @@ float TerrainSystem::evalTerrainHeight(float p_x, float p_y, float quad_w) const
 		terrain_h += rock_height * 0.8f;
 	}
 	return terrain_h;
+}
+
+
+// p_x, p_y are world space coordinates.
+float TerrainSystem::evalTerrainHeight(float p_x, float p_y, float quad_w) const
+{
+#if 1
+	const float nx = p_x * terrain_scale_factor + 0.5f; // Offset by 0.5 so that the central heightmap is centered at (0,0,0).
+	const float ny = p_y * terrain_scale_factor + 0.5f;
+
+	// Work out which source terrain data section we are reading from
+	const TerrainDataSection* section = getSectionWithHeightmap(Maths::floorToInt(nx) + TERRAIN_SECTION_OFFSET, Maths::floorToInt(ny) + TERRAIN_SECTION_OFFSET);
+	if(!section)
+		return spec.default_terrain_z;
+
+	return evalTerrainHeightInSection(*section, p_x, p_y, nx, ny);
 
 #elif 0
 	//	return p_x * 0.01f;
@@ -926,6 +940,76 @@ float TerrainSystem::evalTerrainHeight(float p_x, float p_y, float quad_w) const
 }
 
 
+// Evaluates terrain heights at the points (p_x + i*dx, p_y) for i in [0, num_points), writing them to heights_out.
+// Gives the same results as calling evalTerrainHeight() for each point, but the y coordinate and section row are only computed once,
+// and the section lookup is shared by runs of points in the same section.
+void TerrainSystem::evalTerrainHeightsForRow(float p_x, float p_y, float dx, int num_points, float quad_w, float* heights_out) const
+{
+	const float ny = p_y * terrain_scale_factor + 0.5f;
+	const int section_y = Maths::floorToInt(ny) + TERRAIN_SECTION_OFFSET;
+	if(section_y < 0 || section_y >= TERRAIN_DATA_SECTION_RES)
+	{
+		for(int i=0; i<num_points; ++i)
+			heights_out[i] = spec.default_terrain_z;
+		return;
+	}
+
+	int last_section_x = std::numeric_limits<int>::min();
+	const TerrainDataSection* section = NULL;
+
+	for(int i=0; i<num_points; ++i)
+	{
+		const float px = i * dx + p_x;
+		const float nx = px * terrain_scale_factor + 0.5f;
+		const int section_x = Maths::floorToInt(nx) + TERRAIN_SECTION_OFFSET;
+		if(section_x != last_section_x)
+		{
+			section = getSectionWithHeightmap(section_x, section_y);
+			last_section_x = section_x;
+		}
+
+		heights_out[i] = section ? evalTerrainHeightInSection(*section, px, p_y, nx, ny) : spec.default_terrain_z;
+	}
+}
+
+
+// Evaluates terrain heights on a res_x * res_y grid of points, with heights_out.elem(x, y) = height at (p_x + x*spacing, p_y + y*spacing).
+void TerrainSystem::evalTerrainHeightsForTile(float p_x, float p_y, float spacing, int res_x, int res_y, float quad_w, Array2D<float>& heights_out) const
+{
+	heights_out.resizeNoCopy(res_x, res_y);
+
+	for(int y=0; y<res_y; ++y)
+		evalTerrainHeightsForRow(p_x, /*p_y=*/y * spacing + p_y, /*dx=*/spacing, /*num points=*/res_x, quad_w, /*heights_out=*/&heights_out.elem(0, y));
+}
+
+
+// Evaluates terrain heights at arbitrary points.
+// Points that are close together, for example scattered over a chunk, will mostly lie in the same section, so cache the last section looked up.
+void TerrainSystem::evalTerrainHeightsForPoints(const Vec2f* points, size_t num_points, float quad_w, float* heights_out) const
+{
+	int last_section_x = std::numeric_limits<int>::min();
+	int last_section_y = std::numeric_limits<int>::min();
+	const TerrainDataSection* section = NULL;
+
+	for(size_t i=0; i<num_points; ++i)
+	{
+		const float nx = points[i].x * terrain_scale_factor + 0.5f;
+		const float ny = points[i].y * terrain_scale_factor + 0.5f;
+
+		const int section_x = Maths::floorToInt(nx) + TERRAIN_SECTION_OFFSET;
+		const int section_y = Maths::floorToInt(ny) + TERRAIN_SECTION_OFFSET;
+		if(section_x != last_section_x || section_y != last_section_y)
+		{
+			section = getSectionWithHeightmap(section_x, section_y);
+			last_section_x = section_x;
+			last_section_y = section_y;
+		}
+
+		heights_out[i] = section ? evalTerrainHeightInSection(*section, points[i].x, points[i].y, nx, ny) : spec.default_terrain_z;
+	}
+}
+
+
 void TerrainSystem::makeTerrainChunkMesh(float chunk_x, float chunk_y, float chunk_w, bool build_physics_ob, TerrainChunkData& chunk_data_out) const
 {
 	//Timer timer;
@@ -965,18 +1049,19 @@ void TerrainSystem::makeTerrainChunkMesh(float chunk_x, float chunk_y, float chu
 	{
 		const int CHECK_RES = 32;
 		const float quad_w = chunk_w / (CHECK_RES - 1);
-		const float z_0 = evalTerrainHeight(chunk_x, chunk_y, quad_w);
+		float row_z[CHECK_RES];
+		float z_0 = 0;
 		for(int y=0; y<CHECK_RES; ++y)
-		for(int x=0; x<CHECK_RES; ++x)
 		{
-			const float p_x = x * quad_w + chunk_x;
-			const float p_y = y * quad_w + chunk_y;
-			const float z = evalTerrainHeight(p_x, p_y, quad_w);
-			if(z != z_0)
-			{
-				completely_flat = false;
-				goto done;
-			}
+			evalTerrainHeightsForRow(chunk_x, /*p_y=*/y * quad_w + chunk_y, /*dx=*/quad_w, CHECK_RES, quad_w, row_z);
+			if(y == 0)
+				z_0 = row_z[0];
+			for(int x=0; x<CHECK_RES; ++x)
+				if(row_z[x] != z_0)
+				{
+					completely_flat = false;
+					goto done;
+				}
 		}
 	}
 done:
@@ -1074,28 +1159,10 @@ done:
 
 	assert(in_vert_offset_B == vert_size_B);
 
-	Array2D<float> raw_heightfield(interior_vert_res, interior_vert_res);
-	// Array2D<Vec3f> raw_normals(interior_vert_res, interior_vert_res);
-	for(int y=0; y<interior_vert_res; ++y)
-	for(int x=0; x<interior_vert_res; ++x)
-	{
-		const float p_x = x * quad_w + chunk_x;
-		const float p_y = y * quad_w + chunk_y;
-	// 	const float dx = 0.1f;
-	// 	const float dy = 0.1f;
-	// 
-	 	const float z    = evalTerrainHeight(p_x,      p_y,      quad_w); // z = h(p_x, p_y)
-	// 	const float z_dx = evalTerrainHeight(p_x + dx, p_y,      quad_w, water); // z_dx = h(p_x + dx, dy)
-	// 	const float z_dy = evalTerrainHeight(p_x,      p_y + dy, quad_w, water); // z_dy = h(p_x, p_y + dy)
-	// 
-	// 	const Vec3f p_dx_minus_p(dx, 0, z_dx - z); // p(p_x + dx, dy) - p(p_x, p_y) = (p_x + dx, d_y, z_dx) - (p_x, p_y, z) = (d_x, 0, z_dx - z)
-	// 	const Vec3f p_dy_minus_p(0, dy, z_dy - z);
-	// 
-	// 	const Vec3f normal = normalise(crossProduct(p_dx_minus_p, p_dy_minus_p));
-	// 
-	 	raw_heightfield.elem(x, y) = z;
-	// 	raw_normals.elem(x, y) = normal;
-	}
+	// Evaluate heights at the interior vertices, plus an extra column and row past the +x and +y edges, 
+	// which are used for the forward differences when computing normals at the edge vertices.
+	Array2D<float> raw_heightfield;
+	evalTerrainHeightsForTile(chunk_x, chunk_y, /*spacing=*/quad_w, /*res_x=*/interior_vert_res + 1, /*res_y=*/interior_vert_res + 1, quad_w, /*heights_out=*/raw_heightfield);
 
 	//conPrint("eval terrain height took     " + timer.elapsedStringMSWIthNSigFigs(4));
 	//timer.reset();
@@ -1154,9 +1221,9 @@ done:
 
 		// Compute normal and height at vertex.
 		// For interior vertices, use central differences from adjacent vertices for computing the normal.
-		// This is fast because it avoids calling evalTerrainHeight().
-		// For edge vertices, compute normal using evalTerrainHeight() calls, since the resulting normal should match adjacent chunks more closely,
+		// For edge vertices, use forward differences, since the resulting normal should match adjacent chunks more closely,
 		// for example if the adjacent chunk has different tesselation resolution.
+		// Both just read from raw_heightfield, which was evaluated in batch.
 		float h;
 		Vec4f normal;
 		if(src_x >= 1 && src_x < interior_vert_res_minus_1 && src_y >= 1 && src_y < interior_vert_res_minus_1)
@@ -1170,16 +1237,13 @@ done:
 		}
 		else
 		{
-			// Use large deltas for consistency with the normal generation in the interior of the chunk, otherwise the chunk edge is visible due to different normal generation techniques.
-			const float dx = quad_w; 
-			const float dy = quad_w;
-			
-						h    = evalTerrainHeight(chunk_x + p_x,      chunk_y + p_y,      quad_w); // h(p_x, p_y)
-			const float h_dx = evalTerrainHeight(chunk_x + p_x + dx, chunk_y + p_y,      quad_w); // h(p_x + dx, dy)
-			const float h_dy = evalTerrainHeight(chunk_x + p_x,      chunk_y + p_y + dy, quad_w); // h(p_x, p_y + dy)
+			// Use large deltas (a whole quad) for consistency with the normal generation in the interior of the chunk, otherwise the chunk edge is visible due to different normal generation techniques.
+						h    = raw_heightfield.elem(src_x,     src_y);     // h(p_x, p_y)
+			const float h_dx = raw_heightfield.elem(src_x + 1, src_y);     // h(p_x + quad_w, p_y)
+			const float h_dy = raw_heightfield.elem(src_x,     src_y + 1); // h(p_x, p_y + quad_w)
 			
-			const float dh_dx = (h_dx - h) * (1.f / dx);
-			const float dh_dy = (h_dy - h) * (1.f / dy);
+			const float dh_dx = (h_dx - h) * (1.f / quad_w);
+			const float dh_dy = (h_dy - h) * (1.f / quad_w);
 			
 			normal = normalise(Vec4f(-dh_dx, -dh_dy, 1, 0));
 		}
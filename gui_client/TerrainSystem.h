@@ -179,7 +179,14 @@ public:
 	float evalTreeMask(float p_x, float p_y) const; // Return value >= 0.5: tree allowed
 	float evalTerrainHeight(float p_x, float p_y, float quad_w) const;
 
+	// Batch versions of evalTerrainHeight().  These give the same heights, but are faster, since section lookups are shared between points.
+	void evalTerrainHeightsForRow(float p_x, float p_y, float dx, int num_points, float quad_w, float* heights_out) const; // Evaluates at (p_x + i*dx, p_y) for i in [0, num_points)
+	void evalTerrainHeightsForTile(float p_x, float p_y, float spacing, int res_x, int res_y, float quad_w, Array2D<float>& heights_out) const; // heights_out.elem(x, y) = height at (p_x + x*spacing, p_y + y*spacing)
+	void evalTerrainHeightsForPoints(const Vec2f* points, size_t num_points, float quad_w, float* heights_out) const;
+
 private:
+	const TerrainDataSection* getSectionWithHeightmap(int section_x, int section_y) const;
+	float evalTerrainHeightInSection(const TerrainDataSection& section, float p_x, float p_y, float nx, float ny) const;
 	void makeTerrainChunkMesh(float chunk_x, float chunk_y, float chunk_w, bool build_physics_ob, TerrainChunkData& chunk_data_out) const;
 	void updateSubtree(TerrainNode* node, const Vec3d& campos);
 	void removeSubtree(TerrainNode* node, std::vector<GLObjectRef>& old_children_gl_obs_in_out, std::vector<PhysicsObjectRef>& old_children_phys_obs_in_out);
@@ -797,6 +797,32 @@ void TerrainTests::testTerrainSystem(TerrainSystem& terrain_system)
 {
 	conPrint("testTerrainSystem()");
 
+	// Check batch height evaluation gives the same results as evalTerrainHeight()
+	{
+		const float p_x = 1463.f;
+		const float p_y = 1883.9f;
+		const float spacing = 0.37f;
+		const int res = 37;
+
+		Array2D<float> tile_heights;
+		terrain_system.evalTerrainHeightsForTile(p_x, p_y, spacing, res, res, /*quad_w=*/spacing, tile_heights);
+
+		std::vector<Vec2f> points;
+		for(int y=0; y<res; ++y)
+		for(int x=0; x<res; ++x)
+			points.push_back(Vec2f(x * spacing + p_x, y * spacing + p_y));
+		std::vector<float> point_heights(points.size());
+		terrain_system.evalTerrainHeightsForPoints(points.data(), points.size(), /*quad_w=*/spacing, point_heights.data());
+
+		for(int y=0; y<res; ++y)
+		for(int x=0; x<res; ++x)
+		{
+			const float h = terrain_system.evalTerrainHeight(x * spacing + p_x, y * spacing + p_y, /*quad_w=*/spacing);
+			testAssert(std::fabs(tile_heights.elem(x, y) - h) < 1.0e-3f);
+			testAssert(std::fabs(point_heights[x + y * res] - h) < 1.0e-3f);
+		}
+	}
+
 	double min_time = 1.0e10;
 	for(int i=0; i<1000; ++i)
 	{
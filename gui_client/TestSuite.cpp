@@ -11,8 +11,20 @@ Copyright Glare Technologies Limited 2023 -
 #include "TerrainTests.h"
 #include "URLParser.h"
 #include "CameraController.h"
+#include "HashedObGrid.h"
+#include "DistanceBandQueue.h"
+#include "ScriptedObjectProximityChecker.h"
+#include "ObjectLODTable.h"
+#include "FrameWorkScheduler.h"
+#include "ClientBenchmark.h"
+#include "NetCapture.h"
+#include "DownloadResourcesThread.h"
+#include "StreamingGIFDecoder.h"
+#include "PhysicsShapeCache.h"
 #include "../shared/VoxelMeshBuilding.h"
 #include "../shared/LODGeneration.h"
+#include "../shared/GPUMesh.h"
+#include "../shared/PackedResourceCache.h"
 #include "../shared/ImageDecoding.h"
 #include "../physics/TreeTest.h"
 #include "../opengl/TextureLoading.h"
@@ -62,6 +74,8 @@ Copyright Glare Technologies Limited 2023 -
 #include "../utils/DatabaseTests.h"
 #include "../utils/TaskTests.h"
 #include "../audio/AudioResampler.h"
+#include "../audio/AudioEngine.h"
+#include "../audio/VoiceJitterBuffer.h"
 #include "../networking/URL.h"
 #include "../networking/TLSSocketTests.h"
 #include "../networking/HTTPClient.h"
@@ -153,6 +167,8 @@ void TestSuite::test()
 	runTest([&]() { SmallArrayTest::test(); });
 	runTest([&]() { SmallVectorTest::test(); });
 	runTest([&]() { glare::AudioResampler::test(); });
+	runTest([&]() { glare::AudioEngine::testWithoutDevice(); });
+	runTest([&]() { glare::VoiceJitterBuffer::test(); });
 	runTest([&]() { Sort::test(); });
 	runTest([&]() { glare::BestFitAllocator::test(); });
 	runTest([&]() { testSRGBUtils(); });
@@ -176,13 +192,25 @@ void TestSuite::test()
 	runTest([&]() { js::AABBox::test(); });
 	runTest([&]() { ReferenceTest::run(); });
 	runTest([&]() { CameraController::test(); });
+	runTest([&]() { HashedObGrid::test(); });
+	runTest([&]() { testDistanceBandQueue(); });
+	runTest([&]() { ScriptedObjectProximityChecker::test(); });
+	runTest([&]() { ObjectLODTable::test(); });
+	runTest([&]() { FrameWorkScheduler::test(); });
+	runTest([&]() { ClientBenchmark::test(); });
+	runTest([&]() { NetCaptureReader::test(); });
+	runTest([&]() { DownloadResourcesThread::test(); });
 
 #if !defined(EMSCRIPTEN)
 
 	// These tests tend to use testfiles that we don't currently package for the Emscripten build, so don't run them.
 	runTest([&]() { JSONParser::test(); });
 	runTest([&]() { FileUtils::doUnitTests(); });
+	runTest([&]() { PackedResourceCache::test(); });
+	runTest([&]() { StreamingGIFDecoder::test(); });
+	runTest([&]() { PhysicsShapeCache::test(); });
 	runTest([&]() { LODGeneration::test(); });
+	runTest([&]() { GPUMesh::test(); });
 	runTest([&]() { MeshSimplification::test(); });
 	runTest([&]() { PhysicsWorld::test(); });
 	runTest([&]() { FormatDecoderGLTF::test(); });
@@ -8,6 +8,7 @@ Generated at 2016-01-16 22:59:23 +1300
 
 
 #include "WorldState.h"
+#include "../shared/PackedResourceCache.h"
 #include <MessageableThread.h>
 #include <Platform.h>
 #include <MyThread.h>
@@ -37,6 +38,8 @@ public:
 
 	virtual void doRun();
 
+	PackedResourceCache::PinRef local_file_pin; // If set, the file at local_path was extracted from the packed cache.  Held until the thread is destroyed, so the file isn't deleted during the upload.
+
 private:
 	//ThreadSafeQueue<Reference<ThreadMessage> >* out_msg_queue;
 	std::string local_path, resource_URL;
@@ -29,6 +29,8 @@ WorldState::~WorldState()
 {
 	delete url_whitelist;
 
+	lod_table.clear(); // Remove table pointers from objects, while objects are still alive.
+
 	dirty_from_remote_objects.clear();
 	dirty_from_local_objects.clear();
 
@@ -12,6 +12,7 @@ Copyright Glare Technologies Limited 2022 -
 #include "../shared/GroundPatch.h"
 #include "../shared/WorldStateLock.h"
 #include "../shared/LODChunk.h"
+#include "ObjectLODTable.h"
 #include <ThreadSafeRefCounted.h>
 #include <FastIterMap.h>
 #include <Mutex.h>
@@ -48,6 +49,8 @@ public:
 	std::unordered_set<WorldObjectRef, WorldObjectRefHash> dirty_from_remote_objects GUARDED_BY(mutex);
 	std::unordered_set<WorldObjectRef, WorldObjectRefHash> dirty_from_local_objects GUARDED_BY(mutex);
 
+	ObjectLODTable lod_table GUARDED_BY(mutex); // LOD-relevant fields of objects, used by GUIClient::checkForLODChanges().
+
 	std::map<ParcelID, ParcelRef> parcels GUARDED_BY(mutex);
 	std::unordered_set<ParcelRef, ParcelRefHash> dirty_from_remote_parcels GUARDED_BY(mutex);
 	std::unordered_set<ParcelRef, ParcelRefHash> dirty_from_local_parcels GUARDED_BY(mutex);
@@ -110,7 +110,8 @@ public:
 	LightMapperBot(const std::string& server_hostname_, int server_port_, ResourceManagerRef& resource_manager_, struct tls_config* client_tls_config_)
 	:	server_hostname(server_hostname_), server_port(server_port_), resource_manager(resource_manager_), client_tls_config(client_tls_config_)
 	{
-		resource_download_thread_manager.addThread(new DownloadResourcesThread(&msg_queue, resource_manager, server_hostname, server_port, &this->num_non_net_resources_downloading, client_tls_config, &download_queue));
+		resource_download_thread_manager.addThread(new DownloadResourcesThread(&msg_queue, resource_manager, server_hostname, server_port, &this->num_non_net_resources_downloading, client_tls_config, &download_queue,
+			/*stats=*/NULL, /*connection_index=*/0));
 
 		for(int i=0; i<4; ++i)
 			net_resource_download_thread_manager.addThread(new NetDownloadResourcesThread(&msg_queue, resource_manager, &num_net_resources_downloading));
@@ -485,7 +486,7 @@ public:
 			{
 				const WorldMaterialRef ob_mat = ob->materials[i];
 
-				Indigo::SceneNodeMaterialRef indigo_mat_node = IndigoConversion::convertMaterialToIndigoMat(*ob_mat, *resource_manager);
+				Indigo::SceneNodeMaterialRef indigo_mat_node = IndigoConversion::convertMaterialToIndigoMat(*ob_mat, *resource_manager, extracted_file_pins);
 
 				if(ob_mat->emission_lum_flux_or_lum > 0)
 				{
@@ -1205,11 +1206,11 @@ public:
 	}
 
 
-	void doLightMapping(WorldState& world_state, Reference<ClientThread>& client_thread_, ThreadSafeQueue<Reference<ThreadMessage> >& external_msg_queue)
-	{
-		conPrint("---------------doLightMapping()-----------------");
-		this->client_thread = client_thread_;
-
+	void doLightMapping(WorldState& world_state, Reference<ClientThread>& client_thread_, ThreadSafeQueue<Reference<ThreadMessage> >& external_msg_queue)
+	{
+		conPrint("---------------doLightMapping()-----------------");
+		this->client_thread = client_thread_;
+
 		try
 		{
 			//============= Do an initial scan over all objects, to see if any of them need lightmapping ===========
@@ -1341,6 +1342,7 @@ public:
 	glare::TaskManager task_manager;
 
 	ResourceManagerRef& resource_manager;
+	std::vector<PackedResourceCache::PinRef> extracted_file_pins; // For texture files read by Indigo.  Empty unless the resource manager has a packed cache.
 
 	ThreadManager resource_download_thread_manager;
 	ThreadManager net_resource_download_thread_manager;
@@ -1362,9 +1364,9 @@ public:
 };
 
 
-struct LightMapperBotConfig
-{
-	std::string lightmapper_bot_password;
+struct LightMapperBotConfig
+{
+	std::string lightmapper_bot_password;
 };
 
 
@@ -1385,7 +1387,7 @@ int main(int argc, char* argv[])
 	{
 		Clock::init();
 		Networking::init();
-		PlatformUtils::ignoreUnixSignals();
+		PlatformUtils::ignoreUnixSignals();
 		TLSSocket::initTLS();
 
 
@@ -10,13 +10,17 @@ Copyright Glare Technologies Limited 2023 -
 #include "ServerWorldState.h"
 #include "ServerSideScripting.h"
 #include "MeshLODGenThread.h"
+#include "LuaHTTPRequestManager.h"
 #include "../shared/ImageDecoding.h"
+#include "../shared/RateLimiter.h"
 #include <ConPrint.h>
 #include <Exception.h>
 #include <Lock.h>
 #include <StringUtils.h>
 #include <PlatformUtils.h>
 #include <Timer.h>
+#include <Clock.h>
+#include <TestUtils.h>
 #include <TaskManager.h>
 #include <FileUtils.h>
 #include <IncludeXXHash.h>
@@ -25,6 +29,13 @@ Copyright Glare Technologies Limited 2023 -
 #include <graphics/ImageMap.h>
 
 
+static const double RESCAN_PERIOD = 300.0; // Rebuild the list of objects with dynamic textures this often (seconds).
+static const size_t MAX_CONCURRENT_FETCHES = 4;
+static const double HOST_RATE_LIMIT_PERIOD = 60.0;
+static const size_t HOST_RATE_LIMIT_MAX_REQUESTS = 10; // Max number of requests to a single host in HOST_RATE_LIMIT_PERIOD.
+static const int64 IF_MODIFIED_SINCE_CLOCK_SKEW_MARGIN = 300; // Seconds subtracted from our previous fetch time when using it as the If-Modified-Since time.  See fetchFileForURLAndAddAsResource().
+
+
 DynamicTextureUpdaterThread::DynamicTextureUpdaterThread(Server* server_, ServerAllWorldsState* world_state_)
 :	server(server_), world_state(world_state_)
 {
@@ -41,6 +52,7 @@ struct ObWithDynamicTexture
 	std::string world_name;
 	UID ob_uid;
 	Reference<ServerSideScripting::ServerSideScript> script;
+	double next_check_time; // In Clock::getTimeSinceInit() time.
 };
 
 
@@ -61,7 +73,7 @@ static void checkForDynamicTextureToCheck(const std::string& world_name, WorldOb
 					const User* user = user_res->second.ptr();
 					if(BitUtils::isBitSet(user->flags, User::ALLOW_DYN_TEX_UPDATE_CHECKING))
 					{
-						obs_with_dyn_textures_out.push_back({world_name, ob->uid, script});
+						obs_with_dyn_textures_out.push_back({world_name, ob->uid, script, /*next_check_time=*/0.0});
 					}
 					else
 					{
@@ -88,27 +100,93 @@ static std::string sanitiseString(const std::string& s)
 }
 
 
-struct DynTextureFetchResults
+// Formats a time as an HTTP-date (RFC 7231 IMF-fixdate), e.g. "Sun, 06 Nov 1994 08:49:37 GMT".
+static std::string formatHTTPDate(int64 secs_since_1970)
 {
-	std::string substrata_URL; // Set to empty string if exception occurred or download failed.
+	static const char* day_names[7] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+	static const char* month_names[12] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+	const int64 days = (secs_since_1970 >= 0) ? (secs_since_1970 / 86400) : ((secs_since_1970 - 86399) / 86400);
+	const int64 secs_in_day = secs_since_1970 - days * 86400;
+
+	// Convert days since 1970-01-01 to a civil date.  See http://howardhinnant.github.io/date_algorithms.html#civil_from_days
+	const int64 z = days + 719468;
+	const int64 era = ((z >= 0) ? z : (z - 146096)) / 146097;
+	const int64 doe = z - era * 146097; // [0, 146096]
+	const int64 yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365; // [0, 399]
+	const int64 doy = doe - (365*yoe + yoe/4 - yoe/100); // [0, 365]
+	const int64 mp = (5*doy + 2) / 153; // [0, 11]
+	const int64 day = doy - (153*mp + 2)/5 + 1; // [1, 31]
+	const int64 month = (mp < 10) ? (mp + 3) : (mp - 9); // [1, 12]
+	const int64 year = yoe + era * 400 + ((month <= 2) ? 1 : 0);
+
+	const int64 weekday = ((days % 7) + 11) % 7; // 1970-01-01 was a Thursday.
+
+	return std::string(day_names[weekday]) + ", " + ::leftPad(toString(day), '0', 2) + " " + month_names[month - 1] + " " + toString(year) + " " +
+		::leftPad(toString(secs_in_day / 3600), '0', 2) + ":" + ::leftPad(toString((secs_in_day / 60) % 60), '0', 2) + ":" + ::leftPad(toString(secs_in_day % 60), '0', 2) + " GMT";
+}
+
+
+// Information about the last successful fetch of a base URL.  Used for making conditional requests, and to avoid re-adding unchanged images as resources.
+struct URLFetchState
+{
+	URLFetchState() : content_hash(0), fetch_time(0) {}
+
+	std::string substrata_URL; // URL of the resource for the last fetched image.  Empty if never successfully fetched.
+	uint64 content_hash; // XXH64 hash of the last fetched image data.
+	double fetch_time; // Time (seconds since 1970) at which the last successful fetch was started.
 };
 
 
-// Returns substrata URL of resource for the downloaded file.
-static std::string fetchFileForURLAndAddAsResource(const std::string& base_URL, ServerAllWorldsState* world_state)
+// Downloads the image at base_URL, adds it as a resource if it is a new image, and returns the updated fetch state in state_out.
+// If there was a previous successful fetch, makes a conditional request, so that the webserver can reply with 304 Not Modified.
+//
+// HTTPClient doesn't give us the Last-Modified or ETag response headers, so we use our own previous fetch time as the If-Modified-Since validator.
+// Webservers compare If-Modified-Since against the Last-Modified time of the file, which comes from the webserver's clock, not ours.
+// If the webserver's clock is behind ours, a file modified just after our previous fetch would have a Last-Modified time before our fetch time,
+// and we would get a 304 response and miss the change.  So we subtract IF_MODIFIED_SINCE_CLOCK_SKEW_MARGIN, which handles clock differences of up to 5 minutes.
+// The cost is that a file modified within the margin before our previous fetch gets a spurious 200 response, which is caught by the content hash check below.
+static void fetchFileForURLAndAddAsResource(const std::string& base_URL, const URLFetchState& prev_state, ServerAllWorldsState* world_state, URLFetchState& state_out)
 {
+	const double fetch_time = Clock::getSecsSince1970();
+
 	HTTPClient http_client;
 	http_client.setAsNotIndependentlyHeapAllocated();
 	http_client.max_data_size			= 32 * 1024 * 1024; // 32 MB
 	http_client.max_socket_buffer_size	= 32 * 1024 * 1024; // 32 MB
 
+	const bool have_prev_fetch = !prev_state.substrata_URL.empty();
+	if(have_prev_fetch)
+		http_client.additional_headers.push_back("If-Modified-Since: " + formatHTTPDate((int64)prev_state.fetch_time - IF_MODIFIED_SINCE_CLOCK_SKEW_MARGIN));
+
 	std::vector<uint8> data;
 	HTTPClient::ResponseInfo response = http_client.downloadFile(base_URL, data);
 
+	if(have_prev_fetch && (response.response_code == 304))
+	{
+		conPrint("\tDynamicTextureUpdaterThread: Got HTTP 304 Not Modified response.");
+
+		state_out = prev_state;
+		state_out.fetch_time = fetch_time;
+		return;
+	}
+
 	if(response.response_code >= 200 && response.response_code < 300)
 	{
 		conPrint("\tDynamicTextureUpdaterThread: Got HTTP " + toString(response.response_code) + " response, file size: " + ::getNiceByteSize(data.size()));
 
+		const uint64 hash = XXH64(data.data(), data.size(), /*seed=*/1);
+
+		// If the data is the same as the last fetched data, it has already been validated and added as a resource.
+		if(have_prev_fetch && (hash == prev_state.content_hash))
+		{
+			conPrint("\tDynamicTextureUpdaterThread: Image is unchanged since last fetch.");
+
+			state_out = prev_state;
+			state_out.fetch_time = fetch_time;
+			return;
+		}
+
 		// If original URL didn't have a file extension in it, pick one based on MIME type
 		std::string use_extension = sanitiseString(::getExtension(base_URL));
 		if(use_extension.empty())
@@ -130,8 +208,6 @@ static std::string fetchFileForURLAndAddAsResource(const std::string& base_URL,
 		if(!ImageDecoding::areMagicBytesValid(data.data(), data.size(), use_extension))
 			throw glare::Exception("Image magic bytes are not valid for extension '" + use_extension + "'.");
 
-		const uint64 hash = XXH64(data.data(), data.size(), /*seed=*/1);
-
 		const std::string URL = ResourceManager::URLForNameAndExtensionAndHash(::removeDotAndExtension(base_URL), use_extension, hash);
 
 		conPrint("\tDynamicTextureUpdaterThread: current/new URL: " + URL + "");
@@ -161,117 +237,121 @@ static std::string fetchFileForURLAndAddAsResource(const std::string& base_URL,
 			}
 		} // End lock scope
 
-		return URL;
+		state_out.substrata_URL = URL;
+		state_out.content_hash = hash;
+		state_out.fetch_time = fetch_time;
 	}
 	else
-		throw glare::Exception("Non 200 HTTP return code: " + toString(response.response_code) + ", msg: '" + response.response_message + "'"); 
+		throw glare::Exception("Non 200 HTTP return code: " + toString(response.response_code) + ", msg: '" + response.response_message + "'");
 
 }
 
 
-static void checkDynamicTexture(const ObWithDynamicTexture& ob_with_dyn_tex, ServerAllWorldsState* world_state, Server* server, std::map<std::string, DynTextureFetchResults>& fetch_results_map)
+// Fetches a single base URL.  The number of concurrent fetches is bounded by the number of threads in the task manager.
+class DynTexFetchTask : public glare::Task
 {
-	const std::string base_URL = ob_with_dyn_tex.script->base_image_URL;
+public:
+	DynTexFetchTask() : succeeded(false) {}
 
-	const auto fetch_it = fetch_results_map.find(base_URL);
-	if(fetch_it == fetch_results_map.end())
+	virtual void run(size_t thread_index)
 	{
-		conPrint("\tDynamicTextureUpdaterThread: Requesting file at URL '" + ob_with_dyn_tex.script->base_image_URL + "'...");
-
+		conPrint("\tDynamicTextureUpdaterThread: Requesting file at URL '" + base_URL + "'...");
 		try
 		{
-			const std::string substrata_URL = fetchFileForURLAndAddAsResource(base_URL, world_state);
-
-			fetch_results_map[base_URL] = DynTextureFetchResults({substrata_URL});
+			fetchFileForURLAndAddAsResource(base_URL, prev_state, world_state, new_state);
+			succeeded = true;
 		}
 		catch(glare::Exception& e)
 		{
 			conPrint("\tDynamicTextureUpdaterThread: Excep fetching URL '" + base_URL + "': " + e.what());
-			fetch_results_map[base_URL] = DynTextureFetchResults({""});
+		}
+		catch(std::exception& e) // catch std::bad_alloc etc..
+		{
+			conPrint("\tDynamicTextureUpdaterThread: Caught std::exception fetching URL '" + base_URL + "': " + e.what());
 		}
 	}
 
-	assert(fetch_results_map.count(base_URL) > 0);
-	DynTextureFetchResults fetch_results = fetch_results_map[base_URL];
+	std::string base_URL;
+	URLFetchState prev_state;
+	ServerAllWorldsState* world_state;
 
-	if(fetch_results.substrata_URL.empty())
-	{
-		// We already tried to fetch from this URL, and it failed.
-		conPrint("\tDynamicTextureUpdaterThread: Fetch for URL '" + base_URL + "' failed, skipping");
-	}
-	else
-	{
-		{
-			WorldStateLock lock(world_state->mutex);
+	URLFetchState new_state; // Valid if succeeded is true.
+	bool succeeded;
+};
 
-			const std::string substrata_URL = fetch_results.substrata_URL;
 
-			// Update object to use new texture
-			const auto ob_res = world_state->world_states[ob_with_dyn_tex.world_name]->getObjects(lock).find(ob_with_dyn_tex.ob_uid);
-			if(ob_res != world_state->world_states[ob_with_dyn_tex.world_name]->getObjects(lock).end())
-			{
-				WorldObject* ob = ob_res->second.ptr();
+// Assign the texture with the given substrata URL to the object material, if it is not already assigned.
+static void applyDynamicTexture(const ObWithDynamicTexture& ob_with_dyn_tex, const std::string& substrata_URL, ServerAllWorldsState* world_state, Server* server)
+{
+	WorldStateLock lock(world_state->mutex);
 
-				if(ob_with_dyn_tex.script->material_index < ob->materials.size())
-				{
-					WorldMaterial* material = ob->materials[ob_with_dyn_tex.script->material_index].ptr();
+	const auto world_res = world_state->world_states.find(ob_with_dyn_tex.world_name);
+	if(world_res == world_state->world_states.end())
+		return;
+	ServerWorldState* world = world_res->second.ptr();
 
-					bool tex_URL_changed = false;
-					if(ob_with_dyn_tex.script->material_texture == "colour")
-					{
-						if(substrata_URL != material->colour_texture_url) // If new URL is different from existing texture URL:
-						{
-							material->colour_texture_url = substrata_URL;
-							tex_URL_changed = true;
-						}
-					}
-					else if(ob_with_dyn_tex.script->material_texture == "emission")
-					{
-						if(substrata_URL != material->emission_texture_url) // If new URL is different from existing texture URL:
-						{
-							material->emission_texture_url = substrata_URL;
-							tex_URL_changed = true;
-						}
-					}
-					else
-						throw glare::Exception("Invalid material_texture type");
+	// Update object to use new texture
+	const auto ob_res = world->getObjects(lock).find(ob_with_dyn_tex.ob_uid);
+	if(ob_res != world->getObjects(lock).end())
+	{
+		WorldObject* ob = ob_res->second.ptr();
 
-					if(tex_URL_changed) // If new URL is different from existing texture URL:
-					{
-						conPrint("\tDynamicTextureUpdaterThread: Texture is different from existing texture, updating object...");
+		if(ob_with_dyn_tex.script->material_index < ob->materials.size())
+		{
+			WorldMaterial* material = ob->materials[ob_with_dyn_tex.script->material_index].ptr();
+			const Reference<WorldMaterial> old_material = material->clone();
 
-						world_state->world_states[ob_with_dyn_tex.world_name]->addWorldObjectAsDBDirty(ob, lock);
-						world_state->markAsChanged();
+			if(ob_with_dyn_tex.script->material_texture == "colour")
+				material->colour_texture_url = substrata_URL;
+			else if(ob_with_dyn_tex.script->material_texture == "emission")
+				material->emission_texture_url = substrata_URL;
+			else
+				throw glare::Exception("Invalid material_texture type");
 
-						ob->from_remote_other_dirty = true; // Set this so a ObjectFullUpdate message is sent to clients.
-						world_state->world_states[ob_with_dyn_tex.world_name]->getDirtyFromRemoteObjects(lock).insert(ob);
+			// Clears the Basis textures present flag if the texture changed, as the Basis textures are for the old texture.
+			const bool tex_URL_changed = material->updateBasisTexturesPresentFlag(old_material.ptr());
+			if(tex_URL_changed) // If new URL is different from existing texture URL:
+			{
+				conPrint("\tDynamicTextureUpdaterThread: Texture is different from existing texture, updating object...");
 
-						// Send a message to MeshLODGenThread to generate LOD textures for this new texture (if not already generated)
-						CheckGenResourcesForObject* msg = new CheckGenResourcesForObject();
-						msg->ob_uid = ob_with_dyn_tex.ob_uid;
-						server->enqueueMsgForLodGenThread(msg);
-					}
-					else
-						conPrint("\tDynamicTextureUpdaterThread: Texture is the same as existing texture on object.");
-				}
+				world->addWorldObjectAsDBDirty(ob, lock);
+				world_state->markAsChanged();
+
+				ob->from_remote_other_dirty = true; // Set this so a ObjectFullUpdate message is sent to clients.
+				world->getDirtyFromRemoteObjects(lock).insert(ob);
+
+				// Send a message to MeshLODGenThread to generate LOD textures for this new texture (if not already generated)
+				CheckGenResourcesForObject* msg = new CheckGenResourcesForObject();
+				msg->ob_uid = ob_with_dyn_tex.ob_uid;
+				server->enqueueMsgForLodGenThread(msg);
 			}
-		} // End lock scope
+		}
 	}
 }
 
 
+static std::string makeObKey(const std::string& world_name, const UID& ob_uid)
+{
+	return world_name + "|" + ob_uid.toString();
+}
+
+
 void DynamicTextureUpdaterThread::doRun()
 {
 	PlatformUtils::setCurrentThreadName("DynamicTextureUpdaterThread");
 
 	try
 	{
+		glare::TaskManager task_manager("DynamicTextureUpdaterThread fetch task manager", MAX_CONCURRENT_FETCHES);
+
+		std::map<std::string, ObWithDynamicTexture> scheduled_obs; // Map from world name + object UID (see makeObKey()) to object info and next check time.
+		std::map<std::string, URLFetchState> url_fetch_states; // Map from base URL to info about the last successful fetch.
+		std::map<std::string, Reference<RateLimiter>> host_rate_limiters; // Map from host to rate limiter for that host.
+		double last_scan_time = -1.0e10;
+
 		while(1)
 		{
-			Timer time_since_last_scan;
-
-			//-------------------------------------------  Wait until we have a kill message, or N seconds have elapsed, or the force-update flag is set ------------------------------------------- 
-			while(time_since_last_scan.elapsed() < 3600.0)
+			//-------------------------------------------  Wait until we have a kill message, or a few seconds have elapsed -------------------------------------------
 			{
 				// Block for a while, or until we have a message
 				ThreadMessageRef msg;
@@ -281,69 +361,147 @@ void DynamicTextureUpdaterThread::doRun()
 					if(dynamic_cast<KillThreadMessage*>(msg.ptr()))
 						return;
 				}
+			}
 
-				// Check if the force-update flag is set (can be set in admin web interface).  If so, abort wait.
+			// Check if the force-update flag is set (can be set in admin web interface).
+			bool force_update = false;
+			{
+				Lock lock(world_state->mutex);
+				if(world_state->force_dyn_tex_update)
 				{
-					Lock lock(world_state->mutex);
-					if(world_state->force_dyn_tex_update)
-					{
-						world_state->force_dyn_tex_update = false;
-						break;
-					}
+					world_state->force_dyn_tex_update = false;
+					force_update = true;
 				}
 			}
 
-			//-------------------------------------------  Iterate over objects, get list of objects using dynamic textures -------------------------------------------
-			conPrint("DynamicTextureUpdaterThread: Iterating over world object(s)...");
-			Timer timer;
-			std::vector<ObWithDynamicTexture> obs_with_dyn_textures;
+			const double cur_time = Clock::getTimeSinceInit();
 
+			//-------------------------------------------  Periodically iterate over objects, rebuild list of objects using dynamic textures -------------------------------------------
+			if(force_update || (cur_time - last_scan_time >= RESCAN_PERIOD))
 			{
-				WorldStateLock lock(world_state->mutex);
+				conPrint("DynamicTextureUpdaterThread: Iterating over world object(s)...");
+				Timer timer;
+				std::vector<ObWithDynamicTexture> obs_with_dyn_textures;
 
-				for(auto world_it = world_state->world_states.begin(); world_it != world_state->world_states.end(); ++world_it)
 				{
-					ServerWorldState* world = world_it->second.ptr();
-					ServerWorldState::ObjectMapType& objects = world->getObjects(lock);
-					for(auto it = objects.begin(); it != objects.end(); ++it)
+					WorldStateLock lock(world_state->mutex);
+
+					for(auto world_it = world_state->world_states.begin(); world_it != world_state->world_states.end(); ++world_it)
 					{
-						WorldObject* ob = it->second.ptr();
-						try
+						ServerWorldState* world = world_it->second.ptr();
+						ServerWorldState::ObjectMapType& objects = world->getObjects(lock);
+						for(auto it = objects.begin(); it != objects.end(); ++it)
 						{
-							checkForDynamicTextureToCheck(/*world name=*/world_it->first, ob, world_state, obs_with_dyn_textures);
-						}
-						catch(glare::Exception& e)
-						{
-							conPrint("\tDynamicTextureUpdaterThread: exception while processing object: " + e.what());
+							WorldObject* ob = it->second.ptr();
+							try
+							{
+								checkForDynamicTextureToCheck(/*world name=*/world_it->first, ob, world_state, obs_with_dyn_textures);
+							}
+							catch(glare::Exception& e)
+							{
+								conPrint("\tDynamicTextureUpdaterThread: exception while processing object: " + e.what());
+							}
 						}
 					}
+				} // End lock scope
+
+				// Rebuild scheduled_obs, keeping the next check time for objects we already know about.  New objects are checked straight away.
+				std::map<std::string, ObWithDynamicTexture> new_scheduled_obs;
+				for(size_t i=0; i<obs_with_dyn_textures.size(); ++i)
+				{
+					ObWithDynamicTexture& ob_with_dyn_tex = obs_with_dyn_textures[i];
+					const std::string key = makeObKey(ob_with_dyn_tex.world_name, ob_with_dyn_tex.ob_uid);
+
+					const auto existing = scheduled_obs.find(key);
+					ob_with_dyn_tex.next_check_time = (existing != scheduled_obs.end() && !force_update) ? existing->second.next_check_time : cur_time;
+					new_scheduled_obs[key] = ob_with_dyn_tex;
 				}
-			} // End lock scope
+				scheduled_obs.swap(new_scheduled_obs);
+
+				if(force_update)
+					url_fetch_states.clear(); // Do full (non-conditional) fetches when forced.
 
-			conPrint("DynamicTextureUpdaterThread: Iterating over objects took " + timer.elapsedStringNSigFigs(4) + ", obs_with_dyn_textures: " + toString(obs_with_dyn_textures.size()));
+				last_scan_time = cur_time;
+
+				conPrint("DynamicTextureUpdaterThread: Iterating over objects took " + timer.elapsedStringNSigFigs(4) + ", obs_with_dyn_textures: " + toString(obs_with_dyn_textures.size()));
+			}
 			//----------------------------------------------------------------------------------------------------------------------------------------------------
 
-			//-------------------------------------------  Check each dynamic texture, without holding the world lock -------------------------------------------
-			conPrint("DynamicTextureUpdaterThread: Checking for image updates...");
-			timer.reset();
+			//-------------------------------------------  Get objects that are due for a check, grouped by base URL -------------------------------------------
+			std::map<std::string, std::vector<ObWithDynamicTexture*>> due_obs_for_URL;
+			for(auto it = scheduled_obs.begin(); it != scheduled_obs.end(); ++it)
+				if(cur_time >= it->second.next_check_time)
+					due_obs_for_URL[it->second.script->base_image_URL].push_back(&it->second);
 
-			std::map<std::string, DynTextureFetchResults> fetch_results_map;
+			if(due_obs_for_URL.empty())
+				continue;
+
+			//-------------------------------------------  Fetch due URLs concurrently, without holding the world lock -------------------------------------------
+			conPrint("DynamicTextureUpdaterThread: Checking for image updates for " + toString(due_obs_for_URL.size()) + " URL(s)...");
+			Timer timer;
 
-			for(size_t i=0; i<obs_with_dyn_textures.size(); ++i)
+			std::vector<Reference<DynTexFetchTask>> tasks;
+			for(auto it = due_obs_for_URL.begin(); it != due_obs_for_URL.end(); ++it)
 			{
-				const ObWithDynamicTexture& ob_with_dyn_tex = obs_with_dyn_textures[i];
-				try
-				{
-					conPrint("DynamicTextureUpdaterThread: Checking dynamic texture for URL '" + ob_with_dyn_tex.script->base_image_URL + "'");
+				const std::string& base_URL = it->first;
+
+				// Look up rate limiter for the host.  If we have made too many requests to the host recently, leave the objects due, they will be tried again later.
+				Reference<RateLimiter>& rate_limiter = host_rate_limiters[LuaHTTPRequestManager::getHostForURL(base_URL)];
+				if(rate_limiter.isNull())
+					rate_limiter = new RateLimiter(HOST_RATE_LIMIT_PERIOD, HOST_RATE_LIMIT_MAX_REQUESTS);
 
-					checkDynamicTexture(ob_with_dyn_tex, world_state, server, fetch_results_map);
+				if(!rate_limiter->checkAddEvent(cur_time))
+				{
+					conPrint("\tDynamicTextureUpdaterThread: Rate limited for host of URL '" + base_URL + "', deferring fetch.");
+					continue;
 				}
-				catch(glare::Exception& e)
+
+				Reference<DynTexFetchTask> task = new DynTexFetchTask();
+				task->base_URL = base_URL;
+				const auto state_res = url_fetch_states.find(base_URL);
+				if(state_res != url_fetch_states.end())
+					task->prev_state = state_res->second;
+				task->world_state = world_state;
+				tasks.push_back(task);
+				task_manager.addTask(task);
+			}
+
+			task_manager.waitForTasksToComplete();
+
+			//-------------------------------------------  Apply results to objects, and schedule next checks -------------------------------------------
+			const double done_time = Clock::getTimeSinceInit();
+			for(size_t i=0; i<tasks.size(); ++i)
+			{
+				const DynTexFetchTask* task = tasks[i].ptr();
+				if(task->succeeded)
+					url_fetch_states[task->base_URL] = task->new_state;
+
+				const auto state_res = url_fetch_states.find(task->base_URL);
+				const std::string substrata_URL = (state_res != url_fetch_states.end()) ? state_res->second.substrata_URL : std::string();
+				if(substrata_URL.empty())
+					conPrint("\tDynamicTextureUpdaterThread: Fetch for URL '" + task->base_URL + "' failed, skipping");
+
+				std::vector<ObWithDynamicTexture*>& obs = due_obs_for_URL[task->base_URL];
+				for(size_t z=0; z<obs.size(); ++z)
 				{
-					conPrint("\tDynamicTextureUpdaterThread: glare::Exception while checking dynamic texture changes: " + e.what());
+					ObWithDynamicTexture* ob_with_dyn_tex = obs[z];
+					ob_with_dyn_tex->next_check_time = done_time + ob_with_dyn_tex->script->refresh_interval;
+
+					if(!substrata_URL.empty())
+					{
+						try
+						{
+							applyDynamicTexture(*ob_with_dyn_tex, substrata_URL, world_state, server);
+						}
+						catch(glare::Exception& e)
+						{
+							conPrint("\tDynamicTextureUpdaterThread: glare::Exception while checking dynamic texture changes: " + e.what());
+						}
+					}
 				}
 			}
-			conPrint("DynamicTextureUpdaterThread: Done checking for image updates textures. (Elapsed: " + timer.elapsedStringNSigFigs(4) + ")");
+
+			conPrint("DynamicTextureUpdaterThread: Done checking for image updates. (Elapsed: " + timer.elapsedStringNSigFigs(4) + ")");
 			//----------------------------------------------------------------------------------------------------------------------------------------------------
 		}
 	}
@@ -356,3 +514,22 @@ void DynamicTextureUpdaterThread::doRun()
 		conPrint(std::string("DynamicTextureUpdaterThread: Caught std::exception: ") + e.what());
 	}
 }
+
+
+#if BUILD_TESTS
+
+
+void DynamicTextureUpdaterThread::test()
+{
+	conPrint("DynamicTextureUpdaterThread::test()");
+
+	testAssert(formatHTTPDate(0) == "Thu, 01 Jan 1970 00:00:00 GMT");
+	testAssert(formatHTTPDate(784111777) == "Sun, 06 Nov 1994 08:49:37 GMT"); // Example from RFC 7231
+	testAssert(formatHTTPDate(951782400) == "Tue, 29 Feb 2000 00:00:00 GMT");
+	testAssert(formatHTTPDate(1700000000) == "Tue, 14 Nov 2023 22:13:20 GMT");
+
+	conPrint("DynamicTextureUpdaterThread::test() done.");
+}
+
+
+#endif // BUILD_TESTS
@@ -20,6 +20,10 @@ These scripts download an image from a fixed URL periodically,
 and if the image changes, add it as a resource to the substrata server,
 and assign the image to the specified object material.
 
+Each object is checked according to the refresh interval in its script.
+Due URLs are fetched concurrently (with a bounded number of fetches in flight),
+with conditional requests and per-host rate limiting.
+
 Note that this code runs on the server, so we have to be a bit careful with it.
 =====================================================================*/
 class DynamicTextureUpdaterThread : public MessageableThread
@@ -31,6 +35,8 @@ public:
 
 	virtual void doRun();
 
+	static void test();
+
 private:
 	Server* server;
 	ServerAllWorldsState* world_state;
@@ -9,15 +9,35 @@ Copyright Glare Technologies Limited 2024 -
 #include "LuaHTTPWorkerThread.h"
 #include "Server.h"
 #include "../shared/LuaScriptEvaluator.h"
+#include <utils/StringUtils.h>
+#include <utils/Clock.h>
+#include <utils/Lock.h>
+#include <utils/TestUtils.h>
+
+
+static const int NUM_WORKER_THREADS = 4;
+static const size_t MAX_IN_FLIGHT_PER_USER = 2;
+static const size_t MAX_IN_FLIGHT_PER_HOST = 2;
+static const size_t MAX_PENDING_PER_USER = 64;
+
+static const double RESPONSE_CACHE_TIME = 10.0; // How long successful GET responses are cached for, in seconds.
+static const size_t MAX_CACHED_RESPONSE_SIZE = 1 << 20; // Don't cache responses larger than this (1 MB).
+static const size_t MAX_NUM_CACHED_RESPONSES = 256;
+
+static const double MAX_POOLED_HTTP_CLIENT_IDLE_TIME = 30.0; // Idle HTTPClients (and their connections) are discarded after this many seconds.
+static const size_t MAX_IDLE_HTTP_CLIENTS_PER_KEY = 2;
 
 
 LuaHTTPRequestManager::LuaHTTPRequestManager(Server* server_)
-:	server(server_)
+:	server(server_),
+	total_num_in_flight(0),
+	last_cache_cleanup_time(0),
+	last_idle_http_client_cleanup_time(0)
 {
 	if(!server->config.do_lua_http_request_rate_limiting)
 		conPrint("Lua HTTP request rate limiting is disabled.");
 
-	for(int i=0; i<4; ++i)
+	for(int i=0; i<NUM_WORKER_THREADS; ++i)
 	{
 		thread_manager.addThread(new LuaHTTPWorkerThread(this));
 	}
@@ -34,40 +54,142 @@ LuaHTTPRequestManager::~LuaHTTPRequestManager()
 }
 
 
+// Make a copy of a result for another request.  Used for cached responses and coalesced requests.
+static Reference<LuaHTTPRequestResult> makeResultCopyForRequest(const LuaHTTPRequestResult& src, Reference<LuaHTTPRequest> request)
+{
+	Reference<LuaHTTPRequestResult> result = new LuaHTTPRequestResult();
+	result->request = request;
+	result->response = src.response;
+	result->data = src.data;
+	result->exception_msg = src.exception_msg;
+	result->error_code = src.error_code;
+	result->from_cache = true;
+	return result;
+}
+
+
 void LuaHTTPRequestManager::think()
 {
-	Lock lock(result_queue.getMutex());
-	
-	while(result_queue.unlockedNonEmpty())
+	// Take all results off the queue before processing them, so we don't hold the queue mutex while executing Lua callbacks
+	// (which may make new requests).
+	std::vector<Reference<LuaHTTPRequestResult>> results;
+	{
+		Lock lock(result_queue.getMutex());
+		while(result_queue.unlockedNonEmpty())
+			results.push_back(result_queue.unlockedDequeue());
+	}
+
+	const double cur_time = Clock::getTimeSinceInit();
+
+	for(size_t i=0; i<results.size(); ++i)
 	{
-		Reference<LuaHTTPRequestResult> result = result_queue.unlockedDequeue();
+		Reference<LuaHTTPRequestResult> result = results[i];
 
 		Reference<LuaHTTPRequest> request = result->request;
 
-		Reference<LuaScriptEvaluator> script_evaluator = request->lua_script_evaluator.upgradeToStrongRef();
-		if(script_evaluator)
+		if(request->dispatched)
 		{
-			WorldStateLock world_state_lock(server->world_state->mutex);
+			requestFinished(*request);
 
-			if(!result->exception_msg.empty())
+			if(!request->cache_key.empty())
 			{
-				// Call the script onError function
-				script_evaluator->doOnError(request->onError_ref, 
-					/*error code=*/result->error_code,
-					result->exception_msg, // error description
-					world_state_lock
-				);
+				if(result->exception_msg.empty() && (result->response.response_code >= 200) && (result->response.response_code < 300) && (result->data.size() <= MAX_CACHED_RESPONSE_SIZE))
+				{
+					if(response_cache.size() >= MAX_NUM_CACHED_RESPONSES)
+						response_cache.clear();
+
+					response_cache[request->cache_key] = CachedResponse({result, cur_time + RESPONSE_CACHE_TIME});
+				}
+
+				// Give the result to any identical requests that were made while this request was in flight.
+				auto coalesced_res = coalesced_requests.find(request->cache_key);
+				if(coalesced_res != coalesced_requests.end())
+				{
+					for(size_t z=0; z<coalesced_res->second.size(); ++z)
+						results.push_back(makeResultCopyForRequest(*result, coalesced_res->second[z]));
+
+					coalesced_requests.erase(coalesced_res);
+				}
 			}
-			else
+		}
+
+		Reference<LuaScriptEvaluator> script_evaluator = request->lua_script_evaluator.upgradeToStrongRef();
+		if(script_evaluator)
+		{
+			const UID script_ob_uid = script_evaluator->world_object->uid;
 			{
-				// Call the script onDone function
-				script_evaluator->doOnDone(request->onDone_ref, result, world_state_lock);
+				WorldStateLock world_state_lock(server->world_state->mutex);
+
+				if(!result->exception_msg.empty())
+				{
+					// Call the script onError function
+					script_evaluator->doOnError(request->onError_ref,
+						/*error code=*/result->error_code,
+						result->exception_msg, // error description
+						world_state_lock
+					);
+				}
+				else
+				{
+					// Call the script onDone function
+					script_evaluator->doOnDone(request->onDone_ref, result, world_state_lock);
+				}
 			}
+
+			logRequestStats(*request, *result, script_ob_uid, cur_time);
+		}
+	}
+
+	dispatchPendingRequests();
+
+	// Periodically remove expired cached responses.
+	if(cur_time - last_cache_cleanup_time > RESPONSE_CACHE_TIME)
+	{
+		for(auto it = response_cache.begin(); it != response_cache.end(); )
+		{
+			if(cur_time >= it->second.expiry_time)
+				it = response_cache.erase(it);
+			else
+				++it;
 		}
+		last_cache_cleanup_time = cur_time;
+	}
+
+	// Periodically close connections that have been idle for too long.
+	if(cur_time - last_idle_http_client_cleanup_time > MAX_POOLED_HTTP_CLIENT_IDLE_TIME)
+	{
+		closeIdleHTTPClients(cur_time);
+		last_idle_http_client_cleanup_time = cur_time;
 	}
 }
 
 
+// Requests may be cached if they are GET requests, and the script hasn't asked for a non-cached response.
+static bool isCacheableRequest(const LuaHTTPRequest& request)
+{
+	if(request.request_type != "GET")
+		return false;
+
+	for(size_t i=0; i<request.additional_headers.size(); ++i)
+	{
+		const std::string header = ::toLowerCase(request.additional_headers[i]);
+		if((hasPrefix(header, "cache-control:") || hasPrefix(header, "pragma:")) && (StringUtils::containsString(header, "no-cache") || StringUtils::containsString(header, "no-store")))
+			return false;
+	}
+	return true;
+}
+
+
+static std::string makeCacheKey(const LuaHTTPRequest& request)
+{
+	// Include the headers, since they may affect the response (e.g. Authorization).
+	std::string key = request.URL;
+	for(size_t i=0; i<request.additional_headers.size(); ++i)
+		key += "\n" + request.additional_headers[i];
+	return key;
+}
+
+
 void LuaHTTPRequestManager::enqueueHTTPRequest(Reference<LuaHTTPRequest> request)
 {
 	bool http_requests_enabled;
@@ -97,9 +219,56 @@ void LuaHTTPRequestManager::enqueueHTTPRequest(Reference<LuaHTTPRequest> request
 		else // Else if rate limiting disabled:
 			can_enqueue_request = true;
 
+		const auto user_queue_res = user_queues.find(request->script_user_id);
+		if(can_enqueue_request && (user_queue_res != user_queues.end()) && (user_queue_res->second.pending.size() >= MAX_PENDING_PER_USER))
+		{
+			Reference<LuaHTTPRequestResult> result = new LuaHTTPRequestResult();
+			result->request = request;
+			result->error_code = LuaHTTPRequestResult::ErrorCode_RateLimited;
+			result->exception_msg = "Rate limited: too many HTTP requests waiting to be made.";
+			result_queue.enqueue(result);
+			return;
+		}
+
 		if(can_enqueue_request)
 		{
-			request_queue.enqueue(request);
+			const double cur_time = Clock::getTimeSinceInit();
+			request->enqueue_time = cur_time;
+			request->host = getHostForURL(request->URL);
+			request->connection_pool_key = getConnectionPoolKeyForURL(request->URL);
+
+			if(isCacheableRequest(*request))
+			{
+				request->cache_key = makeCacheKey(*request);
+
+				// If we have a recent response for an identical request, use it.
+				auto cache_res = response_cache.find(request->cache_key);
+				if(cache_res != response_cache.end())
+				{
+					if(cur_time < cache_res->second.expiry_time)
+					{
+						result_queue.enqueue(makeResultCopyForRequest(*cache_res->second.result, request));
+						return;
+					}
+					response_cache.erase(cache_res);
+				}
+
+				// If an identical request is already pending or in flight, wait for its result.
+				auto coalesced_res = coalesced_requests.find(request->cache_key);
+				if(coalesced_res != coalesced_requests.end())
+				{
+					coalesced_res->second.push_back(request);
+					return;
+				}
+				coalesced_requests[request->cache_key]; // Create empty list of waiting requests, to mark this request as pending.
+			}
+
+			UserRequestQueue& user_queue = user_queues[request->script_user_id];
+			if(user_queue.pending.empty())
+				users_with_pending_requests.push_back(request->script_user_id);
+			user_queue.pending.push_back(request);
+
+			dispatchPendingRequests();
 		}
 		else
 		{
@@ -117,7 +286,306 @@ void LuaHTTPRequestManager::enqueueHTTPRequest(Reference<LuaHTTPRequest> request
 }
 
 
+// Hand pending requests to the worker threads, taking one request from each user in turn.
+// Requests are only dispatched while there is a free worker thread, so that requests don't build up in request_queue, where they would be processed in FIFO order.
+void LuaHTTPRequestManager::dispatchPendingRequests()
+{
+	const size_t max_num_in_flight = thread_manager.getNumThreads();
+
+	size_t num_users_checked_without_dispatch = 0;
+	while((total_num_in_flight < max_num_in_flight) && (num_users_checked_without_dispatch < users_with_pending_requests.size()))
+	{
+		const UserID user_id = users_with_pending_requests.front();
+		users_with_pending_requests.pop_front();
+
+		UserRequestQueue& user_queue = user_queues[user_id];
+		assert(!user_queue.pending.empty());
+
+		Reference<LuaHTTPRequest> request = user_queue.pending.front();
+		size_t& host_in_flight = host_num_in_flight[request->host];
+		if((user_queue.num_in_flight < MAX_IN_FLIGHT_PER_USER) && (host_in_flight < MAX_IN_FLIGHT_PER_HOST))
+		{
+			user_queue.pending.pop_front();
+			user_queue.num_in_flight++;
+			host_in_flight++;
+			total_num_in_flight++;
+
+			request->dispatched = true;
+			request->dispatch_time = Clock::getTimeSinceInit();
+			request_queue.enqueue(request);
+
+			num_users_checked_without_dispatch = 0;
+		}
+		else
+			num_users_checked_without_dispatch++;
+
+		if(!user_queue.pending.empty())
+			users_with_pending_requests.push_back(user_id); // Put user at the back of the round-robin order.
+	}
+}
+
+
+void LuaHTTPRequestManager::requestFinished(const LuaHTTPRequest& request)
+{
+	auto user_res = user_queues.find(request.script_user_id);
+	if(user_res != user_queues.end())
+	{
+		assert(user_res->second.num_in_flight > 0);
+		user_res->second.num_in_flight--;
+		if(user_res->second.pending.empty() && (user_res->second.num_in_flight == 0))
+			user_queues.erase(user_res);
+	}
+
+	auto host_res = host_num_in_flight.find(request.host);
+	if(host_res != host_num_in_flight.end())
+	{
+		assert(host_res->second > 0);
+		host_res->second--;
+		if(host_res->second == 0)
+			host_num_in_flight.erase(host_res);
+	}
+
+	assert(total_num_in_flight > 0);
+	total_num_in_flight--;
+}
+
+
+// Add a message with the queue and request times to the script creator's script log.
+void LuaHTTPRequestManager::logRequestStats(const LuaHTTPRequest& request, const LuaHTTPRequestResult& result, const UID& script_ob_uid, double cur_time)
+{
+	std::string msg = "HTTP " + request.request_type + " request to '" + request.URL + "' ";
+	if(result.from_cache)
+		msg += "served from cache";
+	else if(request.dispatched)
+		msg += "queue time: " + doubleToStringNSigFigs((request.dispatch_time - request.enqueue_time) * 1.0e3, 3) + " ms, request time: " + doubleToStringNSigFigs(result.request_time * 1.0e3, 3) + " ms";
+	else
+		msg += "not made";
+
+	if(!result.exception_msg.empty())
+		msg += " (error: " + result.exception_msg + ")";
+	else
+		msg += " (response code: " + toString(result.response.response_code) + ")";
+
+	server->logLuaMessage(msg, UserScriptLogMessage::MessageType_print, script_ob_uid, request.script_user_id);
+}
+
+
 void LuaHTTPRequestManager::enqueueResult(Reference<LuaHTTPRequestResult> result)
 {
 	result_queue.enqueue(result);
 }
+
+
+Reference<HTTPClient> LuaHTTPRequestManager::getPooledHTTPClient(const std::string& connection_pool_key)
+{
+	{
+		Lock lock(http_client_pool_mutex);
+
+		const double cur_time = Clock::getTimeSinceInit();
+
+		auto res = idle_http_clients.find(connection_pool_key);
+		if(res != idle_http_clients.end())
+		{
+			std::vector<PooledHTTPClient>& clients = res->second;
+			while(!clients.empty())
+			{
+				PooledHTTPClient pooled = clients.back();
+				clients.pop_back();
+				if(cur_time - pooled.last_used_time < MAX_POOLED_HTTP_CLIENT_IDLE_TIME)
+					return pooled.client;
+			}
+			idle_http_clients.erase(res);
+		}
+	}
+
+	Reference<HTTPClient> client = new HTTPClient();
+	client->max_data_size = 1 << 24; // 16 MB
+	client->max_socket_buffer_size = 1 << 16;
+	return client;
+}
+
+
+void LuaHTTPRequestManager::returnHTTPClientToPool(const std::string& connection_pool_key, Reference<HTTPClient> client)
+{
+	Lock lock(http_client_pool_mutex);
+
+	std::vector<PooledHTTPClient>& clients = idle_http_clients[connection_pool_key];
+	if(clients.size() < MAX_IDLE_HTTP_CLIENTS_PER_KEY)
+		clients.push_back(PooledHTTPClient({client, Clock::getTimeSinceInit()}));
+}
+
+
+// Removes pooled HTTPClients that have been idle for longer than MAX_POOLED_HTTP_CLIENT_IDLE_TIME.  The connection is closed when the HTTPClient is destroyed.
+void LuaHTTPRequestManager::closeIdleHTTPClients(double cur_time)
+{
+	std::vector<Reference<HTTPClient>> clients_to_close; // Destroy outside of the lock, as closing the socket may block.
+	{
+		Lock lock(http_client_pool_mutex);
+
+		for(auto it = idle_http_clients.begin(); it != idle_http_clients.end(); )
+		{
+			std::vector<PooledHTTPClient>& clients = it->second;
+			for(size_t i=0; i<clients.size(); )
+			{
+				if(cur_time - clients[i].last_used_time >= MAX_POOLED_HTTP_CLIENT_IDLE_TIME)
+				{
+					clients_to_close.push_back(clients[i].client);
+					clients[i] = clients.back();
+					clients.pop_back();
+				}
+				else
+					++i;
+			}
+
+			if(clients.empty())
+				it = idle_http_clients.erase(it);
+			else
+				++it;
+		}
+	}
+}
+
+
+// See https://www.rfc-editor.org/rfc/rfc7230#section-3.2.6
+static inline bool isTokenChar(char c)
+{
+	return ::isAlphaNumeric(c) || (c == '!') || (c == '#') || (c == '$') || (c == '%') || (c == '&') || (c == '\'') || (c == '*') || (c == '+') || 
+		(c == '-') || (c == '.') || (c == '^') || (c == '_') || (c == '`') || (c == '|') || (c == '~');
+}
+
+
+void LuaHTTPRequestManager::checkHeaderNameValid(const std::string& name)
+{
+	if(name.empty())
+		throw glare::Exception("header name is empty");
+
+	for(size_t i=0; i<name.size(); ++i)
+		if(!isTokenChar(name[i]))
+			throw glare::Exception("header name '" + name + "' contains an invalid character");
+}
+
+
+void LuaHTTPRequestManager::checkHeaderValueValid(const std::string& value)
+{
+	for(size_t i=0; i<value.size(); ++i)
+		if((value[i] == '\r') || (value[i] == '\n') || (value[i] == '\0'))
+			throw glare::Exception("header value contains a CR, LF or NUL character");
+}
+
+
+std::string LuaHTTPRequestManager::getHostForURL(const std::string& URL)
+{
+	const std::string::size_type scheme_end = URL.find("://");
+	const size_t host_begin = (scheme_end == std::string::npos) ? 0 : scheme_end + 3;
+
+	size_t host_end = host_begin;
+	while(host_end < URL.size() && URL[host_end] != '/' && URL[host_end] != ':' && URL[host_end] != '?' && URL[host_end] != '#')
+		host_end++;
+
+	return ::toLowerCase(URL.substr(host_begin, host_end - host_begin));
+}
+
+
+std::string LuaHTTPRequestManager::getConnectionPoolKeyForURL(const std::string& URL)
+{
+	const std::string::size_type scheme_end = URL.find("://");
+	const std::string scheme = (scheme_end == std::string::npos) ? std::string("http") : ::toLowerCase(URL.substr(0, scheme_end));
+	const size_t host_begin = (scheme_end == std::string::npos) ? 0 : scheme_end + 3;
+
+	size_t host_end = host_begin;
+	while(host_end < URL.size() && URL[host_end] != '/' && URL[host_end] != ':' && URL[host_end] != '?' && URL[host_end] != '#')
+		host_end++;
+
+	std::string port;
+	if(host_end < URL.size() && URL[host_end] == ':')
+	{
+		size_t port_end = host_end + 1;
+		while(port_end < URL.size() && URL[port_end] >= '0' && URL[port_end] <= '9')
+			port_end++;
+		port = URL.substr(host_end + 1, port_end - (host_end + 1));
+	}
+	if(port.empty())
+		port = (scheme == "https") ? "443" : "80";
+
+	return scheme + "://" + ::toLowerCase(URL.substr(host_begin, host_end - host_begin)) + ":" + port;
+}
+
+
+#if BUILD_TESTS
+
+
+void LuaHTTPRequestManager::test()
+{
+	conPrint("LuaHTTPRequestManager::test()");
+
+	testAssert(getHostForURL("https://images.metaverse-billboards.com/space1.png") == "images.metaverse-billboards.com");
+	testAssert(getHostForURL("http://Example.com:8080/a.png") == "example.com");
+	testAssert(getHostForURL("https://example.com?a=b") == "example.com");
+	testAssert(getHostForURL("https://example.com") == "example.com");
+	testAssert(getHostForURL("example.com/a.png") == "example.com");
+	testAssert(getHostForURL("") == "");
+
+	testAssert(getConnectionPoolKeyForURL("https://Example.com/a.png") == "https://example.com:443");
+	testAssert(getConnectionPoolKeyForURL("HTTP://example.com?a=b") == "http://example.com:80");
+	testAssert(getConnectionPoolKeyForURL("http://example.com:8080/a.png") == "http://example.com:8080");
+	testAssert(getConnectionPoolKeyForURL("https://example.com:8443") == "https://example.com:8443");
+	testAssert(getConnectionPoolKeyForURL("example.com/a.png") == "http://example.com:80");
+	// Requests to the same host with different schemes or ports must not share connections.
+	testAssert(getConnectionPoolKeyForURL("http://example.com/") != getConnectionPoolKeyForURL("https://example.com/"));
+	testAssert(getConnectionPoolKeyForURL("https://example.com/") != getConnectionPoolKeyForURL("https://example.com:8443/"));
+
+	{
+		LuaHTTPRequest request;
+		request.request_type = "GET";
+		request.URL = "https://example.com/api";
+		testAssert(isCacheableRequest(request));
+
+		request.additional_headers.push_back("Authorization: Bearer abc");
+		testAssert(isCacheableRequest(request));
+		testAssert(makeCacheKey(request) == "https://example.com/api\nAuthorization: Bearer abc");
+
+		request.additional_headers.push_back("Cache-Control: no-cache");
+		testAssert(!isCacheableRequest(request));
+
+		request.additional_headers.clear();
+		request.request_type = "POST";
+		testAssert(!isCacheableRequest(request));
+	}
+
+	//----------------------- Test header validation -----------------------
+	{
+		checkHeaderNameValid("Authorization");
+		checkHeaderNameValid("X-Custom_Header.1~");
+		checkHeaderValueValid("Bearer abc; q=\"x y\"");
+		checkHeaderValueValid("");
+
+		const char* invalid_names[] = { "", "Bad Name", "Bad:Name", "Bad\r\nName", "Bad(Name)", "Bad\"Name" };
+		for(size_t i=0; i<staticArrayNumElems(invalid_names); ++i)
+		{
+			try
+			{
+				checkHeaderNameValid(invalid_names[i]);
+				failTest("Expected exception for header name '" + std::string(invalid_names[i]) + "'");
+			}
+			catch(glare::Exception&)
+			{}
+		}
+
+		const std::string invalid_values[] = { "abc\r\nX-Injected: 1", "abc\nGET / HTTP/1.1", "abc\r", std::string("abc\0def", 7) };
+		for(size_t i=0; i<staticArrayNumElems(invalid_values); ++i)
+		{
+			try
+			{
+				checkHeaderValueValid(invalid_values[i]);
+				failTest("Expected exception for header value");
+			}
+			catch(glare::Exception&)
+			{}
+		}
+	}
+
+	conPrint("LuaHTTPRequestManager::test() done.");
+}
+
+
+#endif // BUILD_TESTS
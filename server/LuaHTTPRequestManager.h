@@ -7,14 +7,18 @@ Copyright Glare Technologies Limited 2024 -
 
 
 #include "../shared/UserID.h"
+#include "../shared/UID.h"
 #include "../shared/RateLimiter.h"
 #include <networking/HTTPClient.h>
 #include <utils/ThreadSafeRefCounted.h>
 #include <utils/Reference.h>
 #include <utils/ThreadManager.h>
 #include <utils/WeakReference.h>
+#include <utils/Mutex.h>
 #include <vector>
 #include <string>
+#include <map>
+#include <deque>
 #include <unordered_map>
 
 
@@ -25,6 +29,8 @@ class Server;
 class LuaHTTPRequest : public ThreadSafeRefCounted
 {
 public:
+	LuaHTTPRequest() : onDone_ref(0), onError_ref(0), enqueue_time(0), dispatch_time(0), dispatched(false) {}
+
 	UserID script_user_id;
 
 	std::string request_type; // GET or POST
@@ -36,13 +42,21 @@ public:
 	WeakReference<LuaScriptEvaluator> lua_script_evaluator;
 	int onDone_ref;
 	int onError_ref;
+
+	// Set by LuaHTTPRequestManager
+	std::string host;
+	std::string connection_pool_key; // scheme://host:port, HTTPClients are only reused for requests with the same key.
+	std::string cache_key; // Empty if the request is not cacheable.
+	double enqueue_time; // In Clock::getTimeSinceInit() time.
+	double dispatch_time; // Time the request was handed to a worker thread.
+	bool dispatched; // Was the request handed to a worker thread?  False for rate-limited, cached and coalesced requests.
 };
 
 
 class LuaHTTPRequestResult : public ThreadSafeRefCounted
 {
 public:
-	LuaHTTPRequestResult() : error_code(0) {}
+	LuaHTTPRequestResult() : error_code(0), request_time(0), from_cache(false) {}
 
 	Reference<LuaHTTPRequest> request;
 	HTTPClient::ResponseInfo response;
@@ -51,6 +65,9 @@ public:
 	std::string exception_msg;
 	int error_code;
 
+	double request_time; // Time taken by the worker thread to do the request, in seconds.
+	bool from_cache; // True if the result was a cached response, or the response to an identical in-flight request.
+
 	enum ErrorCode
 	{
 		ErrorCode_OK = 0,
@@ -63,6 +80,17 @@ public:
 /*=====================================================================
 LuaHTTPRequestManager
 ---------------------
+Queues HTTP requests made by Lua scripts, and runs them on LuaHTTPWorkerThreads.
+
+Pending requests are held in a queue per user, and are handed to the worker threads
+round-robin across users, with limits on the number of in-flight requests per user
+and per host, so that one user's scripts can't starve everyone else.
+
+Identical GET requests are coalesced while in flight, and successful responses are
+cached for a short time, so that many scripts polling the same API only result
+in a single request.
+
+HTTPClients are pooled per scheme, host and port, so that connections can be reused between requests.
 =====================================================================*/
 class LuaHTTPRequestManager : public ThreadSafeRefCounted
 {
@@ -78,11 +106,68 @@ public:
 	// Called from worker threads.
 	void enqueueResult(Reference<LuaHTTPRequestResult> result);
 
-	ThreadSafeQueue<Reference<LuaHTTPRequest>> request_queue;
+	// Called from worker threads.  Returns an idle HTTPClient for the connection pool key if there is one in the pool, otherwise a new HTTPClient.
+	Reference<HTTPClient> getPooledHTTPClient(const std::string& connection_pool_key);
+	// Called from worker threads.  Returns a HTTPClient to the pool after a successful request, so the connection can be reused.
+	void returnHTTPClientToPool(const std::string& connection_pool_key, Reference<HTTPClient> client);
+
+	// Returns the lower-cased host part of a URL, e.g. "example.com" for "https://example.com:8080/a?b=c".
+	static std::string getHostForURL(const std::string& URL);
+
+	// Returns the lower-cased scheme, host and port of a URL, e.g. "https://example.com:443" for "https://Example.com/a?b=c".
+	// The default port for the scheme is used if the URL doesn't have a port.
+	static std::string getConnectionPoolKeyForURL(const std::string& URL);
+
+	// Header names must be RFC 7230 tokens, and values must not contain CR, LF or NUL characters,
+	// so that scripts can't inject additional headers or requests.  Throw glare::Exception if invalid.
+	static void checkHeaderNameValid(const std::string& name);
+	static void checkHeaderValueValid(const std::string& value);
+
+	static void test();
+
+	ThreadSafeQueue<Reference<LuaHTTPRequest>> request_queue; // Requests that have been dispatched to the worker threads.
 private:
+	void dispatchPendingRequests();
+	void requestFinished(const LuaHTTPRequest& request);
+	void logRequestStats(const LuaHTTPRequest& request, const LuaHTTPRequestResult& result, const UID& script_ob_uid, double cur_time);
+	void closeIdleHTTPClients(double cur_time);
+
 	ThreadManager thread_manager;
 	ThreadSafeQueue<Reference<LuaHTTPRequestResult>> result_queue;
 	Server* server;
 
 	std::unordered_map<UserID, Reference<RateLimiter>, UserIDHasher> rate_limiters;
+
+	// The following are only accessed on the main thread.
+	struct UserRequestQueue
+	{
+		UserRequestQueue() : num_in_flight(0) {}
+		std::deque<Reference<LuaHTTPRequest>> pending;
+		size_t num_in_flight;
+	};
+	std::unordered_map<UserID, UserRequestQueue, UserIDHasher> user_queues;
+	std::deque<UserID> users_with_pending_requests; // Round-robin order for dispatching.
+	std::map<std::string, size_t> host_num_in_flight;
+	size_t total_num_in_flight;
+
+	// Requests waiting on an identical in-flight (or pending) GET request.  Map from cache key to waiting requests.
+	std::map<std::string, std::vector<Reference<LuaHTTPRequest>>> coalesced_requests;
+
+	struct CachedResponse
+	{
+		Reference<LuaHTTPRequestResult> result;
+		double expiry_time;
+	};
+	std::map<std::string, CachedResponse> response_cache;
+	double last_cache_cleanup_time;
+	double last_idle_http_client_cleanup_time;
+
+	// Pool of idle HTTPClients, accessed from worker threads.
+	struct PooledHTTPClient
+	{
+		Reference<HTTPClient> client;
+		double last_used_time;
+	};
+	std::map<std::string, std::vector<PooledHTTPClient>> idle_http_clients GUARDED_BY(http_client_pool_mutex); // Map from connection pool key to idle clients.
+	Mutex http_client_pool_mutex;
 };
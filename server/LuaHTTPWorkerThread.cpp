@@ -10,9 +10,47 @@ Copyright Glare Technologies Limited 2024 -
 #include <networking/HTTPClient.h>
 #include <utils/PlatformUtils.h>
 #include <utils/ConPrint.h>
+#include <utils/Timer.h>
 #include <utils/KillThreadMessage.h>
 
 
+// Makes sure the request manager gets a result for a dequeued request, even if an exception escapes before the result is enqueued.
+// Otherwise the manager's in-flight counts for the request would never be decremented, and the user and host would eventually stop getting requests dispatched.
+class ResultGuard
+{
+public:
+	ResultGuard(LuaHTTPRequestManager* manager_, const Reference<LuaHTTPRequest>& request_) : manager(manager_), request(request_) {}
+	~ResultGuard()
+	{
+		if(request)
+		{
+			try
+			{
+				Reference<LuaHTTPRequestResult> result = new LuaHTTPRequestResult();
+				result->request = request;
+				result->error_code = LuaHTTPRequestResult::ErrorCode_Other;
+				result->exception_msg = "Internal error while doing request";
+				manager->enqueueResult(result);
+			}
+			catch(std::exception& e) // Don't throw from destructor.
+			{
+				conPrint(std::string("LuaHTTPWorkerThread: Failed to enqueue result: ") + e.what());
+			}
+		}
+	}
+
+	void enqueueResult(Reference<LuaHTTPRequestResult> result)
+	{
+		manager->enqueueResult(result);
+		request = nullptr;
+	}
+
+private:
+	LuaHTTPRequestManager* manager;
+	Reference<LuaHTTPRequest> request; // Set to null once the result has been enqueued.
+};
+
+
 LuaHTTPWorkerThread::LuaHTTPWorkerThread(LuaHTTPRequestManager* manager_)
 :	manager(manager_)
 {
@@ -36,16 +74,19 @@ void LuaHTTPWorkerThread::doRun()
 			if(!request) // A null request means the thread should quit.
 				return;
 
+			ResultGuard result_guard(manager, request);
+
 			Reference<LuaHTTPRequestResult> result = new LuaHTTPRequestResult();
 			result->request = request;
 
+			Timer timer;
 			try
 			{
 				conPrint("Doing Lua HTTP Request to '" + request->URL + "'...");
 
-				http_client = new HTTPClient();
-				http_client->max_data_size = 1 << 24; // 16 MB
-				http_client->max_socket_buffer_size = 1 << 16;
+				// Get a HTTPClient from the pool, so that a kept-alive connection to the host can be reused.
+				http_client = manager->getPooledHTTPClient(request->connection_pool_key);
+				http_client->additional_headers = request->additional_headers;
 
 				if(request->request_type == "GET")
 				{
@@ -59,6 +100,8 @@ void LuaHTTPWorkerThread::doRun()
 					runtimeCheckFailed("invalid request type");
 
 				conPrint("Lua HTTP Request to '" + request->URL + "' done.");
+
+				manager->returnHTTPClientToPool(request->connection_pool_key, http_client);
 			}
 			catch(glare::Exception& e)
 			{
@@ -68,10 +111,20 @@ void LuaHTTPWorkerThread::doRun()
 				result->exception_msg = e.what();
 				result->data.clear();
 			}
+			catch(std::exception& e) // catch std::bad_alloc etc..
+			{
+				conPrint(std::string("std::exception while doing Lua HTTP Request to '") + request->URL + "': " + e.what());
+
+				result->error_code = LuaHTTPRequestResult::ErrorCode_Other;
+				result->exception_msg = e.what();
+				result->data.clear();
+			}
 
 			http_client = nullptr;
 
-			manager->enqueueResult(result);
+			result->request_time = timer.elapsed();
+
+			result_guard.enqueueResult(result);
 		}
 	}
 	catch(glare::Exception& e)
@@ -0,0 +1,538 @@
+/*=====================================================================
+MapTileGenThread.cpp
+--------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#include "MapTileGenThread.h"
+
+
+#include "Server.h"
+#include "ServerWorldState.h"
+#include "../shared/ImageDecoding.h"
+#include <ConPrint.h>
+#include <Exception.h>
+#include <Lock.h>
+#include <StringUtils.h>
+#include <PlatformUtils.h>
+#include <Timer.h>
+#include <TaskManager.h>
+#include <FileUtils.h>
+#include <CryptoRNG.h>
+#include <KillThreadMessage.h>
+#include <TestUtils.h>
+#include <graphics/jpegdecoder.h>
+#include <graphics/Map2D.h>
+#include <maths/mathstypes.h>
+
+
+static const double BUILD_CHECK_PERIOD = 30.0; // Check for coarse tiles that can be built this often (seconds).
+static const double INVALIDATION_PERIOD = 300.0; // Invalidate tiles covering changed objects and parcels this often (seconds).
+
+static const uint8 BACKGROUND_COLOUR[3] = { 0, 0, 0 }; // Used for parts of coarse tiles that don't have a child tile.
+
+
+MapTileGenThread::MapTileGenThread(Server* server_, ServerAllWorldsState* world_state_)
+:	server(server_), world_state(world_state_)
+{
+}
+
+
+MapTileGenThread::~MapTileGenThread()
+{
+}
+
+
+void MapTileGenThread::getTileRange(int tile_z, int& x_begin_out, int& x_end_out, int& y_begin_out, int& y_end_out)
+{
+	const float TILE_WIDTH_M = getTileWidthM(tile_z);
+
+	const int span = (int)std::ceil(300 / TILE_WIDTH_M);
+	const int plus_x_span = (int)std::ceil(700 / TILE_WIDTH_M);  // NOTE: pushing out positive x span here to encompass east districts
+	const int plus_y_span = (int)std::ceil(530 / TILE_WIDTH_M);  // NOTE: pushing out positive y span here to encompass north district
+
+	x_begin_out = -span;
+	x_end_out = plus_x_span;
+	y_begin_out = -span;
+	y_end_out = plus_y_span;
+}
+
+
+void MapTileGenThread::getMaxZTilesForRegion(const MapChangedRegion& region, std::set<Vec3<int>>& tiles_out)
+{
+	if(!(isFinite(region.min_x) && isFinite(region.min_y) && isFinite(region.max_x) && isFinite(region.max_y)))
+		return;
+
+	int x_begin, x_end, y_begin, y_end;
+	getTileRange(MAX_TILE_Z, x_begin, x_end, y_begin, y_end);
+
+	// Clamp region to map range first, so huge objects don't result in huge loops.
+	const float tile_w = getTileWidthM(MAX_TILE_Z);
+	const float min_x = myMax(region.min_x, x_begin * tile_w);
+	const float min_y = myMax(region.min_y, y_begin * tile_w);
+	const float max_x = myMin(region.max_x, x_end * tile_w);
+	const float max_y = myMin(region.max_y, y_end * tile_w);
+	if(min_x > max_x || min_y > max_y)
+		return;
+
+	const int tile_x_begin = myMax(x_begin, (int)std::floor(min_x / tile_w));
+	const int tile_x_end   = myMin(x_end,   (int)std::floor(max_x / tile_w) + 1);
+	const int tile_y_begin = myMax(y_begin, (int)std::floor(min_y / tile_w));
+	const int tile_y_end   = myMin(y_end,   (int)std::floor(max_y / tile_w) + 1);
+
+	for(int y = tile_y_begin; y < tile_y_end; ++y)
+	for(int x = tile_x_begin; x < tile_x_end; ++x)
+		tiles_out.insert(Vec3<int>(x, y, MAX_TILE_Z));
+}
+
+
+ScreenshotRef MapTileGenThread::makeMapTileScreenshot(uint64 id, const Vec3<int>& tile)
+{
+	ScreenshotRef shot = new Screenshot();
+	shot->id = id;
+	shot->created_time = TimeStamp::currentTime();
+	shot->state = Screenshot::ScreenshotState_notdone;
+	shot->is_map_tile = true;
+	shot->tile_x = tile.x;
+	shot->tile_y = tile.y;
+	shot->tile_z = tile.z;
+	return shot;
+}
+
+
+ImageMapUInt8Ref MapTileGenThread::buildParentTileImage(const ImageMapUInt8* children[4], int tile_w_px)
+{
+	ImageMapUInt8Ref parent = new ImageMapUInt8(tile_w_px, tile_w_px, 3);
+
+	const int half_w = tile_w_px / 2;
+	for(int j=0; j<2; ++j)
+	for(int i=0; i<2; ++i)
+	{
+		const ImageMapUInt8* child = children[i + 2*j];
+
+		// Child tile (2x + i, 2y + j) covers the quadrant with x offset i.
+		// Image rows go from north to south (+y to -y), so the j = 1 children go in the top half of the image.
+		const int dest_x0 = i * half_w;
+		const int dest_y0 = (1 - j) * half_w;
+
+		if(!child)
+		{
+			for(int ly=0; ly<half_w; ++ly)
+			for(int lx=0; lx<half_w; ++lx)
+			{
+				uint8* dest = parent->getPixel(dest_x0 + lx, dest_y0 + ly);
+				dest[0] = BACKGROUND_COLOUR[0];
+				dest[1] = BACKGROUND_COLOUR[1];
+				dest[2] = BACKGROUND_COLOUR[2];
+			}
+			continue;
+		}
+
+		const int64 child_w = (int64)child->getWidth();
+		const int64 child_h = (int64)child->getHeight();
+		const size_t child_N = child->getN();
+		const size_t g_offset = (child_N >= 3) ? 1 : 0; // Handle greyscale child images.
+		const size_t b_offset = (child_N >= 3) ? 2 : 0;
+
+		for(int ly=0; ly<half_w; ++ly)
+		for(int lx=0; lx<half_w; ++lx)
+		{
+			// 2x2 box filter.  Child images are normally twice the size of the destination quadrant, but scale coordinates in case they are not.
+			uint32 sum[3] = { 0, 0, 0 };
+			for(int dy=0; dy<2; ++dy)
+			for(int dx=0; dx<2; ++dx)
+			{
+				const size_t sx = (size_t)myMin(child_w - 1, ((int64)(2*lx + dx) * child_w) / tile_w_px);
+				const size_t sy = (size_t)myMin(child_h - 1, ((int64)(2*ly + dy) * child_h) / tile_w_px);
+				const uint8* src = child->getPixel(sx, sy);
+				sum[0] += src[0];
+				sum[1] += src[g_offset];
+				sum[2] += src[b_offset];
+			}
+
+			uint8* dest = parent->getPixel(dest_x0 + lx, dest_y0 + ly);
+			dest[0] = (uint8)((sum[0] + 2) / 4);
+			dest[1] = (uint8)((sum[1] + 2) / 4);
+			dest[2] = (uint8)((sum[2] + 2) / 4);
+		}
+	}
+
+	return parent;
+}
+
+
+// Mark the tile as needing regeneration.  The current screenshot becomes the previous screenshot, which will be served until the new one is done.
+static void invalidateTile(TileInfo& tile_info, const Vec3<int>& tile, uint64& next_shot_id)
+{
+	if(tile_info.cur_tile_screenshot.nonNull() && (tile_info.cur_tile_screenshot->state == Screenshot::ScreenshotState_notdone))
+		return; // Already waiting to be (re)generated.
+
+	if(tile_info.cur_tile_screenshot.nonNull())
+		tile_info.prev_tile_screenshot = tile_info.cur_tile_screenshot;
+
+	tile_info.cur_tile_screenshot = MapTileGenThread::makeMapTileScreenshot(next_shot_id++, tile);
+}
+
+
+void MapTileGenThread::invalidateChangedTiles()
+{
+	std::set<Vec3<int>> changed_tiles; // At MAX_TILE_Z
+	{
+		WorldStateLock lock(world_state->mutex);
+
+		Reference<ServerWorldState> root_world = world_state->getRootWorldState();
+
+		const ServerWorldState::ObjectMapType& objects = root_world->getObjects(lock);
+		std::map<UID, MapChangedRegion>& changed_obs = root_world->getMapChangedObjects(lock);
+		for(auto it = changed_obs.begin(); it != changed_obs.end(); ++it)
+		{
+			getMaxZTilesForRegion(it->second, changed_tiles);
+
+			// If the object has moved, the tiles at its old position need to be regenerated as well.
+			auto last_res = last_ob_regions.find(it->first);
+			if(last_res != last_ob_regions.end())
+				getMaxZTilesForRegion(last_res->second, changed_tiles);
+
+			// If the object has been deleted, we don't need to remember its bounds any more.
+			auto ob_res = objects.find(it->first);
+			const bool ob_removed = (ob_res == objects.end()) || (ob_res->second->state == WorldObject::State_Dead);
+			if(ob_removed)
+			{
+				if(last_res != last_ob_regions.end())
+					last_ob_regions.erase(last_res);
+			}
+			else if(last_res != last_ob_regions.end())
+				last_res->second = it->second;
+			else
+				last_ob_regions.insert(*it);
+		}
+		changed_obs.clear();
+
+		std::map<ParcelID, MapChangedRegion>& changed_parcels = root_world->getMapChangedParcels(lock);
+		for(auto it = changed_parcels.begin(); it != changed_parcels.end(); ++it)
+			getMaxZTilesForRegion(it->second, changed_tiles);
+		changed_parcels.clear();
+
+		if(changed_tiles.empty())
+			return;
+
+		// Invalidate changed tiles and their ancestors
+		uint64 next_shot_id = world_state->getNextScreenshotUID();
+		std::set<Vec3<int>> invalidated_tiles;
+		for(auto it = changed_tiles.begin(); it != changed_tiles.end(); ++it)
+		{
+			Vec3<int> tile = *it;
+			while(tile.z >= 0)
+			{
+				if(!invalidated_tiles.insert(tile).second)
+					break; // Already invalidated this tile, and so its ancestors.
+
+				auto res = world_state->map_tile_info.info.find(tile);
+				if(res != world_state->map_tile_info.info.end())
+					invalidateTile(res->second, tile, next_shot_id);
+
+				tile = Vec3<int>(Maths::divideByTwoRoundedDown(tile.x), Maths::divideByTwoRoundedDown(tile.y), tile.z - 1);
+			}
+		}
+
+		world_state->map_tile_info.db_dirty = true;
+		world_state->markAsChanged();
+
+		conPrint("MapTileGenThread: Invalidated " + toString(invalidated_tiles.size()) + " map tile(s) (" + toString(changed_tiles.size()) + " at zoom level " + toString(MAX_TILE_Z) + ")");
+	} // End lock scope
+}
+
+
+// Builds a single coarse tile from its child tile images.
+class BuildCoarseTileTask : public glare::Task
+{
+public:
+	BuildCoarseTileTask() : succeeded(false) {}
+
+	virtual void run(size_t thread_index)
+	{
+		try
+		{
+			// Load child tiles
+			Reference<Map2D> child_maps[4];
+			const ImageMapUInt8* children[4] = { NULL, NULL, NULL, NULL };
+			for(int i=0; i<4; ++i)
+			{
+				if(!child_paths[i].empty())
+				{
+					try
+					{
+						child_maps[i] = ImageDecoding::decodeImage(".", child_paths[i]);
+						if(child_maps[i].isType<ImageMapUInt8>())
+							children[i] = child_maps[i].downcastToPtr<ImageMapUInt8>();
+						else
+							conPrint("MapTileGenThread: child tile '" + child_paths[i] + "' was not an 8-bit image.");
+					}
+					catch(glare::Exception& e)
+					{
+						conPrint("MapTileGenThread: failed to load child tile '" + child_paths[i] + "': " + e.what());
+					}
+				}
+			}
+
+			ImageMapUInt8Ref tile_map = MapTileGenThread::buildParentTileImage(children, MapTileGenThread::TILE_WIDTH_PX);
+
+			// Generate random path, in the same way as for tiles from the screenshot bot.
+			const int NUM_BYTES = 16;
+			uint8 pathdata[NUM_BYTES];
+			CryptoRNG::getRandomBytes(pathdata, NUM_BYTES);
+			screenshot_filename = "tile_" + toString(tile.x) + "_" + toString(tile.y) + "_" + toString(tile.z) + "_" + StringUtils::convertByteArrayToHexString(pathdata, NUM_BYTES) + ".jpg";
+			screenshot_path = screenshot_dir + "/" + screenshot_filename;
+
+			JPEGDecoder::SaveOptions options;
+			options.quality = 90;
+			JPEGDecoder::save(tile_map, screenshot_path, options);
+
+			succeeded = true;
+		}
+		catch(glare::Exception& e)
+		{
+			conPrint("MapTileGenThread: failed to build tile " + tile.toString() + ": " + e.what());
+		}
+		catch(std::exception& e) // catch std::bad_alloc etc..
+		{
+			conPrint("MapTileGenThread: failed to build tile " + tile.toString() + ": " + e.what());
+		}
+	}
+
+	Vec3<int> tile;
+	ScreenshotRef screenshot;
+	std::string child_paths[4]; // Empty string if no child.
+	std::string screenshot_dir;
+
+	std::string screenshot_filename;
+	std::string screenshot_path;
+	bool succeeded;
+};
+
+
+void MapTileGenThread::buildCoarseTiles(glare::TaskManager& task_manager)
+{
+	std::vector<ScreenshotRef> built_shots; // Screenshots of all tiles built in this pass.
+
+	for(int z = MAX_TILE_Z - 1; z >= 0; --z)
+	{
+		// Find coarse tiles at this level that need building, and for which all the children are done.
+		std::vector<Reference<BuildCoarseTileTask>> tasks;
+		{
+			WorldStateLock lock(world_state->mutex);
+
+			for(auto it = world_state->map_tile_info.info.begin(); it != world_state->map_tile_info.info.end(); ++it)
+			{
+				const Vec3<int>& tile = it->first;
+				const TileInfo& tile_info = it->second;
+				if((tile.z != z) || tile_info.cur_tile_screenshot.isNull() || (tile_info.cur_tile_screenshot->state != Screenshot::ScreenshotState_notdone))
+					continue;
+
+				Reference<BuildCoarseTileTask> task = new BuildCoarseTileTask();
+				bool children_ready = true;
+				for(int j=0; j<2; ++j)
+				for(int i=0; i<2; ++i)
+				{
+					auto child_res = world_state->map_tile_info.info.find(Vec3<int>(tile.x * 2 + i, tile.y * 2 + j, z + 1));
+					if(child_res != world_state->map_tile_info.info.end())
+					{
+						const TileInfo& child_info = child_res->second;
+						if(child_info.cur_tile_screenshot.nonNull() && (child_info.cur_tile_screenshot->state == Screenshot::ScreenshotState_done))
+							task->child_paths[i + 2*j] = child_info.cur_tile_screenshot->local_path;
+						else if(child_info.cur_tile_screenshot.nonNull())
+							children_ready = false; // Child is waiting to be (re)generated.
+					}
+				}
+
+				if(children_ready)
+				{
+					task->tile = tile;
+					task->screenshot = tile_info.cur_tile_screenshot;
+					task->screenshot_dir = server->screenshot_dir;
+					tasks.push_back(task);
+				}
+			}
+		} // End lock scope
+
+		if(tasks.empty())
+			continue;
+
+		Timer timer;
+		for(size_t i=0; i<tasks.size(); ++i)
+			task_manager.addTask(tasks[i]);
+		task_manager.waitForTasksToComplete();
+
+		// Add built tiles as resources, for access by the embedded minimap on the client.
+		std::vector<Reference<BuildCoarseTileTask>> added_tasks;
+		std::vector<ResourceRef> added_resources;
+		for(size_t i=0; i<tasks.size(); ++i)
+		{
+			BuildCoarseTileTask* task = tasks[i].ptr();
+			if(!task->succeeded)
+				continue;
+
+			try
+			{
+				ResourceRef resource = world_state->resource_manager->getOrCreateResourceForURL(task->screenshot_filename); // Will create a new Resource ob if not already inserted.
+				const std::string local_abs_path = world_state->resource_manager->getLocalAbsPathForResource(*resource);
+
+				FileUtils::copyFile(task->screenshot_path, local_abs_path);
+
+				resource->owner_id = UserID::invalidUserID();
+				resource->setState(Resource::State_Present);
+
+				added_tasks.push_back(tasks[i]);
+				added_resources.push_back(resource);
+			}
+			catch(glare::Exception& e)
+			{
+				conPrint("MapTileGenThread: failed to add tile " + task->tile.toString() + " as resource: " + e.what());
+			}
+		}
+
+		// Mark screenshots as done, so the next zoom level can use them.
+		if(!added_tasks.empty())
+		{
+			WorldStateLock lock(world_state->mutex);
+			for(size_t i=0; i<added_tasks.size(); ++i)
+			{
+				BuildCoarseTileTask* task = added_tasks[i].ptr();
+				world_state->addResourcesAsDBDirty(added_resources[i]);
+
+				task->screenshot->URL = task->screenshot_filename;
+				task->screenshot->local_path = task->screenshot_path;
+				task->screenshot->state = Screenshot::ScreenshotState_done;
+				built_shots.push_back(task->screenshot);
+			}
+			world_state->map_tile_info.db_dirty = true;
+		}
+
+		conPrint("MapTileGenThread: Built " + toString(tasks.size()) + " tile(s) at zoom level " + toString(z) + " (Elapsed: " + timer.elapsedStringNSigFigs(4) + ")");
+	}
+
+	// Mark all built screenshots as DB dirty as a single batch, so the web data version is only bumped (invalidating the web page cache) once per pass, not once per tile.
+	if(!built_shots.empty())
+	{
+		WorldStateLock lock(world_state->mutex);
+		world_state->addScreenshotsAsDBDirty(built_shots);
+	}
+}
+
+
+void MapTileGenThread::doRun()
+{
+	PlatformUtils::setCurrentThreadName("MapTileGenThread");
+
+	try
+	{
+		glare::TaskManager task_manager("MapTileGenThread task manager");
+
+		{
+			WorldStateLock lock(world_state->mutex);
+			world_state->getRootWorldState()->setTrackMapChanges(true, lock);
+		}
+
+		Timer time_since_invalidation;
+		while(1)
+		{
+			// Block for a while, or until we have a message
+			ThreadMessageRef msg;
+			const bool got_msg = getMessageQueue().dequeueWithTimeout(/*wait_time_seconds=*/BUILD_CHECK_PERIOD, msg);
+			if(got_msg)
+			{
+				if(dynamic_cast<KillThreadMessage*>(msg.ptr()))
+					return;
+			}
+
+			if(time_since_invalidation.elapsed() >= INVALIDATION_PERIOD)
+			{
+				invalidateChangedTiles();
+				time_since_invalidation.reset();
+			}
+
+			buildCoarseTiles(task_manager);
+		}
+	}
+	catch(glare::Exception& e)
+	{
+		conPrint("MapTileGenThread: glare::Exception: " + e.what());
+	}
+	catch(std::exception& e) // catch std::bad_alloc etc..
+	{
+		conPrint(std::string("MapTileGenThread: Caught std::exception: ") + e.what());
+	}
+}
+
+
+#if BUILD_TESTS
+
+
+void MapTileGenThread::test()
+{
+	conPrint("MapTileGenThread::test()");
+
+	//-------------------- Test getMaxZTilesForRegion --------------------
+	{
+		const float tile_w = getTileWidthM(MAX_TILE_Z);
+		testAssert(tile_w == 80.f);
+
+		std::set<Vec3<int>> tiles;
+		getMaxZTilesForRegion(MapChangedRegion({10.f, 10.f, 20.f, 20.f}), tiles);
+		testAssert(tiles.size() == 1 && tiles.count(Vec3<int>(0, 0, MAX_TILE_Z)) == 1);
+
+		// Region straddling tile boundaries
+		tiles.clear();
+		getMaxZTilesForRegion(MapChangedRegion({-10.f, 70.f, 10.f, 90.f}), tiles);
+		testAssert(tiles.size() == 4);
+		testAssert(tiles.count(Vec3<int>(-1, 0, MAX_TILE_Z)) == 1);
+		testAssert(tiles.count(Vec3<int>(0, 1, MAX_TILE_Z)) == 1);
+
+		// Region outside of map
+		tiles.clear();
+		getMaxZTilesForRegion(MapChangedRegion({1.0e5f, 1.0e5f, 1.0e5f + 10, 1.0e5f + 10}), tiles);
+		testAssert(tiles.empty());
+
+		// Huge region should be clamped to the map range.
+		int x_begin, x_end, y_begin, y_end;
+		getTileRange(MAX_TILE_Z, x_begin, x_end, y_begin, y_end);
+		tiles.clear();
+		getMaxZTilesForRegion(MapChangedRegion({-1.0e9f, -1.0e9f, 1.0e9f, 1.0e9f}), tiles);
+		testAssert(tiles.size() == (size_t)((x_end - x_begin) * (y_end - y_begin)));
+	}
+
+	//-------------------- Test buildParentTileImage --------------------
+	{
+		const int W = 8;
+		ImageMapUInt8 child_00(W, W, 3); // Lower left (south-west)
+		ImageMapUInt8 child_10(W, W, 3); // Lower right
+		ImageMapUInt8 child_01(W, W, 1); // Upper left, greyscale
+		child_00.set(10);
+		child_10.set(20);
+		child_01.set(30);
+
+		// Make a pixel pattern in child_00 to check averaging
+		child_00.getPixel(0, 0)[0] = 14;
+		child_00.getPixel(1, 0)[0] = 10;
+		child_00.getPixel(0, 1)[0] = 10;
+		child_00.getPixel(1, 1)[0] = 10;
+
+		const ImageMapUInt8* children[4] = { &child_00, &child_10, &child_01, NULL };
+		ImageMapUInt8Ref parent = buildParentTileImage(children, W);
+		testAssert(parent->getWidth() == W && parent->getHeight() == W && parent->getN() == 3);
+
+		// Top-left quadrant is child (0, 1)
+		testAssert(parent->getPixel(0, 0)[0] == 30 && parent->getPixel(0, 0)[1] == 30 && parent->getPixel(0, 0)[2] == 30);
+		// Top-right quadrant is missing child (1, 1)
+		testAssert(parent->getPixel(W-1, 0)[0] == BACKGROUND_COLOUR[0]);
+		// Bottom-left quadrant is child (0, 0)
+		testAssert(parent->getPixel(0, W/2)[0] == 11); // (14 + 10 + 10 + 10) / 4 = 11
+		testAssert(parent->getPixel(1, W/2)[0] == 10);
+		// Bottom-right quadrant is child (1, 0)
+		testAssert(parent->getPixel(W-1, W-1)[0] == 20);
+	}
+
+	conPrint("MapTileGenThread::test() done.");
+}
+
+
+#endif // BUILD_TESTS
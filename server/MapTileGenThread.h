@@ -0,0 +1,73 @@
+/*=====================================================================
+MapTileGenThread.h
+------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#pragma once
+
+
+#include "ServerWorldState.h"
+#include "Screenshot.h"
+#include "../shared/UID.h"
+#include <MessageableThread.h>
+#include <graphics/ImageMap.h>
+#include <maths/vec3.h>
+#include <map>
+#include <set>
+#include <vector>
+class Server;
+namespace glare { class TaskManager; }
+
+
+/*=====================================================================
+MapTileGenThread
+----------------
+Keeps the map tile pyramid up to date.
+
+Only tiles at the highest zoom level (MAX_TILE_Z) are rendered by the screenshot bot.
+Tiles at lower zoom levels are built in-process, by compositing and 2x2 downsampling
+their 4 child tiles, once all the child tiles are done.  Each zoom level is built in parallel.
+
+Changed objects and parcels in the root world are recorded by ServerWorldState.
+Periodically the tiles at MAX_TILE_Z that cover the changed regions are marked for
+re-rendering, along with their ancestor tiles, so that the amount of map regeneration
+work depends on the amount of change, not on the size of the map.
+=====================================================================*/
+class MapTileGenThread : public MessageableThread
+{
+public:
+	MapTileGenThread(Server* server, ServerAllWorldsState* world_state);
+
+	virtual ~MapTileGenThread();
+
+	virtual void doRun();
+
+	static const int MAX_TILE_Z = 6; // Tiles at this zoom level are rendered by the screenshot bot, tiles at lower zoom levels are built from them.
+	static const int TILE_WIDTH_PX = 256;
+
+	static float getTileWidthM(int tile_z) { return 5120.f / (1 << tile_z); }
+
+	// Get range of tile coordinates in the map at the given zoom level.  Ranges are half-open: [x_begin, x_end).
+	static void getTileRange(int tile_z, int& x_begin_out, int& x_end_out, int& y_begin_out, int& y_end_out);
+
+	// Get coordinates of tiles at MAX_TILE_Z that overlap the region, and are in the map tile range.
+	static void getMaxZTilesForRegion(const MapChangedRegion& region, std::set<Vec3<int>>& tiles_out);
+
+	// Makes a new Screenshot object for the map tile, in the not-done state.
+	static ScreenshotRef makeMapTileScreenshot(uint64 id, const Vec3<int>& tile);
+
+	// Composites and downsamples 4 child tiles into a new tile image with width and height tile_w_px.
+	// children[i + 2*j] is the image for child tile (2x + i, 2y + j, z + 1).  Children may be NULL, in which case the quadrant is filled with a background colour.
+	static ImageMapUInt8Ref buildParentTileImage(const ImageMapUInt8* children[4], int tile_w_px);
+
+	static void test();
+
+private:
+	void invalidateChangedTiles();
+	void buildCoarseTiles(glare::TaskManager& task_manager);
+
+	Server* server;
+	ServerAllWorldsState* world_state;
+
+	std::map<UID, MapChangedRegion> last_ob_regions; // Bounds of objects when they last invalidated tiles, so we can invalidate the tiles at the old position when an object moves.
+};
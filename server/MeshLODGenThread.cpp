@@ -8,6 +8,7 @@ Copyright Glare Technologies Limited 2022 -
 
 #include "ServerWorldState.h"
 #include "../shared/LODGeneration.h"
+#include "../shared/GPUMesh.h"
 #include "../shared/ImageDecoding.h"
 #include <ConPrint.h>
 #include <Exception.h>
@@ -48,6 +49,22 @@ struct LODMeshToGen
 };
 
 
+struct GPUMeshToGen
+{
+	std::string source_model_abs_path; // Base model path for LOD level 0, LOD model (bmesh) path otherwise.
+	std::string gpu_mesh_abs_path;
+	std::string gpu_mesh_URL;
+	UserID owner_id;
+};
+
+
+struct ObjectWithGPUMeshesToGen
+{
+	Reference<ServerWorldState> world;
+	WorldObjectRef ob;
+};
+
+
 struct LODTextureToGen
 {
 	std::string source_tex_abs_path; // Absolute base texture path, to read texture from.
@@ -58,17 +75,58 @@ struct LODTextureToGen
 };
 
 
-struct KTXTextureToGen
+struct BasisTextureToGen
 {
-	std::string source_tex_abs_path; // source texture abs path
-	std::string ktx_tex_abs_path; // abs path to write KTX texture to.
-	std::string ktx_URL;
+	std::string source_tex_abs_path; // Base texture path for the base LOD level, JPG/PNG LOD texture path otherwise.
+	std::string basis_tex_abs_path; // abs path to write Basis texture to.
+	std::string basis_URL;
 	int base_lod_level;
 	int lod_level;
+	bool is_sRGB;
 	UserID owner_id;
 };
 
 
+struct ObjectWithBasisTexturesToGen
+{
+	Reference<ServerWorldState> world;
+	WorldObjectRef ob;
+};
+
+
+// Generates a single Basis texture.  Multiple textures are generated in parallel, one task per texture.
+class GenerateBasisTextureTask : public glare::Task
+{
+public:
+	GenerateBasisTextureTask() : num_encoder_threads(1), succeeded(false) {}
+
+	virtual void run(size_t thread_index)
+	{
+		try
+		{
+			if(!FileUtils::fileExists(tex_to_gen.source_tex_abs_path)) // LOD texture generation may have failed.
+				throw glare::Exception("Source texture '" + tex_to_gen.source_tex_abs_path + "' not present.");
+
+			LODGeneration::generateBasisTexture(tex_to_gen.source_tex_abs_path, tex_to_gen.base_lod_level, tex_to_gen.lod_level, tex_to_gen.is_sRGB, tex_to_gen.basis_tex_abs_path, num_encoder_threads);
+
+			succeeded = true;
+		}
+		catch(glare::Exception& e)
+		{
+			conPrint("\tMeshLODGenThread: excep while generating Basis texture '" + tex_to_gen.basis_URL + "': " + e.what());
+		}
+		catch(std::exception& e) // catch std::bad_alloc etc..
+		{
+			conPrint("\tMeshLODGenThread: excep while generating Basis texture '" + tex_to_gen.basis_URL + "': " + e.what());
+		}
+	}
+
+	BasisTextureToGen tex_to_gen;
+	int num_encoder_threads;
+	bool succeeded;
+};
+
+
 
 struct MeshLODGenThreadTexInfo
 {
@@ -262,6 +320,82 @@ static void checkForLODMeshesToGenerate(ServerAllWorldsState* world_state, Serve
 }
 
 
+// Sets or clears WorldObject::GPU_MESH_PRESENT_FLAG depending on if the GPU meshes for all model LOD levels are present.
+// Returns true if all GPU meshes are present.
+static bool updateGPUMeshPresentFlag(ServerAllWorldsState* world_state, ServerWorldState* world, WorldObject* ob, WorldStateLock& lock)
+{
+	bool all_present = !ob->model_url.empty();
+	for(int lvl = 0; (lvl <= ob->max_model_lod_level) && all_present; ++lvl)
+		all_present = world_state->resource_manager->isFileForURLPresent(WorldObject::getGPUMeshURLForLevel(ob->model_url, lvl));
+
+	if(BitUtils::isBitSet(ob->flags, WorldObject::GPU_MESH_PRESENT_FLAG) != all_present)
+	{
+		BitUtils::setOrZeroBit(ob->flags, WorldObject::GPU_MESH_PRESENT_FLAG, all_present);
+
+		ob->from_remote_flags_dirty = true; // Set this so a ObjectFlagsChanged message is sent to clients.
+		world->addWorldObjectAsDBDirty(ob, lock);
+		world->getDirtyFromRemoteObjects(lock).insert(ob);
+		world_state->markAsChanged();
+	}
+	return all_present;
+}
+
+
+// Make tasks for generating GPU meshes (see GPUMesh.h) for each model LOD level.
+// GPU meshes for LOD levels > 0 are built from the LOD meshes, so need to be generated after the LOD meshes.
+static void checkForGPUMeshesToGenerate(ServerAllWorldsState* world_state, ServerWorldState* world, WorldObject* ob, std::unordered_set<std::string>& lod_URLs_considered, 
+	const std::unordered_set<std::string>& failed_gpu_mesh_URLs, std::vector<GPUMeshToGen>& gpu_meshes_to_gen, std::vector<ObjectWithGPUMeshesToGen>& obs_with_gpu_meshes_to_gen, WorldStateLock& lock)
+{
+	try
+	{
+		if(ob->object_type != WorldObject::ObjectType_Generic || ob->model_url.empty() || hasPrefix(ob->model_url, "http:") || hasPrefix(ob->model_url, "https:"))
+			return;
+
+		ResourceRef base_resource = world_state->resource_manager->getExistingResourceForURL(ob->model_url);
+		if(!base_resource || !base_resource->isPresent()) // Base resource needs to be fully present before we start processing it.
+			return;
+
+		if(updateGPUMeshPresentFlag(world_state, world, ob, lock))
+			return;
+
+		const std::string model_abs_path = world_state->resource_manager->getLocalAbsPathForResource(*base_resource);
+
+		bool added_mesh_to_gen = false;
+		for(int lvl = 0; lvl <= ob->max_model_lod_level; ++lvl)
+		{
+			const std::string gpu_mesh_URL = WorldObject::getGPUMeshURLForLevel(ob->model_url, lvl);
+			if(lod_URLs_considered.count(gpu_mesh_URL) == 0 && failed_gpu_mesh_URLs.count(gpu_mesh_URL) == 0)
+			{
+				lod_URLs_considered.insert(gpu_mesh_URL);
+
+				if(!world_state->resource_manager->isFileForURLPresent(gpu_mesh_URL))
+				{
+					GPUMeshToGen mesh_to_gen;
+					mesh_to_gen.source_model_abs_path = WorldObject::getLODModelURLForLevel(model_abs_path, lvl);
+					mesh_to_gen.gpu_mesh_abs_path = world_state->resource_manager->pathForURL(gpu_mesh_URL);
+					mesh_to_gen.gpu_mesh_URL = gpu_mesh_URL;
+					mesh_to_gen.owner_id = base_resource->owner_id;
+					gpu_meshes_to_gen.push_back(mesh_to_gen);
+					added_mesh_to_gen = true;
+				}
+			}
+		}
+
+		if(added_mesh_to_gen)
+		{
+			ObjectWithGPUMeshesToGen ob_info;
+			ob_info.world = world;
+			ob_info.ob = ob;
+			obs_with_gpu_meshes_to_gen.push_back(ob_info);
+		}
+	}
+	catch(glare::Exception& e)
+	{
+		conPrint("MeshLODGenThread: glare::Exception: " + e.what());
+	}
+}
+
+
 static void checkMaterialFlags(ServerAllWorldsState* world_state, ServerWorldState* world, WorldObject* ob, std::map<std::string, MeshLODGenThreadTexInfo>& tex_info)
 {
 	for(size_t z=0; z<ob->materials.size(); ++z)
@@ -360,7 +494,7 @@ static void checkForLODTexturesToGenerate(ServerAllWorldsState* world_state, Ser
 						if(texture_URL == mat->colour_texture_url)
 							has_alpha = BitUtils::isBitSet(mat->flags, WorldMaterial::COLOUR_TEX_HAS_ALPHA_FLAG); // Assume mat->flags are correct.
 
-						const std::string lod_URL = mat->getLODTextureURLForLevel(texture_URL, lvl, has_alpha);
+						const std::string lod_URL = mat->getImageLODTextureURLForLevel(texture_URL, lvl, has_alpha);
 
 						if(lod_URL != texture_URL) // We don't do LOD for some texture types.
 						{
@@ -391,61 +525,129 @@ static void checkForLODTexturesToGenerate(ServerAllWorldsState* world_state, Ser
 }
 
 
-// Make tasks for generating KTX level textures.
-static void checkForKTXTexturesToGenerate(ServerAllWorldsState* world_state, ServerWorldState* world, WorldObject* ob, std::unordered_set<std::string>& lod_URLs_considered,
-	std::vector<KTXTextureToGen>& ktx_textures_to_gen)
+// Gets the material textures that may have Basis versions, with whether they are colour (sRGB) textures.
+// Metallic_fraction and opacity textures are not loaded by clients, so don't have Basis versions.
+static void getTexturesForBasis(const WorldMaterial* mat, std::vector<std::pair<std::string, bool> >& textures_out)
 {
+	textures_out.clear();
+	textures_out.push_back(std::make_pair(mat->colour_texture_url,		/*is sRGB=*/true));
+	textures_out.push_back(std::make_pair(mat->emission_texture_url,	/*is sRGB=*/true));
+	textures_out.push_back(std::make_pair(mat->roughness.texture_url,	/*is sRGB=*/false));
+	textures_out.push_back(std::make_pair(mat->normal_map_url,			/*is sRGB=*/false));
+}
+
+
+// Sets or clears WorldMaterial::BASIS_TEXTURES_PRESENT_FLAG for each material of the object, depending on if the Basis textures for all LOD levels
+// of all the material textures are present.  If any material flags changed, a ObjectFullUpdate message will be sent to clients.
+static void updateBasisTexturesPresentFlags(ServerAllWorldsState* world_state, ServerWorldState* world, WorldObject* ob, WorldStateLock& lock)
+{
+	bool flags_changed = false;
+	std::vector<std::pair<std::string, bool> > textures;
+	for(size_t z=0; z<ob->materials.size(); ++z)
+	{
+		WorldMaterial* mat = ob->materials[z].ptr();
+		if(!mat)
+			continue;
+
+		getTexturesForBasis(mat, textures);
+
+		bool have_basis_texture = false;
+		bool all_present = true;
+		for(size_t q=0; (q<textures.size()) && all_present; ++q)
+		{
+			const std::string& texture_URL = textures[q].first;
+			if(!texture_URL.empty() && !mat->getBasisTextureURLForLevel(texture_URL, 0).empty())
+			{
+				have_basis_texture = true;
+				for(int lvl = mat->minLODLevel(); (lvl <= 2) && all_present; ++lvl)
+					all_present = world_state->resource_manager->isFileForURLPresent(mat->getBasisTextureURLForLevel(texture_URL, lvl));
+			}
+		}
+
+		const bool use_basis = have_basis_texture && all_present;
+		if(mat->basisTexturesPresent() != use_basis)
+		{
+			BitUtils::setOrZeroBit(mat->flags, WorldMaterial::BASIS_TEXTURES_PRESENT_FLAG, use_basis);
+			flags_changed = true;
+		}
+	}
+
+	if(flags_changed)
+	{
+		ob->from_remote_other_dirty = true; // Set this so a ObjectFullUpdate message (which includes the materials) is sent to clients.
+		world->addWorldObjectAsDBDirty(ob, lock);
+		world->getDirtyFromRemoteObjects(lock).insert(ob);
+		world_state->markAsChanged();
+	}
+}
+
+
+// Make tasks for generating Basis Universal textures for each LOD level.
+// Basis textures for LOD levels > base level are built from the JPG/PNG LOD textures, so need to be generated after the LOD textures.
+static void checkForBasisTexturesToGenerate(ServerAllWorldsState* world_state, ServerWorldState* world, WorldObject* ob, std::unordered_set<std::string>& lod_URLs_considered,
+	const std::unordered_set<std::string>& failed_basis_URLs, std::vector<BasisTextureToGen>& basis_textures_to_gen, std::vector<ObjectWithBasisTexturesToGen>& obs_with_basis_textures_to_gen, WorldStateLock& lock)
+{
+	updateBasisTexturesPresentFlags(world_state, world, ob, lock);
+
+	bool added_tex_to_gen = false;
+	std::vector<std::pair<std::string, bool> > textures;
 	for(size_t z=0; z<ob->materials.size(); ++z)
 	{
 		const WorldMaterial* mat = ob->materials[z].ptr();
+		if(!mat || mat->basisTexturesPresent())
+			continue;
+
+		getTexturesForBasis(mat, textures);
 
-		for(int lvl = mat->minLODLevel(); lvl <= 2; ++lvl)
+		for(size_t q=0; q<textures.size(); ++q)
 		{
-			std::vector<std::string> URLs;
-			URLs.push_back(mat->colour_texture_url);
-			URLs.push_back(mat->emission_texture_url);
-			URLs.push_back(mat->roughness.texture_url);
-			URLs.push_back(mat->normal_map_url);
+			const std::string& texture_URL = textures[q].first;
+			if(texture_URL.empty() || mat->getBasisTextureURLForLevel(texture_URL, 0).empty()) // Don't generate Basis textures for mp4s, gifs etc.
+				continue;
 
-			for(size_t q=0; q<URLs.size(); ++q)
-			{
-				const std::string texture_URL = URLs[q];
-				if(!texture_URL.empty() && !hasExtension(texture_URL, "mp4") && !hasExtension(texture_URL, "gif")) // Don't generate KTX textures for mp4s or gifs
-				{
-					ResourceRef base_resource = world_state->resource_manager->getExistingResourceForURL(texture_URL);
-					if(base_resource && base_resource->isPresent()) // Base resource needs to be fully present before we start processing it.
-					{
-						const std::string lod_URL = mat->getLODTextureURLForLevel(texture_URL, lvl, /*has_alpha=*/false);  // Lod URL without ktx extension (jpg or PNG)
-						if(!hasExtension(lod_URL, "ktx2"))
-						{
-							const std::string ktx_lod_URL = ::eatExtension(lod_URL) + "ktx2";
+			ResourceRef base_resource = world_state->resource_manager->getExistingResourceForURL(texture_URL);
+			if(!base_resource || !base_resource->isPresent()) // Base resource needs to be fully present before we start processing it.
+				continue;
 
-							if(lod_URLs_considered.count(ktx_lod_URL) == 0)
-							{
-								lod_URLs_considered.insert(ktx_lod_URL);
+			bool has_alpha = false;
+			if(texture_URL == mat->colour_texture_url)
+				has_alpha = mat->colourTexHasAlpha(); // Assume mat->flags are correct.
 
-								if(!world_state->resource_manager->isFileForURLPresent(ktx_lod_URL))
-								{
-									const std::string lod_abs_path = world_state->resource_manager->pathForURL(lod_URL);
-									const std::string ktx_abs_path = world_state->resource_manager->pathForURL(ktx_lod_URL);
+			for(int lvl = mat->minLODLevel(); lvl <= 2; ++lvl)
+			{
+				const std::string basis_URL = mat->getBasisTextureURLForLevel(texture_URL, lvl);
 
-									// Generate the texture
-									KTXTextureToGen tex_to_gen;
-									tex_to_gen.source_tex_abs_path = lod_abs_path; // source texture abs path
-									tex_to_gen.ktx_tex_abs_path = ktx_abs_path; // abs path to write KTX texture to.
-									tex_to_gen.ktx_URL = ktx_lod_URL;
-									tex_to_gen.base_lod_level = mat->minLODLevel();
-									tex_to_gen.lod_level = lvl;
-									tex_to_gen.owner_id = base_resource->owner_id;
-									ktx_textures_to_gen.push_back(tex_to_gen);
-								}
-							}
-						}
+				if(lod_URLs_considered.count(basis_URL) == 0 && failed_basis_URLs.count(basis_URL) == 0)
+				{
+					lod_URLs_considered.insert(basis_URL);
+
+					if(!world_state->resource_manager->isFileForURLPresent(basis_URL))
+					{
+						const std::string lod_URL = mat->getImageLODTextureURLForLevel(texture_URL, lvl, has_alpha); // JPG or PNG texture to build the Basis texture from.
+
+						BasisTextureToGen tex_to_gen;
+						tex_to_gen.source_tex_abs_path = (lod_URL == texture_URL) ? world_state->resource_manager->getLocalAbsPathForResource(*base_resource) : world_state->resource_manager->pathForURL(lod_URL);
+						tex_to_gen.basis_tex_abs_path = world_state->resource_manager->pathForURL(basis_URL);
+						tex_to_gen.basis_URL = basis_URL;
+						tex_to_gen.base_lod_level = mat->minLODLevel();
+						tex_to_gen.lod_level = lvl;
+						tex_to_gen.is_sRGB = textures[q].second;
+						tex_to_gen.owner_id = base_resource->owner_id;
+						basis_textures_to_gen.push_back(tex_to_gen);
+						added_tex_to_gen = true;
 					}
 				}
 			}
 		}
 	}
+
+	if(added_tex_to_gen)
+	{
+		ObjectWithBasisTexturesToGen ob_info;
+		ob_info.world = world;
+		ob_info.ob = ob;
+		obs_with_basis_textures_to_gen.push_back(ob_info);
+	}
 }
 
 
@@ -459,6 +661,12 @@ void MeshLODGenThread::doRun()
 	// After that we will wait for CheckGenResourcesForObject messages, which instructs this thread to just scan a single object.
 	bool do_initial_full_scan = true;
 
+	// GPU mesh URLs that we failed to generate, or that are for unsupported meshes (e.g. skinned meshes), so we don't try to generate them again.
+	std::unordered_set<std::string> failed_gpu_mesh_URLs;
+
+	// Basis texture URLs that we failed to generate, so we don't try to generate them again.
+	std::unordered_set<std::string> failed_basis_URLs;
+
 	try
 	{
 		while(1)
@@ -488,8 +696,11 @@ void MeshLODGenThread::doRun()
 			// Set object max_lod_level if it is a generic model or a voxel model.
 			// Compute list of LOD meshes we need to generate.
 			std::vector<LODMeshToGen> meshes_to_gen;
+			std::vector<GPUMeshToGen> gpu_meshes_to_gen;
+			std::vector<ObjectWithGPUMeshesToGen> obs_with_gpu_meshes_to_gen;
 			std::vector<LODTextureToGen> lod_textures_to_gen;
-			std::vector<KTXTextureToGen> ktx_textures_to_gen;
+			std::vector<BasisTextureToGen> basis_textures_to_gen;
+			std::vector<ObjectWithBasisTexturesToGen> obs_with_basis_textures_to_gen;
 			std::unordered_set<std::string> lod_URLs_considered;
 			std::map<std::string, MeshLODGenThreadTexInfo> tex_info; // Cached info about textures
 
@@ -517,8 +728,9 @@ void MeshLODGenThread::doRun()
 									checkMaterialFlags(world_state, world, ob, tex_info);
 
 								checkForLODMeshesToGenerate(world_state, world, ob, lod_URLs_considered, meshes_to_gen);
+								checkForGPUMeshesToGenerate(world_state, world, ob, lod_URLs_considered, failed_gpu_mesh_URLs, gpu_meshes_to_gen, obs_with_gpu_meshes_to_gen, lock);
 								checkForLODTexturesToGenerate(world_state, world, ob, lod_URLs_considered, lod_textures_to_gen);
-								checkForKTXTexturesToGenerate(world_state, world, ob, lod_URLs_considered, ktx_textures_to_gen);
+								checkForBasisTexturesToGenerate(world_state, world, ob, lod_URLs_considered, failed_basis_URLs, basis_textures_to_gen, obs_with_basis_textures_to_gen, lock);
 							}
 							catch(glare::Exception& e)
 							{
@@ -541,8 +753,9 @@ void MeshLODGenThread::doRun()
 							try
 							{
 								checkForLODMeshesToGenerate(world_state, world, ob, lod_URLs_considered, meshes_to_gen);
+								checkForGPUMeshesToGenerate(world_state, world, ob, lod_URLs_considered, failed_gpu_mesh_URLs, gpu_meshes_to_gen, obs_with_gpu_meshes_to_gen, lock);
 								checkForLODTexturesToGenerate(world_state, world, ob, lod_URLs_considered, lod_textures_to_gen);
-								checkForKTXTexturesToGenerate(world_state, world, ob, lod_URLs_considered, ktx_textures_to_gen);
+								checkForBasisTexturesToGenerate(world_state, world, ob, lod_URLs_considered, failed_basis_URLs, basis_textures_to_gen, obs_with_basis_textures_to_gen, lock);
 							}
 							catch(glare::Exception& e)
 							{
@@ -553,8 +766,8 @@ void MeshLODGenThread::doRun()
 				}
 			} // End lock scope
 
-			conPrint("MeshLODGenThread: Iterating over objects took " + timer.elapsedStringNSigFigs(4) + ", meshes_to_gen: " + toString(meshes_to_gen.size()) + ", lod_textures_to_gen: " + toString(lod_textures_to_gen.size()) + 
-				", ktx_textures_to_gen: " + toString(ktx_textures_to_gen.size()));
+			conPrint("MeshLODGenThread: Iterating over objects took " + timer.elapsedStringNSigFigs(4) + ", meshes_to_gen: " + toString(meshes_to_gen.size()) + ", gpu_meshes_to_gen: " + toString(gpu_meshes_to_gen.size()) + ", lod_textures_to_gen: " + toString(lod_textures_to_gen.size()) + 
+				", basis_textures_to_gen: " + toString(basis_textures_to_gen.size()));
 
 
 			//-------------------------------------------  Generate each mesh, without holding the world lock -------------------------------------------
@@ -597,6 +810,77 @@ void MeshLODGenThread::doRun()
 			conPrint("MeshLODGenThread: Done generating LOD meshes. (Elapsed: " + timer.elapsedStringNSigFigs(4) + ")");
 
 
+			//------------------------------------------- Generate each GPU mesh, without holding the world lock -------------------------------------------
+			if(!gpu_meshes_to_gen.empty())
+			{
+				conPrint("MeshLODGenThread: Generating GPU meshes...");
+				timer.reset();
+
+				for(size_t i=0; i<gpu_meshes_to_gen.size(); ++i)
+				{
+					const GPUMeshToGen& mesh_to_gen = gpu_meshes_to_gen[i];
+					try
+					{
+						conPrint("MeshLODGenThread: Generating GPU mesh with URL " + mesh_to_gen.gpu_mesh_URL);
+
+						if(!FileUtils::fileExists(mesh_to_gen.source_model_abs_path)) // LOD model generation may have failed.
+							throw glare::Exception("Source model '" + mesh_to_gen.source_model_abs_path + "' not present.");
+
+						BatchedMeshRef batched_mesh = LODGeneration::loadModel(mesh_to_gen.source_model_abs_path);
+						if(!GPUMesh::canBuildForBatchedMesh(*batched_mesh))
+						{
+							conPrint("MeshLODGenThread: Mesh type not supported for GPU mesh, skipping.");
+							failed_gpu_mesh_URLs.insert(mesh_to_gen.gpu_mesh_URL);
+							continue;
+						}
+
+						GPUMesh::writeGPUMeshFileForBatchedMesh(*batched_mesh, mesh_to_gen.gpu_mesh_abs_path);
+
+						// Now that we have generated the GPU mesh, add it to resources.
+						{ // lock scope
+							Lock lock(world_state->mutex);
+
+							const std::string raw_path = FileUtils::getFilename(mesh_to_gen.gpu_mesh_abs_path); // NOTE: assuming we can get raw/relative path from abs path like this.
+
+							ResourceRef resource = new Resource(
+								mesh_to_gen.gpu_mesh_URL, // URL
+								raw_path, // raw local path
+								Resource::State_Present, // state
+								mesh_to_gen.owner_id
+							);
+
+							world_state->addResourcesAsDBDirty(resource);
+							world_state->resource_manager->addResource(resource);
+
+						} // End lock scope
+					}
+					catch(glare::Exception& e)
+					{
+						conPrint("\tMeshLODGenThread: glare::Exception while generating GPU mesh: " + e.what());
+						failed_gpu_mesh_URLs.insert(mesh_to_gen.gpu_mesh_URL);
+					}
+				}
+
+				// Now that the GPU meshes have been generated, set GPU_MESH_PRESENT_FLAG on objects that have all their GPU meshes present.
+				{
+					WorldStateLock lock(world_state->mutex);
+					for(size_t i=0; i<obs_with_gpu_meshes_to_gen.size(); ++i)
+					{
+						try
+						{
+							updateGPUMeshPresentFlag(world_state, obs_with_gpu_meshes_to_gen[i].world.ptr(), obs_with_gpu_meshes_to_gen[i].ob.ptr(), lock);
+						}
+						catch(glare::Exception& e)
+						{
+							conPrint("\tMeshLODGenThread: glare::Exception while updating GPU mesh flag: " + e.what());
+						}
+					}
+				}
+
+				conPrint("MeshLODGenThread: Done generating GPU meshes. (Elapsed: " + timer.elapsedStringNSigFigs(4) + ")");
+			}
+
+
 			//------------------------------------------- Generate each texture, without holding the world lock -------------------------------------------
 			conPrint("MeshLODGenThread: Generating LOD textures...");
 			timer.reset();
@@ -636,31 +920,43 @@ void MeshLODGenThread::doRun()
 
 			conPrint("MeshLODGenThread: Done generating LOD textures. (Elapsed: " + timer.elapsedStringNSigFigs(4));
 
-			//------------------------------------------- Generate each KTX texture, without holding the world lock -------------------------------------------
-// NOTE: Disable KTX texture generation currently, since basis universal has lots of compile warnings which clutter up the build output, and we don't use basisu KTX files currently.
-#if 0
-			conPrint("MeshLODGenThread: Generating KTX textures...");
-			timer.reset();
-
-			for(size_t i=0; i<ktx_textures_to_gen.size(); ++i)
+			//------------------------------------------- Generate Basis textures in parallel, without holding the world lock -------------------------------------------
+			if(!basis_textures_to_gen.empty())
 			{
-				const KTXTextureToGen& tex_to_gen = ktx_textures_to_gen[i];
-				try
+				conPrint("MeshLODGenThread: Generating " + toString(basis_textures_to_gen.size()) + " Basis textures...");
+				timer.reset();
+
+				// Run one task per texture.  If there are fewer textures than threads, let the Basis encoder for each texture use multiple threads.
+				const int num_encoder_threads = myMax(1, (int)(task_manager.getNumThreads() / basis_textures_to_gen.size()));
+
+				std::vector<Reference<GenerateBasisTextureTask>> tasks(basis_textures_to_gen.size());
+				for(size_t i=0; i<basis_textures_to_gen.size(); ++i)
 				{
-					conPrint("MeshLODGenThread: (ktx " + toString(i) + " / " + toString(ktx_textures_to_gen.size()) + "): Generating KTX texture with URL " + tex_to_gen.ktx_URL);
+					tasks[i] = new GenerateBasisTextureTask();
+					tasks[i]->tex_to_gen = basis_textures_to_gen[i];
+					tasks[i]->num_encoder_threads = num_encoder_threads;
+					task_manager.addTask(tasks[i]);
+				}
+				task_manager.waitForTasksToComplete();
 
-					LODGeneration::generateKTXTexture(tex_to_gen.source_tex_abs_path, 
-						tex_to_gen.base_lod_level, tex_to_gen.lod_level, tex_to_gen.ktx_tex_abs_path, 
-						task_manager);
+				// Add generated textures to resources, then set BASIS_TEXTURES_PRESENT_FLAG on materials that have all their Basis textures present.
+				// Textures are only added as resources once completely written, so if the server is stopped during generation, the remaining textures will be generated on the next full scan.
+				{
+					WorldStateLock lock(world_state->mutex);
 
-					// Now that we have generated the LOD model, add it to resources.
-					{ // lock scope
-						Lock lock(world_state->mutex);
+					for(size_t i=0; i<tasks.size(); ++i)
+					{
+						const BasisTextureToGen& tex_to_gen = tasks[i]->tex_to_gen;
+						if(!tasks[i]->succeeded)
+						{
+							failed_basis_URLs.insert(tex_to_gen.basis_URL);
+							continue;
+						}
 
-						const std::string raw_path = FileUtils::getFilename(tex_to_gen.ktx_tex_abs_path); // NOTE: assuming we can get raw/relative path from abs path like this.
+						const std::string raw_path = FileUtils::getFilename(tex_to_gen.basis_tex_abs_path); // NOTE: assuming we can get raw/relative path from abs path like this.
 
 						ResourceRef resource = new Resource(
-							tex_to_gen.ktx_URL, // URL
+							tex_to_gen.basis_URL, // URL
 							raw_path, // raw local path
 							Resource::State_Present, // state
 							tex_to_gen.owner_id
@@ -668,18 +964,23 @@ void MeshLODGenThread::doRun()
 
 						world_state->addResourcesAsDBDirty(resource);
 						world_state->resource_manager->addResource(resource);
+					}
 
-					} // End lock scope
-				}
-				catch(glare::Exception& e)
-				{
-					conPrint("\tMeshLODGenThread: excep while generating KTX texture: " + e.what());
-				}
-			}
+					for(size_t i=0; i<obs_with_basis_textures_to_gen.size(); ++i)
+					{
+						try
+						{
+							updateBasisTexturesPresentFlags(world_state, obs_with_basis_textures_to_gen[i].world.ptr(), obs_with_basis_textures_to_gen[i].ob.ptr(), lock);
+						}
+						catch(glare::Exception& e)
+						{
+							conPrint("\tMeshLODGenThread: glare::Exception while updating Basis texture flags: " + e.what());
+						}
+					}
+				} // End lock scope
 
-			conPrint("MeshLODGenThread: Done generating KTX textures. (Elapsed: " + timer.elapsedStringNSigFigs(4) + ")");
-#endif
-			//------------------------------------------- End Generate each KTX texture  -------------------------------------------
+				conPrint("MeshLODGenThread: Done generating Basis textures. (Elapsed: " + timer.elapsedStringNSigFigs(4) + ")");
+			}
 		}
 	}
 	catch(glare::Exception& e)
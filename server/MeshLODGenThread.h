@@ -21,7 +21,9 @@ public:
 /*=====================================================================
 MeshLODGenThread
 ----------------
-Does generation of LOD meshes, also LOD textures and KTX textures.
+Does generation of LOD meshes, GPU meshes (see GPUMesh.h), also LOD textures and Basis Universal (.basis) textures.
+Basis textures are generated in parallel on the thread's task manager, after which
+WorldMaterial::BASIS_TEXTURES_PRESENT_FLAG is set on materials that have all their Basis textures present.
 
 Lightmap LOD generation is done by LightMapperBot.
 =====================================================================*/
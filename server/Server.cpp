@@ -10,6 +10,7 @@ Copyright Glare Technologies Limited 2023 -
 #include "UDPHandlerThread.h"
 #include "MeshLODGenThread.h"
 #include "DynamicTextureUpdaterThread.h"
+#include "MapTileGenThread.h"
 #include "ChunkGenThread.h"
 #include "WorkerThread.h"
 #include "ServerTestSuite.h"
@@ -40,6 +41,7 @@ Copyright Glare Technologies Limited 2023 -
 #include <maths/Rect2.h>
 #include <graphics/BasisDecoder.h>
 #include <utils/ThreadManager.h>
+#include <utils/TaskManager.h>
 #include <utils/PlatformUtils.h>
 #include <utils/Clock.h>
 #include <utils/Timer.h>
@@ -58,80 +60,39 @@ Copyright Glare Technologies Limited 2023 -
 #endif
 
 
+// Add tile screenshot objects for any tiles in the map range that don't have one yet.
+// Tiles at MapTileGenThread::MAX_TILE_Z are rendered by the screenshot bot, tiles at lower zoom levels are built by MapTileGenThread.
 void updateMapTiles(ServerAllWorldsState& world_state)
 {
 	uint64 next_shot_id = world_state.getNextScreenshotUID();
 
-	const int z_begin = 0;
-	const int z_end = 7;
-	if(true) // world_state.map_tile_info.empty())
+	for(int z = 0; z <= MapTileGenThread::MAX_TILE_Z; ++z)
 	{
-		// world_state.map_tile_info.clear();
+		// in general num_tiles = (span*2)^2 = ((2^(z-2))*2)^2 = (2^(z-1))^2 = 2^((z-1)*2) = 2^(2z - 2)
+		// zoom level 6: num_tiles = 2^10 = 1024
+		int x_begin, x_end, y_begin, y_end;
+		MapTileGenThread::getTileRange(z, x_begin, x_end, y_begin, y_end);
 
-		for(int z = z_begin; z < z_end; ++z)
+		for(int y = y_begin; y < y_end; ++y)
+		for(int x = x_begin; x < x_end; ++x)
 		{
-			const float TILE_WIDTH_M = 5120.f / (1 << z); //TILE_WIDTH_PX * metres_per_pixel;
-			//const float TILE_WIDTH_M = 2560.f/*5120.f*/ / (1 << z); //TILE_WIDTH_PX * metres_per_pixel;
+			const Vec3<int> v(x, y, z);
 
-			const int span = (int)std::ceil(300 / TILE_WIDTH_M);
-			const int plus_x_span = (int)std::ceil(700 / TILE_WIDTH_M);  // NOTE: pushing out positive x span here to encompass east districts
-			const int plus_y_span = (int)std::ceil(530 / TILE_WIDTH_M);  // NOTE: pushing out positive y span here to encompass north district
-
-
-			// We want zoom level 3 to have (half) span 2 = 2^1.
-			// zoom level 4 : span = 2^(4-2) = 2^2 = 4.
-			// So num tiles = (4*2)^2 = 64
-			// zoom level 5 : span = 2^(5-2) = 2^3 = 8.
-			// So num tiles = (8*2)^2 = 256
-
-			// in general num_tiles = (span*2)^2 = ((2^(z-2))*2)^2 = (2^(z-1))^2 = 2^((z-1)*2) = 2^(2z - 2)
-			// zoom level 6: num_tiles = 2^10 = 1024
-			//const int span = 1 << myMax(0, z - 2); // 2^(z-2)
-
-			const int x_begin = -span;
-			const int x_end = plus_x_span;
-			const int y_begin = -span;
-			const int y_end = plus_y_span;
-
-			
-
-			for(int y = y_begin; y < y_end; ++y)
-			for(int x = x_begin; x < x_end; ++x)
+			if(world_state.map_tile_info.info.count(v) == 0)
 			{
-				const Vec3<int> v(x, y, z);
-
-				if(world_state.map_tile_info.info.count(v) == 0)
-				{
+				TileInfo info;
+				info.cur_tile_screenshot = MapTileGenThread::makeMapTileScreenshot(next_shot_id++, v);
 
-					TileInfo info;
-					info.cur_tile_screenshot = new Screenshot();
-					info.cur_tile_screenshot->id = next_shot_id++;
-					info.cur_tile_screenshot->created_time = TimeStamp::currentTime();
-					info.cur_tile_screenshot->state = Screenshot::ScreenshotState_notdone;
-					info.cur_tile_screenshot->is_map_tile = true;
-					info.cur_tile_screenshot->tile_x = x;
-					info.cur_tile_screenshot->tile_y = y;
-					info.cur_tile_screenshot->tile_z = z;
+				world_state.map_tile_info.info[v] = info;
 
-					world_state.map_tile_info.info[v] = info;
+				conPrint("Added map tile screenshot: " + v.toString());
 
-					conPrint("Added map tile screenshot: " + v.toString());
+				world_state.markAsChanged();
 
-					world_state.markAsChanged();
-
-					world_state.map_tile_info.db_dirty = true;
-				}
+				world_state.map_tile_info.db_dirty = true;
 			}
 		}
 	}
-	else
-	{
-		// TEMP: Redo screenshot
-		/*for(auto it = world_state.map_tile_info.begin(); it != world_state.map_tile_info.end(); ++it)
-		{
-			it->second.cur_tile_screenshot->state = Screenshot::ScreenshotState_notdone;
-		}*/
-	}
 }
 
 
@@ -386,7 +347,10 @@ int main(int argc, char *argv[])
 
 		// updateToUseImageCubeMeshes(*server.world_state);
 		
-		server.world_state->denormaliseData();
+		{
+			glare::TaskManager task_manager("denormaliseData task manager");
+			server.world_state->denormaliseData(task_manager);
+		}
 
 
 
@@ -520,6 +484,8 @@ int main(int argc, char *argv[])
 
 		server.dyn_tex_updater_thread_manager.addThread(new DynamicTextureUpdaterThread(&server, server.world_state.ptr()));
 
+		server.map_tile_gen_thread_manager.addThread(new MapTileGenThread(&server, server.world_state.ptr()));
+
 		server.lua_http_manager = new LuaHTTPRequestManager(&server);
 
 		//----------------------------------------------- Create any Lua scripts for objects -----------------------------------------------
@@ -1049,6 +1015,36 @@ int main(int argc, char *argv[])
 				}
 			}
 
+			if((loop_iter % 10) == 0) // Approx every 1 s.
+			{
+				// Send the minimum protocol version of all connected clients to clients that understand the MinClientProtocolVersion message, if it has changed since it was last sent to them.
+				// Clients use this to decide whether they can use newer formats for data that is relayed to other clients, such as voice frames longer than 10 ms.
+				Lock lock3(server.worker_thread_manager.getMutex());
+
+				uint32 min_client_protocol_version = Protocol::CyberspaceProtocolVersion;
+				for(auto i = server.worker_thread_manager.getThreads().begin(); i != server.worker_thread_manager.getThreads().end(); ++i)
+				{
+					assert(dynamic_cast<WorkerThread*>(i->getPointer()));
+					const int64 client_protocol_version = static_cast<WorkerThread*>(i->getPointer())->updates_connection_protocol_version;
+					if(client_protocol_version > 0)
+						min_client_protocol_version = myMin(min_client_protocol_version, (uint32)client_protocol_version);
+				}
+
+				MessageUtils::initPacket(scratch_packet, Protocol::MinClientProtocolVersion);
+				scratch_packet.writeUInt32(min_client_protocol_version);
+				MessageUtils::updatePacketLengthField(scratch_packet);
+
+				for(auto i = server.worker_thread_manager.getThreads().begin(); i != server.worker_thread_manager.getThreads().end(); ++i)
+				{
+					WorkerThread* worker = static_cast<WorkerThread*>(i->getPointer());
+					if((worker->updates_connection_protocol_version >= 41) && (worker->sent_min_client_protocol_version != min_client_protocol_version)) // MinClientProtocolVersion was introduced in protocol version 41.
+					{
+						worker->enqueueDataToSend(scratch_packet);
+						worker->sent_min_client_protocol_version = min_client_protocol_version;
+					}
+				}
+			}
+
 #if USE_GLARE_PARCEL_AUCTION_CODE
 			if(server_config.update_parcel_sales && ((loop_iter % 512) == 0)) // Approx every 50 s.
 			{
@@ -1153,6 +1149,7 @@ Server::~Server()
 
 	// Stop any threads that may refer to other data members first
 	dyn_tex_updater_thread_manager.killThreadsBlocking();
+	map_tile_gen_thread_manager.killThreadsBlocking();
 	udp_handler_thread_manager.killThreadsBlocking();
 	mesh_lod_gen_thread_manager.killThreadsBlocking();
 	worker_thread_manager.killThreadsBlocking();
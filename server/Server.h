@@ -150,6 +150,8 @@ public:
 
 	ThreadManager dyn_tex_updater_thread_manager;
 
+	ThreadManager map_tile_gen_thread_manager;
+
 	ThreadSafeQueue<Reference<ThreadMessage> > message_queue; // Contains messages from worker threads to the main server thread.
 
 	std::string screenshot_dir;
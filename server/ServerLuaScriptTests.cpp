@@ -448,6 +448,21 @@ void ServerLuaScriptTests::test()
 			world_ob2->event_handlers = NULL; // Clean up from test
 		}
 
+		//-------------------------------- Test setProximityRadius --------------------------------
+		{
+			const std::string script_src = "setProximityRadius(124, 5.5)";
+			Reference<LuaScriptEvaluator> lua_script_evaluator = new LuaScriptEvaluator(&vm, &output_handler, script_src, world_ob.ptr(), main_world_state.ptr(), lock);
+
+			testAssert(world_ob2->event_handlers && world_ob2->event_handlers->proximity_radius == 5.5f);
+
+			world_ob2->event_handlers = NULL; // Clean up from test
+		}
+		{ // Test radius out of range
+			testExceptionExpected([&]() { new LuaScriptEvaluator(&vm, &output_handler, "setProximityRadius(124, 1000)", world_ob.ptr(), main_world_state.ptr(), lock); });
+			testExceptionExpected([&]() { new LuaScriptEvaluator(&vm, &output_handler, "setProximityRadius(124, -1)", world_ob.ptr(), main_world_state.ptr(), lock); });
+			world_ob2->event_handlers = NULL; // Clean up from test
+		}
+
 		// Test listener added twice with addEventListener
 		{
 			const std::string script_src = 
@@ -32,11 +32,13 @@ Reference<ServerSideScript> parseXMLScript(const std::string& script)
 				const std::string base_url = XMLParseUtils::parseString(dynamic_texture_update_elem, "base_url");
 				const uint32 material_index = XMLParseUtils::parseIntWithDefault(dynamic_texture_update_elem, "material_index", 0);
 				const std::string material_texture = XMLParseUtils::parseStringWithDefault(dynamic_texture_update_elem, "material_texture", "colour");
+				const double refresh_interval = XMLParseUtils::parseDoubleWithDefault(dynamic_texture_update_elem, "refresh_interval", 3600.0);
 
 				Reference<ServerSideScript> script_ob = new ServerSideScript();
 				script_ob->base_image_URL = base_url;
 				script_ob->material_index = material_index;
 				script_ob->material_texture = material_texture;
+				script_ob->refresh_interval = myClamp(refresh_interval, 60.0, 7 * 24 * 3600.0); // Don't allow checking more often than once a minute.
 				return script_ob;
 			}
 		}
@@ -16,11 +16,13 @@ namespace ServerSideScripting
 class ServerSideScript : public RefCounted
 {
 public:
+	ServerSideScript() : material_index(0), material_texture("colour"), refresh_interval(3600.0) {}
 	virtual ~ServerSideScript() {}
 
 	std::string base_image_URL;
 	size_t material_index;
 	std::string material_texture; // One of "colour", "emission".  Default is "colour"
+	double refresh_interval; // Time between checks of base_image_URL, in seconds.  Default is 3600.
 };
 
 
@@ -7,6 +7,10 @@ Copyright Glare Technologies Limited 2023 -
 
 
 #include "AccountHandlers.h"
+#include "WebPageCache.h"
+#include "DynamicTextureUpdaterThread.h"
+#include "MapTileGenThread.h"
+#include "LuaHTTPRequestManager.h"
 #include "ServerLuaScriptTests.h"
 #include "../shared/WorldObject.h"
 #include "../shared/LODGeneration.h"
@@ -114,6 +118,10 @@ void ServerTestSuite::test()
 	runTest([&]() { RLP::test();														});
 	runTest([&]() { Signing::test();													});
 	runTest([&]() { AccountHandlers::test();											});
+	runTest([&]() { WebPageCache::test();												});
+	runTest([&]() { DynamicTextureUpdaterThread::test();								});
+	runTest([&]() { LuaHTTPRequestManager::test();										});
+	runTest([&]() { MapTileGenThread::test();											});
 	runTest([&]() { HTTPClient::test();													}, /*mem leak allowed=*/true); // Leaks due to libtls allocating globals
 	
 	// runTest([&]() { BatchedMeshTests::test();										}); // Uses some Indigo files
@@ -19,9 +19,23 @@ Generated at 2016-01-12 12:22:34 +1300
 #include <Database.h>
 #include <BufferOutStream.h>
 #include <BufferViewInStream.h>
+#include <TaskManager.h>
 #include "../shared/LODChunk.h"
 
 
+void ServerWorldState::addMapChangedObject(const WorldObject& ob)
+{
+	const js::AABBox aabb = ob.getAABBWS();
+	map_changed_objects[ob.uid] = MapChangedRegion({aabb.min_[0], aabb.min_[1], aabb.max_[0], aabb.max_[1]});
+}
+
+
+void ServerWorldState::addMapChangedParcel(const Parcel& parcel)
+{
+	map_changed_parcels[parcel.id] = MapChangedRegion({(float)parcel.aabb_min.x, (float)parcel.aabb_min.y, (float)parcel.aabb_max.x, (float)parcel.aabb_max.y});
+}
+
+
 ServerAllWorldsState::ServerAllWorldsState()
 {
 	next_avatar_uid = UID(0);
@@ -29,6 +43,8 @@ ServerAllWorldsState::ServerAllWorldsState()
 	next_order_uid = 0;
 	next_sub_eth_transaction_uid = 0;
 
+	web_data_version = 0;
+
 	world_states[""] = new ServerWorldState();
 
 	last_parcel_update_info.last_parcel_sale_update_hour = 0;
@@ -104,6 +120,354 @@ static const uint32 OBJECT_STORAGE_ITEM_VERSION = 1;
 static const uint32 USER_SECRET_VERSION = 1;
 
 
+namespace
+{
+
+struct DBRecordRef
+{
+	DatabaseKey database_key;
+	const uint8* data;
+	size_t len;
+};
+
+
+// Deserialised objects from a contiguous range of database records.  Filled in by DecodeDBRecordsTask, then merged into ServerAllWorldsState on the calling thread.
+struct DecodedDBRecords
+{
+	DecodedDBRecords() : eth_info_read(false), feature_flags_read(false), last_parcel_update_info_read(false), map_tile_info_read(false), hit_eos(false) {}
+
+	std::vector<std::pair<std::string, WorldObjectRef>> objects; // (world name, object) pairs
+	std::vector<std::pair<std::string, ParcelRef>> parcels; // (world name, parcel) pairs
+	std::vector<std::pair<std::string, LODChunkRef>> lod_chunks; // (world name, chunk) pairs
+	std::vector<DBRecordRef> world_settings_records; // WorldSettings is non-copyable, and there are few of these records, so they are decoded while merging.
+	std::vector<UserRef> users;
+	std::vector<ResourceRef> resources;
+	std::vector<OrderRef> orders;
+	std::vector<UserWebSessionRef> sessions;
+	std::vector<ParcelAuctionRef> auctions;
+	std::vector<ScreenshotRef> screenshots;
+	std::vector<SubEthTransactionRef> sub_eth_transactions;
+	std::vector<NewsPostRef> news_posts;
+	std::vector<ObjectStorageItemRef> object_storage_items;
+	std::vector<UserSecretRef> user_secrets;
+	std::vector<SubEventRef> events;
+
+	// Singleton records.  If there are multiple in the range, the last one read is kept, which is the same as the sequential behaviour.
+	EthInfo eth_info;
+	bool eth_info_read;
+	FeatureFlagInfo feature_flag_info;
+	bool feature_flags_read;
+	LastParcelUpdateInfo last_parcel_update_info;
+	bool last_parcel_update_info_read;
+	MapTileInfo map_tile_info;
+	bool map_tile_info_read;
+
+	bool hit_eos; // Was EOS_CHUNK read?  If so, decoding stopped at it, and records in later ranges should be ignored.
+
+	std::string error_msg; // Non-empty if an exception was thrown while decoding.
+};
+
+
+static void decodeDBRecord(const DBRecordRef& record_ref, DecodedDBRecords& out)
+{
+	const DatabaseKey database_key = record_ref.database_key;
+
+	BufferViewInStream stream(ArrayRef<uint8>(record_ref.data, record_ref.len));
+
+	const uint32 chunk = stream.readUInt32();
+	if(chunk == WORLD_CHUNK)
+	{
+		// Not doing anything wtih this chunk.  Instead the world name is saved with each object and parcel.
+	}
+	else if(chunk == WORLD_OBJECT_CHUNK)
+	{
+		// Read world name
+		const std::string world_name = stream.readStringLengthFirst(10000);
+
+		// Deserialise object
+		WorldObjectRef world_ob = new WorldObject();
+		readWorldObjectFromStream(stream, *world_ob);
+
+		//TEMP HACK: clear lightmap needed flag
+		BitUtils::zeroBit(world_ob->flags, WorldObject::LIGHTMAP_NEEDS_COMPUTING_FLAG);
+
+		world_ob->database_key = database_key;
+		out.objects.push_back(std::make_pair(world_name, world_ob));
+	}
+	else if(chunk == USER_CHUNK)
+	{
+		// Deserialise user
+		UserRef user = new User();
+		readUserFromStream(stream, *user);
+
+		user->database_key = database_key;
+		out.users.push_back(user);
+	}
+	else if(chunk == PARCEL_CHUNK)
+	{
+		// Read world name
+		const std::string world_name = stream.readStringLengthFirst(10000);
+
+		// Deserialise parcel
+		ParcelRef parcel = new Parcel();
+		readFromStream(stream, *parcel);
+
+		parcel->database_key = database_key;
+		out.parcels.push_back(std::make_pair(world_name, parcel));
+	}
+	else if(chunk == WORLD_SETTINGS_CHUNK)
+	{
+		out.world_settings_records.push_back(record_ref);
+	}
+	else if(chunk == RESOURCE_CHUNK)
+	{
+		// Deserialise resource
+		ResourceRef resource = new Resource();
+		const uint32 res_version = readFromStream(stream, *resource);
+					
+		// Resource serialisation version 3 added serialisation of resource state.  If we are reading a resource before that, just assume it is present on disk,
+		// which is what addResource() below used to do.
+		if(res_version < 3)
+			resource->setState(Resource::State_Present);
+
+		resource->database_key = database_key;
+		out.resources.push_back(resource);
+	}
+	else if(chunk == ORDER_CHUNK)
+	{
+		// Deserialise order
+		OrderRef order = new Order();
+		readFromStream(stream, *order);
+
+		order->database_key = database_key;
+		out.orders.push_back(order);
+	}
+	else if(chunk == USER_WEB_SESSION_CHUNK)
+	{
+		// Deserialise UserWebSession
+		UserWebSessionRef session = new UserWebSession();
+		readFromStream(stream, *session);
+
+		session->database_key = database_key;
+		out.sessions.push_back(session);
+	}
+	else if(chunk == PARCEL_AUCTION_CHUNK)
+	{
+		// Deserialise ParcelAuction
+		ParcelAuctionRef auction = new ParcelAuction();
+		readFromStream(stream, *auction);
+
+		auction->database_key = database_key;
+		out.auctions.push_back(auction);
+	}
+	else if(chunk == SCREENSHOT_CHUNK)
+	{
+		// Deserialise Screenshot
+		ScreenshotRef shot = new Screenshot();
+		readScreenshotFromStream(stream, *shot);
+
+		shot->database_key = database_key;
+		out.screenshots.push_back(shot);
+	}
+	else if(chunk == SUB_ETH_TRANSACTIONS_CHUNK)
+	{
+		// Deserialise SubEthTransaction
+		SubEthTransactionRef trans = new SubEthTransaction();
+		readFromStream(stream, *trans);
+
+		trans->database_key = database_key;
+		out.sub_eth_transactions.push_back(trans);
+	}
+	else if(chunk == NEWS_POST_CHUNK)
+	{
+		// Deserialise NewsPost
+		NewsPostRef post = new NewsPost();
+		readNewsPostFromStream(stream, *post);
+
+		post->database_key = database_key;
+		out.news_posts.push_back(post);
+	}
+	else if(chunk == OBJECT_STORAGE_ITEM_CHUNK)
+	{
+		// Deserialise ObjectStorageItem
+		const uint32 item_version = stream.readUInt32();
+		if(item_version != OBJECT_STORAGE_ITEM_VERSION)
+			throw glare::Exception("invalid object storage item version: " + toString(item_version));
+
+		ObjectStorageItemRef item = new ObjectStorageItem();
+
+		// Read key
+		item->key.ob_uid = readUIDFromStream(stream);
+		item->key.key_string = stream.readStringLengthFirst(1000);
+
+		// Read size of data
+		const uint32 data_size = stream.readUInt32();
+		if(data_size > (1 << 16))
+			throw glare::Exception("Invalid object storage data size: " + toString(data_size));
+
+		// Read data
+		item->data.resizeNoCopy(data_size);
+		stream.readData(item->data.data(), data_size);
+
+		item->database_key = database_key;
+		out.object_storage_items.push_back(item);
+	}
+	else if(chunk == USER_SECRET_CHUNK)
+	{
+		// Deserialise UserSecret
+		const uint32 user_secret_version = stream.readUInt32();
+		if(user_secret_version != USER_SECRET_VERSION)
+			throw glare::Exception("invalid user secret version: " + toString(user_secret_version));
+
+		UserSecretRef secret = new UserSecret();
+
+		// Read key
+		secret->key.user_id = readUserIDFromStream(stream);
+		secret->key.secret_name = stream.readStringLengthFirst(UserSecret::MAX_SECRET_NAME_SIZE);
+					
+		secret->value = stream.readStringLengthFirst(UserSecret::MAX_VALUE_SIZE);
+
+		secret->database_key = database_key;
+		out.user_secrets.push_back(secret);
+	}
+	else if(chunk == ETH_INFO_CHUNK)
+	{
+		const uint32 eth_info_v = stream.readInt32();
+		if(eth_info_v != ETH_INFO_CHUNK_VERSION)
+			throw glare::Exception("invalid eth_info version: " + toString(eth_info_v));
+
+		out.eth_info.database_key = database_key;
+		out.eth_info.min_next_nonce = stream.readInt32();
+		out.eth_info_read = true;
+	}
+	else if(chunk == FEATURE_FLAG_CHUNK)
+	{
+		const uint32 ff_info_v = stream.readInt32();
+		if(ff_info_v != FEATURE_FLAG_CHUNK_VERSION)
+			throw glare::Exception("invalid feature flag version: " + toString(ff_info_v));
+
+		out.feature_flag_info.database_key = database_key;
+		out.feature_flag_info.feature_flags = stream.readUInt64();
+		out.feature_flags_read = true;
+	}
+	else if(chunk == LAST_PARCEL_SALE_UPDATE_CHUNK)
+	{
+		const uint32 update_v = stream.readInt32();
+		if(update_v != PARCEL_SALE_UPDATE_VERSION)
+			throw glare::Exception("invalid parcel_sale_update_version: " + toString(update_v));
+
+		out.last_parcel_update_info.database_key = database_key;
+		out.last_parcel_update_info.last_parcel_sale_update_hour = stream.readInt32();
+		out.last_parcel_update_info.last_parcel_sale_update_day = stream.readInt32();
+		out.last_parcel_update_info.last_parcel_sale_update_year = stream.readInt32();
+		out.last_parcel_update_info_read = true;
+	}
+	else if(chunk == MAP_TILE_INFO_CHUNK)
+	{
+		const uint32 map_tile_info_version = stream.readInt32();
+		if(map_tile_info_version != MAP_TILE_INFO_VERSION)
+			throw glare::Exception("invalid map_tile_info_version: " + toString(map_tile_info_version));
+
+		const int num_tiles = stream.readInt32();
+		for(int i=0; i<num_tiles; ++i)
+		{
+			const int x = stream.readInt32();
+			const int y = stream.readInt32();
+			const int z = stream.readInt32();
+
+			TileInfo tile_info;
+			const bool cur_tile_screenshot_non_null = stream.readInt32() != 0;
+			if(cur_tile_screenshot_non_null)
+			{
+				tile_info.cur_tile_screenshot = new Screenshot();
+				readScreenshotFromStream(stream, *tile_info.cur_tile_screenshot);
+			}
+			const bool prev_tile_screenshot_non_null = stream.readInt32() != 0;
+			if(prev_tile_screenshot_non_null)
+			{
+				tile_info.prev_tile_screenshot = new Screenshot();
+				readScreenshotFromStream(stream, *tile_info.prev_tile_screenshot);
+			}
+
+			out.map_tile_info.info[Vec3<int>(x, y, z)] = tile_info; // Insert
+		}
+
+		out.map_tile_info.database_key = database_key;
+		out.map_tile_info_read = true;
+	}
+	else if(chunk == LOD_CHUNK_CHUNK)
+	{
+		// Read world name
+		const std::string world_name = stream.readStringLengthFirst(10000);
+
+		Reference<LODChunk> lod_chunk = new LODChunk();
+		readLODChunkFromStream(stream, *lod_chunk);
+					
+		lod_chunk->database_key = database_key;
+		out.lod_chunks.push_back(std::make_pair(world_name, lod_chunk));
+	}
+	else if(chunk == SUB_EVENT_CHUNK)
+	{
+		// Deserialise SubEvent
+		SubEventRef event = new SubEvent();
+		readSubEventFromStream(stream, *event);
+
+		event->database_key = database_key;
+		out.events.push_back(event);
+	}
+	else if(chunk == EOS_CHUNK)
+	{
+		out.hit_eos = true;
+	}
+	else
+	{
+		throw glare::Exception("Unknown chunk type '" + toString(chunk) + "'");
+	}
+}
+
+
+// Decodes database records [begin, end) into a DecodedDBRecords.
+class DecodeDBRecordsTask : public glare::Task
+{
+public:
+	virtual void run(size_t thread_index)
+	{
+		try
+		{
+			for(size_t i=begin; i<end; ++i)
+			{
+				decodeDBRecord((*records)[i], *out);
+				if(out->hit_eos)
+					break;
+			}
+		}
+		catch(glare::Exception& e)
+		{
+			out->error_msg = e.what();
+		}
+		catch(std::exception& e) // E.g. std::bad_alloc
+		{
+			out->error_msg = std::string("std::exception while decoding database records: ") + e.what();
+		}
+	}
+
+	const std::vector<DBRecordRef>* records;
+	size_t begin, end;
+	DecodedDBRecords* out;
+};
+
+
+static ServerWorldState* getOrCreateWorld(std::map<std::string, Reference<ServerWorldState> >& world_states, const std::string& world_name)
+{
+	Reference<ServerWorldState>& world = world_states[world_name];
+	if(world.isNull())
+		world = new ServerWorldState();
+	return world.ptr();
+}
+
+} // end anonymous namespace
+
+
 void ServerAllWorldsState::readFromDisk(const std::string& path)
 {
 	conPrint("Reading world state from '" + path + "'...");
@@ -112,6 +476,8 @@ void ServerAllWorldsState::readFromDisk(const std::string& path)
 
 	Timer timer;
 
+	glare::TaskManager task_manager("ServerAllWorldsState::readFromDisk task manager");
+
 	size_t num_obs = 0;
 	size_t num_parcels = 0;
 	size_t num_orders = 0;
@@ -139,325 +505,188 @@ void ServerAllWorldsState::readFromDisk(const std::string& path)
 	if(!is_pre_database_format)
 	{
 		// Using database
+		Timer phase_timer;
 		database.startReadingFromDisk(path);
+		const double db_read_time = phase_timer.elapsed();
 
+		// Get references to all valid records.  The record data is not copied, we just point into the database's data.
+		phase_timer.reset();
+		std::vector<DBRecordRef> records;
+		records.reserve(database.getRecordMap().size());
 		for(auto it = database.getRecordMap().begin(); it != database.getRecordMap().end(); ++it)
 		{
-			const DatabaseKey database_key = it->first;
 			const Database::RecordInfo& record = it->second;
-
 			if(record.isRecordValid())
 			{
-				BufferViewInStream stream(ArrayRef<uint8>(database.getInitialRecordData(record), record.len));
-
-				// Now deserialise from our temp buffer
-				const uint32 chunk = stream.readUInt32();
-				if(chunk == WORLD_CHUNK)
-				{
-					// Not doing anything wtih this chunk.  Instead the world name is saved with each object and parcel.
-				}
-				else if(chunk == WORLD_OBJECT_CHUNK)
-				{
-					// Read world name
-					const std::string world_name = stream.readStringLengthFirst(10000);
-
-					// Create ServerWorldState for world name if needed
-					if(world_states.count(world_name) == 0) 
-						world_states[world_name] = new ServerWorldState();
-
-					// Deserialise object
-					WorldObjectRef world_ob = new WorldObject();
-					readWorldObjectFromStream(stream, *world_ob);
-
-					//TEMP HACK: clear lightmap needed flag
-					BitUtils::zeroBit(world_ob->flags, WorldObject::LIGHTMAP_NEEDS_COMPUTING_FLAG);
-
-					world_ob->database_key = database_key;
-					world_states[world_name]->getObjects(lock)[world_ob->uid] = world_ob; // Add to object map
-					num_obs++;
-
-					next_object_uid = UID(myMax(world_ob->uid.value() + 1, next_object_uid.value()));
-				}
-				else if(chunk == USER_CHUNK)
-				{
-					// Deserialise user
-					UserRef user = new User();
-					readUserFromStream(stream, *user);
-
-					user->database_key = database_key;
-					user_id_to_users[user->id] = user; // Add to user map
-					name_to_users[user->name] = user; // Add to user map
-				}
-				else if(chunk == PARCEL_CHUNK)
-				{
-					// Read world name
-					const std::string world_name = stream.readStringLengthFirst(10000);
+				DBRecordRef record_ref;
+				record_ref.database_key = it->first;
+				record_ref.data = database.getInitialRecordData(record);
+				record_ref.len = record.len;
+				records.push_back(record_ref);
+			}
+		}
+		const double record_collection_time = phase_timer.elapsed();
 
-					// Create ServerWorldState for world name if needed
-					if(world_states.count(world_name) == 0) 
-						world_states[world_name] = new ServerWorldState();
+		// Decode records in parallel.  Each task decodes a contiguous range of records into its own DecodedDBRecords.
+		phase_timer.reset();
+		const size_t MIN_RECORDS_PER_TASK = 1024;
+		const size_t num_tasks = myMax<size_t>(1, myMin<size_t>(task_manager.getNumThreads() * 4, (records.size() + MIN_RECORDS_PER_TASK - 1) / MIN_RECORDS_PER_TASK));
+		const size_t records_per_task = (records.size() + num_tasks - 1) / num_tasks;
 
-					// Deserialise parcel
-					ParcelRef parcel = new Parcel();
-					readFromStream(stream, *parcel);
+		std::vector<DecodedDBRecords> decoded(num_tasks);
+		for(size_t t=0; t<num_tasks; ++t)
+		{
+			DecodeDBRecordsTask* task = new DecodeDBRecordsTask();
+			task->records = &records;
+			task->begin = myMin(records.size(), t * records_per_task);
+			task->end   = myMin(records.size(), (t + 1) * records_per_task);
+			task->out = &decoded[t];
+			task_manager.addTask(task);
+		}
+		task_manager.waitForTasksToComplete();
+		const double decode_time = phase_timer.elapsed();
 
-					parcel->database_key = database_key;
-					world_states[world_name]->getParcels(lock)[parcel->id] = parcel; // Add to parcel map
-					num_parcels++;
-				}
-				else if(chunk == WORLD_SETTINGS_CHUNK)
-				{
-					// Read world name
-					const std::string world_name = stream.readStringLengthFirst(10000);
-
-					// Create ServerWorldState for world name if needed
-					if(world_states.count(world_name) == 0) 
-						world_states[world_name] = new ServerWorldState();
-
-					// NOTE: There was a bug with multiple world settings for the same world getting saved to the database.  Resolve ambiguity of which one to use by choosing the setting with the largest database key value.
-					// Use these new settings iff the existing settings are either uninitialised (in which case database_key will be invalid), or the settings we are reading from the DB have a greater key 
-					// value than the existing settings.
-					const bool use_settings = !world_states[world_name]->world_settings.database_key.valid() || (database_key.value() > world_states[world_name]->world_settings.database_key.value());
-					if(use_settings)
-					{	
-						// Deserialise world settings
-						readWorldSettingsFromStream(stream, world_states[world_name]->world_settings);
-
-						world_states[world_name]->world_settings.database_key = database_key;
-					}
+		// Merge decoded records into our maps, in record order, so that the result is the same as decoding sequentially.
+		phase_timer.reset();
+		for(size_t t=0; t<num_tasks; ++t)
+		{
+			DecodedDBRecords& d = decoded[t];
+			if(!d.error_msg.empty())
+				throw glare::Exception(d.error_msg);
 
-					num_world_settings++;
-				}
-				else if(chunk == RESOURCE_CHUNK)
-				{
-					// Deserialise resource
-					ResourceRef resource = new Resource();
-					const uint32 res_version = readFromStream(stream, *resource);
-					
-					// Resource serialisation version 3 added serialisation of resource state.  If we are reading a resource before that, just assume it is present on disk,
-					// which is what addResource() below used to do.
-					if(res_version < 3)
-						resource->setState(Resource::State_Present);
+			for(size_t i=0; i<d.objects.size(); ++i)
+			{
+				WorldObject* world_ob = d.objects[i].second.ptr();
+				getOrCreateWorld(world_states, d.objects[i].first)->getObjects(lock)[world_ob->uid] = d.objects[i].second; // Add to object map
+				next_object_uid = UID(myMax(world_ob->uid.value() + 1, next_object_uid.value()));
+			}
+			num_obs += d.objects.size();
 
-					//conPrint("Loaded resource:\n  URL: '" + resource->URL + "'\n  local_path: '" + resource->getLocalPath() + "'\n  owner_id: " + resource->owner_id.toString());
+			for(size_t i=0; i<d.users.size(); ++i)
+			{
+				user_id_to_users[d.users[i]->id] = d.users[i]; // Add to user map
+				name_to_users[d.users[i]->name] = d.users[i]; // Add to user map
+			}
 
-					resource->database_key = database_key;
-					this->resource_manager->addResource(resource);
-				}
-				else if(chunk == ORDER_CHUNK)
-				{
-					// Deserialise order
-					OrderRef order = new Order();
-					readFromStream(stream, *order);
+			for(size_t i=0; i<d.parcels.size(); ++i)
+				getOrCreateWorld(world_states, d.parcels[i].first)->getParcels(lock)[d.parcels[i].second->id] = d.parcels[i].second; // Add to parcel map
+			num_parcels += d.parcels.size();
 
-					order->database_key = database_key;
-					orders[order->id] = order; // Add to order map
+			for(size_t i=0; i<d.world_settings_records.size(); ++i)
+			{
+				const DatabaseKey database_key = d.world_settings_records[i].database_key;
+				BufferViewInStream stream(ArrayRef<uint8>(d.world_settings_records[i].data, d.world_settings_records[i].len));
+				stream.readUInt32(); // Skip chunk
 
-					next_order_uid = myMax(order->id + 1, next_order_uid);
-					num_orders++;
-				}
-				else if(chunk == USER_WEB_SESSION_CHUNK)
-				{
-					// Deserialise UserWebSession
-					UserWebSessionRef session = new UserWebSession();
-					readFromStream(stream, *session);
+				// Read world name
+				const std::string world_name = stream.readStringLengthFirst(10000);
 
-					session->database_key = database_key;
-					user_web_sessions[session->id] = session; // Add to session map
-					num_sessions++;
-				}
-				else if(chunk == PARCEL_AUCTION_CHUNK)
-				{
-					// Deserialise ParcelAuction
-					ParcelAuctionRef auction = new ParcelAuction();
-					readFromStream(stream, *auction);
+				ServerWorldState* world = getOrCreateWorld(world_states, world_name);
 
-					auction->database_key = database_key;
-					parcel_auctions[auction->id] = auction;
-					num_auctions++;
-				}
-				else if(chunk == SCREENSHOT_CHUNK)
-				{
-					// Deserialise Screenshot
-					ScreenshotRef shot = new Screenshot();
-					readScreenshotFromStream(stream, *shot);
+				// NOTE: There was a bug with multiple world settings for the same world getting saved to the database.  Resolve ambiguity of which one to use by choosing the setting with the largest database key value.
+				// Use these new settings iff the existing settings are either uninitialised (in which case database_key will be invalid), or the settings we are reading from the DB have a greater key 
+				// value than the existing settings.
+				const bool use_settings = !world->world_settings.database_key.valid() || (database_key.value() > world->world_settings.database_key.value());
+				if(use_settings)
+				{	
+					// Deserialise world settings
+					readWorldSettingsFromStream(stream, world->world_settings);
 
-					shot->database_key = database_key;
-					screenshots[shot->id] = shot;
-					num_screenshots++;
+					world->world_settings.database_key = database_key;
 				}
-				else if(chunk == SUB_ETH_TRANSACTIONS_CHUNK)
-				{
-					// Deserialise Screenshot
-					SubEthTransactionRef trans = new SubEthTransaction();
-					readFromStream(stream, *trans);
+			}
+			num_world_settings += d.world_settings_records.size();
 
-					next_sub_eth_transaction_uid = myMax(trans->id + 1, next_sub_eth_transaction_uid);
+			for(size_t i=0; i<d.resources.size(); ++i)
+				this->resource_manager->addResource(d.resources[i]);
 
-					trans->database_key = database_key;
-					sub_eth_transactions[trans->id] = trans;
-					num_sub_eth_transactions++;
-				}
-				else if(chunk == NEWS_POST_CHUNK)
-				{
-					// Deserialise NewsPost
-					NewsPostRef post = new NewsPost();
-					readNewsPostFromStream(stream, *post);
+			for(size_t i=0; i<d.orders.size(); ++i)
+			{
+				orders[d.orders[i]->id] = d.orders[i]; // Add to order map
+				next_order_uid = myMax(d.orders[i]->id + 1, next_order_uid);
+			}
+			num_orders += d.orders.size();
 
-					post->database_key = database_key;
-					news_posts[post->id] = post;
-					num_news_posts++;
-				}
-				else if(chunk == OBJECT_STORAGE_ITEM_CHUNK)
-				{
-					// Deserialise ObjectStorageItem
-					const uint32 item_version = stream.readUInt32();
-					if(item_version != OBJECT_STORAGE_ITEM_VERSION)
-						throw glare::Exception("invalid object storage item version: " + toString(item_version));
-
-					ObjectStorageItemRef item = new ObjectStorageItem();
-
-					// Read key
-					item->key.ob_uid = readUIDFromStream(stream);
-					item->key.key_string = stream.readStringLengthFirst(1000);
-
-					// Read size of data
-					const uint32 data_size = stream.readUInt32();
-					if(data_size > (1 << 16))
-						throw glare::Exception("Invalid object storage data size: " + toString(data_size));
-
-					// Read data
-					item->data.resizeNoCopy(data_size);
-					stream.readData(item->data.data(), data_size);
-
-					item->database_key = database_key;
-					object_storage_items[item->key] = item;
-					object_num_storage_items[item->key.ob_uid]++;
-					num_object_storage_items++;
-				}
-				else if(chunk == USER_SECRET_CHUNK)
-				{
-					// Deserialise UserSecret
-					const uint32 user_secret_version = stream.readUInt32();
-					if(user_secret_version != USER_SECRET_VERSION)
-						throw glare::Exception("invalid user secret version: " + toString(user_secret_version));
+			for(size_t i=0; i<d.sessions.size(); ++i)
+				user_web_sessions[d.sessions[i]->id] = d.sessions[i]; // Add to session map
+			num_sessions += d.sessions.size();
 
-					UserSecretRef secret = new UserSecret();
+			for(size_t i=0; i<d.auctions.size(); ++i)
+				parcel_auctions[d.auctions[i]->id] = d.auctions[i];
+			num_auctions += d.auctions.size();
 
-					// Read key
-					secret->key.user_id = readUserIDFromStream(stream);
-					secret->key.secret_name = stream.readStringLengthFirst(UserSecret::MAX_SECRET_NAME_SIZE);
-					
-					secret->value = stream.readStringLengthFirst(UserSecret::MAX_VALUE_SIZE);
+			for(size_t i=0; i<d.screenshots.size(); ++i)
+				screenshots[d.screenshots[i]->id] = d.screenshots[i];
+			num_screenshots += d.screenshots.size();
 
-					secret->database_key = database_key;
-					user_secrets[secret->key] = secret;
-					num_user_secrets++;
-				}
-				else if(chunk == ETH_INFO_CHUNK)
-				{
-					const uint32 eth_info_v = stream.readInt32();
-					if(eth_info_v != ETH_INFO_CHUNK_VERSION)
-						throw glare::Exception("invalid eth_info version: " + toString(eth_info_v));
+			for(size_t i=0; i<d.sub_eth_transactions.size(); ++i)
+			{
+				sub_eth_transactions[d.sub_eth_transactions[i]->id] = d.sub_eth_transactions[i];
+				next_sub_eth_transaction_uid = myMax(d.sub_eth_transactions[i]->id + 1, next_sub_eth_transaction_uid);
+			}
+			num_sub_eth_transactions += d.sub_eth_transactions.size();
 
-					this->eth_info.database_key = database_key;
-					this->eth_info.min_next_nonce = stream.readInt32();
-				}
-				else if(chunk == FEATURE_FLAG_CHUNK)
-				{
-					const uint32 ff_info_v = stream.readInt32();
-					if(ff_info_v != FEATURE_FLAG_CHUNK_VERSION)
-						throw glare::Exception("invalid feature flag version: " + toString(ff_info_v));
+			for(size_t i=0; i<d.news_posts.size(); ++i)
+				news_posts[d.news_posts[i]->id] = d.news_posts[i];
+			num_news_posts += d.news_posts.size();
 
-					this->feature_flag_info.database_key = database_key;
+			for(size_t i=0; i<d.object_storage_items.size(); ++i)
+			{
+				ObjectStorageItemRef item = d.object_storage_items[i];
+				object_storage_items[item->key] = item;
+				object_num_storage_items[item->key.ob_uid]++;
+			}
+			num_object_storage_items += d.object_storage_items.size();
 
-					this->feature_flag_info.feature_flags = stream.readUInt64();
-				}
-				else if(chunk == LAST_PARCEL_SALE_UPDATE_CHUNK)
-				{
-					const uint32 update_v = stream.readInt32();
-					if(update_v != PARCEL_SALE_UPDATE_VERSION)
-						throw glare::Exception("invalid parcel_sale_update_version: " + toString(update_v));
-
-					this->last_parcel_update_info.database_key = database_key;
-					this->last_parcel_update_info.last_parcel_sale_update_hour = stream.readInt32();
-					this->last_parcel_update_info.last_parcel_sale_update_day = stream.readInt32();
-					this->last_parcel_update_info.last_parcel_sale_update_year = stream.readInt32();
-				}
-				else if(chunk == MAP_TILE_INFO_CHUNK)
-				{
-					const uint32 map_tile_info_version = stream.readInt32();
-					if(map_tile_info_version != MAP_TILE_INFO_VERSION)
-						throw glare::Exception("invalid map_tile_info_version: " + toString(map_tile_info_version));
+			for(size_t i=0; i<d.user_secrets.size(); ++i)
+				user_secrets[d.user_secrets[i]->key] = d.user_secrets[i];
+			num_user_secrets += d.user_secrets.size();
 
-					const int num_tiles = stream.readInt32();
-					for(int i=0; i<num_tiles; ++i)
-					{
-						const int x = stream.readInt32();
-						const int y = stream.readInt32();
-						const int z = stream.readInt32();
-
-						TileInfo tile_info;
-						const bool cur_tile_screenshot_non_null = stream.readInt32() != 0;
-						if(cur_tile_screenshot_non_null)
-						{
-							tile_info.cur_tile_screenshot = new Screenshot();
-							readScreenshotFromStream(stream, *tile_info.cur_tile_screenshot);
-						}
-						const bool prev_tile_screenshot_non_null = stream.readInt32() != 0;
-						if(prev_tile_screenshot_non_null)
-						{
-							tile_info.prev_tile_screenshot = new Screenshot();
-							readScreenshotFromStream(stream, *tile_info.prev_tile_screenshot);
-						}
-
-						map_tile_info.info[Vec3<int>(x, y, z)] = tile_info; // Insert
-					}
+			if(d.eth_info_read)
+			{
+				this->eth_info.database_key = d.eth_info.database_key;
+				this->eth_info.min_next_nonce = d.eth_info.min_next_nonce;
+			}
 
-					map_tile_info.database_key = database_key;
+			if(d.feature_flags_read)
+			{
+				this->feature_flag_info.database_key = d.feature_flag_info.database_key;
+				this->feature_flag_info.feature_flags = d.feature_flag_info.feature_flags;
+			}
 
-					num_tiles_read = num_tiles;
-				}
-				else if(chunk == LOD_CHUNK_CHUNK)
-				{
-					// Read world name
-					const std::string world_name = stream.readStringLengthFirst(10000);
+			if(d.last_parcel_update_info_read)
+			{
+				this->last_parcel_update_info.database_key = d.last_parcel_update_info.database_key;
+				this->last_parcel_update_info.last_parcel_sale_update_hour = d.last_parcel_update_info.last_parcel_sale_update_hour;
+				this->last_parcel_update_info.last_parcel_sale_update_day = d.last_parcel_update_info.last_parcel_sale_update_day;
+				this->last_parcel_update_info.last_parcel_sale_update_year = d.last_parcel_update_info.last_parcel_sale_update_year;
+			}
 
-					// Create ServerWorldState for world name if needed
-					if(world_states.count(world_name) == 0) 
-						world_states[world_name] = new ServerWorldState();
+			if(d.map_tile_info_read)
+			{
+				for(auto it = d.map_tile_info.info.begin(); it != d.map_tile_info.info.end(); ++it)
+					map_tile_info.info[it->first] = it->second; // Insert
+				map_tile_info.database_key = d.map_tile_info.database_key;
+				num_tiles_read = d.map_tile_info.info.size();
+			}
 
-					Reference<LODChunk> lod_chunk = new LODChunk();
+			for(size_t i=0; i<d.lod_chunks.size(); ++i)
+				getOrCreateWorld(world_states, d.lod_chunks[i].first)->getLODChunks(lock)[d.lod_chunks[i].second->coords] = d.lod_chunks[i].second;
+			num_lod_chunks += d.lod_chunks.size();
 
-					readLODChunkFromStream(stream, *lod_chunk);
-					
-					lod_chunk->database_key = database_key;
-					world_states[world_name]->getLODChunks(lock)[lod_chunk->coords] = lod_chunk;
-					num_lod_chunks++;
-				}
-				else if(chunk == SUB_EVENT_CHUNK)
-				{
-					// Deserialise SubEvent
-					SubEventRef event = new SubEvent();
-					readSubEventFromStream(stream, *event);
+			for(size_t i=0; i<d.events.size(); ++i)
+				events[d.events[i]->id] = d.events[i];
+			num_events += d.events.size();
 
-					event->database_key = database_key;
-					events[event->id] = event;
-					num_events++;
-				}
-				else if(chunk == EOS_CHUNK)
-				{
-					break;
-				}
-				else
-				{
-					throw glare::Exception("Unknown chunk type '" + toString(chunk) + "'");
-				}
-			}
+			if(d.hit_eos)
+				break; // Ignore any records after the EOS chunk.
 		}
-
+		const double merge_time = phase_timer.elapsed();
 
 		database.finishReadingFromDisk();
+
+		conPrint("Database load phases: DB read: " + doubleToStringNSigFigs(db_read_time, 4) + " s, record collection: " + doubleToStringNSigFigs(record_collection_time, 4) + 
+			" s, decode (" + toString(num_tasks) + " tasks): " + doubleToStringNSigFigs(decode_time, 4) + " s, merge: " + doubleToStringNSigFigs(merge_time, 4) + " s");
 	}
 	else // Else if is_pre_database:
 	{
@@ -648,7 +877,9 @@ void ServerAllWorldsState::readFromDisk(const std::string& path)
 	}
 
 
-	denormaliseData();
+	Timer denormalise_timer;
+	denormaliseData(task_manager);
+	conPrint("denormaliseData took " + denormalise_timer.elapsedStringNSigFigs(4));
 
 	// Compress voxel data if needed.
 	for(auto world_it = world_states.begin(); world_it != world_states.end(); ++world_it)
@@ -719,6 +950,27 @@ void ServerAllWorldsState::addEverythingToDirtySets()
 }
 
 
+void ServerAllWorldsState::addScreenshotsAsDBDirty(const std::vector<ScreenshotRef>& shots)
+{
+	if(shots.empty())
+		return;
+
+	for(size_t i=0; i<shots.size(); ++i)
+		db_dirty_screenshots.insert(shots[i]);
+	changed = 1;
+	web_data_version++;
+}
+
+
+uint64 ServerAllWorldsState::getWebDataVersion()
+{
+	WorldStateLock lock(mutex);
+
+	// Parcels are only displayed on web pages for the root world.
+	return web_data_version + getRootWorldState()->getParcelsVersion(lock);
+}
+
+
 bool ServerAllWorldsState::isInReadOnlyMode()
 { 
 	Lock lock(mutex); 
@@ -734,30 +986,30 @@ void ServerAllWorldsState::clearAndReset() // Just for fuzzing
 }
 
 
-void ServerAllWorldsState::denormaliseData()
+namespace
 {
-	WorldStateLock lock(mutex);
 
-	for(auto world_it = world_states.begin(); world_it != world_states.end(); ++world_it)
+// Builds denormalised fields for a range of objects or parcels.  Only reads from the user map, and each object/parcel is written by a single task, so no locking is needed.
+class DenormaliseTask : public glare::Task
+{
+public:
+	virtual void run(size_t thread_index)
 	{
-		Reference<ServerWorldState> world_state = world_it->second;
-
-		// Build cached fields like WorldObject::creator_name
-		for(auto i=world_state->getObjects(lock).begin(); i != world_state->getObjects(lock).end(); ++i)
+		for(size_t i=begin; i<end; ++i)
 		{
-			auto res = user_id_to_users.find(i->second->creator_id);
-			if(res != user_id_to_users.end())
-				i->second->creator_name = res->second->name;
+			auto res = user_id_to_users->find((*objects)[i]->creator_id);
+			if(res != user_id_to_users->end())
+				(*objects)[i]->creator_name = res->second->name;
 		}
 
-		for(auto i=world_state->getParcels(lock).begin(); i != world_state->getParcels(lock).end(); ++i)
+		for(size_t i=parcels_begin; i<parcels_end; ++i)
 		{
-			Parcel* parcel = i->second.ptr();
+			Parcel* parcel = (*parcels)[i];
 
 			// Denormalise Parcel::owner_name
 			{
-				auto res = user_id_to_users.find(parcel->owner_id); // Lookup user from owner_id
-				if(res != user_id_to_users.end())
+				auto res = user_id_to_users->find(parcel->owner_id); // Lookup user from owner_id
+				if(res != user_id_to_users->end())
 					parcel->owner_name = res->second->name;
 			}
 
@@ -765,27 +1017,95 @@ void ServerAllWorldsState::denormaliseData()
 			parcel->admin_names.resize(parcel->admin_ids.size());
 			for(size_t z=0; z<parcel->admin_ids.size(); ++z)
 			{
-				auto res = user_id_to_users.find(parcel->admin_ids[z]); // Lookup user from admin id
-				if(res != user_id_to_users.end())
-				{
-					//conPrint("admin: " + res->second->name);
+				auto res = user_id_to_users->find(parcel->admin_ids[z]); // Lookup user from admin id
+				if(res != user_id_to_users->end())
 					parcel->admin_names[z] = res->second->name;
-				}
 			}
 
 			// Denormalise Parcel::writer_names
 			parcel->writer_names.resize(parcel->writer_ids.size());
 			for(size_t z=0; z<parcel->writer_ids.size(); ++z)
 			{
-				auto res = user_id_to_users.find(parcel->writer_ids[z]); // Lookup user from writer id
-				if(res != user_id_to_users.end())
-				{
-					//conPrint("writer: " + res->second->name);
+				auto res = user_id_to_users->find(parcel->writer_ids[z]); // Lookup user from writer id
+				if(res != user_id_to_users->end())
 					parcel->writer_names[z] = res->second->name;
-				}
 			}
 		}
 	}
+
+	const std::map<UserID, Reference<User>>* user_id_to_users;
+	const std::vector<WorldObject*>* objects;
+	size_t begin, end;
+	const std::vector<Parcel*>* parcels;
+	size_t parcels_begin, parcels_end;
+};
+
+} // end anonymous namespace
+
+
+// This is called after edits to users, parcels etc., so just do the work on this thread.
+// Creating a task manager per call, while holding the world state lock, costs more than the parallelism saves.
+void ServerAllWorldsState::denormaliseData()
+{
+	doDenormaliseData(/*task_manager=*/NULL);
+}
+
+
+void ServerAllWorldsState::denormaliseData(glare::TaskManager& task_manager)
+{
+	doDenormaliseData(&task_manager);
+}
+
+
+void ServerAllWorldsState::doDenormaliseData(glare::TaskManager* task_manager)
+{
+	WorldStateLock lock(mutex);
+
+	// Gather objects and parcels from all worlds into flat arrays so they can be split evenly between tasks.
+	std::vector<WorldObject*> all_objects;
+	std::vector<Parcel*> all_parcels;
+	for(auto world_it = world_states.begin(); world_it != world_states.end(); ++world_it)
+	{
+		ServerWorldState* world_state = world_it->second.ptr();
+
+		for(auto i=world_state->getObjects(lock).begin(); i != world_state->getObjects(lock).end(); ++i)
+			all_objects.push_back(i->second.ptr());
+
+		for(auto i=world_state->getParcels(lock).begin(); i != world_state->getParcels(lock).end(); ++i)
+			all_parcels.push_back(i->second.ptr());
+	}
+
+	// Build cached fields like WorldObject::creator_name, Parcel::owner_name
+	if(!task_manager)
+	{
+		DenormaliseTask task;
+		task.user_id_to_users = &user_id_to_users;
+		task.objects = &all_objects;
+		task.begin = 0;
+		task.end = all_objects.size();
+		task.parcels = &all_parcels;
+		task.parcels_begin = 0;
+		task.parcels_end = all_parcels.size();
+		task.run(/*thread_index=*/0);
+		return;
+	}
+
+	const size_t num_tasks = myMax<size_t>(1, task_manager->getNumThreads());
+	const size_t obs_per_task     = (all_objects.size() + num_tasks - 1) / num_tasks;
+	const size_t parcels_per_task = (all_parcels.size() + num_tasks - 1) / num_tasks;
+	for(size_t t=0; t<num_tasks; ++t)
+	{
+		DenormaliseTask* task = new DenormaliseTask();
+		task->user_id_to_users = &user_id_to_users;
+		task->objects = &all_objects;
+		task->begin = myMin(all_objects.size(), t * obs_per_task);
+		task->end   = myMin(all_objects.size(), (t + 1) * obs_per_task);
+		task->parcels = &all_parcels;
+		task->parcels_begin = myMin(all_parcels.size(), t * parcels_per_task);
+		task->parcels_end   = myMin(all_parcels.size(), (t + 1) * parcels_per_task);
+		task_manager->addTask(task);
+	}
+	task_manager->waitForTasksToComplete();
 }
 
 
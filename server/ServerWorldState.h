@@ -30,6 +30,7 @@ Copyright Glare Technologies Limited 2024 -
 #include <unordered_set>
 class ServerWorldState;
 class WebDataStore;
+namespace glare { class TaskManager; }
 
 
 struct OpenSeaParcelListing
@@ -38,6 +39,13 @@ struct OpenSeaParcelListing
 };
 
 
+// 2D (x, y) bounds of a changed object or parcel, used for invalidating map tiles.  See MapTileGenThread.
+struct MapChangedRegion
+{
+	float min_x, min_y, max_x, max_y;
+};
+
+
 struct TileInfo
 {
 	ScreenshotRef cur_tile_screenshot;
@@ -208,8 +216,10 @@ members private and having accessor methods that take a WorldStateLock argument.
 class ServerWorldState : public ThreadSafeRefCounted
 {
 public:
-	void addParcelAsDBDirty     (const ParcelRef parcel,  WorldStateLock& /*world_state_lock*/) { db_dirty_parcels.insert(parcel); }
-	void addWorldObjectAsDBDirty(const WorldObjectRef ob, WorldStateLock& /*world_state_lock*/) { db_dirty_world_objects.insert(ob); }
+	ServerWorldState() : parcels_version(0), track_map_changes(false) {}
+
+	void addParcelAsDBDirty     (const ParcelRef parcel,  WorldStateLock& /*world_state_lock*/) { db_dirty_parcels.insert(parcel); parcels_version++; if(track_map_changes) addMapChangedParcel(*parcel); }
+	void addWorldObjectAsDBDirty(const WorldObjectRef ob, WorldStateLock& /*world_state_lock*/) { db_dirty_world_objects.insert(ob); if(track_map_changes) addMapChangedObject(*ob); }
 	void addLODChunkAsDBDirty   (const LODChunkRef ob,    WorldStateLock& /*world_state_lock*/) { db_dirty_lod_chunks.insert(ob); }
 
 	WorldSettings world_settings;
@@ -232,7 +242,24 @@ public:
 	std::unordered_set<ParcelRef, ParcelRefHash>&           getDBDirtyParcels(WorldStateLock& /*world_state_lock*/) { return db_dirty_parcels; }
 	std::unordered_set<LODChunkRef, LODChunkRefHash>&       getDBDirtyLODChunks(WorldStateLock& /*world_state_lock*/) { return db_dirty_lod_chunks; }
 
+	uint64 getParcelsVersion(WorldStateLock& /*world_state_lock*/) const { return parcels_version; }
+
+	// If enabled, the bounds of objects and parcels marked as DB dirty are recorded, so that the map tiles covering them can be regenerated.
+	// Only enabled for the root world, by MapTileGenThread, which also takes the recorded changes.
+	void setTrackMapChanges(bool track, WorldStateLock& /*world_state_lock*/) { track_map_changes = track; }
+	std::map<UID, MapChangedRegion>&      getMapChangedObjects(WorldStateLock& /*world_state_lock*/) { return map_changed_objects; }
+	std::map<ParcelID, MapChangedRegion>& getMapChangedParcels(WorldStateLock& /*world_state_lock*/) { return map_changed_parcels; }
+
 private:
+	void addMapChangedObject(const WorldObject& ob);
+	void addMapChangedParcel(const Parcel& parcel);
+
+	uint64 parcels_version; // Incremented whenever a parcel is marked as DB dirty.  Used for invalidating cached web pages.
+
+	bool track_map_changes;
+	std::map<UID, MapChangedRegion> map_changed_objects; // Latest bounds of changed objects, since last taken by MapTileGenThread.
+	std::map<ParcelID, MapChangedRegion> map_changed_parcels;
+
 	ObjectMapType objects;
 	DirtyFromRemoteObjectSetType dirty_from_remote_objects; // TODO: could just use vector for this, and avoid duplicates by checking object dirty flag.
 	AvatarMapType avatars;
@@ -258,7 +285,8 @@ public:
 	void readFromDisk(const std::string& path);
 	void createNewDatabase(const std::string& path);
 	void serialiseToDisk(WorldStateLock& lock) REQUIRES(mutex); // Write any changed data (objects in dirty set) to disk.  Mutex should be held already.
-	void denormaliseData(); // Build/update cached/denormalised fields like creator_name.
+	void denormaliseData(); // Build/update cached/denormalised fields like creator_name.  Does the work on the calling thread.
+	void denormaliseData(glare::TaskManager& task_manager); // Does the work in parallel using task_manager.  Used when loading the database.
 
 	// Removes sensitive information from the database, such as user passwords, email addresses, billing information, web sessions etc.
 	// Then saves the updates to disk.
@@ -287,17 +315,22 @@ public:
 	Reference<ServerWorldState> getRootWorldState(); // Guaranteed to return a non-null reference
 
 	void addResourcesAsDBDirty(const ResourceRef resource)					REQUIRES(mutex) { db_dirty_resources.insert(resource); changed = 1; }
-	void addSubEthTransactionAsDBDirty(const SubEthTransactionRef trans)	REQUIRES(mutex) { db_dirty_sub_eth_transactions.insert(trans); changed = 1; }
+	void addSubEthTransactionAsDBDirty(const SubEthTransactionRef trans)	REQUIRES(mutex) { db_dirty_sub_eth_transactions.insert(trans); changed = 1; web_data_version++; }
 	void addOrderAsDBDirty(const OrderRef order)							REQUIRES(mutex) { db_dirty_orders.insert(order); changed = 1; }
-	void addParcelAuctionAsDBDirty(const ParcelAuctionRef parcel_auction)	REQUIRES(mutex) { db_dirty_parcel_auctions.insert(parcel_auction); changed = 1; }
+	void addParcelAuctionAsDBDirty(const ParcelAuctionRef parcel_auction)	REQUIRES(mutex) { db_dirty_parcel_auctions.insert(parcel_auction); changed = 1; web_data_version++; }
 	void addUserWebSessionAsDBDirty(const UserWebSessionRef screenshot)		REQUIRES(mutex) { db_dirty_userwebsessions.insert(screenshot); changed = 1; }
-	void addScreenshotAsDBDirty(const ScreenshotRef screenshot)				REQUIRES(mutex) { db_dirty_screenshots.insert(screenshot); changed = 1; }
-	void addUserAsDBDirty(const UserRef user)								REQUIRES(mutex) { db_dirty_users.insert(user); changed = 1; }
-	void addNewsPostAsDBDirty(const NewsPostRef post)						REQUIRES(mutex) { db_dirty_news_posts.insert(post); changed = 1; }
-	void addEventAsDBDirty(const SubEventRef event)							REQUIRES(mutex) { db_dirty_events.insert(event); changed = 1; }
+	void addScreenshotAsDBDirty(const ScreenshotRef screenshot)				REQUIRES(mutex) { db_dirty_screenshots.insert(screenshot); changed = 1; web_data_version++; }
+	void addScreenshotsAsDBDirty(const std::vector<ScreenshotRef>& shots)	REQUIRES(mutex); // Only increments web_data_version once for the whole batch.
+	void addUserAsDBDirty(const UserRef user)								REQUIRES(mutex) { db_dirty_users.insert(user); changed = 1; web_data_version++; }
+	void addNewsPostAsDBDirty(const NewsPostRef post)						REQUIRES(mutex) { db_dirty_news_posts.insert(post); changed = 1; web_data_version++; }
+	void addEventAsDBDirty(const SubEventRef event)							REQUIRES(mutex) { db_dirty_events.insert(event); changed = 1; web_data_version++; }
 
 	void addEverythingToDirtySets();
 
+	// Returns a counter that changes whenever data shown on cacheable web pages (parcels, auctions, users, screenshots, news posts, events) changes.
+	// See WebPageCache.  Locks mutex.
+	uint64 getWebDataVersion();
+
 	bool isInReadOnlyMode();
 
 	void clearAndReset(); // Just for fuzzing
@@ -391,6 +424,8 @@ public:
 private:
 	GLARE_DISABLE_COPY(ServerAllWorldsState);
 
+	void doDenormaliseData(glare::TaskManager* task_manager); // task_manager may be NULL, in which case the work is done on the calling thread.
+
 	glare::AtomicInt changed;
 
 	UID next_object_uid GUARDED_BY(mutex);
@@ -398,5 +433,7 @@ private:
 	uint64 next_order_uid GUARDED_BY(mutex);
 	uint64 next_sub_eth_transaction_uid GUARDED_BY(mutex);
 
+	uint64 web_data_version GUARDED_BY(mutex);
+
 	Database database GUARDED_BY(mutex);
 };
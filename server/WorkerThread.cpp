@@ -11,6 +11,7 @@ Copyright Glare Technologies Limited 2018 -
 #include "Screenshot.h"
 #include "SubEthTransaction.h"
 #include "MeshLODGenThread.h"
+#include "MapTileGenThread.h"
 #include "../webserver/LoginHandlers.h"
 #include "../shared/Protocol.h"
 #include "../shared/ProtocolStructs.h"
@@ -57,7 +58,9 @@ WorkerThread::WorkerThread(const Reference<SocketInterface>& socket_, Server* se
 	server(server_),
 	scratch_packet(SocketBufferOutStream::DontUseNetworkByteOrder),
 	fuzzing(false),
-	write_trace(false)
+	write_trace(false),
+	updates_connection_protocol_version(0),
+	sent_min_client_protocol_version(0)
 {
 	//if(VERBOSE) print("event_fd.efd: " + toString(event_fd.efd));
 
@@ -477,10 +480,12 @@ void WorkerThread::handleScreenshotBotConnection()
 				if(screenshot.isNull())
 				{
 					// Find first screenshot in map_tile_info map in ScreenshotState_notdone state.  NOTE: slow linear scan.
+					// Only tiles at the highest zoom level are rendered by the bot, tiles at lower zoom levels are built from them by MapTileGenThread.
 					for(auto it = server->world_state->map_tile_info.info.begin(); it != server->world_state->map_tile_info.info.end(); ++it)
 					{
 						TileInfo& tile_info = it->second;
-						if(tile_info.cur_tile_screenshot.nonNull() && tile_info.cur_tile_screenshot->state == Screenshot::ScreenshotState_notdone)
+						if(tile_info.cur_tile_screenshot.nonNull() && tile_info.cur_tile_screenshot->state == Screenshot::ScreenshotState_notdone &&
+							tile_info.cur_tile_screenshot->tile_z == MapTileGenThread::MAX_TILE_Z)
 						{
 							screenshot = tile_info.cur_tile_screenshot;
 							break;
@@ -903,6 +908,8 @@ void WorkerThread::doRun()
 			if(CAPTURE_TRACES)
 				this->write_trace = true;
 
+			this->updates_connection_protocol_version = client_protocol_version;
+
 			// Read name of world to connect to
 			const std::string world_name = socket->readStringLengthFirst(1000);
 			conPrintIfNotFuzzing("Client connecting to world '" + world_name + "'...");
@@ -1706,7 +1713,32 @@ void WorkerThread::doRun()
 										}
 										else
 										{
+											const std::string old_model_url = ob->model_url;
+											const bool old_gpu_mesh_present = BitUtils::isBitSet(ob->flags, WorldObject::GPU_MESH_PRESENT_FLAG);
+											const std::vector<WorldMaterialRef> old_materials = ob->materials;
+
 											ob->copyNetworkStateFrom(temp_ob);
+
+											// GPU_MESH_PRESENT_FLAG is only set by the server (MeshLODGenThread), so don't take it from the client.
+											BitUtils::setOrZeroBit(ob->flags, WorldObject::GPU_MESH_PRESENT_FLAG, old_gpu_mesh_present && (ob->model_url == old_model_url));
+
+											// Likewise for WorldMaterial::BASIS_TEXTURES_PRESENT_FLAG.  Keep it only if the material textures are unchanged.
+											bool material_textures_changed = ob->materials.size() != old_materials.size();
+											for(size_t z=0; z<ob->materials.size(); ++z)
+												if(ob->materials[z].nonNull())
+												{
+													const WorldMaterial* old_mat = (z < old_materials.size()) ? old_materials[z].ptr() : NULL;
+													if(ob->materials[z]->updateBasisTexturesPresentFlag(old_mat))
+														material_textures_changed = true;
+												}
+
+											if((ob->model_url != old_model_url) || material_textures_changed)
+											{
+												// Send a message to MeshLODGenThread to generate LOD and GPU meshes and Basis textures for the new model and textures (if not already generated)
+												CheckGenResourcesForObject* msg = new CheckGenResourcesForObject();
+												msg->ob_uid = ob->uid;
+												server->enqueueMsgForLodGenThread(msg);
+											}
 											
 											// Clamp volume to the max allowed level
 											ob->audio_volume = myClamp(ob->audio_volume, 0.f, maxAudioVolumeForObject(*ob, client_user_id, client_user_name, this->connected_world_name));
@@ -1803,6 +1835,7 @@ void WorkerThread::doRun()
 									{
 										ob->model_url = new_model_url;
 										ob->last_modified_time = TimeStamp::currentTime();
+										BitUtils::zeroBit(ob->flags, WorldObject::GPU_MESH_PRESENT_FLAG); // GPU meshes are for the old model, MeshLODGenThread will set the flag again once generated.
 
 										ob->from_remote_model_url_dirty = true;
 										cur_world_state->addWorldObjectAsDBDirty(ob, lock);
@@ -1811,6 +1844,11 @@ void WorkerThread::doRun()
 										markLODChunkAsNeedsRebuildForChangedObject(cur_world_state.ptr(), ob, lock);
 
 										world_state->markAsChanged();
+
+										// Send a message to MeshLODGenThread to generate LOD and GPU meshes for the new model (if not already generated)
+										CheckGenResourcesForObject* msg = new CheckGenResourcesForObject();
+										msg->ob_uid = ob->uid;
+										server->enqueueMsgForLodGenThread(msg);
 									}
 								}
 							}
@@ -1832,7 +1870,10 @@ void WorkerThread::doRun()
 
 									if(!world_state->isInReadOnlyMode())
 									{
-										ob->flags = flags; // Copy flags
+										// Copy flags, apart from GPU_MESH_PRESENT_FLAG, which is only set by the server.
+										const bool gpu_mesh_present = BitUtils::isBitSet(ob->flags, WorldObject::GPU_MESH_PRESENT_FLAG);
+										ob->flags = flags;
+										BitUtils::setOrZeroBit(ob->flags, WorldObject::GPU_MESH_PRESENT_FLAG, gpu_mesh_present);
 										ob->last_modified_time = TimeStamp::currentTime();
 
 										ob->from_remote_flags_dirty = true;
@@ -1923,6 +1964,10 @@ void WorkerThread::doRun()
 									new_ob->created_time = TimeStamp::currentTime();
 									new_ob->last_modified_time = new_ob->created_time;
 									new_ob->creator_name = client_user_name;
+									BitUtils::zeroBit(new_ob->flags, WorldObject::GPU_MESH_PRESENT_FLAG); // Only set by MeshLODGenThread.
+									for(size_t z=0; z<new_ob->materials.size(); ++z)
+										if(new_ob->materials[z].nonNull())
+											new_ob->materials[z]->updateBasisTexturesPresentFlag(/*old_mat=*/NULL); // Clears the flag, it is only set by MeshLODGenThread.
 
 									std::set<DependencyURL> URLs;
 									WorldObject::GetDependencyOptions options;
@@ -1945,6 +1990,14 @@ void WorkerThread::doRun()
 
 										world_state->markAsChanged();
 									}
+
+									if(!new_ob->model_url.empty())
+									{
+										// Send a message to MeshLODGenThread to generate LOD and GPU meshes for the model (if not already generated)
+										CheckGenResourcesForObject* msg = new CheckGenResourcesForObject();
+										msg->ob_uid = new_ob->uid;
+										server->enqueueMsgForLodGenThread(msg);
+									}
 								}
 								else // else if user doesn't have permissions to create objects:
 								{
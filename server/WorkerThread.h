@@ -68,4 +68,7 @@ private:
 	bool write_trace; // Should we write a record of network traffic to disk for fuzz seeding?
 
 	glare::AtomicInt should_quit;
+
+	glare::AtomicInt updates_connection_protocol_version; // Protocol version of the client if this is an updates connection, 0 otherwise.  Read by the main server thread.
+	uint32 sent_min_client_protocol_version; // Last value sent to the client in a MinClientProtocolVersion message.  Only accessed by the main server thread.
 };
@@ -0,0 +1,723 @@
+/*=====================================================================
+GPUMesh.cpp
+-----------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#include "GPUMesh.h"
+
+
+#include "../maths/vec3.h"
+#include "../maths/Vec4f.h"
+#include "../utils/FileUtils.h"
+#include "../utils/Exception.h"
+#include "../utils/StringUtils.h"
+#include "../utils/IncludeHalf.h"
+#include "../utils/RuntimeCheck.h"
+#include "meshoptimizer/src/meshoptimizer.h"
+#include <limits>
+#include <cstring>
+#include <cmath>
+
+
+static const float MAX_POS_ERROR_FRACTION = 0.0005f; // Max allowed half-precision position error, as a fraction of the AABB diagonal length.
+static const float MAX_HALF_POS_MAGNITUDE = 60000.f; // A bit below the max half value.
+static const float MAX_HALF_UV_MAGNITUDE = 4.f; // UVs larger than this in magnitude are stored as float.  Half precision at 4 is 1/1024.
+static const float OVERDRAW_THRESHOLD = 1.05f; // Allow the vertex cache hit ratio to get 5% worse when optimising for overdraw.
+static const uint32 MAX_NUM_VERTS = 1 << 28;
+static const uint32 MAX_NUM_INDICES = 1 << 30;
+static const uint32 MAX_NUM_BATCHES = 1 << 16;
+
+
+GPUMesh::VertLayout GPUMesh::computeVertLayout(uint32 flags)
+{
+	VertLayout layout;
+	uint32 offset = 0;
+
+	layout.pos_offset_B = 0;
+	offset += (flags & FLOAT_POSITIONS_FLAG) ? sizeof(float) * 3 : sizeof(half) * 4; // Half positions are padded to 8 bytes to keep 4-byte alignment.
+
+	layout.normal_offset_B = -1;
+	if(flags & HAS_NORMALS_FLAG)
+	{
+		layout.normal_offset_B = (int)offset;
+		offset += sizeof(uint32);
+	}
+
+	const uint32 uv_size = (flags & FLOAT_UVS_FLAG) ? sizeof(float) * 2 : sizeof(half) * 2;
+
+	layout.uv0_offset_B = -1;
+	if(flags & HAS_UV0_FLAG)
+	{
+		layout.uv0_offset_B = (int)offset;
+		offset += uv_size;
+	}
+
+	layout.uv1_offset_B = -1;
+	if(flags & HAS_UV1_FLAG)
+	{
+		layout.uv1_offset_B = (int)offset;
+		offset += uv_size;
+	}
+
+	layout.vert_stride_B = offset;
+	return layout;
+}
+
+
+bool GPUMesh::canBuildForBatchedMesh(const BatchedMesh& mesh)
+{
+	const BatchedMesh::VertAttribute* pos_attr = mesh.findAttribute(BatchedMesh::VertAttribute_Position);
+	if(!pos_attr || pos_attr->component_type != BatchedMesh::ComponentType_Float)
+		return false;
+
+	// Skinned and animated meshes need the animation data, which we don't store.
+	if(mesh.findAttribute(BatchedMesh::VertAttribute_Joints) || mesh.findAttribute(BatchedMesh::VertAttribute_Weights) || !mesh.animation_data.animations.empty())
+		return false;
+
+	if(mesh.findAttribute(BatchedMesh::VertAttribute_Colour))
+		return false;
+
+	const BatchedMesh::VertAttribute* normal_attr = mesh.findAttribute(BatchedMesh::VertAttribute_Normal);
+	if(normal_attr && !(normal_attr->component_type == BatchedMesh::ComponentType_PackedNormal || normal_attr->component_type == BatchedMesh::ComponentType_Float))
+		return false;
+
+	const BatchedMesh::VertAttribute* uv0_attr = mesh.findAttribute(BatchedMesh::VertAttribute_UV_0);
+	if(uv0_attr && !(uv0_attr->component_type == BatchedMesh::ComponentType_Float || uv0_attr->component_type == BatchedMesh::ComponentType_Half))
+		return false;
+
+	const BatchedMesh::VertAttribute* uv1_attr = mesh.findAttribute(BatchedMesh::VertAttribute_UV_1);
+	if(uv1_attr && !(uv1_attr->component_type == BatchedMesh::ComponentType_Float || uv1_attr->component_type == BatchedMesh::ComponentType_Half))
+		return false;
+
+	return mesh.numVerts() > 0 && mesh.numVerts() <= MAX_NUM_VERTS && mesh.numIndices() > 0 && mesh.numIndices() <= MAX_NUM_INDICES && !mesh.batches.empty() && mesh.batches.size() <= MAX_NUM_BATCHES;
+}
+
+
+static Vec2f readUV(const BatchedMesh& mesh, const BatchedMesh::VertAttribute& attr, size_t vert_i)
+{
+	const size_t offset = mesh.vertexSize() * vert_i + attr.offset_B;
+	if(attr.component_type == BatchedMesh::ComponentType_Float)
+	{
+		runtimeCheck(offset + sizeof(float) * 2 <= mesh.vertex_data.size());
+		Vec2f uv;
+		std::memcpy(&uv, &mesh.vertex_data[offset], sizeof(float) * 2);
+		return uv;
+	}
+	else
+	{
+		runtimeCheck(offset + sizeof(half) * 2 <= mesh.vertex_data.size());
+		half uv[2];
+		std::memcpy(uv, &mesh.vertex_data[offset], sizeof(half) * 2);
+		return Vec2f(uv[0], uv[1]);
+	}
+}
+
+
+static void appendData(js::Vector<uint8, 16>& data, const void* src, size_t size)
+{
+	const size_t write_i = data.size();
+	data.resize(write_i + size);
+	if(size > 0)
+		std::memcpy(&data[write_i], src, size);
+}
+
+
+static void padToAlignment(js::Vector<uint8, 16>& data, size_t alignment)
+{
+	while(data.size() % alignment != 0)
+		data.push_back(0);
+}
+
+
+void GPUMesh::buildForBatchedMesh(const BatchedMesh& mesh, js::Vector<uint8, 16>& data_out)
+{
+	if(!canBuildForBatchedMesh(mesh))
+		throw glare::Exception("GPUMesh: mesh type not supported.");
+
+	const size_t src_num_verts = mesh.numVerts();
+	const size_t src_vert_stride_B = mesh.vertexSize();
+	const size_t num_indices = mesh.numIndices();
+
+	if(num_indices % 3 != 0)
+		throw glare::Exception("GPUMesh: num indices must be a multiple of 3.");
+
+	//------------------------------------------ Read indices ------------------------------------------
+	std::vector<uint32> indices(num_indices);
+	if(mesh.index_type == BatchedMesh::ComponentType_UInt8)
+	{
+		runtimeCheck(mesh.index_data.size() >= num_indices * sizeof(uint8));
+		for(size_t i=0; i<num_indices; ++i)
+			indices[i] = ((const uint8*)mesh.index_data.data())[i];
+	}
+	else if(mesh.index_type == BatchedMesh::ComponentType_UInt16)
+	{
+		runtimeCheck(mesh.index_data.size() >= num_indices * sizeof(uint16));
+		for(size_t i=0; i<num_indices; ++i)
+			indices[i] = ((const uint16*)mesh.index_data.data())[i];
+	}
+	else if(mesh.index_type == BatchedMesh::ComponentType_UInt32)
+	{
+		runtimeCheck(mesh.index_data.size() >= num_indices * sizeof(uint32));
+		std::memcpy(indices.data(), mesh.index_data.data(), num_indices * sizeof(uint32));
+	}
+	else
+		throw glare::Exception("GPUMesh: unhandled index_type");
+
+	for(size_t i=0; i<num_indices; ++i)
+		if(indices[i] >= src_num_verts)
+			throw glare::Exception("GPUMesh: vertex index out of bounds");
+
+	//------------------------------------------ Read positions ------------------------------------------
+	const BatchedMesh::VertAttribute& pos_attr = mesh.getAttribute(BatchedMesh::VertAttribute_Position);
+	std::vector<Vec3f> positions(src_num_verts);
+	for(size_t i=0; i<src_num_verts; ++i)
+	{
+		runtimeCheck(src_vert_stride_B * i + pos_attr.offset_B + sizeof(Vec3f) <= mesh.vertex_data.size());
+		std::memcpy(&positions[i], &mesh.vertex_data[src_vert_stride_B * i + pos_attr.offset_B], sizeof(Vec3f));
+		if(!positions[i].isFinite())
+			throw glare::Exception("GPUMesh: non-finite vertex position");
+	}
+
+	//------------------------------------------ Optimise indices for the vertex cache and overdraw, per batch ------------------------------------------
+	std::vector<GPUMesh::Batch> batches(mesh.batches.size());
+	std::vector<uint32> temp_indices;
+	for(size_t b=0; b<mesh.batches.size(); ++b)
+	{
+		const BatchedMesh::IndicesBatch& src_batch = mesh.batches[b];
+		if((uint64)src_batch.indices_start + (uint64)src_batch.num_indices > num_indices || src_batch.num_indices % 3 != 0)
+			throw glare::Exception("GPUMesh: invalid batch");
+
+		batches[b].material_index = src_batch.material_index;
+		batches[b].indices_start = src_batch.indices_start;
+		batches[b].num_indices = src_batch.num_indices;
+
+		if(src_batch.num_indices > 0)
+		{
+			uint32* const batch_indices = &indices[src_batch.indices_start];
+			temp_indices.resize(src_batch.num_indices);
+
+			meshopt_optimizeVertexCache(temp_indices.data(), batch_indices, src_batch.num_indices, src_num_verts);
+			meshopt_optimizeOverdraw(batch_indices, temp_indices.data(), src_batch.num_indices, &positions[0].x, src_num_verts, sizeof(Vec3f), OVERDRAW_THRESHOLD);
+		}
+	}
+
+	//------------------------------------------ Reorder vertices for vertex fetch locality, removing unreferenced vertices ------------------------------------------
+	std::vector<uint32> remap(src_num_verts);
+	const size_t num_verts = meshopt_optimizeVertexFetchRemap(remap.data(), indices.data(), num_indices, src_num_verts);
+	for(size_t i=0; i<num_indices; ++i)
+		indices[i] = remap[indices[i]];
+
+	//------------------------------------------ Work out vertex format ------------------------------------------
+	js::AABBox src_aabb = js::AABBox::emptyAABBox();
+	for(size_t i=0; i<src_num_verts; ++i)
+		if(remap[i] != std::numeric_limits<uint32>::max())
+			src_aabb.enlargeToHoldPoint(positions[i].toVec4fPoint());
+
+	float max_pos_magnitude = 0;
+	for(int i=0; i<3; ++i)
+		max_pos_magnitude = myMax(max_pos_magnitude, myMax(std::fabs(src_aabb.min_[i]), std::fabs(src_aabb.max_[i])));
+	const float diagonal_len = Vec3f(src_aabb.max_[0] - src_aabb.min_[0], src_aabb.max_[1] - src_aabb.min_[1], src_aabb.max_[2] - src_aabb.min_[2]).length();
+	const float half_pos_error = max_pos_magnitude * (1.f / 2048); // Half has 10 explicit mantissa bits, so max rounding error is 2^-11 relative.
+	const bool use_half_positions = (max_pos_magnitude < MAX_HALF_POS_MAGNITUDE) && (half_pos_error <= diagonal_len * MAX_POS_ERROR_FRACTION);
+
+	const BatchedMesh::VertAttribute* normal_attr = mesh.findAttribute(BatchedMesh::VertAttribute_Normal);
+	const BatchedMesh::VertAttribute* uv0_attr = mesh.findAttribute(BatchedMesh::VertAttribute_UV_0);
+	const BatchedMesh::VertAttribute* uv1_attr = mesh.findAttribute(BatchedMesh::VertAttribute_UV_1);
+
+	bool use_half_uvs = true;
+	for(int z=0; z<2; ++z)
+	{
+		const BatchedMesh::VertAttribute* uv_attr = (z == 0) ? uv0_attr : uv1_attr;
+		if(uv_attr && uv_attr->component_type == BatchedMesh::ComponentType_Float)
+		{
+			for(size_t i=0; i<src_num_verts; ++i)
+			{
+				const Vec2f uv = readUV(mesh, *uv_attr, i);
+				if(!(std::fabs(uv.x) <= MAX_HALF_UV_MAGNITUDE && std::fabs(uv.y) <= MAX_HALF_UV_MAGNITUDE)) // Written so NaNs also result in float UVs.
+				{
+					use_half_uvs = false;
+					break;
+				}
+			}
+		}
+	}
+
+	uint32 flags = 0;
+	if(normal_attr)			flags |= HAS_NORMALS_FLAG;
+	if(uv0_attr)			flags |= HAS_UV0_FLAG;
+	if(uv1_attr)			flags |= HAS_UV1_FLAG;
+	if(!use_half_positions)	flags |= FLOAT_POSITIONS_FLAG;
+	if(!use_half_uvs)		flags |= FLOAT_UVS_FLAG;
+
+	const VertLayout layout = computeVertLayout(flags);
+
+	//------------------------------------------ Build vertex data ------------------------------------------
+	js::Vector<uint8, 16> vert_data(num_verts * layout.vert_stride_B);
+	std::memset(vert_data.data(), 0, vert_data.size());
+	js::AABBox aabb_os = js::AABBox::emptyAABBox(); // Bounds of the stored (possibly quantised) positions.
+
+	for(size_t src_i=0; src_i<src_num_verts; ++src_i)
+	{
+		const uint32 new_i = remap[src_i];
+		if(new_i == std::numeric_limits<uint32>::max()) // If vertex was not referenced:
+			continue;
+
+		uint8* const dest = &vert_data[new_i * layout.vert_stride_B];
+		const Vec3f& pos = positions[src_i];
+
+		if(use_half_positions)
+		{
+			const half half_pos[4] = { half(pos.x), half(pos.y), half(pos.z), half(0.f) };
+			std::memcpy(dest + layout.pos_offset_B, half_pos, sizeof(half) * 4);
+			aabb_os.enlargeToHoldPoint(Vec4f(half_pos[0], half_pos[1], half_pos[2], 1.f));
+		}
+		else
+		{
+			std::memcpy(dest + layout.pos_offset_B, &pos, sizeof(Vec3f));
+			aabb_os.enlargeToHoldPoint(pos.toVec4fPoint());
+		}
+
+		if(normal_attr)
+		{
+			const size_t src_offset = src_vert_stride_B * src_i + normal_attr->offset_B;
+			uint32 packed_normal;
+			if(normal_attr->component_type == BatchedMesh::ComponentType_PackedNormal)
+			{
+				runtimeCheck(src_offset + sizeof(uint32) <= mesh.vertex_data.size());
+				std::memcpy(&packed_normal, &mesh.vertex_data[src_offset], sizeof(uint32));
+			}
+			else
+			{
+				runtimeCheck(src_offset + sizeof(Vec3f) <= mesh.vertex_data.size());
+				Vec3f n;
+				std::memcpy(&n, &mesh.vertex_data[src_offset], sizeof(Vec3f));
+				const float len = n.length();
+				packed_normal = batchedMeshPackNormal((isFinite(len) && len > 1.0e-20f) ? Vec4f(n.x / len, n.y / len, n.z / len, 0) : Vec4f(0, 0, 1, 0));
+			}
+			std::memcpy(dest + layout.normal_offset_B, &packed_normal, sizeof(uint32));
+		}
+
+		for(int z=0; z<2; ++z)
+		{
+			const BatchedMesh::VertAttribute* uv_attr = (z == 0) ? uv0_attr : uv1_attr;
+			const int dest_offset = (z == 0) ? layout.uv0_offset_B : layout.uv1_offset_B;
+			if(uv_attr)
+			{
+				const Vec2f uv = readUV(mesh, *uv_attr, src_i);
+				if(use_half_uvs)
+				{
+					const half half_uv[2] = { half(uv.x), half(uv.y) };
+					std::memcpy(dest + dest_offset, half_uv, sizeof(half) * 2);
+				}
+				else
+					std::memcpy(dest + dest_offset, &uv, sizeof(Vec2f));
+			}
+		}
+	}
+
+	//------------------------------------------ Write file data ------------------------------------------
+	const uint32 index_size_B = (num_verts <= 256) ? 1 : ((num_verts <= 65536) ? 2 : 4);
+
+	GPUMeshHeader header;
+	header.magic_number = MAGIC_NUMBER;
+	header.format_version = FORMAT_VERSION;
+	header.flags = flags;
+	header.vert_stride_B = layout.vert_stride_B;
+	header.num_verts = (uint32)num_verts;
+	header.num_indices = (uint32)num_indices;
+	header.index_size_B = index_size_B;
+	header.num_batches = (uint32)batches.size();
+	header.num_materials_referenced = (uint32)mesh.numMaterialsReferenced();
+	for(int i=0; i<3; ++i)
+	{
+		header.aabb_min[i] = aabb_os.min_[i];
+		header.aabb_max[i] = aabb_os.max_[i];
+	}
+
+	data_out.clear();
+	appendData(data_out, &header, sizeof(GPUMeshHeader));
+	appendData(data_out, batches.data(), batches.size() * sizeof(GPUMesh::Batch));
+	padToAlignment(data_out, 16);
+	appendData(data_out, vert_data.data(), vert_data.size());
+	padToAlignment(data_out, 4);
+
+	if(index_size_B == 1)
+	{
+		for(size_t i=0; i<num_indices; ++i)
+			data_out.push_back((uint8)indices[i]);
+	}
+	else if(index_size_B == 2)
+	{
+		for(size_t i=0; i<num_indices; ++i)
+		{
+			const uint16 index = (uint16)indices[i];
+			appendData(data_out, &index, sizeof(uint16));
+		}
+	}
+	else
+		appendData(data_out, indices.data(), num_indices * sizeof(uint32));
+}
+
+
+void GPUMesh::writeGPUMeshFileForBatchedMesh(const BatchedMesh& mesh, const std::string& path)
+{
+	js::Vector<uint8, 16> data;
+	buildForBatchedMesh(mesh, data);
+
+	FileUtils::writeEntireFile(path, (const char*)data.data(), data.size());
+}
+
+
+static inline uint64 roundUpToMultiple(uint64 x, uint64 m)
+{
+	return ((x + m - 1) / m) * m;
+}
+
+
+void GPUMesh::parse(const uint8* data, size_t data_size, ParsedGPUMesh& mesh_out)
+{
+	GPUMeshHeader header;
+	if(data_size < sizeof(GPUMeshHeader))
+		throw glare::Exception("GPUMesh: file too small");
+	std::memcpy(&header, data, sizeof(GPUMeshHeader));
+
+	if(header.magic_number != MAGIC_NUMBER)
+		throw glare::Exception("GPUMesh: invalid magic number");
+	if(header.format_version > FORMAT_VERSION)
+		throw glare::Exception("GPUMesh: unsupported format version " + toString(header.format_version));
+
+	const uint32 valid_flags = HAS_NORMALS_FLAG | HAS_UV0_FLAG | HAS_UV1_FLAG | FLOAT_POSITIONS_FLAG | FLOAT_UVS_FLAG;
+	if((header.flags & ~valid_flags) != 0)
+		throw glare::Exception("GPUMesh: invalid flags");
+
+	mesh_out.flags = header.flags;
+	mesh_out.layout = computeVertLayout(header.flags);
+	if(header.vert_stride_B != mesh_out.layout.vert_stride_B)
+		throw glare::Exception("GPUMesh: invalid vertex stride");
+
+	if(header.num_verts > MAX_NUM_VERTS || header.num_indices > MAX_NUM_INDICES || header.num_batches > MAX_NUM_BATCHES)
+		throw glare::Exception("GPUMesh: too many verts, indices or batches");
+	if(header.num_indices % 3 != 0)
+		throw glare::Exception("GPUMesh: num indices must be a multiple of 3");
+	if(!(header.index_size_B == 1 || header.index_size_B == 2 || header.index_size_B == 4))
+		throw glare::Exception("GPUMesh: invalid index size");
+
+	mesh_out.num_verts = header.num_verts;
+	mesh_out.num_indices = header.num_indices;
+	mesh_out.index_size_B = header.index_size_B;
+	mesh_out.num_materials_referenced = header.num_materials_referenced;
+
+	const Vec4f aabb_min(header.aabb_min[0], header.aabb_min[1], header.aabb_min[2], 1.f);
+	const Vec4f aabb_max(header.aabb_max[0], header.aabb_max[1], header.aabb_max[2], 1.f);
+	if(!(aabb_min.isFinite() && aabb_max.isFinite() && aabb_min[0] <= aabb_max[0] && aabb_min[1] <= aabb_max[1] && aabb_min[2] <= aabb_max[2]))
+		throw glare::Exception("GPUMesh: invalid AABB");
+	mesh_out.aabb_os = js::AABBox(aabb_min, aabb_max);
+
+	// Compute and check section offsets.  Use uint64s so the computations can't overflow.
+	const uint64 batches_offset = sizeof(GPUMeshHeader);
+	const uint64 vert_data_offset = roundUpToMultiple(batches_offset + (uint64)header.num_batches * sizeof(GPUMesh::Batch), 16);
+	const uint64 index_data_offset = roundUpToMultiple(vert_data_offset + (uint64)header.num_verts * header.vert_stride_B, 4);
+	const uint64 end_offset = index_data_offset + (uint64)header.num_indices * header.index_size_B;
+	if(end_offset > data_size)
+		throw glare::Exception("GPUMesh: file truncated");
+
+	mesh_out.batches.resize(header.num_batches);
+	if(header.num_batches > 0)
+		std::memcpy(mesh_out.batches.data(), data + batches_offset, header.num_batches * sizeof(GPUMesh::Batch));
+
+	for(size_t i=0; i<mesh_out.batches.size(); ++i)
+		if((uint64)mesh_out.batches[i].indices_start + (uint64)mesh_out.batches[i].num_indices > header.num_indices)
+			throw glare::Exception("GPUMesh: invalid batch");
+
+	mesh_out.vert_data = data + vert_data_offset;
+	mesh_out.index_data = data + index_data_offset;
+
+	// Check all vertex indices are in bounds.  This is a read-only pass over the indices, so is fast.
+	uint32 max_index = 0;
+	if(header.index_size_B == 1)
+	{
+		for(uint32 i=0; i<header.num_indices; ++i)
+			max_index = myMax<uint32>(max_index, mesh_out.index_data[i]);
+	}
+	else if(header.index_size_B == 2)
+	{
+		for(uint32 i=0; i<header.num_indices; ++i)
+		{
+			uint16 index;
+			std::memcpy(&index, mesh_out.index_data + i * sizeof(uint16), sizeof(uint16));
+			max_index = myMax<uint32>(max_index, index);
+		}
+	}
+	else
+	{
+		for(uint32 i=0; i<header.num_indices; ++i)
+		{
+			uint32 index;
+			std::memcpy(&index, mesh_out.index_data + i * sizeof(uint32), sizeof(uint32));
+			max_index = myMax(max_index, index);
+		}
+	}
+	if(header.num_indices > 0 && max_index >= header.num_verts)
+		throw glare::Exception("GPUMesh: vertex index out of bounds");
+}
+
+
+BatchedMeshRef GPUMesh::makeBatchedMeshWithPositions(const ParsedGPUMesh& mesh)
+{
+	BatchedMeshRef batched_mesh = new BatchedMesh();
+	batched_mesh->vert_attributes.push_back(BatchedMesh::VertAttribute(BatchedMesh::VertAttribute_Position, BatchedMesh::ComponentType_Float, /*offset_B=*/0));
+
+	batched_mesh->vertex_data.resize(mesh.num_verts * sizeof(Vec3f));
+	for(size_t i=0; i<mesh.num_verts; ++i)
+	{
+		const uint8* src = mesh.vert_data + mesh.layout.vert_stride_B * i + mesh.layout.pos_offset_B;
+		Vec3f pos;
+		if(mesh.flags & FLOAT_POSITIONS_FLAG)
+			std::memcpy(&pos, src, sizeof(Vec3f));
+		else
+		{
+			half half_pos[3];
+			std::memcpy(half_pos, src, sizeof(half) * 3);
+			pos = Vec3f(half_pos[0], half_pos[1], half_pos[2]);
+		}
+		std::memcpy(&batched_mesh->vertex_data[i * sizeof(Vec3f)], &pos, sizeof(Vec3f));
+	}
+
+	js::Vector<uint32> indices(mesh.num_indices);
+	for(size_t i=0; i<mesh.num_indices; ++i)
+	{
+		if(mesh.index_size_B == 1)
+			indices[i] = mesh.index_data[i];
+		else if(mesh.index_size_B == 2)
+		{
+			uint16 index;
+			std::memcpy(&index, mesh.index_data + i * sizeof(uint16), sizeof(uint16));
+			indices[i] = index;
+		}
+		else
+			std::memcpy(&indices[i], mesh.index_data + i * sizeof(uint32), sizeof(uint32));
+	}
+	batched_mesh->setIndexDataFromIndices(indices, mesh.num_verts);
+
+	for(size_t i=0; i<mesh.batches.size(); ++i)
+	{
+		BatchedMesh::IndicesBatch batch;
+		batch.indices_start = mesh.batches[i].indices_start;
+		batch.material_index = mesh.batches[i].material_index;
+		batch.num_indices = mesh.batches[i].num_indices;
+		batched_mesh->batches.push_back(batch);
+	}
+
+	batched_mesh->aabb_os = mesh.aabb_os;
+	return batched_mesh;
+}
+
+
+#if BUILD_TESTS
+
+
+#include "../utils/TestUtils.h"
+#include "../utils/ConPrint.h"
+
+
+// Makes a grid mesh in the z=0 plane with float positions, float normals and float UVs, with two batches.
+// An extra unreferenced vertex is added at the end.
+static BatchedMeshRef makeTestGridMesh(int res, const Vec3f& offset, float uv_scale)
+{
+	BatchedMeshRef mesh = new BatchedMesh();
+	mesh->vert_attributes.push_back(BatchedMesh::VertAttribute(BatchedMesh::VertAttribute_Position, BatchedMesh::ComponentType_Float, /*offset_B=*/0));
+	mesh->vert_attributes.push_back(BatchedMesh::VertAttribute(BatchedMesh::VertAttribute_Normal, BatchedMesh::ComponentType_Float, /*offset_B=*/12));
+	mesh->vert_attributes.push_back(BatchedMesh::VertAttribute(BatchedMesh::VertAttribute_UV_0, BatchedMesh::ComponentType_Float, /*offset_B=*/24));
+	const size_t vert_size = 32;
+
+	const size_t num_verts = (size_t)(res * res) + 1;
+	mesh->vertex_data.resize(num_verts * vert_size);
+	for(int y=0; y<res; ++y)
+	for(int x=0; x<res; ++x)
+	{
+		const float data[8] = { offset.x + (float)x, offset.y + (float)y, offset.z, 0.f, 0.f, 2.f, uv_scale * x / (res - 1), uv_scale * y / (res - 1) };
+		std::memcpy(&mesh->vertex_data[(y * res + x) * vert_size], data, sizeof(data));
+	}
+	const float unused_vert[8] = { offset.x + 1000.f, offset.y, offset.z, 0, 0, 1, 0, 0 };
+	std::memcpy(&mesh->vertex_data[(num_verts - 1) * vert_size], unused_vert, sizeof(unused_vert));
+
+	js::Vector<uint32> indices;
+	for(int y=0; y<res-1; ++y)
+	for(int x=0; x<res-1; ++x)
+	{
+		const uint32 v0 = y * res + x;
+		const uint32 v1 = v0 + 1;
+		const uint32 v2 = v0 + res + 1;
+		const uint32 v3 = v0 + res;
+		indices.push_back(v0); indices.push_back(v1); indices.push_back(v2);
+		indices.push_back(v0); indices.push_back(v2); indices.push_back(v3);
+	}
+	mesh->setIndexDataFromIndices(indices, num_verts);
+
+	const uint32 num_tri_indices = (uint32)indices.size();
+	const uint32 split = (num_tri_indices / 6) * 3;
+	BatchedMesh::IndicesBatch batch_0;
+	batch_0.indices_start = 0;
+	batch_0.material_index = 0;
+	batch_0.num_indices = split;
+	mesh->batches.push_back(batch_0);
+
+	BatchedMesh::IndicesBatch batch_1;
+	batch_1.indices_start = split;
+	batch_1.material_index = 1;
+	batch_1.num_indices = num_tri_indices - split;
+	mesh->batches.push_back(batch_1);
+
+	mesh->aabb_os = js::AABBox(Vec4f(offset.x, offset.y, offset.z, 1), Vec4f(offset.x + 1000.f, offset.y + res - 1, offset.z, 1));
+	return mesh;
+}
+
+
+static float sumTriangleAreas(const BatchedMesh& mesh)
+{
+	js::Vector<uint32> indices(mesh.numIndices());
+	for(size_t i=0; i<mesh.numIndices(); ++i)
+	{
+		if(mesh.index_type == BatchedMesh::ComponentType_UInt8)
+			indices[i] = ((const uint8*)mesh.index_data.data())[i];
+		else if(mesh.index_type == BatchedMesh::ComponentType_UInt16)
+			indices[i] = ((const uint16*)mesh.index_data.data())[i];
+		else
+			indices[i] = ((const uint32*)mesh.index_data.data())[i];
+	}
+
+	const size_t pos_offset = mesh.getAttribute(BatchedMesh::VertAttribute_Position).offset_B;
+	const size_t stride = mesh.vertexSize();
+	float sum = 0;
+	for(size_t i=0; i+2<indices.size(); i+=3)
+	{
+		Vec3f v[3];
+		for(int z=0; z<3; ++z)
+			std::memcpy(&v[z], &mesh.vertex_data[indices[i + z] * stride + pos_offset], sizeof(Vec3f));
+		sum += crossProduct(v[1] - v[0], v[2] - v[0]).length() * 0.5f;
+	}
+	return sum;
+}
+
+
+void GPUMesh::test()
+{
+	conPrint("GPUMesh::test()");
+
+	//-------------------------------- Test vertex layouts --------------------------------
+	{
+		const VertLayout layout = computeVertLayout(HAS_NORMALS_FLAG | HAS_UV0_FLAG | HAS_UV1_FLAG);
+		testAssert(layout.pos_offset_B == 0 && layout.normal_offset_B == 8 && layout.uv0_offset_B == 12 && layout.uv1_offset_B == 16 && layout.vert_stride_B == 20);
+
+		const VertLayout float_layout = computeVertLayout(FLOAT_POSITIONS_FLAG | FLOAT_UVS_FLAG | HAS_UV0_FLAG);
+		testAssert(float_layout.normal_offset_B == -1 && float_layout.uv0_offset_B == 12 && float_layout.uv1_offset_B == -1 && float_layout.vert_stride_B == 20);
+
+		for(uint32 flags=0; flags<32; ++flags)
+			testAssert(computeVertLayout(flags).vert_stride_B % 4 == 0);
+	}
+
+	try
+	{
+		//-------------------------------- Test a mesh near the origin, should use half positions and UVs --------------------------------
+		{
+			const int res = 20;
+			BatchedMeshRef mesh = makeTestGridMesh(res, Vec3f(-10.f, -10.f, 0.f), /*uv scale=*/1.f);
+			testAssert(canBuildForBatchedMesh(*mesh));
+
+			js::Vector<uint8, 16> data;
+			buildForBatchedMesh(*mesh, data);
+
+			ParsedGPUMesh parsed;
+			parse(data.data(), data.size(), parsed);
+			testAssert(parsed.flags == (HAS_NORMALS_FLAG | HAS_UV0_FLAG));
+			testAssert(parsed.num_verts == (uint32)(res * res)); // Unreferenced vertex should have been removed.
+			testAssert(parsed.num_indices == mesh->numIndices());
+			testAssert(parsed.index_size_B == 2);
+			testAssert(parsed.batches.size() == 2);
+			testAssert(parsed.batches[0].material_index == 0 && parsed.batches[1].material_index == 1);
+			testAssert(parsed.batches[0].num_indices + parsed.batches[1].num_indices == parsed.num_indices);
+			testAssert(parsed.num_materials_referenced == 2);
+			testAssert(((uint64)parsed.vert_data - (uint64)data.data()) % 16 == 0);
+
+			// AABB should not include the unreferenced vertex.
+			testAssert(parsed.aabb_os.min_[0] == -10.f && parsed.aabb_os.min_[1] == -10.f && parsed.aabb_os.min_[2] == 0.f);
+			testAssert(parsed.aabb_os.max_[0] == -10.f + res - 1 && parsed.aabb_os.max_[1] == -10.f + res - 1 && parsed.aabb_os.max_[2] == 0.f);
+
+			// Check normal was normalised and packed.
+			uint32 packed_normal;
+			std::memcpy(&packed_normal, parsed.vert_data + parsed.layout.normal_offset_B, sizeof(uint32));
+			const Vec4f unpacked_normal = batchedMeshUnpackNormal(packed_normal);
+			testAssert(std::fabs(unpacked_normal[0]) < 0.01f && std::fabs(unpacked_normal[1]) < 0.01f && std::fabs(unpacked_normal[2] - 1.f) < 0.01f);
+
+			// Check geometry is the same
+			BatchedMeshRef pos_mesh = makeBatchedMeshWithPositions(parsed);
+			testAssert(pos_mesh->numVerts() == parsed.num_verts);
+			testAssert(std::fabs(sumTriangleAreas(*pos_mesh) - sumTriangleAreas(*mesh)) < 1.0e-3f);
+		}
+
+		//-------------------------------- Test a mesh far from the origin with large UVs, should use float positions and UVs --------------------------------
+		{
+			BatchedMeshRef mesh = makeTestGridMesh(/*res=*/4, Vec3f(10000.f, 0.f, 0.f), /*uv scale=*/100.f);
+
+			js::Vector<uint8, 16> data;
+			buildForBatchedMesh(*mesh, data);
+
+			ParsedGPUMesh parsed;
+			parse(data.data(), data.size(), parsed);
+			testAssert(parsed.flags == (HAS_NORMALS_FLAG | HAS_UV0_FLAG | FLOAT_POSITIONS_FLAG | FLOAT_UVS_FLAG));
+			testAssert(parsed.index_size_B == 1);
+			testAssert(parsed.aabb_os.min_[0] == 10000.f);
+
+			BatchedMeshRef pos_mesh = makeBatchedMeshWithPositions(parsed);
+			testAssert(sumTriangleAreas(*pos_mesh) == sumTriangleAreas(*mesh));
+
+			//-------------------------------- Test invalid data is rejected --------------------------------
+			// Truncated data
+			try
+			{
+				parse(data.data(), data.size() - 1, parsed);
+				failTest("Expected exception");
+			}
+			catch(glare::Exception&)
+			{}
+
+			// Out of bounds vertex index
+			try
+			{
+				js::Vector<uint8, 16> bad_data = data;
+				bad_data[bad_data.size() - 1] = 200;
+				parse(bad_data.data(), bad_data.size(), parsed);
+				failTest("Expected exception");
+			}
+			catch(glare::Exception&)
+			{}
+
+			// Invalid magic number
+			try
+			{
+				js::Vector<uint8, 16> bad_data = data;
+				bad_data[0] = 0;
+				parse(bad_data.data(), bad_data.size(), parsed);
+				failTest("Expected exception");
+			}
+			catch(glare::Exception&)
+			{}
+		}
+
+		//-------------------------------- Test unsupported meshes --------------------------------
+		{
+			BatchedMeshRef mesh = makeTestGridMesh(/*res=*/4, Vec3f(0.f), /*uv scale=*/1.f);
+			mesh->vert_attributes.push_back(BatchedMesh::VertAttribute(BatchedMesh::VertAttribute_Colour, BatchedMesh::ComponentType_Float, /*offset_B=*/20));
+			testAssert(!canBuildForBatchedMesh(*mesh));
+		}
+	}
+	catch(glare::Exception& e)
+	{
+		failTest(e.what());
+	}
+
+	conPrint("GPUMesh::test() done.");
+}
+
+
+#endif // BUILD_TESTS
@@ -0,0 +1,118 @@
+/*=====================================================================
+GPUMesh.h
+---------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#pragma once
+
+
+#include <graphics/BatchedMesh.h>
+#include <physics/jscol_aabbox.h>
+#include <utils/Vector.h>
+#include <utils/Platform.h>
+#include <string>
+#include <vector>
+
+
+/*=====================================================================
+GPUMesh
+-------
+A mesh file format (.gpumesh) where the vertex and index data is stored
+in the layout the OpenGL engine uses for rendering, so clients can map the file
+and upload the data without any decompression, sanitising or vertex format conversion.
+
+Built by MeshLODGenThread on the server from a BatchedMesh, for each model LOD level.
+The index buffer is vertex-cache and overdraw optimised, and vertices are reordered for vertex fetch locality.
+
+Vertex layout (each attribute is 4-byte aligned):
+	position:	half[3] + 2 bytes padding, or float[3] if half precision is not sufficient for the mesh
+	normal:		GL_INT_2_10_10_10_REV packed normal (if the source mesh has normals)
+	uv0:		half[2], or float[2] if the UVs are out of range for half precision (if the source mesh has uv0)
+	uv1:		half[2], or float[2] (lightmap UVs, if the source mesh has uv1)
+
+File format:
+	GPUMeshHeader
+	Batch[num_batches]
+	padding to 16 bytes, vertex data (num_verts * vert_stride_B bytes)
+	padding to 4 bytes, index data (num_indices * index_size_B bytes)
+
+Only static meshes without vertex colours are supported, see canBuildForBatchedMesh().
+=====================================================================*/
+class GPUMesh
+{
+public:
+	static const uint32 MAGIC_NUMBER = 0x4D555047; // "GPUM"
+	static const uint32 FORMAT_VERSION = 1;
+
+	static const uint32 HAS_NORMALS_FLAG	= 1;
+	static const uint32 HAS_UV0_FLAG		= 2;
+	static const uint32 HAS_UV1_FLAG		= 4;
+	static const uint32 FLOAT_POSITIONS_FLAG = 8; // Positions are stored as float instead of half.
+	static const uint32 FLOAT_UVS_FLAG		= 16; // UVs are stored as float instead of half.
+
+	struct GPUMeshHeader
+	{
+		uint32 magic_number;
+		uint32 format_version;
+		uint32 flags;
+		uint32 vert_stride_B;
+		uint32 num_verts;
+		uint32 num_indices;
+		uint32 index_size_B; // 1, 2 or 4
+		uint32 num_batches;
+		uint32 num_materials_referenced;
+		float aabb_min[3];
+		float aabb_max[3];
+	};
+
+	struct Batch
+	{
+		uint32 material_index;
+		uint32 indices_start;
+		uint32 num_indices;
+	};
+
+	// Offsets of the vertex attributes, computed from the flags.  Offsets are set to -1 for attributes that are not present.
+	struct VertLayout
+	{
+		int pos_offset_B;
+		int normal_offset_B;
+		int uv0_offset_B;
+		int uv1_offset_B;
+		uint32 vert_stride_B;
+	};
+	static VertLayout computeVertLayout(uint32 flags);
+
+	// Returns false for meshes that can't be represented, e.g. skinned or animated meshes, or meshes with vertex colours.
+	static bool canBuildForBatchedMesh(const BatchedMesh& mesh);
+
+	// Throws glare::Exception on failure.
+	static void buildForBatchedMesh(const BatchedMesh& mesh, js::Vector<uint8, 16>& data_out);
+
+	static void writeGPUMeshFileForBatchedMesh(const BatchedMesh& mesh, const std::string& path);
+
+
+	// Parsed file data.  vert_data and index_data point into the data passed to parse().
+	struct ParsedGPUMesh
+	{
+		uint32 flags;
+		VertLayout layout;
+		uint32 num_verts;
+		uint32 num_indices;
+		uint32 index_size_B;
+		uint32 num_materials_referenced;
+		js::AABBox aabb_os;
+		std::vector<Batch> batches;
+		const uint8* vert_data;
+		const uint8* index_data;
+	};
+
+	// Checks the header, batches and that all vertex indices are in range.  Doesn't copy the vertex or index data.
+	// Throws glare::Exception if the data is invalid.
+	static void parse(const uint8* data, size_t data_size, ParsedGPUMesh& mesh_out);
+
+	// Makes a BatchedMesh with just float positions, for building physics shapes.
+	static BatchedMeshRef makeBatchedMeshWithPositions(const ParsedGPUMesh& mesh);
+
+	static void test();
+};
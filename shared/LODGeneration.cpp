@@ -33,8 +33,8 @@ Copyright Glare Technologies Limited 2021 -
 #include <dll/include/IndigoException.h>
 #include <dll/IndigoStringUtils.h>
 #include <dll/IndigoStringUtils.h>
-#if !GUI_CLIENT
-//#include <encoder/basisu_comp.h>
+#if SERVER
+#include <encoder/basisu_comp.h>
 #endif
 
 namespace LODGeneration
@@ -238,11 +238,12 @@ void generateLODTexture(const std::string& base_tex_path, int lod_level, const s
 }
 
 
-#if 0
-void generateKTXTexture(const std::string& src_tex_path, int base_lod_level, int lod_level, const std::string& ktx_tex_path, glare::TaskManager& task_manager)
+// Generates a Basis Universal (.basis) texture for the given LOD level, from the source texture at src_tex_path.
+// For the base LOD level, the source texture is the original texture, otherwise it is the JPG/PNG LOD texture for lod_level.
+void generateBasisTexture(const std::string& src_tex_path, int base_lod_level, int lod_level, bool is_sRGB, const std::string& basis_tex_path, int num_encoder_threads)
 {
-#if GUI_CLIENT
-	throw glare::Exception("generateKTXTexture not supported.");
+#if !SERVER
+	throw glare::Exception("generateBasisTexture not supported.");
 #else
 
 	int new_max_w_h;
@@ -256,7 +257,7 @@ void generateKTXTexture(const std::string& src_tex_path, int base_lod_level, int
 	Reference<Map2D> map;
 	if(hasExtension(src_tex_path, "gif"))
 	{
-		throw glare::Exception("Not handling KTX encoding of GIFs yet");
+		throw glare::Exception("Not handling Basis encoding of GIFs yet");
 	}
 	else
 	{
@@ -293,24 +294,26 @@ void generateKTXTexture(const std::string& src_tex_path, int base_lod_level, int
 
 			const ImageMapUInt8* imagemap = map.downcastToPtr<ImageMapUInt8>();
 
-			Reference<Map2D> resized_map = imagemap->resizeMidQuality(new_w, new_h, &task_manager);
+			// Don't use a task manager for resizing, as this is called from multiple tasks in parallel.
+			Reference<Map2D> resized_map = imagemap->resizeMidQuality(new_w, new_h, /*task_manager=*/NULL);
 			runtimeCheck(resized_map.isType<ImageMapUInt8>());
 
-			writeBasisUniversalKTXFile(*resized_map.downcast<ImageMapUInt8>(), ktx_tex_path);
+			writeBasisUniversalFile(*resized_map.downcast<ImageMapUInt8>(), basis_tex_path, is_sRGB, num_encoder_threads);
 		}
 		else
 			throw glare::Exception("Unhandled image type: " + src_tex_path);
 	}
 #endif
 }
-#endif
 
 
-#if 0
-void writeBasisUniversalKTXFile(const ImageMapUInt8& imagemap, const std::string& path)
+// Writes a .basis file using ETC1S encoding, with mipmaps.
+// All textures, including non-sRGB textures such as normal maps and metallic-roughness maps, must use ETC1S, since the client transcoder
+// is built without UASTC support (BASISD_SUPPORT_UASTC=0).  Non-sRGB textures use linear error metrics and mipmap filtering instead.
+void writeBasisUniversalFile(const ImageMapUInt8& imagemap, const std::string& path, bool is_sRGB, int num_encoder_threads)
 {
-#if GUI_CLIENT
-	throw glare::Exception("writeBasisUniversalKTXFile not supported.");
+#if !SERVER
+	throw glare::Exception("writeBasisUniversalFile not supported.");
 #else
 
 	basisu::basisu_encoder_init(); // Can be called multiple times harmlessly.
@@ -322,14 +325,17 @@ void writeBasisUniversalKTXFile(const ImageMapUInt8& imagemap, const std::string
 	basisu::basis_compressor_params params;
 
 	params.m_source_images.push_back(img);
-	params.m_perceptual = true;
-	
+	params.m_perceptual = is_sRGB; // Use linear error metrics for non-colour data such as normal maps and metallic-roughness textures.
+	params.m_uastc = false; // The client transcoder can't decode UASTC.
+
+	params.m_status_output = false;
+
 	params.m_write_output_basis_files = true;
 	params.m_out_filename = path;
-	params.m_create_ktx2_file = true;
+	params.m_create_ktx2_file = false;
 
 	params.m_mip_gen = true; // Generate mipmaps for each source image
-	params.m_mip_srgb = true; // Convert image to linear before filtering, then back to sRGB
+	params.m_mip_srgb = is_sRGB; // Convert image to linear before filtering, then back to sRGB
 
 	params.m_quality_level = 255;
 
@@ -337,7 +343,7 @@ void writeBasisUniversalKTXFile(const ImageMapUInt8& imagemap, const std::string
 	//params.m_max_endpoint_clusters = 16128;
 	//params.m_max_selector_clusters = 16128;
 
-	basisu::job_pool jpool(PlatformUtils::getNumLogicalProcessors());
+	basisu::job_pool jpool(myMax(1, num_encoder_threads));
 	params.m_pJob_pool = &jpool;
 
 	basisu::basis_compressor basisCompressor;
@@ -352,10 +358,9 @@ void writeBasisUniversalKTXFile(const ImageMapUInt8& imagemap, const std::string
 	if(result != basisu::basis_compressor::cECSuccess)
 		throw glare::Exception("basisCompressor.process() failed.");
 
-	conPrint("Basisu compression and writing of KTX file took " + timer.elapsedStringNSigFigs(3));
+	conPrint("Basisu compression and writing of basis file took " + timer.elapsedStringNSigFigs(3));
 #endif
 }
-#endif
 
 
 // Look up from cache or recompute.
@@ -389,7 +394,7 @@ void generateLODTexturesForTexURL(const std::string& base_tex_URL, bool texture_
 
 	for(int lvl = start_lod_level; lvl <= 2; ++lvl)
 	{
-		const std::string lod_URL = mat->getLODTextureURLForLevel(base_tex_URL, lvl, texture_has_alpha);
+		const std::string lod_URL = mat->getImageLODTextureURLForLevel(base_tex_URL, lvl, texture_has_alpha);
 
 		if((lod_URL != base_tex_URL) && !resource_manager.isFileForURLPresent(lod_URL)) // If the LOD URL is actually different, and if the LOD'd texture has not already been created:
 		{
@@ -446,6 +451,36 @@ void generateLODTexturesForMaterialsIfNotPresent(std::vector<WorldMaterialRef>&
 #include "../utils/PlatformUtils.h"
 #include "../utils/Exception.h"
 #include "../utils/Timer.h"
+#include "../utils/MemMappedFile.h"
+#include "../maths/vec3.h"
+
+
+#if SERVER
+// Writes a Basis file for imagemap, and checks it can be decoded with the client transcoder configuration: ETC1S only, since the client is built with BASISD_SUPPORT_UASTC=0.
+static void testBasisFileDecodableByClient(const ImageMapUInt8& imagemap, bool is_sRGB, const std::string& basis_path)
+{
+	writeBasisUniversalFile(imagemap, basis_path, is_sRGB, /*num_encoder_threads=*/1);
+	testAssert(FileUtils::fileExists(basis_path));
+
+	{
+		MemMappedFile file(basis_path);
+		testAssert(file.fileSize() >= sizeof(basist::basis_file_header));
+		const basist::basis_file_header* header = (const basist::basis_file_header*)file.fileData();
+		testAssert((uint32)header->m_tex_format == (uint32)basist::basis_tex_format::cETC1S);
+	}
+
+	// Decode with and without ETC support, as the client does depending on the GPU.
+	for(int ETC_support=0; ETC_support<2; ++ETC_support)
+	{
+		ImageDecoding::ImageDecodingOptions options;
+		options.ETC_support = ETC_support != 0;
+		Reference<Map2D> decoded_map = ImageDecoding::decodeImage(".", basis_path, /*mem_allocator=*/NULL, options);
+		testAssert(decoded_map.nonNull());
+		testAssert(decoded_map->getMapWidth() == imagemap.getWidth());
+		testAssert(decoded_map->getMapHeight() == imagemap.getHeight());
+	}
+}
+#endif
 
 
 void LODGeneration::test()
@@ -512,6 +547,30 @@ void LODGeneration::test()
 		}
 
 
+#if SERVER // writeBasisUniversalFile is only supported on the server.
+		//------------------------------------------- Test Basis texture generation -------------------------------------------
+		{
+			ImageMapUInt8 colour_map(64, 64, 3);
+			ImageMapUInt8 normal_map(64, 64, 3);
+			for(int y=0; y<64; ++y)
+			for(int x=0; x<64; ++x)
+			{
+				colour_map.getPixel(x, y)[0] = (uint8)(x * 4);
+				colour_map.getPixel(x, y)[1] = (uint8)(y * 4);
+				colour_map.getPixel(x, y)[2] = 128;
+
+				// A bumpy tangent-space normal map
+				const Vec3f n = normalise(Vec3f(0.3f * std::sin(x * 0.4f), 0.3f * std::cos(y * 0.4f), 1.f));
+				for(int c=0; c<3; ++c)
+					normal_map.getPixel(x, y)[c] = (uint8)myClamp((int)((n[c] * 0.5f + 0.5f) * 255.f + 0.5f), 0, 255);
+			}
+
+			testBasisFileDecodableByClient(colour_map, /*is_sRGB=*/true,  PlatformUtils::getTempDirPath() + "/lodgen_colour.basis");
+			testBasisFileDecodableByClient(normal_map, /*is_sRGB=*/false, PlatformUtils::getTempDirPath() + "/lodgen_normal.basis");
+		}
+#endif
+
+
 #if 0 // !GUI_CLIENT  // generateKTXTexture is disabled in gui_client.
 		//------------------------------------------- Test KTX texture generation -------------------------------------------
 		// Test writing an 8 bit RGB KTX image.
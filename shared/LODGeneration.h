@@ -38,12 +38,14 @@ bool textureHasAlphaChannel(const std::string& tex_path, Map2DRef map);
 
 void generateLODTexture(const std::string& base_tex_path, int lod_level, const std::string& LOD_tex_path, glare::TaskManager& task_manager);
 
-//void generateKTXTexture(const std::string& src_tex_path, int base_lod_level, int lod_level, const std::string& ktx_tex_path, glare::TaskManager& task_manager);
+// Only supported on the server, where the Basis Universal encoder is compiled in.  Throws glare::Exception on failure.
+// Safe to call from multiple threads concurrently.  num_encoder_threads is the number of threads the Basis encoder uses for this texture.
+void generateBasisTexture(const std::string& src_tex_path, int base_lod_level, int lod_level, bool is_sRGB, const std::string& basis_tex_path, int num_encoder_threads);
 
 // Generate LOD and KTX textures for materials, if not already present on disk.
 void generateLODTexturesForMaterialsIfNotPresent(std::vector<WorldMaterialRef>& materials, ResourceManager& resource_manager, glare::TaskManager& task_manager);
 
-//void writeBasisUniversalKTXFile(const ImageMapUInt8& imagemap, const std::string& path);
+void writeBasisUniversalFile(const ImageMapUInt8& imagemap, const std::string& path, bool is_sRGB, int num_encoder_threads);
 
 void test();
 
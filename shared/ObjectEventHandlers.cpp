@@ -9,6 +9,10 @@ Copyright Glare Technologies Limited 2024 -
 #include <utils/ConPrint.h>
 
 
+const float ObjectEventHandlers::DEFAULT_PROXIMITY_RADIUS = 20.f;
+const float ObjectEventHandlers::MAX_PROXIMITY_RADIUS = 100.f;
+
+
  // Returns if added or not
 bool HandlerList::addHandler(const HandlerFunc& handler)
 {
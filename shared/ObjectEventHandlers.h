@@ -45,6 +45,8 @@ on the object that owns the ObjectEventHandlers instance.
 class ObjectEventHandlers : public ThreadSafeRefCounted
 {
 public:
+	ObjectEventHandlers() : proximity_radius(DEFAULT_PROXIMITY_RADIUS) {}
+
 	void executeOnUserUsedObjectHandlers(UID avatar_uid, UID ob_uid, WorldStateLock& world_state_lock);
 	void executeOnUserTouchedObjectHandlers(UID avatar_uid, UID ob_uid, WorldStateLock& world_state_lock);
 	void executeOnUserMovedNearToObjectHandlers(UID avatar_uid, UID ob_uid, WorldStateLock& world_state_lock);
@@ -62,4 +64,12 @@ public:
 	HandlerList onUserExitedParcel_handlers;
 	HandlerList onUserEnteredVehicle_handlers;
 	HandlerList onUserExitedVehicle_handlers;
+
+	bool hasProximityHandlers() const { return !onUserMovedNearToObject_handlers.handler_funcs.empty() || !onUserMovedAwayFromObject_handlers.handler_funcs.empty(); }
+
+	// Distance from the object AABB within which a user is considered near to the object, for onUserMovedNearToObject and onUserMovedAwayFromObject.  Set with setProximityRadius().
+	float proximity_radius;
+
+	static const float DEFAULT_PROXIMITY_RADIUS;
+	static const float MAX_PROXIMITY_RADIUS;
 };
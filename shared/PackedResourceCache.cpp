@@ -0,0 +1,1154 @@
+/*=====================================================================
+PackedResourceCache.cpp
+-----------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#include "PackedResourceCache.h"
+
+
+#include <MemMappedFile.h>
+#include <FileUtils.h>
+#include <BufferViewInStream.h>
+#include <BufferOutStream.h>
+#include <StringUtils.h>
+#include <ConPrint.h>
+#include <Exception.h>
+#include <Lock.h>
+#include <algorithm>
+#include <cstring>
+
+
+static const uint32 INDEX_MAGIC_NUMBER = 0x58444950; // "PIDX"
+static const uint32 INDEX_SERIALISATION_VERSION = 2; // Version 2: added extracted flag to entries, and list of packs pending deletion.
+static const size_t MAX_URL_SIZE = 10000;
+
+
+PackedResourceCache::PackMapping::PackMapping(const std::string& path)
+:	file(NULL)
+{
+	file = new MemMappedFile(path);
+}
+
+
+PackedResourceCache::PackMapping::PackMapping(const std::string& path, uint64 offset, uint64 size)
+:	file(NULL)
+{
+	std::ifstream stream(StringUtils::UTF8ToPlatformUnicodeEncoding(path).c_str(), std::ios::in | std::ios::binary);
+	if(!stream)
+		throw glare::Exception("Failed to open pack file '" + path + "' for reading.");
+
+	data_copy.resize(size);
+	stream.seekg((std::streamoff)offset);
+	stream.read((char*)data_copy.data(), (std::streamsize)size);
+	if(!stream)
+		throw glare::Exception("Failed to read from pack file '" + path + "'.");
+}
+
+
+PackedResourceCache::PackMapping::~PackMapping()
+{
+	delete file;
+}
+
+
+PackedResourceCache::PackedResourceCache(const std::string& cache_dir_)
+:	cache_dir(cache_dir_), current_pack_id(0), next_last_used(1), total_data_size(0), total_extracted_size(0), index_changed(false)
+{
+	FileUtils::createDirIfDoesNotExist(cache_dir);
+
+	loadIndex();
+
+	Lock lock(mutex);
+	startNewPack(); // Start a new pack each session, so we never append after a partially written record at the end of a pack.
+}
+
+
+PackedResourceCache::~PackedResourceCache()
+{
+	try
+	{
+		saveIndexIfChanged();
+	}
+	catch(glare::Exception& e)
+	{
+		conPrint("PackedResourceCache: failed to save index: " + e.what());
+	}
+
+	// Remove the current pack if nothing was written to it.
+	Lock lock(mutex);
+	auto res = packs.find(current_pack_id);
+	if((res != packs.end()) && (res->second.file_size == 0) && (res->second.num_writers == 0))
+	{
+		res->second.mapping = NULL;
+		try
+		{
+			FileUtils::deleteFile(res->second.path);
+		}
+		catch(glare::Exception&)
+		{}
+	}
+}
+
+
+const std::string PackedResourceCache::packPath(uint32 pack_id) const
+{
+	return cache_dir + "/pack_" + toString(pack_id) + ".pack";
+}
+
+
+struct PackRecord
+{
+	std::string URL;
+	uint64 data_offset;
+	uint64 data_size;
+};
+
+
+// Parses records in the pack file from start_offset onwards, appending committed records to records_out.
+// Returns the offset of the end of the last valid record.
+static uint64 scanPackRecords(const std::string& pack_path, uint64 start_offset, std::vector<PackRecord>& records_out)
+{
+	MemMappedFile file(pack_path);
+	const uint8* data = (const uint8*)file.fileData();
+	const uint64 file_size = file.fileSize();
+
+	uint64 offset = start_offset;
+	while(offset + 16 <= file_size)
+	{
+		uint32 magic, URL_len;
+		uint64 data_len;
+		std::memcpy(&magic, data + offset, 4);
+		std::memcpy(&URL_len, data + offset + 4, 4);
+		std::memcpy(&data_len, data + offset + 8, 8);
+
+		if((magic != PackedResourceCache::RECORD_MAGIC && magic != PackedResourceCache::RECORD_MAGIC_UNCOMMITTED) || (URL_len > MAX_URL_SIZE))
+			break;
+
+		const uint64 data_offset = offset + 16 + URL_len;
+		if((data_len > file_size) || (data_offset + data_len > file_size))
+			break;
+
+		if(magic == PackedResourceCache::RECORD_MAGIC)
+		{
+			PackRecord record;
+			record.URL = std::string((const char*)data + offset + 16, URL_len);
+			record.data_offset = data_offset;
+			record.data_size = data_len;
+			records_out.push_back(record);
+		}
+
+		offset = data_offset + data_len;
+	}
+	return offset;
+}
+
+
+void PackedResourceCache::loadIndex()
+{
+	Lock lock(mutex);
+
+	const std::string index_path = cache_dir + "/index.bin";
+
+	bool loaded_index = false;
+	if(FileUtils::fileExists(index_path))
+	{
+		try
+		{
+			MemMappedFile file(index_path);
+			BufferViewInStream stream(ArrayRef<uint8>((const uint8*)file.fileData(), file.fileSize()));
+
+			const uint32 magic = stream.readUInt32();
+			if(magic != INDEX_MAGIC_NUMBER)
+				throw glare::Exception("Invalid magic number " + toString(magic) + ", expected " + toString(INDEX_MAGIC_NUMBER) + ".");
+			const uint32 version = stream.readUInt32();
+			if(version > INDEX_SERIALISATION_VERSION)
+				throw glare::Exception("Unknown version " + toString(version) + ", expected " + toString(INDEX_SERIALISATION_VERSION) + ".");
+
+			const uint32 num_packs = stream.readUInt32();
+			for(uint32 i=0; i<num_packs; ++i)
+			{
+				const uint32 pack_id = stream.readUInt32();
+				Pack& pack = packs[pack_id];
+				pack.path = packPath(pack_id);
+				pack.file_size = stream.readUInt64();
+			}
+
+			const uint64 num_entries = stream.readUInt64();
+			for(uint64 i=0; i<num_entries; ++i)
+			{
+				const std::string URL = stream.readStringLengthFirst(MAX_URL_SIZE);
+				Entry entry;
+				entry.pack_id = stream.readUInt32();
+				entry.offset = stream.readUInt64();
+				entry.size = stream.readUInt64();
+				entry.last_used = stream.readUInt64();
+				entry.extracted = (version >= 2) ? (stream.readUInt32() != 0) : false;
+
+				auto pack_res = packs.find(entry.pack_id);
+				if((pack_res == packs.end()) || (entry.offset + entry.size > pack_res->second.file_size))
+					throw glare::Exception("Invalid entry for URL '" + URL + "'.");
+
+				entries[URL] = entry;
+				next_last_used = myMax(next_last_used, entry.last_used + 1);
+			}
+
+			if(version >= 2)
+			{
+				const uint32 num_pending_deletion = stream.readUInt32();
+				for(uint32 i=0; i<num_pending_deletion; ++i)
+					packs_pending_deletion.insert(stream.readUInt32());
+			}
+
+			loaded_index = true;
+		}
+		catch(glare::Exception& e)
+		{
+			conPrint("PackedResourceCache: failed to load index, rebuilding from pack files: " + e.what());
+			entries.clear();
+			packs.clear();
+			packs_pending_deletion.clear();
+		}
+	}
+
+	// Get the pack files actually in the cache dir
+	std::map<uint32, uint64> pack_file_sizes;
+	const std::vector<std::string> filenames = FileUtils::getFilesInDir(cache_dir);
+	for(size_t i=0; i<filenames.size(); ++i)
+	{
+		const std::string& filename = filenames[i];
+		if(::hasPrefix(filename, "pack_") && ::hasSuffix(filename, ".pack"))
+		{
+			try
+			{
+				const uint32 pack_id = (uint32)stringToUInt64(filename.substr(5, filename.size() - 10));
+				pack_file_sizes[pack_id] = FileUtils::getFileSize(cache_dir + "/" + filename);
+			}
+			catch(glare::Exception&)
+			{}
+		}
+	}
+
+	// Try again to delete packs that were compacted but couldn't be deleted, and make sure they aren't scanned and reloaded as live packs if they still can't be deleted.
+	for(auto it = packs_pending_deletion.begin(); it != packs_pending_deletion.end(); )
+	{
+		if(pack_file_sizes.count(*it) == 0)
+		{
+			it = packs_pending_deletion.erase(it);
+			index_changed = true;
+			continue;
+		}
+
+		pack_file_sizes.erase(*it);
+		try
+		{
+			FileUtils::deleteFile(packPath(*it));
+			it = packs_pending_deletion.erase(it);
+			index_changed = true;
+		}
+		catch(glare::Exception&)
+		{
+			++it;
+		}
+	}
+
+	// Remove packs in the index whose files are missing, and their entries.
+	for(auto it = packs.begin(); it != packs.end(); )
+	{
+		if(pack_file_sizes.count(it->first) == 0)
+			it = packs.erase(it);
+		else
+			++it;
+	}
+	for(auto it = entries.begin(); it != entries.end(); )
+	{
+		if(packs.count(it->second.pack_id) == 0)
+			it = entries.erase(it);
+		else
+			++it;
+	}
+
+	// Scan any records written after the index was saved, including in packs that are not in the index.
+	// Packs are scanned in pack id order, so later records for a URL replace earlier ones.
+	for(auto it = pack_file_sizes.begin(); it != pack_file_sizes.end(); ++it)
+	{
+		Pack& pack = packs[it->first];
+		pack.path = packPath(it->first);
+		if(it->second > pack.file_size)
+		{
+			try
+			{
+				std::vector<PackRecord> records;
+				pack.file_size = scanPackRecords(pack.path, pack.file_size, records);
+
+				for(size_t z=0; z<records.size(); ++z)
+				{
+					Entry entry;
+					entry.pack_id = it->first;
+					entry.offset = records[z].data_offset;
+					entry.size = records[z].data_size;
+					entry.last_used = next_last_used++;
+					entry.extracted = false;
+					entries[records[z].URL] = entry;
+				}
+			}
+			catch(glare::Exception& e)
+			{
+				conPrint("PackedResourceCache: failed to scan pack '" + pack.path + "': " + e.what());
+			}
+			index_changed = true;
+		}
+	}
+
+	if(!loaded_index)
+		index_changed = true;
+
+	total_data_size = 0;
+	for(auto it = entries.begin(); it != entries.end(); ++it)
+	{
+		packs[it->second.pack_id].live_bytes += it->second.size;
+		total_data_size += it->second.size;
+		if(it->second.extracted)
+			total_extracted_size += it->second.size;
+	}
+
+	current_pack_id = packs.empty() ? 0 : packs.rbegin()->first;
+}
+
+
+void PackedResourceCache::saveIndexIfChanged()
+{
+	BufferOutStream buf;
+	{
+		Lock lock(mutex);
+		if(!index_changed)
+			return;
+		index_changed = false;
+
+		buf.writeUInt32(INDEX_MAGIC_NUMBER);
+		buf.writeUInt32(INDEX_SERIALISATION_VERSION);
+
+		buf.writeUInt32((uint32)packs.size());
+		for(auto it = packs.begin(); it != packs.end(); ++it)
+		{
+			buf.writeUInt32(it->first);
+			buf.writeUInt64(it->second.file_size);
+		}
+
+		buf.writeUInt64(entries.size());
+		for(auto it = entries.begin(); it != entries.end(); ++it)
+		{
+			buf.writeStringLengthFirst(it->first);
+			buf.writeUInt32(it->second.pack_id);
+			buf.writeUInt64(it->second.offset);
+			buf.writeUInt64(it->second.size);
+			buf.writeUInt64(it->second.last_used);
+			buf.writeUInt32(it->second.extracted ? 1 : 0);
+		}
+
+		buf.writeUInt32((uint32)packs_pending_deletion.size());
+		for(auto it = packs_pending_deletion.begin(); it != packs_pending_deletion.end(); ++it)
+			buf.writeUInt32(*it);
+	}
+
+	// Write to a temp file then move over the old index, so we don't end up with a partially written index.
+	const std::string index_path = cache_dir + "/index.bin";
+	const std::string temp_path = index_path + "_temp";
+	try
+	{
+		FileUtils::writeEntireFile(temp_path, (const char*)buf.buf.data(), buf.buf.size());
+		FileUtils::moveFile(temp_path, index_path);
+	}
+	catch(glare::Exception&)
+	{
+		Lock lock(mutex);
+		index_changed = true; // Try again next time.
+		throw;
+	}
+}
+
+
+void PackedResourceCache::startNewPack()
+{
+	uint32 new_pack_id = packs.empty() ? 0 : (packs.rbegin()->first + 1);
+	if(!packs_pending_deletion.empty())
+		new_pack_id = myMax(new_pack_id, *packs_pending_deletion.rbegin() + 1); // Don't reuse the id of a pack file that is still on disk.
+
+	Pack& pack = packs[new_pack_id];
+	pack.path = packPath(new_pack_id);
+
+	// Create the empty pack file, so that Writers can open it for update.
+	FileUtils::writeEntireFile(pack.path, std::string());
+
+	current_pack_id = new_pack_id;
+	index_changed = true;
+}
+
+
+void PackedResourceCache::clearExtracted(Entry& entry)
+{
+	if(entry.extracted)
+	{
+		assert(total_extracted_size >= entry.size);
+		total_extracted_size -= entry.size;
+		entry.extracted = false;
+		index_changed = true;
+	}
+}
+
+
+void PackedResourceCache::removeEntry(std::unordered_map<std::string, Entry>::iterator it)
+{
+	clearExtracted(it->second);
+
+	Pack& pack = packs[it->second.pack_id];
+	assert(pack.live_bytes >= it->second.size);
+	pack.live_bytes -= it->second.size;
+	assert(total_data_size >= it->second.size);
+	total_data_size -= it->second.size;
+
+	entries.erase(it);
+	index_changed = true;
+}
+
+
+bool PackedResourceCache::contains(const std::string& URL) const
+{
+	Lock lock(mutex);
+	return entries.count(URL) != 0;
+}
+
+
+bool PackedResourceCache::getData(const std::string& URL, ReadRef& data_out)
+{
+	uint32 pack_id;
+	std::string pack_path;
+	uint64 offset, size;
+	{
+		Lock lock(mutex);
+
+		auto res = entries.find(URL);
+		if(res == entries.end())
+			return false;
+
+		Entry& entry = res->second;
+		entry.last_used = next_last_used++;
+		index_changed = true;
+
+		// If the entry is in the current pack, and the current pack is big enough, start a new current pack, so that this one can be sealed and mapped once any remaining writers have finished.
+		if((entry.pack_id == current_pack_id) && (packs[current_pack_id].file_size >= MIN_SEALED_PACK_SIZE))
+			startNewPack();
+
+		Pack& pack = packs[entry.pack_id];
+		if(isSealed(entry.pack_id, pack))
+		{
+			if(pack.mapping.isNull())
+				pack.mapping = new PackMapping(pack.path);
+
+			if(pack.mapping->file->fileSize() < entry.offset + entry.size)
+				throw glare::Exception("Pack file '" + pack.path + "' is too small for entry '" + URL + "'.");
+
+			data_out.mapping = pack.mapping;
+			data_out.data = ArrayRef<uint8>((const uint8*)pack.mapping->file->fileData() + entry.offset, entry.size);
+			return true;
+		}
+
+		pack.num_copy_readers++;
+		pack_id = entry.pack_id;
+		pack_path = pack.path;
+		offset = entry.offset;
+		size = entry.size;
+	}
+
+	// The pack is still being written to, so read a copy of the data instead of mapping the pack.
+	// The entry data has been committed, so won't be written to again.
+	Reference<PackMapping> copy;
+	try
+	{
+		copy = new PackMapping(pack_path, offset, size);
+	}
+	catch(glare::Exception&)
+	{
+		Lock lock(mutex);
+		packs[pack_id].num_copy_readers--;
+		throw;
+	}
+
+	{
+		Lock lock(mutex);
+		packs[pack_id].num_copy_readers--;
+	}
+
+	data_out.mapping = copy;
+	data_out.data = ArrayRef<uint8>(copy->data_copy.data(), copy->data_copy.size());
+	return true;
+}
+
+
+void PackedResourceCache::markAsUsed(const std::string& URL)
+{
+	Lock lock(mutex);
+
+	auto res = entries.find(URL);
+	if(res != entries.end())
+	{
+		res->second.last_used = next_last_used++;
+		index_changed = true;
+	}
+}
+
+
+void PackedResourceCache::setExtracted(const std::string& URL)
+{
+	Lock lock(mutex);
+
+	auto res = entries.find(URL);
+	if((res != entries.end()) && !res->second.extracted)
+	{
+		res->second.extracted = true;
+		total_extracted_size += res->second.size;
+		index_changed = true;
+	}
+}
+
+
+bool PackedResourceCache::isPinned(const std::string& URL) const
+{
+	Lock lock(mutex);
+	return pin_counts.count(URL) != 0;
+}
+
+
+void PackedResourceCache::pin(const std::string& URL)
+{
+	Lock lock(mutex);
+	pin_counts[URL]++;
+}
+
+
+void PackedResourceCache::unpin(const std::string& URL)
+{
+	Lock lock(mutex);
+
+	auto res = pin_counts.find(URL);
+	assert(res != pin_counts.end());
+	if(res != pin_counts.end())
+	{
+		res->second--;
+		if(res->second <= 0)
+			pin_counts.erase(res);
+	}
+}
+
+
+PackedResourceCache::Pin::Pin(const Reference<PackedResourceCache>& cache_, const std::string& URL_)
+:	cache(cache_), URL(URL_)
+{
+	cache->pin(URL);
+}
+
+
+PackedResourceCache::Pin::~Pin()
+{
+	cache->unpin(URL);
+}
+
+
+void PackedResourceCache::reserve(uint64 record_size, uint32& pack_id_out, uint64& record_offset_out)
+{
+	Lock lock(mutex);
+
+	if(packs[current_pack_id].file_size > 0 && (packs[current_pack_id].file_size + record_size > MAX_PACK_SIZE))
+		startNewPack();
+
+	Pack& pack = packs[current_pack_id];
+	pack_id_out = current_pack_id;
+	record_offset_out = pack.file_size;
+	pack.file_size += record_size;
+	pack.num_writers++;
+}
+
+
+void PackedResourceCache::writerFinished(const Writer& writer, bool committed)
+{
+	Lock lock(mutex);
+
+	Pack& pack = packs[writer.pack_id];
+	assert(pack.num_writers > 0);
+	pack.num_writers--;
+
+	if(!committed)
+		return;
+
+	auto res = entries.find(writer.URL);
+	uint64 last_used = next_last_used++;
+	bool extracted = false; // New data for a URL makes any extracted copy stale.
+	if(writer.is_compaction_copy)
+	{
+		// Only update the entry if it hasn't been replaced or removed while we were copying it.
+		if((res == entries.end()) || (res->second.pack_id != writer.src_pack_id) || (res->second.offset != writer.src_offset))
+			return;
+		last_used = res->second.last_used; // Copying doesn't count as a use.
+		extracted = res->second.extracted;
+	}
+
+	if(res != entries.end())
+		removeEntry(res);
+
+	Entry entry;
+	entry.pack_id = writer.pack_id;
+	entry.offset = writer.data_offset;
+	entry.size = writer.data_size;
+	entry.last_used = last_used;
+	entry.extracted = extracted;
+	entries[writer.URL] = entry;
+
+	pack.live_bytes += writer.data_size;
+	total_data_size += writer.data_size;
+	if(extracted)
+		total_extracted_size += writer.data_size;
+	index_changed = true;
+}
+
+
+PackedResourceCache::Writer::Writer(PackedResourceCache& cache_, const std::string& URL_, uint64 data_size_)
+:	cache(cache_), URL(URL_), is_compaction_copy(false), src_pack_id(0), src_offset(0), data_size(data_size_), num_written(0), committed(false)
+{
+	if(URL.size() > MAX_URL_SIZE)
+		throw glare::Exception("URL too long.");
+
+	const uint64 header_size = recordHeaderSize(URL.size());
+	cache.reserve(header_size + data_size, pack_id, record_offset);
+	data_offset = record_offset + header_size;
+
+	try
+	{
+		const std::string pack_path = cache.packPath(pack_id);
+		file.open(StringUtils::UTF8ToPlatformUnicodeEncoding(pack_path).c_str(), std::ios::in | std::ios::out | std::ios::binary);
+		if(!file)
+			throw glare::Exception("Failed to open pack file '" + pack_path + "' for writing.");
+
+		const uint32 magic = RECORD_MAGIC_UNCOMMITTED;
+		const uint32 URL_len = (uint32)URL.size();
+		file.seekp((std::streamoff)record_offset);
+		file.write((const char*)&magic, 4);
+		file.write((const char*)&URL_len, 4);
+		file.write((const char*)&data_size, 8);
+		file.write(URL.data(), URL.size());
+		if(!file)
+			throw glare::Exception("Failed to write record header to pack file '" + pack_path + "'.");
+	}
+	catch(glare::Exception&)
+	{
+		cache.writerFinished(*this, /*committed=*/false); // Destructor won't be called as we are throwing from the constructor.
+		throw;
+	}
+}
+
+
+PackedResourceCache::Writer::~Writer()
+{
+	if(!committed)
+		cache.writerFinished(*this, /*committed=*/false);
+}
+
+
+void PackedResourceCache::Writer::writeData(const void* data, size_t num_bytes)
+{
+	if(num_written + num_bytes > data_size)
+		throw glare::Exception("PackedResourceCache::Writer: wrote more than data_size bytes.");
+
+	file.write((const char*)data, num_bytes);
+	if(!file)
+		throw glare::Exception("PackedResourceCache::Writer: failed to write to pack file.");
+	num_written += num_bytes;
+}
+
+
+void PackedResourceCache::Writer::commit()
+{
+	assert(!committed);
+	if(num_written != data_size)
+		throw glare::Exception("PackedResourceCache::Writer: commit() called before all data was written.");
+
+	// Now that the data is written, mark the record as committed.
+	const uint32 magic = RECORD_MAGIC;
+	file.seekp((std::streamoff)record_offset);
+	file.write((const char*)&magic, 4);
+	file.close();
+	if(file.fail())
+		throw glare::Exception("PackedResourceCache::Writer: failed to commit record to pack file.");
+
+	committed = true;
+	cache.writerFinished(*this, /*committed=*/true);
+}
+
+
+void PackedResourceCache::insert(const std::string& URL, ArrayRef<uint8> data)
+{
+	Writer writer(*this, URL, data.size());
+	writer.writeData(data.data(), data.size());
+	writer.commit();
+}
+
+
+void PackedResourceCache::remove(const std::string& URL)
+{
+	Lock lock(mutex);
+
+	auto res = entries.find(URL);
+	if(res != entries.end())
+		removeEntry(res);
+}
+
+
+void PackedResourceCache::evictToBudget(uint64 budget_B, std::vector<std::string>& evicted_URLs_out, std::vector<std::string>& unextracted_URLs_out)
+{
+	Lock lock(mutex);
+
+	if(total_data_size + total_extracted_size <= budget_B)
+		return;
+
+	// Sort entries by last used counter.  For the least recently used entries, drop the extracted copy first, as it can be recreated from the pack,
+	// then remove the entry if we are still over budget.
+	std::vector<std::pair<uint64, std::string> > last_used_and_URL;
+	last_used_and_URL.reserve(entries.size());
+	for(auto it = entries.begin(); it != entries.end(); ++it)
+		last_used_and_URL.push_back(std::make_pair(it->second.last_used, it->first));
+
+	std::sort(last_used_and_URL.begin(), last_used_and_URL.end());
+
+	for(size_t i=0; (i<last_used_and_URL.size()) && (total_data_size + total_extracted_size > budget_B); ++i)
+	{
+		if(pin_counts.count(last_used_and_URL[i].second) != 0) // Don't drop the extracted copy or evict the entry if it is still in use.
+			continue;
+
+		auto res = entries.find(last_used_and_URL[i].second);
+		assert(res != entries.end());
+		const bool was_extracted = res->second.extracted;
+		clearExtracted(res->second);
+
+		if(total_data_size + total_extracted_size > budget_B)
+		{
+			removeEntry(res);
+			evicted_URLs_out.push_back(last_used_and_URL[i].second);
+		}
+		else if(was_extracted)
+			unextracted_URLs_out.push_back(last_used_and_URL[i].second);
+	}
+}
+
+
+bool PackedResourceCache::compactStep()
+{
+	uint32 src_pack_id;
+	Reference<PackMapping> src_mapping;
+	std::vector<std::pair<std::string, Entry> > live_entries;
+	{
+		Lock lock(mutex);
+
+		// Retry deleting pack files that we failed to delete previously.
+		for(auto it = packs_pending_deletion.begin(); it != packs_pending_deletion.end(); )
+		{
+			try
+			{
+				FileUtils::deleteFile(packPath(*it));
+				it = packs_pending_deletion.erase(it);
+				index_changed = true;
+			}
+			catch(glare::Exception&)
+			{
+				++it;
+			}
+		}
+
+		// Find a pack to compact: sealed, with no copy readers, and less than half full of live data.
+		auto pack_it = packs.end();
+		for(auto it = packs.begin(); it != packs.end(); ++it)
+			if(isSealed(it->first, it->second) && (it->second.num_copy_readers == 0) && (it->second.live_bytes * 2 < it->second.file_size))
+			{
+				pack_it = it;
+				break;
+			}
+
+		if(pack_it == packs.end())
+			return false;
+
+		src_pack_id = pack_it->first;
+
+		for(auto it = entries.begin(); it != entries.end(); ++it)
+			if(it->second.pack_id == src_pack_id)
+				live_entries.push_back(*it);
+
+		if(!live_entries.empty())
+		{
+			if(pack_it->second.mapping.isNull())
+				pack_it->second.mapping = new PackMapping(pack_it->second.path);
+			src_mapping = pack_it->second.mapping;
+		}
+	}
+
+	// Copy live entries into the current pack, without holding the mutex.
+	for(size_t i=0; i<live_entries.size(); ++i)
+	{
+		const Entry& entry = live_entries[i].second;
+
+		Writer writer(*this, live_entries[i].first, entry.size);
+		writer.is_compaction_copy = true;
+		writer.src_pack_id = src_pack_id;
+		writer.src_offset = entry.offset;
+		writer.writeData((const uint8*)src_mapping->file->fileData() + entry.offset, entry.size);
+		writer.commit();
+	}
+	src_mapping = NULL;
+
+	{
+		Lock lock(mutex);
+
+		auto pack_it = packs.find(src_pack_id);
+		if(pack_it == packs.end())
+			return true;
+
+		// Entries can't be added to a sealed pack, so there shouldn't be any live entries left in it.  If there are, don't delete the pack, as the entries
+		// still refer to it.  It will be compacted again on a later step.
+		if(pack_it->second.live_bytes != 0)
+		{
+			conPrint("PackedResourceCache: pack " + toString(src_pack_id) + " still has " + toString(pack_it->second.live_bytes) + " B of live data after compaction, not deleting it.");
+			return true;
+		}
+
+		const std::string path = pack_it->second.path;
+		packs.erase(pack_it); // Drops the cache's reference to the mapping.
+		index_changed = true;
+
+		try
+		{
+			FileUtils::deleteFile(path);
+		}
+		catch(glare::Exception&)
+		{
+			// The file may still be mapped by a ReadRef, which prevents deletion on Windows.  Try again later.
+			packs_pending_deletion.insert(src_pack_id);
+		}
+	}
+
+	return true;
+}
+
+
+uint64 PackedResourceCache::getTotalDataSizeB() const
+{
+	Lock lock(mutex);
+	return total_data_size;
+}
+
+
+uint64 PackedResourceCache::getTotalExtractedSizeB() const
+{
+	Lock lock(mutex);
+	return total_extracted_size;
+}
+
+
+uint64 PackedResourceCache::getTotalPackFileSizeB() const
+{
+	Lock lock(mutex);
+	uint64 sum = 0;
+	for(auto it = packs.begin(); it != packs.end(); ++it)
+		sum += it->second.file_size;
+	return sum;
+}
+
+
+size_t PackedResourceCache::getNumEntries() const
+{
+	Lock lock(mutex);
+	return entries.size();
+}
+
+
+std::string PackedResourceCache::getDiagnostics() const
+{
+	Lock lock(mutex);
+
+	uint64 total_file_size = 0;
+	for(auto it = packs.begin(); it != packs.end(); ++it)
+		total_file_size += it->second.file_size;
+
+	std::string s;
+	s += "num entries: " + toString(entries.size()) + "\n";
+	s += "live data: " + getNiceByteSize(total_data_size) + "\n";
+	s += "extracted data: " + getNiceByteSize(total_extracted_size) + "\n";
+	s += "num packs: " + toString(packs.size()) + " (" + getNiceByteSize(total_file_size) + ")\n";
+	s += "num packs pending deletion: " + toString(packs_pending_deletion.size()) + "\n";
+	return s;
+}
+
+
+#if BUILD_TESTS
+
+
+#include <TestUtils.h>
+#include <PlatformUtils.h>
+
+
+static void testDataMatches(PackedResourceCache& cache, const std::string& URL, const std::vector<uint8>& expected)
+{
+	PackedResourceCache::ReadRef ref;
+	testAssert(cache.getData(URL, ref));
+	testAssert(ref.data.size() == expected.size());
+	testAssert(std::memcmp(ref.data.data(), expected.data(), expected.size()) == 0);
+}
+
+
+static std::vector<uint8> makeTestData(size_t size, uint8 seed)
+{
+	std::vector<uint8> data(size);
+	for(size_t i=0; i<size; ++i)
+		data[i] = (uint8)(i * 7 + seed);
+	return data;
+}
+
+
+void PackedResourceCache::test()
+{
+	conPrint("PackedResourceCache::test()");
+
+	const std::string dir = PlatformUtils::getTempDirPath() + "/packed_resource_cache_test";
+	FileUtils::createDirIfDoesNotExist(dir);
+	{
+		const std::vector<std::string> filenames = FileUtils::getFilesInDir(dir);
+		for(size_t i=0; i<filenames.size(); ++i)
+			FileUtils::deleteFile(dir + "/" + filenames[i]);
+	}
+
+	const std::vector<uint8> a_data = makeTestData(1000, 1);
+	const std::vector<uint8> a2_data = makeTestData(2000, 2);
+	const std::vector<uint8> b_data = makeTestData(3000, 3);
+	const std::vector<uint8> c_data = makeTestData(4000, 4);
+
+	// Test basic insertion and reading
+	{
+		PackedResourceCache cache(dir);
+		testAssert(!cache.contains("a.bin"));
+
+		cache.insert("a.bin", ArrayRef<uint8>(a_data.data(), a_data.size()));
+		cache.insert("b.bin", ArrayRef<uint8>(b_data.data(), b_data.size()));
+		testAssert(cache.contains("a.bin") && cache.contains("b.bin"));
+		testDataMatches(cache, "a.bin", a_data);
+		testDataMatches(cache, "b.bin", b_data);
+
+		// Test replacing an entry
+		cache.insert("a.bin", ArrayRef<uint8>(a2_data.data(), a2_data.size()));
+		testDataMatches(cache, "a.bin", a2_data);
+		testAssert(cache.getTotalDataSizeB() == a2_data.size() + b_data.size());
+
+		// Test that an uncommitted writer doesn't add an entry
+		{
+			Writer writer(cache, "c.bin", c_data.size());
+			writer.writeData(c_data.data(), 100);
+		}
+		testAssert(!cache.contains("c.bin"));
+
+		// Test that commit fails if not all data was written
+		try
+		{
+			Writer writer(cache, "c.bin", c_data.size());
+			writer.writeData(c_data.data(), 100);
+			writer.commit();
+			failTest("Expected exception");
+		}
+		catch(glare::Exception&)
+		{}
+		testAssert(!cache.contains("c.bin"));
+	}
+
+	// Test index is saved and loaded
+	{
+		PackedResourceCache cache(dir);
+		testAssert(cache.getNumEntries() == 2);
+		testDataMatches(cache, "a.bin", a2_data);
+		testDataMatches(cache, "b.bin", b_data);
+
+		cache.insert("c.bin", ArrayRef<uint8>(c_data.data(), c_data.size()));
+	}
+
+	// Test recovery of entries by scanning pack files, when the index is missing.
+	FileUtils::deleteFile(dir + "/index.bin");
+	{
+		PackedResourceCache cache(dir);
+		testAssert(cache.getNumEntries() == 3);
+		testDataMatches(cache, "a.bin", a2_data); // Later record for a.bin should replace the earlier record.
+		testDataMatches(cache, "b.bin", b_data);
+		testDataMatches(cache, "c.bin", c_data);
+		testAssert(cache.getTotalDataSizeB() == a2_data.size() + b_data.size() + c_data.size());
+	}
+
+	// Test LRU eviction and compaction
+	{
+		PackedResourceCache cache(dir);
+
+		testDataMatches(cache, "b.bin", b_data);
+		testDataMatches(cache, "a.bin", a2_data); // a.bin is now the most recently used.
+
+		std::vector<std::string> evicted, unextracted;
+		cache.evictToBudget(/*budget=*/a2_data.size() + b_data.size(), evicted, unextracted);
+		testAssert(evicted.size() == 1 && evicted[0] == "c.bin");
+		testAssert(unextracted.empty());
+		testAssert(!cache.contains("c.bin"));
+
+		evicted.clear();
+		cache.evictToBudget(/*budget=*/a2_data.size(), evicted, unextracted);
+		testAssert(evicted.size() == 1 && evicted[0] == "b.bin");
+		testAssert(cache.contains("a.bin"));
+		testAssert(cache.getTotalDataSizeB() == a2_data.size());
+
+		const uint64 pack_size_before = cache.getTotalPackFileSizeB();
+		while(cache.compactStep())
+		{}
+		testAssert(cache.getTotalPackFileSizeB() < pack_size_before);
+		testDataMatches(cache, "a.bin", a2_data);
+	}
+
+	// Check compacted state was saved correctly
+	{
+		PackedResourceCache cache(dir);
+		testAssert(cache.getNumEntries() == 1);
+		testDataMatches(cache, "a.bin", a2_data);
+	}
+
+	// Test markAsUsed updates LRU order, and that extracted copies are counted against the budget and dropped before entries are evicted.
+	{
+		PackedResourceCache cache(dir);
+		cache.insert("b.bin", ArrayRef<uint8>(b_data.data(), b_data.size()));
+		cache.insert("c.bin", ArrayRef<uint8>(c_data.data(), c_data.size()));
+
+		cache.markAsUsed("a.bin"); // b.bin is now the least recently used.
+
+		std::vector<std::string> evicted, unextracted;
+		cache.evictToBudget(/*budget=*/a2_data.size() + c_data.size(), evicted, unextracted);
+		testAssert(evicted.size() == 1 && evicted[0] == "b.bin");
+		testAssert(cache.contains("a.bin") && cache.contains("c.bin"));
+
+		cache.setExtracted("c.bin");
+		cache.setExtracted("c.bin"); // Setting twice should only count once.
+		testAssert(cache.getTotalExtractedSizeB() == c_data.size());
+		cache.markAsUsed("a.bin"); // c.bin is now the least recently used.
+
+		// Over budget due to the extracted copy of c.bin: the extracted copy should be dropped, but the entry kept.
+		evicted.clear();
+		cache.evictToBudget(/*budget=*/a2_data.size() + c_data.size(), evicted, unextracted);
+		testAssert(evicted.empty());
+		testAssert(unextracted.size() == 1 && unextracted[0] == "c.bin");
+		testAssert(cache.contains("c.bin"));
+		testAssert(cache.getTotalExtractedSizeB() == 0);
+
+		// Test extracted flag is saved in the index, and kept over compaction.
+		cache.setExtracted("a.bin");
+		cache.remove("c.bin");
+		while(cache.compactStep())
+		{}
+		testAssert(cache.getTotalExtractedSizeB() == a2_data.size());
+	}
+	{
+		PackedResourceCache cache(dir);
+		testAssert(cache.getNumEntries() == 1);
+		testAssert(cache.getTotalExtractedSizeB() == a2_data.size());
+		testDataMatches(cache, "a.bin", a2_data);
+	}
+
+	// Test that packs pending deletion are saved in the index, and are deleted (not reloaded as live packs) when the cache is next opened.
+	{
+		const std::string pending_pack_path = dir + "/pack_1000.pack";
+		{
+			PackedResourceCache cache(dir);
+			cache.insert("d.bin", ArrayRef<uint8>(b_data.data(), b_data.size()));
+			cache.saveIndexIfChanged();
+
+			// Make a copy of a pack containing d.bin, and mark it as pending deletion, as if compaction had failed to delete it.
+			Lock lock(cache.mutex);
+			FileUtils::copyFile(cache.packs[cache.current_pack_id].path, pending_pack_path);
+			cache.packs_pending_deletion.insert(1000);
+			cache.removeEntry(cache.entries.find("d.bin"));
+		}
+		testAssert(FileUtils::fileExists(pending_pack_path));
+		{
+			PackedResourceCache cache(dir);
+			testAssert(!FileUtils::fileExists(pending_pack_path));
+			testAssert(!cache.contains("d.bin"));
+		}
+	}
+
+	// Test that pinned entries, and their extracted copies, are not evicted.
+	{
+		Reference<PackedResourceCache> cache = new PackedResourceCache(dir);
+		cache->insert("e.bin", ArrayRef<uint8>(b_data.data(), b_data.size()));
+		cache->setExtracted("e.bin");
+		cache->markAsUsed("a.bin"); // e.bin is now the least recently used.
+
+		std::vector<std::string> evicted, unextracted;
+		{
+			PinRef pin = new Pin(cache, "e.bin");
+			PinRef pin2 = new Pin(cache, "e.bin");
+			pin2 = NULL;
+			testAssert(cache->isPinned("e.bin"));
+
+			cache->evictToBudget(/*budget=*/0, evicted, unextracted);
+			testAssert(evicted.size() == 1 && evicted[0] == "a.bin");
+			testAssert(unextracted.empty());
+			testAssert(cache->contains("e.bin"));
+			testAssert(cache->getTotalExtractedSizeB() == b_data.size());
+		}
+		testAssert(!cache->isPinned("e.bin"));
+
+		evicted.clear();
+		cache->evictToBudget(/*budget=*/0, evicted, unextracted);
+		testAssert(evicted.size() == 1 && evicted[0] == "e.bin");
+		testAssert(cache->getNumEntries() == 0);
+	}
+
+	// Test that the current pack is only mapped once it is sealed.
+	{
+		PackedResourceCache cache(dir);
+		cache.insert("f.bin", ArrayRef<uint8>(c_data.data(), c_data.size()));
+
+		// The current pack is small, so data read from it should be a copy, and the pack shouldn't be mapped.
+		{
+			ReadRef ref;
+			testAssert(cache.getData("f.bin", ref));
+			testAssert(ref.mapping->file == NULL);
+			testDataMatches(cache, "f.bin", c_data);
+			Lock lock(cache.mutex);
+			testAssert(cache.packs[cache.entries["f.bin"].pack_id].mapping.isNull());
+		}
+
+		// Once the current pack is big enough, reading from it should start a new pack, and map the old one.
+		const std::vector<uint8> big_data = makeTestData(MIN_SEALED_PACK_SIZE, 6);
+		cache.insert("g.bin", ArrayRef<uint8>(big_data.data(), big_data.size()));
+		uint32 g_pack_id;
+		{
+			Lock lock(cache.mutex);
+			g_pack_id = cache.entries["g.bin"].pack_id;
+			testAssert(g_pack_id == cache.current_pack_id);
+		}
+		{
+			ReadRef ref;
+			testAssert(cache.getData("g.bin", ref));
+			testAssert(ref.mapping->file != NULL);
+			testAssert(ref.data.size() == big_data.size() && std::memcmp(ref.data.data(), big_data.data(), big_data.size()) == 0);
+			Lock lock(cache.mutex);
+			testAssert(cache.current_pack_id != g_pack_id);
+			testAssert(cache.packs[g_pack_id].mapping.nonNull());
+		}
+		testDataMatches(cache, "f.bin", c_data);
+
+		cache.remove("f.bin");
+		cache.remove("g.bin");
+		while(cache.compactStep())
+		{}
+	}
+
+	conPrint("PackedResourceCache::test() done.");
+}
+
+
+#endif // BUILD_TESTS
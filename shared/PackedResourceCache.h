@@ -0,0 +1,243 @@
+/*=====================================================================
+PackedResourceCache.h
+---------------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#pragma once
+
+
+#include <ThreadSafeRefCounted.h>
+#include <Reference.h>
+#include <ArrayRef.h>
+#include <Mutex.h>
+#include <Platform.h>
+#include <unordered_map>
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+#include <fstream>
+class MemMappedFile;
+
+
+/*=====================================================================
+PackedResourceCache
+-------------------
+Stores resource files in a small number of large, append-only pack files,
+instead of one file per resource.
+
+Pack file layout is a sequence of records:
+	uint32 magic (RECORD_MAGIC, or RECORD_MAGIC_UNCOMMITTED while the record is being written)
+	uint32 URL length
+	uint64 data length
+	URL bytes
+	data bytes
+
+The index (URL -> pack, offset, size, last-used counter, extracted flag) is kept in memory and saved to
+index.bin in the cache dir, along with the ids of packs that are waiting to be deleted.  index.bin is read with a memory mapping when the cache is opened.
+Records appended to packs after the index was last saved, or in packs missing from the index
+(e.g. if the client crashed) are recovered by scanning the packs.
+
+Resource data is returned as a ReadRef, which refers directly to a read-only memory mapping
+of the pack file, so no copies are made.  The mapping is kept alive by the ReadRef.
+Only sealed packs are mapped: packs that are not the current pack, and that have no Writers left, so a pack file is never
+written to while it is mapped.  Once the current pack is at least MIN_SEALED_PACK_SIZE, reading from it starts a new current pack,
+so it can be sealed.  Data in packs that are still being written to is read into a copy instead.
+
+Each entry has a last-used counter, updated when the entry is read or markAsUsed() is called.
+Resources that need to be loaded from a file are extracted to a loose file by the caller, which then calls
+setExtracted() so the extracted copy is counted against the budget as well.
+evictToBudget() drops extracted copies and removes entries from the index, in least-recently-used order,
+until the total size of the entries and extracted copies is within the budget.
+Entries that are pinned (there is a Pin for the URL), for example because a loaded resource still streams from the extracted file,
+are not evicted, and their extracted copies are not dropped.
+The space used by evicted entries is reclaimed by compactStep(), which copies the live entries out of
+a mostly-dead pack into the current pack and then deletes the old pack file.
+
+Threadsafe.
+=====================================================================*/
+class PackedResourceCache : public ThreadSafeRefCounted
+{
+public:
+	// Opens the cache in cache_dir, creating the dir if needed.
+	// Throws glare::Exception on failure.
+	PackedResourceCache(const std::string& cache_dir);
+	~PackedResourceCache();
+
+	static const uint32 RECORD_MAGIC = 0x4B434150; // "PACK"
+	static const uint32 RECORD_MAGIC_UNCOMMITTED = 0x50434B55;
+	static const uint64 MAX_PACK_SIZE = 256 * 1024 * 1024; // A new pack is started when the current pack reaches this size.
+	static const uint64 MIN_SEALED_PACK_SIZE = 16 * 1024 * 1024; // Reading from the current pack starts a new pack, so the current pack can be sealed and mapped, if it is at least this size.
+
+
+	// A read-only memory mapping of a sealed pack file, or for data in a pack that is still being written to, a copy of the data.
+	struct PackMapping : public ThreadSafeRefCounted
+	{
+		PackMapping(const std::string& path); // Maps the whole file.
+		PackMapping(const std::string& path, uint64 offset, uint64 size); // Reads a copy of size bytes at offset in the file.
+		~PackMapping();
+
+		MemMappedFile* file; // NULL if the data was copied.
+		std::vector<uint8> data_copy;
+	};
+
+	// Data for a resource, referring directly to the pack file mapping.
+	struct ReadRef
+	{
+		Reference<PackMapping> mapping; // Keeps the mapping alive while the data is in use.
+		ArrayRef<uint8> data;
+	};
+
+
+	bool contains(const std::string& URL) const;
+
+	// Returns true if the URL is in the cache, in which case data_out is set.  Marks the entry as most recently used.
+	// Throws glare::Exception if the pack file could not be mapped.
+	bool getData(const std::string& URL, ReadRef& data_out);
+
+	// Marks the entry for the URL, if present, as most recently used.
+	void markAsUsed(const std::string& URL);
+
+	// Records that the data for the URL has been extracted to a loose file, so that the extracted copy counts against the budget.
+	// Does nothing if the URL is not in the cache.
+	void setExtracted(const std::string& URL);
+
+
+	// Stops the entry for the URL, and any extracted copy of it, from being evicted while the Pin exists.
+	// The URL does not need to be in the cache when the pin is created.
+	class Pin : public ThreadSafeRefCounted
+	{
+	public:
+		Pin(const Reference<PackedResourceCache>& cache, const std::string& URL);
+		~Pin();
+
+	private:
+		Reference<PackedResourceCache> cache;
+		std::string URL;
+	};
+	typedef Reference<Pin> PinRef;
+
+	bool isPinned(const std::string& URL) const;
+
+
+	// Writes data for a single resource into the current pack.
+	// Space in the pack is reserved on construction, so multiple writers can write concurrently.
+	// The entry is only added to the index (and so visible to readers) when commit() is called.
+	// If the writer is destroyed without commit() being called, the reserved space is left as a dead (uncommitted) record.
+	class Writer
+	{
+	public:
+		// Throws glare::Exception on failure.
+		Writer(PackedResourceCache& cache, const std::string& URL, uint64 data_size);
+		~Writer();
+
+		// Throws glare::Exception on failure.
+		void writeData(const void* data, size_t num_bytes);
+
+		// Throws glare::Exception on failure, or if not all data_size bytes have been written.
+		void commit();
+
+	private:
+		friend class PackedResourceCache;
+		PackedResourceCache& cache;
+		std::string URL;
+		bool is_compaction_copy; // If true, only update the index entry if it still refers to the source data at (src_pack_id, src_offset).
+		uint32 src_pack_id;
+		uint64 src_offset;
+		uint32 pack_id;
+		uint64 record_offset;
+		uint64 data_offset;
+		uint64 data_size;
+		uint64 num_written;
+		std::fstream file;
+		bool committed;
+	};
+
+	// Convenience method, writes the data for the URL with a Writer.
+	void insert(const std::string& URL, ArrayRef<uint8> data);
+
+	// Removes the entry for the URL from the index, if present.  The space is reclaimed by compaction.
+	void remove(const std::string& URL);
+
+	// In least-recently-used order, drops extracted copies and removes entries, until the total size of the entries and extracted copies is <= budget_B.
+	// Pinned entries are skipped.
+	// Appends the URLs of evicted entries to evicted_URLs_out.
+	// Appends the URLs of entries that are still in the cache, but whose extracted copy was dropped, to unextracted_URLs_out.
+	// The caller is responsible for deleting the extracted files for both lists.
+	void evictToBudget(uint64 budget_B, std::vector<std::string>& evicted_URLs_out, std::vector<std::string>& unextracted_URLs_out);
+
+	// Compacts at most one pack: if some sealed pack is less than half full of live entries,
+	// copies the live entries into the current pack and deletes the old pack file.
+	// Also retries deleting pack files that couldn't be deleted earlier (e.g. because they were still mapped on Windows).
+	// Returns true if there may be more compaction work to do.
+	// Intended to be called periodically from a background thread.
+	bool compactStep();
+
+	// Saves the index to index.bin, if it has changed since it was last saved.
+	// Throws glare::Exception on failure.
+	void saveIndexIfChanged();
+
+	uint64 getTotalDataSizeB() const; // Sum of data sizes of all entries in the index.
+	uint64 getTotalExtractedSizeB() const; // Sum of data sizes of entries with extracted copies.
+	uint64 getTotalPackFileSizeB() const;
+	size_t getNumEntries() const;
+
+	std::string getDiagnostics() const;
+
+	static void test();
+
+private:
+	struct Entry
+	{
+		uint32 pack_id;
+		uint64 offset; // Offset of data in the pack file
+		uint64 size;
+		uint64 last_used;
+		bool extracted; // True if the data has been extracted to a loose file.
+	};
+
+	struct Pack
+	{
+		Pack() : file_size(0), live_bytes(0), num_writers(0), num_copy_readers(0) {}
+
+		std::string path;
+		uint64 file_size; // Including reserved space for in-progress writes.
+		uint64 live_bytes; // Sum of data sizes of index entries in this pack.
+		int num_writers; // Number of Writers currently writing into this pack.
+		int num_copy_readers; // Number of getData() calls currently reading a copy of data from this pack.  The pack is not compacted while this is non-zero.
+		Reference<PackMapping> mapping; // Only set once the pack is sealed.
+	};
+
+	static uint64 recordHeaderSize(size_t URL_len) { return 16 + URL_len; }
+
+	const std::string packPath(uint32 pack_id) const;
+	void loadIndex();
+	void startNewPack()												REQUIRES(mutex);
+	void removeEntry(std::unordered_map<std::string, Entry>::iterator it)	REQUIRES(mutex);
+	void clearExtracted(Entry& entry)												REQUIRES(mutex);
+	bool isSealed(uint32 pack_id, const Pack& pack) const							REQUIRES(mutex) { return (pack_id != current_pack_id) && (pack.num_writers == 0); }
+
+	// Called by Pin
+	void pin(const std::string& URL);
+	void unpin(const std::string& URL);
+
+	// Called by Writer
+	void reserve(uint64 record_size, uint32& pack_id_out, uint64& record_offset_out);
+	void writerFinished(const Writer& writer, bool committed);
+
+	std::string cache_dir;
+
+	mutable Mutex mutex;
+	std::unordered_map<std::string, Entry> entries		GUARDED_BY(mutex);
+	std::map<uint32, Pack> packs						GUARDED_BY(mutex);
+	uint32 current_pack_id								GUARDED_BY(mutex);
+	uint64 next_last_used								GUARDED_BY(mutex);
+	uint64 total_data_size								GUARDED_BY(mutex);
+	uint64 total_extracted_size							GUARDED_BY(mutex);
+	bool index_changed									GUARDED_BY(mutex);
+	std::set<uint32> packs_pending_deletion				GUARDED_BY(mutex); // Ids of pack files that we failed to delete.  Saved in the index so they are not reloaded as live packs.
+	std::unordered_map<std::string, int> pin_counts		GUARDED_BY(mutex); // Number of Pins for each pinned URL.
+};
+
+
+typedef Reference<PackedResourceCache> PackedResourceCacheRef;
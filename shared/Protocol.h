@@ -34,13 +34,14 @@ CyberspaceProtocolVersion
 38: Use length-prefixed serialisation for WorldMaterial, sending server version to client.
 39: Added QueryMapTiles, MapTilesResult
 40: Added QueryLODChunksMessage, LODChunkInitialSend, LODChunkUpdatedMessage
+41: Added MinClientProtocolVersion message.  Clients can decode voice packets with Opus frames longer than 10 ms.
 */
 namespace Protocol
 {
 
 const uint32 CyberspaceHello = 1357924680;
 
-const uint32 CyberspaceProtocolVersion = 40;
+const uint32 CyberspaceProtocolVersion = 41;
 
 const uint32 ClientProtocolOK		= 10000;
 const uint32 ClientProtocolTooOld	= 10001;
@@ -51,6 +52,8 @@ const uint32 ClientUDPSocketOpen	= 10003;
 const uint32 AudioStreamToServerStarted			= 10020;
 const uint32 AudioStreamToServerEnded			= 10021;
 
+const uint32 MinClientProtocolVersion			= 10030; // Server is sending the minimum protocol version of all connected clients.  Only sent to clients with protocol version >= 41.
+
 const uint32 ConnectionTypeUpdates				= 500;
 const uint32 ConnectionTypeUploadResource		= 501;
 const uint32 ConnectionTypeDownloadResources	= 502;
@@ -20,7 +20,7 @@ Generated at 2016-01-12 12:22:34 +1300
 
 
 ResourceManager::ResourceManager(const std::string& base_resource_dir_)
-:	base_resource_dir(base_resource_dir_), changed(0), total_present_resources_size_B(0)
+:	base_resource_dir(base_resource_dir_), changed(0), total_present_resources_size_B(0), packed_cache_budget_B(0), next_extract_id(0)
 {
 }
 
@@ -271,6 +271,9 @@ void ResourceManager::deleteResourceLocally(const ResourceRef& resource)
 		// conPrint("Deleting local resource '" + local_abs_path + "'...");
 		FileUtils::deleteFile(local_abs_path);
 
+		if(packed_cache.nonNull())
+			packed_cache->remove(resource->URL);
+
 		resource->setState(Resource::State_NotPresent);
 
 		resource->locally_deleted = true;
@@ -299,6 +302,119 @@ void ResourceManager::markAsChanged() // Thread-safe
 }
 
 
+void ResourceManager::setPackedCache(const Reference<PackedResourceCache>& packed_cache_, uint64 packed_cache_budget_B_)
+{
+	packed_cache = packed_cache_;
+	packed_cache_budget_B = packed_cache_budget_B_;
+}
+
+
+PackedResourceCache::PinRef ResourceManager::ensureResourceFileExtracted(const ResourceRef& resource)
+{
+	if(packed_cache.isNull())
+		return PackedResourceCache::PinRef();
+
+	// Pin the resource before checking for the extracted file, so doPackedCacheMaintenance() won't delete it after the check.
+	PackedResourceCache::PinRef pin;
+	{
+		Lock lock(packed_cache_eviction_mutex);
+		pin = new PackedResourceCache::Pin(packed_cache, resource->URL);
+	}
+
+	const std::string local_abs_path = resource->getLocalAbsPath(this->base_resource_dir);
+	if(FileUtils::fileExists(local_abs_path))
+	{
+		// The file may have been extracted in a previous session, so make sure it is counted against the budget.
+		packed_cache->markAsUsed(resource->URL);
+		packed_cache->setExtracted(resource->URL);
+		return pin;
+	}
+
+	PackedResourceCache::ReadRef data;
+	if(!packed_cache->getData(resource->URL, data)) // Marks the entry as used
+		return pin;
+
+	// Write to a temp file then move into place, so that other threads loading the same resource never see a partially written file.
+	const std::string temp_path = local_abs_path + "_extract_" + toString(next_extract_id.increment());
+	FileUtils::writeEntireFile(temp_path, (const char*)data.data.data(), data.data.size());
+	FileUtils::moveFile(temp_path, local_abs_path);
+
+	packed_cache->setExtracted(resource->URL);
+	return pin;
+}
+
+
+const std::string ResourceManager::extractedPathForURL(const std::string& URL, PackedResourceCache::PinRef& pin_out)
+{
+	ResourceRef resource = getOrCreateResourceForURL(URL);
+	if(resource->getState() == Resource::State_Present)
+		pin_out = ensureResourceFileExtracted(resource);
+	return getLocalAbsPathForResource(*resource);
+}
+
+
+// Deletes the extracted file, if any, for a resource in the packed cache.  May fail if the file is currently being loaded, in which case it is just left on disk.
+static void deleteExtractedFile(const std::string& local_abs_path)
+{
+	try
+	{
+		if(FileUtils::fileExists(local_abs_path))
+			FileUtils::deleteFile(local_abs_path);
+	}
+	catch(glare::Exception&)
+	{}
+}
+
+
+void ResourceManager::doPackedCacheMaintenance()
+{
+	if(packed_cache.isNull())
+		return;
+
+	try
+	{
+		{
+			Lock eviction_lock(packed_cache_eviction_mutex); // Don't let resources be pinned while we are evicting and deleting files.
+
+			std::vector<std::string> evicted_URLs, unextracted_URLs;
+			packed_cache->evictToBudget(packed_cache_budget_B, evicted_URLs, unextracted_URLs);
+
+			if(!evicted_URLs.empty() || !unextracted_URLs.empty())
+			{
+				Lock lock(mutex);
+				for(size_t i=0; i<evicted_URLs.size(); ++i)
+				{
+					auto res = resource_for_url.find(evicted_URLs[i]);
+					if(res != resource_for_url.end() && (res->second->getState() == Resource::State_Present))
+					{
+						deleteExtractedFile(res->second->getLocalAbsPath(this->base_resource_dir));
+
+						res->second->setState(Resource::State_NotPresent);
+					}
+				}
+
+				// These resources are still in the packed cache, just delete the extracted copy.  It will be extracted again if needed.
+				for(size_t i=0; i<unextracted_URLs.size(); ++i)
+				{
+					auto res = resource_for_url.find(unextracted_URLs[i]);
+					if(res != resource_for_url.end())
+						deleteExtractedFile(res->second->getLocalAbsPath(this->base_resource_dir));
+				}
+				this->changed = 1;
+			}
+		}
+
+		packed_cache->compactStep();
+
+		packed_cache->saveIndexIfChanged();
+	}
+	catch(glare::Exception& e)
+	{
+		conPrint("ResourceManager: packed cache maintenance failed: " + e.what());
+	}
+}
+
+
 void ResourceManager::addToDownloadFailedURLs(const std::string& URL)
 {
 	// conPrint("addToDownloadFailedURLs: " + URL);
@@ -356,6 +472,9 @@ std::string ResourceManager::getDiagnostics() const
 	}
 	if(num_present > max_num_to_display)
 		s += "  ...\n";
+
+	if(packed_cache.nonNull())
+		s += "Packed cache:\n" + packed_cache->getDiagnostics();
 	return s;
 }
 
@@ -10,6 +10,7 @@ Generated at 2016-01-12 12:22:34 +1300
 #include "Resource.h"
 #include "Avatar.h"
 #include "WorldObject.h"
+#include "PackedResourceCache.h"
 #include <ThreadSafeRefCounted.h>
 #include <Reference.h>
 #include <map>
@@ -69,6 +70,28 @@ public:
 
 	void deleteResourceLocally(const ResourceRef& resource);
 
+	// Optional packed cache.  If set, downloaded resources are stored in the packed cache instead of as individual files,
+	// and the packed cache is kept within packed_cache_budget_B by doPackedCacheMaintenance().
+	void setPackedCache(const Reference<PackedResourceCache>& packed_cache, uint64 packed_cache_budget_B);
+	const Reference<PackedResourceCache>& getPackedCache() const { return packed_cache; }
+
+	// Makes sure there is a file at the local path of the resource, extracting the resource data from the packed cache if needed.
+	// Marks the resource as used in the packed cache, and counts the extracted file against the packed cache budget.
+	// Should be called before loading a resource with a loader that takes a file path.  Loaders that can read from memory should use getPackedCache()->getData() instead.
+	// Returns a pin that stops doPackedCacheMaintenance() from deleting the extracted file.  The caller should hold it for as long as the file is read.
+	// Returns NULL if there is no packed cache.
+	// Throws glare::Exception on failure.
+	PackedResourceCache::PinRef ensureResourceFileExtracted(const ResourceRef& resource);
+
+	// Like pathForURL(), but also makes sure the file for the URL is extracted from the packed cache, if it is in the packed cache.
+	// Should be used instead of pathForURL() when the file at the returned path will be read.  pin_out is set as for ensureResourceFileExtracted().
+	// Throws glare::Exception if URL is invalid or on extraction failure.
+	const std::string extractedPathForURL(const std::string& URL, PackedResourceCache::PinRef& pin_out);
+
+	// Evicts least-recently-used resources and extracted files from the packed cache until it is within budget, and does a compaction step.
+	// Evicted resources are marked as not present, and any extracted files for them are deleted.  Pinned resources are not evicted.
+	void doPackedCacheMaintenance();
+
 
 	void addToDownloadFailedURLs(const std::string& URL);
 	bool isInDownloadFailedURLs(const std::string& URL) const;
@@ -103,6 +126,11 @@ private:
 	std::unordered_set<std::string> download_failed_URLs; // Ephemeral state, used to prevent trying to download the same resource over and over again in one client execution.
 
 	int64 total_present_resources_size_B;
+
+	Reference<PackedResourceCache> packed_cache;
+	uint64 packed_cache_budget_B;
+	glare::AtomicInt next_extract_id;
+	Mutex packed_cache_eviction_mutex; // Held while pinning a resource, and while evicting and deleting extracted files, so a file can't be deleted after it has been pinned.
 };
 
 
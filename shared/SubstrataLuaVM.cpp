@@ -18,6 +18,7 @@ Copyright Glare Technologies Limited 2024 -
 #elif SERVER
 #include "../server/Server.h"
 #include "../server/LuaHTTPRequestManager.h"
+#include "../server/MeshLODGenThread.h"
 #endif
 #include <lua/LuaVM.h>
 #include <lua/LuaScript.h>
@@ -535,6 +536,59 @@ static int luaAddEventListener(lua_State* state)
 }
 
 
+static int luaSetProximityRadius(lua_State* state)
+{
+	// Expected args:
+	// Arg 1: ob_uid : UID
+	// Arg 2: radius : number
+
+	checkNumArgs(state, /*num_args_required*/2);
+
+	const UID ob_uid = UID((uint64)LuaUtils::getDoubleArg(state, /*index=*/1));
+	const double radius = LuaUtils::getDoubleArg(state, /*index=*/2);
+	if(!(radius >= 0 && radius <= ObjectEventHandlers::MAX_PROXIMITY_RADIUS)) // Also rejects NaN
+		throw glare::Exception("setProximityRadius(): radius must be in [0, " + toString((int)ObjectEventHandlers::MAX_PROXIMITY_RADIUS) + "]" + errorContextString(state));
+
+	LuaScript* script = (LuaScript*)lua_getthreaddata(state);
+	LuaScriptEvaluator* script_evaluator = (LuaScriptEvaluator*)script->userdata;
+
+	// As in luaAddEventListener(), on the client the object may not be loaded yet, in which case set the radius on the pending event handlers.
+#if GUI_CLIENT
+	SubstrataLuaVM* sub_lua_vm = script_evaluator->substrata_lua_vm;
+	WorldState* world_state = sub_lua_vm->gui_client->world_state.ptr();
+
+	WorldObject* ob = nullptr;
+	try
+	{
+		ob = getWorldObjectForUID(script_evaluator, ob_uid);
+	}
+	catch(glare::Exception&)
+	{}
+
+	Reference<ObjectEventHandlers> ob_event_handlers;
+	if(ob)
+		ob_event_handlers = ob->getOrCreateEventHandlers();
+	else
+	{
+		if(world_state->pending_event_handlers[ob_uid].isNull())
+			world_state->pending_event_handlers[ob_uid] = new ObjectEventHandlers();
+		ob_event_handlers = world_state->pending_event_handlers[ob_uid];
+	}
+
+	ob_event_handlers->proximity_radius = (float)radius;
+
+	if(ob)
+		sub_lua_vm->gui_client->scripted_ob_proximity_checker.objectProximityRadiusChanged(ob);
+#else
+	// Proximity is determined by the client, so the radius is not used on the server, but store it anyway.
+	WorldObject* ob = getWorldObjectForUID(script_evaluator, ob_uid);
+	ob->getOrCreateEventHandlers()->proximity_radius = (float)radius;
+#endif
+
+	return 0;
+}
+
+
 static int showMessageToUser(lua_State* state)
 {
 	// Expected args:
@@ -662,6 +716,39 @@ static int objectStorageSetItem(lua_State* state)
 }
 
 
+#if SERVER
+// Reads the additional header lines table at table_index, of the form { header_name = value, ... }.
+// Throws glare::Exception if any header name or value is invalid, so scripts can't inject extra headers or requests with CR/LF characters.
+static void readAdditionalHeaderLines(lua_State* state, int table_index, std::vector<std::string>& header_lines_out)
+{
+	LuaUtils::checkValueIsTable(state, table_index);
+	lua_pushnil(state); // Push first key onto stack
+	while(1)
+	{
+		int notdone = lua_next(state, table_index); // pops a key from the stack, and pushes a key-value pair from the table at the given index
+		if(notdone == 0)
+			break;
+
+		const std::string name  = LuaUtils::getString(state, -2);
+		const std::string value = LuaUtils::getString(state, -1);
+		try
+		{
+			LuaHTTPRequestManager::checkHeaderNameValid(name);
+			LuaHTTPRequestManager::checkHeaderValueValid(value);
+		}
+		catch(glare::Exception& e)
+		{
+			throw glare::Exception("Invalid HTTP header line: " + e.what() + errorContextString(state));
+		}
+
+		header_lines_out.push_back(name + ": " + value);
+
+		lua_pop(state, 1); // Remove value, keep key on stack for next lua_next call
+	}
+}
+#endif
+
+
 static int doHTTPGetRequestAsync(lua_State* state)
 {
 	// Expected args:
@@ -702,20 +789,7 @@ static int doHTTPGetRequestAsync(lua_State* state)
 	request->request_type = "GET";
 	request->URL = URL_string;
 
-	LuaUtils::checkValueIsTable(state, /*index=*/2);
-	lua_pushnil(state); // Push first key onto stack
-	while(1)
-	{
-		int notdone = lua_next(state, /*table_index=*/2); // pops a key from the stack, and pushes a key-value pair from the table at the given index
-		if(notdone == 0)
-			break;
-
-		request->additional_headers.push_back(LuaUtils::getString(state, -2));
-		request->additional_headers.back() += ": ";
-		request->additional_headers.back() += LuaUtils::getString(state, -1);
-
-		lua_pop(state, 1); // Remove value, keep key on stack for next lua_next call
-	}
+	readAdditionalHeaderLines(state, /*table_index=*/2, request->additional_headers);
 
 	request->onDone_ref  = lua_ref(state, /*index=*/3);
 	request->onError_ref = lua_ref(state, /*index=*/4);
@@ -773,21 +847,17 @@ static int doHTTPPostRequestAsync(lua_State* state)
 	request->post_content = post_content;
 	request->content_type = content_type;
 
-	LuaUtils::checkValueIsTable(state, /*index=*/4);
-	lua_pushnil(state); // Push first key onto stack
-	while(1)
+	try
 	{
-		int notdone = lua_next(state, /*table_index=*/4); // pops a key from the stack, and pushes a key-value pair from the table at the given index
-		if(notdone == 0)
-			break;
-
-		request->additional_headers.push_back(LuaUtils::getString(state, -2));
-		request->additional_headers.back() += ": ";
-		request->additional_headers.back() += LuaUtils::getString(state, -1);
-
-		lua_pop(state, 1); // Remove value, keep key on stack for next lua_next call
+		LuaHTTPRequestManager::checkHeaderValueValid(content_type);
+	}
+	catch(glare::Exception& e)
+	{
+		throw glare::Exception("doHTTPPostRequestAsync(): invalid content_type: " + e.what() + errorContextString(state));
 	}
 
+	readAdditionalHeaderLines(state, /*table_index=*/4, request->additional_headers);
+
 	request->onDone_ref  = lua_ref(state, /*index=*/5);
 	request->onError_ref = lua_ref(state, /*index=*/6);
 
@@ -1503,6 +1573,12 @@ static int worldMaterialClassNewIndexMetaMethod(lua_State* state)
 	// Read key
 	int atom = -1;
 	const char* key_str = LuaUtils::getStringAndAtom(state, /*index=*/2, atom);
+
+	// If a texture URL is being assigned, keep a copy of the old material so we can tell if the textures changed.
+	Reference<WorldMaterial> old_mat;
+	if(atom == Atom_colour_texture_url || atom == Atom_emission_texture_url || atom == Atom_normal_map_url || atom == Atom_roughness_texture_url)
+		old_mat = mat->clone();
+
 	switch(atom) // NOTE: The switch cases should be in the same order as the Atom enum values to ensure nice code-gen.
 	{
 	case Atom_colour:
@@ -1561,6 +1637,14 @@ static int worldMaterialClassNewIndexMetaMethod(lua_State* state)
 		throw glare::Exception("Unknown field '" + std::string(key_str) + "'" + errorContextString(state));
 	}
 
+	if(old_mat.nonNull() && mat->updateBasisTexturesPresentFlag(old_mat.ptr())) // If the textures changed (also clears the Basis textures present flag in that case):
+	{
+		// Send a message to MeshLODGenThread to generate LOD and Basis textures for the new textures (if not already generated)
+		CheckGenResourcesForObject* msg = new CheckGenResourcesForObject();
+		msg->ob_uid = ob->uid;
+		sub_lua_vm->server->enqueueMsgForLodGenThread(msg);
+	}
+
 	// Mark the object as dirty, sending the updated object will send the updated material as well.
 	ob->from_remote_other_dirty = true; // TODO: rename
 	script_evaluator->world_state->getDirtyFromRemoteObjects(*script_evaluator->cur_world_state_lock).insert(ob);
@@ -1883,6 +1967,9 @@ SubstrataLuaVM::SubstrataLuaVM()
 	
 	lua_pushcfunction(lua_vm->state, luaAddEventListener, /*debugname=*/"addEventListener");
 	lua_setglobal(lua_vm->state, "addEventListener");
+
+	lua_pushcfunction(lua_vm->state, luaSetProximityRadius, /*debugname=*/"setProximityRadius");
+	lua_setglobal(lua_vm->state, "setProximityRadius");
 	
 	lua_pushcfunction(lua_vm->state, doHTTPGetRequestAsync, /*debugname=*/"doHTTPGetRequestAsync");
 	lua_setglobal(lua_vm->state, "doHTTPGetRequestAsync");
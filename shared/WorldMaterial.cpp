@@ -38,8 +38,32 @@ WorldMaterial::~WorldMaterial()
 {}
 
 
-static std::string getLODTextureURLForLevel(const std::string& base_texture_url, int material_min_lod_level, int level, bool has_alpha)
+// Can a Basis Universal version of the texture be generated by the server?
+// Gifs may be animated, and we don't do LOD for videos or http URLs.
+static bool canUseBasisForTexture(const std::string& base_texture_url)
 {
+	return (::hasExtensionStringView(base_texture_url, "jpg") || ::hasExtensionStringView(base_texture_url, "jpeg") || ::hasExtensionStringView(base_texture_url, "png")) &&
+		!hasPrefix(base_texture_url, "http:") && !hasPrefix(base_texture_url, "https:");
+}
+
+
+static std::string getBasisTextureURLForLevel(const std::string& base_texture_url, int material_min_lod_level, int level)
+{
+	if(!canUseBasisForTexture(base_texture_url))
+		return std::string();
+
+	if(level <= material_min_lod_level)
+		return removeDotAndExtension(base_texture_url) + ".basis";
+	else
+		return removeDotAndExtension(base_texture_url) + ((level == 0) ? "_lod0.basis" : ((level == 1) ? "_lod1.basis" : "_lod2.basis"));
+}
+
+
+static std::string getLODTextureURLForLevel(const std::string& base_texture_url, int material_min_lod_level, int level, bool has_alpha, bool use_basis)
+{
+	if(use_basis && canUseBasisForTexture(base_texture_url))
+		return getBasisTextureURLForLevel(base_texture_url, material_min_lod_level, level);
+
 	if(level <= material_min_lod_level)
 		return base_texture_url;
 	else
@@ -63,20 +87,32 @@ static std::string getLODTextureURLForLevel(const std::string& base_texture_url,
 }
 
 
-void ScalarVal::appendDependencyURLs(bool tex_use_sRGB, int material_min_lod_level, int lod_level, std::vector<DependencyURL>& paths_out) const
+// Appends the Basis texture URLs for all LOD levels, if the texture has a Basis version.
+static void appendBasisDependencyURLsAllLODLevels(const std::string& base_texture_url, bool tex_use_sRGB, int material_min_lod_level, std::vector<DependencyURL>& paths_out)
+{
+	if(canUseBasisForTexture(base_texture_url))
+		for(int i=material_min_lod_level; i <=2; ++i)
+			paths_out.push_back(DependencyURL(getBasisTextureURLForLevel(base_texture_url, material_min_lod_level, i), tex_use_sRGB));
+}
+
+
+void ScalarVal::appendDependencyURLs(bool tex_use_sRGB, int material_min_lod_level, bool use_basis, int lod_level, std::vector<DependencyURL>& paths_out) const
 {
 	if(!texture_url.empty())
-		paths_out.push_back(DependencyURL(getLODTextureURLForLevel(texture_url, material_min_lod_level, lod_level, /*has alpha=*/false), tex_use_sRGB));
+		paths_out.push_back(DependencyURL(getLODTextureURLForLevel(texture_url, material_min_lod_level, lod_level, /*has alpha=*/false, use_basis), tex_use_sRGB));
 }
 
 
-void ScalarVal::appendDependencyURLsAllLODLevels(bool tex_use_sRGB, int material_min_lod_level, std::vector<DependencyURL>& paths_out) const
+void ScalarVal::appendDependencyURLsAllLODLevels(bool tex_use_sRGB, int material_min_lod_level, bool use_basis, std::vector<DependencyURL>& paths_out) const
 {
 	if(!texture_url.empty())
 	{
 		paths_out.push_back(DependencyURL(texture_url, tex_use_sRGB));
 		for(int i=material_min_lod_level+1; i <=2; ++i)
-			paths_out.push_back(DependencyURL(getLODTextureURLForLevel(texture_url, material_min_lod_level, i, /*has alpha=*/false), tex_use_sRGB));
+			paths_out.push_back(DependencyURL(getLODTextureURLForLevel(texture_url, material_min_lod_level, i, /*has alpha=*/false, /*use_basis=*/false), tex_use_sRGB));
+
+		if(use_basis)
+			appendBasisDependencyURLsAllLODLevels(texture_url, tex_use_sRGB, material_min_lod_level, paths_out);
 	}
 }
 
@@ -100,7 +136,27 @@ void ScalarVal::convertLocalPathsToURLS(ResourceManager& resource_manager)
 
 std::string WorldMaterial::getLODTextureURLForLevel(const std::string& base_texture_url, int level, bool has_alpha) const
 {
-	return ::getLODTextureURLForLevel(base_texture_url, this->minLODLevel(), level, has_alpha);
+	return ::getLODTextureURLForLevel(base_texture_url, this->minLODLevel(), level, has_alpha, /*use_basis=*/this->basisTexturesPresent());
+}
+
+
+std::string WorldMaterial::getImageLODTextureURLForLevel(const std::string& base_texture_url, int level, bool has_alpha) const
+{
+	return ::getLODTextureURLForLevel(base_texture_url, this->minLODLevel(), level, has_alpha, /*use_basis=*/false);
+}
+
+
+std::string WorldMaterial::getBasisTextureURLForLevel(const std::string& base_texture_url, int level) const
+{
+	return ::getBasisTextureURLForLevel(base_texture_url, this->minLODLevel(), level);
+}
+
+
+bool WorldMaterial::updateBasisTexturesPresentFlag(const WorldMaterial* old_mat)
+{
+	const bool textures_unchanged = old_mat && textureURLsEqual(*old_mat) && (minLODLevel() == old_mat->minLODLevel());
+	BitUtils::setOrZeroBit(flags, BASIS_TEXTURES_PRESENT_FLAG, textures_unchanged && old_mat->basisTexturesPresent());
+	return !textures_unchanged;
 }
 
 
@@ -116,40 +172,53 @@ void WorldMaterial::appendDependencyURLs(int lod_level, std::vector<DependencyUR
 		paths_out.push_back(DependencyURL(getLODTextureURLForLevel(normal_map_url, lod_level, /*has alpha=*/false), /*use sRGB=*/false));
 
 	const int min_lod_level = this->minLODLevel();
-	roughness.			appendDependencyURLs(/*use sRGB=*/false, min_lod_level, lod_level, paths_out);
-	metallic_fraction.	appendDependencyURLs(/*use sRGB=*/false, min_lod_level, lod_level, paths_out);
-	opacity.			appendDependencyURLs(/*use sRGB=*/false, min_lod_level, lod_level, paths_out);
+	const bool use_basis = this->basisTexturesPresent();
+	// Basis textures are only generated for the roughness (metallic-roughness) texture, not metallic_fraction or opacity textures.
+	roughness.			appendDependencyURLs(/*use sRGB=*/false, min_lod_level, use_basis,         lod_level, paths_out);
+	metallic_fraction.	appendDependencyURLs(/*use sRGB=*/false, min_lod_level, /*use basis=*/false, lod_level, paths_out);
+	opacity.			appendDependencyURLs(/*use sRGB=*/false, min_lod_level, /*use basis=*/false, lod_level, paths_out);
 }
 
 
+// The image LOD textures are always included, followed by the Basis textures if BASIS_TEXTURES_PRESENT_FLAG is set.
 void WorldMaterial::appendDependencyURLsAllLODLevels(std::vector<DependencyURL>& paths_out) const
 {
 	const int min_lod_level = this->minLODLevel();
+	const bool use_basis = this->basisTexturesPresent();
 
 	if(!colour_texture_url.empty())
 	{
 		paths_out.push_back(DependencyURL(colour_texture_url));
 		for(int i=min_lod_level+1; i <=2; ++i)
-			paths_out.push_back(DependencyURL(getLODTextureURLForLevel(colour_texture_url, i, this->colourTexHasAlpha())));
+			paths_out.push_back(DependencyURL(getImageLODTextureURLForLevel(colour_texture_url, i, this->colourTexHasAlpha())));
+
+		if(use_basis)
+			appendBasisDependencyURLsAllLODLevels(colour_texture_url, /*use sRGB=*/true, min_lod_level, paths_out);
 	}
 	
 	if(!emission_texture_url.empty())
 	{
 		paths_out.push_back(DependencyURL(emission_texture_url));
 		for(int i=min_lod_level+1; i <=2; ++i)
-			paths_out.push_back(DependencyURL(getLODTextureURLForLevel(emission_texture_url, i, /*has alpha=*/false)));
+			paths_out.push_back(DependencyURL(getImageLODTextureURLForLevel(emission_texture_url, i, /*has alpha=*/false)));
+
+		if(use_basis)
+			appendBasisDependencyURLsAllLODLevels(emission_texture_url, /*use sRGB=*/true, min_lod_level, paths_out);
 	}
 
 	if(!normal_map_url.empty())
 	{
 		paths_out.push_back(DependencyURL(normal_map_url, /*use sRGB=*/false));
 		for(int i=min_lod_level+1; i <=2; ++i)
-			paths_out.push_back(DependencyURL(getLODTextureURLForLevel(normal_map_url, i, /*has alpha=*/false), /*use sRGB=*/false));
+			paths_out.push_back(DependencyURL(getImageLODTextureURLForLevel(normal_map_url, i, /*has alpha=*/false), /*use sRGB=*/false));
+
+		if(use_basis)
+			appendBasisDependencyURLsAllLODLevels(normal_map_url, /*use sRGB=*/false, min_lod_level, paths_out);
 	}
 
-	roughness.			appendDependencyURLsAllLODLevels(/*use sRGB=*/false, min_lod_level, paths_out);
-	metallic_fraction.	appendDependencyURLsAllLODLevels(/*use sRGB=*/false, min_lod_level, paths_out);
-	opacity.			appendDependencyURLsAllLODLevels(/*use sRGB=*/false, min_lod_level, paths_out);
+	roughness.			appendDependencyURLsAllLODLevels(/*use sRGB=*/false, min_lod_level, use_basis,         paths_out);
+	metallic_fraction.	appendDependencyURLsAllLODLevels(/*use sRGB=*/false, min_lod_level, /*use basis=*/false, paths_out);
+	opacity.			appendDependencyURLsAllLODLevels(/*use sRGB=*/false, min_lod_level, /*use basis=*/false, paths_out);
 }
 
 
@@ -752,6 +821,70 @@ void WorldMaterial::test()
 	}
 
 
+	//----------------------- Test BASIS_TEXTURES_PRESENT_FLAG -----------------------
+	{
+		WorldMaterial mat;
+		mat.colour_texture_url = "sometex.png";
+		mat.roughness.texture_url = "roughtex.jpg";
+		mat.emission_texture_url = "anim.gif";
+		BitUtils::setBit(mat.flags, WorldMaterial::BASIS_TEXTURES_PRESENT_FLAG);
+
+		std::vector<DependencyURL> urls;
+		mat.appendDependencyURLs(/*lod level=*/0, urls);
+		testAssert(urls.size() == 3);
+		testAssert(urls[0].URL == "sometex.basis" && urls[0].use_sRGB);
+		testAssert(urls[1].URL == "anim.gif"); // Gifs don't have Basis versions.
+		testAssert(urls[2].URL == "roughtex.basis" && !urls[2].use_sRGB);
+
+		urls.clear();
+		mat.appendDependencyURLs(/*lod level=*/2, urls);
+		testAssert(urls.size() == 3);
+		testAssert(urls[0].URL == "sometex_lod2.basis");
+		testAssert(urls[1].URL == "anim_lod2.gif");
+		testAssert(urls[2].URL == "roughtex_lod2.basis");
+
+		// The image LOD URLs should not be affected by the flag.
+		testAssert(mat.getImageLODTextureURLForLevel(mat.colour_texture_url, 1, /*has alpha=*/false) == "sometex_lod1.jpg");
+		testAssert(mat.getBasisTextureURLForLevel("anim.gif", 1) == "");
+		testAssert(mat.getBasisTextureURLForLevel("http://example.com/tex.png", 1) == "");
+
+		// Test updateBasisTexturesPresentFlag
+		{
+			const Reference<WorldMaterial> old_mat = mat.clone();
+			Reference<WorldMaterial> new_mat = mat.clone();
+			BitUtils::zeroBit(new_mat->flags, WorldMaterial::BASIS_TEXTURES_PRESENT_FLAG);
+			testAssert(!new_mat->updateBasisTexturesPresentFlag(old_mat.ptr())); // Textures unchanged, so flag should be taken from old_mat.
+			testAssert(new_mat->basisTexturesPresent());
+
+			new_mat->normal_map_url = "normals.png";
+			testAssert(new_mat->updateBasisTexturesPresentFlag(old_mat.ptr()));
+			testAssert(!new_mat->basisTexturesPresent());
+
+			new_mat = mat.clone();
+			testAssert(new_mat->updateBasisTexturesPresentFlag(NULL));
+			testAssert(!new_mat->basisTexturesPresent());
+		}
+
+		// All LOD levels should include both the image and Basis textures.
+		urls.clear();
+		mat.colour_texture_url = "";
+		mat.emission_texture_url = "";
+		mat.appendDependencyURLsAllLODLevels(urls);
+		testAssert(urls.size() == 6);
+		testAssert(urls[0].URL == "roughtex.jpg");
+		testAssert(urls[1].URL == "roughtex_lod1.jpg");
+		testAssert(urls[2].URL == "roughtex_lod2.jpg");
+		testAssert(urls[3].URL == "roughtex.basis");
+		testAssert(urls[4].URL == "roughtex_lod1.basis");
+		testAssert(urls[5].URL == "roughtex_lod2.basis");
+
+		// With the MIN_LOD_LEVEL_IS_NEGATIVE_1 flag, level 0 gets its own Basis texture.
+		BitUtils::setBit(mat.flags, WorldMaterial::MIN_LOD_LEVEL_IS_NEGATIVE_1);
+		testAssert(mat.getLODTextureURLForLevel(mat.roughness.texture_url, -1, /*has alpha=*/false) == "roughtex.basis");
+		testAssert(mat.getLODTextureURLForLevel(mat.roughness.texture_url, 0, /*has alpha=*/false) == "roughtex_lod0.basis");
+	}
+
+
 	// Perf test
 	{
 		int iters = 1000;
@@ -30,8 +30,8 @@ struct ScalarVal
 	ScalarVal() : val(0.0f) {}
 	explicit ScalarVal(const float v) : val(v) {}
 
-	void appendDependencyURLs(bool tex_use_sRGB, int material_min_lod_level, int lod_level, std::vector<DependencyURL>& paths_out) const;
-	void appendDependencyURLsAllLODLevels(bool tex_use_sRGB, int material_min_lod_level, std::vector<DependencyURL>& paths_out) const;
+	void appendDependencyURLs(bool tex_use_sRGB, int material_min_lod_level, bool use_basis, int lod_level, std::vector<DependencyURL>& paths_out) const;
+	void appendDependencyURLsAllLODLevels(bool tex_use_sRGB, int material_min_lod_level, bool use_basis, std::vector<DependencyURL>& paths_out) const;
 	void appendDependencyURLsBaseLevel(bool tex_use_sRGB, std::vector<DependencyURL>& paths_out) const;
 
 	void convertLocalPathsToURLS(ResourceManager& resource_manager);
@@ -86,6 +86,8 @@ public:
 	static const uint32 USE_VERT_COLOURS_FOR_WIND   = 8;
 	static const uint32 DOUBLE_SIDED_FLAG           = 16;
 	static const uint32 DECAL_FLAG                  = 32;
+	static const uint32 BASIS_TEXTURES_PRESENT_FLAG = 64; // Set by the server when Basis Universal (.basis) versions of all LOD levels of the material textures have been generated.
+	// If set, clients use the .basis textures instead of the JPG/PNG LOD textures, see getLODTextureURLForLevel().
 
 	uint32 flags;
 
@@ -96,6 +98,8 @@ public:
 
 	inline bool isDecal() const { return BitUtils::isBitSet(flags, DECAL_FLAG); }
 
+	inline bool basisTexturesPresent() const { return BitUtils::isBitSet(flags, BASIS_TEXTURES_PRESENT_FLAG); }
+
 
 	Reference<WorldMaterial> clone() const
 	{
@@ -132,8 +136,32 @@ public:
 			flags == b.flags;
 	}
 
+	bool textureURLsEqual(const WorldMaterial& b) const
+	{
+		return
+			colour_texture_url == b.colour_texture_url &&
+			emission_texture_url == b.emission_texture_url &&
+			normal_map_url == b.normal_map_url &&
+			roughness.texture_url == b.roughness.texture_url &&
+			metallic_fraction.texture_url == b.metallic_fraction.texture_url &&
+			opacity.texture_url == b.opacity.texture_url;
+	}
+
+	// Should be called after the material may have been changed from old_mat.
+	// Keeps BASIS_TEXTURES_PRESENT_FLAG from old_mat only if the textures are unchanged, since any Basis textures were generated for the old textures.
+	// MeshLODGenThread sets the flag again once the Basis textures for the new textures have been generated.  old_mat may be NULL, in which case the flag is cleared.
+	// Returns true if the textures changed, in which case the server should send a CheckGenResourcesForObject message to MeshLODGenThread.
+	bool updateBasisTexturesPresentFlag(const WorldMaterial* old_mat);
+
+	// Returns the .basis texture URL if BASIS_TEXTURES_PRESENT_FLAG is set and the texture has a Basis version, otherwise the image (JPG/PNG/GIF) LOD texture URL.
 	std::string getLODTextureURLForLevel(const std::string& base_texture_url, int level, bool has_alpha) const;
 
+	// Returns the JPG/PNG/GIF LOD texture URL, ignoring BASIS_TEXTURES_PRESENT_FLAG.  Used on the server when generating LOD textures.
+	std::string getImageLODTextureURLForLevel(const std::string& base_texture_url, int level, bool has_alpha) const;
+
+	// Returns the URL of the .basis texture for the given LOD level, or the empty string if the texture can't be converted to Basis (e.g. gifs, videos, http URLs).
+	std::string getBasisTextureURLForLevel(const std::string& base_texture_url, int level) const;
+
 	void appendDependencyURLs(int lod_level, std::vector<DependencyURL>& paths_out) const;
 	void appendDependencyURLsAllLODLevels(std::vector<DependencyURL>& paths_out) const;
 	void appendDependencyURLsBaseLevel(std::vector<DependencyURL>& paths_out) const;
@@ -15,6 +15,7 @@ Copyright Glare Technologies Limited 2016 -
 #include "../gui_client/MeshManager.h"
 #include "../gui_client/PhysicsObject.h"
 #include "../gui_client/Scripting.h"
+#include "../gui_client/ObjectLODTable.h"
 #include <graphics/ImageMap.h>
 #include <opengl/ui/GLUITextView.h>
 #include <opengl/OpenGLEngine.h>
@@ -85,6 +86,8 @@ WorldObject::WorldObject() noexcept
 	current_lod_level = 0;
 	loading_or_loaded_model_lod_level = -10;
 	loading_or_loaded_lod_level = -10;
+	lod_table = NULL;
+	lod_table_index = -1;
 	is_path_controlled = false;
 	use_materialise_effect_on_load = false;
 	materialise_effect_start_time = -1000.f;
@@ -132,6 +135,7 @@ WorldObject::~WorldObject()
 {
 #if GUI_CLIENT
 	assert(physics_object.isNull());
+	assert(lod_table == NULL); // Should have been removed from the LOD table before being destroyed.
 #endif
 }
 
@@ -153,6 +157,15 @@ std::string WorldObject::getLODModelURLForLevel(const std::string& base_model_ur
 }
 
 
+std::string WorldObject::getGPUMeshURLForLevel(const std::string& base_model_url, int level)
+{
+	if(hasPrefix(base_model_url, "http:") || hasPrefix(base_model_url, "https:"))
+		return base_model_url;
+
+	return removeDotAndExtension(getLODModelURLForLevel(base_model_url, level)) + ".gpumesh";
+}
+
+
 int WorldObject::getLODLevelForURL(const std::string& URL) // Identifies _lod1 etc. suffix.
 {
 	const std::string base = removeDotAndExtension(URL);
@@ -210,7 +223,10 @@ void WorldObject::appendDependencyURLs(int ob_lod_level, const GetDependencyOpti
 	if(!model_url.empty())
 	{
 		const int ob_model_lod_level =  myClamp(ob_lod_level, 0, this->max_model_lod_level);
-		URLs_out.push_back(DependencyURL(getLODModelURLForLevel(model_url, ob_model_lod_level)));
+		if(BitUtils::isBitSet(flags, GPU_MESH_PRESENT_FLAG))
+			URLs_out.push_back(DependencyURL(getGPUMeshURLForLevel(model_url, ob_model_lod_level)));
+		else
+			URLs_out.push_back(DependencyURL(getLODModelURLForLevel(model_url, ob_model_lod_level)));
 	}
 
 	if(options.include_lightmaps && !lightmap_url.empty())
@@ -238,6 +254,10 @@ void WorldObject::appendDependencyURLsForAllLODLevels(std::vector<DependencyURL>
 			URLs_out.push_back(DependencyURL(getLODModelURLForLevel(model_url, 1)));
 			URLs_out.push_back(DependencyURL(getLODModelURLForLevel(model_url, 2)));
 		}
+
+		if(BitUtils::isBitSet(flags, GPU_MESH_PRESENT_FLAG))
+			for(int lvl=0; lvl<=max_model_lod_level; ++lvl)
+				URLs_out.push_back(DependencyURL(getGPUMeshURLForLevel(model_url, lvl)));
 	}
 
 	if(!lightmap_url.empty())
@@ -1391,7 +1411,20 @@ void WorldObject::zeroAABBOS()
 	this->centroid_ws = Vec4f(0,0,0,1);
 	this->aabb_ws_longest_len = 0;
 	this->biased_aabb_len = 0;
+
+#if GUI_CLIENT
+	if(lod_table)
+		updateLODTableEntry();
+#endif
+}
+
+
+#if GUI_CLIENT
+void WorldObject::updateLODTableEntry()
+{
+	lod_table->objectTransformChanged(this);
 }
+#endif
 
 
 void WorldObject::transformChanged() // Rebuild centroid_ws, biased_aabb_len
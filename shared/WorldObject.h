@@ -40,6 +40,7 @@ class ResourceManager;
 class WinterShaderEvaluator;
 class LuaScriptEvaluator;
 class ObjectEventHandlers;
+class ObjectLODTable;
 class Matrix4f;
 class RayMesh;
 namespace Indigo { class SceneNodeModel; }
@@ -155,6 +156,7 @@ public:
 
 	static std::string getLODModelURLForLevel(const std::string& base_model_url, int level);
 	static int getLODLevelForURL(const std::string& URL); // Identifies _lod1 etc. suffix.
+	static std::string getGPUMeshURLForLevel(const std::string& base_model_url, int level); // URL of the GPUMesh (.gpumesh) variant of the LOD model, see GPUMesh.h
 	static std::string getLODLightmapURL(const std::string& base_lightmap_url, int level);
 
 	inline int getLODLevel(const Vec3d& campos) const;
@@ -300,6 +302,7 @@ public:
 	static const uint32 VIDEO_MUTED                             = 128; // For video objects, should the video be initially muted?
 	static const uint32 IS_SENSOR_FLAG                          = 256; // Is this a physics sensor?
 	static const uint32 EXCLUDE_FROM_LOD_CHUNK_MESH             = 512; // Should this object be excluded from LOD Chunk meshes? (for e.g. moving objects)
+	static const uint32 GPU_MESH_PRESENT_FLAG                   = 1024; // Has the server generated .gpumesh files for all model LOD levels of the current model_url?  Only set by the server.
 	uint32 flags;
 
 	TimeStamp created_time;
@@ -428,6 +431,10 @@ public:
 	int loading_or_loaded_lod_level; // Lod level for textures etc.. 
 	// Both these lod levels will be reset to -10 if the model is unloaded due to being out of camera proximity.
 
+	ObjectLODTable* lod_table; // The table this object is in, or NULL.  Updated when the transform changes.
+	int lod_table_index; // Index of this object in lod_table, or -1 if not in a table.
+	void updateLODTableEntry();
+
 	bool is_path_controlled; // Is this object controlled by a path controller script?  If so, we want to set the OpenGL transform from the physics engine.
 
 	Reference<WebViewData> web_view_data;
@@ -660,6 +667,11 @@ void WorldObject::doTransformChanged(const Matrix4f& ob_to_world, const Vec4f& u
 
 	if(BitUtils::isBitSet(flags, SUMMONED_FLAG))
 		this->biased_aabb_len *= 4;
+
+#if GUI_CLIENT
+	if(lod_table)
+		updateLODTableEntry();
+#endif
 }
 
 
@@ -681,4 +693,9 @@ void WorldObject::doTransformChangedIgnoreRotation(const Vec4f& use_position, co
 
 	if(BitUtils::isBitSet(flags, SUMMONED_FLAG))
 		this->biased_aabb_len *= 4;
+
+#if GUI_CLIENT
+	if(lod_table)
+		updateLODTableEntry();
+#endif
 }
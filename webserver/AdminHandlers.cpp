@@ -13,6 +13,7 @@ Copyright Glare Technologies Limited 2021 -
 #include "ResponseUtils.h"
 #include "WebServerResponseUtils.h"
 #include "LoginHandlers.h"
+#include "WebDataStore.h"
 #include "../server/ServerWorldState.h"
 #include <ConPrint.h>
 #include <Exception.h>
@@ -129,6 +130,9 @@ void renderMainAdminPage(ServerAllWorldsState& world_state, const web::RequestIn
 		page_out += "</form>";
 	}
 
+	page_out += "<h2>Web page cache</h2>\n";
+	page_out += world_state.web_data_store->page_cache.getStatsHTML();
+
 	web::ResponseUtils::writeHTTPOKHeaderAndData(reply_info, page_out);
 }
 
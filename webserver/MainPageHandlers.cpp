@@ -13,6 +13,7 @@ Copyright Glare Technologies Limited 2021 -
 #include "ResponseUtils.h"
 #include "WebServerResponseUtils.h"
 #include "LoginHandlers.h"
+#include "WebPageCache.h"
 #include "../shared/Version.h"
 #include "../server/ServerWorldState.h"
 #include <ConPrint.h>
@@ -20,6 +21,7 @@ Copyright Glare Technologies Limited 2021 -
 #include <Lock.h>
 #include <StringUtils.h>
 #include <PlatformUtils.h>
+#include <Clock.h>
 #include <WebDataStore.h>
 #include <webserver/ResponseUtils.h>
 
@@ -30,6 +32,21 @@ namespace MainPageHandlers
 
 void renderRootPage(ServerAllWorldsState& world_state, WebDataStore& data_store, const web::RequestInfo& request_info, web::ReplyInfo& reply_info)
 {
+	// Serve from the page cache if possible.
+	const bool use_page_cache = WebPageCache::isCacheableRequest(request_info);
+	const std::string cache_key = WebPageCache::makeKey(request_info);
+	const uint64 data_version = world_state.getWebDataVersion(); // Get version before rendering, so that changes made during rendering invalidate the cached page.
+	const double cur_time = Clock::getTimeSinceInit();
+	if(use_page_cache)
+	{
+		Reference<WebPageCacheEntry> entry = data_store.page_cache.lookup(cache_key, data_version, cur_time);
+		if(entry.nonNull())
+		{
+			data_store.page_cache.writeResponse(*entry, request_info, reply_info);
+			return;
+		}
+	}
+
 	//std::string page_out = WebServerResponseUtils::standardHeader(world_state, request_info, /*page title=*/"Substrata");
 	//const bool logged_in = LoginHandlers::isLoggedInAsNick(data_store, request_info);
 
@@ -221,7 +238,14 @@ void renderRootPage(ServerAllWorldsState& world_state, WebDataStore& data_store,
 	
 	page_out += WebServerResponseUtils::standardFooter(request_info, true);
 
-	web::ResponseUtils::writeHTTPOKHeaderAndData(reply_info, page_out);
+	if(use_page_cache)
+	{
+		// Page shows auction prices and upcoming events, which depend on the current time, so limit max age.
+		Reference<WebPageCacheEntry> entry = data_store.page_cache.insert(cache_key, data_version, page_out, /*max age (s)=*/60.0, cur_time);
+		data_store.page_cache.writeResponse(*entry, request_info, reply_info);
+	}
+	else
+		web::ResponseUtils::writeHTTPOKHeaderAndData(reply_info, page_out);
 }
 
 
@@ -798,6 +822,22 @@ void renderBotStatusPage(ServerAllWorldsState& world_state, const web::RequestIn
 
 void renderMapPage(ServerAllWorldsState& world_state, const web::RequestInfo& request_info, web::ReplyInfo& reply_info)
 {
+	// Serve from the page cache if possible.
+	WebPageCache& page_cache = world_state.web_data_store->page_cache;
+	const bool use_page_cache = WebPageCache::isCacheableRequest(request_info);
+	const std::string cache_key = WebPageCache::makeKey(request_info);
+	const uint64 data_version = world_state.getWebDataVersion();
+	const double cur_time = Clock::getTimeSinceInit();
+	if(use_page_cache)
+	{
+		Reference<WebPageCacheEntry> entry = page_cache.lookup(cache_key, data_version, cur_time);
+		if(entry.nonNull())
+		{
+			page_cache.writeResponse(*entry, request_info, reply_info);
+			return;
+		}
+	}
+
 	const std::string extra_header_tags = WebServerResponseUtils::getMapHeaderTags();
 	std::string page = WebServerResponseUtils::standardHeader(world_state, request_info, /*page title=*/"Map", extra_header_tags);
 
@@ -805,7 +845,14 @@ void renderMapPage(ServerAllWorldsState& world_state, const web::RequestInfo& re
 
 	page += WebServerResponseUtils::standardFooter(request_info, true);
 
-	web::ResponseUtils::writeHTTPOKHeaderAndData(reply_info, page);
+	if(use_page_cache)
+	{
+		// Parcel state on the map depends on whether auctions are currently running, so limit max age.
+		Reference<WebPageCacheEntry> entry = page_cache.insert(cache_key, data_version, page, /*max age (s)=*/60.0, cur_time);
+		page_cache.writeResponse(*entry, request_info, reply_info);
+	}
+	else
+		web::ResponseUtils::writeHTTPOKHeaderAndData(reply_info, page);
 }
 
 
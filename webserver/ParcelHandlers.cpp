@@ -14,6 +14,8 @@ Copyright Glare Technologies Limited 2021 -
 #include "ResponseUtils.h"
 #include "WebServerResponseUtils.h"
 #include "LoginHandlers.h"
+#include "WebDataStore.h"
+#include "WebPageCache.h"
 #include "../server/ServerWorldState.h"
 #include "../server/Order.h"
 #include <ConPrint.h>
@@ -23,6 +25,7 @@ Copyright Glare Technologies Limited 2021 -
 #include <PlatformUtils.h>
 #include <Parser.h>
 #include <ContainerUtils.h>
+#include <Clock.h>
 
 
 namespace ParcelHandlers
@@ -42,6 +45,22 @@ void renderParcelPage(ServerAllWorldsState& world_state, const web::RequestInfo&
 		if(!parser.parseUnsignedInt(parcel_id))
 			throw glare::Exception("Failed to parse parcel id");
 
+		// Serve from the page cache if possible.
+		WebPageCache& page_cache = world_state.web_data_store->page_cache;
+		const bool use_page_cache = WebPageCache::isCacheableRequest(request);
+		const std::string cache_key = WebPageCache::makeKey(request);
+		const uint64 data_version = world_state.getWebDataVersion(); // Get version before rendering, so that changes made during rendering invalidate the cached page.
+		const double cur_time = Clock::getTimeSinceInit();
+		if(use_page_cache)
+		{
+			Reference<WebPageCacheEntry> entry = page_cache.lookup(cache_key, data_version, cur_time);
+			if(entry.nonNull())
+			{
+				page_cache.writeResponse(*entry, request, reply_info);
+				return;
+			}
+		}
+
 		const std::string extra_header_tags = WebServerResponseUtils::getMapHeaderTags();
 
 		std::string page = WebServerResponseUtils::standardHeader(world_state, request, /*page title=*/"Parcel #" + toString(parcel_id) + "", extra_header_tags);
@@ -298,7 +317,14 @@ void renderParcelPage(ServerAllWorldsState& world_state, const web::RequestInfo&
 		page += "</div>   \n"; // end main div
 		page += WebServerResponseUtils::standardFooter(request, true);
 
-		web::ResponseUtils::writeHTTPOKHeaderAndData(reply_info, page);
+		if(use_page_cache)
+		{
+			// Page shows current auction state, so limit max age.
+			Reference<WebPageCacheEntry> entry = page_cache.insert(cache_key, data_version, page, /*max age (s)=*/60.0, cur_time);
+			page_cache.writeResponse(*entry, request, reply_info);
+		}
+		else
+			web::ResponseUtils::writeHTTPOKHeaderAndData(reply_info, page);
 	}
 	catch(glare::Exception& e)
 	{
@@ -29,68 +29,73 @@ WebDataStore::~WebDataStore() {}
 
 
 
-static void compressFile(Reference<WebDataStoreFile> file, const std::string& path)
+void WebDataStoreFile::compress(int deflate_level, int zstd_level)
 {
-#if BUILD_TESTS
-	const bool use_high_compression_level = false; // don't spend long compressing for debug modes
-#else
-	const bool use_high_compression_level = true;
-#endif
-
 	// Do deflate compression
 	{
-		Timer timer;
+		const uLong bound = compressBound((uLong)uncompressed_data.size());
 
-		const uLong bound = compressBound((uLong)file->uncompressed_data.size());
-
-		file->deflate_compressed_data.resizeNoCopy(bound);
+		deflate_compressed_data.resizeNoCopy(bound);
 		uLong dest_len = bound;
 
 		const int result = ::compress2(
-			file->deflate_compressed_data.data(), // dest
+			deflate_compressed_data.data(), // dest
 			&dest_len, // dest len
-			(Bytef*)file->uncompressed_data.data(), // source
-			(uLong)file->uncompressed_data.size(), // source len
-			(use_high_compression_level ? Z_BEST_COMPRESSION : Z_BEST_SPEED)
+			(Bytef*)uncompressed_data.data(), // source
+			(uLong)uncompressed_data.size(), // source len
+			deflate_level
 		);
 
 		if(result != Z_OK)
 			throw glare::Exception("Compression failed.");
 
-		file->deflate_compressed_data.resize(dest_len);
-
-		conPrint("Compressed file '" + path + "' from " + toString(file->uncompressed_data.size()) + " B to " + toString((uint64)dest_len) + " B with deflate (" + 
-			doubleToStringNSigFigs((double)dest_len / file->uncompressed_data.size(), 4) + " dest/src size ratio).  Elapsed: " + timer.elapsedStringNPlaces(3));
+		deflate_compressed_data.resize(dest_len);
 	}
 
 	// Do zstd compression
 	{
-		Timer timer;
-
-		const size_t compressed_bound = ZSTD_compressBound(file->uncompressed_data.size());
+		const size_t compressed_bound = ZSTD_compressBound(uncompressed_data.size());
 
-		file->zstd_compressed_data.resizeNoCopy(compressed_bound);
-
-		// Chrome seems to not be able to decompress Zstd data with compression levels >= 20 ('ultra' compression levels), see https://issues.chromium.org/issues/41493659
-		// So use 19.
+		zstd_compressed_data.resizeNoCopy(compressed_bound);
 
 		const size_t compressed_size = ZSTD_compress(
-			/*dest=*/file->zstd_compressed_data.data(), /*dest capacity=*/file->zstd_compressed_data.size(), 
-			/*src=*/file->uncompressed_data.data(), /*src size=*/file->uncompressed_data.size(),
-			(use_high_compression_level ? 19 : 1)
+			/*dest=*/zstd_compressed_data.data(), /*dest capacity=*/zstd_compressed_data.size(), 
+			/*src=*/uncompressed_data.data(), /*src size=*/uncompressed_data.size(),
+			zstd_level
 		);
 		if(ZSTD_isError(compressed_size))
 			throw glare::Exception(std::string("Compression failed: ") + ZSTD_getErrorName(compressed_size));
 
 		// Trim compressed_data
-		file->zstd_compressed_data.resize(compressed_size);
-
-		conPrint("Compressed file '" + path + "' from " + toString(file->uncompressed_data.size()) + " B to " + toString(compressed_size) + " B with zstd (" + 
-			doubleToStringNSigFigs((double)compressed_size / file->uncompressed_data.size(), 4) + " dest/src size ratio).  Elapsed: " + timer.elapsedStringNPlaces(3));
+		zstd_compressed_data.resize(compressed_size);
 	}
 }
 
 
+static void compressFile(Reference<WebDataStoreFile> file, const std::string& path)
+{
+#if BUILD_TESTS
+	const bool use_high_compression_level = false; // don't spend long compressing for debug modes
+#else
+	const bool use_high_compression_level = true;
+#endif
+
+	Timer timer;
+
+	// Chrome seems to not be able to decompress Zstd data with compression levels >= 20 ('ultra' compression levels), see https://issues.chromium.org/issues/41493659
+	// So use 19.
+	file->compress(
+		/*deflate level=*/use_high_compression_level ? Z_BEST_COMPRESSION : Z_BEST_SPEED,
+		/*zstd level=*/use_high_compression_level ? 19 : 1
+	);
+
+	conPrint("Compressed file '" + path + "' from " + toString(file->uncompressed_data.size()) + " B to " + toString(file->deflate_compressed_data.size()) + " B with deflate (" + 
+		doubleToStringNSigFigs((double)file->deflate_compressed_data.size() / file->uncompressed_data.size(), 4) + " dest/src size ratio), " + 
+		toString(file->zstd_compressed_data.size()) + " B with zstd (" + 
+		doubleToStringNSigFigs((double)file->zstd_compressed_data.size() / file->uncompressed_data.size(), 4) + " dest/src size ratio).  Elapsed: " + timer.elapsedStringNPlaces(3));
+}
+
+
 static js::Vector<uint8, 16> readFile(const std::string& path)
 {
 	MemMappedFile file(path);
@@ -213,6 +218,9 @@ void WebDataStore::loadAndCompressFiles()
 
 	//conPrint("WebDataStore::loadAndCompressFiles done.");
 
+	// Cached pages may have been built from old fragments or reference an old main_css_hash, so discard them.
+	page_cache.clear();
+
 	// Compute main_css_hash (cache-busting hash)
 	{
 		Lock lock(mutex);
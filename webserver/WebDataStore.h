@@ -6,6 +6,7 @@ Copyright Glare Technologies Limited 2022 -
 #pragma once
 
 
+#include "WebPageCache.h"
 #include <ThreadSafeRefCounted.h>
 #include <Reference.h>
 #include <Vector.h>
@@ -18,6 +19,9 @@ Copyright Glare Technologies Limited 2022 -
 class WebDataStoreFile : public ThreadSafeRefCounted
 {
 public:
+	// Fills in deflate_compressed_data and zstd_compressed_data from uncompressed_data.  Throws glare::Exception on failure.
+	void compress(int deflate_level, int zstd_level);
+
 	js::Vector<uint8, 16> uncompressed_data;
 	js::Vector<uint8, 16> deflate_compressed_data;
 	js::Vector<uint8, 16> zstd_compressed_data;
@@ -68,6 +72,9 @@ public:
 	Mutex mutex;
 
 
+	WebPageCache page_cache; // Cache of rendered, compressed dynamic pages and fragments.  Has its own mutex.
+
+
 	std::string main_css_hash GUARDED_BY(hash_mutex);
 	Mutex hash_mutex;
 };
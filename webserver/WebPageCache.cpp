@@ -0,0 +1,345 @@
+/*=====================================================================
+WebPageCache.cpp
+----------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#include "WebPageCache.h"
+
+
+#include "WebDataStore.h"
+#include "RequestInfo.h"
+#include "Response.h"
+#include <utils/StringUtils.h>
+#include <utils/ConPrint.h>
+#include <utils/Lock.h>
+#include <utils/Clock.h>
+#include <utils/TestUtils.h>
+#include <utils/IncludeXXHash.h>
+#include <zlib.h>
+#include <cstring>
+
+
+static const size_t MAX_NUM_PAGES = 4096; // Limit number of cached pages so memory usage stays bounded.
+
+
+WebPageCache::WebPageCache()
+:	num_hits(0), num_misses(0), num_not_modified_responses(0), num_fragment_hits(0), num_fragment_misses(0)
+{}
+
+
+WebPageCache::~WebPageCache()
+{}
+
+
+bool WebPageCache::isCacheableRequest(const web::RequestInfo& request_info)
+{
+	// Requests with a session cookie may be for a logged-in user, so don't cache.  See LoginHandlers::getLoggedInUser().
+	for(size_t i=0; i<request_info.cookies.size(); ++i)
+		if(request_info.cookies[i].key == "site-b")
+			return false;
+	return true;
+}
+
+
+std::string WebPageCache::makeKey(const web::RequestInfo& request_info)
+{
+	// Only requests that are not logged in are cached currently, so just append a not-logged-in marker in case that changes.
+	return request_info.path + "|anon";
+}
+
+
+void WebPageCache::removeExpiredEntries(double cur_time)
+{
+	for(auto it = pages.begin(); it != pages.end(); )
+	{
+		if(cur_time >= it->second->expiry_time)
+			it = pages.erase(it);
+		else
+			++it;
+	}
+
+	for(auto it = fragments.begin(); it != fragments.end(); )
+	{
+		if(cur_time >= it->second.expiry_time)
+			it = fragments.erase(it);
+		else
+			++it;
+	}
+}
+
+
+Reference<WebPageCacheEntry> WebPageCache::lookup(const std::string& key, uint64 data_version, double cur_time)
+{
+	Lock lock(mutex);
+
+	auto res = pages.find(key);
+	if(res != pages.end())
+	{
+		WebPageCacheEntry* entry = res->second.ptr();
+		if((entry->data_version == data_version) && (cur_time < entry->expiry_time))
+		{
+			num_hits.increment();
+			return res->second;
+		}
+
+		pages.erase(res); // Entry is stale, remove it.
+	}
+
+	num_misses.increment();
+	return Reference<WebPageCacheEntry>();
+}
+
+
+Reference<WebPageCacheEntry> WebPageCache::insert(const std::string& key, uint64 data_version, const std::string& page, double max_age_s, double cur_time)
+{
+	Reference<WebPageCacheEntry> entry = new WebPageCacheEntry();
+	entry->file = new WebDataStoreFile();
+	entry->file->uncompressed_data.resize(page.size());
+	if(!page.empty())
+		std::memcpy(entry->file->uncompressed_data.data(), page.data(), page.size());
+	entry->file->content_type = "text/html; charset=UTF-8";
+
+	// Use fast compression levels, since we are compressing on the request path.
+	// Do the compression outside of the mutex lock.
+	entry->file->compress(/*deflate level=*/Z_BEST_SPEED, /*zstd level=*/3);
+
+	const uint64 hash = XXH64(page.data(), page.size(), /*seed=*/1);
+	entry->etag = "W/\"" + ::toHexString(hash) + "\""; // Use a weak ETag since the representation differs depending on content encoding.
+	entry->data_version = data_version;
+	entry->expiry_time = cur_time + max_age_s;
+
+	{
+		Lock lock(mutex);
+
+		if(pages.size() >= MAX_NUM_PAGES)
+		{
+			removeExpiredEntries(cur_time);
+			if(pages.size() >= MAX_NUM_PAGES)
+				pages.clear();
+		}
+
+		pages[key] = entry;
+	}
+
+	return entry;
+}
+
+
+bool WebPageCache::lookupFragment(const std::string& key, uint64 data_version, double cur_time, std::string& fragment_out)
+{
+	Lock lock(mutex);
+
+	auto res = fragments.find(key);
+	if(res != fragments.end() && (res->second.data_version == data_version) && (cur_time < res->second.expiry_time))
+	{
+		fragment_out = res->second.data;
+		num_fragment_hits.increment();
+		return true;
+	}
+	num_fragment_misses.increment();
+	return false;
+}
+
+
+void WebPageCache::insertFragment(const std::string& key, uint64 data_version, const std::string& fragment, double max_age_s, double cur_time)
+{
+	Lock lock(mutex);
+
+	FragmentEntry& entry = fragments[key];
+	entry.data = fragment;
+	entry.data_version = data_version;
+	entry.expiry_time = cur_time + max_age_s;
+}
+
+
+void WebPageCache::clear()
+{
+	Lock lock(mutex);
+	pages.clear();
+	fragments.clear();
+}
+
+
+size_t WebPageCache::getNumPages()
+{
+	Lock lock(mutex);
+	return pages.size();
+}
+
+
+std::string WebPageCache::getStatsHTML()
+{
+	const int64 total = num_hits + num_misses;
+	const double hit_ratio = (total > 0) ? ((double)num_hits / (double)total) : 0.0;
+
+	std::string s;
+	s += "<p>Cached pages: " + toString(getNumPages()) + "</p>\n";
+	s += "<p>Page hits: " + toString(num_hits) + ", misses: " + toString(num_misses) + " (hit ratio: " + doubleToStringNDecimalPlaces(hit_ratio * 100, 1) + "%)</p>\n";
+	s += "<p>304 Not Modified responses: " + toString(num_not_modified_responses) + "</p>\n";
+	s += "<p>Fragment hits: " + toString(num_fragment_hits) + ", misses: " + toString(num_fragment_misses) + "</p>\n";
+	return s;
+}
+
+
+bool WebPageCache::requestETagMatches(const web::RequestInfo& request_info, const std::string& etag)
+{
+	// If-None-Match may be a comma-separated list of ETags, or '*'.
+	for(size_t i=0; i<request_info.headers.size(); ++i)
+		if(StringUtils::equalCaseInsensitive(request_info.headers[i].key, "if-none-match"))
+		{
+			const std::string val = toString(request_info.headers[i].value);
+			if(StringUtils::containsString(val, etag) || (::stripHeadAndTailWhitespace(val) == "*"))
+				return true;
+		}
+	return false;
+}
+
+
+void WebPageCache::writeResponse(const WebPageCacheEntry& entry, const web::RequestInfo& request_info, web::ReplyInfo& reply_info)
+{
+	if(requestETagMatches(request_info, entry.etag))
+	{
+		const std::string response =
+			"HTTP/1.1 304 Not Modified\r\n"
+			"ETag: " + entry.etag + "\r\n"
+			"Cache-Control: no-cache\r\n"
+			"Connection: Keep-Alive\r\n"
+			"\r\n";
+
+		reply_info.socket->writeData(response.c_str(), response.size());
+		num_not_modified_responses.increment();
+		return;
+	}
+
+	const WebDataStoreFile& file = *entry.file;
+	const js::Vector<uint8, 16>* data;
+	const char* content_encoding = NULL;
+	if(request_info.zstd_accept_encoding && !file.zstd_compressed_data.empty())
+	{
+		data = &file.zstd_compressed_data;
+		content_encoding = "zstd";
+	}
+	else if(request_info.deflate_accept_encoding && !file.deflate_compressed_data.empty())
+	{
+		data = &file.deflate_compressed_data;
+		content_encoding = "deflate";
+	}
+	else
+		data = &file.uncompressed_data;
+
+	// no-cache means the browser may store the page, but must revalidate it (with If-None-Match) before use.
+	std::string response =
+		"HTTP/1.1 200 OK\r\n"
+		"Content-Type: " + file.content_type + "\r\n"
+		"Content-Length: " + toString(data->size()) + "\r\n"
+		"ETag: " + entry.etag + "\r\n"
+		"Cache-Control: no-cache\r\n"
+		"Vary: Accept-Encoding, Cookie\r\n"
+		"Connection: Keep-Alive\r\n";
+	if(content_encoding)
+		response += std::string("Content-Encoding: ") + content_encoding + "\r\n";
+	response += "\r\n";
+
+	reply_info.socket->writeData(response.c_str(), response.size());
+	if(!data->empty())
+		reply_info.socket->writeData(data->data(), data->size());
+}
+
+
+#if BUILD_TESTS
+
+
+void WebPageCache::test()
+{
+	conPrint("WebPageCache::test()");
+
+	//-------------------- Test lookup and insert --------------------
+	{
+		WebPageCache cache;
+		testAssert(cache.lookup("/map|anon", /*data version=*/1, /*cur time=*/0.0).isNull());
+
+		Reference<WebPageCacheEntry> entry = cache.insert("/map|anon", /*data version=*/1, "<html>map</html>", /*max age=*/10.0, /*cur time=*/0.0);
+		testAssert(entry->file->uncompressed_data.size() == 16);
+		testAssert(!entry->file->zstd_compressed_data.empty());
+		testAssert(!entry->file->deflate_compressed_data.empty());
+		testAssert(hasPrefix(entry->etag, "W/\""));
+
+		testAssert(cache.lookup("/map|anon", /*data version=*/1, /*cur time=*/1.0) == entry);
+		testAssert(cache.lookup("/|anon", /*data version=*/1, /*cur time=*/1.0).isNull());
+
+		// Changing the data version should invalidate the entry.
+		testAssert(cache.lookup("/map|anon", /*data version=*/2, /*cur time=*/1.0).isNull());
+		testAssert(cache.lookup("/map|anon", /*data version=*/1, /*cur time=*/1.0).isNull()); // Stale entry should have been removed.
+
+		testAssert(cache.num_hits == 1);
+		testAssert(cache.num_misses == 4);
+		testAssert(cache.getNumPages() == 0);
+	}
+
+	//-------------------- Test expiry --------------------
+	{
+		WebPageCache cache;
+		cache.insert("/|anon", /*data version=*/1, "<html>root</html>", /*max age=*/10.0, /*cur time=*/0.0);
+		testAssert(cache.lookup("/|anon", /*data version=*/1, /*cur time=*/9.0).nonNull());
+		testAssert(cache.lookup("/|anon", /*data version=*/1, /*cur time=*/11.0).isNull());
+	}
+
+	//-------------------- Test identical pages get identical ETags, different pages get different ETags --------------------
+	{
+		WebPageCache cache;
+		Reference<WebPageCacheEntry> a = cache.insert("/a|anon", /*data version=*/1, "page a", /*max age=*/10.0, /*cur time=*/0.0);
+		Reference<WebPageCacheEntry> a2 = cache.insert("/a2|anon", /*data version=*/2, "page a", /*max age=*/10.0, /*cur time=*/0.0);
+		Reference<WebPageCacheEntry> b = cache.insert("/b|anon", /*data version=*/1, "page b", /*max age=*/10.0, /*cur time=*/0.0);
+		testAssert(a->etag == a2->etag);
+		testAssert(a->etag != b->etag);
+	}
+
+	//-------------------- Test fragments --------------------
+	{
+		WebPageCache cache;
+		std::string frag;
+		testAssert(!cache.lookupFragment("map_parcel_data", /*data version=*/1, /*cur time=*/0.0, frag));
+		cache.insertFragment("map_parcel_data", /*data version=*/1, "abc", /*max age=*/10.0, /*cur time=*/0.0);
+		testAssert(cache.lookupFragment("map_parcel_data", /*data version=*/1, /*cur time=*/1.0, frag) && frag == "abc");
+		testAssert(!cache.lookupFragment("map_parcel_data", /*data version=*/2, /*cur time=*/1.0, frag));
+		testAssert(!cache.lookupFragment("map_parcel_data", /*data version=*/1, /*cur time=*/20.0, frag));
+		testAssert(cache.num_fragment_hits == 1);
+		testAssert(cache.num_fragment_misses == 3);
+		testAssert(hasPrefix(cache.getStatsHTML(), "<p>"));
+
+		cache.clear();
+		testAssert(!cache.lookupFragment("map_parcel_data", /*data version=*/1, /*cur time=*/1.0, frag));
+	}
+
+	//-------------------- Test isCacheableRequest and If-None-Match matching --------------------
+	{
+		web::RequestInfo request_info;
+		testAssert(isCacheableRequest(request_info));
+
+		web::Cookie cookie;
+		cookie.key = "site-b";
+		cookie.value = "AAA";
+		request_info.cookies.push_back(cookie);
+		testAssert(!isCacheableRequest(request_info));
+	}
+	{
+		const std::string etag = "W/\"0123456789abcdef\"";
+
+		web::RequestInfo request_info;
+		testAssert(!requestETagMatches(request_info, etag));
+
+		web::Header header;
+		header.key = "If-None-Match";
+		header.value = "W/\"aaaa\", W/\"0123456789abcdef\"";
+		request_info.headers.push_back(header);
+		testAssert(requestETagMatches(request_info, etag));
+
+		request_info.headers[0].value = "W/\"aaaa\"";
+		testAssert(!requestETagMatches(request_info, etag));
+	}
+
+	conPrint("WebPageCache::test() done.");
+}
+
+
+#endif // BUILD_TESTS
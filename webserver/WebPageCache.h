@@ -0,0 +1,108 @@
+/*=====================================================================
+WebPageCache.h
+--------------
+Copyright Glare Technologies Limited 2026 -
+=====================================================================*/
+#pragma once
+
+
+#include <ThreadSafeRefCounted.h>
+#include <Reference.h>
+#include <Mutex.h>
+#include <AtomicInt.h>
+#include <Platform.h>
+#include <string>
+#include <map>
+class WebDataStoreFile;
+namespace web
+{
+class RequestInfo;
+class ReplyInfo;
+}
+
+
+class WebPageCacheEntry : public ThreadSafeRefCounted
+{
+public:
+	Reference<WebDataStoreFile> file; // Uncompressed and precompressed (deflate, zstd) page data.
+	std::string etag; // Including the W/ prefix and quotes, e.g. W/"0123456789abcdef"
+	uint64 data_version; // Value of ServerAllWorldsState::getWebDataVersion() when the page was rendered.
+	double expiry_time; // In Clock::getTimeSinceInit() time.
+};
+
+
+/*=====================================================================
+WebPageCache
+------------
+Cache of rendered dynamic web pages (root page, map page, parcel pages etc.),
+and of expensive page fragments like the map parcel data.
+
+Entries are keyed by a string that should include the path and any request state
+that affects the output (see makeKey()).
+An entry is only returned if it was rendered at the current data version
+(see ServerAllWorldsState::getWebDataVersion()) and has not passed its max age.
+The max age is there to handle page content that depends on the current time,
+such as auction prices.
+
+Pages are stored precompressed with deflate and zstd, like WebDataStore files,
+and are served with an ETag, so that repeat visits can get a 304 Not Modified response.
+=====================================================================*/
+class WebPageCache
+{
+public:
+	WebPageCache();
+	~WebPageCache();
+
+	// Should the response to this request be cached / served from the cache?
+	// Currently only pages for visitors that are not logged in are cached, since logged-in pages contain per-user content.
+	static bool isCacheableRequest(const web::RequestInfo& request_info);
+
+	static std::string makeKey(const web::RequestInfo& request_info);
+
+	// Returns NULL if there is no entry for key, or the entry is stale.
+	Reference<WebPageCacheEntry> lookup(const std::string& key, uint64 data_version, double cur_time);
+
+	// Compresses page and inserts it into the cache.  Returns the new entry.
+	Reference<WebPageCacheEntry> insert(const std::string& key, uint64 data_version, const std::string& page, double max_age_s, double cur_time);
+
+	// Look up a page fragment (uncompressed string data).  Returns false if not found or stale.
+	bool lookupFragment(const std::string& key, uint64 data_version, double cur_time, std::string& fragment_out);
+	void insertFragment(const std::string& key, uint64 data_version, const std::string& fragment, double max_age_s, double cur_time);
+
+	void clear();
+
+	// Writes a 304 Not Modified response if the request has a matching If-None-Match header, otherwise writes the page data with
+	// the best content encoding accepted by the client.
+	void writeResponse(const WebPageCacheEntry& entry, const web::RequestInfo& request_info, web::ReplyInfo& reply_info);
+
+	size_t getNumPages();
+
+	// Returns an HTML summary of the cache statistics, for the admin page.
+	std::string getStatsHTML();
+
+	static bool requestETagMatches(const web::RequestInfo& request_info, const std::string& etag);
+
+	static void test();
+
+	glare::AtomicInt num_hits;
+	glare::AtomicInt num_misses;
+	glare::AtomicInt num_not_modified_responses;
+	glare::AtomicInt num_fragment_hits;
+	glare::AtomicInt num_fragment_misses;
+
+private:
+	GLARE_DISABLE_COPY(WebPageCache);
+
+	void removeExpiredEntries(double cur_time) REQUIRES(mutex);
+
+	struct FragmentEntry
+	{
+		std::string data;
+		uint64 data_version;
+		double expiry_time;
+	};
+
+	std::map<std::string, Reference<WebPageCacheEntry>> pages GUARDED_BY(mutex);
+	std::map<std::string, FragmentEntry> fragments GUARDED_BY(mutex);
+	Mutex mutex;
+};
@@ -119,18 +119,9 @@ const std::string getMapHeaderTags()
 }
 
 
-const std::string getMapEmbedCode(ServerAllWorldsState& world_state, ParcelID highlighted_parcel_id)
+// Builds the hidden divs with parcel boundaries, ids and states, that map.js reads.
+static std::string makeMapParcelDataHTML(ServerAllWorldsState& world_state)
 {
-	std::string page;
-	/*page += 
-		"<script src=\"https://unpkg.com/leaflet@1.7.1/dist/leaflet.js\"\
-		integrity=\"sha512-XQoYMqMTK8LvdxXYG3nZ448hOEQiglfqkJs1NOQV44cWnUrBc8PkAOcXy20w0vlaXaVUearIOBhiXZ5V3ynxwA==\"\
-		crossorigin=\"\"></script>";*/
-	page += "<script src=\"/files/leaflet.js\"></script>";
-
-	page += "<a name=\"map\"></a>";
-	page += "<div id=\"mapid\"></div>";
-
 	// Get parcel polygon boundaries.  Some parcels are rectangles, so we will handle those as a special case optimisation where we can just write a rectangle.
 	std::vector<Vec2d> poly_verts;
 	std::vector<int> poly_parcel_ids;
@@ -258,6 +249,34 @@ const std::string getMapEmbedCode(ServerAllWorldsState& world_state, ParcelID hi
 	}
 	var_js += "</div>\n";
 
+	return var_js;
+}
+
+
+const std::string getMapEmbedCode(ServerAllWorldsState& world_state, ParcelID highlighted_parcel_id)
+{
+	std::string page;
+	/*page += 
+		"<script src=\"https://unpkg.com/leaflet@1.7.1/dist/leaflet.js\"\
+		integrity=\"sha512-XQoYMqMTK8LvdxXYG3nZ448hOEQiglfqkJs1NOQV44cWnUrBc8PkAOcXy20w0vlaXaVUearIOBhiXZ5V3ynxwA==\"\
+		crossorigin=\"\"></script>";*/
+	page += "<script src=\"/files/leaflet.js\"></script>";
+
+	page += "<a name=\"map\"></a>";
+	page += "<div id=\"mapid\"></div>";
+
+	// The parcel data is the same for all map embeds (apart from the highlighted parcel id), and is expensive to build, so cache it.
+	const uint64 data_version = world_state.getWebDataVersion();
+	const double cur_time = Clock::getTimeSinceInit();
+	std::string var_js;
+	if(!world_state.web_data_store->page_cache.lookupFragment("map_parcel_data", data_version, cur_time, var_js))
+	{
+		var_js = makeMapParcelDataHTML(world_state);
+
+		// Parcel state depends on whether auctions are currently running, so limit max age.
+		world_state.web_data_store->page_cache.insertFragment("map_parcel_data", data_version, var_js, /*max age (s)=*/60.0, cur_time);
+	}
+
 	var_js += "<div class=\"hidden\" id=\"highlight_parcel_id\">";
 	var_js += toString(highlighted_parcel_id.value());
 	var_js += "</div>\n";